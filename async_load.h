@@ -0,0 +1,630 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "image_io.h"
+#include "job_system.h"
+#include "profile.h"
+#include "shader_cache.h"
+#include "texture_stream.h"
+#include "thread_pool.h"
+
+#if defined(__linux__)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// coroutine resource loading on top of the job system. every load is a load_task that starts
+// running as soon as it is created, so starting several before awaiting the first one loads
+// them side by side while the code still reads top to bottom:
+//
+//     load_task<bool> load_scene(load_context *ctx, shader_cache *cache, scene *s)
+//     {
+//         auto texture = load_texture(ctx, "data/uv_grid.jpg");  // all three start here
+//         auto vs = load_shader(ctx, cache, &vs_desc);
+//         auto ps = load_shader(ctx, cache, &ps_desc);
+//         s->image = co_await texture;                            // null if it failed
+//         s->vs = co_await vs;
+//         s->ps = co_await ps;
+//         co_await load_on_main(ctx);                             // device calls from here on
+//         ...
+//         co_return true;
+//     }
+//
+//     bool ok = load_wait(&ctx, load_scene(&ctx, &cache, &s));
+//
+// file reads go through io_uring on linux, a thread reaps the completions and hands the
+// waiting coroutine back to the pool. elsewhere, or where the kernel refuses a ring, reads
+// are blocking jobs on the pool. epoll doesn't help here, regular files are always ready.
+// decoding, mips and shader compiles run on the pool and fan out further through it.
+//
+// every task has to be awaited or passed to load_wait before it goes out of scope, and
+// pointer arguments such as paths have to stay valid until it finished.
+
+#define LOAD_RING_ENTRIES 256 // submission queue size, the kernel makes the completion queue twice as big
+#define LOAD_READ_CHUNK (1u << 30)
+
+struct load_context
+{
+    thread_pool *pool;
+#if defined(__linux__)
+    int ring_fd; // -1 when reads run on the pool
+    uint8_t *sq_ring;
+    size_t sq_ring_size;
+    uint8_t *cq_ring;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+    std::atomic<uint32_t> *sq_head;
+    std::atomic<uint32_t> *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t *sq_array;
+    std::atomic<uint32_t> *cq_head;
+    std::atomic<uint32_t> *cq_tail;
+    uint32_t cq_mask;
+    io_uring_cqe *cqes;
+    std::mutex submit_mutex;
+    std::thread reaper;
+
+    // reads submitted and not reaped yet, at most one per completion queue entry so the
+    // completion queue can't overflow
+    std::mutex read_mutex;
+    std::condition_variable read_done;
+    uint32_t reads_in_flight;
+    uint32_t max_reads_in_flight;
+#endif
+};
+
+//
+// tasks
+//
+
+#define LOAD_TASK_DONE ((void *)1)
+
+template <typename T>
+struct load_task;
+
+template <typename T>
+struct load_promise
+{
+    // null while running, the coroutine awaiting it, or LOAD_TASK_DONE
+    std::atomic<void *> waiting{nullptr};
+    T value{};
+
+    // declared so the promise isn't an aggregate, c++20 would otherwise build it from the
+    // coroutine's arguments
+    load_promise() = default;
+
+    load_task<T> get_return_object() { return load_task<T>{std::coroutine_handle<load_promise>::from_promise(*this)}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    void return_value(T v) { value = std::move(v); }
+    void unhandled_exception() { std::terminate(); }
+
+    // stays suspended at the end so the task can still read value, and goes straight on with
+    // whoever awaited it
+    struct final_awaiter
+    {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<load_promise> h) noexcept
+        {
+            void *waiting = h.promise().waiting.exchange(LOAD_TASK_DONE, std::memory_order_acq_rel);
+            return waiting ? std::coroutine_handle<>::from_address(waiting) : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+};
+
+template <typename T>
+struct load_task
+{
+    typedef load_promise<T> promise_type;
+    std::coroutine_handle<promise_type> handle;
+
+    load_task() = default;
+    explicit load_task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    load_task(load_task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    load_task &operator=(load_task &&other) noexcept
+    {
+        if (handle)
+            handle.destroy();
+        handle = std::exchange(other.handle, nullptr);
+        return *this;
+    }
+    load_task(const load_task &) = delete;
+    load_task &operator=(const load_task &) = delete;
+    ~load_task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return handle.promise().waiting.load(std::memory_order_acquire) == LOAD_TASK_DONE; }
+    // false resumes right away, the task finished in the meantime
+    bool await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        void *expected = nullptr;
+        return handle.promise().waiting.compare_exchange_strong(expected, h.address(), std::memory_order_acq_rel, std::memory_order_acquire);
+    }
+    T await_resume() { return std::move(handle.promise().value); }
+};
+
+template <typename T>
+inline bool
+load_task_done(const load_task<T> &task)
+{
+    return task.handle.promise().waiting.load(std::memory_order_acquire) == LOAD_TASK_DONE;
+}
+
+// runs jobs until task finished and returns its value. call it on the thread that created the
+// pool, it runs the load_on_main parts while it waits
+template <typename T>
+inline T
+load_wait(load_context *ctx, load_task<T> &&task)
+{
+    PROFILE_ZONE("load_wait");
+    while (load_task_done(task) == false)
+    {
+        if (job_help(&ctx->pool->jobs) == false)
+            std::this_thread::yield();
+    }
+    return std::move(task.handle.promise().value);
+}
+
+//
+// switching threads
+//
+
+inline void
+load_resume_job(void *user)
+{
+    std::coroutine_handle<>::from_address(user).resume();
+}
+
+// continues the coroutine on a pool thread
+struct load_pool_awaiter
+{
+    load_context *ctx;
+
+    bool await_ready() noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { job_run(&ctx->pool->jobs, load_resume_job, h.address()); }
+    void await_resume() noexcept {}
+};
+
+inline load_pool_awaiter
+load_on_pool(load_context *ctx)
+{
+    return {ctx};
+}
+
+// continues the coroutine on the thread that created the pool, the next time it pumps the
+// main queue or waits
+struct load_main_awaiter
+{
+    load_context *ctx;
+
+    bool await_ready() noexcept
+    {
+        job_worker *worker = job_worker_of(&ctx->pool->jobs);
+        return worker && worker->index == 0;
+    }
+    void await_suspend(std::coroutine_handle<> h) { job_run_main(&ctx->pool->jobs, load_resume_job, h.address()); }
+    void await_resume() noexcept {}
+};
+
+inline load_main_awaiter
+load_on_main(load_context *ctx)
+{
+    return {ctx};
+}
+
+//
+// file reads
+//
+
+struct load_read_awaiter
+{
+    load_context *ctx;
+    const char *path;
+    std::vector<uint8_t> *data;
+    std::coroutine_handle<> waiting;
+    int fd;
+    size_t offset;
+    bool ok;
+
+    bool await_ready() noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h);
+    bool await_resume() noexcept { return ok; }
+};
+
+inline void
+load_read_blocking(void *user)
+{
+    PROFILE_ZONE("load read");
+    load_read_awaiter *read = (load_read_awaiter *)user;
+    read->ok = false;
+    FILE *file = fopen(read->path, "rb");
+    if (file)
+    {
+        if (fseek(file, 0, SEEK_END) == 0)
+        {
+            long size = ftell(file);
+            if (size >= 0 && fseek(file, 0, SEEK_SET) == 0)
+            {
+                read->data->resize((size_t)size);
+                read->ok = fread(read->data->data(), 1, (size_t)size, file) == (size_t)size;
+            }
+        }
+        fclose(file);
+    }
+    read->waiting.resume();
+}
+
+#if defined(__linux__)
+
+inline int
+load_ring_enter(int fd, unsigned submit, unsigned wait, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0);
+}
+
+// hands read back to its coroutine on the pool and frees its slot
+inline void
+load_ring_finish(load_context *ctx, load_read_awaiter *read, bool ok)
+{
+    read->ok = ok;
+    close(read->fd);
+    {
+        std::lock_guard<std::mutex> lock(ctx->read_mutex);
+        ctx->reads_in_flight--;
+    }
+    ctx->read_done.notify_one();
+    job_run(&ctx->pool->jobs, load_resume_job, read->waiting.address());
+}
+
+// queues the next chunk of every read with one io_uring_enter per submission queue full. a
+// null read is the reaper's quit signal, user_data 0. reads the kernel refuses fail, returns
+// how many it took
+inline uint32_t
+load_ring_submit(load_context *ctx, load_read_awaiter *const *reads, uint32_t count)
+{
+    uint32_t submitted = 0;
+    {
+        std::lock_guard<std::mutex> lock(ctx->submit_mutex);
+        while (submitted < count)
+        {
+            uint32_t batch = count - submitted < ctx->sq_entries ? count - submitted : ctx->sq_entries;
+            uint32_t tail = ctx->sq_tail->load(std::memory_order_relaxed);
+            for (uint32_t i = 0; i < batch; ++i)
+            {
+                uint32_t index = (tail + i) & ctx->sq_mask;
+                io_uring_sqe *sqe = &ctx->sqes[index];
+                memset(sqe, 0, sizeof(*sqe));
+                load_read_awaiter *read = reads[submitted + i];
+                if (read)
+                {
+                    size_t remaining = read->data->size() - read->offset;
+                    sqe->opcode = IORING_OP_READ;
+                    sqe->fd = read->fd;
+                    sqe->off = read->offset;
+                    sqe->addr = (uint64_t)(uintptr_t)(read->data->data() + read->offset);
+                    sqe->len = remaining < LOAD_READ_CHUNK ? (uint32_t)remaining : LOAD_READ_CHUNK;
+                    sqe->user_data = (uint64_t)(uintptr_t)read;
+                }
+                else
+                {
+                    sqe->opcode = IORING_OP_NOP;
+                }
+                ctx->sq_array[index] = index;
+            }
+            ctx->sq_tail->store(tail + batch, std::memory_order_release);
+
+            // the kernel takes the entries it accepts during the call, the reaper's calls don't
+            // submit anything, so whatever is left can be taken back off the queue
+            uint32_t taken = 0;
+            while (taken < batch)
+            {
+                int result = load_ring_enter(ctx->ring_fd, batch - taken, 0, 0);
+                if (result > 0)
+                    taken += (uint32_t)result;
+                else if (result == 0 || (errno != EINTR && errno != EAGAIN))
+                    break;
+            }
+            submitted += taken;
+            if (taken < batch)
+            {
+                ctx->sq_tail->store(tail + taken, std::memory_order_release);
+                break;
+            }
+        }
+    }
+
+    for (uint32_t i = submitted; i < count; ++i)
+    {
+        if (reads[i])
+            load_ring_finish(ctx, reads[i], false);
+    }
+    return submitted;
+}
+
+inline void
+load_ring_reaper_main(load_context *ctx)
+{
+    PROFILE_THREAD_NAME("load reaper");
+    std::vector<load_read_awaiter *> resubmit;
+    for (;;)
+    {
+        // completions land in the ring without the call, if waiting fails poll it instead
+        if (load_ring_enter(ctx->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            std::this_thread::yield();
+
+        uint32_t head = ctx->cq_head->load(std::memory_order_relaxed);
+        uint32_t tail = ctx->cq_tail->load(std::memory_order_acquire);
+        bool quit = false;
+        for (; head != tail; ++head)
+        {
+            io_uring_cqe cqe = ctx->cqes[head & ctx->cq_mask];
+            ctx->cq_head->store(head + 1, std::memory_order_release);
+
+            load_read_awaiter *read = (load_read_awaiter *)(uintptr_t)cqe.user_data;
+            if (read == nullptr)
+            {
+                quit = true;
+                continue;
+            }
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+            {
+                resubmit.push_back(read);
+                continue;
+            }
+            if (cqe.res > 0)
+            {
+                read->offset += (size_t)cqe.res;
+                if (read->offset < read->data->size())
+                {
+                    resubmit.push_back(read);
+                    continue;
+                }
+            }
+
+            // done, or failed, or the file got shorter since the fstat
+            load_ring_finish(ctx, read, cqe.res > 0 && read->offset == read->data->size());
+        }
+        if (resubmit.empty() == false)
+        {
+            load_ring_submit(ctx, resubmit.data(), (uint32_t)resubmit.size());
+            resubmit.clear();
+        }
+        if (quit)
+            return;
+    }
+}
+
+inline bool
+load_ring_init(load_context *ctx)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ctx->ring_fd = (int)syscall(__NR_io_uring_setup, LOAD_RING_ENTRIES, &params);
+    if (ctx->ring_fd < 0)
+        return false;
+
+    ctx->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ctx->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ctx->cq_ring_size > ctx->sq_ring_size)
+        ctx->sq_ring_size = ctx->cq_ring_size;
+
+    void *sq = mmap(nullptr, ctx->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_SQ_RING);
+    void *cq = single_mmap ? sq : mmap(nullptr, ctx->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_CQ_RING);
+    ctx->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, ctx->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ctx->ring_fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        if (sq != MAP_FAILED)
+            munmap(sq, ctx->sq_ring_size);
+        if (cq != MAP_FAILED && cq != sq)
+            munmap(cq, ctx->cq_ring_size);
+        if (sqes != MAP_FAILED)
+            munmap(sqes, ctx->sqes_size);
+        close(ctx->ring_fd);
+        ctx->ring_fd = -1;
+        return false;
+    }
+
+    // the ring indices are plain u32s shared with the kernel, accessed the way liburing does
+    ctx->sq_ring = (uint8_t *)sq;
+    ctx->cq_ring = (uint8_t *)cq;
+    ctx->sqes = (io_uring_sqe *)sqes;
+    ctx->sq_head = (std::atomic<uint32_t> *)(ctx->sq_ring + params.sq_off.head);
+    ctx->sq_tail = (std::atomic<uint32_t> *)(ctx->sq_ring + params.sq_off.tail);
+    ctx->sq_mask = *(uint32_t *)(ctx->sq_ring + params.sq_off.ring_mask);
+    ctx->sq_entries = params.sq_entries;
+    ctx->sq_array = (uint32_t *)(ctx->sq_ring + params.sq_off.array);
+    ctx->cq_head = (std::atomic<uint32_t> *)(ctx->cq_ring + params.cq_off.head);
+    ctx->cq_tail = (std::atomic<uint32_t> *)(ctx->cq_ring + params.cq_off.tail);
+    ctx->cq_mask = *(uint32_t *)(ctx->cq_ring + params.cq_off.ring_mask);
+    ctx->cqes = (io_uring_cqe *)(ctx->cq_ring + params.cq_off.cqes);
+    ctx->reads_in_flight = 0;
+    ctx->max_reads_in_flight = params.cq_entries;
+
+    ctx->reaper = std::thread(load_ring_reaper_main, ctx);
+    return true;
+}
+
+inline void
+load_ring_shutdown(load_context *ctx)
+{
+    if (ctx->ring_fd < 0)
+        return;
+    // nothing is in flight any more, so the quit signal fits the completion queue
+    load_read_awaiter *quit = nullptr;
+    while (load_ring_submit(ctx, &quit, 1) == 0)
+        std::this_thread::yield();
+    ctx->reaper.join();
+    munmap(ctx->sqes, ctx->sqes_size);
+    if (ctx->cq_ring != ctx->sq_ring)
+        munmap(ctx->cq_ring, ctx->cq_ring_size);
+    munmap(ctx->sq_ring, ctx->sq_ring_size);
+    close(ctx->ring_fd);
+    ctx->ring_fd = -1;
+}
+
+#endif
+
+// the awaiter lives in the suspended coroutine's frame, the read completes into it
+inline bool
+load_read_awaiter::await_suspend(std::coroutine_handle<> h)
+{
+    waiting = h;
+    ok = false;
+    offset = 0;
+#if defined(__linux__)
+    if (ctx->ring_fd >= 0)
+    {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return false;
+        }
+        data->resize((size_t)st.st_size);
+        if (data->empty())
+        {
+            close(fd);
+            ok = true;
+            return false;
+        }
+
+        // waits for the reaper when the completion queue could fill up
+        {
+            std::unique_lock<std::mutex> lock(ctx->read_mutex);
+            while (ctx->reads_in_flight >= ctx->max_reads_in_flight)
+                ctx->read_done.wait(lock);
+            ctx->reads_in_flight++;
+        }
+        load_read_awaiter *read = this;
+        load_ring_submit(ctx, &read, 1);
+        return true;
+    }
+#endif
+    job_run(&ctx->pool->jobs, load_read_blocking, this);
+    return true;
+}
+
+// reads the whole file into data, the coroutine goes on on a pool thread. returns false if
+// the file can't be opened or read
+inline load_read_awaiter
+load_read_file(load_context *ctx, const char *path, std::vector<uint8_t> *data)
+{
+    load_read_awaiter read = {};
+    read.ctx = ctx;
+    read.path = path;
+    read.data = data;
+    read.fd = -1;
+    return read;
+}
+
+//
+// api
+//
+
+// use_ring false sends every read through the pool, for comparisons
+inline void
+load_context_init(load_context *ctx, thread_pool *pool, bool use_ring = true)
+{
+    ctx->pool = pool;
+#if defined(__linux__)
+    ctx->ring_fd = -1;
+    if (use_ring)
+        load_ring_init(ctx);
+#endif
+}
+
+// every task has to be finished
+inline void
+load_context_shutdown(load_context *ctx)
+{
+#if defined(__linux__)
+    load_ring_shutdown(ctx);
+#endif
+}
+
+inline bool
+load_context_uses_ring(const load_context *ctx)
+{
+#if defined(__linux__)
+    return ctx->ring_fd >= 0;
+#else
+    return false;
+#endif
+}
+
+// cooked .tex files are mapped and touched on a pool thread, anything else is read, decoded
+// and gets its mips (and BC7 blocks when compress is set) built across the pool. returns the
+// same image texture_stream hands to its upload callback, null on failure, free it with
+// texture_stream_image_free
+inline load_task<texture_stream_image *>
+load_texture(load_context *ctx, const char *path, bool compress = false)
+{
+    texture_stream_image *image = new texture_stream_image();
+    size_t length = strlen(path);
+    if (length > 4 && strcmp(path + length - 4, ".tex") == 0)
+    {
+        co_await load_on_pool(ctx);
+        if (texture_stream_load_cooked(image, path) == false)
+        {
+            texture_stream_image_free(image);
+            co_return nullptr;
+        }
+        co_return image;
+    }
+
+    std::vector<uint8_t> file;
+    if (co_await load_read_file(ctx, path, &file) == false)
+    {
+        texture_stream_image_free(image);
+        co_return nullptr;
+    }
+
+    int width, height;
+    uint8_t *pixels = image_load_memory(file.data(), file.size(), &width, &height);
+    std::vector<uint8_t>().swap(file);
+    if (pixels == nullptr || texture_stream_build_image(image, pixels, width, height, compress, ctx->pool) == false)
+    {
+        texture_stream_image_free(image);
+        co_return nullptr;
+    }
+    co_return image;
+}
+
+// looks desc up in the cache and compiles it on a pool thread on a miss. desc and everything
+// it points to has to stay valid until the task finished
+inline load_task<shader_result>
+load_shader(load_context *ctx, shader_cache *cache, const shader_desc *desc)
+{
+    co_await load_on_pool(ctx);
+    shader_result result;
+    shader_cache_compile(cache, desc, &result);
+    co_return result;
+}
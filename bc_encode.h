@@ -0,0 +1,835 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "simd_math.h"
+#include "thread_pool.h"
+
+// block compression for rgba8 images: BC1 (rgb, 1 bit alpha), BC3 (BC1 color + BC4 alpha) and
+// BC7 mode 6 (one subset, rgba 7.7.7.7 endpoints with p-bits, 4 bit indices). blocks are
+// written row after row, bc_row_pitch bytes apart, which is the layout CreateTexture2D
+// expects for DXGI_FORMAT_BC1_UNORM, BC3_UNORM and BC7_UNORM.
+//
+// every block starts from endpoints on its principal axis, higher quality presets refine them
+// with least squares on the chosen indices. index selection tests SIMD_MATH_WIDTH pixels at a
+// time against the whole palette. block rows are spread over the thread pool.
+
+enum bc_format
+{
+    BC_FORMAT_BC1,
+    BC_FORMAT_BC3,
+    BC_FORMAT_BC7,
+};
+
+enum bc_quality
+{
+    BC_QUALITY_FAST,   // principal axis endpoints
+    BC_QUALITY_NORMAL, // plus two least squares refinements
+    BC_QUALITY_HIGH,   // plus more refinements, endpoint nudging and a full p-bit search
+};
+
+// one 4x4 block, channel c of pixel y * 4 + x
+struct bc_block
+{
+    alignas(SIMD_MATH_ALIGN) float c[4][16];
+};
+
+inline int
+bc_block_bytes(bc_format format)
+{
+    return format == BC_FORMAT_BC1 ? 8 : 16;
+}
+
+inline int
+bc_row_pitch(bc_format format, int width)
+{
+    return (width + 3) / 4 * bc_block_bytes(format);
+}
+
+inline size_t
+bc_level_size(bc_format format, int width, int height)
+{
+    return (size_t)bc_row_pitch(format, width) * ((height + 3) / 4);
+}
+
+inline float
+bc_clamp(float v, float lo, float hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// pixels past the edge of the image repeat the last row/column
+inline void
+bc_load_block(const uint8_t *pixels, int width, int height, int pitch, int block_x, int block_y, bc_block *block)
+{
+    for (int y = 0; y < 4; ++y)
+    {
+        int py = block_y * 4 + y < height ? block_y * 4 + y : height - 1;
+        for (int x = 0; x < 4; ++x)
+        {
+            int px = block_x * 4 + x < width ? block_x * 4 + x : width - 1;
+            const uint8_t *p = pixels + (size_t)py * pitch + px * 4;
+            for (int c = 0; c < 4; ++c)
+                block->c[c][y * 4 + x] = (float)p[c];
+        }
+    }
+}
+
+// nearest palette entry for every pixel over channel_count channels, returns the summed
+// squared error
+inline float
+bc_fit_indices(const float (*channels)[16], int channel_count, const float (*palette)[4], int palette_size, uint8_t indices[16])
+{
+    float total = 0.0f;
+    for (int i = 0; i < 16; i += SIMD_MATH_WIDTH)
+    {
+        vf best = vf_splat(FLT_MAX);
+        vf best_index = vf_splat(0.0f);
+        for (int p = 0; p < palette_size; ++p)
+        {
+            vf error = vf_splat(0.0f);
+            for (int c = 0; c < channel_count; ++c)
+            {
+                vf d = vf_sub(vf_load(channels[c] + i), vf_splat(palette[p][c]));
+                error = vf_madd(d, d, error);
+            }
+            vf closer = vf_cmp_ge(best, error);
+            best = vf_select(closer, error, best);
+            best_index = vf_select(closer, vf_splat((float)p), best_index);
+        }
+
+        alignas(SIMD_MATH_ALIGN) float lane_error[SIMD_MATH_WIDTH];
+        alignas(SIMD_MATH_ALIGN) float lane_index[SIMD_MATH_WIDTH];
+        vf_store(lane_error, best);
+        vf_store(lane_index, best_index);
+        for (int lane = 0; lane < SIMD_MATH_WIDTH; ++lane)
+        {
+            total += lane_error[lane];
+            indices[i + lane] = (uint8_t)lane_index[lane];
+        }
+    }
+    return total;
+}
+
+// mean and dominant direction of the first channel_count channels, power iteration on the
+// covariance. axis is zero for flat blocks
+inline void
+bc_principal_axis(const bc_block *block, int channel_count, float mean[4], float axis[4])
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        mean[c] = 0.0f;
+        axis[c] = 0.0f;
+    }
+    for (int c = 0; c < channel_count; ++c)
+    {
+        for (int i = 0; i < 16; ++i)
+            mean[c] += block->c[c][i];
+        mean[c] *= 1.0f / 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float d[4];
+        for (int c = 0; c < channel_count; ++c)
+            d[c] = block->c[c][i] - mean[c];
+        for (int r = 0; r < channel_count; ++r)
+            for (int c = 0; c < channel_count; ++c)
+                covariance[r][c] += d[r] * d[c];
+    }
+
+    // start from the row of the channel with the largest variance
+    int widest = 0;
+    for (int c = 1; c < channel_count; ++c)
+        widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+    float v[4] = {};
+    for (int c = 0; c < channel_count; ++c)
+        v[c] = covariance[widest][c];
+
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float largest = 0.0f;
+        for (int r = 0; r < channel_count; ++r)
+        {
+            for (int c = 0; c < channel_count; ++c)
+                next[r] += covariance[r][c] * v[c];
+            largest = fabsf(next[r]) > largest ? fabsf(next[r]) : largest;
+        }
+        if (largest < 1e-6f)
+            return;
+        for (int c = 0; c < channel_count; ++c)
+            v[c] = next[c] / largest;
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < channel_count; ++c)
+        length += v[c] * v[c];
+    length = sqrtf(length);
+    for (int c = 0; c < channel_count; ++c)
+        axis[c] = v[c] / length;
+}
+
+// extent of the block along axis
+inline void
+bc_axis_endpoints(const bc_block *block, int channel_count, const float mean[4], const float axis[4], float e0[4], float e1[4])
+{
+    float t_min = 0.0f;
+    float t_max = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < channel_count; ++c)
+            t += (block->c[c][i] - mean[c]) * axis[c];
+        t_min = t < t_min ? t : t_min;
+        t_max = t > t_max ? t : t_max;
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+        e0[c] = bc_clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+        e1[c] = bc_clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+    }
+}
+
+// endpoints that minimize the error for fixed indices, weights[index] is the position
+// between e0 and e1, negative weights leave the pixel out. false when degenerate
+inline bool
+bc_least_squares(const bc_block *block, int channel_count, const uint8_t indices[16], const float *weights, float e0[4], float e1[4])
+{
+    float a = 0.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    float d0[4] = {};
+    float d1[4] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float w = weights[indices[i]];
+        if (w < 0.0f)
+            continue;
+        float iw = 1.0f - w;
+        a += iw * iw;
+        b += iw * w;
+        c += w * w;
+        for (int ch = 0; ch < channel_count; ++ch)
+        {
+            d0[ch] += iw * block->c[ch][i];
+            d1[ch] += w * block->c[ch][i];
+        }
+    }
+
+    float det = a * c - b * b;
+    if (fabsf(det) < 1e-6f)
+        return false;
+    for (int ch = 0; ch < channel_count; ++ch)
+    {
+        e0[ch] = bc_clamp((c * d0[ch] - b * d1[ch]) / det, 0.0f, 255.0f);
+        e1[ch] = bc_clamp((a * d1[ch] - b * d0[ch]) / det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+inline void
+bc_write_u16(uint8_t *out, uint32_t v)
+{
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+}
+
+//
+// BC1 color block, also the color half of BC3
+//
+
+inline uint16_t
+bc1_pack565(const float c[3])
+{
+    int r = (int)(bc_clamp(c[0], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+    int g = (int)(bc_clamp(c[1], 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+    int b = (int)(bc_clamp(c[2], 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void
+bc1_unpack565(uint32_t v, uint8_t out[4])
+{
+    uint32_t r = (v >> 11) & 31;
+    uint32_t g = (v >> 5) & 63;
+    uint32_t b = v & 31;
+    out[0] = (uint8_t)((r << 3) | (r >> 2));
+    out[1] = (uint8_t)((g << 2) | (g >> 4));
+    out[2] = (uint8_t)((b << 3) | (b >> 2));
+    out[3] = 255;
+}
+
+// four colors when c0 > c1 or always for BC3, else three colors and transparent black
+inline void
+bc1_palette(uint32_t c0, uint32_t c1, bool force_four, uint8_t palette[4][4])
+{
+    bc1_unpack565(c0, palette[0]);
+    bc1_unpack565(c1, palette[1]);
+    if (force_four || c0 > c1)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (uint8_t)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+            palette[3][c] = (uint8_t)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+        }
+        palette[2][3] = 255;
+        palette[3][3] = 255;
+    }
+    else
+    {
+        for (int c = 0; c < 3; ++c)
+            palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c]) / 2);
+        palette[2][3] = 255;
+        memset(palette[3], 0, 4);
+    }
+}
+
+struct bc1_candidate
+{
+    uint32_t c0;
+    uint32_t c1;
+    uint8_t indices[16];
+    float error;
+};
+
+// orders the endpoints for the wanted mode, fits indices and scores them. punch_through
+// blocks use three colors and index 3 for every pixel in transparent
+inline void
+bc1_evaluate(const bc_block *block, uint32_t c0, uint32_t c1, bool force_four, bool punch_through, const bool transparent[16], bc1_candidate *candidate)
+{
+    bool swap = punch_through ? c0 > c1 : c0 < c1;
+    candidate->c0 = swap ? c1 : c0;
+    candidate->c1 = swap ? c0 : c1;
+
+    uint8_t palette_bytes[4][4];
+    bc1_palette(candidate->c0, candidate->c1, force_four, palette_bytes);
+    float palette[4][4];
+    for (int p = 0; p < 4; ++p)
+        for (int c = 0; c < 4; ++c)
+            palette[p][c] = (float)palette_bytes[p][c];
+
+    // equal BC1 endpoints decode as three colors, index 3 would be transparent
+    bool three_color = punch_through || (force_four == false && candidate->c0 == candidate->c1);
+    candidate->error = bc_fit_indices(block->c, 3, palette, three_color ? 3 : 4, candidate->indices);
+    if (punch_through == false)
+        return;
+
+    // only opaque pixels count
+    candidate->error = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        if (transparent[i])
+        {
+            candidate->indices[i] = 3;
+            continue;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            float d = block->c[c][i] - palette[candidate->indices[i]][c];
+            candidate->error += d * d;
+        }
+    }
+}
+
+inline void
+bc1_encode_color(const bc_block *source, bc_quality quality, bool force_four, uint8_t out[8])
+{
+    // transparent pixels take the mean opaque color so they don't pull the fit around
+    bc_block block = *source;
+    bool transparent[16] = {};
+    bool punch_through = false;
+    if (force_four == false)
+    {
+        float sum[3] = {};
+        int opaque = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            transparent[i] = block.c[3][i] < 128.0f;
+            punch_through |= transparent[i];
+            if (transparent[i] == false)
+            {
+                for (int c = 0; c < 3; ++c)
+                    sum[c] += block.c[c][i];
+                opaque++;
+            }
+        }
+        if (opaque == 0)
+        {
+            // c0 <= c1 and every index 3, transparent black
+            memset(out, 0, 4);
+            memset(out + 4, 0xff, 4);
+            return;
+        }
+        for (int i = 0; i < 16; ++i)
+            if (transparent[i])
+                for (int c = 0; c < 3; ++c)
+                    block.c[c][i] = sum[c] / (float)opaque;
+    }
+
+    float mean[4], axis[4], e0[4], e1[4];
+    bc_principal_axis(&block, 3, mean, axis);
+    bc_axis_endpoints(&block, 3, mean, axis, e0, e1);
+
+    bc1_candidate best;
+    bc1_evaluate(&block, bc1_pack565(e1), bc1_pack565(e0), force_four, punch_through, transparent, &best);
+
+    // position of every index between c0 and c1
+    static const float four_weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    static const float three_weights[4] = {0.0f, 1.0f, 0.5f, -1.0f};
+
+    int refinements = quality == BC_QUALITY_FAST ? 0 : (quality == BC_QUALITY_NORMAL ? 2 : 8);
+    for (int iteration = 0; iteration < refinements && best.error > 0.0f; ++iteration)
+    {
+        bool three_color = punch_through || (force_four == false && best.c0 == best.c1);
+        if (bc_least_squares(&block, 3, best.indices, three_color ? three_weights : four_weights, e0, e1) == false)
+            break;
+
+        bc1_candidate candidate;
+        bc1_evaluate(&block, bc1_pack565(e0), bc1_pack565(e1), force_four, punch_through, transparent, &candidate);
+        if (candidate.error >= best.error)
+            break;
+        best = candidate;
+    }
+
+    // nudge every 565 channel of both endpoints by one step while it helps
+    if (quality == BC_QUALITY_HIGH)
+    {
+        static const uint32_t shifts[3] = {11, 5, 0};
+        static const uint32_t masks[3] = {31, 63, 31};
+        bool improved = true;
+        for (int pass = 0; pass < 4 && improved && best.error > 0.0f; ++pass)
+        {
+            improved = false;
+            for (int endpoint = 0; endpoint < 2; ++endpoint)
+            {
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    for (int step = -1; step <= 1; step += 2)
+                    {
+                        uint32_t packed = endpoint == 0 ? best.c0 : best.c1;
+                        int value = (int)((packed >> shifts[channel]) & masks[channel]) + step;
+                        if (value < 0 || value > (int)masks[channel])
+                            continue;
+                        packed = (packed & ~(masks[channel] << shifts[channel])) | ((uint32_t)value << shifts[channel]);
+
+                        bc1_candidate candidate;
+                        bc1_evaluate(&block, endpoint == 0 ? packed : best.c0, endpoint == 0 ? best.c1 : packed,
+                            force_four, punch_through, transparent, &candidate);
+                        if (candidate.error < best.error)
+                        {
+                            best = candidate;
+                            improved = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bc_write_u16(out, best.c0);
+    bc_write_u16(out + 2, best.c1);
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint32_t)best.indices[i] << (i * 2);
+    bc_write_u16(out + 4, bits);
+    bc_write_u16(out + 6, bits >> 16);
+}
+
+//
+// BC4 single channel block, the alpha half of BC3
+//
+
+// eight interpolated values when a0 > a1, else six plus 0 and 255
+inline void
+bc4_palette(uint32_t a0, uint32_t a1, uint8_t palette[8])
+{
+    palette[0] = (uint8_t)a0;
+    palette[1] = (uint8_t)a1;
+    if (a0 > a1)
+    {
+        for (uint32_t i = 1; i < 7; ++i)
+            palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+    }
+    else
+    {
+        for (uint32_t i = 1; i < 5; ++i)
+            palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+inline float
+bc4_evaluate(const float (*values)[16], uint32_t a0, uint32_t a1, uint8_t indices[16])
+{
+    uint8_t palette_bytes[8];
+    bc4_palette(a0, a1, palette_bytes);
+    float palette[8][4] = {};
+    for (int p = 0; p < 8; ++p)
+        palette[p][0] = (float)palette_bytes[p];
+    return bc_fit_indices(values, 1, palette, 8, indices);
+}
+
+inline void
+bc4_encode(const float (*values)[16], bc_quality quality, uint8_t out[8])
+{
+    int lo = 255, hi = 0;
+    int inner_lo = 255, inner_hi = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int v = (int)(*values)[i];
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+        if (v != 0 && v != 255)
+        {
+            inner_lo = v < inner_lo ? v : inner_lo;
+            inner_hi = v > inner_hi ? v : inner_hi;
+        }
+    }
+
+    uint32_t best_a0 = (uint32_t)hi;
+    uint32_t best_a1 = (uint32_t)lo;
+    uint8_t best_indices[16];
+    float best_error = bc4_evaluate(values, best_a0, best_a1, best_indices);
+
+    // six value mode when the block mixes 0/255 with values in between
+    if (quality != BC_QUALITY_FAST && best_error > 0.0f && inner_lo <= inner_hi && (lo == 0 || hi == 255))
+    {
+        uint8_t indices[16];
+        float error = bc4_evaluate(values, (uint32_t)inner_lo, (uint32_t)inner_hi, indices);
+        if (error < best_error)
+        {
+            best_error = error;
+            best_a0 = (uint32_t)inner_lo;
+            best_a1 = (uint32_t)inner_hi;
+            memcpy(best_indices, indices, 16);
+        }
+    }
+
+    // pull the eight value endpoints in while it helps
+    if (quality == BC_QUALITY_HIGH && best_a0 > best_a1 + 2)
+    {
+        for (int pass = 0; pass < 8 && best_error > 0.0f; ++pass)
+        {
+            uint32_t tries[2][2] = {{best_a0 - 1, best_a1}, {best_a0, best_a1 + 1}};
+            bool improved = false;
+            for (int t = 0; t < 2; ++t)
+            {
+                if (tries[t][0] <= tries[t][1])
+                    continue;
+                uint8_t indices[16];
+                float error = bc4_evaluate(values, tries[t][0], tries[t][1], indices);
+                if (error < best_error)
+                {
+                    best_error = error;
+                    best_a0 = tries[t][0];
+                    best_a1 = tries[t][1];
+                    memcpy(best_indices, indices, 16);
+                    improved = true;
+                }
+            }
+            if (improved == false)
+                break;
+        }
+    }
+
+    uint64_t bits = best_a0 | (best_a1 << 8);
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint64_t)best_indices[i] << (16 + i * 3);
+    for (int i = 0; i < 8; ++i)
+        out[i] = (uint8_t)(bits >> (i * 8));
+}
+
+//
+// BC7 mode 6
+//
+
+static const int bc7_weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct bc7_candidate
+{
+    int endpoints[2][4]; // 7 bit values
+    int pbits[2];
+    uint8_t indices[16];
+    float error;
+};
+
+inline int
+bc7_quantize(float v, int pbit)
+{
+    int q = (int)((v - (float)pbit) * 0.5f + 0.5f);
+    return q < 0 ? 0 : (q > 127 ? 127 : q);
+}
+
+inline void
+bc7_palette(const int endpoints[2][4], const int pbits[2], uint8_t palette[16][4])
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        int e0 = (endpoints[0][c] << 1) | pbits[0];
+        int e1 = (endpoints[1][c] << 1) | pbits[1];
+        for (int i = 0; i < 16; ++i)
+            palette[i][c] = (uint8_t)(((64 - bc7_weights4[i]) * e0 + bc7_weights4[i] * e1 + 32) >> 6);
+    }
+}
+
+inline void
+bc7_evaluate(const bc_block *block, const float e0[4], const float e1[4], const int pbits[2], bc7_candidate *candidate)
+{
+    candidate->pbits[0] = pbits[0];
+    candidate->pbits[1] = pbits[1];
+    for (int c = 0; c < 4; ++c)
+    {
+        candidate->endpoints[0][c] = bc7_quantize(e0[c], pbits[0]);
+        candidate->endpoints[1][c] = bc7_quantize(e1[c], pbits[1]);
+    }
+
+    uint8_t palette_bytes[16][4];
+    bc7_palette(candidate->endpoints, candidate->pbits, palette_bytes);
+    float palette[16][4];
+    for (int p = 0; p < 16; ++p)
+        for (int c = 0; c < 4; ++c)
+            palette[p][c] = (float)palette_bytes[p][c];
+    candidate->error = bc_fit_indices(block->c, 4, palette, 16, candidate->indices);
+}
+
+// p-bit with the smallest quantization error for one endpoint
+inline int
+bc7_best_pbit(const float e[4])
+{
+    float error[2] = {};
+    for (int pbit = 0; pbit < 2; ++pbit)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            float d = (float)((bc7_quantize(e[c], pbit) << 1) | pbit) - e[c];
+            error[pbit] += d * d;
+        }
+    }
+    return error[1] < error[0] ? 1 : 0;
+}
+
+// best p-bits for a pair of endpoints, every combination on high quality
+inline void
+bc7_evaluate_pbits(const bc_block *block, const float e0[4], const float e1[4], bc_quality quality, bc7_candidate *best)
+{
+    if (quality != BC_QUALITY_HIGH)
+    {
+        int pbits[2] = {bc7_best_pbit(e0), bc7_best_pbit(e1)};
+        bc7_evaluate(block, e0, e1, pbits, best);
+        return;
+    }
+
+    best->error = FLT_MAX;
+    for (int combination = 0; combination < 4; ++combination)
+    {
+        int pbits[2] = {combination & 1, combination >> 1};
+        bc7_candidate candidate;
+        bc7_evaluate(block, e0, e1, pbits, &candidate);
+        if (candidate.error < best->error)
+            *best = candidate;
+    }
+}
+
+struct bc_bit_writer
+{
+    uint8_t *out;
+    int position;
+};
+
+inline void
+bc_write_bits(bc_bit_writer *writer, uint32_t value, int count)
+{
+    for (int i = 0; i < count; ++i, ++writer->position)
+        writer->out[writer->position >> 3] |= (uint8_t)(((value >> i) & 1) << (writer->position & 7));
+}
+
+inline void
+bc7_encode(const bc_block *block, bc_quality quality, uint8_t out[16])
+{
+    float mean[4], axis[4], e0[4], e1[4];
+    bc_principal_axis(block, 4, mean, axis);
+    bc_axis_endpoints(block, 4, mean, axis, e0, e1);
+
+    bc7_candidate best;
+    bc7_evaluate_pbits(block, e0, e1, quality, &best);
+
+    float weights[16];
+    for (int i = 0; i < 16; ++i)
+        weights[i] = (float)bc7_weights4[i] / 64.0f;
+
+    int refinements = quality == BC_QUALITY_FAST ? 0 : (quality == BC_QUALITY_NORMAL ? 2 : 6);
+    for (int iteration = 0; iteration < refinements && best.error > 0.0f; ++iteration)
+    {
+        if (bc_least_squares(block, 4, best.indices, weights, e0, e1) == false)
+            break;
+
+        bc7_candidate candidate;
+        bc7_evaluate_pbits(block, e0, e1, quality, &candidate);
+        if (candidate.error >= best.error)
+            break;
+        best = candidate;
+    }
+
+    // the anchor index (pixel 0) has an implicit 0 msb, swap the endpoints if it's set
+    if (best.indices[0] >= 8)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int t = best.endpoints[0][c];
+            best.endpoints[0][c] = best.endpoints[1][c];
+            best.endpoints[1][c] = t;
+        }
+        int t = best.pbits[0];
+        best.pbits[0] = best.pbits[1];
+        best.pbits[1] = t;
+        for (int i = 0; i < 16; ++i)
+            best.indices[i] = (uint8_t)(15 - best.indices[i]);
+    }
+
+    memset(out, 0, 16);
+    bc_bit_writer writer = {out, 0};
+    bc_write_bits(&writer, 1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        bc_write_bits(&writer, (uint32_t)best.endpoints[0][c], 7);
+        bc_write_bits(&writer, (uint32_t)best.endpoints[1][c], 7);
+    }
+    bc_write_bits(&writer, (uint32_t)best.pbits[0], 1);
+    bc_write_bits(&writer, (uint32_t)best.pbits[1], 1);
+    bc_write_bits(&writer, best.indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        bc_write_bits(&writer, best.indices[i], 4);
+}
+
+//
+// images
+//
+
+inline void
+bc_encode_block(bc_format format, bc_quality quality, const bc_block *block, uint8_t *out)
+{
+    switch (format)
+    {
+        case BC_FORMAT_BC1:
+            bc1_encode_color(block, quality, false, out);
+            break;
+        case BC_FORMAT_BC3:
+            bc4_encode(&block->c[3], quality, out);
+            bc1_encode_color(block, quality, true, out + 8);
+            break;
+        case BC_FORMAT_BC7:
+            bc7_encode(block, quality, out);
+            break;
+    }
+}
+
+// out receives bc_level_size(format, width, height) bytes. pool may be null to run on the
+// calling thread only
+inline void
+bc_encode_image(bc_format format, bc_quality quality, const uint8_t *pixels, int width, int height, int pitch, uint8_t *out, thread_pool *pool)
+{
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+    int block_bytes = bc_block_bytes(format);
+    int row_pitch = bc_row_pitch(format, width);
+
+    auto encode_row = [&](int block_y) {
+        for (int block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            bc_block block;
+            bc_load_block(pixels, width, height, pitch, block_x, block_y, &block);
+            bc_encode_block(format, quality, &block, out + (size_t)block_y * row_pitch + (size_t)block_x * block_bytes);
+        }
+    };
+    if (pool)
+        thread_pool_parallel_for(pool, blocks_y, encode_row);
+    else
+        for (int block_y = 0; block_y < blocks_y; ++block_y)
+            encode_row(block_y);
+}
+
+// decodes what the encoder writes, BC7 blocks in other modes than 6 come out as zero
+inline void
+bc_decode_block(bc_format format, const uint8_t *in, uint8_t pixels[16][4])
+{
+    if (format == BC_FORMAT_BC7)
+    {
+        uint64_t lo = 0, hi = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            lo |= (uint64_t)in[i] << (i * 8);
+            hi |= (uint64_t)in[8 + i] << (i * 8);
+        }
+        auto bits = [&](int position, int count) {
+            uint32_t value = 0;
+            for (int i = 0; i < count; ++i, ++position)
+                value |= (uint32_t)(((position < 64 ? lo >> position : hi >> (position - 64)) & 1) << i);
+            return value;
+        };
+
+        memset(pixels, 0, 64);
+        if ((lo & 0x7f) != 0x40)
+            return;
+
+        int endpoints[2][4];
+        for (int c = 0; c < 4; ++c)
+        {
+            endpoints[0][c] = (int)bits(7 + c * 14, 7);
+            endpoints[1][c] = (int)bits(14 + c * 14, 7);
+        }
+        int pbits[2] = {(int)bits(63, 1), (int)bits(64, 1)};
+        uint8_t palette[16][4];
+        bc7_palette(endpoints, pbits, palette);
+        for (int i = 0; i < 16; ++i)
+        {
+            uint32_t index = i == 0 ? bits(65, 3) : bits(68 + (i - 1) * 4, 4);
+            memcpy(pixels[i], palette[index], 4);
+        }
+        return;
+    }
+
+    const uint8_t *color = format == BC_FORMAT_BC3 ? in + 8 : in;
+    uint8_t palette[4][4];
+    uint32_t c0 = color[0] | (color[1] << 8);
+    uint32_t c1 = color[2] | (color[3] << 8);
+    bc1_palette(c0, c1, format == BC_FORMAT_BC3, palette);
+    uint32_t color_bits = color[4] | (color[5] << 8) | (color[6] << 16) | ((uint32_t)color[7] << 24);
+    for (int i = 0; i < 16; ++i)
+        memcpy(pixels[i], palette[(color_bits >> (i * 2)) & 3], 4);
+
+    if (format == BC_FORMAT_BC3)
+    {
+        uint8_t alpha[8];
+        bc4_palette(in[0], in[1], alpha);
+        uint64_t alpha_bits = 0;
+        for (int i = 0; i < 6; ++i)
+            alpha_bits |= (uint64_t)in[2 + i] << (i * 8);
+        for (int i = 0; i < 16; ++i)
+            pixels[i][3] = alpha[(alpha_bits >> (i * 3)) & 7];
+    }
+}
+
+inline void
+bc_decode_image(bc_format format, const uint8_t *blocks, int width, int height, uint8_t *pixels, int pitch)
+{
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+    int block_bytes = bc_block_bytes(format);
+    for (int block_y = 0; block_y < blocks_y; ++block_y)
+    {
+        for (int block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            uint8_t decoded[16][4];
+            bc_decode_block(format, blocks + ((size_t)block_y * blocks_x + block_x) * block_bytes, decoded);
+            for (int y = 0; y < 4 && block_y * 4 + y < height; ++y)
+                for (int x = 0; x < 4 && block_x * 4 + x < width; ++x)
+                    memcpy(pixels + (size_t)(block_y * 4 + y) * pitch + (block_x * 4 + x) * 4, decoded[y * 4 + x], 4);
+        }
+    }
+}
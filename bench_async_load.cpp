@@ -0,0 +1,344 @@
+// startup wall time of a scene's resources loaded the way the examples do it, one blocking
+// step after another, against async_load.h coroutines that start every load up front and
+// await them in order. the scene is a set of synthetic ppm textures (read, decoded and given
+// kaiser mips) and shader permutations compiled through the shader cache by a stub compiler
+// that takes compile_ms each. both paths end with a "create" step on the main thread that
+// hashes every level and bytecode, standing in for the device calls.
+// the images are in the page cache after they are written, so this measures how much of the
+// decode and compile work overlaps, not disk throughput.
+// usage: bench_async_load [-d dir] [-x textures] [-s size] [-n shaders] [-c compile_ms]
+//        [-t max_threads] [-i iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "async_load.h"
+
+#if defined(_WIN32)
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// stub compiler, same idea as bench_shader_cache
+//
+
+static volatile uint64_t stub_sink;
+
+static uint64_t
+stub_work(uint64_t rounds)
+{
+    uint64_t x = 1;
+    for (uint64_t i = 0; i < rounds; ++i)
+        x = x * 6364136223846793005ull + (x >> 29);
+    return x;
+}
+
+static bool
+stub_compile(void *user, const shader_desc *desc, std::vector<uint8_t> *bytecode, std::string *errors)
+{
+    stub_sink = stub_work(*(const uint64_t *)user);
+    uint64_t hash = shader_cache_hash(0xcbf29ce484222325ull, desc->source, desc->source_size);
+    hash = shader_cache_hash_string(hash, desc->entry);
+    for (const shader_define *define = desc->defines; define && define->name; ++define)
+        hash = shader_cache_hash_string(hash, define->definition);
+    bytecode->assign({'D', 'X', 'B', 'C'});
+    for (int i = 0; i < 256; ++i)
+    {
+        hash = hash * 6364136223846793005ull + 1442695040888963407ull;
+        bytecode->push_back((uint8_t)(hash >> 56));
+    }
+    return true;
+}
+
+static const char shader_src[] = R"(
+    float4 vs_main(float3 position : Position) : SV_Position { return float4(position * VARIANT, 1); }
+    float4 ps_main() : SV_Target { return float4(VARIANT, 0, 0, 1); }
+)";
+
+static bool
+generate_images(const char *dir, int count, int size, std::vector<std::string> *paths)
+{
+#if defined(_WIN32)
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+
+    std::vector<uint8_t> rgb((size_t)size * size * 3);
+    for (int i = 0; i < count; ++i)
+    {
+        uint32_t seed = 1234567u + (uint32_t)i;
+        for (size_t p = 0; p < rgb.size(); p += 3)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            size_t x = p / 3 % (size_t)size;
+            rgb[p + 0] = (uint8_t)(x * 255 / (size_t)size);
+            rgb[p + 1] = (uint8_t)(seed >> 24);
+            rgb[p + 2] = (uint8_t)(i * 53);
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/async_%04d.ppm", dir, i);
+        FILE *file = fopen(path, "wb");
+        if (file == nullptr)
+            return false;
+        fprintf(file, "P6 %d %d 255\n", size, size);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        if (fclose(file) != 0 || ok == false)
+            return false;
+        paths->push_back(path);
+    }
+    return true;
+}
+
+struct scene
+{
+    std::vector<texture_stream_image *> images;
+    std::vector<shader_result> shaders;
+    uint64_t hash;
+    bool created_on_main;
+};
+
+static std::thread::id main_thread;
+
+// stands in for CreateTexture2D and Create*Shader
+static bool
+create_resources(scene *s)
+{
+    s->created_on_main = std::this_thread::get_id() == main_thread;
+    uint64_t hash = 14695981039346656037ull;
+    for (const texture_stream_image *image : s->images)
+    {
+        if (image == nullptr)
+            return false;
+        for (int level = 0; level < image->level_count; ++level)
+            hash = shader_cache_hash(hash, image->levels[level].data, (size_t)image->levels[level].size);
+    }
+    for (const shader_result &shader : s->shaders)
+    {
+        if (shader.ok == false)
+            return false;
+        hash = shader_cache_hash(hash, shader.bytecode.data(), shader.bytecode.size());
+    }
+    s->hash = hash;
+    return true;
+}
+
+static void
+free_scene(scene *s)
+{
+    for (texture_stream_image *image : s->images)
+    {
+        if (image)
+            texture_stream_image_free(image);
+    }
+    s->images.clear();
+    s->shaders.clear();
+}
+
+// what the examples do today
+static bool
+load_serial(scene *s, const std::vector<std::string> &paths, shader_cache *cache, const std::vector<shader_desc> &descs)
+{
+    for (const std::string &path : paths)
+    {
+        texture_stream_image *image = new texture_stream_image();
+        if (texture_stream_load_image(image, path.c_str(), false) == false)
+        {
+            texture_stream_image_free(image);
+            image = nullptr;
+        }
+        s->images.push_back(image);
+    }
+    for (const shader_desc &desc : descs)
+    {
+        shader_result result;
+        shader_cache_compile(cache, &desc, &result);
+        s->shaders.push_back(std::move(result));
+    }
+    return create_resources(s);
+}
+
+// the same, written as a coroutine. every load starts before the first one is awaited
+static load_task<bool>
+load_async(load_context *ctx, scene *s, const std::vector<std::string> *paths, shader_cache *cache, const std::vector<shader_desc> *descs)
+{
+    std::vector<load_task<texture_stream_image *>> textures;
+    for (const std::string &path : *paths)
+        textures.push_back(load_texture(ctx, path.c_str()));
+    std::vector<load_task<shader_result>> shaders;
+    for (const shader_desc &desc : *descs)
+        shaders.push_back(load_shader(ctx, cache, &desc));
+
+    for (load_task<texture_stream_image *> &texture : textures)
+        s->images.push_back(co_await texture);
+    for (load_task<shader_result> &shader : shaders)
+        s->shaders.push_back(co_await shader);
+
+    co_await load_on_main(ctx);
+    co_return create_resources(s);
+}
+
+// a missing file fails the read and the texture without taking anything else down
+static load_task<bool>
+load_missing(load_context *ctx)
+{
+    std::vector<uint8_t> data;
+    bool read = co_await load_read_file(ctx, "does/not/exist.ppm", &data);
+    texture_stream_image *image = co_await load_texture(ctx, "does/not/exist.ppm");
+    co_return read == false && image == nullptr;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *dir = "async_load_bench";
+    int texture_count = 24;
+    int texture_size = 1024;
+    int shader_count = 32;
+    double compile_ms = 10.0;
+    int max_threads = 8;
+    int iterations = 3;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+            dir = argv[i + 1];
+        else if (strcmp(argv[i], "-x") == 0)
+            texture_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            texture_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            shader_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            compile_ms = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            max_threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-i") == 0)
+            iterations = atoi(argv[i + 1]);
+    }
+    main_thread = std::this_thread::get_id();
+
+    std::vector<std::string> paths;
+    if (generate_images(dir, texture_count, texture_size, &paths) == false)
+    {
+        printf("Failed to write images to %s\n", dir);
+        return 1;
+    }
+
+    // rounds per millisecond, measured on this thread
+    uint64_t rounds = 1 << 20;
+    {
+        double start = now_seconds();
+        stub_sink = stub_work(rounds);
+        double ms = (now_seconds() - start) * 1000.0;
+        rounds = (uint64_t)((double)rounds * compile_ms / ms);
+    }
+    shader_compiler compiler = {};
+    compiler.name = "stub";
+    compiler.version = 1;
+    compiler.compile = stub_compile;
+    compiler.user = &rounds;
+
+    std::vector<std::string> variants(shader_count);
+    std::vector<shader_define> defines((size_t)shader_count * 2);
+    std::vector<shader_desc> descs;
+    for (int i = 0; i < shader_count; ++i)
+    {
+        variants[i] = std::to_string(i);
+        defines[(size_t)i * 2] = {"VARIANT", variants[i].c_str()};
+        defines[(size_t)i * 2 + 1] = {nullptr, nullptr};
+        descs.push_back({"shader_src", shader_src, sizeof(shader_src), i & 1 ? "ps_main" : "vs_main", i & 1 ? "ps_5_0" : "vs_5_0",
+            &defines[(size_t)i * 2], 0});
+    }
+
+    mip_decode_table();
+    mip_decode16_table();
+    mip_encode_table();
+
+    printf("%d textures of %dx%d, %d shaders at %.1f ms, %u cores, best of %d\n", texture_count, texture_size, texture_size,
+        shader_count, compile_ms, std::thread::hardware_concurrency(), iterations);
+    printf("%-30s %10s %9s\n", "", "ms", "speedup");
+
+    // a memory only cache that starts empty every time, every shader compiles
+    bool ok = true;
+    uint64_t reference_hash = 0;
+    double serial_ms = 0.0;
+    {
+        double best = 1e30;
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            shader_cache cache;
+            shader_cache_init(&cache, nullptr, compiler);
+            scene s;
+            double start = now_seconds();
+            ok &= load_serial(&s, paths, &cache, descs);
+            double ms = (now_seconds() - start) * 1000.0;
+            best = ms < best ? ms : best;
+            reference_hash = s.hash;
+            ok &= s.created_on_main;
+            free_scene(&s);
+        }
+        serial_ms = best;
+        printf("%-30s %10.1f %8.2fx\n", "serial", serial_ms, 1.0);
+    }
+
+    for (int use_ring = 1; use_ring >= 0; --use_ring)
+    {
+        for (int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            thread_pool pool;
+            thread_pool_init(&pool, threads);
+            load_context ctx;
+            load_context_init(&ctx, &pool, use_ring != 0);
+            if (use_ring && load_context_uses_ring(&ctx) == false)
+            {
+                load_context_shutdown(&ctx);
+                thread_pool_shutdown(&pool);
+                printf("io_uring unavailable, reads run on the pool\n");
+                break;
+            }
+
+            double best = 1e30;
+            for (int iteration = 0; iteration < iterations; ++iteration)
+            {
+                shader_cache cache;
+                shader_cache_init(&cache, nullptr, compiler);
+                scene s;
+                double start = now_seconds();
+                bool loaded = load_wait(&ctx, load_async(&ctx, &s, &paths, &cache, &descs));
+                double ms = (now_seconds() - start) * 1000.0;
+                best = ms < best ? ms : best;
+                ok &= loaded && s.hash == reference_hash && s.created_on_main;
+                free_scene(&s);
+            }
+            ok &= load_wait(&ctx, load_missing(&ctx));
+
+            char name[64];
+            snprintf(name, sizeof(name), "async, %s, %d threads", use_ring ? "io_uring" : "pool reads", threads);
+            printf("%-30s %10.1f %8.2fx\n", name, best, serial_ms / best);
+
+            load_context_shutdown(&ctx);
+            thread_pool_shutdown(&pool);
+        }
+    }
+
+    for (const std::string &path : paths)
+        remove(path.c_str());
+
+    printf("async load checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+// encodes an image to BC1, BC3 and BC7 at every quality preset and reports encode speed and
+// PSNR against the source, usage: bench_bc [-i image.ppm] [-s size] [-t threads]
+// without -i a synthetic rgba image with gradients, noise, hard edges and an alpha ramp is used
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "bc_encode.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// binary P6 with maxval 255, like the ones headless_cubes writes
+static bool
+read_ppm(const char *path, std::vector<uint8_t> *pixels, int *width, int *height)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    int max_value = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", width, height, &max_value) == 3 && max_value == 255 && fgetc(file) != EOF;
+    if (ok)
+    {
+        std::vector<uint8_t> rgb((size_t)*width * *height * 3);
+        ok = fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        pixels->resize((size_t)*width * *height * 4);
+        for (size_t i = 0; ok && i < (size_t)*width * *height; ++i)
+        {
+            memcpy(&(*pixels)[i * 4], &rgb[i * 3], 3);
+            (*pixels)[i * 4 + 3] = 255;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+static void
+fill_image(std::vector<uint8_t> *pixels, int size)
+{
+    pixels->resize((size_t)size * size * 4);
+    uint32_t seed = 1234567;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint8_t *p = &(*pixels)[((size_t)y * size + x) * 4];
+            seed = seed * 1664525u + 1013904223u;
+            int noise = (int)(seed >> 27) - 16;
+
+            // smooth gradients in the top half, a checker of saturated colors with a soft
+            // noise overlay in the bottom half
+            int r, g, b;
+            if (y < size / 2)
+            {
+                r = x * 255 / size;
+                g = y * 510 / size;
+                b = 255 - (x + y) * 255 / (size + size / 2);
+            }
+            else
+            {
+                int cell = ((x / 24) + (y / 24)) % 3;
+                r = cell == 0 ? 230 : 20;
+                g = cell == 1 ? 200 : 40;
+                b = cell == 2 ? 220 : 60;
+                r += noise;
+                g += noise;
+                b += noise;
+            }
+            p[0] = (uint8_t)(r < 0 ? 0 : (r > 255 ? 255 : r));
+            p[1] = (uint8_t)(g < 0 ? 0 : (g > 255 ? 255 : g));
+            p[2] = (uint8_t)(b < 0 ? 0 : (b > 255 ? 255 : b));
+            p[3] = (uint8_t)((x * 7 / size) * 255 / 6);
+        }
+    }
+}
+
+static double
+psnr(const uint8_t *a, const uint8_t *b, size_t pixel_count, int first_channel, int channel_count)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < pixel_count; ++i)
+    {
+        for (int c = first_channel; c < first_channel + channel_count; ++c)
+        {
+            double d = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / ((double)pixel_count * channel_count);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    int size = 2048;
+    int threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-i") == 0)
+            path = argv[i + 1];
+        else if (strcmp(argv[i], "-s") == 0)
+            size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+    }
+
+    std::vector<uint8_t> pixels;
+    int width = size;
+    int height = size;
+    if (path)
+    {
+        if (read_ppm(path, &pixels, &width, &height) == false)
+        {
+            fprintf(stderr, "Failed to read %s\n", path);
+            return 1;
+        }
+    }
+    else
+    {
+        fill_image(&pixels, size);
+    }
+
+    // BC1 is measured on an opaque copy, the 1 bit alpha would dominate its PSNR otherwise
+    std::vector<uint8_t> opaque = pixels;
+    for (size_t i = 3; i < opaque.size(); i += 4)
+        opaque[i] = 255;
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    size_t pixel_count = (size_t)width * height;
+    double megabytes = (double)pixel_count * 4.0 / (1024.0 * 1024.0);
+    printf("%s %dx%d, simd path: %s, %d threads\n", path ? path : "synthetic", width, height, SIMD_MATH_NAME, thread_pool_size(&pool));
+    printf("%-6s %-8s %10s %10s %10s %10s\n", "format", "quality", "ms", "MB/s", "rgb PSNR", "a PSNR");
+
+    const char *format_names[] = {"BC1", "BC3", "BC7"};
+    const char *quality_names[] = {"fast", "normal", "high"};
+    std::vector<uint8_t> decoded(pixel_count * 4);
+    for (int f = 0; f < 3; ++f)
+    {
+        bc_format format = (bc_format)f;
+        const std::vector<uint8_t> &source = format == BC_FORMAT_BC1 ? opaque : pixels;
+        std::vector<uint8_t> blocks(bc_level_size(format, width, height));
+
+        for (int q = 0; q < 3; ++q)
+        {
+            bc_quality quality = (bc_quality)q;
+            double start = now_seconds();
+            bc_encode_image(format, quality, source.data(), width, height, width * 4, blocks.data(), &pool);
+            double seconds = now_seconds() - start;
+
+            bc_decode_image(format, blocks.data(), width, height, decoded.data(), width * 4);
+            double rgb_psnr = psnr(source.data(), decoded.data(), pixel_count, 0, 3);
+            if (format == BC_FORMAT_BC1)
+            {
+                printf("%-6s %-8s %10.1f %10.1f %10.2f %10s\n", format_names[f], quality_names[q],
+                    seconds * 1000.0, megabytes / seconds, rgb_psnr, "-");
+            }
+            else
+            {
+                double alpha_psnr = psnr(source.data(), decoded.data(), pixel_count, 3, 1);
+                printf("%-6s %-8s %10.1f %10.1f %10.2f %10.2f\n", format_names[f], quality_names[q],
+                    seconds * 1000.0, megabytes / seconds, rgb_psnr, alpha_psnr);
+            }
+        }
+    }
+
+    thread_pool_shutdown(&pool);
+    return 0;
+}
@@ -0,0 +1,213 @@
+// builds a bvh (bvh.h) over fields of 1k up to 1M boxes, then refits it after the boxes
+// spun in place like the example_cubes cubes, on one thread and on the pool. every tree is
+// culled against a camera frustum next to the flat SIMD culling of frustum_cull.h, the visible
+// sets have to match, and picks rays from the camera, checked against testing every box.
+// usage: bench_bvh [-m max objects] [-r rays] [-t threads] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "bvh.h"
+#include "frustum_cull.h"
+#include "simd_math.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static float
+random_range(uint64_t *state, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(next_random(state) & 0xffffff) / (float)0xffffff;
+}
+
+// cubes of half size `size` spinning around all three axes like example_cubes, the box of a
+// rotated cube reaches size * sum |r_ij| along axis j
+static void
+spin_boxes(frustum_bounds *boxes, const std::vector<float> &size, const std::vector<float> &speed, float angle)
+{
+    for (size_t i = 0; i < boxes->count; ++i)
+    {
+        float a = angle * speed[i];
+        float f[16];
+        mat4_store(f, mat4_rotation_x(a) * mat4_rotation_y(a) * mat4_rotation_z(a));
+        for (int axis = 0; axis < 3; ++axis)
+            frustum_bounds_stream(boxes, axis + 3)[i] = size[i] * (fabsf(f[0 * 4 + axis]) + fabsf(f[1 * 4 + axis]) + fabsf(f[2 * 4 + axis]));
+    }
+}
+
+// nearest box along the ray by testing all of them
+static bvh_ray_hit
+raycast_all(const frustum_bounds *boxes, const float origin[3], const float dir[3], float max_t)
+{
+    float inv_dir[3];
+    for (int axis = 0; axis < 3; ++axis)
+        inv_dir[axis] = fabsf(dir[axis]) > 1e-20f ? 1.0f / dir[axis] : (dir[axis] < 0.0f ? -1e20f : 1e20f);
+
+    bvh_ray_hit hit = {BVH_NONE, max_t};
+    for (size_t i = 0; i < boxes->count; ++i)
+    {
+        float min[3], max[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float c = frustum_bounds_stream(boxes, axis)[i];
+            float e = frustum_bounds_stream(boxes, axis + 3)[i];
+            min[axis] = c - e;
+            max[axis] = c + e;
+        }
+        float t;
+        if (bvh_ray_box(origin, inv_dir, min, max, hit.t, &t) && (t < hit.t || hit.object == BVH_NONE))
+        {
+            hit.t = t;
+            hit.object = (uint32_t)i;
+        }
+    }
+    return hit;
+}
+
+int
+main(int argc, char **argv)
+{
+    int max_objects = 1000000;
+    int ray_count = 10000;
+    int threads = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-m") == 0)
+            max_objects = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            ray_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            seed = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    printf("%d rays, %d threads, ms unless noted\n", ray_count, thread_pool_size(&pool));
+    printf("%-10s %9s %9s %9s %9s %9s %9s %11s %7s %11s\n", "objects", "build", "refit 1t", "refit", "cull flat", "cull bvh",
+        "visible", "rays/ms", "hits", "brute/ms");
+
+    bool ok = true;
+    for (int object_count = 1000; object_count <= max_objects; object_count *= 10)
+    {
+        // density stays the same at every size, about one object in a hundred is in view
+        uint64_t state = seed;
+        float half_size = 4.0f * cbrtf((float)object_count);
+        frustum_bounds boxes;
+        if (frustum_bounds_init(&boxes, object_count, FRUSTUM_AABB_STREAMS) == false)
+        {
+            fprintf(stderr, "Failed to allocate %d boxes\n", object_count);
+            return 1;
+        }
+        std::vector<float> size(object_count), speed(object_count);
+        for (int i = 0; i < object_count; ++i)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+                frustum_bounds_stream(&boxes, axis)[i] = random_range(&state, -half_size, half_size);
+            size[i] = random_range(&state, 0.25f, 1.0f);
+            speed[i] = random_range(&state, 0.5f, 2.0f);
+        }
+        spin_boxes(&boxes, size, speed, 0.0f);
+
+        bvh tree = {};
+        double start = now_seconds();
+        if (bvh_build(&tree, &boxes) == false)
+        {
+            fprintf(stderr, "Failed to build a bvh over %d boxes\n", object_count);
+            return 1;
+        }
+        double build_ms = (now_seconds() - start) * 1000.0;
+
+        // spin the cubes a second further, once refit on this thread and once on the pool
+        spin_boxes(&boxes, size, speed, 1.0f);
+        start = now_seconds();
+        bvh_refit(&tree, &boxes, nullptr);
+        double refit_serial_ms = (now_seconds() - start) * 1000.0;
+
+        spin_boxes(&boxes, size, speed, 2.0f);
+        start = now_seconds();
+        bvh_refit(&tree, &boxes, &pool);
+        double refit_ms = (now_seconds() - start) * 1000.0;
+
+        // camera at the center of the field looking down z
+        float far_z = half_size * 0.5f;
+        frustum f = frustum_from_matrix(mat4_perspective_fov_lh(simd_radians(60.0f), 16.0f / 9.0f, 0.1f, far_z));
+        std::vector<uint32_t> flat(object_count), hierarchical(object_count);
+
+        int cull_repeats = object_count < 100000 ? 100 : 5;
+        uint32_t flat_count = 0, bvh_count = 0;
+        start = now_seconds();
+        for (int repeat = 0; repeat < cull_repeats; ++repeat)
+            flat_count = frustum_cull_aabbs(&f, &boxes, 0, object_count, flat.data());
+        double cull_flat_ms = (now_seconds() - start) * 1000.0 / cull_repeats;
+
+        start = now_seconds();
+        for (int repeat = 0; repeat < cull_repeats; ++repeat)
+            bvh_count = bvh_cull(&tree, &f, hierarchical.data());
+        double cull_bvh_ms = (now_seconds() - start) * 1000.0 / cull_repeats;
+
+        std::sort(hierarchical.begin(), hierarchical.begin() + bvh_count);
+        bool same_visible = flat_count == bvh_count && memcmp(flat.data(), hierarchical.data(), flat_count * sizeof(uint32_t)) == 0;
+        ok = ok && same_visible;
+
+        // rays from the camera into the field, a few of them checked against every box
+        std::vector<float> directions((size_t)ray_count * 3);
+        for (int i = 0; i < ray_count; ++i)
+        {
+            float d[3] = {random_range(&state, -0.5f, 0.5f), random_range(&state, -0.3f, 0.3f), 1.0f};
+            float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            for (int axis = 0; axis < 3; ++axis)
+                directions[(size_t)i * 3 + axis] = d[axis] / length;
+        }
+
+        float origin[3] = {0.0f, 0.0f, 0.0f};
+        int hits = 0;
+        start = now_seconds();
+        for (int i = 0; i < ray_count; ++i)
+            hits += bvh_raycast(&tree, origin, &directions[(size_t)i * 3], far_z).object != BVH_NONE;
+        double ray_seconds = now_seconds() - start;
+
+        int checked = ray_count < 100 ? ray_count : 100;
+        bool same_hits = true;
+        start = now_seconds();
+        for (int i = 0; i < checked; ++i)
+        {
+            bvh_ray_hit a = bvh_raycast(&tree, origin, &directions[(size_t)i * 3], far_z);
+            bvh_ray_hit b = raycast_all(&boxes, origin, &directions[(size_t)i * 3], far_z);
+            // two boxes can be entered at the same t
+            same_hits = same_hits && (a.object == b.object || (a.object != BVH_NONE && b.object != BVH_NONE && a.t == b.t));
+        }
+        double brute_seconds = now_seconds() - start;
+        ok = ok && same_hits;
+
+        printf("%-10d %9.2f %9.3f %9.3f %9.3f %9.3f %9u %11.0f %7d %11.1f%s%s\n", object_count, build_ms, refit_serial_ms, refit_ms,
+            cull_flat_ms, cull_bvh_ms, bvh_count, ray_count / (ray_seconds * 1000.0), hits, checked / (brute_seconds * 1000.0),
+            same_visible ? "" : "  visible sets DIFFER", same_hits ? "" : "  ray hits DIFFER");
+
+        bvh_free(&tree);
+        frustum_bounds_free(&boxes);
+    }
+
+    thread_pool_shutdown(&pool);
+
+    printf("bvh checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
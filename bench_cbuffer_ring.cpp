@@ -0,0 +1,167 @@
+// runs cbuffer_ring.h against a mock device whose gpu trails the cpu by a few frames,
+// checks that no in flight region is ever overwritten and reports throughput, bytes/frame,
+// wraps and stalls. usage: bench_cbuffer_ring [-f frames] [-d draws per frame] [-l gpu latency]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "cbuffer_ring.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the gpu finishes a frame `latency` frames after it was submitted, or when the cpu waits on it
+struct mock_device
+{
+    std::vector<uint8_t> memory;
+    // fence of the frame that last wrote each CBUFFER_RING_ALIGNMENT block
+    std::vector<uint64_t> block_fences;
+    uint64_t signaled;
+    uint64_t completed;
+    uint64_t latency;
+    uint64_t waits;
+    uint64_t violations;
+};
+
+static uint64_t
+mock_signal_fence(void *user)
+{
+    mock_device *device = (mock_device *)user;
+    device->signaled++;
+    if (device->signaled > device->latency && device->signaled - device->latency > device->completed)
+        device->completed = device->signaled - device->latency;
+    return device->signaled;
+}
+
+static uint64_t
+mock_completed_fence(void *user)
+{
+    return ((mock_device *)user)->completed;
+}
+
+static void
+mock_wait_fence(void *user, uint64_t fence)
+{
+    mock_device *device = (mock_device *)user;
+    device->waits++;
+    if (fence > device->completed)
+        device->completed = fence;
+}
+
+static void *
+mock_map(void *user, uint32_t offset, uint32_t size)
+{
+    mock_device *device = (mock_device *)user;
+
+    // everything written now is covered by the next fence, the old owner must be done
+    uint32_t first = offset / CBUFFER_RING_ALIGNMENT;
+    uint32_t last = (offset + size - 1) / CBUFFER_RING_ALIGNMENT;
+    for (uint32_t block = first; block <= last; ++block)
+    {
+        if (device->block_fences[block] > device->completed)
+            device->violations++;
+        device->block_fences[block] = device->signaled + 1;
+    }
+    return device->memory.data() + offset;
+}
+
+static void
+mock_unmap(void *user)
+{
+}
+
+int
+main(int argc, char **argv)
+{
+    int frames = 2000;
+    int draws_per_frame = 10000;
+    int latency = 2;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            draws_per_frame = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-l") == 0)
+            latency = atoi(argv[i + 1]);
+    }
+
+    // per draw payload, mvp plus a color index like example_instancing's per draw path
+    struct draw_constants
+    {
+        float mvp[16];
+        uint32_t color;
+    };
+
+    // ring sizes in frames worth of data, below latency + 1 frames the cpu has to stall
+    float ring_frames[] = {1.5f, 2.5f, 3.5f, 6.0f};
+
+    printf("%d frames, %d draws/frame, gpu latency %d frames, %d byte payload\n",
+        frames, draws_per_frame, latency, (int)sizeof(draw_constants));
+    printf("%10s %10s %12s %12s %8s %8s %8s %10s\n",
+        "ring KB", "ns/alloc", "KB/frame", "peak KB", "wraps", "stalls", "fails", "violations");
+
+    bool ok = true;
+    for (float ring_frame : ring_frames)
+    {
+        uint32_t ring_size = (uint32_t)(ring_frame * draws_per_frame * cbuffer_ring_align((uint32_t)sizeof(draw_constants)));
+
+        mock_device device = {};
+        device.memory.resize(ring_size);
+        device.block_fences.resize(ring_size / CBUFFER_RING_ALIGNMENT + 1);
+        device.latency = (uint64_t)latency;
+
+        cbuffer_ring_backend backend = {};
+        backend.user = &device;
+        backend.signal_fence = mock_signal_fence;
+        backend.completed_fence = mock_completed_fence;
+        backend.wait_fence = mock_wait_fence;
+        backend.map = mock_map;
+        backend.unmap = mock_unmap;
+
+        cbuffer_ring ring;
+        cbuffer_ring_init(&ring, ring_size, &backend);
+
+        draw_constants constants = {};
+        double start = now_seconds();
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            cbuffer_ring_begin_frame(&ring);
+
+            // vary the draw count so the head lands on different offsets every frame
+            int draws = draws_per_frame - draws_per_frame / 8 + (frame * 7919) % (draws_per_frame / 4 + 1);
+            for (int draw = 0; draw < draws; ++draw)
+            {
+                constants.color = (uint32_t)draw;
+                cbuffer_ring_allocation allocation;
+                cbuffer_ring_write(&ring, &constants, (uint32_t)sizeof(constants), &allocation);
+            }
+
+            cbuffer_ring_end_frame(&ring);
+        }
+        double seconds = now_seconds() - start;
+
+        const cbuffer_ring_stats *stats = &ring.stats;
+        printf("%10u %10.2f %12.1f %12.1f %8llu %8llu %8llu %10llu\n",
+            ring_size / 1024,
+            seconds * 1e9 / (double)stats->allocations,
+            (double)stats->bytes / stats->frames / 1024.0,
+            (double)stats->peak_frame_bytes / 1024.0,
+            (unsigned long long)stats->wraps,
+            (unsigned long long)stats->stalls,
+            (unsigned long long)stats->failures,
+            (unsigned long long)device.violations);
+
+        ok &= device.violations == 0;
+    }
+
+    printf("%s\n", ok ? "no in flight region was overwritten" : "IN FLIGHT REGIONS WERE OVERWRITTEN");
+    return ok ? 0 : 1;
+}
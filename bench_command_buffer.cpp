@@ -0,0 +1,563 @@
+// records the example_cubes frame scaled up to tens of thousands of draws into command buffers
+// (command_buffer.h) on 1 to n threads and replays them in order on one thread. each buffer
+// holds a fixed run of draws and binds the state it needs, draws switch material every 16
+// draws and write their transform inline. reports recording time and speedup per thread
+// count, the stream size per draw, and the replay cost on the null device through the state
+// cache next to issuing the same frame straight on the cache.
+// checks that every thread count records the same bytes, that the replay leaves the null
+// device exactly where the immediate frame does, and that a smaller frame recorded in
+// parallel and replayed on the software rasterizer matches drawing it straight, pixel for pixel.
+// usage: bench_command_buffer [-f frames] [-d draws per frame] [-t max threads] [-c draws per buffer]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "command_buffer.h"
+#include "simd_math.h"
+#include "state_cache_null.h"
+#include "state_cache_sw.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ring_device
+{
+    null_device *device;
+    null_handle buffer;
+};
+
+static uint64_t
+ring_signal_fence(void *user)
+{
+    return null_signal_fence(((ring_device *)user)->device);
+}
+
+static uint64_t
+ring_completed_fence(void *user)
+{
+    return null_completed_fence(((ring_device *)user)->device);
+}
+
+static void
+ring_wait_fence(void *user, uint64_t fence)
+{
+    null_wait_fence(((ring_device *)user)->device, fence);
+}
+
+static void *
+ring_map(void *user, uint32_t offset, uint32_t size)
+{
+    ring_device *ring = (ring_device *)user;
+    uint8_t *memory = (uint8_t *)null_map(ring->device, ring->buffer, NULL_MAP_WRITE_NO_OVERWRITE);
+    return memory ? memory + offset : nullptr;
+}
+
+static void
+ring_unmap(void *user)
+{
+    ring_device *ring = (ring_device *)user;
+    null_unmap(ring->device, ring->buffer);
+}
+
+static const float cube_vertices[] = {
+    -1.0f, -1.0f, -1.0f,
+     1.0f, -1.0f, -1.0f,
+    -1.0f,  1.0f, -1.0f,
+     1.0f,  1.0f, -1.0f,
+    -1.0f, -1.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f
+};
+
+static const uint32_t cube_indices[] = {
+    0, 2, 3,  0, 3, 1,
+    1, 3, 7,  1, 7, 5,
+    5, 7, 6,  5, 6, 4,
+    4, 6, 2,  4, 2, 0,
+    2, 6, 7,  2, 7, 3,
+    0, 1, 5,  0, 5, 4
+};
+
+static const float cube_colors[24] = {
+    1.0f, 0.0f, 0.0f, 1.0f,
+    0.0f, 1.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 0.0f, 1.0f,
+    0.0f, 1.0f, 1.0f, 1.0f,
+    1.0f, 0.0f, 1.0f, 1.0f
+};
+
+#define MATERIAL_COUNT 4
+#define MATERIAL_DRAWS 16
+
+// every object as the pointer the cache and the command buffers see
+struct scene
+{
+    void *render_target;
+    void *depth_stencil;
+    void *depth_state;
+    state_cache_viewport viewport;
+    void *layout;
+    void *vertex_buffer;
+    void *index_buffer;
+    void *vs;
+    void *colors_buffer;
+    void *sampler;
+
+    // pixel shader, albedo and normal map
+    void *material_ps[MATERIAL_COUNT];
+    void *material_views[MATERIAL_COUNT][2];
+};
+
+static void
+scene_init_null(null_device *device, scene *s)
+{
+    s->render_target = state_cache_null_object(null_create_render_target_view(device, 1280, 720));
+    s->depth_stencil = state_cache_null_object(null_create_depth_stencil_view(device, 1280, 720));
+    s->depth_state = state_cache_null_object(null_create_depth_stencil_state(device));
+    s->viewport = {0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f};
+
+    null_input_element elements[] = {{0, 0, 12, false}};
+    s->layout = state_cache_null_object(null_create_input_layout(device, elements, 1));
+    s->vertex_buffer = state_cache_null_object(
+        null_create_buffer(device, sizeof(cube_vertices), NULL_USAGE_IMMUTABLE, NULL_BIND_VERTEX_BUFFER, cube_vertices));
+    s->index_buffer = state_cache_null_object(
+        null_create_buffer(device, sizeof(cube_indices), NULL_USAGE_IMMUTABLE, NULL_BIND_INDEX_BUFFER, cube_indices));
+    null_shader_desc vs_desc = {};
+    vs_desc.constant_buffer_sizes[0] = sizeof(mat4);
+    s->vs = state_cache_null_object(null_create_vertex_shader(device, &vs_desc));
+    s->colors_buffer = state_cache_null_object(
+        null_create_buffer(device, sizeof(cube_colors), NULL_USAGE_IMMUTABLE, NULL_BIND_CONSTANT_BUFFER, cube_colors));
+    s->sampler = state_cache_null_object(null_create_sampler_state(device));
+
+    null_shader_desc ps_desc = {};
+    ps_desc.constant_buffer_sizes[0] = sizeof(cube_colors);
+    ps_desc.resource_mask = 0x3;
+    ps_desc.sampler_mask = 0x1;
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+    {
+        s->material_ps[i] = state_cache_null_object(null_create_pixel_shader(device, &ps_desc));
+        s->material_views[i][0] = state_cache_null_object(null_create_shader_resource_view(device, 512, 512));
+        s->material_views[i][1] = state_cache_null_object(null_create_shader_resource_view(device, 512, 512));
+    }
+}
+
+// the transform of draw i, a 64 x 64 grid of cubes repeated in depth
+static mat4
+draw_transform(int i, const mat4 &rotation, const mat4 &proj)
+{
+    float x = (float)(i % 64) - 32.0f;
+    float y = (float)(i / 64 % 64) - 32.0f;
+    float z = 40.0f + (float)(i / 4096) * 4.0f;
+    return mat4_transpose(rotation * mat4_translation(x, y, z) * proj);
+}
+
+// draws [first, end) of the frame into cb, starting with everything they need bound
+static void
+record_draws(command_buffer *cb, const scene *s, int first, int end, const mat4 &rotation, const mat4 &proj)
+{
+    command_buffer_ia_set_input_layout(cb, s->layout);
+    command_buffer_ia_set_primitive_topology(cb, NULL_TOPOLOGY_TRIANGLELIST);
+    command_buffer_ia_set_vertex_buffer(cb, 0, s->vertex_buffer, sizeof(float) * 3, 0);
+    command_buffer_ia_set_index_buffer(cb, s->index_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+    command_buffer_vs_set_shader(cb, s->vs);
+    command_buffer_ps_set_constant_buffer(cb, 0, s->colors_buffer);
+    command_buffer_ps_set_sampler(cb, 0, s->sampler);
+    command_buffer_rs_set_viewports(cb, 1, &s->viewport);
+    command_buffer_om_set_render_target(cb, 0, s->render_target);
+    command_buffer_om_set_depth_stencil_view(cb, s->depth_stencil);
+    command_buffer_om_set_depth_stencil_state(cb, s->depth_state, 1);
+
+    for (int i = first; i < end; ++i)
+    {
+        if (i == first || i % MATERIAL_DRAWS == 0)
+        {
+            int material = i / MATERIAL_DRAWS % MATERIAL_COUNT;
+            command_buffer_ps_set_shader(cb, s->material_ps[material]);
+            command_buffer_ps_set_shader_resource(cb, 0, s->material_views[material][0]);
+            command_buffer_ps_set_shader_resource(cb, 1, s->material_views[material][1]);
+        }
+
+        mat4 mvp = draw_transform(i, rotation, proj);
+        command_buffer_vs_set_constants(cb, 0, &mvp, sizeof(mvp));
+        command_buffer_draw_indexed(cb, 36, 0, 0);
+    }
+}
+
+// the same frame issued straight on the cache, constants written to the ring as they come
+static void
+issue_draws(state_cache *cache, command_buffer_ring *ring, const scene *s, int draws, const mat4 &rotation, const mat4 &proj)
+{
+    state_cache_ia_set_input_layout(cache, s->layout);
+    state_cache_ia_set_primitive_topology(cache, NULL_TOPOLOGY_TRIANGLELIST);
+    state_cache_ia_set_vertex_buffer(cache, 0, s->vertex_buffer, sizeof(float) * 3, 0);
+    state_cache_ia_set_index_buffer(cache, s->index_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+    state_cache_vs_set_shader(cache, s->vs);
+    state_cache_ps_set_constant_buffer(cache, 0, s->colors_buffer);
+    state_cache_ps_set_sampler(cache, 0, s->sampler);
+    state_cache_rs_set_viewports(cache, 1, &s->viewport);
+    state_cache_om_set_render_target(cache, 0, s->render_target);
+    state_cache_om_set_depth_stencil_view(cache, s->depth_stencil);
+    state_cache_om_set_depth_stencil_state(cache, s->depth_state, 1);
+
+    for (int i = 0; i < draws; ++i)
+    {
+        if (i % MATERIAL_DRAWS == 0)
+        {
+            int material = i / MATERIAL_DRAWS % MATERIAL_COUNT;
+            state_cache_ps_set_shader(cache, s->material_ps[material]);
+            state_cache_ps_set_shader_resource(cache, 0, s->material_views[material][0]);
+            state_cache_ps_set_shader_resource(cache, 1, s->material_views[material][1]);
+        }
+
+        mat4 mvp = draw_transform(i, rotation, proj);
+        uint32_t first_constant = 0;
+        uint32_t constant_count = 0;
+        void *buffer = command_buffer_ring_upload(ring, &mvp, sizeof(mvp), &first_constant, &constant_count);
+        state_cache_vs_set_constant_buffer(cache, 0, buffer, first_constant, constant_count);
+        state_cache_draw_indexed(cache, 36, 0, 0);
+    }
+}
+
+static mat4
+frame_rotation(int frame)
+{
+    float angle = (float)frame * 0.01f;
+    return mat4_rotation_x(angle) * mat4_rotation_y(angle) * mat4_rotation_z(angle);
+}
+
+// records every buffer of a frame, buffer i holds draws [i * buffer_draws, (i + 1) * buffer_draws)
+static void
+record_frame(thread_pool *pool, std::vector<command_buffer> *buffers, const scene *s, int draws, int buffer_draws, const mat4 &rotation,
+    const mat4 &proj)
+{
+    thread_pool_parallel_for(pool, (int)buffers->size(), [&](int i) {
+        command_buffer *cb = &(*buffers)[i];
+        int first = i * buffer_draws;
+        int end = first + buffer_draws < draws ? first + buffer_draws : draws;
+        command_buffer_reset(cb);
+        record_draws(cb, s, first, end, rotation, proj);
+    });
+}
+
+static bool
+same_buffers(const std::vector<command_buffer> &a, const std::vector<command_buffer> &b)
+{
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].size != b[i].size || memcmp(a[i].data, b[i].data, a[i].size) != 0)
+            return false;
+    return true;
+}
+
+// a null device with the scene, a constant ring big enough for a few frames and a cache
+struct null_target
+{
+    null_device device;
+    scene s;
+    ring_device ring_user;
+    cbuffer_ring ring;
+    command_buffer_ring constants_ring;
+    command_buffer_constants constants;
+    state_cache cache;
+};
+
+static void
+null_target_init(null_target *t, int draws)
+{
+    null_device_init(&t->device);
+    scene_init_null(&t->device, &t->s);
+
+    uint32_t ring_size = (uint32_t)draws * CBUFFER_RING_ALIGNMENT * 4;
+    null_handle ring_buffer = null_create_buffer(&t->device, ring_size, NULL_USAGE_DYNAMIC, NULL_BIND_CONSTANT_BUFFER);
+    t->ring_user = {&t->device, ring_buffer};
+    cbuffer_ring_backend ring_backend = {&t->ring_user, ring_signal_fence, ring_completed_fence, ring_wait_fence, ring_map, ring_unmap};
+    cbuffer_ring_init(&t->ring, ring_size, &ring_backend);
+    t->constants_ring = {&t->ring, state_cache_null_object(ring_buffer)};
+    t->constants = command_buffer_constants_ring(&t->constants_ring);
+
+    state_cache_backend backend = state_cache_backend_null(&t->device);
+    state_cache_init(&t->cache, &backend);
+}
+
+static void
+null_target_begin_frame(null_target *t)
+{
+    float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    null_clear_render_target_view(&t->device, state_cache_null_handle(t->s.render_target), clear_color);
+    null_clear_depth_stencil_view(&t->device, state_cache_null_handle(t->s.depth_stencil), 1.0f);
+    cbuffer_ring_begin_frame(&t->ring);
+}
+
+static void
+null_target_end_frame(null_target *t)
+{
+    cbuffer_ring_end_frame(&t->ring);
+    state_cache_end_frame(&t->cache);
+    null_present(&t->device);
+}
+
+// sw_raster
+
+static sw_float4
+ps_material(const sw_pixel_input *input, const void *const *constant_buffers, float scale)
+{
+    sw_float4 color = ((const sw_float4 *)constant_buffers[0])[input->primitive_id / 2];
+    return {color.x * scale, color.y * scale, color.z * scale, 1.0f};
+}
+
+static sw_float4 ps_material_0(const sw_pixel_input *input, const void *const *cbs) { return ps_material(input, cbs, 1.0f); }
+static sw_float4 ps_material_1(const sw_pixel_input *input, const void *const *cbs) { return ps_material(input, cbs, 0.75f); }
+static sw_float4 ps_material_2(const sw_pixel_input *input, const void *const *cbs) { return ps_material(input, cbs, 0.5f); }
+static sw_float4 ps_material_3(const sw_pixel_input *input, const void *const *cbs) { return ps_material(input, cbs, 0.25f); }
+
+static sw_pixel_shader sw_materials[MATERIAL_COUNT] = {ps_material_0, ps_material_1, ps_material_2, ps_material_3};
+
+// the software rasterizer reads inline constants where they are in the stream
+static void *
+sw_constants_in_place(void *user, const void *data, uint32_t size, uint32_t *first_constant, uint32_t *constant_count)
+{
+    return (void *)data;
+}
+
+static void
+sw_draw_frame_direct(sw_context *ctx, const scene *s, int draws, const mat4 &rotation, const mat4 &proj)
+{
+    sw_ia_set_vertex_buffer(ctx, cube_vertices, sizeof(float) * 3, 0);
+    sw_ia_set_index_buffer(ctx, cube_indices, 0);
+    sw_ps_set_constant_buffer(ctx, 0, cube_colors);
+    sw_rs_set_viewport(ctx, (const sw_viewport *)&s->viewport);
+    sw_om_set_depth_state(ctx, true, true, SW_COMPARISON_LESS);
+
+    for (int i = 0; i < draws; ++i)
+    {
+        if (i % MATERIAL_DRAWS == 0)
+            sw_ps_set_shader(ctx, sw_materials[i / MATERIAL_DRAWS % MATERIAL_COUNT]);
+        mat4 mvp = draw_transform(i, rotation, proj);
+        sw_vs_set_constant_buffer(ctx, 0, &mvp);
+        sw_draw_indexed(ctx, 36, 0, 0);
+    }
+}
+
+// renders a frame straight on sw_raster and from command buffers recorded on the pool, the
+// two have to come out the same
+static bool
+check_sw_replay(thread_pool *pool, int draws, int buffer_draws)
+{
+    int width = 320;
+    int height = 180;
+    sw_render_target direct_rt;
+    sw_render_target replay_rt;
+    sw_render_target_init(&direct_rt, width, height);
+    sw_render_target_init(&replay_rt, width, height);
+
+    state_cache_sw_depth_state depth_state = {true, true, SW_COMPARISON_LESS};
+    scene s = {};
+    s.depth_state = &depth_state;
+    s.viewport = {0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f};
+    s.vertex_buffer = (void *)cube_vertices;
+    s.index_buffer = (void *)cube_indices;
+    s.colors_buffer = (void *)cube_colors;
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+        s.material_ps[i] = &sw_materials[i];
+
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), (float)width / (float)height, 0.1f, 100.0f);
+    mat4 rotation = frame_rotation(7);
+    float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+    sw_context direct;
+    sw_context_init(&direct, pool);
+    sw_om_set_render_target(&direct, &direct_rt);
+    sw_clear_render_target(&direct, clear_color);
+    sw_clear_depth(&direct, 1.0f);
+    sw_draw_frame_direct(&direct, &s, draws, rotation, proj);
+    sw_flush(&direct);
+
+    sw_context replay;
+    sw_context_init(&replay, pool);
+    sw_om_set_render_target(&replay, &replay_rt);
+    sw_clear_render_target(&replay, clear_color);
+    sw_clear_depth(&replay, 1.0f);
+    s.render_target = &replay_rt;
+
+    std::vector<command_buffer> buffers((draws + buffer_draws - 1) / buffer_draws);
+    for (command_buffer &cb : buffers)
+        command_buffer_init(&cb);
+    record_frame(pool, &buffers, &s, draws, buffer_draws, rotation, proj);
+
+    state_cache cache;
+    state_cache_backend backend = state_cache_backend_sw(&replay);
+    state_cache_init(&cache, &backend);
+    command_buffer_constants constants = {nullptr, sw_constants_in_place};
+    for (const command_buffer &cb : buffers)
+        command_buffer_execute(&cb, &cache, &constants);
+    sw_flush(&replay);
+
+    int mismatches = 0;
+    for (int i = 0; i < width * height; ++i)
+        mismatches += direct_rt.color[i] != replay_rt.color[i];
+    printf("sw replay: %d draws at %dx%d, %llu triangles rasterized, %d pixels differ\n", draws, width, height,
+        (unsigned long long)replay.stats.triangles_rasterized, mismatches);
+
+    bool ok = mismatches == 0 && replay.stats.draws == (uint64_t)draws && direct.stats.triangles_rasterized == replay.stats.triangles_rasterized;
+    for (command_buffer &cb : buffers)
+        command_buffer_free(&cb);
+    sw_render_target_free(&direct_rt);
+    sw_render_target_free(&replay_rt);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    int frames = 30;
+    int draws = 50000;
+    int max_threads = (int)std::thread::hardware_concurrency();
+    int buffer_draws = 256;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            draws = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            max_threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            buffer_draws = atoi(argv[i + 1]);
+    }
+    if (max_threads < 1)
+        max_threads = 1;
+    if (buffer_draws < 1)
+        buffer_draws = 1;
+
+    bool ok = true;
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+    int buffer_count = (draws + buffer_draws - 1) / buffer_draws;
+
+    null_target *target = new null_target;
+    null_target_init(target, draws);
+    const scene *s = &target->s;
+
+    // single threaded recording of the first frame is what every thread count has to match
+    std::vector<command_buffer> reference(buffer_count);
+    std::vector<command_buffer> buffers(buffer_count);
+    for (int i = 0; i < buffer_count; ++i)
+    {
+        command_buffer_init(&reference[i]);
+        command_buffer_init(&buffers[i]);
+    }
+    {
+        thread_pool pool;
+        thread_pool_init(&pool, 1);
+        record_frame(&pool, &reference, s, draws, buffer_draws, frame_rotation(0), proj);
+        thread_pool_shutdown(&pool);
+    }
+
+    size_t stream_bytes = 0;
+    uint64_t commands = 0;
+    for (const command_buffer &cb : reference)
+    {
+        stream_bytes += cb.size;
+        commands += cb.command_count;
+    }
+
+    printf("%d frames of %d draws in %d command buffers of %d draws, %llu commands, %.1f bytes/draw (%.1f KB/frame)\n", frames, draws,
+        buffer_count, buffer_draws, (unsigned long long)commands, (double)stream_bytes / draws, stream_bytes / 1024.0);
+    printf("%-22s %10s %10s %9s %11s\n", "recording", "ms/frame", "Mdraws/s", "speedup", "efficiency");
+
+    double single_ms = 0.0;
+    for (int threads = 1;; threads *= 2)
+    {
+        if (threads > max_threads)
+            threads = max_threads;
+
+        thread_pool pool;
+        thread_pool_init(&pool, threads);
+        record_frame(&pool, &buffers, s, draws, buffer_draws, frame_rotation(0), proj);
+        ok = same_buffers(reference, buffers) && ok;
+
+        double start = now_seconds();
+        for (int frame = 0; frame < frames; ++frame)
+            record_frame(&pool, &buffers, s, draws, buffer_draws, frame_rotation(frame), proj);
+        double ms = (now_seconds() - start) * 1000.0 / frames;
+        thread_pool_shutdown(&pool);
+
+        if (threads == 1)
+            single_ms = ms;
+        char name[32];
+        snprintf(name, sizeof(name), "%d threads", threads);
+        printf("%-22s %10.3f %10.2f %8.2fx %10.0f%%\n", name, ms, draws / (ms * 1000.0), single_ms / ms, single_ms / ms / threads * 100.0);
+
+        if (threads == max_threads)
+            break;
+    }
+
+    // replay the recorded frame in order, then issue the same frame straight on the cache
+    printf("%-22s %10s %10s %9s %11s\n", "submission", "ms/frame", "ns/draw", "draws", "dev calls");
+    null_stats before = target->device.stats;
+    double start = now_seconds();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        null_target_begin_frame(target);
+        for (const command_buffer &cb : reference)
+            command_buffer_execute(&cb, &target->cache, &target->constants);
+        null_target_end_frame(target);
+    }
+    double replay_ms = (now_seconds() - start) * 1000.0 / frames;
+    uint64_t replay_draws = (target->device.stats.draws - before.draws) / frames;
+    uint64_t replay_calls = (target->device.stats.state_changes - before.state_changes) / frames;
+    printf("%-22s %10.3f %10.1f %9llu %11llu\n", "replay", replay_ms, replay_ms * 1e6 / draws, (unsigned long long)replay_draws,
+        (unsigned long long)replay_calls);
+
+    null_target *immediate = new null_target;
+    null_target_init(immediate, draws);
+    before = immediate->device.stats;
+    start = now_seconds();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        null_target_begin_frame(immediate);
+        issue_draws(&immediate->cache, &immediate->constants_ring, &immediate->s, draws, frame_rotation(0), proj);
+        null_target_end_frame(immediate);
+    }
+    double immediate_ms = (now_seconds() - start) * 1000.0 / frames;
+    uint64_t immediate_draws = (immediate->device.stats.draws - before.draws) / frames;
+    uint64_t immediate_calls = (immediate->device.stats.state_changes - before.state_changes) / frames;
+    printf("%-22s %10.3f %10.1f %9llu %11llu\n", "immediate", immediate_ms, immediate_ms * 1e6 / draws, (unsigned long long)immediate_draws,
+        (unsigned long long)immediate_calls);
+
+    // both devices saw the same frames, they have to agree on everything they were told
+    bool same_device = memcmp(target->device.stats.calls, immediate->device.stats.calls, sizeof(target->device.stats.calls)) == 0 &&
+        target->device.vs_constant_buffers[0].first_constant == immediate->device.vs_constant_buffers[0].first_constant &&
+        target->device.pixel_shader == immediate->device.pixel_shader;
+    printf("replay vs immediate: %s, %llu + %llu errors\n", same_device ? "same device calls" : "device calls differ",
+        (unsigned long long)target->device.stats.errors, (unsigned long long)immediate->device.stats.errors);
+    ok = ok && same_device && replay_draws == (uint64_t)draws && target->device.stats.errors == 0 && immediate->device.stats.errors == 0;
+
+    {
+        thread_pool pool;
+        thread_pool_init(&pool, max_threads);
+        ok = check_sw_replay(&pool, 2000, 64) && ok;
+        thread_pool_shutdown(&pool);
+    }
+
+    for (int i = 0; i < buffer_count; ++i)
+    {
+        command_buffer_free(&reference[i]);
+        command_buffer_free(&buffers[i]);
+    }
+    null_device_shutdown(&target->device);
+    null_device_shutdown(&immediate->device);
+    delete target;
+    delete immediate;
+
+    printf("command buffer checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,446 @@
+// headless comparison of the example frame loop against simulation and rendering on their own
+// threads (frame_handoff.h). a thread stands in for the window and posts input events at a
+// fixed rate, rendering is a busy wait of render_ms with a hitch of hitch_ms every hitch_every
+// frames and present blocks until the next vblank of a simulated refresh_hz display.
+// - coupled is the examples' loop: one message per iteration, angle += 1 / 60 per frame,
+//   render and present on one thread
+// - decoupled has a fixed step simulation thread draining the input queue and publishing
+//   snapshots into the triple buffer, and a render thread presenting the newest one
+// reports input to present latency percentiles, missed vblanks, frames presented without a
+// new snapshot, snapshots never presented, and how far simulated time fell behind wall time.
+// stress tests of the triple buffer and the input queue run first.
+// usage: bench_frame_pacing [-s seconds] [-r refresh_hz] [-t sim_hz] [-i input_hz] [-w render_ms]
+//        [-h hitch_every] [-m hitch_ms]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "frame_handoff.h"
+
+static double
+now_seconds()
+{
+    return frame_handoff_now();
+}
+
+static void
+sleep_until_seconds(double time)
+{
+    double now = now_seconds();
+    if (time > now)
+        std::this_thread::sleep_for(std::chrono::duration<double>(time - now));
+}
+
+static void
+spin_seconds(double seconds)
+{
+    double end = now_seconds() + seconds;
+    while (now_seconds() < end)
+    {
+    }
+}
+
+static double
+percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (double)(values.size() - 1))];
+}
+
+// stress
+
+struct stress_snapshot
+{
+    uint64_t sequence;
+    uint64_t payload[15];
+};
+
+// the producer publishes as fast as it can, the consumer checks every snapshot it takes is
+// whole and newer than the last one
+static bool
+stress_frame_handoff(uint64_t count)
+{
+    frame_handoff handoff;
+    frame_handoff_init(&handoff);
+    stress_snapshot slots[FRAME_HANDOFF_SLOTS] = {};
+
+    std::thread producer([&] {
+        for (uint64_t i = 1; i <= count; ++i)
+        {
+            stress_snapshot *s = &slots[frame_handoff_write_slot(&handoff)];
+            s->sequence = i;
+            for (int j = 0; j < 15; ++j)
+                s->payload[j] = i * 2654435761u + (uint64_t)j;
+            frame_handoff_publish(&handoff);
+        }
+    });
+
+    uint64_t last = 0;
+    uint64_t torn = 0;
+    uint64_t out_of_order = 0;
+    while (last < count)
+    {
+        if (frame_handoff_acquire(&handoff) == false)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        const stress_snapshot *s = &slots[frame_handoff_read_slot(&handoff)];
+        for (int j = 0; j < 15; ++j)
+            torn += s->payload[j] != s->sequence * 2654435761u + (uint64_t)j;
+        out_of_order += s->sequence <= last;
+        last = s->sequence;
+    }
+    producer.join();
+
+    printf("frame handoff stress: %llu published, %llu acquired, %llu overwritten, %llu torn, %llu out of order\n",
+        (unsigned long long)handoff.published, (unsigned long long)handoff.acquired, (unsigned long long)handoff.overwritten,
+        (unsigned long long)torn, (unsigned long long)out_of_order);
+    return torn == 0 && out_of_order == 0 && handoff.published == handoff.acquired + handoff.overwritten;
+}
+
+static bool
+stress_spsc_queue(uint32_t count)
+{
+    spsc_queue<uint32_t, 1024> *queue = new spsc_queue<uint32_t, 1024>;
+    spsc_queue_init(queue);
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; ++i)
+            while (spsc_queue_push(queue, i) == false)
+                std::this_thread::yield();
+    });
+
+    uint32_t expected = 0;
+    uint32_t out_of_order = 0;
+    while (expected < count)
+    {
+        uint32_t item;
+        if (spsc_queue_pop(queue, &item) == false)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        out_of_order += item != expected;
+        expected = item + 1;
+    }
+    producer.join();
+    delete queue;
+
+    printf("spsc queue stress: %u items, %u out of order\n", count, out_of_order);
+    return out_of_order == 0;
+}
+
+// frame loops
+
+struct options
+{
+    double seconds;
+    double refresh_hz;
+    double sim_hz;
+    double input_hz;
+    double render_ms;
+    int hitch_every;
+    double hitch_ms;
+};
+
+struct input_event
+{
+    uint32_t sequence;
+};
+
+#define INPUT_QUEUE_SIZE 4096
+typedef spsc_queue<input_event, INPUT_QUEUE_SIZE> input_queue;
+
+// stands in for the window thread, event_times[sequence] is when an event was posted
+struct input_source
+{
+    input_queue queue;
+    std::vector<double> event_times;
+    std::atomic<bool> stop;
+    uint32_t posted;
+    uint32_t lost; // queue was full
+};
+
+static void
+input_source_run(input_source *source, double input_hz)
+{
+    double interval = 1.0 / input_hz;
+    double next = now_seconds();
+    while (source->stop.load(std::memory_order_relaxed) == false && source->posted < source->event_times.size())
+    {
+        sleep_until_seconds(next);
+        next += interval;
+        source->event_times[source->posted] = now_seconds();
+        if (spsc_queue_push(&source->queue, {source->posted}))
+            source->posted++;
+        else
+            source->lost++;
+    }
+}
+
+// a display refreshing at a fixed rate, present blocks until the vblank after the call
+struct vsync
+{
+    double start;
+    double interval;
+    uint64_t last_vblank;
+    uint64_t presents;
+    uint64_t missed;
+};
+
+static double
+vsync_present(vsync *v)
+{
+    uint64_t vblank = (uint64_t)((now_seconds() - v->start) / v->interval) + 1;
+    if (v->presents && vblank > v->last_vblank + 1)
+        v->missed += vblank - v->last_vblank - 1;
+    v->last_vblank = vblank;
+    v->presents++;
+
+    double time = v->start + (double)vblank * v->interval;
+    sleep_until_seconds(time);
+    return time;
+}
+
+// a frame's worth of render work, with a hitch now and then
+static void
+render_frame(const options *o, uint64_t frame)
+{
+    double ms = o->render_ms;
+    if (o->hitch_every > 0 && frame % (uint64_t)o->hitch_every == (uint64_t)o->hitch_every - 1)
+        ms += o->hitch_ms;
+    spin_seconds(ms * 0.001);
+}
+
+struct model_result
+{
+    std::vector<double> latencies; // input to present, seconds
+    uint64_t presents;
+    uint64_t missed;
+    uint64_t repeats;     // presented without a new snapshot
+    uint64_t overwritten; // snapshots never presented
+    double sim_lag;       // wall time minus simulated time at the end
+    uint32_t backlog;     // input events posted and never seen by the simulation
+};
+
+// everything on one thread like the examples
+static void
+run_coupled(const options *o, model_result *result)
+{
+    input_source *source = new input_source;
+    spsc_queue_init(&source->queue);
+    source->event_times.resize((size_t)(o->seconds * o->input_hz) + 16);
+    source->stop.store(false);
+    source->posted = 0;
+    source->lost = 0;
+    std::thread input_thread(input_source_run, source, o->input_hz);
+
+    vsync v = {now_seconds(), 1.0 / o->refresh_hz, 0, 0, 0};
+    double start = v.start;
+    double sim_time = 0.0;
+    float angle = 0.0f;
+    uint32_t seen = 0;
+    uint32_t presented = 0;
+    uint64_t frame = 0;
+    while (now_seconds() - start < o->seconds)
+    {
+        // one message per iteration
+        input_event event;
+        if (spsc_queue_pop(&source->queue, &event))
+            seen = event.sequence + 1;
+
+        angle += 1.0f / 60.0f;
+        sim_time += 1.0 / 60.0;
+
+        render_frame(o, frame++);
+        double present_time = vsync_present(&v);
+        for (; presented < seen; ++presented)
+            result->latencies.push_back(present_time - source->event_times[presented]);
+    }
+
+    source->stop.store(true);
+    input_thread.join();
+    result->presents = v.presents;
+    result->missed = v.missed;
+    result->repeats = 0;
+    result->overwritten = 0;
+    result->sim_lag = (now_seconds() - start) - sim_time;
+    result->backlog = source->posted - seen;
+    delete source;
+}
+
+// immutable snapshot of the simulation, previous and current state for interpolation
+struct sim_snapshot
+{
+    uint64_t tick;
+    double state_time;
+    float previous_angle;
+    float angle;
+    uint32_t input_seen;
+};
+
+static void
+run_decoupled(const options *o, model_result *result)
+{
+    input_source *source = new input_source;
+    spsc_queue_init(&source->queue);
+    source->event_times.resize((size_t)(o->seconds * o->input_hz) + 16);
+    source->stop.store(false);
+    source->posted = 0;
+    source->lost = 0;
+    std::thread input_thread(input_source_run, source, o->input_hz);
+
+    frame_handoff handoff;
+    frame_handoff_init(&handoff);
+    sim_snapshot snapshots[FRAME_HANDOFF_SLOTS] = {};
+    std::atomic<bool> stop(false);
+
+    double start = now_seconds();
+    fixed_timestep ts;
+    fixed_timestep_init(&ts, 1.0 / o->sim_hz, start);
+
+    std::thread sim_thread([&] {
+        float angle = 0.0f;
+        float previous_angle = 0.0f;
+        uint32_t seen = 0;
+        while (stop.load(std::memory_order_relaxed) == false)
+        {
+            uint32_t steps = fixed_timestep_advance(&ts, now_seconds());
+            for (uint32_t i = 0; i < steps; ++i)
+            {
+                input_event event;
+                while (spsc_queue_pop(&source->queue, &event))
+                    seen = event.sequence + 1;
+                previous_angle = angle;
+                angle += (float)ts.step;
+            }
+
+            if (steps)
+            {
+                sim_snapshot *s = &snapshots[frame_handoff_write_slot(&handoff)];
+                s->tick = ts.ticks;
+                s->state_time = fixed_timestep_state_time(&ts);
+                s->previous_angle = previous_angle;
+                s->angle = angle;
+                s->input_seen = seen;
+                frame_handoff_publish(&handoff);
+            }
+            sleep_until_seconds(fixed_timestep_next_time(&ts));
+        }
+    });
+
+    vsync v = {start, 1.0 / o->refresh_hz, 0, 0, 0};
+    uint32_t presented = 0;
+    uint64_t frame = 0;
+    uint64_t repeats = 0;
+    bool have_snapshot = false;
+    volatile float rendered_angle = 0.0f;
+    while (now_seconds() - start < o->seconds)
+    {
+        bool fresh = frame_handoff_acquire(&handoff);
+        have_snapshot = have_snapshot || fresh;
+        repeats += fresh == false;
+        const sim_snapshot *s = &snapshots[frame_handoff_read_slot(&handoff)];
+
+        if (have_snapshot)
+        {
+            float alpha = fixed_timestep_alpha(s->state_time, now_seconds(), ts.step);
+            rendered_angle = s->previous_angle + (s->angle - s->previous_angle) * alpha;
+        }
+
+        render_frame(o, frame++);
+        double present_time = vsync_present(&v);
+        if (have_snapshot)
+            for (; presented < s->input_seen; ++presented)
+                result->latencies.push_back(present_time - source->event_times[presented]);
+    }
+
+    stop.store(true);
+    sim_thread.join();
+    source->stop.store(true);
+    input_thread.join();
+    (void)rendered_angle;
+
+    result->presents = v.presents;
+    result->missed = v.missed;
+    result->repeats = repeats;
+    result->overwritten = handoff.overwritten;
+    result->sim_lag = (now_seconds() - start) - (double)ts.ticks * ts.step;
+    uint32_t newest = snapshots[frame_handoff_read_slot(&handoff)].input_seen;
+    result->backlog = source->posted - newest;
+    delete source;
+}
+
+static void
+print_result(const char *name, const model_result *r)
+{
+    printf("%-24s %7llu %7llu %8llu %9llu %9.2f %9.2f %9.2f %9.2f %9.2f %8u\n", name, (unsigned long long)r->presents,
+        (unsigned long long)r->missed, (unsigned long long)r->repeats, (unsigned long long)r->overwritten, r->sim_lag * 1000.0,
+        percentile(r->latencies, 0.5) * 1000.0, percentile(r->latencies, 0.95) * 1000.0, percentile(r->latencies, 0.99) * 1000.0,
+        percentile(r->latencies, 1.0) * 1000.0, r->backlog);
+}
+
+int
+main(int argc, char **argv)
+{
+    options o = {};
+    o.seconds = 2.0;
+    o.refresh_hz = 60.0;
+    o.sim_hz = 120.0;
+    o.input_hz = 250.0;
+    o.render_ms = 4.0;
+    o.hitch_every = 30;
+    o.hitch_ms = 35.0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+            o.seconds = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            o.refresh_hz = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            o.sim_hz = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-i") == 0)
+            o.input_hz = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-w") == 0)
+            o.render_ms = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-h") == 0)
+            o.hitch_every = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-m") == 0)
+            o.hitch_ms = atof(argv[i + 1]);
+    }
+
+    bool ok = true;
+    ok = stress_frame_handoff(2000000) && ok;
+    ok = stress_spsc_queue(4000000) && ok;
+
+    printf("%.1f s at %.0f hz refresh, %.0f hz simulation, %.0f hz input, %.1f ms render, %.1f ms hitch every %d frames\n", o.seconds,
+        o.refresh_hz, o.sim_hz, o.input_hz, o.render_ms, o.hitch_ms, o.hitch_every);
+    printf("%-24s %7s %7s %8s %9s %9s %9s %9s %9s %9s %8s\n", "", "frames", "missed", "repeats", "unshown", "sim lag", "input p50",
+        "p95", "p99", "max ms", "backlog");
+
+    model_result coupled = {};
+    run_coupled(&o, &coupled);
+    print_result("coupled, one thread", &coupled);
+
+    model_result decoupled = {};
+    run_decoupled(&o, &decoupled);
+    print_result("decoupled, sim + render", &decoupled);
+
+    // the simulation keeps wall time within a step or two and every input reaches the screen
+    // within a few frames, hitches included
+    double frame_time = 1.0 / o.refresh_hz;
+    double worst_frame = frame_time + (o.render_ms + o.hitch_ms) * 0.001;
+    ok = ok && decoupled.latencies.empty() == false && decoupled.sim_lag < 2.0 / o.sim_hz &&
+        percentile(decoupled.latencies, 1.0) < 2.0 * worst_frame + 2.0 / o.sim_hz;
+
+    printf("frame pacing checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+// culls a field of objects scattered around a camera against its view frustum (frustum_cull.h),
+// bounding spheres and boxes one at a time without SIMD and SIMD_MATH_WIDTH at a time, plus
+// the SIMD spheres split into ranges over the thread pool. reports objects tested per ms and
+// checks that every batch result matches the one at a time test.
+// then a field of spinning cubes is drawn instanced through the software backend, once all of
+// them and once only the visible list gathered into the instance stream, the images have to
+// be identical.
+// usage: bench_frustum_cull [-n objects] [-r repeats] [-c cubes] [-t threads] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "frustum_cull.h"
+#include "simd_math.h"
+#include "sw_raster.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static float
+random_range(uint64_t *state, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(next_random(state) & 0xffffff) / (float)0xffffff;
+}
+
+static sw_float4
+ps_main(const sw_pixel_input *input, const void *const *constant_buffers)
+{
+    const sw_float4 *colors = (const sw_float4 *)constant_buffers[0];
+    return colors[input->primitive_id / 2];
+}
+
+// the camera turns around the y axis, the view matrix is the inverse of that rotation
+static mat4
+camera_view_proj(float yaw, float aspect)
+{
+    return mat4_rotation_y(-yaw) * mat4_perspective_fov_lh(simd_radians(60.0f), aspect, 0.1f, 1000.0f);
+}
+
+// a batch result may only differ from the one at a time test on objects that touch a plane
+// within rounding, the batch path can use fma
+static bool
+sphere_on_boundary(const frustum *f, const frustum_bounds *spheres, uint32_t i)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float *plane = f->planes[p];
+        double d = (double)plane[0] * frustum_bounds_stream(spheres, 0)[i] + (double)plane[1] * frustum_bounds_stream(spheres, 1)[i] +
+            (double)plane[2] * frustum_bounds_stream(spheres, 2)[i] + (double)plane[3] + frustum_bounds_stream(spheres, 3)[i];
+        if (d > -1e-3 && d < 1e-3)
+            return true;
+    }
+    return false;
+}
+
+static bool
+aabb_on_boundary(const frustum *f, const frustum_bounds *boxes, uint32_t i)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float *plane = f->planes[p];
+        double d = (double)plane[3];
+        for (int axis = 0; axis < 3; ++axis)
+            d += (double)plane[axis] * frustum_bounds_stream(boxes, axis)[i] + fabs((double)plane[axis]) * frustum_bounds_stream(boxes, axis + 3)[i];
+        if (d > -1e-3 && d < 1e-3)
+            return true;
+    }
+    return false;
+}
+
+// compares two ascending index lists, differences have to be boundary cases
+template <typename boundary_fn>
+static bool
+same_visible(const uint32_t *a, uint32_t a_count, const uint32_t *b, uint32_t b_count, boundary_fn on_boundary)
+{
+    uint32_t i = 0, j = 0;
+    while (i < a_count || j < b_count)
+    {
+        if (i < a_count && j < b_count && a[i] == b[j])
+        {
+            i++;
+            j++;
+        }
+        else if (j == b_count || (i < a_count && a[i] < b[j]))
+        {
+            if (on_boundary(a[i++]) == false)
+                return false;
+        }
+        else if (on_boundary(b[j++]) == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    int object_count = 1000000;
+    int repeats = 20;
+    int cube_count = 20000;
+    int threads = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            object_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            repeats = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            cube_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            seed = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    // objects within 500 units of the camera, about a tenth of them end up in view
+    frustum_bounds spheres, boxes;
+    if (frustum_bounds_init(&spheres, object_count, FRUSTUM_SPHERE_STREAMS) == false ||
+        frustum_bounds_init(&boxes, object_count, FRUSTUM_AABB_STREAMS) == false)
+    {
+        fprintf(stderr, "Failed to allocate bounds\n");
+        return 1;
+    }
+    uint64_t state = seed;
+    for (int i = 0; i < object_count; ++i)
+    {
+        float center[3], extent[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            center[axis] = random_range(&state, -500.0f, 500.0f);
+            extent[axis] = random_range(&state, 0.5f, 3.0f);
+        }
+        frustum_bounds_set_sphere(&spheres, i, center[0], center[1], center[2], sqrtf(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]));
+        frustum_bounds_set_aabb(&boxes, i, center, extent);
+    }
+
+    std::vector<uint32_t> reference(object_count);
+    std::vector<uint32_t> visible(object_count);
+
+    // ranges for the pool are multiples of 8 so every one starts on a SIMD block
+    const int range_size = 16384;
+    int range_count = (object_count + range_size - 1) / range_size;
+    std::vector<uint32_t> range_counts(range_count);
+    std::vector<uint32_t> parallel_visible(object_count);
+
+    enum
+    {
+        METHOD_SPHERES_SCALAR,
+        METHOD_SPHERES_SIMD,
+        METHOD_SPHERES_PARALLEL,
+        METHOD_AABBS_SCALAR,
+        METHOD_AABBS_SIMD,
+        METHOD_COUNT
+    };
+    const char *method_names[METHOD_COUNT] = {"spheres scalar", "spheres " SIMD_MATH_NAME, "spheres " SIMD_MATH_NAME " pool",
+        "aabbs scalar", "aabbs " SIMD_MATH_NAME};
+    double seconds[METHOD_COUNT] = {};
+    uint64_t visible_total[METHOD_COUNT] = {};
+
+    bool ok = true;
+    for (int repeat = 0; repeat < repeats; ++repeat)
+    {
+        frustum f = frustum_from_matrix(camera_view_proj((float)repeat * 0.3f, 16.0f / 9.0f));
+
+        // spheres
+        double start = now_seconds();
+        uint32_t reference_count = 0;
+        for (int i = 0; i < object_count; ++i)
+        {
+            if (frustum_test_sphere(&f, frustum_bounds_stream(&spheres, 0)[i], frustum_bounds_stream(&spheres, 1)[i],
+                    frustum_bounds_stream(&spheres, 2)[i], frustum_bounds_stream(&spheres, 3)[i]))
+                reference[reference_count++] = (uint32_t)i;
+        }
+        seconds[METHOD_SPHERES_SCALAR] += now_seconds() - start;
+        visible_total[METHOD_SPHERES_SCALAR] += reference_count;
+
+        start = now_seconds();
+        uint32_t visible_count = frustum_cull_spheres(&f, &spheres, 0, object_count, visible.data());
+        seconds[METHOD_SPHERES_SIMD] += now_seconds() - start;
+        visible_total[METHOD_SPHERES_SIMD] += visible_count;
+        ok = ok && same_visible(reference.data(), reference_count, visible.data(), visible_count,
+            [&](uint32_t i) { return sphere_on_boundary(&f, &spheres, i); });
+
+        // every range culls into its own slice, then the slices are packed together
+        start = now_seconds();
+        thread_pool_parallel_for(&pool, range_count, [&](int range) {
+            size_t begin = (size_t)range * range_size;
+            size_t end = begin + range_size < (size_t)object_count ? begin + range_size : (size_t)object_count;
+            range_counts[range] = frustum_cull_spheres(&f, &spheres, begin, end, parallel_visible.data() + begin);
+        });
+        uint32_t parallel_count = 0;
+        for (int range = 0; range < range_count; ++range)
+        {
+            memmove(parallel_visible.data() + parallel_count, parallel_visible.data() + (size_t)range * range_size, range_counts[range] * sizeof(uint32_t));
+            parallel_count += range_counts[range];
+        }
+        seconds[METHOD_SPHERES_PARALLEL] += now_seconds() - start;
+        visible_total[METHOD_SPHERES_PARALLEL] += parallel_count;
+        ok = ok && parallel_count == visible_count && memcmp(parallel_visible.data(), visible.data(), visible_count * sizeof(uint32_t)) == 0;
+
+        // boxes
+        start = now_seconds();
+        reference_count = 0;
+        for (int i = 0; i < object_count; ++i)
+        {
+            float center[3], extent[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                center[axis] = frustum_bounds_stream(&boxes, axis)[i];
+                extent[axis] = frustum_bounds_stream(&boxes, axis + 3)[i];
+            }
+            if (frustum_test_aabb(&f, center, extent))
+                reference[reference_count++] = (uint32_t)i;
+        }
+        seconds[METHOD_AABBS_SCALAR] += now_seconds() - start;
+        visible_total[METHOD_AABBS_SCALAR] += reference_count;
+
+        start = now_seconds();
+        visible_count = frustum_cull_aabbs(&f, &boxes, 0, object_count, visible.data());
+        seconds[METHOD_AABBS_SIMD] += now_seconds() - start;
+        visible_total[METHOD_AABBS_SIMD] += visible_count;
+        ok = ok && same_visible(reference.data(), reference_count, visible.data(), visible_count,
+            [&](uint32_t i) { return aabb_on_boundary(&f, &boxes, i); });
+    }
+
+    printf("%d objects, %d repeats, %d threads\n", object_count, repeats, thread_pool_size(&pool));
+    printf("%-24s %10s %14s %10s\n", "method", "ms/pass", "objects/ms", "visible");
+    for (int method = 0; method < METHOD_COUNT; ++method)
+    {
+        double ms = seconds[method] * 1000.0 / repeats;
+        printf("%-24s %10.3f %14.0f %9.2f%%\n", method_names[method], ms, object_count / ms,
+            100.0 * (double)visible_total[method] / ((double)object_count * repeats));
+    }
+    printf("\n");
+
+    // the culled list feeds an instanced draw, culled cubes can't have covered any pixel
+    int width = 640;
+    int height = 360;
+    sw_render_target all_target, culled_target;
+    if (sw_render_target_init(&all_target, width, height) == false || sw_render_target_init(&culled_target, width, height) == false)
+    {
+        fprintf(stderr, "Failed to create render targets\n");
+        return 1;
+    }
+    sw_context context;
+    sw_context_init(&context, &pool);
+
+    float vertices[] = {
+        -1.0f, -1.0f, -1.0f,
+         1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+         1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f
+    };
+
+    unsigned int indices[] = {
+        0, 2, 3,  0, 3, 1,
+        1, 3, 7,  1, 7, 5,
+        5, 7, 6,  5, 6, 4,
+        4, 6, 2,  4, 2, 0,
+        2, 6, 7,  2, 7, 3,
+        0, 1, 5,  0, 5, 4
+    };
+
+    float colors[] = {
+        1.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, 1.0f, 1.0f,
+        1.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 1.0f
+    };
+
+    // unit cubes spinning in place, a sphere of radius sqrt(3) bounds every orientation
+    std::vector<float> angle(cube_count), tx(cube_count), ty(cube_count), tz(cube_count);
+    frustum_bounds cube_bounds;
+    frustum_bounds_init(&cube_bounds, cube_count, FRUSTUM_SPHERE_STREAMS);
+    for (int i = 0; i < cube_count; ++i)
+    {
+        tx[i] = random_range(&state, -150.0f, 150.0f);
+        ty[i] = random_range(&state, -20.0f, 20.0f);
+        tz[i] = random_range(&state, -150.0f, 150.0f);
+        angle[i] = random_range(&state, 0.0f, 6.0f);
+        frustum_bounds_set_sphere(&cube_bounds, i, tx[i], ty[i], tz[i], sqrtf(3.0f));
+    }
+
+    mat4_soa world;
+    mat4_soa_init(&world, cube_count);
+    mat4 view_proj = camera_view_proj(0.5f, (float)width / (float)height);
+    mat4_soa_euler_translation(&world, angle.data(), angle.data(), angle.data(), tx.data(), ty.data(), tz.data());
+    mat4_soa_mul_mat4(&world, &world, view_proj);
+    std::vector<float> transforms((size_t)cube_count * 16);
+    mat4_soa_store_transposed(transforms.data(), &world);
+
+    std::vector<uint32_t> cube_visible(cube_count);
+    std::vector<float> visible_transforms((size_t)cube_count * 16);
+    sw_viewport viewport = {};
+    viewport.width = (float)width;
+    viewport.height = (float)height;
+    viewport.max_depth = 1.0f;
+
+    double draw_seconds[2] = {};
+    uint32_t drawn[2] = {};
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        bool culled = mode == 1;
+        float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        sw_om_set_render_target(&context, culled ? &culled_target : &all_target);
+        sw_clear_render_target(&context, clear_color);
+        sw_clear_depth(&context, 1.0f);
+        sw_flush(&context);
+
+        double start = now_seconds();
+        const float *instances = transforms.data();
+        uint32_t instance_count = (uint32_t)cube_count;
+        if (culled)
+        {
+            frustum f = frustum_from_matrix(view_proj);
+            instance_count = frustum_cull_spheres(&f, &cube_bounds, 0, cube_count, cube_visible.data());
+            for (uint32_t i = 0; i < instance_count; ++i)
+                memcpy(&visible_transforms[(size_t)i * 16], &transforms[(size_t)cube_visible[i] * 16], 16 * sizeof(float));
+            instances = visible_transforms.data();
+        }
+
+        sw_ia_set_vertex_buffer(&context, vertices, 3 * sizeof(float), 0);
+        sw_ia_set_index_buffer(&context, indices, 0);
+        sw_ia_set_instance_buffer(&context, instances, 16 * sizeof(float), 0);
+        sw_ps_set_shader(&context, ps_main);
+        sw_ps_set_constant_buffer(&context, 0, colors);
+        sw_rs_set_viewport(&context, &viewport);
+        sw_om_set_depth_state(&context, true, true, SW_COMPARISON_LESS);
+        sw_draw_indexed_instanced(&context, 36, instance_count, 0, 0, 0);
+        sw_flush(&context);
+        draw_seconds[mode] = now_seconds() - start;
+        drawn[mode] = instance_count;
+    }
+
+    bool identical = memcmp(all_target.color, culled_target.color, (size_t)width * height * sizeof(uint32_t)) == 0;
+    ok = ok && identical;
+    printf("%-24s %10s %10s\n", "instanced draw", "cubes", "ms");
+    printf("%-24s %10u %10.3f\n", "all cubes", drawn[0], draw_seconds[0] * 1000.0);
+    printf("%-24s %10u %10.3f\n", "culled + gathered", drawn[1], draw_seconds[1] * 1000.0);
+    printf("images %s\n", identical ? "identical" : "DIFFER");
+
+    mat4_soa_free(&world);
+    frustum_bounds_free(&cube_bounds);
+    sw_render_target_free(&culled_target);
+    sw_render_target_free(&all_target);
+    frustum_bounds_free(&boxes);
+    frustum_bounds_free(&spheres);
+    thread_pool_shutdown(&pool);
+
+    printf("frustum checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
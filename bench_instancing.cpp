@@ -0,0 +1,259 @@
+// draws a grid of rotating cubes through the software backend twice, once with a cbuffer
+// update and a draw per cube like example_cubes and once with a single instanced draw.
+// sw_raster transforms and sets up every draw as it is submitted, so the "submit + setup"
+// time is mostly vertex work. "record" writes the same calls into a command buffer without
+// running them, which is the per draw submission cost on its own.
+// usage: bench_instancing [-n cubes] [-f frames] [-t threads] [-w width] [-h height]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "command_buffer.h"
+#include "simd_math.h"
+#include "sw_raster.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static sw_float4
+ps_main(const sw_pixel_input *input, const void *const *constant_buffers)
+{
+    const sw_float4 *colors = (const sw_float4 *)constant_buffers[0];
+    const uint32_t *instance_colors = (const uint32_t *)constant_buffers[1];
+    return colors[(input->primitive_id / 2 + instance_colors[input->instance_id]) % 6];
+}
+
+// the calls of one frame of either path, the per draw transforms go inline into the stream and
+// the instanced path copies them into an instance stream the way a map discard would
+static void
+record_frame(command_buffer *cb, bool instanced, int cube_count, const float *transforms, const uint32_t *cube_colors,
+    float *instance_stream, void *vertices, void *indices, void *colors, const sw_viewport *viewport)
+{
+    static sw_pixel_shader pixel_shader = ps_main;
+    command_buffer_reset(cb);
+    command_buffer_ia_set_vertex_buffer(cb, 0, vertices, 3 * sizeof(float), 0);
+    command_buffer_ia_set_index_buffer(cb, indices, 0, 0);
+    command_buffer_set_shader(cb, STATE_CACHE_STAGE_PS, &pixel_shader);
+    command_buffer_set_constant_buffer(cb, STATE_CACHE_STAGE_PS, 0, colors);
+    command_buffer_rs_set_viewports(cb, 1, (const state_cache_viewport *)viewport);
+
+    if (instanced)
+    {
+        memcpy(instance_stream, transforms, (size_t)cube_count * 16 * sizeof(float));
+        command_buffer_ia_set_vertex_buffer(cb, 1, instance_stream, 16 * sizeof(float), 0);
+        command_buffer_set_constant_buffer(cb, STATE_CACHE_STAGE_PS, 1, (void *)cube_colors);
+        command_buffer_draw_indexed_instanced(cb, 36, (uint32_t)cube_count, 0, 0, 0);
+    }
+    else
+    {
+        for (int i = 0; i < cube_count; ++i)
+        {
+            command_buffer_set_constants(cb, STATE_CACHE_STAGE_VS, 0, &transforms[(size_t)i * 16], 16 * sizeof(float));
+            command_buffer_set_constant_buffer(cb, STATE_CACHE_STAGE_PS, 1, (void *)&cube_colors[i]);
+            command_buffer_draw_indexed(cb, 36, 0, 0);
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int cube_count = 100000;
+    int frames = 5;
+    int threads = 0;
+    int width = 1280;
+    int height = 720;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            cube_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-w") == 0)
+            width = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-h") == 0)
+            height = atoi(argv[i + 1]);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    sw_render_target per_draw_target;
+    sw_render_target instanced_target;
+    if (sw_render_target_init(&per_draw_target, width, height) == false ||
+        sw_render_target_init(&instanced_target, width, height) == false)
+    {
+        fprintf(stderr, "Failed to create render targets\n");
+        return 1;
+    }
+
+    sw_context context;
+    sw_context_init(&context, &pool);
+
+    float vertices[] = {
+        -1.0f, -1.0f, -1.0f,
+         1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+         1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f
+    };
+
+    unsigned int indices[] = {
+        0, 2, 3,  0, 3, 1,
+        1, 3, 7,  1, 7, 5,
+        5, 7, 6,  5, 6, 4,
+        4, 6, 2,  4, 2, 0,
+        2, 6, 7,  2, 7, 3,
+        0, 1, 5,  0, 5, 4
+    };
+
+    float colors[] = {
+        1.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, 1.0f, 1.0f,
+        1.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 1.0f
+    };
+
+    // 100 x 100 x n grid of cubes, each spinning at its own speed
+    std::vector<float> speed(cube_count);
+    std::vector<float> angle_x(cube_count), angle_y(cube_count), angle_z(cube_count);
+    std::vector<float> tx(cube_count), ty(cube_count), tz(cube_count);
+    std::vector<uint32_t> cube_colors(cube_count);
+    for (int i = 0; i < cube_count; ++i)
+    {
+        speed[i] = 0.5f + (float)(i % 7) * 0.25f;
+        tx[i] = ((float)(i % 100) - 49.5f) * 4.0f;
+        ty[i] = ((float)((i / 100) % 100) - 49.5f) * 4.0f;
+        tz[i] = 250.0f + (float)(i / 10000) * 4.0f;
+        cube_colors[i] = (uint32_t)(i % 6);
+    }
+
+    mat4_soa world;
+    mat4_soa_init(&world, cube_count);
+    std::vector<float> transforms((size_t)cube_count * 16);
+
+    sw_viewport viewport = {};
+    viewport.width = (float)width;
+    viewport.height = (float)height;
+    viewport.max_depth = 1.0f;
+
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), viewport.width / viewport.height, 0.1f, 1000.0f);
+
+    command_buffer cb;
+    command_buffer_init(&cb);
+    std::vector<float> instance_stream((size_t)cube_count * 16);
+
+    double update_seconds = 0.0;
+    double record_seconds[2] = {};
+    size_t record_bytes[2] = {};
+    double submit_seconds[2] = {};
+    double flush_seconds[2] = {};
+
+    float angle = 0.0f;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        angle += (1.0f / 60.0f);
+
+        // update transforms, shared by both paths
+        {
+            double start = now_seconds();
+            for (int i = 0; i < cube_count; ++i)
+            {
+                angle_x[i] = angle * speed[i];
+                angle_y[i] = angle * speed[i];
+                angle_z[i] = angle * speed[i];
+            }
+            mat4_soa_euler_translation(&world, angle_x.data(), angle_y.data(), angle_z.data(), tx.data(), ty.data(), tz.data());
+            mat4_soa_mul_mat4(&world, &world, proj);
+            mat4_soa_store_transposed(transforms.data(), &world);
+            update_seconds += now_seconds() - start;
+        }
+
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            bool instanced = mode == 1;
+            {
+                double start = now_seconds();
+                record_frame(&cb, instanced, cube_count, transforms.data(), cube_colors.data(), instance_stream.data(), vertices, indices,
+                    colors, &viewport);
+                record_seconds[mode] += now_seconds() - start;
+                record_bytes[mode] = cb.size;
+            }
+
+            float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+            sw_om_set_render_target(&context, instanced ? &instanced_target : &per_draw_target);
+            sw_clear_render_target(&context, clear_color);
+            sw_clear_depth(&context, 1.0f);
+
+            double start = now_seconds();
+
+            sw_ia_set_vertex_buffer(&context, vertices, 3 * sizeof(float), 0);
+            sw_ia_set_index_buffer(&context, indices, 0);
+            sw_ps_set_shader(&context, ps_main);
+            sw_ps_set_constant_buffer(&context, 0, colors);
+            sw_rs_set_viewport(&context, &viewport);
+            sw_om_set_depth_state(&context, true, true, SW_COMPARISON_LESS);
+
+            if (instanced)
+            {
+                // one draw, transforms and color indices come from per instance streams
+                sw_ia_set_instance_buffer(&context, transforms.data(), 16 * sizeof(float), 0);
+                sw_ps_set_constant_buffer(&context, 1, cube_colors.data());
+                sw_draw_indexed_instanced(&context, 36, cube_count, 0, 0, 0);
+            }
+            else
+            {
+                // map discard + draw per cube
+                float transform_cbuffer[16];
+                sw_ia_set_instance_buffer(&context, nullptr, 0, 0);
+                sw_vs_set_constant_buffer(&context, 0, transform_cbuffer);
+                for (int i = 0; i < cube_count; ++i)
+                {
+                    memcpy(transform_cbuffer, &transforms[(size_t)i * 16], sizeof(transform_cbuffer));
+                    sw_ps_set_constant_buffer(&context, 1, &cube_colors[i]);
+                    sw_draw_indexed(&context, 36, 0, 0);
+                }
+            }
+
+            double submitted = now_seconds();
+            sw_flush(&context);
+            submit_seconds[mode] += submitted - start;
+            flush_seconds[mode] += now_seconds() - submitted;
+        }
+    }
+
+    size_t pixel_count = (size_t)width * height;
+    bool identical = memcmp(per_draw_target.color, instanced_target.color, pixel_count * sizeof(uint32_t)) == 0;
+
+    printf("%d cubes, %d frames at %dx%d on %d threads\n", cube_count, frames, width, height, thread_pool_size(&pool));
+    printf("transform update: %.3f ms/frame\n", update_seconds * 1000.0 / frames);
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        printf("%-10s record %.3f ms/frame (%zu bytes), submit + setup %.3f ms/frame, flush %.3f ms/frame\n",
+            mode ? "instanced:" : "per draw:", record_seconds[mode] * 1000.0 / frames, record_bytes[mode],
+            submit_seconds[mode] * 1000.0 / frames, flush_seconds[mode] * 1000.0 / frames);
+    }
+    printf("images %s\n", identical ? "identical" : "DIFFER");
+
+    command_buffer_free(&cb);
+    mat4_soa_free(&world);
+    sw_render_target_free(&instanced_target);
+    sw_render_target_free(&per_draw_target);
+    thread_pool_shutdown(&pool);
+
+    return identical ? 0 : 1;
+}
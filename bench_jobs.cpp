@@ -0,0 +1,461 @@
+// scales the job system from 1 to 64 threads over three workloads: empty jobs (scheduling
+// overhead), a texture graph where every decode job is followed by a mip job that fans out
+// again through mip_chain_build and a main thread upload, and a frame graph that animates,
+// culls and records draws for tens of thousands of objects in chunks, each stage waiting on
+// a counter for the one before and the submit running on the main thread.
+// checks that every thread count produces the same mips, visible sets and command bytes as
+// one thread, that main thread jobs only ever ran there and that nested parallel fors cover
+// their ranges exactly once.
+// usage: bench_jobs [-t max_threads] [-n objects] [-s texture_size] [-x textures] [-f frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "command_buffer.h"
+#include "frustum_cull.h"
+#include "job_system.h"
+#include "mip_gen.h"
+#include "simd_math.h"
+#include "thread_pool.h"
+
+#define CHUNK_SIZE 1024
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+static std::thread::id main_thread;
+static std::atomic<int> main_thread_misses;
+
+//
+// empty jobs
+//
+
+static void
+empty_job(void *user)
+{
+    *(uint8_t *)user = 1;
+}
+
+//
+// textures: decode -> mips (nested parallel for) -> upload on the main thread
+//
+
+struct texture_task
+{
+    thread_pool *pool;
+    job_system *jobs;
+    int index;
+    int size;
+    std::vector<uint8_t> pixels;
+    mip_chain chain;
+    job_counter decoded;
+    job_counter *done;
+    uint64_t hash;
+};
+
+// stands in for a decoder: a gradient with noise, a few operations per byte
+static void
+decode_texture(void *user)
+{
+    texture_task *t = (texture_task *)user;
+    t->pixels.resize((size_t)t->size * t->size * 4);
+    uint32_t seed = 12345u + (uint32_t)t->index * 7919u;
+    for (int y = 0; y < t->size; ++y)
+    {
+        uint8_t *row = t->pixels.data() + (size_t)y * t->size * 4;
+        for (int x = 0; x < t->size; ++x)
+        {
+            int noise = (int)(next_random(&seed) & 15) - 8;
+            int r = x * 255 / t->size + noise;
+            int g = y * 255 / t->size + noise;
+            row[x * 4 + 0] = (uint8_t)(r < 0 ? 0 : (r > 255 ? 255 : r));
+            row[x * 4 + 1] = (uint8_t)(g < 0 ? 0 : (g > 255 ? 255 : g));
+            row[x * 4 + 2] = (uint8_t)(t->index * 37);
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
+static void
+upload_texture(void *user)
+{
+    texture_task *t = (texture_task *)user;
+    if (std::this_thread::get_id() != main_thread)
+        main_thread_misses.fetch_add(1);
+    uint64_t hash = 14695981039346656037ull;
+    for (int level = 1; level < t->chain.level_count; ++level)
+    {
+        const mip_level *l = &t->chain.levels[level];
+        hash = hash_bytes(hash, l->data, (size_t)l->pitch * l->height);
+    }
+    t->hash = hash;
+    mip_chain_free(&t->chain);
+}
+
+static void
+build_texture_mips(void *user)
+{
+    texture_task *t = (texture_task *)user;
+    mip_chain_build(&t->chain, t->pixels.data(), t->size, t->size, MIP_FILTER_KAISER, true, t->pool);
+    job_run_main(t->jobs, upload_texture, t, t->done);
+}
+
+//
+// frame: animate -> cull -> record -> submit on the main thread, one job per chunk per stage
+//
+
+struct frame_chunk
+{
+    int first;
+    int count;
+    const float *speed;
+    const float *position;
+    std::vector<float> angles[3];
+    mat4_soa world;
+    frustum_bounds spheres;
+    std::vector<uint32_t> visible;
+    uint32_t visible_count;
+    command_buffer commands;
+};
+
+struct frame_state
+{
+    job_system *jobs;
+    frame_chunk *chunks;
+    int chunk_count;
+    int frame;
+    mat4 view_proj;
+    frustum f;
+    job_counter animated;
+    job_counter culled;
+    job_counter recorded;
+    job_counter submitted;
+    uint32_t visible_total;
+    uint32_t draw_total;
+    uint64_t hash;
+};
+
+struct frame_job
+{
+    frame_state *state;
+    frame_chunk *chunk;
+};
+
+static void
+animate_chunk(void *user)
+{
+    frame_job *j = (frame_job *)user;
+    frame_chunk *c = j->chunk;
+    float t = (float)j->state->frame * 0.016f;
+    for (int i = 0; i < c->count; ++i)
+    {
+        const float *speed = c->speed + (size_t)(c->first + i) * 3;
+        for (int axis = 0; axis < 3; ++axis)
+            c->angles[axis][i] = speed[axis] * t;
+    }
+
+    // objects drift along x over time so the visible set changes from frame to frame
+    const float *p = c->position + (size_t)c->first * 3;
+    std::vector<float> tx(c->count), ty(c->count), tz(c->count);
+    for (int i = 0; i < c->count; ++i)
+    {
+        tx[i] = p[i * 3 + 0] + t * 20.0f;
+        ty[i] = p[i * 3 + 1];
+        tz[i] = p[i * 3 + 2];
+    }
+    mat4_soa_euler_translation(&c->world, c->angles[0].data(), c->angles[1].data(), c->angles[2].data(), tx.data(), ty.data(),
+        tz.data());
+    for (int i = 0; i < c->count; ++i)
+        frustum_bounds_set_sphere(&c->spheres, (size_t)i, tx[i], ty[i], tz[i], 1.8f);
+}
+
+static void
+cull_chunk(void *user)
+{
+    frame_job *j = (frame_job *)user;
+    frame_chunk *c = j->chunk;
+    c->visible_count = frustum_cull_spheres(&j->state->f, &c->spheres, 0, (size_t)c->count, c->visible.data());
+}
+
+static void
+record_chunk(void *user)
+{
+    frame_job *j = (frame_job *)user;
+    frame_chunk *c = j->chunk;
+    command_buffer_reset(&c->commands);
+    command_buffer_ia_set_primitive_topology(&c->commands, 4);
+    command_buffer_vs_set_shader(&c->commands, (void *)(uintptr_t)0x1000);
+    for (uint32_t k = 0; k < c->visible_count; ++k)
+    {
+        mat4 mvp = mat4_transpose(mat4_soa_get(&c->world, c->visible[k]) * j->state->view_proj);
+        command_buffer_vs_set_constants(&c->commands, 0, &mvp, sizeof(mvp));
+        command_buffer_draw_indexed(&c->commands, 36, 0, 0);
+    }
+}
+
+// stands in for replaying the buffers on the immediate context, which has to happen on the
+// thread that owns it
+static void
+submit_frame(void *user)
+{
+    frame_state *s = (frame_state *)user;
+    if (std::this_thread::get_id() != main_thread)
+        main_thread_misses.fetch_add(1);
+    for (int c = 0; c < s->chunk_count; ++c)
+    {
+        const frame_chunk *chunk = &s->chunks[c];
+        s->visible_total += chunk->visible_count;
+        s->draw_total += chunk->commands.draw_count;
+        s->hash = hash_bytes(s->hash, chunk->commands.data, chunk->commands.size);
+    }
+}
+
+static void
+queue_submit(void *user)
+{
+    frame_state *s = (frame_state *)user;
+    job_run_main(s->jobs, submit_frame, s, &s->submitted);
+}
+
+static void
+run_frame(job_system *jobs, frame_state *s, std::vector<frame_job> *frame_jobs)
+{
+    for (int c = 0; c < s->chunk_count; ++c)
+        job_run(jobs, animate_chunk, &(*frame_jobs)[c], &s->animated);
+    for (int c = 0; c < s->chunk_count; ++c)
+        job_run_after(jobs, &s->animated, cull_chunk, &(*frame_jobs)[c], &s->culled);
+    for (int c = 0; c < s->chunk_count; ++c)
+        job_run_after(jobs, &s->culled, record_chunk, &(*frame_jobs)[c], &s->recorded);
+    job_run_after(jobs, &s->recorded, queue_submit, s, &s->submitted);
+    job_wait(jobs, &s->submitted);
+}
+
+static mat4
+frame_view_proj(int frame)
+{
+    float yaw = (float)frame * 0.02f;
+    return mat4_rotation_y(-yaw) * mat4_perspective_fov_lh(simd_radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+}
+
+struct run_result
+{
+    double empty_seconds;
+    double texture_seconds;
+    double frame_seconds;
+    bool empty_ok;
+    bool nested_ok;
+    std::vector<uint64_t> texture_hashes;
+    std::vector<uint64_t> frame_hashes;
+    std::vector<uint32_t> frame_visible;
+};
+
+int
+main(int argc, char **argv)
+{
+    int max_threads = 64;
+    int object_count = 65536;
+    int texture_size = 512;
+    int texture_count = 32;
+    int frames = 20;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-t") == 0)
+            max_threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            object_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            texture_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-x") == 0)
+            texture_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+    }
+    const int empty_count = 200000;
+    main_thread = std::this_thread::get_id();
+
+    // objects scattered in a slab around the camera, each spinning at its own rate
+    uint32_t seed = 987654321u;
+    std::vector<float> speeds((size_t)object_count * 3);
+    std::vector<float> positions((size_t)object_count * 3);
+    for (int i = 0; i < object_count; ++i)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+            speeds[(size_t)i * 3 + axis] = (float)(next_random(&seed) % 2000) * 0.001f - 1.0f;
+        positions[(size_t)i * 3 + 0] = (float)(next_random(&seed) % 6000) * 0.1f - 300.0f;
+        positions[(size_t)i * 3 + 1] = (float)(next_random(&seed) % 400) * 0.1f - 20.0f;
+        positions[(size_t)i * 3 + 2] = (float)(next_random(&seed) % 6000) * 0.1f - 300.0f;
+    }
+
+    int chunk_count = (object_count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<frame_chunk> chunks(chunk_count);
+    for (int c = 0; c < chunk_count; ++c)
+    {
+        frame_chunk *chunk = &chunks[c];
+        chunk->first = c * CHUNK_SIZE;
+        chunk->count = object_count - chunk->first < CHUNK_SIZE ? object_count - chunk->first : CHUNK_SIZE;
+        chunk->speed = speeds.data();
+        chunk->position = positions.data();
+        for (int axis = 0; axis < 3; ++axis)
+            chunk->angles[axis].resize(chunk->count);
+        mat4_soa_init(&chunk->world, (size_t)chunk->count);
+        frustum_bounds_init(&chunk->spheres, (size_t)chunk->count, FRUSTUM_SPHERE_STREAMS);
+        chunk->visible.resize((size_t)chunk->count);
+        chunk->visible_count = 0;
+        command_buffer_init(&chunk->commands, 1 << 16);
+    }
+
+    mip_decode_table();
+    mip_decode16_table();
+    mip_encode_table();
+
+    printf("%d empty jobs, %d textures of %dx%d, %d objects in %d chunks, %d frames, simd path: %s, %u cores\n", empty_count,
+        texture_count, texture_size, texture_size, object_count, chunk_count, frames, SIMD_MATH_NAME,
+        std::thread::hardware_concurrency());
+    printf("%8s %12s %12s %12s %12s %10s\n", "threads", "Mjobs/s", "textures ms", "frame ms", "Mobjects/s", "speedup");
+
+    bool ok = true;
+    std::vector<run_result> results;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        thread_pool pool;
+        thread_pool_init(&pool, threads);
+        job_system *jobs = &pool.jobs;
+        run_result r;
+
+        // scheduling overhead, every job writes its own flag
+        {
+            std::vector<uint8_t> flags(empty_count, 0);
+            job_counter counter;
+            double start = now_seconds();
+            for (int i = 0; i < empty_count; ++i)
+                job_run(jobs, empty_job, &flags[i], &counter);
+            job_wait(jobs, &counter);
+            r.empty_seconds = now_seconds() - start;
+            r.empty_ok = counter.value.load() == 0;
+            for (int i = 0; i < empty_count; ++i)
+                r.empty_ok &= flags[i] == 1;
+        }
+
+        // parallel fors inside parallel fors, every (outer, inner) pair once
+        {
+            const int outer = 64;
+            const int inner = 4096;
+            std::vector<std::atomic<int>> hits((size_t)outer * inner);
+            for (std::atomic<int> &h : hits)
+                h.store(0);
+            thread_pool_parallel_for(&pool, outer, [&](int o) {
+                thread_pool_parallel_for(&pool, inner, [&](int i) { hits[(size_t)o * inner + i].fetch_add(1, std::memory_order_relaxed); });
+            });
+            r.nested_ok = true;
+            for (std::atomic<int> &h : hits)
+                r.nested_ok &= h.load() == 1;
+        }
+
+        // texture graph
+        {
+            std::vector<texture_task> tasks(texture_count);
+            job_counter done;
+            double start = now_seconds();
+            for (int t = 0; t < texture_count; ++t)
+            {
+                texture_task *task = &tasks[t];
+                task->pool = &pool;
+                task->jobs = jobs;
+                task->index = t;
+                task->size = texture_size;
+                task->done = &done;
+                task->hash = 0;
+                job_run(jobs, decode_texture, task, &task->decoded);
+                job_run_after(jobs, &task->decoded, build_texture_mips, task, &done);
+            }
+            job_wait(jobs, &done);
+            r.texture_seconds = now_seconds() - start;
+            for (int t = 0; t < texture_count; ++t)
+                r.texture_hashes.push_back(tasks[t].hash);
+        }
+
+        // frame graph
+        {
+            double start = now_seconds();
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                frame_state s;
+                s.jobs = jobs;
+                s.chunks = chunks.data();
+                s.chunk_count = chunk_count;
+                s.frame = frame;
+                s.view_proj = frame_view_proj(frame);
+                s.f = frustum_from_matrix(s.view_proj);
+                s.visible_total = 0;
+                s.draw_total = 0;
+                s.hash = 14695981039346656037ull;
+                std::vector<frame_job> frame_jobs(chunk_count);
+                for (int c = 0; c < chunk_count; ++c)
+                    frame_jobs[c] = {&s, &chunks[c]};
+                run_frame(jobs, &s, &frame_jobs);
+                r.frame_hashes.push_back(s.hash);
+                r.frame_visible.push_back(s.visible_total);
+                if (s.draw_total != s.visible_total)
+                    ok = false;
+            }
+            r.frame_seconds = (now_seconds() - start) / frames;
+        }
+
+        thread_pool_shutdown(&pool);
+
+        ok &= r.empty_ok && r.nested_ok;
+        if (results.empty() == false)
+        {
+            const run_result &reference = results[0];
+            ok &= r.texture_hashes == reference.texture_hashes;
+            ok &= r.frame_hashes == reference.frame_hashes;
+        }
+        double speedup = results.empty() ? 1.0 : results[0].frame_seconds / r.frame_seconds;
+        printf("%8d %12.2f %12.1f %12.2f %12.1f %9.2fx%s\n", threads, empty_count / r.empty_seconds * 1e-6, r.texture_seconds * 1000.0,
+            r.frame_seconds * 1000.0, object_count / r.frame_seconds * 1e-6, speedup, r.empty_ok && r.nested_ok ? "" : "  MISMATCH");
+        results.push_back(r);
+    }
+
+    uint32_t visible_sum = 0;
+    for (uint32_t v : results[0].frame_visible)
+        visible_sum += v;
+    printf("%.1f visible objects per frame\n", (double)visible_sum / frames);
+
+    ok &= main_thread_misses.load() == 0;
+    ok &= visible_sum > 0 && visible_sum < (uint32_t)object_count * (uint32_t)frames;
+
+    for (frame_chunk &chunk : chunks)
+    {
+        mat4_soa_free(&chunk.world);
+        frustum_bounds_free(&chunk.spheres);
+        command_buffer_free(&chunk.commands);
+    }
+
+    printf("jobs checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
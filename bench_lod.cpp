@@ -0,0 +1,299 @@
+// builds lod chains with mesh_simplify.h for a uv sphere and a noisy terrain patch and reports
+// triangles, error and build time per level. then flies a camera through a field of sphere
+// instances: every frame culls them against the frustum (frustum_cull.h), picks a level per
+// instance from the screen space error for a 720 pixel high viewport (mesh_lod.h) and counts
+// the triangles submitted with and without lod.
+// checks that every level has fewer triangles than the one before and stays under the error
+// budget, that the sphere levels stay closed with no triangle turned inside out, and that the
+// SIMD selection matches mesh_lod_select.
+// usage: bench_lod [-n instances] [-r rings] [-f frames] [-p pixel error] [-s seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "frustum_cull.h"
+#include "mesh_lod.h"
+#include "mesh_simplify.h"
+#include "simd_math.h"
+
+#define VIEWPORT_HEIGHT 720.0f
+#define SPHERE_RADIUS 2.0f
+
+struct mesh
+{
+    std::vector<float> positions; // xyz per vertex
+    std::vector<uint32_t> indices;
+};
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static float
+random_range(uint64_t *state, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(next_random(state) & 0xffffff) / (float)0xffffff;
+}
+
+// wound like the cube of the examples, (b - a) x (c - a) points out. the seam and the poles
+// repeat positions
+static mesh
+make_sphere(int rings, int segments, float radius)
+{
+    mesh m;
+    for (int r = 0; r <= rings; ++r)
+    {
+        float theta = 3.14159265f * (float)r / (float)rings;
+        for (int s = 0; s <= segments; ++s)
+        {
+            // the seam and the poles land on exactly the same positions
+            float phi = 2.0f * 3.14159265f * (float)(s % segments) / (float)segments;
+            float ring = r == 0 || r == rings ? 0.0f : radius * sinf(theta);
+            float y = r == 0 ? radius : r == rings ? -radius : radius * cosf(theta);
+            m.positions.insert(m.positions.end(), {ring * cosf(phi), y, ring * sinf(phi)});
+        }
+    }
+    for (int r = 0; r < rings; ++r)
+    {
+        for (int s = 0; s < segments; ++s)
+        {
+            uint32_t a = (uint32_t)(r * (segments + 1) + s);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(segments + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, b, c, b, d, c});
+        }
+    }
+    return m;
+}
+
+// a grid with rolling hills and a little noise, open on all four sides
+static mesh
+make_terrain(int size, uint64_t *state)
+{
+    mesh m;
+    for (int z = 0; z <= size; ++z)
+    {
+        for (int x = 0; x <= size; ++x)
+        {
+            float height = 2.0f * sinf((float)x * 0.05f) * cosf((float)z * 0.07f) + random_range(state, -0.02f, 0.02f);
+            m.positions.insert(m.positions.end(), {(float)x, height, (float)z});
+        }
+    }
+    for (int z = 0; z < size; ++z)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint32_t a = (uint32_t)(z * (size + 1) + x);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(size + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return m;
+}
+
+// every edge between two positions has its twin and every triangle faces away from the center
+static bool
+sphere_level_valid(const mesh *m, const std::vector<uint32_t> &indices)
+{
+    std::vector<uint32_t> remap;
+    mesh_simplify_position_remap(&remap, m->positions.data(), m->positions.size() / 3, 3 * sizeof(float));
+    std::vector<uint64_t> edges;
+    mesh_simplify_edges(&edges, indices.data(), indices.size(), remap.data());
+    for (uint64_t edge : edges)
+    {
+        uint32_t a = (uint32_t)(edge >> 32), b = (uint32_t)edge;
+        if (a != b && mesh_simplify_has_edge(edges, b, a) == false)
+            return false;
+    }
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const float *p[3];
+        for (int c = 0; c < 3; ++c)
+            p[c] = &m->positions[(size_t)indices[t + c] * 3];
+        double n[3];
+        mesh_simplify_normal(p[0], p[1], p[2], n);
+        if (n[0] == 0.0 && n[1] == 0.0 && n[2] == 0.0)
+            continue; // the pole triangles
+        double centroid[3];
+        for (int i = 0; i < 3; ++i)
+            centroid[i] = p[0][i] + p[1][i] + p[2][i];
+        // slivers standing on edge between seam vertices in the z = 0 plane come out at exactly 0
+        if (n[0] * centroid[0] + n[1] * centroid[1] + n[2] * centroid[2] < 0.0)
+            return false;
+    }
+    return true;
+}
+
+static bool
+build_chain(const char *name, const mesh *m, float max_error, std::vector<mesh_lod> *lods)
+{
+    double start = now_seconds();
+    mesh_build_lods(lods, m->indices.data(), m->indices.size(), m->positions.data(), m->positions.size() / 3, 3 * sizeof(float),
+        MESH_LOD_MAX_LEVELS, 0.5f, max_error);
+    double ms = (now_seconds() - start) * 1000.0;
+
+    bool ok = lods->size() > 1;
+    for (size_t level = 0; level < lods->size(); ++level)
+    {
+        const mesh_lod &lod = (*lods)[level];
+        bool fewer = level == 0 || lod.indices.size() < (*lods)[level - 1].indices.size();
+        bool bounded = lod.error <= max_error;
+        ok = ok && fewer && bounded;
+        printf("%-8s %6zu %10zu %12.5f%s%s\n", level == 0 ? name : "", level, lod.indices.size() / 3, lod.error,
+            fewer ? "" : "  NOT FEWER", bounded ? "" : "  OVER BUDGET");
+    }
+    printf("%-8s %zu levels in %.1f ms\n", "", lods->size(), ms);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    int instance_count = 20000;
+    int rings = 64;
+    int frames = 240;
+    float pixel_error = 1.0f;
+    uint64_t state = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            instance_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            rings = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-p") == 0)
+            pixel_error = (float)atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            state = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    mesh sphere = make_sphere(rings, rings * 2, SPHERE_RADIUS);
+    mesh terrain = make_terrain(rings * 2, &state);
+
+    printf("%-8s %6s %10s %12s\n", "mesh", "level", "triangles", "error");
+    std::vector<mesh_lod> sphere_lods, terrain_lods;
+    bool ok = build_chain("sphere", &sphere, SPHERE_RADIUS * 0.25f, &sphere_lods);
+    ok = build_chain("terrain", &terrain, 1.0f, &terrain_lods) && ok;
+    for (size_t level = 0; level < sphere_lods.size(); ++level)
+    {
+        if (sphere_level_valid(&sphere, sphere_lods[level].indices) == false)
+        {
+            printf("sphere level %zu is open or has flipped triangles\n", level);
+            ok = false;
+        }
+    }
+
+    int level_count = (int)sphere_lods.size();
+    float errors[MESH_LOD_MAX_LEVELS];
+    uint64_t level_triangles[MESH_LOD_MAX_LEVELS];
+    for (int level = 0; level < level_count; ++level)
+    {
+        errors[level] = sphere_lods[level].error;
+        level_triangles[level] = sphere_lods[level].indices.size() / 3;
+    }
+
+    // the same projection the examples draw with
+    float aspect = 1280.0f / VIEWPORT_HEIGHT;
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), aspect, 0.1f, 2000.0f);
+    float distances[MESH_LOD_MAX_LEVELS];
+    mesh_lod_switch_distances(distances, errors, level_count, proj, VIEWPORT_HEIGHT, pixel_error);
+    printf("\n%.1f pixel error, switch distances:", pixel_error);
+    for (int level = 0; level < level_count; ++level)
+        printf(" %.1f", distances[level]);
+    printf("\n");
+
+    // spheres scattered over a square around the camera path
+    frustum_bounds spheres;
+    if (frustum_bounds_init(&spheres, (size_t)instance_count, FRUSTUM_SPHERE_STREAMS) == false)
+        return 1;
+    float field = sqrtf((float)instance_count) * 5.0f;
+    for (int i = 0; i < instance_count; ++i)
+    {
+        frustum_bounds_set_sphere(&spheres, (size_t)i, random_range(&state, -field, field), random_range(&state, 0.0f, 20.0f),
+            random_range(&state, -field, field), SPHERE_RADIUS);
+    }
+
+    std::vector<uint32_t> visible(instance_count);
+    std::vector<uint8_t> levels(instance_count);
+    uint64_t full_triangles = 0, lod_triangles = 0, visible_total = 0;
+    uint64_t level_histogram[MESH_LOD_MAX_LEVELS] = {};
+    double select_seconds = 0.0;
+    int mismatches = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        float t = (float)frame / (float)(frames > 1 ? frames - 1 : 1);
+        float eye[3] = {0.0f, 8.0f, -field + 2.0f * field * t};
+        float yaw = 6.2831853f * t;
+        mat4 view = mat4_translation(-eye[0], -eye[1], -eye[2]) * mat4_rotation_y(-yaw);
+        frustum f = frustum_from_matrix(view * proj);
+        uint32_t visible_count = frustum_cull_spheres(&f, &spheres, 0, spheres.count, visible.data());
+
+        double start = now_seconds();
+        mesh_lod_select_spheres(levels.data(), &spheres, eye, distances, level_count);
+        select_seconds += now_seconds() - start;
+
+        for (uint32_t v = 0; v < visible_count; ++v)
+        {
+            uint32_t i = visible[v];
+            full_triangles += level_triangles[0];
+            lod_triangles += level_triangles[levels[i]];
+            level_histogram[levels[i]]++;
+        }
+        visible_total += visible_count;
+
+        // the scalar pick on the distance to the sphere surface, may only differ by rounding at a switch
+        const float *xs = frustum_bounds_stream(&spheres, 0);
+        const float *ys = frustum_bounds_stream(&spheres, 1);
+        const float *zs = frustum_bounds_stream(&spheres, 2);
+        for (int i = 0; i < instance_count; ++i)
+        {
+            float dx = xs[i] - eye[0], dy = ys[i] - eye[1], dz = zs[i] - eye[2];
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz) - SPHERE_RADIUS;
+            int expected = mesh_lod_select(distances, level_count, distance > 0.0f ? distance : 0.0f);
+            if (expected != levels[i])
+            {
+                int level = std::max(expected, (int)levels[i]);
+                if (fabsf(distance - distances[level]) > distances[level] * 1e-4f + 1e-4f)
+                    mismatches++;
+            }
+        }
+    }
+    frustum_bounds_free(&spheres);
+
+    double frame_count = frames > 0 ? (double)frames : 1.0;
+    printf("%d instances, %d frames, %.0f visible per frame\n", instance_count, frames, (double)visible_total / frame_count);
+    printf("%-22s %14.0f\n", "triangles without lod", (double)full_triangles / frame_count);
+    printf("%-22s %14.0f  (%.1f%%)\n", "triangles with lod", (double)lod_triangles / frame_count,
+        full_triangles ? 100.0 * (double)lod_triangles / (double)full_triangles : 0.0);
+    printf("%-22s", "visible per level");
+    for (int level = 0; level < level_count; ++level)
+        printf(" %.0f", (double)level_histogram[level] / frame_count);
+    printf("\n");
+    printf("%-22s %14.3f ms per frame, %s %d wide\n", "lod selection", select_seconds * 1000.0 / frame_count, SIMD_MATH_NAME,
+        SIMD_MATH_WIDTH);
+
+    if (mismatches)
+        printf("%d selections differ from mesh_lod_select\n", mismatches);
+    ok = ok && mismatches == 0 && lod_triangles <= full_triangles;
+    printf("lod checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+// compares building example_cubes style mvp matrices one call at a time against the
+// simd_math.h batch path, usage: bench_math [-n objects] [-i iterations]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "simd_math.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int
+main(int argc, char **argv)
+{
+    int object_count = 100000;
+    int iterations = 20;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            object_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-i") == 0)
+            iterations = atoi(argv[i + 1]);
+    }
+
+    // per object rotation angles and positions
+    std::vector<float> angle_x(object_count), angle_y(object_count), angle_z(object_count);
+    std::vector<float> tx(object_count), ty(object_count), tz(object_count);
+    for (int i = 0; i < object_count; ++i)
+    {
+        angle_x[i] = (float)i * 0.001f;
+        angle_y[i] = (float)i * 0.002f - 50.0f;
+        angle_z[i] = (float)i * 0.0005f;
+        tx[i] = (float)(i % 100) - 50.0f;
+        ty[i] = (float)((i / 100) % 100) - 50.0f;
+        tz[i] = 5.0f + (float)(i / 10000);
+    }
+
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    // cbuffer ready output, one transposed mvp per object
+    std::vector<float> single_out((size_t)object_count * 16);
+    std::vector<float> batch_out((size_t)object_count * 16);
+
+    // one matrix per call, the way example_cubes builds them
+    double single_seconds = 0.0;
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        double start = now_seconds();
+        for (int i = 0; i < object_count; ++i)
+        {
+            mat4 mvp = mat4_transpose(
+                mat4_rotation_x(angle_x[i]) *
+                mat4_rotation_y(angle_y[i]) *
+                mat4_rotation_z(angle_z[i]) *
+                mat4_translation(tx[i], ty[i], tz[i]) *
+                proj
+            );
+            mat4_store(&single_out[(size_t)i * 16], mvp);
+        }
+        single_seconds += now_seconds() - start;
+    }
+
+    // SoA batch, SIMD_MATH_WIDTH objects per step
+    mat4_soa world;
+    if (mat4_soa_init(&world, object_count) == false)
+    {
+        fprintf(stderr, "Failed to allocate matrices\n");
+        return 1;
+    }
+
+    double batch_seconds = 0.0;
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        double start = now_seconds();
+        mat4_soa_euler_translation(&world, angle_x.data(), angle_y.data(), angle_z.data(), tx.data(), ty.data(), tz.data());
+        mat4_soa_mul_mat4(&world, &world, proj);
+        mat4_soa_store_transposed(batch_out.data(), &world);
+        batch_seconds += now_seconds() - start;
+    }
+
+    float max_error = 0.0f;
+    for (size_t i = 0; i < single_out.size(); ++i)
+    {
+        float error = fabsf(single_out[i] - batch_out[i]);
+        max_error = error > max_error ? error : max_error;
+    }
+
+    double total = (double)object_count * iterations;
+    printf("simd path: %s, width %d\n", SIMD_MATH_NAME, SIMD_MATH_WIDTH);
+    printf("single: %.2f ns/matrix\n", single_seconds * 1e9 / total);
+    printf("batch:  %.2f ns/matrix (%.2fx)\n", batch_seconds * 1e9 / total, single_seconds / batch_seconds);
+    printf("max abs difference: %g\n", max_error);
+
+    mat4_soa_free(&world);
+    return 0;
+}
@@ -0,0 +1,338 @@
+// loads a generated multi-million triangle mesh the three ways mesh_import.h and mesh_file.h
+// offer: parsing .obj text, reading a .glb and mapping the cooked file. the source formats are
+// imported on one thread and on the pool and quantized the way cook_mesh does it, every path
+// ends with the vertex and index bytes copied into a staging buffer, which stands in for the
+// driver reading pSysMem. cold runs drop the files from the os page cache first, warm ones
+// are the average of the runs after. checks that both imports give back the generated
+// triangles and that the cooked bytes match a fresh encode.
+// usage: bench_mesh_load [-n grid size] [-i iterations] [-t threads] [-d directory]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "mesh_file.h"
+#include "mesh_import.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a rolling terrain, left handed with clockwise triangles like the examples
+static mesh_data
+make_terrain(int size)
+{
+    mesh_data m;
+    for (int y = 0; y <= size; ++y)
+    {
+        for (int x = 0; x <= size; ++x)
+        {
+            float u = (float)x / (float)size, v = (float)y / (float)size;
+            m.positions.insert(m.positions.end(), {u * 1000.0f - 500.0f, sinf(u * 40.0f) * cosf(v * 30.0f) * 20.0f, v * 1000.0f - 500.0f});
+            m.uvs.insert(m.uvs.end(), {u * 16.0f, v * 16.0f});
+        }
+    }
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint32_t a = (uint32_t)(y * (size + 1) + x);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(size + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return m;
+}
+
+// right handed with counter clockwise triangles and uv origin at the bottom, what the importer
+// turns back into the generated mesh
+static bool
+write_obj(const char *path, const mesh_data *m)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    size_t vertex_count = m->positions.size() / 3;
+    for (size_t v = 0; v < vertex_count; ++v)
+        fprintf(file, "v %.9g %.9g %.9g\n", m->positions[v * 3], m->positions[v * 3 + 1], -m->positions[v * 3 + 2]);
+    for (size_t v = 0; v < vertex_count; ++v)
+        fprintf(file, "vt %.9g %.9g\n", m->uvs[v * 2], 1.0f - m->uvs[v * 2 + 1]);
+    for (size_t i = 0; i + 2 < m->indices.size(); i += 3)
+    {
+        uint32_t a = m->indices[i] + 1, b = m->indices[i + 1] + 1, c = m->indices[i + 2] + 1;
+        fprintf(file, "f %u/%u %u/%u %u/%u\n", a, a, c, c, b, b);
+    }
+    bool ok = ferror(file) == 0;
+    return fclose(file) == 0 && ok;
+}
+
+static bool
+write_glb(const char *path, const mesh_data *m)
+{
+    size_t vertex_count = m->positions.size() / 3;
+    std::vector<float> positions(m->positions.size());
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        positions[v * 3] = m->positions[v * 3];
+        positions[v * 3 + 1] = m->positions[v * 3 + 1];
+        positions[v * 3 + 2] = -m->positions[v * 3 + 2];
+    }
+    std::vector<uint32_t> indices(m->indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        indices[i] = m->indices[i];
+        indices[i + 1] = m->indices[i + 2];
+        indices[i + 2] = m->indices[i + 1];
+    }
+
+    size_t position_bytes = positions.size() * sizeof(float);
+    size_t uv_bytes = m->uvs.size() * sizeof(float);
+    size_t index_bytes = indices.size() * sizeof(uint32_t);
+    size_t bin_size = position_bytes + uv_bytes + index_bytes;
+    char json[2048];
+    int json_length = snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1},\"indices\":2}]}],"
+        "\"buffers\":[{\"byteLength\":%zu}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+        "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+        "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+        "{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+        "{\"bufferView\":2,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+        bin_size, position_bytes, position_bytes, uv_bytes, position_bytes + uv_bytes, index_bytes, vertex_count, vertex_count,
+        indices.size());
+    while (json_length % 4 != 0)
+        json[json_length++] = ' ';
+
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    uint32_t header[5] = {0x46546c67, 2, (uint32_t)(12 + 8 + json_length + 8 + bin_size), (uint32_t)json_length, 0x4e4f534a};
+    uint32_t bin_header[2] = {(uint32_t)bin_size, 0x004e4942};
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(json, 1, (size_t)json_length, file) == (size_t)json_length &&
+        fwrite(bin_header, sizeof(bin_header), 1, file) == 1 && fwrite(positions.data(), 1, position_bytes, file) == position_bytes &&
+        fwrite(m->uvs.data(), 1, uv_bytes, file) == uv_bytes && fwrite(indices.data(), 1, index_bytes, file) == index_bytes;
+    return fclose(file) == 0 && ok;
+}
+
+// flushes the file and asks the os to forget its cached pages. opening a handle without
+// buffering makes windows purge the file from its cache
+static bool
+drop_file_cache(const char *path)
+{
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    CloseHandle(handle);
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#endif
+}
+
+static uint64_t
+file_size(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr)
+        return 0;
+#if defined(_WIN32)
+    _fseeki64(f, 0, SEEK_END);
+    uint64_t size = (uint64_t)_ftelli64(f);
+#else
+    fseeko(f, 0, SEEK_END);
+    uint64_t size = (uint64_t)ftello(f);
+#endif
+    fclose(f);
+    return size;
+}
+
+enum load_path
+{
+    LOAD_OBJ,
+    LOAD_GLB,
+    LOAD_COOKED,
+};
+
+// everything up to the bytes CreateBuffer would read, staging receives them
+static bool
+load(load_path path, const char *file_path, const mesh_encoding *encoding, thread_pool *pool, std::vector<uint8_t> *staging)
+{
+    if (path == LOAD_COOKED)
+    {
+        mesh_file file;
+        if (mesh_file_open(&file, file_path) == false)
+            return false;
+        size_t vertex_size = (size_t)file.header->vertex_size;
+        size_t index_size = (size_t)file.header->index_size;
+        staging->resize(vertex_size + index_size);
+        memcpy(staging->data(), mesh_file_vertices(&file), vertex_size);
+        memcpy(staging->data() + vertex_size, mesh_file_indices(&file), index_size);
+        mesh_file_close(&file);
+        return true;
+    }
+
+    mesh_data mesh;
+    bool ok = path == LOAD_OBJ ? mesh_import_obj(file_path, &mesh, pool) : mesh_import_gltf(file_path, &mesh, pool);
+    if (ok == false)
+        return false;
+    mesh_source source = mesh_data_source(&mesh);
+    mesh_encoded encoded;
+    if (mesh_encode(&source, encoding, &encoded) == false)
+        return false;
+    staging->resize(encoded.vertices.size() + encoded.indices.size());
+    memcpy(staging->data(), encoded.vertices.data(), encoded.vertices.size());
+    memcpy(staging->data() + encoded.vertices.size(), encoded.indices.data(), encoded.indices.size());
+    return true;
+}
+
+// every triangle corner of the import at the position of the generated one
+static bool
+same_triangles(const mesh_data *imported, const mesh_data *reference, float tolerance)
+{
+    if (imported->indices.size() != reference->indices.size() || imported->uvs.empty())
+        return false;
+    for (size_t i = 0; i < reference->indices.size(); ++i)
+    {
+        const float *a = &imported->positions[(size_t)imported->indices[i] * 3];
+        const float *b = &reference->positions[(size_t)reference->indices[i] * 3];
+        const float *uv_a = &imported->uvs[(size_t)imported->indices[i] * 2];
+        const float *uv_b = &reference->uvs[(size_t)reference->indices[i] * 2];
+        for (int c = 0; c < 3; ++c)
+        {
+            if (fabsf(a[c] - b[c]) > tolerance * fmaxf(1.0f, fabsf(b[c])))
+                return false;
+        }
+        for (int c = 0; c < 2; ++c)
+        {
+            if (fabsf(uv_a[c] - uv_b[c]) > tolerance * fmaxf(1.0f, fabsf(uv_b[c])))
+                return false;
+        }
+    }
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    int grid_size = 1000;
+    int iterations = 3;
+    int threads = 0;
+    std::string directory = ".";
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            grid_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-i") == 0)
+            iterations = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            directory = argv[i + 1];
+    }
+    if (iterations < 1)
+        iterations = 1;
+
+    std::string obj_path = directory + "/bench_mesh_load.obj";
+    std::string glb_path = directory + "/bench_mesh_load.glb";
+    std::string cooked_path = directory + "/bench_mesh_load.mesh";
+
+    double start = now_seconds();
+    mesh_data terrain = make_terrain(grid_size);
+    mesh_encoding encoding = {MESH_POSITION_SNORM16, MESH_UV_UNORM16, MESH_COLOR_RGBA8, false};
+    mesh_source source = mesh_data_source(&terrain);
+    mesh_encoded encoded;
+    if (mesh_encode(&source, &encoding, &encoded) == false || write_obj(obj_path.c_str(), &terrain) == false ||
+        write_glb(glb_path.c_str(), &terrain) == false || mesh_file_write(cooked_path.c_str(), &encoded) == false)
+    {
+        fprintf(stderr, "Failed to write the meshes to %s\n", directory.c_str());
+        return 1;
+    }
+    printf("%zu vertices, %zu triangles, files written in %.1f s\n", terrain.positions.size() / 3, terrain.indices.size() / 3,
+        now_seconds() - start);
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    // the imports have to give back the generated mesh, obj goes through text
+    bool ok = true;
+    {
+        mesh_data imported;
+        bool obj_same = mesh_import_obj(obj_path.c_str(), &imported, &pool) && same_triangles(&imported, &terrain, 1e-6f);
+        bool glb_same = mesh_import_gltf(glb_path.c_str(), &imported, &pool) && same_triangles(&imported, &terrain, 0.0f);
+        std::vector<uint8_t> staging;
+        bool cooked_same = load(LOAD_COOKED, cooked_path.c_str(), &encoding, &pool, &staging) &&
+            staging.size() == encoded.vertices.size() + encoded.indices.size() &&
+            memcmp(staging.data(), encoded.vertices.data(), encoded.vertices.size()) == 0 &&
+            memcmp(staging.data() + encoded.vertices.size(), encoded.indices.data(), encoded.indices.size()) == 0;
+        ok = obj_same && glb_same && cooked_same;
+        printf("obj %s, glb %s, cooked %s\n", obj_same ? "matches" : "DIFFERS", glb_same ? "matches" : "DIFFERS",
+            cooked_same ? "matches" : "DIFFERS");
+    }
+
+    printf("%-8s %8s %10s %10s %10s %12s\n", "format", "threads", "file MB", "cold ms", "warm ms", "warm MB/s");
+    struct run
+    {
+        load_path path;
+        const char *name;
+        const std::string *file;
+        bool serial;
+    };
+    run runs[] = {
+        {LOAD_OBJ, "obj", &obj_path, true},
+        {LOAD_OBJ, "obj", &obj_path, false},
+        {LOAD_GLB, "glb", &glb_path, true},
+        {LOAD_GLB, "glb", &glb_path, false},
+        {LOAD_COOKED, "cooked", &cooked_path, true},
+    };
+    bool cold = true;
+    for (const run &r : runs)
+    {
+        thread_pool *run_pool = r.serial ? nullptr : &pool;
+        const char *path = r.file->c_str();
+        double mb = (double)file_size(path) / (1024.0 * 1024.0);
+        std::vector<uint8_t> staging;
+
+        cold = drop_file_cache(path) && cold;
+        start = now_seconds();
+        bool loaded = load(r.path, path, &encoding, run_pool, &staging);
+        double cold_ms = (now_seconds() - start) * 1000.0;
+
+        double warm_ms = 0.0;
+        for (int i = 0; i < iterations && loaded; ++i)
+        {
+            start = now_seconds();
+            loaded = load(r.path, path, &encoding, run_pool, &staging);
+            warm_ms += (now_seconds() - start) * 1000.0;
+        }
+        warm_ms /= iterations;
+        ok = ok && loaded;
+        printf("%-8s %8d %10.1f %10.1f %10.1f %12.1f%s\n", r.name, r.serial ? 1 : thread_pool_size(&pool), mb, cold_ms, warm_ms,
+            mb / (warm_ms / 1000.0), loaded ? "" : "  FAILED");
+    }
+    if (cold == false)
+        printf("could not drop the page cache, cold runs may be warm\n");
+
+    thread_pool_shutdown(&pool);
+    remove(obj_path.c_str());
+    remove(glb_path.c_str());
+    remove(cooked_path.c_str());
+
+    printf("mesh load checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
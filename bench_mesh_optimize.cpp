@@ -0,0 +1,201 @@
+// reorders generated meshes with mesh_optimize.h: a regular grid, a uv sphere and a grid whose
+// triangles and vertices were shuffled the way an exporter without an optimizer leaves them.
+// reports acmr, atvr and overfetch in input order and after tipsify and forsyth followed by
+// the fetch reorder, and triangles optimized per ms. checks that every mesh still has exactly
+// its triangles with the same positions and that neither ordering is worse than the input.
+// usage: bench_mesh_optimize [-n grid size] [-c cache size] [-s seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <vector>
+
+#include "mesh_optimize.h"
+
+struct mesh
+{
+    std::vector<float> positions; // xyz per vertex
+    std::vector<uint32_t> indices;
+};
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static mesh
+make_grid(int size)
+{
+    mesh m;
+    for (int y = 0; y <= size; ++y)
+        for (int x = 0; x <= size; ++x)
+            m.positions.insert(m.positions.end(), {(float)x, (float)y, 0.0f});
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint32_t a = (uint32_t)(y * (size + 1) + x);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(size + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return m;
+}
+
+static mesh
+make_sphere(int rings, int segments)
+{
+    mesh m;
+    for (int r = 0; r <= rings; ++r)
+    {
+        float theta = 3.14159265f * (float)r / (float)rings;
+        for (int s = 0; s <= segments; ++s)
+        {
+            float phi = 2.0f * 3.14159265f * (float)s / (float)segments;
+            m.positions.insert(m.positions.end(), {sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)});
+        }
+    }
+    for (int r = 0; r < rings; ++r)
+    {
+        for (int s = 0; s < segments; ++s)
+        {
+            uint32_t a = (uint32_t)(r * (segments + 1) + s);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(segments + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return m;
+}
+
+// shuffles triangle order and vertex numbering
+static void
+shuffle_mesh(mesh *m, uint64_t *state)
+{
+    size_t triangle_count = m->indices.size() / 3;
+    for (size_t i = triangle_count; i > 1; --i)
+    {
+        size_t j = next_random(state) % i;
+        for (int c = 0; c < 3; ++c)
+            std::swap(m->indices[(i - 1) * 3 + c], m->indices[j * 3 + c]);
+    }
+
+    size_t vertex_count = m->positions.size() / 3;
+    std::vector<uint32_t> order(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        order[v] = (uint32_t)v;
+    for (size_t i = vertex_count; i > 1; --i)
+        std::swap(order[i - 1], order[next_random(state) % i]);
+
+    std::vector<float> positions(m->positions.size());
+    for (size_t v = 0; v < vertex_count; ++v)
+        memcpy(&positions[(size_t)order[v] * 3], &m->positions[v * 3], 3 * sizeof(float));
+    m->positions.swap(positions);
+    for (uint32_t &index : m->indices)
+        index = order[index];
+}
+
+// every triangle as its 9 coordinates, rotated so the smallest corner comes first, sorted
+static std::vector<std::array<float, 9>>
+triangle_set(const mesh *m)
+{
+    std::vector<std::array<float, 9>> set;
+    for (size_t t = 0; t + 2 < m->indices.size(); t += 3)
+    {
+        std::array<std::array<float, 3>, 3> corners;
+        for (int c = 0; c < 3; ++c)
+            memcpy(corners[c].data(), &m->positions[(size_t)m->indices[t + c] * 3], 3 * sizeof(float));
+        int first = (int)(std::min_element(corners.begin(), corners.end()) - corners.begin());
+        std::array<float, 9> tri;
+        for (int c = 0; c < 3; ++c)
+            memcpy(&tri[c * 3], corners[(first + c) % 3].data(), 3 * sizeof(float));
+        set.push_back(tri);
+    }
+    std::sort(set.begin(), set.end());
+    return set;
+}
+
+int
+main(int argc, char **argv)
+{
+    int grid_size = 300;
+    uint32_t cache_size = MESH_CACHE_SIZE;
+    uint64_t state = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            grid_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            cache_size = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            state = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    const char *mesh_names[] = {"grid", "sphere", "shuffled grid"};
+    mesh meshes[3] = {make_grid(grid_size), make_sphere(grid_size / 2, grid_size), make_grid(grid_size)};
+    shuffle_mesh(&meshes[2], &state);
+
+    const char *method_names[] = {"input order", "tipsify + fetch", "forsyth + fetch"};
+    printf("fifo cache %u, 12 byte vertices\n", cache_size);
+    printf("%-24s %-16s %8s %8s %10s %12s\n", "mesh", "order", "acmr", "atvr", "overfetch", "tris/ms");
+
+    bool ok = true;
+    for (int m = 0; m < 3; ++m)
+    {
+        const mesh *input = &meshes[m];
+        std::vector<std::array<float, 9>> reference = triangle_set(input);
+        size_t index_count = input->indices.size();
+        size_t vertex_count = input->positions.size() / 3;
+
+        float input_acmr = 0.0f;
+        for (int method = 0; method < 3; ++method)
+        {
+            mesh out = *input;
+            double start = now_seconds();
+            if (method == 1)
+                mesh_optimize_vertex_cache(out.indices.data(), out.indices.data(), index_count, vertex_count, cache_size);
+            else if (method == 2)
+                mesh_optimize_vertex_cache_forsyth(out.indices.data(), out.indices.data(), index_count, vertex_count);
+            if (method != 0)
+            {
+                size_t used = mesh_optimize_vertex_fetch(out.positions.data(), out.indices.data(), index_count,
+                    out.positions.data(), vertex_count, 3 * sizeof(float));
+                out.positions.resize(used * 3);
+            }
+            double ms = (now_seconds() - start) * 1000.0;
+
+            mesh_analysis a = mesh_analyze(out.indices.data(), index_count, out.positions.size() / 3, 3 * sizeof(float), cache_size);
+            if (method == 0)
+            {
+                input_acmr = a.acmr;
+                printf("%-24s %-16s %8.3f %8.3f %10.3f %12s\n", mesh_names[m], method_names[method], a.acmr, a.atvr, a.overfetch, "");
+                continue;
+            }
+
+            bool same = triangle_set(&out) == reference;
+            bool better = a.acmr <= input_acmr;
+            ok = ok && same && better;
+            printf("%-24s %-16s %8.3f %8.3f %10.3f %12.0f%s%s\n", mesh_names[m], method_names[method], a.acmr, a.atvr, a.overfetch,
+                a.triangles / ms, same ? "" : "  triangles DIFFER", better ? "" : "  WORSE");
+        }
+    }
+
+    printf("mesh optimize checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+// encodes generated meshes with mesh_quantize.h: the example cube, a grid with uvs and colors
+// small enough for 16 bit indices and a sphere too big for them. reports the vertex stride,
+// vertex and index memory, the bytes a draw fetches (vertex lines through mesh_analyze plus
+// the index buffer) and the largest position and uv error for float, snorm/unorm and half
+// encodings. then times float to half conversion with and without the simd path. checks the
+// errors stay within half a step of each format, indices survive and both conversions agree
+// on every half and on random floats.
+// usage: bench_mesh_quantize [-n grid size] [-c count in millions] [-s seed]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "mesh_optimize.h"
+#include "mesh_quantize.h"
+
+struct mesh
+{
+    std::vector<float> positions; // xyz per vertex
+    std::vector<float> uvs;       // uv per vertex, may be empty
+    std::vector<float> colors;    // rgba per vertex, may be empty
+    std::vector<uint32_t> indices;
+};
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static mesh
+make_cube()
+{
+    mesh m;
+    m.positions = {
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,
+    };
+    m.indices = {
+        0, 2, 3,  0, 3, 1,
+        1, 3, 7,  1, 7, 5,
+        5, 7, 6,  5, 6, 4,
+        4, 6, 2,  4, 2, 0,
+        2, 6, 7,  2, 7, 3,
+        4, 0, 1,  4, 1, 5,
+    };
+    return m;
+}
+
+// a terrain like patch of size * size quads 100 units across, uvs repeat the texture 4 times
+static mesh
+make_grid(int size)
+{
+    mesh m;
+    for (int y = 0; y <= size; ++y)
+    {
+        for (int x = 0; x <= size; ++x)
+        {
+            float u = (float)x / (float)size, v = (float)y / (float)size;
+            m.positions.insert(m.positions.end(), {u * 100.0f - 50.0f, sinf(u * 12.0f) * cosf(v * 9.0f) * 3.0f, v * 100.0f - 50.0f});
+            m.uvs.insert(m.uvs.end(), {u * 4.0f, v * 4.0f});
+            m.colors.insert(m.colors.end(), {u, v, 1.0f - u, 1.0f});
+        }
+    }
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint32_t a = (uint32_t)(y * (size + 1) + x);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(size + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return m;
+}
+
+static mesh
+make_sphere(int rings, int segments)
+{
+    mesh m;
+    for (int r = 0; r <= rings; ++r)
+    {
+        float theta = 3.14159265f * (float)r / (float)rings;
+        for (int s = 0; s <= segments; ++s)
+        {
+            float phi = 2.0f * 3.14159265f * (float)s / (float)segments;
+            m.positions.insert(m.positions.end(), {sinf(theta) * cosf(phi) * 2.0f, cosf(theta) * 2.0f, sinf(theta) * sinf(phi) * 2.0f});
+            m.uvs.insert(m.uvs.end(), {(float)s / (float)segments, (float)r / (float)rings});
+        }
+    }
+    for (int r = 0; r < rings; ++r)
+    {
+        for (int s = 0; s < segments; ++s)
+        {
+            uint32_t a = (uint32_t)(r * (segments + 1) + s);
+            uint32_t b = a + 1;
+            uint32_t c = a + (uint32_t)(segments + 1);
+            uint32_t d = c + 1;
+            m.indices.insert(m.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    return m;
+}
+
+static mesh_source
+source_of(const mesh *m)
+{
+    mesh_source source = {};
+    source.positions = m->positions.data();
+    source.uvs = m->uvs.empty() ? nullptr : m->uvs.data();
+    source.colors = m->colors.empty() ? nullptr : m->colors.data();
+    source.color_components = 4;
+    source.vertex_count = m->positions.size() / 3;
+    source.indices = m->indices.data();
+    source.index_count = m->indices.size();
+    return source;
+}
+
+// largest error of the decoded uvs and colors, what the shader gets after uv_scale_offset
+static void
+attribute_errors(const mesh *m, const mesh_encoded *encoded, float *uv_error, float *color_error)
+{
+    *uv_error = 0.0f;
+    *color_error = 0.0f;
+    for (uint32_t e = 1; e < encoded->element_count; ++e)
+    {
+        const mesh_vertex_element *element = &encoded->elements[e];
+        for (size_t v = 0; v < encoded->vertex_count; ++v)
+        {
+            const uint8_t *p = &encoded->vertices[v * encoded->stride + element->offset];
+            float decoded[4];
+            if (element->format == MESH_FORMAT_R16G16_UNORM)
+            {
+                uint16_t q[2];
+                memcpy(q, p, sizeof(q));
+                for (int c = 0; c < 2; ++c)
+                    decoded[c] = (float)q[c] / 65535.0f * encoded->uv_scale_offset[c] + encoded->uv_scale_offset[2 + c];
+            }
+            else if (element->format == MESH_FORMAT_R16G16_FLOAT)
+            {
+                uint16_t h[2];
+                memcpy(h, p, sizeof(h));
+                mesh_half_to_float(decoded, h, 2);
+            }
+            else if (element->format == MESH_FORMAT_R8G8B8A8_UNORM)
+            {
+                for (int c = 0; c < 4; ++c)
+                    decoded[c] = (float)p[c] / 255.0f;
+            }
+            else
+            {
+                memcpy(decoded, p, mesh_format_size(element->format));
+            }
+
+            if (strcmp(element->semantic, "TexCoord") == 0)
+            {
+                for (int c = 0; c < 2; ++c)
+                    *uv_error = fmaxf(*uv_error, fabsf(decoded[c] - m->uvs[v * 2 + c]));
+            }
+            else
+            {
+                for (int c = 0; c < 4; ++c)
+                    *color_error = fmaxf(*color_error, fabsf(decoded[c] - m->colors[v * 4 + c]));
+            }
+        }
+    }
+}
+
+static bool
+indices_match(const mesh *m, const mesh_encoded *encoded)
+{
+    for (size_t i = 0; i < m->indices.size(); ++i)
+    {
+        uint32_t index;
+        if (encoded->index_size == 2)
+            index = ((const uint16_t *)encoded->indices.data())[i];
+        else
+            index = ((const uint32_t *)encoded->indices.data())[i];
+        if (index != m->indices[i])
+            return false;
+    }
+    return true;
+}
+
+static bool
+same_float(float a, float b)
+{
+    if (a != a || b != b)
+        return a != a && b != b;
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// every half to float and back, and random floats through both conversions
+static bool
+check_half_conversion(uint64_t *state)
+{
+    std::vector<uint16_t> halfs(65536);
+    for (uint32_t h = 0; h < 65536; ++h)
+        halfs[h] = (uint16_t)h;
+    std::vector<float> floats(65536);
+    mesh_half_to_float(floats.data(), halfs.data(), halfs.size());
+    std::vector<uint16_t> round_trip(65536);
+    mesh_float_to_half(round_trip.data(), floats.data(), floats.size());
+    for (uint32_t h = 0; h < 65536; ++h)
+    {
+        bool nan = (h & 0x7c00u) == 0x7c00u && (h & 0x3ffu);
+        if (same_float(floats[h], mesh_half_to_float_scalar((uint16_t)h)) == false)
+            return false;
+        if (nan ? (round_trip[h] & 0x7fffu) <= 0x7c00u : round_trip[h] != h)
+            return false;
+    }
+
+    // random bit patterns cover nans, infinities, overflow and subnormals, the rest lands
+    // in the half range where rounding between two halfs matters
+    std::vector<float> random(1 << 20);
+    for (size_t i = 0; i < random.size(); ++i)
+    {
+        uint32_t bits = next_random(state) | (next_random(state) & 1u) << 31;
+        if (i % 4 != 0)
+            bits = (bits & 0x807fffffu) | ((uint32_t)(103 + next_random(state) % 40) << 23);
+        memcpy(&random[i], &bits, sizeof(bits));
+    }
+    std::vector<uint16_t> converted(random.size());
+    mesh_float_to_half(converted.data(), random.data(), random.size());
+    for (size_t i = 0; i < random.size(); ++i)
+    {
+        uint16_t expected = mesh_float_to_half_scalar(random[i]);
+        bool nan = random[i] != random[i];
+        if (nan ? ((converted[i] & 0x7c00u) != 0x7c00u || (converted[i] & 0x3ffu) == 0) : converted[i] != expected)
+            return false;
+    }
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    int grid_size = 255;
+    int count_millions = 16;
+    uint64_t state = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            grid_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            count_millions = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            state = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    const char *mesh_names[] = {"cube", "grid", "sphere"};
+    mesh meshes[3] = {make_cube(), make_grid(grid_size), make_sphere(grid_size, grid_size * 2)};
+    for (int m = 1; m < 3; ++m)
+    {
+        // draw order as it would be shipped, so the fetch numbers are the ones of real draws
+        mesh *input = &meshes[m];
+        mesh_optimize_vertex_cache(input->indices.data(), input->indices.data(), input->indices.size(), input->positions.size() / 3);
+    }
+
+    const char *encoding_names[] = {"float", "snorm16/unorm16/rgba8", "half/half/rgba8"};
+    mesh_encoding encodings[3] = {
+        {MESH_POSITION_FLOAT, MESH_UV_FLOAT, MESH_COLOR_FLOAT, false},
+        {MESH_POSITION_SNORM16, MESH_UV_UNORM16, MESH_COLOR_RGBA8, true},
+        {MESH_POSITION_HALF, MESH_UV_HALF, MESH_COLOR_RGBA8, true},
+    };
+
+    printf("%-8s %-22s %8s %8s %10s %10s %8s %10s %8s %10s %10s %10s\n", "mesh", "encoding", "verts", "stride", "vertex KB",
+        "index KB", "saved", "draw KB", "saved", "pos err", "uv err", "color err");
+
+    bool ok = true;
+    for (int m = 0; m < 3; ++m)
+    {
+        const mesh *input = &meshes[m];
+        mesh_source source = source_of(input);
+        double base_size = 0.0, base_draw = 0.0;
+        for (int e = 0; e < 3; ++e)
+        {
+            mesh_encoded encoded;
+            if (mesh_encode(&source, &encodings[e], &encoded) == false)
+            {
+                printf("%-8s %-22s failed to encode\n", mesh_names[m], encoding_names[e]);
+                ok = false;
+                continue;
+            }
+
+            mesh_analysis a = mesh_analyze(input->indices.data(), input->indices.size(), encoded.vertex_count, encoded.stride);
+            double size = (double)mesh_encoded_size(&encoded);
+            double draw = (double)a.fetched_bytes + (double)encoded.indices.size();
+            if (e == 0)
+            {
+                base_size = size;
+                base_draw = draw;
+            }
+
+            // errors against the largest step of each format: half a step when rounding, a
+            // half has 11 significant bits
+            float position_error = 0.0f, position_bound = 0.0f;
+            for (size_t v = 0; v < encoded.vertex_count; ++v)
+            {
+                float decoded[3];
+                mesh_decode_position(&encoded, v, decoded);
+                for (int c = 0; c < 3; ++c)
+                    position_error = fmaxf(position_error, fabsf(decoded[c] - input->positions[v * 3 + c]));
+            }
+            for (int c = 0; c < 3; ++c)
+            {
+                float step = encodings[e].position == MESH_POSITION_SNORM16 ? 1.0f / 32767.0f : 1.0f / 2048.0f;
+                float bound = encodings[e].position == MESH_POSITION_FLOAT ? 0.0f : encoded.position_scale[c] * step;
+                position_bound = fmaxf(position_bound, bound);
+            }
+            float uv_error, color_error;
+            attribute_errors(input, &encoded, &uv_error, &color_error);
+            float uv_bound = encodings[e].uv == MESH_UV_FLOAT ? 0.0f :
+                (encodings[e].uv == MESH_UV_UNORM16 ? 0.5f / 65535.0f * 4.0f : 4.0f / 2048.0f);
+            float color_bound = encodings[e].color == MESH_COLOR_FLOAT ? 0.0f : 0.5f / 255.0f;
+
+            bool precise = position_error <= position_bound * 1.01f && uv_error <= uv_bound * 1.01f + 1e-6f &&
+                color_error <= color_bound * 1.01f;
+            bool same_indices = indices_match(input, &encoded);
+            bool index16 = encoded.index_size == 2;
+            bool right_size = index16 == (encodings[e].index16 && encoded.vertex_count <= 65536);
+            ok = ok && precise && same_indices && right_size;
+
+            printf("%-8s %-22s %8zu %8u %10.1f %10.1f %7.1f%% %10.1f %7.1f%% %10.2e %10.2e %10.2e%s%s%s\n", mesh_names[m],
+                encoding_names[e], encoded.vertex_count, encoded.stride, encoded.vertices.size() / 1024.0, encoded.indices.size() / 1024.0,
+                100.0 * (1.0 - size / base_size), draw / 1024.0, 100.0 * (1.0 - draw / base_draw), position_error, uv_error,
+                color_error, precise ? "" : "  IMPRECISE", same_indices ? "" : "  indices DIFFER", right_size ? "" : "  wrong index size");
+        }
+    }
+
+    // float to half throughput
+    size_t count = (size_t)count_millions << 20;
+    std::vector<float> floats(count);
+    for (size_t i = 0; i < count; ++i)
+        floats[i] = ((float)(next_random(&state) & 0xffffff) / (float)0xffffff - 0.5f) * 200.0f;
+    std::vector<uint16_t> halfs(count), halfs_scalar(count);
+
+    double start = now_seconds();
+    for (size_t i = 0; i < count; ++i)
+        halfs_scalar[i] = mesh_float_to_half_scalar(floats[i]);
+    double scalar_ms = (now_seconds() - start) * 1000.0;
+    start = now_seconds();
+    mesh_float_to_half(halfs.data(), floats.data(), count);
+    double simd_ms = (now_seconds() - start) * 1000.0;
+
+#if defined(MESH_QUANTIZE_F16C)
+    const char *simd_name = "f16c";
+#elif defined(SIMD_MATH_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    const char *simd_name = "neon";
+#else
+    const char *simd_name = "none";
+#endif
+    bool same_halfs = memcmp(halfs.data(), halfs_scalar.data(), count * sizeof(uint16_t)) == 0;
+    bool conversion = check_half_conversion(&state);
+    ok = ok && same_halfs && conversion;
+    printf("\nfloat to half, %dM values\n", count_millions);
+    printf("%-22s %10.1f Mfloats/s\n", "scalar", (double)count / scalar_ms / 1000.0);
+    printf("%-22s %10.1f Mfloats/s %5.1fx%s\n", simd_name, (double)count / simd_ms / 1000.0, scalar_ms / simd_ms,
+        same_halfs ? "" : "  results DIFFER");
+    printf("%-22s %10s\n", "every half, random", conversion ? "exact" : "MISMATCH");
+
+    printf("mesh quantize checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
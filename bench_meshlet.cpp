@@ -0,0 +1,354 @@
+// splits a dense mesh into meshlets (meshlet.h) and culls them from a camera orbiting close
+// around it: the cube of the examples with every face tessellated into a grid, and the same
+// grid pushed out onto a sphere. reports the meshlet count, vertices and triangles per
+// meshlet and build time, then per camera pass the clusters and triangles left, cull and emit
+// time one at a time and SIMD_MATH_WIDTH at a time, and the time the software backend takes
+// to draw the full index buffer and the compacted stream.
+// checks that every meshlet stays within the limits and covers each triangle once, that every
+// culled meshlet really has all triangles facing away or all corners outside one frustum
+// plane, and that the full and the culled draw produce identical images.
+// usage: bench_meshlet [-n grid size] [-f frames] [-t threads]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "frustum_cull.h"
+#include "meshlet.h"
+#include "simd_math.h"
+#include "sw_raster.h"
+
+struct mesh
+{
+    std::vector<float> positions; // xyz per vertex
+    std::vector<uint32_t> indices;
+};
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the quads of the cube the examples draw, triangles (a, b, c) and (a, c, d) of each face
+// split into size x size cells wound the same way. round pushes every vertex onto the sphere
+static mesh
+make_cube(int size, bool round)
+{
+    float vertices[] = {
+        -1.0f, -1.0f, -1.0f,
+         1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+         1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f
+    };
+
+    unsigned int indices[] = {
+        0, 2, 3,  0, 3, 1,
+        1, 3, 7,  1, 7, 5,
+        5, 7, 6,  5, 6, 4,
+        4, 6, 2,  4, 2, 0,
+        2, 6, 7,  2, 7, 3,
+        0, 1, 5,  0, 5, 4
+    };
+
+    mesh m;
+    for (int face = 0; face < 6; ++face)
+    {
+        const float *a = &vertices[indices[face * 6 + 0] * 3];
+        const float *b = &vertices[indices[face * 6 + 1] * 3];
+        const float *d = &vertices[indices[face * 6 + 5] * 3];
+        uint32_t base = (uint32_t)(m.positions.size() / 3);
+        for (int v = 0; v <= size; ++v)
+        {
+            for (int u = 0; u <= size; ++u)
+            {
+                float fu = (float)u / (float)size, fv = (float)v / (float)size;
+                float p[3];
+                for (int axis = 0; axis < 3; ++axis)
+                    p[axis] = a[axis] + fu * (b[axis] - a[axis]) + fv * (d[axis] - a[axis]);
+                if (round)
+                {
+                    float inv = 1.0f / sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                    for (int axis = 0; axis < 3; ++axis)
+                        p[axis] *= inv;
+                }
+                m.positions.insert(m.positions.end(), {p[0], p[1], p[2]});
+            }
+        }
+        for (int v = 0; v < size; ++v)
+        {
+            for (int u = 0; u < size; ++u)
+            {
+                uint32_t p00 = base + (uint32_t)(v * (size + 1) + u);
+                uint32_t p10 = p00 + 1;
+                uint32_t p01 = p00 + (uint32_t)(size + 1);
+                uint32_t p11 = p01 + 1;
+                m.indices.insert(m.indices.end(), {p00, p10, p11, p00, p11, p01});
+            }
+        }
+    }
+    return m;
+}
+
+// the camera sits on a sphere around the origin and looks at it
+static void
+orbit_camera(float yaw, float pitch, float distance, float aspect, mat4 *view_proj, float eye[3])
+{
+    mat4 orientation = mat4_rotation_x(pitch) * mat4_rotation_y(yaw);
+    float o[16];
+    mat4_store(o, orientation);
+    for (int axis = 0; axis < 3; ++axis)
+        eye[axis] = -o[8 + axis] * distance;
+    *view_proj = mat4_translation(-eye[0], -eye[1], -eye[2]) * mat4_rotation_y(-yaw) * mat4_rotation_x(-pitch) *
+        mat4_perspective_fov_lh(simd_radians(60.0f), aspect, 0.01f, 100.0f);
+}
+
+// a culled meshlet has to face away with every triangle or lie behind one plane entirely
+static bool
+rejection_valid(const meshlet_mesh *ml, const mesh *m, uint32_t index, const frustum *f, const float eye[3])
+{
+    const meshlet &cluster = ml->meshlets[index];
+    const uint32_t *indices = &ml->indices[(size_t)cluster.triangle_offset * 3];
+    for (int p = 0; p < 6; ++p)
+    {
+        bool outside = true;
+        for (uint32_t i = 0; i < cluster.triangle_count * 3 && outside; ++i)
+        {
+            const float *v = &m->positions[(size_t)indices[i] * 3];
+            const float *plane = f->planes[p];
+            outside = (double)plane[0] * v[0] + (double)plane[1] * v[1] + (double)plane[2] * v[2] + plane[3] < 0.0;
+        }
+        if (outside)
+            return true;
+    }
+    for (uint32_t t = 0; t < cluster.triangle_count; ++t)
+    {
+        const float *a = &m->positions[(size_t)indices[t * 3 + 0] * 3];
+        const float *b = &m->positions[(size_t)indices[t * 3 + 1] * 3];
+        const float *c = &m->positions[(size_t)indices[t * 3 + 2] * 3];
+        double ab[3] = {(double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2]};
+        double ac[3] = {(double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2]};
+        double n[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+        if (n[0] * ((double)a[0] - eye[0]) + n[1] * ((double)a[1] - eye[1]) + n[2] * ((double)a[2] - eye[2]) < 0.0)
+            return false;
+    }
+    return true;
+}
+
+static sw_float4
+ps_main(const sw_pixel_input *input, const void *const *constant_buffers)
+{
+    // the culled draw maps its primitives back to the triangles of the full one
+    const uint32_t *triangle_ids = (const uint32_t *)constant_buffers[0];
+    uint32_t id = triangle_ids ? triangle_ids[input->primitive_id] : input->primitive_id;
+    uint32_t hash = id * 2654435761u;
+    sw_float4 color = {(float)(hash & 0xff) / 255.0f, (float)((hash >> 8) & 0xff) / 255.0f, (float)((hash >> 16) & 0xff) / 255.0f,
+        1.0f};
+    return color;
+}
+
+int
+main(int argc, char **argv)
+{
+    int grid_size = 160;
+    int frames = 16;
+    int threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            grid_size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+    int width = 640;
+    int height = 360;
+    sw_render_target full_target, culled_target;
+    if (sw_render_target_init(&full_target, width, height) == false || sw_render_target_init(&culled_target, width, height) == false)
+    {
+        fprintf(stderr, "Failed to create render targets\n");
+        return 1;
+    }
+    sw_context context;
+    sw_context_init(&context, &pool);
+    sw_viewport viewport = {};
+    viewport.width = (float)width;
+    viewport.height = (float)height;
+    viewport.max_depth = 1.0f;
+
+    bool ok = true;
+    const char *mesh_names[] = {"cube", "sphere"};
+    for (int shape = 0; shape < 2; ++shape)
+    {
+        mesh m = make_cube(grid_size, shape == 1);
+        size_t vertex_count = m.positions.size() / 3;
+        size_t triangle_count = m.indices.size() / 3;
+
+        double start = now_seconds();
+        meshlet_mesh ml;
+        if (meshlet_build(&ml, m.indices.data(), m.indices.size(), m.positions.data(), vertex_count, 3 * sizeof(float)) == false)
+        {
+            fprintf(stderr, "Failed to build meshlets\n");
+            return 1;
+        }
+        double build_ms = (now_seconds() - start) * 1000.0;
+
+        // limits, and every triangle exactly once with its own corners
+        uint32_t meshlet_count = (uint32_t)ml.meshlets.size();
+        bool limits = ml.indices.size() == m.indices.size();
+        uint64_t vertex_total = 0;
+        for (const meshlet &cluster : ml.meshlets)
+        {
+            limits = limits && cluster.vertex_count <= MESHLET_MAX_VERTICES && cluster.triangle_count <= MESHLET_MAX_TRIANGLES;
+            vertex_total += cluster.vertex_count;
+            for (uint32_t i = 0; i < cluster.triangle_count * 3 && limits; ++i)
+            {
+                uint32_t corner = ml.triangles[(size_t)cluster.triangle_offset * 3 + i];
+                limits = corner < cluster.vertex_count &&
+                    ml.vertices[cluster.vertex_offset + corner] == ml.indices[(size_t)cluster.triangle_offset * 3 + i];
+            }
+        }
+        std::vector<uint64_t> original, clustered;
+        for (size_t t = 0; t < triangle_count && limits; ++t)
+        {
+            uint32_t corners[2][3];
+            for (int c = 0; c < 3; ++c)
+            {
+                corners[0][c] = m.indices[t * 3 + c];
+                corners[1][c] = ml.indices[t * 3 + c];
+            }
+            // rotate so the smallest corner leads, the winding stays
+            for (int which = 0; which < 2; ++which)
+            {
+                uint32_t *k = corners[which];
+                while (k[0] > k[1] || k[0] > k[2])
+                    std::rotate(k, k + 1, k + 3);
+                (which == 0 ? original : clustered).push_back(((uint64_t)k[0] << 42) | ((uint64_t)k[1] << 21) | k[2]);
+            }
+        }
+        std::sort(original.begin(), original.end());
+        std::sort(clustered.begin(), clustered.end());
+        limits = limits && original == clustered;
+        ok = ok && limits;
+        printf("%s: %zu triangles, %u meshlets, %.1f vertices and %.1f triangles each, built in %.1f ms%s\n", mesh_names[shape],
+            triangle_count, meshlet_count, (double)vertex_total / meshlet_count, (double)triangle_count / meshlet_count, build_ms,
+            limits ? "" : "  BROKEN");
+
+        std::vector<uint32_t> visible(meshlet_count), reference(meshlet_count);
+        std::vector<uint32_t> stream(ml.indices.size()), triangle_ids(triangle_count);
+        double scalar_seconds = 0.0, simd_seconds = 0.0, emit_seconds = 0.0, draw_seconds[2] = {};
+        uint64_t visible_total = 0, triangles_total = 0;
+        bool rejections = true, identical = true;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            float t = (float)frame / (float)(frames > 1 ? frames : 1);
+            float eye[3];
+            mat4 view_proj;
+            orbit_camera(6.2831853f * t, 0.6f * sinf(6.2831853f * t * 2.0f), 1.6f + 3.0f * t, (float)width / (float)height,
+                &view_proj, eye);
+            frustum f = frustum_from_matrix(view_proj);
+
+            start = now_seconds();
+            uint32_t reference_count = 0;
+            for (uint32_t i = 0; i < meshlet_count; ++i)
+            {
+                if (meshlet_visible(&f, eye, &ml.bounds[i]))
+                    reference[reference_count++] = i;
+            }
+            scalar_seconds += now_seconds() - start;
+
+            start = now_seconds();
+            uint32_t visible_count = meshlet_cull(&f, eye, &ml.cull, 0, meshlet_count, visible.data());
+            simd_seconds += now_seconds() - start;
+
+            start = now_seconds();
+            uint32_t index_count = meshlet_emit(stream.data(), &ml, visible.data(), visible_count);
+            emit_seconds += now_seconds() - start;
+            visible_total += visible_count;
+            triangles_total += index_count / 3;
+
+            // both lists may only drop meshlets that really can't show
+            for (int list = 0; list < 2; ++list)
+            {
+                const uint32_t *kept = list == 0 ? reference.data() : visible.data();
+                uint32_t kept_count = list == 0 ? reference_count : visible_count;
+                for (uint32_t i = 0, k = 0; i < meshlet_count; ++i)
+                {
+                    if (k < kept_count && kept[k] == i)
+                        k++;
+                    else
+                        rejections = rejections && rejection_valid(&ml, &m, i, &f, eye);
+                }
+            }
+
+            // the triangle of the full draw behind every primitive of the culled one
+            uint32_t n = 0;
+            for (uint32_t v = 0; v < visible_count; ++v)
+            {
+                const meshlet &cluster = ml.meshlets[visible[v]];
+                for (uint32_t i = 0; i < cluster.triangle_count; ++i)
+                    triangle_ids[n++] = cluster.triangle_offset + i;
+            }
+
+            float mvp[16];
+            mat4_store(mvp, mat4_transpose(view_proj));
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                bool culled = mode == 1;
+                float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+                sw_om_set_render_target(&context, culled ? &culled_target : &full_target);
+                sw_clear_render_target(&context, clear_color);
+                sw_clear_depth(&context, 1.0f);
+                sw_flush(&context);
+
+                start = now_seconds();
+                sw_ia_set_vertex_buffer(&context, m.positions.data(), 3 * sizeof(float), 0);
+                sw_ia_set_index_buffer(&context, culled ? stream.data() : ml.indices.data(), 0);
+                sw_vs_set_constant_buffer(&context, 0, mvp);
+                sw_ps_set_shader(&context, ps_main);
+                sw_ps_set_constant_buffer(&context, 0, culled ? triangle_ids.data() : nullptr);
+                sw_rs_set_viewport(&context, &viewport);
+                sw_rs_set_cull_mode(&context, SW_CULL_BACK);
+                sw_om_set_depth_state(&context, true, true, SW_COMPARISON_LESS);
+                sw_draw_indexed(&context, culled ? index_count : (uint32_t)ml.indices.size(), 0, 0);
+                sw_flush(&context);
+                draw_seconds[mode] += now_seconds() - start;
+            }
+            identical = identical && memcmp(full_target.color, culled_target.color, (size_t)width * height * sizeof(uint32_t)) == 0;
+        }
+
+        ok = ok && rejections && identical;
+        double frame_count = frames > 0 ? (double)frames : 1.0;
+        printf("%-22s %10s %12s %10s\n", "", "meshlets", "triangles", "ms/pass");
+        printf("%-22s %10u %12zu %10s\n", "all", meshlet_count, triangle_count, "");
+        printf("%-22s %10.0f %12.0f %10.4f\n", "cull scalar", (double)visible_total / frame_count, (double)triangles_total / frame_count,
+            scalar_seconds * 1000.0 / frame_count);
+        printf("%-22s %10.0f %12.0f %10.4f\n", "cull " SIMD_MATH_NAME, (double)visible_total / frame_count,
+            (double)triangles_total / frame_count, simd_seconds * 1000.0 / frame_count);
+        printf("%-22s %10s %12s %10.4f\n", "emit", "", "", emit_seconds * 1000.0 / frame_count);
+        printf("%-22s %10s %12s %10.3f\n", "sw draw all", "", "", draw_seconds[0] * 1000.0 / frame_count);
+        printf("%-22s %10s %12s %10.3f\n", "sw draw culled", "", "", draw_seconds[1] * 1000.0 / frame_count);
+        printf("culled meshlets %s, images %s\n\n", rejections ? "valid" : "VISIBLE", identical ? "identical" : "DIFFER");
+        meshlet_mesh_free(&ml);
+    }
+
+    sw_render_target_free(&culled_target);
+    sw_render_target_free(&full_target);
+    thread_pool_shutdown(&pool);
+
+    printf("meshlet checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
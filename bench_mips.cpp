@@ -0,0 +1,201 @@
+// builds full mip chains for synthetic 4k and 8k rgba8 images with the naive approach (2x2
+// average of the srgb bytes, one thread, scalar) and with mip_gen.h, single and multithreaded,
+// usage: bench_mips [-s size] [-i iterations] [-t threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "mip_gen.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// left half alternates black and white rows, the right half is a noisy color gradient.
+// the stripes average to 50% linear light, which is 188 in srgb and 128 only if averaged
+// in gamma space
+static void
+fill_image(uint8_t *pixels, int size)
+{
+    uint32_t seed = 1234567;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint8_t *p = pixels + ((size_t)y * size + x) * 4;
+            if (x < size / 2)
+            {
+                uint8_t v = (y & 1) ? 255 : 0;
+                p[0] = p[1] = p[2] = v;
+            }
+            else
+            {
+                seed = seed * 1664525u + 1013904223u;
+                int noise = (int)(seed >> 28) - 8;
+                int r = x * 255 / size + noise;
+                int g = y * 255 / size + noise;
+                p[0] = (uint8_t)(r < 0 ? 0 : (r > 255 ? 255 : r));
+                p[1] = (uint8_t)(g < 0 ? 0 : (g > 255 ? 255 : g));
+                p[2] = 96;
+            }
+            p[3] = 255;
+        }
+    }
+}
+
+// what most loaders do, average 2x2 blocks of bytes level by level
+static void
+naive_mips(std::vector<uint8_t> *out, const uint8_t *pixels, int width, int height)
+{
+    int level_count = mip_level_count(width, height);
+    size_t total = 0;
+    for (int level = 1; level < level_count; ++level)
+    {
+        int w = width >> level > 0 ? width >> level : 1;
+        int h = height >> level > 0 ? height >> level : 1;
+        total += (size_t)w * h * 4;
+    }
+    out->resize(total);
+
+    const uint8_t *src = pixels;
+    int src_width = width;
+    int src_height = height;
+    uint8_t *dst = out->data();
+    for (int level = 1; level < level_count; ++level)
+    {
+        int w = width >> level > 0 ? width >> level : 1;
+        int h = height >> level > 0 ? height >> level : 1;
+        for (int y = 0; y < h; ++y)
+        {
+            int y0 = y * 2;
+            int y1 = y * 2 + 1 < src_height ? y * 2 + 1 : src_height - 1;
+            for (int x = 0; x < w; ++x)
+            {
+                int x0 = x * 2;
+                int x1 = x * 2 + 1 < src_width ? x * 2 + 1 : src_width - 1;
+                for (int c = 0; c < 4; ++c)
+                {
+                    int sum = src[((size_t)y0 * src_width + x0) * 4 + c] + src[((size_t)y0 * src_width + x1) * 4 + c] +
+                        src[((size_t)y1 * src_width + x0) * 4 + c] + src[((size_t)y1 * src_width + x1) * 4 + c];
+                    dst[((size_t)y * w + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+        src = dst;
+        src_width = w;
+        src_height = h;
+        dst += (size_t)w * h * 4;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int sizes[2] = {4096, 8192};
+    int size_count = 2;
+    int iterations = 3;
+    int threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+        {
+            sizes[0] = atoi(argv[i + 1]);
+            size_count = 1;
+        }
+        else if (strcmp(argv[i], "-i") == 0)
+            iterations = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    printf("simd path: %s, %d threads\n", SIMD_MATH_NAME, thread_pool_size(&pool));
+
+    // build the lookup tables outside the timings
+    mip_decode_table();
+    mip_decode16_table();
+    mip_encode_table();
+
+    for (int s = 0; s < size_count; ++s)
+    {
+        int size = sizes[s];
+        std::vector<uint8_t> pixels((size_t)size * size * 4);
+        fill_image(pixels.data(), size);
+        double megapixels = (double)size * size / 1e6;
+
+        printf("\n%dx%d, %d levels\n", size, size, mip_level_count(size, size));
+        printf("%-22s %10s %10s %9s   %s\n", "", "ms", "MPix/s", "speedup", "1x1 level");
+
+        double naive_ms = 0.0;
+        {
+            std::vector<uint8_t> chain;
+            double start = now_seconds();
+            for (int i = 0; i < iterations; ++i)
+                naive_mips(&chain, pixels.data(), size, size);
+            naive_ms = (now_seconds() - start) * 1000.0 / iterations;
+
+            const uint8_t *last = chain.data() + chain.size() - 4;
+            printf("%-22s %10.2f %10.1f %8.2fx   %3d %3d %3d\n", "naive scalar box", naive_ms, megapixels / naive_ms * 1000.0, 1.0,
+                last[0], last[1], last[2]);
+        }
+
+        struct run
+        {
+            const char *name;
+            mip_filter filter;
+            bool threaded;
+        };
+        run runs[] = {
+            {"box 1 thread", MIP_FILTER_BOX, false},
+            {"box", MIP_FILTER_BOX, true},
+            {"kaiser 1 thread", MIP_FILTER_KAISER, false},
+            {"kaiser", MIP_FILTER_KAISER, true},
+            {"lanczos 1 thread", MIP_FILTER_LANCZOS, false},
+            {"lanczos", MIP_FILTER_LANCZOS, true},
+        };
+        for (const run &r : runs)
+        {
+            mip_chain chain = {};
+            double start = now_seconds();
+            for (int i = 0; i < iterations; ++i)
+            {
+                mip_chain_free(&chain);
+                if (mip_chain_build(&chain, pixels.data(), size, size, r.filter, true, r.threaded ? &pool : nullptr) == false)
+                {
+                    fprintf(stderr, "Failed to allocate mip chain\n");
+                    return 1;
+                }
+            }
+            double ms = (now_seconds() - start) * 1000.0 / iterations;
+
+            const uint8_t *last = chain.levels[chain.level_count - 1].data;
+            printf("%-22s %10.2f %10.1f %8.2fx   %3d %3d %3d\n", r.name, ms, megapixels / ms * 1000.0, naive_ms / ms,
+                last[0], last[1], last[2]);
+            mip_chain_free(&chain);
+        }
+
+        // average of the whole image in linear light, what the 1x1 level should hold
+        {
+            const float *decode = mip_decode_table();
+            double sum[3] = {};
+            for (size_t i = 0; i < pixels.size(); i += 4)
+                for (int c = 0; c < 3; ++c)
+                    sum[c] += decode[pixels[i + c]];
+            int expected[3];
+            for (int c = 0; c < 3; ++c)
+                expected[c] = (int)(mip_linear_to_srgb((float)(sum[c] / ((double)size * size))) * 255.0f + 0.5f);
+            printf("%-22s %10s %10s %9s   %3d %3d %3d\n", "linear light average", "", "", "", expected[0], expected[1], expected[2]);
+        }
+    }
+
+    thread_pool_shutdown(&pool);
+    return 0;
+}
@@ -0,0 +1,450 @@
+// replays the example_cubes and example_texture call streams against the null backend in
+// null_device.h, many draws per frame instead of two, and reports how many calls, draws and
+// state changes per second the cpu side sustains once the gpu is out of the picture. a
+// broken stream at the end checks that validation still catches mistakes.
+// usage: bench_null_device [-f frames] [-d draws per frame] [-l gpu latency]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "cbuffer_ring.h"
+#include "null_device.h"
+#include "simd_math.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// cbuffer_ring_backend on top of the null device, the ring is one dynamic constant buffer
+struct ring_device
+{
+    null_device *device;
+    null_handle buffer;
+};
+
+static uint64_t
+ring_signal_fence(void *user)
+{
+    return null_signal_fence(((ring_device *)user)->device);
+}
+
+static uint64_t
+ring_completed_fence(void *user)
+{
+    return null_completed_fence(((ring_device *)user)->device);
+}
+
+static void
+ring_wait_fence(void *user, uint64_t fence)
+{
+    null_wait_fence(((ring_device *)user)->device, fence);
+}
+
+static void *
+ring_map(void *user, uint32_t offset, uint32_t size)
+{
+    ring_device *ring = (ring_device *)user;
+    uint8_t *memory = (uint8_t *)null_map(ring->device, ring->buffer, NULL_MAP_WRITE_NO_OVERWRITE);
+    return memory ? memory + offset : nullptr;
+}
+
+static void
+ring_unmap(void *user)
+{
+    ring_device *ring = (ring_device *)user;
+    null_unmap(ring->device, ring->buffer);
+}
+
+static const float cube_vertices[] = {
+    -1.0f, -1.0f, -1.0f,
+     1.0f, -1.0f, -1.0f,
+    -1.0f,  1.0f, -1.0f,
+     1.0f,  1.0f, -1.0f,
+    -1.0f, -1.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f
+};
+
+static const uint32_t cube_indices[] = {
+    0, 2, 3,  0, 3, 1,
+    1, 3, 7,  1, 7, 5,
+    5, 7, 6,  5, 6, 4,
+    4, 6, 2,  4, 2, 0,
+    2, 6, 7,  2, 7, 3,
+    0, 1, 5,  0, 5, 4
+};
+
+static const float cube_colors[] = {
+    1.0f, 0.0f, 0.0f, 1.0f,
+    0.0f, 1.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 0.0f, 1.0f,
+    0.0f, 1.0f, 1.0f, 1.0f,
+    1.0f, 0.0f, 1.0f, 1.0f
+};
+
+// position, uv
+static const float quad_vertices[] = {
+    -0.5f,  0.5f, 0.0f, 0.0f,
+     0.5f,  0.5f, 1.0f, 0.0f,
+     0.5f, -0.5f, 1.0f, 1.0f,
+    -0.5f, -0.5f, 0.0f, 1.0f
+};
+
+static const uint32_t quad_indices[] = {0, 1, 2, 0, 2, 3};
+
+struct scene
+{
+    null_handle render_target;
+    null_handle depth_stencil;
+    null_handle depth_state;
+    null_viewport viewport;
+
+    // cubes
+    null_handle cube_layout;
+    null_handle cube_vertex_buffer;
+    null_handle cube_index_buffer;
+    null_handle cube_vs;
+    null_handle cube_ps;
+    null_handle colors_buffer;
+    null_handle ring_buffer;
+
+    // textured quads
+    null_handle quad_layout;
+    null_handle quad_vertex_buffer;
+    null_handle quad_index_buffer;
+    null_handle quad_vs;
+    null_handle quad_ps;
+    null_handle quad_constants;
+    null_handle textures[8];
+    null_handle sampler;
+};
+
+static void
+scene_init(null_device *device, scene *s, uint32_t width, uint32_t height, uint32_t ring_size)
+{
+    s->render_target = null_create_render_target_view(device, width, height);
+    s->depth_stencil = null_create_depth_stencil_view(device, width, height);
+    s->depth_state = null_create_depth_stencil_state(device);
+    s->viewport = {0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f};
+
+    null_input_element cube_elements[] = {{0, 0, 12, false}};
+    s->cube_layout = null_create_input_layout(device, cube_elements, 1);
+    s->cube_vertex_buffer = null_create_buffer(device, sizeof(cube_vertices), NULL_USAGE_IMMUTABLE, NULL_BIND_VERTEX_BUFFER, cube_vertices);
+    s->cube_index_buffer = null_create_buffer(device, sizeof(cube_indices), NULL_USAGE_IMMUTABLE, NULL_BIND_INDEX_BUFFER, cube_indices);
+    null_shader_desc cube_vs_desc = {};
+    cube_vs_desc.constant_buffer_sizes[0] = sizeof(mat4);
+    s->cube_vs = null_create_vertex_shader(device, &cube_vs_desc);
+    null_shader_desc cube_ps_desc = {};
+    cube_ps_desc.constant_buffer_sizes[0] = sizeof(cube_colors);
+    s->cube_ps = null_create_pixel_shader(device, &cube_ps_desc);
+    s->colors_buffer = null_create_buffer(device, sizeof(cube_colors), NULL_USAGE_IMMUTABLE, NULL_BIND_CONSTANT_BUFFER, cube_colors);
+    s->ring_buffer = null_create_buffer(device, ring_size, NULL_USAGE_DYNAMIC, NULL_BIND_CONSTANT_BUFFER);
+
+    null_input_element quad_elements[] = {{0, 0, 8, false}, {0, 8, 8, false}};
+    s->quad_layout = null_create_input_layout(device, quad_elements, 2);
+    s->quad_vertex_buffer = null_create_buffer(device, sizeof(quad_vertices), NULL_USAGE_IMMUTABLE, NULL_BIND_VERTEX_BUFFER, quad_vertices);
+    s->quad_index_buffer = null_create_buffer(device, sizeof(quad_indices), NULL_USAGE_IMMUTABLE, NULL_BIND_INDEX_BUFFER, quad_indices);
+    null_shader_desc quad_vs_desc = {};
+    quad_vs_desc.constant_buffer_sizes[0] = 16;
+    s->quad_vs = null_create_vertex_shader(device, &quad_vs_desc);
+    null_shader_desc quad_ps_desc = {};
+    quad_ps_desc.resource_mask = 1;
+    quad_ps_desc.sampler_mask = 1;
+    s->quad_ps = null_create_pixel_shader(device, &quad_ps_desc);
+    s->quad_constants = null_create_buffer(device, 16, NULL_USAGE_DYNAMIC, NULL_BIND_CONSTANT_BUFFER);
+    for (null_handle &texture : s->textures)
+        texture = null_create_shader_resource_view(device, 512, 512);
+    s->sampler = null_create_sampler_state(device);
+}
+
+// example_cubes: frame state once, then per cube a ring write, an offset binding and a draw
+static void
+cubes_frame(null_device *device, const scene *s, cbuffer_ring *ring, int draws, float angle, const mat4 &proj)
+{
+    float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    null_clear_render_target_view(device, s->render_target, clear_color);
+    null_clear_depth_stencil_view(device, s->depth_stencil, 1.0f);
+
+    uint32_t stride = sizeof(float) * 3;
+    uint32_t offset = 0;
+    null_ia_set_input_layout(device, s->cube_layout);
+    null_ia_set_primitive_topology(device, NULL_TOPOLOGY_TRIANGLELIST);
+    null_ia_set_vertex_buffers(device, 0, 1, &s->cube_vertex_buffer, &stride, &offset);
+    null_ia_set_index_buffer(device, s->cube_index_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+    null_vs_set_shader(device, s->cube_vs);
+    null_ps_set_shader(device, s->cube_ps);
+    null_ps_set_constant_buffers(device, 0, 1, &s->colors_buffer);
+    null_rs_set_viewports(device, 1, &s->viewport);
+    null_om_set_render_targets(device, 1, &s->render_target, s->depth_stencil);
+    null_om_set_depth_stencil_state(device, s->depth_state, 1);
+
+    mat4 rotation = mat4_rotation_x(angle) * mat4_rotation_y(angle) * mat4_rotation_z(angle);
+    cbuffer_ring_begin_frame(ring);
+    for (int i = 0; i < draws; ++i)
+    {
+        mat4 mvp = mat4_transpose(rotation * mat4_translation((float)(i % 64) - 32.0f, (float)(i / 64 % 64) - 32.0f, 40.0f) * proj);
+
+        cbuffer_ring_allocation allocation;
+        if (cbuffer_ring_write(ring, &mvp, sizeof(mvp), &allocation) == false)
+            break;
+        uint32_t first_constant = allocation.offset / 16;
+        uint32_t constant_count = allocation.size / 16;
+        null_vs_set_constant_buffers(device, 0, 1, &s->ring_buffer, &first_constant, &constant_count);
+        null_draw_indexed(device, 36, 0, 0);
+    }
+    cbuffer_ring_end_frame(ring);
+    null_present(device);
+}
+
+// example_texture: a textured quad per draw, switching texture every draw and the small
+// constant buffer with a discard map every 8 draws
+static void
+texture_frame(null_device *device, const scene *s, int draws)
+{
+    float clear_color[4] = {0.1f, 0.1f, 0.1f, 1.0f};
+    null_clear_render_target_view(device, s->render_target, clear_color);
+
+    uint32_t stride = sizeof(float) * 4;
+    uint32_t offset = 0;
+    null_ia_set_input_layout(device, s->quad_layout);
+    null_ia_set_primitive_topology(device, NULL_TOPOLOGY_TRIANGLELIST);
+    null_ia_set_vertex_buffers(device, 0, 1, &s->quad_vertex_buffer, &stride, &offset);
+    null_ia_set_index_buffer(device, s->quad_index_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+    null_vs_set_shader(device, s->quad_vs);
+    null_vs_set_constant_buffers(device, 0, 1, &s->quad_constants);
+    null_ps_set_shader(device, s->quad_ps);
+    null_ps_set_samplers(device, 0, 1, &s->sampler);
+    null_rs_set_viewports(device, 1, &s->viewport);
+    null_om_set_render_targets(device, 1, &s->render_target, 0);
+
+    for (int i = 0; i < draws; ++i)
+    {
+        if (i % 8 == 0)
+        {
+            float *constants = (float *)null_map(device, s->quad_constants, NULL_MAP_WRITE_DISCARD);
+            if (constants)
+            {
+                constants[0] = (float)i;
+                constants[1] = 0.0f;
+                constants[2] = 1.0f;
+                constants[3] = 1.0f;
+            }
+            null_unmap(device, s->quad_constants);
+        }
+        null_ps_set_shader_resources(device, 0, 1, &s->textures[i % 8]);
+        null_draw_indexed(device, 6, 0, 0);
+    }
+    null_present(device);
+}
+
+static uint64_t
+total_calls(const null_stats *stats)
+{
+    uint64_t calls = 0;
+    for (int i = 0; i < NULL_CALL_COUNT; ++i)
+        calls += stats->calls[i];
+    return calls;
+}
+
+static void
+print_result(const char *name, const null_stats *stats, double seconds)
+{
+    uint64_t calls = total_calls(stats);
+    printf("%-22s %10.2f %12.0f %12.0f %12.0f %8.1f %8llu\n", name, seconds * 1000.0, (double)calls / seconds,
+        (double)stats->draws / seconds, (double)stats->state_changes / seconds,
+        stats->draws ? seconds * 1e9 / (double)stats->draws : 0.0, (unsigned long long)stats->errors);
+}
+
+int
+main(int argc, char **argv)
+{
+    int frames = 200;
+    int draws = 10000;
+    uint32_t latency = 2;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            draws = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-l") == 0)
+            latency = (uint32_t)atoi(argv[i + 1]);
+    }
+
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), (float)width / (float)height, 0.1f, 100.0f);
+
+    // room for a few frames of 256 byte allocations in flight
+    uint32_t ring_size = (uint32_t)draws * CBUFFER_RING_ALIGNMENT * (latency + 2);
+
+    printf("%d frames, %d draws per frame, gpu latency %u frames\n", frames, draws, latency);
+    printf("%-22s %10s %12s %12s %12s %8s %8s\n", "", "ms", "calls/s", "draws/s", "changes/s", "ns/draw", "errors");
+
+    bool ok = true;
+
+    // cubes
+    {
+        null_device device;
+        null_device_init(&device, latency);
+        scene s;
+        scene_init(&device, &s, width, height, ring_size);
+
+        ring_device ring_user = {&device, s.ring_buffer};
+        cbuffer_ring_backend backend = {&ring_user, ring_signal_fence, ring_completed_fence, ring_wait_fence, ring_map, ring_unmap};
+        cbuffer_ring ring;
+        cbuffer_ring_init(&ring, ring_size, &backend);
+
+        double start = now_seconds();
+        for (int frame = 0; frame < frames; ++frame)
+            cubes_frame(&device, &s, &ring, draws, (float)frame * 0.01f, proj);
+        double seconds = now_seconds() - start;
+
+        print_result("example_cubes", &device.stats, seconds);
+        printf("%-22s %llu pipeline validations, %llu maps, %llu ring stalls\n", "",
+            (unsigned long long)device.stats.pipeline_validations, (unsigned long long)device.stats.calls[NULL_CALL_MAP],
+            (unsigned long long)ring.stats.stalls);
+        ok = ok && device.stats.errors == 0 && device.stats.draws == (uint64_t)frames * draws;
+        null_device_shutdown(&device);
+    }
+
+    // textured quads
+    {
+        null_device device;
+        null_device_init(&device, latency);
+        scene s;
+        scene_init(&device, &s, width, height, CBUFFER_RING_ALIGNMENT);
+
+        double start = now_seconds();
+        for (int frame = 0; frame < frames; ++frame)
+            texture_frame(&device, &s, draws);
+        double seconds = now_seconds() - start;
+
+        print_result("example_texture", &device.stats, seconds);
+        ok = ok && device.stats.errors == 0 && device.stats.draws == (uint64_t)frames * draws;
+        null_device_shutdown(&device);
+    }
+
+    // every one of these has to be reported and the draw dropped
+    {
+        null_device device;
+        null_device_init(&device, latency);
+        scene s;
+        scene_init(&device, &s, width, height, CBUFFER_RING_ALIGNMENT * 4);
+        uint32_t first_constant = 0;
+        uint32_t constant_count = CBUFFER_RING_ALIGNMENT / 16;
+
+        // full frame state, then break one thing at a time
+        auto bind_cubes = [&]() {
+            uint32_t stride = sizeof(float) * 3;
+            uint32_t offset = 0;
+            null_ia_set_input_layout(&device, s.cube_layout);
+            null_ia_set_primitive_topology(&device, NULL_TOPOLOGY_TRIANGLELIST);
+            null_ia_set_vertex_buffers(&device, 0, 1, &s.cube_vertex_buffer, &stride, &offset);
+            null_ia_set_index_buffer(&device, s.cube_index_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+            null_vs_set_shader(&device, s.cube_vs);
+            null_vs_set_constant_buffers(&device, 0, 1, &s.ring_buffer, &first_constant, &constant_count);
+            null_ps_set_shader(&device, s.cube_ps);
+            null_ps_set_constant_buffers(&device, 0, 1, &s.colors_buffer);
+            null_rs_set_viewports(&device, 1, &s.viewport);
+            null_om_set_render_targets(&device, 1, &s.render_target, s.depth_stencil);
+        };
+
+        // every case has to raise at least one error and draw nothing
+        int cases = 0;
+        int caught = 0;
+        auto check = [&](uint64_t errors_before, uint64_t draws_before) {
+            cases++;
+            if (device.stats.errors > errors_before && device.stats.draws == draws_before)
+                caught++;
+        };
+        uint64_t errors = 0;
+        uint64_t draws_before = 0;
+        auto begin_case = [&]() {
+            errors = device.stats.errors;
+            draws_before = device.stats.draws;
+        };
+
+        bind_cubes();
+        null_draw_indexed(&device, 36, 0, 0);
+        bool good_draw = device.stats.errors == 0 && device.stats.draws == 1;
+
+        begin_case();
+        null_draw_indexed(&device, 36, 6, 0); // past the index buffer
+        check(errors, draws_before);
+
+        begin_case();
+        null_draw_indexed(&device, 36, 0, 4); // base vertex past the vertex buffer
+        check(errors, draws_before);
+
+        begin_case();
+        uint32_t small_stride = 8;
+        uint32_t offset = 0;
+        null_ia_set_vertex_buffers(&device, 0, 1, &s.cube_vertex_buffer, &small_stride, &offset);
+        null_draw_indexed(&device, 36, 0, 0); // stride below the layout
+        check(errors, draws_before);
+
+        bind_cubes();
+        begin_case();
+        null_vs_set_constant_buffers(&device, 0, 1, &s.quad_constants);
+        null_draw_indexed(&device, 36, 0, 0); // 16 byte buffer for a 64 byte cbuffer
+        check(errors, draws_before);
+
+        bind_cubes();
+        begin_case();
+        null_map(&device, s.ring_buffer, NULL_MAP_WRITE_NO_OVERWRITE);
+        null_draw_indexed(&device, 36, 0, 0); // bound while mapped
+        check(errors, draws_before);
+
+        begin_case();
+        null_map(&device, s.ring_buffer, NULL_MAP_WRITE_NO_OVERWRITE); // mapped twice
+        check(errors, draws_before);
+        null_unmap(&device, s.ring_buffer);
+
+        begin_case();
+        null_unmap(&device, s.ring_buffer); // not mapped
+        check(errors, draws_before);
+
+        begin_case();
+        null_map(&device, s.colors_buffer, NULL_MAP_WRITE_DISCARD); // immutable
+        check(errors, draws_before);
+
+        begin_case();
+        null_ia_set_input_layout(&device, s.quad_layout);
+        null_draw_indexed(&device, 6, 0, 0); // quad layout reads 16 bytes, cube stride is 12
+        check(errors, draws_before);
+
+        bind_cubes();
+        begin_case();
+        null_ia_set_index_buffer(&device, s.cube_vertex_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+        null_draw_indexed(&device, 6, 0, 0); // vertex buffer bound as index buffer
+        check(errors, draws_before);
+
+        bind_cubes();
+        begin_case();
+        null_release(&device, s.cube_vs);
+        null_draw_indexed(&device, 36, 0, 0); // released shader still bound
+        check(errors, draws_before);
+
+        bool passed = good_draw && caught == cases;
+        printf("broken stream: %d of %d cases caught, %llu errors%s\n", caught, cases,
+            (unsigned long long)device.stats.errors, passed ? "" : " (FAILED)");
+        if (passed == false)
+        {
+            for (const std::string &message : device.messages)
+                printf("  %s\n", message.c_str());
+        }
+        ok = ok && passed;
+        null_device_shutdown(&device);
+    }
+
+    printf("validation checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
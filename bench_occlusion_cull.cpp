@@ -0,0 +1,322 @@
+// walks a camera down a street of a city of box buildings with spinning cubes scattered between
+// and behind them. every frame the cubes are frustum culled, the buildings in view are
+// rasterized as occluders into the occlusion buffer (occlusion_cull.h) on the pool and the
+// surviving cubes are tested against it, then the buildings and the visible cubes are drawn
+// through the software backend. reports the cost of every stage per frame and how many cubes
+// the occlusion test removed.
+// every few frames the frustum culled cubes are drawn as well without the occlusion test, the
+// images have to be identical.
+// usage: bench_occlusion_cull [-n cubes] [-f frames] [-w width] [-h height] [-d buffer divisor] [-t threads] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "frame_timing.h"
+#include "frustum_cull.h"
+#include "occlusion_cull.h"
+#include "simd_math.h"
+#include "sw_raster.h"
+
+enum frame_phase
+{
+    PHASE_FRUSTUM,
+    PHASE_OCCLUDERS,
+    PHASE_OCCLUDEES,
+    PHASE_DRAW,
+    PHASE_COUNT
+};
+
+static const char *phase_names[PHASE_COUNT] = {"frustum", "occluders", "occludees", "draw"};
+
+#define CITY_BLOCKS 12
+#define CITY_BLOCK_SPACING 24.0f
+#define CITY_BUILDING_HALF 8.0f
+#define CHECK_EVERY 10
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t
+next_random(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+static float
+random_range(uint64_t *state, float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(next_random(state) & 0xffffff) / (float)0xffffff;
+}
+
+static sw_float4
+ps_main(const sw_pixel_input *input, const void *const *constant_buffers)
+{
+    const sw_float4 *colors = (const sw_float4 *)constant_buffers[0];
+    return colors[input->primitive_id / 2];
+}
+
+static float
+block_center(int i)
+{
+    return ((float)i - (CITY_BLOCKS - 1) * 0.5f) * CITY_BLOCK_SPACING;
+}
+
+// the camera drives down the street at x = 0 and looks left and right
+static mat4
+camera_view_proj(int frame, int frames, float aspect)
+{
+    float t = (float)frame / (float)frames;
+    float z = -CITY_BLOCKS * CITY_BLOCK_SPACING * 0.5f + t * CITY_BLOCKS * CITY_BLOCK_SPACING * 0.8f;
+    float yaw = 0.6f * sinf(t * 12.0f);
+    return mat4_translation(0.0f, -2.0f, -z) * mat4_rotation_y(-yaw) *
+        mat4_perspective_fov_lh(simd_radians(60.0f), aspect, 0.1f, 1000.0f);
+}
+
+static mat4
+box_world(const float center[3], const float extent[3])
+{
+    return {{v4_set(extent[0], 0, 0, 0), v4_set(0, extent[1], 0, 0), v4_set(0, 0, extent[2], 0), v4_set(center[0], center[1], center[2], 1)}};
+}
+
+int
+main(int argc, char **argv)
+{
+    int cube_count = 20000;
+    int frames = 200;
+    int width = 640;
+    int height = 360;
+    int divisor = 2;
+    int threads = 0;
+    uint64_t state = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            cube_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-w") == 0)
+            width = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-h") == 0)
+            height = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            divisor = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            state = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    float vertices[] = {
+        -1.0f, -1.0f, -1.0f,
+         1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+         1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f
+    };
+
+    unsigned int indices[] = {
+        0, 2, 3,  0, 3, 1,
+        1, 3, 7,  1, 7, 5,
+        5, 7, 6,  5, 6, 4,
+        4, 6, 2,  4, 2, 0,
+        2, 6, 7,  2, 7, 3,
+        0, 1, 5,  0, 5, 4
+    };
+
+    float colors[] = {
+        1.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, 1.0f, 1.0f,
+        1.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 1.0f
+    };
+
+    // one building per block, the buildings are the occluders
+    int building_count = CITY_BLOCKS * CITY_BLOCKS;
+    std::vector<float> building_center((size_t)building_count * 3), building_extent((size_t)building_count * 3);
+    for (int i = 0; i < building_count; ++i)
+    {
+        float height_half = random_range(&state, 3.0f, 15.0f);
+        float *center = &building_center[(size_t)i * 3];
+        float *extent = &building_extent[(size_t)i * 3];
+        center[0] = block_center(i % CITY_BLOCKS);
+        center[1] = height_half;
+        center[2] = block_center(i / CITY_BLOCKS);
+        extent[0] = CITY_BUILDING_HALF;
+        extent[1] = height_half;
+        extent[2] = CITY_BUILDING_HALF;
+    }
+
+    // unit cubes spinning in place in the streets, their boxes bound every orientation
+    float city_half = CITY_BLOCKS * CITY_BLOCK_SPACING * 0.5f;
+    std::vector<float> angle(cube_count), speed(cube_count), tx(cube_count), ty(cube_count), tz(cube_count);
+    frustum_bounds cube_boxes;
+    if (frustum_bounds_init(&cube_boxes, cube_count, FRUSTUM_AABB_STREAMS) == false)
+    {
+        fprintf(stderr, "Failed to allocate %d cube boxes\n", cube_count);
+        return 1;
+    }
+    for (int i = 0; i < cube_count; ++i)
+    {
+        // keep two units away from the buildings so no cube pokes into one
+        float x, z;
+        do
+        {
+            x = random_range(&state, -city_half, city_half);
+            z = random_range(&state, -city_half, city_half);
+        } while (fabsf(x - block_center((int)floorf(x / CITY_BLOCK_SPACING + CITY_BLOCKS * 0.5f))) < CITY_BUILDING_HALF + 2.0f + sqrtf(3.0f) &&
+                 fabsf(z - block_center((int)floorf(z / CITY_BLOCK_SPACING + CITY_BLOCKS * 0.5f))) < CITY_BUILDING_HALF + 2.0f + sqrtf(3.0f));
+        tx[i] = x;
+        ty[i] = random_range(&state, 2.0f, 6.0f);
+        tz[i] = z;
+        speed[i] = random_range(&state, 0.5f, 2.0f);
+        float center[3] = {tx[i], ty[i], tz[i]};
+        float extent[3] = {sqrtf(3.0f), sqrtf(3.0f), sqrtf(3.0f)};
+        frustum_bounds_set_aabb(&cube_boxes, i, center, extent);
+    }
+
+    occlusion_buffer occlusion;
+    sw_render_target culled_target, reference_target;
+    if (occlusion_buffer_init(&occlusion, width / divisor, height / divisor, &pool) == false ||
+        sw_render_target_init(&culled_target, width, height) == false ||
+        sw_render_target_init(&reference_target, width, height) == false)
+    {
+        fprintf(stderr, "Failed to create buffers\n");
+        return 1;
+    }
+    sw_context context;
+    sw_context_init(&context, &pool);
+    sw_viewport viewport = {};
+    viewport.width = (float)width;
+    viewport.height = (float)height;
+    viewport.max_depth = 1.0f;
+
+    mat4_soa world;
+    mat4_soa_init(&world, cube_count);
+    std::vector<float> transforms((size_t)cube_count * 16), instances((size_t)cube_count * 16);
+    std::vector<uint32_t> candidates(cube_count), visible(cube_count);
+    mat4 building_transform;
+
+    // draws the buildings and the listed cubes into target
+    auto draw_scene = [&](sw_render_target *target, const mat4 &view_proj, const uint32_t *cubes, uint32_t count) {
+        float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        sw_om_set_render_target(&context, target);
+        sw_clear_render_target(&context, clear_color);
+        sw_clear_depth(&context, 1.0f);
+
+        sw_ia_set_vertex_buffer(&context, vertices, 3 * sizeof(float), 0);
+        sw_ia_set_index_buffer(&context, indices, 0);
+        sw_ps_set_shader(&context, ps_main);
+        sw_ps_set_constant_buffer(&context, 0, colors);
+        sw_rs_set_viewport(&context, &viewport);
+        sw_om_set_depth_state(&context, true, true, SW_COMPARISON_LESS);
+        sw_vs_set_constant_buffer(&context, 0, &building_transform);
+        for (int i = 0; i < building_count; ++i)
+        {
+            building_transform = mat4_transpose(box_world(&building_center[(size_t)i * 3], &building_extent[(size_t)i * 3]) * view_proj);
+            sw_draw_indexed(&context, 36, 0, 0);
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+            memcpy(&instances[(size_t)i * 16], &transforms[(size_t)cubes[i] * 16], 16 * sizeof(float));
+        sw_ia_set_instance_buffer(&context, instances.data(), 16 * sizeof(float), 0);
+        sw_draw_indexed_instanced(&context, 36, count, 0, 0, 0);
+        sw_flush(&context);
+    };
+
+    frame_timing timing;
+    frame_timing_init(&timing, PHASE_COUNT, phase_names);
+
+    bool ok = true;
+    int checked = 0;
+    int identical = 0;
+    double reference_seconds = 0.0;
+    uint64_t in_frustum = 0, occluded = 0, occluder_triangles = 0;
+    float aspect = (float)width / (float)height;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        mat4 view_proj = camera_view_proj(frame, frames, aspect);
+        for (int i = 0; i < cube_count; ++i)
+            angle[i] = (float)frame / 60.0f * speed[i];
+        mat4_soa_euler_translation(&world, angle.data(), angle.data(), angle.data(), tx.data(), ty.data(), tz.data());
+        mat4_soa_mul_mat4(&world, &world, view_proj);
+        mat4_soa_store_transposed(transforms.data(), &world);
+
+        frame_timing_begin_frame(&timing);
+
+        frustum f = frustum_from_matrix(view_proj);
+        uint32_t candidate_count = frustum_cull_aabbs(&f, &cube_boxes, 0, cube_count, candidates.data());
+        frame_timing_mark(&timing, PHASE_FRUSTUM);
+
+        occlusion_begin(&occlusion);
+        for (int i = 0; i < building_count; ++i)
+        {
+            const float *center = &building_center[(size_t)i * 3];
+            const float *extent = &building_extent[(size_t)i * 3];
+            if (frustum_test_aabb(&f, center, extent))
+                occlusion_add_occluder(&occlusion, vertices, 3 * sizeof(float), indices, 36, box_world(center, extent) * view_proj);
+        }
+        occlusion_rasterize(&occlusion);
+        frame_timing_mark(&timing, PHASE_OCCLUDERS);
+
+        uint32_t visible_count = occlusion_cull_aabbs(&occlusion, view_proj, &cube_boxes, candidates.data(), candidate_count, visible.data());
+        frame_timing_mark(&timing, PHASE_OCCLUDEES);
+
+        draw_scene(&culled_target, view_proj, visible.data(), visible_count);
+        frame_timing_mark(&timing, PHASE_DRAW);
+        frame_timing_end_frame(&timing);
+
+        in_frustum += candidate_count;
+        occluded += occlusion.stats.occluded;
+        occluder_triangles += occlusion.stats.occluder_triangles;
+
+        if (frame % CHECK_EVERY == 0)
+        {
+            double start = now_seconds();
+            draw_scene(&reference_target, view_proj, candidates.data(), candidate_count);
+            reference_seconds += now_seconds() - start;
+            bool same = memcmp(culled_target.color, reference_target.color, (size_t)width * height * sizeof(uint32_t)) == 0;
+            checked++;
+            identical += same;
+            ok = ok && same;
+        }
+    }
+
+    printf("%d cubes, %d buildings, %d frames at %dx%d, occlusion buffer %dx%d, %d threads\n", cube_count, building_count,
+        frames, width, height, occlusion.width, occlusion.height, thread_pool_size(&pool));
+    frame_timing_print(&timing, stdout);
+    printf("\n%-22s %10.0f\n", "in frustum/frame", (double)in_frustum / frames);
+    printf("%-22s %10.0f\n", "occluded/frame", (double)occluded / frames);
+    printf("%-22s %9.1f%%\n", "occluded", in_frustum ? 100.0 * (double)occluded / (double)in_frustum : 0.0);
+    printf("%-22s %10.0f\n", "occluder tris/frame", (double)occluder_triangles / frames);
+    printf("%-22s %10.3f\n", "draw, frustum only ms", checked ? reference_seconds * 1000.0 / checked : 0.0);
+    printf("images identical in %d of %d checked frames\n", identical, checked);
+
+    ok = ok && occluded > 0;
+
+    frame_timing_free(&timing);
+    mat4_soa_free(&world);
+    sw_render_target_free(&reference_target);
+    sw_render_target_free(&culled_target);
+    occlusion_buffer_free(&occlusion);
+    frustum_bounds_free(&cube_boxes);
+    thread_pool_shutdown(&pool);
+
+    printf("occlusion checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+// cost of a PROFILE_ZONE (profile.h) on one thread and on several recording at once, next to
+// the empty loop, the raw timestamp and the steady clock it replaces. the zones are always
+// compiled in here, everywhere else they only exist with PROFILE_ENABLED.
+// the trace written at the end is read back to check that every recorded zone made it into
+// the file and that nested zones lie inside their parents.
+// usage: bench_profile [-n zones per thread] [-t max threads] [-o trace.json]
+
+#define PROFILE_ENABLED 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "profile.h"
+
+// keeps the loops from being optimized away
+static volatile uint64_t sink;
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// batches stay below the per thread capacity, the buffers are reset between them
+#define BATCH_ZONES (PROFILE_EVENTS_PER_THREAD / 2)
+
+static double
+empty_loop(int count)
+{
+    double start = now_seconds();
+    for (int i = 0; i < count; ++i)
+        sink = sink + (uint64_t)i;
+    return now_seconds() - start;
+}
+
+static double
+ticks_loop(int count)
+{
+    double start = now_seconds();
+    for (int i = 0; i < count; ++i)
+        sink = sink + profile_ticks();
+    return now_seconds() - start;
+}
+
+static double
+clock_loop(int count)
+{
+    double start = now_seconds();
+    for (int i = 0; i < count; ++i)
+        sink = sink + (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    return now_seconds() - start;
+}
+
+static double
+zone_loop(int count)
+{
+    double start = now_seconds();
+    for (int i = 0; i < count; ++i)
+    {
+        PROFILE_ZONE("bench zone");
+        sink = sink + (uint64_t)i;
+    }
+    return now_seconds() - start;
+}
+
+// runs fn in batches of at most BATCH_ZONES and returns ns per iteration
+static double
+measure(double (*fn)(int), int total)
+{
+    double seconds = 0.0;
+    for (int done = 0; done < total; done += BATCH_ZONES)
+    {
+        int count = total - done < BATCH_ZONES ? total - done : BATCH_ZONES;
+        seconds += fn(count);
+        profile_reset();
+    }
+    return seconds * 1e9 / total;
+}
+
+// a parent zone with two nested children, recorded by every thread of the trace check
+static void
+nested_zones(int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        PROFILE_ZONE("parent");
+        {
+            PROFILE_ZONE("child a");
+            sink = sink + (uint64_t)i;
+        }
+        {
+            PROFILE_ZONE("child b");
+            sink = sink + (uint64_t)i * 3;
+        }
+    }
+}
+
+struct trace_zone
+{
+    std::string name;
+    uint32_t tid;
+    double ts;
+    double dur;
+};
+
+// reads back the complete events written by profile_write_chrome_trace, one per line
+static bool
+read_trace(const char *path, std::vector<trace_zone> *zones)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr)
+        return false;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+    {
+        if (strstr(line, "\"ph\":\"X\"") == nullptr)
+            continue;
+        char name[128];
+        trace_zone zone;
+        if (sscanf(line, "{\"name\":\"%127[^\"]\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lf,\"dur\":%lf}",
+                name, &zone.tid, &zone.ts, &zone.dur) != 4)
+        {
+            fclose(file);
+            return false;
+        }
+        zone.name = name;
+        zones->push_back(zone);
+    }
+    fclose(file);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    int zones = 4000000;
+    int max_threads = 8;
+    const char *trace_path = "bench_profile_trace.json";
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            zones = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            max_threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0)
+            trace_path = argv[i + 1];
+    }
+
+    PROFILE_THREAD_NAME("main");
+    printf("%d zones, ticks %.1f per us\n\n", zones, profile_ticks_per_us());
+
+    printf("%-22s %10s\n", "one thread", "ns/iter");
+    printf("%-22s %10.2f\n", "empty loop", measure(empty_loop, zones));
+    printf("%-22s %10.2f\n", "profile_ticks", measure(ticks_loop, zones));
+    printf("%-22s %10.2f\n", "steady_clock::now", measure(clock_loop, zones));
+    double zone_ns = measure(zone_loop, zones);
+    printf("%-22s %10.2f\n", "PROFILE_ZONE", zone_ns);
+
+    // every thread records into its own buffer, nothing is shared while recording
+    printf("\n%-22s %10s %12s\n", "threads", "ns/zone", "zones/s");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        int per_thread = BATCH_ZONES;
+        std::vector<std::thread> workers;
+        double start = now_seconds();
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back([per_thread] { zone_loop(per_thread); });
+        for (std::thread &worker : workers)
+            worker.join();
+        double seconds = now_seconds() - start;
+
+        profile_stats stats = profile_get_stats();
+        printf("%-22d %10.2f %12.0f%s\n", threads, seconds * 1e9 / per_thread, (double)threads * per_thread / seconds,
+            stats.events == (uint64_t)threads * per_thread ? "" : "  lost zones");
+        profile_reset();
+    }
+
+    // trace check, nested zones on a few threads plus one that overflows its buffer
+    int nested = 1000;
+    int trace_threads = max_threads < 4 ? max_threads : 4;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < trace_threads; ++t)
+    {
+        workers.emplace_back([nested] {
+            PROFILE_THREAD_NAME("trace worker");
+            nested_zones(nested);
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    zone_loop(PROFILE_EVENTS_PER_THREAD + 100);
+
+    profile_stats stats = profile_get_stats();
+    bool ok = profile_write_chrome_trace(trace_path);
+
+    std::vector<trace_zone> read;
+    ok = ok && read_trace(trace_path, &read);
+    ok = ok && read.size() == stats.events;
+    ok = ok && stats.dropped == 100;
+
+    // events are recorded when a zone closes, children come right before their parent
+    int parents = 0;
+    for (size_t i = 2; ok && i < read.size(); ++i)
+    {
+        if (read[i].name != "parent")
+            continue;
+        parents++;
+        const trace_zone *parent = &read[i];
+        for (size_t child = i - 2; child < i; ++child)
+        {
+            const trace_zone *c = &read[child];
+            ok = ok && c->tid == parent->tid && c->name.compare(0, 5, "child") == 0;
+            // timestamps are printed with 3 decimals
+            ok = ok && c->ts >= parent->ts - 0.001 && c->ts + c->dur <= parent->ts + parent->dur + 0.002;
+        }
+    }
+    ok = ok && parents == nested * trace_threads;
+    printf("\ntrace %s: %llu zones from %u threads, %llu dropped\n", trace_path, (unsigned long long)stats.events,
+        stats.threads, (unsigned long long)stats.dropped);
+
+    printf("profile checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// exercises shader_cache.h with a stub compiler that does a fixed amount of work per shader,
+// calibrated to take compile_ms on one thread, and emits bytecode derived from its inputs.
+// compiles a set of shader permutations with a cold cache serially and on the thread pool,
+// then again from memory and from disk as a second run would, and checks that every path
+// returns the same bytecode.
+// usage: bench_shader_cache [-d dir] [-n shaders] [-c compile_ms] [-t threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "shader_cache.h"
+
+struct stub_compiler
+{
+    double compile_ms;
+    uint64_t rounds; // of stub_work per shader
+};
+
+static volatile uint64_t stub_sink;
+
+static uint64_t
+stub_work(uint64_t rounds)
+{
+    uint64_t x = 1;
+    for (uint64_t i = 0; i < rounds; ++i)
+        x = x * 6364136223846793005ull + (x >> 29);
+    return x;
+}
+
+static bool
+stub_compile(void *user, const shader_desc *desc, std::vector<uint8_t> *bytecode, std::string *errors)
+{
+    const stub_compiler *compiler = (const stub_compiler *)user;
+    stub_sink = stub_work(compiler->rounds);
+
+    std::string source(desc->source, desc->source_size);
+    if (source.find("#error") != std::string::npos)
+    {
+        *errors = std::string(desc->name) + ": error X1000: #error directive\n";
+        return false;
+    }
+
+    // "bytecode" is a hash of the inputs repeated to half the source size
+    uint64_t hash = shader_cache_hash(0xcbf29ce484222325ull, desc->source, desc->source_size);
+    hash = shader_cache_hash_string(hash, desc->entry);
+    hash = shader_cache_hash_string(hash, desc->profile);
+    for (const shader_define *define = desc->defines; define && define->name; ++define)
+    {
+        hash = shader_cache_hash_string(hash, define->name);
+        hash = shader_cache_hash_string(hash, define->definition);
+    }
+    bytecode->assign({'D', 'X', 'B', 'C'});
+    while (bytecode->size() < desc->source_size / 2 + 4)
+    {
+        hash = hash * 6364136223846793005ull + 1442695040888963407ull;
+        bytecode->push_back((uint8_t)(hash >> 56));
+    }
+    return true;
+}
+
+static const char shader_src[] = R"(
+    cbuffer Constants
+    {
+        float4x4 mvp;
+        float4 tint;
+    };
+
+    struct VS_Out
+    {
+        float3 color : Color;
+        float4 position : SV_Position;
+    };
+
+    VS_Out vs_main(float3 position : Position, float3 color : Color)
+    {
+        VS_Out output;
+        output.position = mul(float4(position, 1), mvp);
+        output.color = color;
+    #if LIGHT_COUNT > 0
+        output.color *= LIGHT_COUNT * 0.25;
+    #endif
+        return output;
+    }
+
+    float4 ps_main(float3 color : Color) : SV_Target
+    {
+    #if USE_TINT
+        return float4(color, 1) * tint;
+    #else
+        return float4(color, 1);
+    #endif
+    }
+)";
+
+// every permutation is a vs and a ps with its own defines
+struct permutation
+{
+    char light_count[8];
+    char use_tint[8];
+    shader_define defines[3];
+};
+
+struct phase_result
+{
+    double ms;
+    shader_cache_stats stats;
+};
+
+static phase_result
+run_phase(shader_cache *cache, const std::vector<shader_desc> &descs, std::vector<shader_result> *results, thread_pool *pool)
+{
+    shader_cache_stats before = shader_cache_get_stats(cache);
+    double start = shader_cache_now();
+    shader_cache_compile_many(cache, descs.data(), (int)descs.size(), results->data(), pool);
+    phase_result phase;
+    phase.ms = (shader_cache_now() - start) * 1000.0;
+
+    shader_cache_stats after = shader_cache_get_stats(cache);
+    phase.stats = after;
+    phase.stats.lookups -= before.lookups;
+    phase.stats.memory_hits -= before.memory_hits;
+    phase.stats.disk_hits -= before.disk_hits;
+    phase.stats.compiles -= before.compiles;
+    phase.stats.failures -= before.failures;
+    phase.stats.saved_seconds -= before.saved_seconds;
+    return phase;
+}
+
+static void
+print_phase(const char *name, const phase_result *phase)
+{
+    const shader_cache_stats *stats = &phase->stats;
+    uint64_t hits = stats->memory_hits + stats->disk_hits;
+    printf("%-22s %10.2f %8llu %8llu %8llu %9.1f%% %10.2f\n", name, phase->ms, (unsigned long long)stats->memory_hits,
+        (unsigned long long)stats->disk_hits, (unsigned long long)stats->compiles,
+        stats->lookups ? 100.0 * (double)hits / (double)stats->lookups : 0.0, stats->saved_seconds * 1000.0);
+}
+
+static bool
+same_bytecode(const std::vector<shader_result> &a, const std::vector<shader_result> &b)
+{
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].ok == false || b[i].ok == false || a[i].bytecode != b[i].bytecode)
+            return false;
+    }
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *dir = "shader_cache_bench";
+    int shader_count = 64;
+    int threads = 0;
+    stub_compiler compiler_state = {15.0, 0};
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+            dir = argv[i + 1];
+        else if (strcmp(argv[i], "-n") == 0)
+            shader_count = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            compiler_state.compile_ms = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+    }
+    if (shader_count < 2)
+        shader_count = 2;
+
+    // rounds per millisecond, measured on this thread
+    {
+        uint64_t rounds = 1 << 20;
+        double start = shader_cache_now();
+        stub_sink = stub_work(rounds);
+        double ms = (shader_cache_now() - start) * 1000.0;
+        compiler_state.rounds = (uint64_t)((double)rounds * compiler_state.compile_ms / ms);
+    }
+
+    shader_compiler compiler = {};
+    compiler.name = "stub";
+    compiler.version = 1;
+    compiler.compile = stub_compile;
+    compiler.user = &compiler_state;
+
+    std::vector<permutation> permutations(shader_count / 2);
+    std::vector<shader_desc> descs;
+    for (size_t i = 0; i < permutations.size(); ++i)
+    {
+        permutation *p = &permutations[i];
+        snprintf(p->light_count, sizeof(p->light_count), "%d", (int)(i / 2));
+        snprintf(p->use_tint, sizeof(p->use_tint), "%d", (int)(i & 1));
+        p->defines[0] = {"LIGHT_COUNT", p->light_count};
+        p->defines[1] = {"USE_TINT", p->use_tint};
+        p->defines[2] = {nullptr, nullptr};
+
+        descs.push_back({"shader_src", shader_src, sizeof(shader_src), "vs_main", "vs_5_0", p->defines, 0});
+        descs.push_back({"shader_src", shader_src, sizeof(shader_src), "ps_main", "ps_5_0", p->defines, 0});
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    printf("%d shaders, stub compile %.1f ms, %d threads, cache in %s\n", (int)descs.size(), compiler_state.compile_ms,
+        thread_pool_size(&pool), dir);
+    printf("%-22s %10s %8s %8s %8s %10s %10s\n", "", "ms", "memory", "disk", "compiled", "hit rate", "saved ms");
+
+    // start from an empty cache directory
+    shader_cache cache;
+    shader_cache_init(&cache, dir, compiler);
+    auto clear_disk = [&]() {
+        for (const shader_desc &desc : descs)
+            remove(shader_cache_path(&cache, shader_cache_key(&cache, &desc)).c_str());
+    };
+
+    std::vector<shader_result> reference(descs.size());
+    std::vector<shader_result> results(descs.size());
+
+    clear_disk();
+    phase_result phase = run_phase(&cache, descs, &reference, nullptr);
+    print_phase("cold, serial", &phase);
+
+    clear_disk();
+    shader_cache_init(&cache, dir, compiler);
+    phase = run_phase(&cache, descs, &results, &pool);
+    print_phase("cold, parallel", &phase);
+    bool ok = same_bytecode(reference, results);
+
+    phase = run_phase(&cache, descs, &results, &pool);
+    print_phase("warm, memory", &phase);
+    ok = ok && same_bytecode(reference, results);
+
+    // a fresh cache on the same directory is what the next run of the program sees
+    shader_cache_init(&cache, dir, compiler);
+    phase = run_phase(&cache, descs, &results, nullptr);
+    print_phase("warm, disk", &phase);
+    ok = ok && same_bytecode(reference, results);
+
+    // a changed define or flag is a new key, a compile error is reported and not cached
+    {
+        shader_define defines[] = {{"LIGHT_COUNT", "99"}, {nullptr, nullptr}};
+        shader_desc changed = descs[0];
+        changed.defines = defines;
+        remove(shader_cache_path(&cache, shader_cache_key(&cache, &changed)).c_str());
+        changed.flags = 1;
+        remove(shader_cache_path(&cache, shader_cache_key(&cache, &changed)).c_str());
+        changed.flags = 0;
+        shader_result result;
+        shader_cache_compile(&cache, &changed, &result);
+        ok = ok && result.ok && result.cached == false && result.bytecode != reference[0].bytecode;
+
+        changed.flags = 1;
+        shader_cache_compile(&cache, &changed, &result);
+        ok = ok && result.ok && result.cached == false;
+
+        const char broken_src[] = "#error broken\n";
+        shader_desc broken = {"broken", broken_src, sizeof(broken_src), "vs_main", "vs_5_0", nullptr, 0};
+        for (int i = 0; i < 2; ++i)
+        {
+            shader_cache_compile(&cache, &broken, &result);
+            ok = ok && result.ok == false && result.cached == false && result.errors.empty() == false;
+        }
+    }
+
+    shader_cache_stats total = shader_cache_get_stats(&cache);
+    printf("last run: %llu lookups, %llu compiles, %llu failures\n", (unsigned long long)total.lookups,
+        (unsigned long long)total.compiles, (unsigned long long)total.failures);
+    printf("bytecode and invalidation checks: %s\n", ok ? "ok" : "FAILED");
+
+    thread_pool_shutdown(&pool);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,488 @@
+// replays the example_cubes stream on the null device (null_device.h) at 10k draws per frame,
+// straight to the device and through the redundant state filter in state_cache.h, once as the
+// example issues it (frame state once, a constant buffer range per draw) and once the way a
+// naive renderer does, every piece of state again before every draw with a material switch
+// every 16 draws. reports time per frame and issued, elided and merged calls per frame. null
+// set calls cost next to nothing where a d3d11 runtime and driver spend around a hundred ns
+// on one, so the last column adds call_ns per call that reached the device to the measured
+// time as an estimate of what the filter saves on a real context.
+// a randomized stream then checks that the cached device always ends up in the same state as
+// the direct one.
+// usage: bench_state_cache [-f frames] [-d draws per frame] [-c call_ns] [-s seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "cbuffer_ring.h"
+#include "simd_math.h"
+#include "state_cache_null.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ring_device
+{
+    null_device *device;
+    null_handle buffer;
+};
+
+static uint64_t
+ring_signal_fence(void *user)
+{
+    return null_signal_fence(((ring_device *)user)->device);
+}
+
+static uint64_t
+ring_completed_fence(void *user)
+{
+    return null_completed_fence(((ring_device *)user)->device);
+}
+
+static void
+ring_wait_fence(void *user, uint64_t fence)
+{
+    null_wait_fence(((ring_device *)user)->device, fence);
+}
+
+static void *
+ring_map(void *user, uint32_t offset, uint32_t size)
+{
+    ring_device *ring = (ring_device *)user;
+    uint8_t *memory = (uint8_t *)null_map(ring->device, ring->buffer, NULL_MAP_WRITE_NO_OVERWRITE);
+    return memory ? memory + offset : nullptr;
+}
+
+static void
+ring_unmap(void *user)
+{
+    ring_device *ring = (ring_device *)user;
+    null_unmap(ring->device, ring->buffer);
+}
+
+static const float cube_vertices[] = {
+    -1.0f, -1.0f, -1.0f,
+     1.0f, -1.0f, -1.0f,
+    -1.0f,  1.0f, -1.0f,
+     1.0f,  1.0f, -1.0f,
+    -1.0f, -1.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f,
+     1.0f,  1.0f,  1.0f
+};
+
+static const uint32_t cube_indices[] = {
+    0, 2, 3,  0, 3, 1,
+    1, 3, 7,  1, 7, 5,
+    5, 7, 6,  5, 6, 4,
+    4, 6, 2,  4, 2, 0,
+    2, 6, 7,  2, 7, 3,
+    0, 1, 5,  0, 5, 4
+};
+
+static const float cube_colors[24] = {};
+
+#define MATERIAL_COUNT 4
+
+// every object as the pointer the cache sees
+struct scene
+{
+    void *render_target;
+    void *depth_stencil;
+    void *depth_state;
+    null_viewport viewport;
+    void *layout;
+    void *vertex_buffer;
+    void *index_buffer;
+    void *vs;
+    void *colors_buffer;
+    void *ring_buffer;
+    void *sampler;
+
+    // pixel shader, albedo and normal map
+    void *material_ps[MATERIAL_COUNT];
+    void *material_views[MATERIAL_COUNT][2];
+};
+
+static void
+scene_init(null_device *device, scene *s, uint32_t ring_size)
+{
+    s->render_target = state_cache_null_object(null_create_render_target_view(device, 1280, 720));
+    s->depth_stencil = state_cache_null_object(null_create_depth_stencil_view(device, 1280, 720));
+    s->depth_state = state_cache_null_object(null_create_depth_stencil_state(device));
+    s->viewport = {0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f};
+
+    null_input_element elements[] = {{0, 0, 12, false}};
+    s->layout = state_cache_null_object(null_create_input_layout(device, elements, 1));
+    s->vertex_buffer = state_cache_null_object(
+        null_create_buffer(device, sizeof(cube_vertices), NULL_USAGE_IMMUTABLE, NULL_BIND_VERTEX_BUFFER, cube_vertices));
+    s->index_buffer = state_cache_null_object(
+        null_create_buffer(device, sizeof(cube_indices), NULL_USAGE_IMMUTABLE, NULL_BIND_INDEX_BUFFER, cube_indices));
+    null_shader_desc vs_desc = {};
+    vs_desc.constant_buffer_sizes[0] = sizeof(mat4);
+    s->vs = state_cache_null_object(null_create_vertex_shader(device, &vs_desc));
+    s->colors_buffer = state_cache_null_object(
+        null_create_buffer(device, sizeof(cube_colors), NULL_USAGE_IMMUTABLE, NULL_BIND_CONSTANT_BUFFER, cube_colors));
+    s->ring_buffer = state_cache_null_object(null_create_buffer(device, ring_size, NULL_USAGE_DYNAMIC, NULL_BIND_CONSTANT_BUFFER));
+    s->sampler = state_cache_null_object(null_create_sampler_state(device));
+
+    null_shader_desc ps_desc = {};
+    ps_desc.constant_buffer_sizes[0] = sizeof(cube_colors);
+    ps_desc.resource_mask = 0x3;
+    ps_desc.sampler_mask = 0x1;
+    for (int i = 0; i < MATERIAL_COUNT; ++i)
+    {
+        s->material_ps[i] = state_cache_null_object(null_create_pixel_shader(device, &ps_desc));
+        s->material_views[i][0] = state_cache_null_object(null_create_shader_resource_view(device, 512, 512));
+        s->material_views[i][1] = state_cache_null_object(null_create_shader_resource_view(device, 512, 512));
+    }
+}
+
+// the calls a renderer makes, either straight on the device or on the cache in front of it
+struct renderer
+{
+    null_device *device;
+    state_cache *cache; // null goes straight to the device
+};
+
+static void
+bind_frame_state(renderer *r, const scene *s, int material)
+{
+    if (r->cache)
+    {
+        state_cache *cache = r->cache;
+        state_cache_ia_set_input_layout(cache, s->layout);
+        state_cache_ia_set_primitive_topology(cache, NULL_TOPOLOGY_TRIANGLELIST);
+        state_cache_ia_set_vertex_buffer(cache, 0, s->vertex_buffer, sizeof(float) * 3, 0);
+        state_cache_ia_set_index_buffer(cache, s->index_buffer, NULL_INDEX_FORMAT_R32_UINT, 0);
+        state_cache_vs_set_shader(cache, s->vs);
+        state_cache_ps_set_shader(cache, s->material_ps[material]);
+        state_cache_ps_set_constant_buffer(cache, 0, s->colors_buffer);
+        state_cache_ps_set_shader_resource(cache, 0, s->material_views[material][0]);
+        state_cache_ps_set_shader_resource(cache, 1, s->material_views[material][1]);
+        state_cache_ps_set_sampler(cache, 0, s->sampler);
+        state_cache_rs_set_viewports(cache, 1, (const state_cache_viewport *)&s->viewport);
+        state_cache_om_set_render_target(cache, 0, s->render_target);
+        state_cache_om_set_depth_stencil_view(cache, s->depth_stencil);
+        state_cache_om_set_depth_stencil_state(cache, s->depth_state, 1);
+        return;
+    }
+
+    null_device *device = r->device;
+    null_handle vertex_buffer = state_cache_null_handle(s->vertex_buffer);
+    null_handle colors_buffer = state_cache_null_handle(s->colors_buffer);
+    null_handle views[2] = {state_cache_null_handle(s->material_views[material][0]), state_cache_null_handle(s->material_views[material][1])};
+    null_handle sampler = state_cache_null_handle(s->sampler);
+    null_handle render_target = state_cache_null_handle(s->render_target);
+    uint32_t stride = sizeof(float) * 3;
+    uint32_t offset = 0;
+    null_ia_set_input_layout(device, state_cache_null_handle(s->layout));
+    null_ia_set_primitive_topology(device, NULL_TOPOLOGY_TRIANGLELIST);
+    null_ia_set_vertex_buffers(device, 0, 1, &vertex_buffer, &stride, &offset);
+    null_ia_set_index_buffer(device, state_cache_null_handle(s->index_buffer), NULL_INDEX_FORMAT_R32_UINT, 0);
+    null_vs_set_shader(device, state_cache_null_handle(s->vs));
+    null_ps_set_shader(device, state_cache_null_handle(s->material_ps[material]));
+    null_ps_set_constant_buffers(device, 0, 1, &colors_buffer);
+    null_ps_set_shader_resources(device, 0, 1, &views[0]);
+    null_ps_set_shader_resources(device, 1, 1, &views[1]);
+    null_ps_set_samplers(device, 0, 1, &sampler);
+    null_rs_set_viewports(device, 1, &s->viewport);
+    null_om_set_render_targets(device, 1, &render_target, state_cache_null_handle(s->depth_stencil));
+    null_om_set_depth_stencil_state(device, state_cache_null_handle(s->depth_state), 1);
+}
+
+static void
+draw_cube(renderer *r, const scene *s, uint32_t first_constant, uint32_t constant_count)
+{
+    if (r->cache)
+    {
+        state_cache_vs_set_constant_buffer(r->cache, 0, s->ring_buffer, first_constant, constant_count);
+        state_cache_draw_indexed(r->cache, 36, 0, 0);
+        return;
+    }
+
+    null_handle ring_buffer = state_cache_null_handle(s->ring_buffer);
+    null_vs_set_constant_buffers(r->device, 0, 1, &ring_buffer, &first_constant, &constant_count);
+    null_draw_indexed(r->device, 36, 0, 0);
+}
+
+// per_draw_state rebinds everything before every draw like a renderer that doesn't track
+// state, otherwise the frame state goes out once like in example_cubes
+static void
+run_frame(renderer *r, const scene *s, cbuffer_ring *ring, int draws, bool per_draw_state, float angle, const mat4 &proj)
+{
+    float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    null_clear_render_target_view(r->device, state_cache_null_handle(s->render_target), clear_color);
+    null_clear_depth_stencil_view(r->device, state_cache_null_handle(s->depth_stencil), 1.0f);
+
+    if (per_draw_state == false)
+        bind_frame_state(r, s, 0);
+
+    mat4 rotation = mat4_rotation_x(angle) * mat4_rotation_y(angle) * mat4_rotation_z(angle);
+    cbuffer_ring_begin_frame(ring);
+    for (int i = 0; i < draws; ++i)
+    {
+        if (per_draw_state)
+            bind_frame_state(r, s, (i / 16) % MATERIAL_COUNT);
+
+        mat4 mvp = mat4_transpose(rotation * mat4_translation((float)(i % 64) - 32.0f, (float)(i / 64 % 64) - 32.0f, 40.0f) * proj);
+        cbuffer_ring_allocation allocation;
+        if (cbuffer_ring_write(ring, &mvp, sizeof(mvp), &allocation) == false)
+            break;
+        draw_cube(r, s, allocation.offset / 16, allocation.size / 16);
+    }
+    cbuffer_ring_end_frame(ring);
+    if (r->cache)
+        state_cache_end_frame(r->cache);
+    null_present(r->device);
+}
+
+static bool
+run_mode(const char *name, int frames, int draws, bool per_draw_state, bool cached, double call_ns)
+{
+    uint32_t ring_size = (uint32_t)draws * CBUFFER_RING_ALIGNMENT * 4;
+    null_device device;
+    null_device_init(&device);
+    scene s;
+    scene_init(&device, &s, ring_size);
+
+    state_cache cache;
+    state_cache_backend backend = state_cache_backend_null(&device);
+    state_cache_init(&cache, &backend);
+    renderer r = {&device, cached ? &cache : nullptr};
+
+    ring_device ring_user = {&device, state_cache_null_handle(s.ring_buffer)};
+    cbuffer_ring_backend ring_backend = {&ring_user, ring_signal_fence, ring_completed_fence, ring_wait_fence, ring_map, ring_unmap};
+    cbuffer_ring ring;
+    cbuffer_ring_init(&ring, ring_size, &ring_backend);
+
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+    null_stats before = device.stats;
+    double start = now_seconds();
+    for (int frame = 0; frame < frames; ++frame)
+        run_frame(&r, &s, &ring, draws, per_draw_state, (float)frame * 0.01f, proj);
+    double seconds = now_seconds() - start;
+
+    // without the cache every set call is issued
+    uint64_t device_sets = device.stats.state_changes - before.state_changes;
+    state_cache_stats frame = cache.last_frame;
+    if (cached == false)
+    {
+        frame.set_calls = device_sets / frames;
+        frame.issued_calls = frame.set_calls;
+        frame.draws = (uint64_t)draws;
+    }
+
+    double ms = seconds * 1000.0 / frames;
+    double estimate_ms = ms + (double)device_sets / frames * call_ns * 1e-6;
+    printf("%-26s %9.3f %8.1f %9llu %9llu %9llu %9llu %7llu %12.3f\n", name, ms, seconds * 1e9 / ((double)frames * draws),
+        (unsigned long long)frame.set_calls, (unsigned long long)frame.issued_calls, (unsigned long long)frame.elided_calls,
+        (unsigned long long)frame.merged_calls, (unsigned long long)device.stats.errors, estimate_ms);
+
+    bool ok = device.stats.errors == 0 && device.stats.draws == (uint64_t)frames * draws &&
+        frame.set_calls == frame.issued_calls + frame.elided_calls + frame.merged_calls;
+    null_device_shutdown(&device);
+    return ok;
+}
+
+// a whole buffer binding is the same as its first 4096 constants
+static bool
+same_constant_buffers(const null_constant_binding *a, const null_constant_binding *b)
+{
+    for (int slot = 0; slot < NULL_CONSTANT_BUFFER_SLOTS; ++slot)
+    {
+        uint32_t a_count = a[slot].constant_count ? a[slot].constant_count : NULL_MAX_CONSTANTS;
+        uint32_t b_count = b[slot].constant_count ? b[slot].constant_count : NULL_MAX_CONSTANTS;
+        if (a[slot].buffer != b[slot].buffer || a[slot].first_constant != b[slot].first_constant || a_count != b_count)
+            return false;
+    }
+    return true;
+}
+
+// the pipeline state the null device ended up with, minus bookkeeping
+static bool
+same_device_state(const null_device *a, const null_device *b)
+{
+    return a->input_layout == b->input_layout && a->topology == b->topology &&
+        memcmp(a->vertex_buffers, b->vertex_buffers, sizeof(a->vertex_buffers)) == 0 &&
+        memcmp(a->vertex_strides, b->vertex_strides, sizeof(a->vertex_strides)) == 0 &&
+        memcmp(a->vertex_offsets, b->vertex_offsets, sizeof(a->vertex_offsets)) == 0 &&
+        a->index_buffer == b->index_buffer && a->index_format == b->index_format && a->index_offset == b->index_offset &&
+        a->vertex_shader == b->vertex_shader && a->pixel_shader == b->pixel_shader &&
+        same_constant_buffers(a->vs_constant_buffers, b->vs_constant_buffers) &&
+        same_constant_buffers(a->ps_constant_buffers, b->ps_constant_buffers) &&
+        memcmp(a->ps_resources, b->ps_resources, sizeof(a->ps_resources)) == 0 &&
+        memcmp(a->ps_samplers, b->ps_samplers, sizeof(a->ps_samplers)) == 0 &&
+        a->viewport_count == b->viewport_count && memcmp(a->viewports, b->viewports, a->viewport_count * sizeof(null_viewport)) == 0 &&
+        memcmp(a->render_targets, b->render_targets, sizeof(a->render_targets)) == 0 &&
+        a->depth_stencil_view == b->depth_stencil_view && a->depth_stencil_state == b->depth_stencil_state;
+}
+
+static uint32_t
+random_next(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return (uint32_t)(*state >> 33);
+}
+
+// random set calls out of a small pool of objects so most of them are redundant, both devices
+// see the same stream and have to agree at every draw
+static bool
+check_random_stream(uint64_t seed, int draws)
+{
+    null_device direct;
+    null_device cached;
+    null_device_init(&direct);
+    null_device_init(&cached);
+    scene s;
+    scene_init(&direct, &s, CBUFFER_RING_ALIGNMENT * 16);
+    scene_init(&cached, &s, CBUFFER_RING_ALIGNMENT * 16);
+
+    state_cache cache;
+    state_cache_backend backend = state_cache_backend_null(&cached);
+    state_cache_init(&cache, &backend);
+
+    null_viewport viewports[2] = {s.viewport, {0.0f, 0.0f, 640.0f, 360.0f, 0.0f, 1.0f}};
+    void *buffers[] = {s.vertex_buffer, s.ring_buffer, s.colors_buffer, nullptr};
+    void *views[] = {s.material_views[0][0], s.material_views[1][0], s.material_views[2][1], nullptr};
+
+    uint64_t random = seed;
+    int mismatches = 0;
+    for (int draw = 0; draw < draws; ++draw)
+    {
+        int sets = 1 + random_next(&random) % 6;
+        for (int i = 0; i < sets; ++i)
+        {
+            uint32_t slot = random_next(&random) % 4;
+            uint32_t pick = random_next(&random) % 4;
+            switch (random_next(&random) % 9)
+            {
+                case 0:
+                {
+                    void *buffer = buffers[pick];
+                    uint32_t stride = 12 + 4 * (random_next(&random) % 2);
+                    uint32_t offset = 0;
+                    null_handle handle = state_cache_null_handle(buffer);
+                    null_ia_set_vertex_buffers(&direct, slot, 1, &handle, &stride, &offset);
+                    state_cache_ia_set_vertex_buffer(&cache, slot, buffer, stride, offset);
+                    break;
+                }
+                case 1:
+                {
+                    uint32_t first = 16 * (random_next(&random) % 3);
+                    uint32_t count = 16 * (random_next(&random) % 2);
+                    null_handle handle = state_cache_null_handle(buffers[pick]);
+                    null_vs_set_constant_buffers(&direct, slot, 1, &handle, count ? &first : nullptr, count ? &count : nullptr);
+                    state_cache_vs_set_constant_buffer(&cache, slot, buffers[pick], count ? first : 0, count);
+                    break;
+                }
+                case 2:
+                {
+                    null_handle handle = state_cache_null_handle(views[pick]);
+                    null_ps_set_shader_resources(&direct, slot, 1, &handle);
+                    state_cache_ps_set_shader_resource(&cache, slot, views[pick]);
+                    break;
+                }
+                case 3:
+                {
+                    void *sampler = pick & 1 ? s.sampler : nullptr;
+                    null_handle handle = state_cache_null_handle(sampler);
+                    null_ps_set_samplers(&direct, slot, 1, &handle);
+                    state_cache_ps_set_sampler(&cache, slot, sampler);
+                    break;
+                }
+                case 4:
+                    null_ps_set_shader(&direct, state_cache_null_handle(s.material_ps[pick]));
+                    state_cache_ps_set_shader(&cache, s.material_ps[pick]);
+                    break;
+                case 5:
+                    null_ia_set_index_buffer(&direct, state_cache_null_handle(s.index_buffer), NULL_INDEX_FORMAT_R32_UINT, 4 * (pick & 1));
+                    state_cache_ia_set_index_buffer(&cache, s.index_buffer, NULL_INDEX_FORMAT_R32_UINT, 4 * (pick & 1));
+                    break;
+                case 6:
+                    null_rs_set_viewports(&direct, 1, &viewports[pick & 1]);
+                    state_cache_rs_set_viewports(&cache, 1, (const state_cache_viewport *)&viewports[pick & 1]);
+                    break;
+                case 7:
+                {
+                    null_handle render_target = state_cache_null_handle(s.render_target);
+                    void *depth_stencil = pick & 1 ? s.depth_stencil : nullptr;
+                    null_om_set_render_targets(&direct, 1, &render_target, state_cache_null_handle(depth_stencil));
+                    state_cache_om_set_render_target(&cache, 0, s.render_target);
+                    state_cache_om_set_depth_stencil_view(&cache, depth_stencil);
+                    break;
+                }
+                case 8:
+                    null_ia_set_input_layout(&direct, pick & 1 ? state_cache_null_handle(s.layout) : 0);
+                    state_cache_ia_set_input_layout(&cache, pick & 1 ? s.layout : nullptr);
+                    null_ia_set_primitive_topology(&direct, NULL_TOPOLOGY_TRIANGLELIST);
+                    state_cache_ia_set_primitive_topology(&cache, NULL_TOPOLOGY_TRIANGLELIST);
+                    break;
+            }
+        }
+
+        // the state is mostly not drawable, the draw only has to happen on both or neither
+        uint64_t direct_draws = direct.stats.draws;
+        uint64_t cached_draws = cached.stats.draws;
+        null_draw_indexed(&direct, 6, 0, 0);
+        state_cache_draw_indexed(&cache, 6, 0, 0);
+        if (same_device_state(&direct, &cached) == false || direct.stats.draws - direct_draws != cached.stats.draws - cached_draws)
+            mismatches++;
+
+        // now and then the context gets touched behind the cache's back
+        if (draw % 97 == 96)
+        {
+            null_ia_set_input_layout(&cached, 0);
+            state_cache_invalidate(&cache);
+        }
+    }
+
+    state_cache_stats stats = cache.stats;
+    printf("random stream: %d draws, %llu sets, %llu issued, %llu elided, %llu merged, %llu rebinds, %d mismatches\n", draws,
+        (unsigned long long)stats.set_calls, (unsigned long long)stats.issued_calls, (unsigned long long)stats.elided_calls,
+        (unsigned long long)stats.merged_calls, (unsigned long long)stats.rebinds, mismatches);
+
+    bool ok = mismatches == 0 && stats.set_calls == stats.issued_calls + stats.elided_calls + stats.merged_calls;
+    null_device_shutdown(&direct);
+    null_device_shutdown(&cached);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    int frames = 100;
+    int draws = 10000;
+    double call_ns = 100.0;
+    uint64_t seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-d") == 0)
+            draws = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            call_ns = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            seed = (uint64_t)atoll(argv[i + 1]);
+    }
+
+    printf("%d frames, %d draws per frame, counts per frame, estimate at %.0f ns per device call\n", frames, draws, call_ns);
+    printf("%-26s %9s %8s %9s %9s %9s %9s %7s %12s\n", "", "ms/frame", "ns/draw", "sets", "issued", "elided", "merged", "errors",
+        "estimate ms");
+
+    bool ok = true;
+    ok = run_mode("frame state, direct", frames, draws, false, false, call_ns) && ok;
+    ok = run_mode("frame state, cached", frames, draws, false, true, call_ns) && ok;
+    ok = run_mode("per draw state, direct", frames, draws, true, false, call_ns) && ok;
+    ok = run_mode("per draw state, cached", frames, draws, true, true, call_ns) && ok;
+    ok = check_random_stream(seed, 100000) && ok;
+
+    printf("state checks: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
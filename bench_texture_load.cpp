@@ -0,0 +1,258 @@
+// compares the two ways example_texture gets its texture ready for CreateTexture2D: decoding
+// the source image, building the mip chain and compressing it to BC7 at startup, against
+// mapping the cooked file. both end with a copy of every level into a staging buffer, which
+// stands in for the driver reading pSysMem.
+// usage: bench_texture_load [-i image] [-c cooked.tex] [-n iterations] [-t threads]
+// cook the file first with cook_texture, the image is optional when stb is not available
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "bc_encode.h"
+#include "image_io.h"
+#include "mip_gen.h"
+#include "texture_file.h"
+
+#if defined(_WIN32)
+    #include <psapi.h>
+    #pragma comment(lib, "psapi.lib")
+#endif
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// resident is everything in the working set, private leaves out pages backed by a file,
+// which the os can drop and read back at any time
+struct memory_usage
+{
+    double resident_mb;
+    double private_mb;
+};
+
+static memory_usage
+memory_now()
+{
+    memory_usage usage = {};
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS_EX counters = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS *)&counters, sizeof(counters)))
+    {
+        usage.resident_mb = (double)counters.WorkingSetSize / (1024.0 * 1024.0);
+        usage.private_mb = (double)counters.PrivateUsage / (1024.0 * 1024.0);
+    }
+#else
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file)
+    {
+        unsigned long size = 0, resident = 0, shared = 0;
+        if (fscanf(file, "%lu %lu %lu", &size, &resident, &shared) == 3)
+        {
+            double page_mb = (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+            usage.resident_mb = (double)resident * page_mb;
+            usage.private_mb = (double)(resident - shared) * page_mb;
+        }
+        fclose(file);
+    }
+#endif
+    return usage;
+}
+
+struct load_result
+{
+    double ms;
+    memory_usage before;
+    memory_usage loaded;
+    uint64_t bytes;
+    int width;
+    int height;
+    int level_count;
+};
+
+static bool
+load_cooked(const char *path, load_result *result)
+{
+    result->before = memory_now();
+    double start = now_seconds();
+
+    texture_file file;
+    if (texture_file_open(&file, path) == false)
+        return false;
+
+    uint32_t count = file.header->mip_count * file.header->array_size;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        total += file.subresources[i].size;
+    uint8_t *staging = (uint8_t *)malloc((size_t)total);
+    if (staging == nullptr)
+    {
+        texture_file_close(&file);
+        return false;
+    }
+
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        size_t size = (size_t)file.subresources[i].size;
+        memcpy(staging + offset, texture_file_subresource_data(&file, i), size);
+        offset += size;
+    }
+
+    result->ms = (now_seconds() - start) * 1000.0;
+    result->loaded = memory_now();
+    result->bytes = offset;
+    result->width = (int)file.header->width;
+    result->height = (int)file.header->height;
+    result->level_count = (int)file.header->mip_count;
+    free(staging);
+    texture_file_close(&file);
+    return true;
+}
+
+// what example_texture does without the cooked file
+static bool
+load_source(const char *path, thread_pool *pool, load_result *result)
+{
+    result->before = memory_now();
+    double start = now_seconds();
+
+    int width, height;
+    uint8_t *pixels = image_load(path, &width, &height);
+    if (pixels == nullptr)
+        return false;
+
+    mip_chain mips = {};
+    if (mip_chain_build(&mips, pixels, width, height, MIP_FILTER_KAISER, true, pool) == false)
+    {
+        image_free(pixels);
+        return false;
+    }
+
+    bool compress = width % 4 == 0 && height % 4 == 0;
+    size_t total = 0;
+    for (int level = 0; level < mips.level_count; ++level)
+    {
+        const mip_level *mip = &mips.levels[level];
+        total += compress ? bc_level_size(BC_FORMAT_BC7, mip->width, mip->height) : (size_t)mip->width * mip->height * 4;
+    }
+    uint8_t *staging = (uint8_t *)malloc(total);
+    if (staging == nullptr)
+    {
+        mip_chain_free(&mips);
+        image_free(pixels);
+        return false;
+    }
+
+    std::vector<uint8_t> blocks;
+    uint64_t offset = 0;
+    for (int level = 0; level < mips.level_count; ++level)
+    {
+        const mip_level *mip = &mips.levels[level];
+        if (compress)
+        {
+            size_t size = bc_level_size(BC_FORMAT_BC7, mip->width, mip->height);
+            blocks.resize(size);
+            bc_encode_image(BC_FORMAT_BC7, BC_QUALITY_NORMAL, mip->data, mip->width, mip->height, mip->pitch, blocks.data(), pool);
+            memcpy(staging + offset, blocks.data(), size);
+            offset += size;
+        }
+        else
+        {
+            size_t size = (size_t)mip->width * 4;
+            for (int y = 0; y < mip->height; ++y)
+                memcpy(staging + offset + y * size, mip->data + (size_t)y * mip->pitch, size);
+            offset += size * mip->height;
+        }
+    }
+
+    result->ms = (now_seconds() - start) * 1000.0;
+    result->loaded = memory_now();
+    result->bytes = offset;
+    result->width = width;
+    result->height = height;
+    result->level_count = mips.level_count;
+    free(staging);
+    mip_chain_free(&mips);
+    image_free(pixels);
+    return true;
+}
+
+static void
+print_result(const char *name, const load_result *first, double average_ms)
+{
+    printf("%-8s %4dx%-5d %6d %10.2f %10.2f %12.1f %12.1f %10.2f\n", name, first->width, first->height, first->level_count,
+        first->ms, average_ms, first->loaded.resident_mb - first->before.resident_mb,
+        first->loaded.private_mb - first->before.private_mb, (double)first->bytes / (1024.0 * 1024.0));
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *image_path = "data/uv_grid.jpg";
+    const char *cooked_path = "data/uv_grid.tex";
+    int iterations = 5;
+    int threads = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-i") == 0)
+            image_path = argv[i + 1];
+        else if (strcmp(argv[i], "-c") == 0)
+            cooked_path = argv[i + 1];
+        else if (strcmp(argv[i], "-n") == 0)
+            iterations = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+    }
+    if (iterations < 1)
+        iterations = 1;
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    printf("simd path: %s, %d threads, %d iterations\n", SIMD_MATH_NAME, thread_pool_size(&pool), iterations);
+    printf("%-8s %10s %6s %10s %10s %12s %12s %10s\n", "path", "size", "levels", "first ms", "avg ms", "resident MB", "private MB", "upload MB");
+
+    // the cooked path runs first so it doesn't inherit the heap the source path grew, the
+    // first iteration is the one with a cold mapping and its memory deltas are the ones shown
+    load_result first = {};
+    if (load_cooked(cooked_path, &first) == false)
+    {
+        fprintf(stderr, "Failed to open %s, cook it with cook_texture\n", cooked_path);
+        thread_pool_shutdown(&pool);
+        return 1;
+    }
+    double total_ms = first.ms;
+    for (int i = 1; i < iterations; ++i)
+    {
+        load_result result;
+        load_cooked(cooked_path, &result);
+        total_ms += result.ms;
+    }
+    print_result("cooked", &first, total_ms / iterations);
+
+    first = {};
+    if (load_source(image_path, &pool, &first))
+    {
+        total_ms = first.ms;
+        for (int i = 1; i < iterations; ++i)
+        {
+            load_result result;
+            load_source(image_path, &pool, &result);
+            total_ms += result.ms;
+        }
+        print_result("source", &first, total_ms / iterations);
+    }
+    else
+    {
+        printf("%-8s could not load %s\n", "source", image_path);
+    }
+
+    thread_pool_shutdown(&pool);
+    return 0;
+}
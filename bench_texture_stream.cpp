@@ -0,0 +1,259 @@
+// stress test for texture_stream.h. requests every image in a directory at once and runs a
+// simulated render loop that polls the stream each frame under an upload byte budget, the
+// upload is a copy of every level into a staging buffer. reports request to ready and request
+// to upload latency percentiles and the time each poll took out of its frame.
+// usage: bench_texture_stream -d dir [-g count] [-s size] [-w workers] [-b budget_mb]
+//        [-f frame_ms] [-c 0|1] [-r repeat]
+// -g writes count synthetic size x size ppm images into dir first
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "texture_stream.h"
+
+#if defined(_WIN32)
+    #include <direct.h>
+#else
+    #include <dirent.h>
+    #include <sys/stat.h>
+#endif
+
+static double
+now_seconds()
+{
+    return texture_stream_now();
+}
+
+static bool
+has_image_extension(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    if (dot == nullptr)
+        return false;
+    const char *extensions[] = {".tex", ".ppm", ".jpg", ".jpeg", ".png", ".tga", ".bmp"};
+    for (const char *extension : extensions)
+    {
+        if (strcmp(dot, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void
+list_images(const char *dir, std::vector<std::string> *paths)
+{
+#if defined(_WIN32)
+    std::string pattern = std::string(dir) + "\\*";
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA(pattern.c_str(), &find_data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && has_image_extension(find_data.cFileName))
+            paths->push_back(std::string(dir) + "\\" + find_data.cFileName);
+    } while (FindNextFileA(find, &find_data));
+    FindClose(find);
+#else
+    DIR *directory = opendir(dir);
+    if (directory == nullptr)
+        return;
+    while (dirent *entry = readdir(directory))
+    {
+        if (entry->d_name[0] != '.' && has_image_extension(entry->d_name))
+            paths->push_back(std::string(dir) + "/" + entry->d_name);
+    }
+    closedir(directory);
+#endif
+    std::sort(paths->begin(), paths->end());
+}
+
+// each image gets its own hue so a broken upload order would show in a viewer
+static bool
+generate_images(const char *dir, int count, int size)
+{
+#if defined(_WIN32)
+    _mkdir(dir);
+#else
+    mkdir(dir, 0755);
+#endif
+
+    std::vector<uint8_t> rgb((size_t)size * size * 3);
+    for (int i = 0; i < count; ++i)
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                uint8_t *p = &rgb[((size_t)y * size + x) * 3];
+                bool checker = ((x / 32) + (y / 32)) & 1;
+                p[0] = (uint8_t)(checker ? i * 37 : x * 255 / size);
+                p[1] = (uint8_t)(checker ? i * 91 : y * 255 / size);
+                p[2] = (uint8_t)(checker ? i * 53 : 128);
+            }
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/stream_%04d.ppm", dir, i);
+        FILE *file = fopen(path, "wb");
+        if (file == nullptr)
+            return false;
+        fprintf(file, "P6 %d %d 255\n", size, size);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        if (fclose(file) != 0 || ok == false)
+            return false;
+    }
+    return true;
+}
+
+static double
+percentile(std::vector<double> *values, double p)
+{
+    if (values->empty())
+        return 0.0;
+    std::sort(values->begin(), values->end());
+    size_t index = (size_t)(p * (double)(values->size() - 1) + 0.5);
+    return (*values)[index];
+}
+
+struct upload_context
+{
+    std::vector<uint8_t> staging;
+    std::vector<double> ready_ms;
+    std::vector<double> upload_ms;
+};
+
+static bool
+upload_image(void *user, const texture_stream_image *image)
+{
+    upload_context *context = (upload_context *)user;
+    if (context->staging.size() < image->bytes)
+        context->staging.resize((size_t)image->bytes);
+
+    uint8_t *out = context->staging.data();
+    for (int level = 0; level < image->level_count; ++level)
+    {
+        memcpy(out, image->levels[level].data, (size_t)image->levels[level].size);
+        out += image->levels[level].size;
+    }
+
+    double now = now_seconds();
+    context->ready_ms.push_back((image->ready_time - image->request_time) * 1000.0);
+    context->upload_ms.push_back((now - image->request_time) * 1000.0);
+    return true;
+}
+
+static void
+print_percentiles(const char *name, std::vector<double> *values)
+{
+    printf("%-22s %10.2f %10.2f %10.2f %10.2f\n", name, percentile(values, 0.5), percentile(values, 0.95),
+        percentile(values, 0.99), percentile(values, 1.0));
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *dir = nullptr;
+    int generate = 0;
+    int size = 512;
+    int workers = 0;
+    double budget_mb = 8.0;
+    double frame_ms = 16.0;
+    bool compress = false;
+    int repeat = 1;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-d") == 0)
+            dir = argv[i + 1];
+        else if (strcmp(argv[i], "-g") == 0)
+            generate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            size = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-w") == 0)
+            workers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-b") == 0)
+            budget_mb = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frame_ms = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            compress = atoi(argv[i + 1]) != 0;
+        else if (strcmp(argv[i], "-r") == 0)
+            repeat = atoi(argv[i + 1]);
+    }
+    if (dir == nullptr)
+    {
+        fprintf(stderr, "usage: bench_texture_stream -d dir [-g count] [-s size] [-w workers] [-b budget_mb] [-f frame_ms] [-c 0|1] [-r repeat]\n");
+        return 1;
+    }
+
+    if (generate > 0 && generate_images(dir, generate, size) == false)
+    {
+        fprintf(stderr, "Failed to write images to %s\n", dir);
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    list_images(dir, &paths);
+    if (paths.empty())
+    {
+        fprintf(stderr, "No images in %s\n", dir);
+        return 1;
+    }
+
+    texture_stream stream;
+    texture_stream_init(&stream, workers, compress);
+    uint64_t budget = (uint64_t)(budget_mb * 1024.0 * 1024.0);
+
+    printf("%d images x %d, %d workers, %s, budget %.1f MB/frame, frame %.1f ms\n", (int)paths.size(), repeat,
+        (int)stream.workers.size(), compress ? "bc7" : "rgba8", budget_mb, frame_ms);
+
+    upload_context context;
+    std::vector<double> poll_ms;
+    int frame_count = 0;
+    int over_frame_count = 0;
+    double start = now_seconds();
+    for (int r = 0; r < repeat; ++r)
+    {
+        for (const std::string &path : paths)
+            texture_stream_request(&stream, path.c_str());
+    }
+
+    while (texture_stream_idle(&stream) == false)
+    {
+        double frame_start = now_seconds();
+        texture_stream_poll(&stream, budget, upload_image, &context);
+        double poll = (now_seconds() - frame_start) * 1000.0;
+        poll_ms.push_back(poll);
+        frame_count++;
+        if (poll > frame_ms)
+            over_frame_count++;
+
+        // the rest of the frame, sleep stands in for rendering
+        double remaining = frame_ms - (now_seconds() - frame_start) * 1000.0;
+        if (remaining > 0.0)
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining));
+    }
+    double seconds = now_seconds() - start;
+
+    texture_stream_stats stats = texture_stream_get_stats(&stream);
+    texture_stream_shutdown(&stream);
+
+    double uploaded_mb = (double)stats.uploaded_bytes / (1024.0 * 1024.0);
+    printf("uploaded %llu, failed %llu in %.2f s over %d frames, %.1f textures/s, %.1f MB/s\n",
+        (unsigned long long)stats.uploaded, (unsigned long long)stats.failed, seconds, frame_count,
+        (double)stats.uploaded / seconds, uploaded_mb / seconds);
+    printf("budget limited frames %llu, peak ready %.1f MB, polls over a frame %d\n",
+        (unsigned long long)stats.budget_limited_polls, (double)stats.peak_ready_bytes / (1024.0 * 1024.0), over_frame_count);
+    printf("%-22s %10s %10s %10s %10s\n", "ms", "p50", "p95", "p99", "max");
+    print_percentiles("request to ready", &context.ready_ms);
+    print_percentiles("request to upload", &context.upload_ms);
+    print_percentiles("poll per frame", &poll_ms);
+    return stats.failed ? 1 : 0;
+}
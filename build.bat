@@ -1,9 +1,10 @@
 @echo off
 
-if "%~1"=="/d" (
-    set DEBUG=true
-) else (
-    set DEBUG=false
+set DEBUG=false
+set PROFILE=false
+for %%a in (%*) do (
+    if "%%~a"=="/d" set DEBUG=true
+    if "%%~a"=="/p" set PROFILE=true
 )
 
 call "%ProgramFiles(x86)%\Microsoft Visual Studio\2019\Community\Common7\Tools\VsDevCmd" -arch=amd64
@@ -17,20 +18,32 @@ if not exist %BUILD_DIR% mkdir %BUILD_DIR%
 pushd %BUILD_DIR%
 
 if %DEBUG%==true (
-    SET COMPILER_FLAGS=/MTd /nologo /GR- /EHa /Od /Oi /WX /W4 /wd4201 /wd4100 /wd4109 /FC /Z7
+    SET COMPILER_FLAGS=/MTd /nologo /std:c++20 /GR- /EHa /Od /Oi /WX /W4 /wd4201 /wd4100 /wd4109 /FC /Z7
     SET LINKER_FLAGS=/incremental:no /opt:ref
 ) else (
-    SET COMPILER_FLAGS=/MTd /nologo /GR- /EHa /Od /Oi /WX /W4 /wd4201 /wd4100 /wd4109 /FC /Z7
+    SET COMPILER_FLAGS=/MTd /nologo /std:c++20 /GR- /EHa /Od /Oi /WX /W4 /wd4201 /wd4100 /wd4109 /FC /Z7
     SET LINKER_FLAGS=/incremental:no /opt:ref
 )
 
+REM /p compiles in the PROFILE_ZONE zones
+if %PROFILE%==true (
+    SET COMPILER_FLAGS=%COMPILER_FLAGS% /DPROFILE_ENABLED
+)
+
 for /r %%i in (..\*.cpp) do (
     cl %COMPILER_FLAGS% "%%i" /link %LINKER_FLAGS%
 )
 
 XCOPY /I/Y %ROOT_DIR%data %BUILD_DIR%data
 
+REM cook the example texture so example_texture can map it instead of decoding the jpg
+%BUILD_DIR%cook_texture.exe %ROOT_DIR%data\uv_grid.jpg %BUILD_DIR%data\uv_grid.tex
 SET ERR=%errorlevel%
+
+REM cook the example mesh, in source order because example_cubes colors faces by primitive id
+%BUILD_DIR%cook_mesh.exe %ROOT_DIR%data\cube.obj %BUILD_DIR%data\cube.mesh -keep-order
+if %ERR%==0 SET ERR=%errorlevel%
+
 if %ERR%==0 (
     echo success!
 )
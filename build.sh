@@ -0,0 +1,53 @@
+#!/bin/sh
+# builds the programs that don't need d3d11 (everything except example_*.cpp),
+# pass -d for an unoptimized debug build and -p to compile in the PROFILE_ZONE zones
+
+DEBUG=false
+PROFILE=false
+for ARG in "$@"; do
+    case $ARG in
+        -d) DEBUG=true ;;
+        -p) PROFILE=true ;;
+    esac
+done
+
+ROOT_DIR=$(cd "$(dirname "$0")" && pwd)
+BUILD_DIR=$ROOT_DIR/build
+
+mkdir -p "$BUILD_DIR"
+
+if [ $DEBUG = true ]; then
+    COMPILER_FLAGS="-std=c++20 -O0 -g -Wall -Wextra -Werror -Wno-unused-parameter -pthread"
+else
+    COMPILER_FLAGS="-std=c++20 -O2 -g -march=native -Wall -Wextra -Werror -Wno-unused-parameter -pthread"
+fi
+
+if [ $PROFILE = true ]; then
+    COMPILER_FLAGS="$COMPILER_FLAGS -DPROFILE_ENABLED"
+fi
+
+ERR=0
+for SRC in "$ROOT_DIR"/*.cpp; do
+    NAME=$(basename "$SRC" .cpp)
+    case $NAME in
+        example_*) continue ;;
+    esac
+    ${CXX:-c++} $COMPILER_FLAGS "$SRC" -o "$BUILD_DIR/$NAME" || ERR=1
+done
+
+cp -r "$ROOT_DIR/data" "$BUILD_DIR/"
+
+# cook the example texture, cook_texture only reads jpg when the stb submodule is checked out
+if [ $ERR = 0 ] && [ -f "$ROOT_DIR/stb/stb_image.h" ]; then
+    "$BUILD_DIR/cook_texture" "$ROOT_DIR/data/uv_grid.jpg" "$BUILD_DIR/data/uv_grid.tex" || ERR=1
+fi
+
+# cook the example mesh, in source order because example_cubes colors faces by primitive id
+if [ $ERR = 0 ]; then
+    "$BUILD_DIR/cook_mesh" "$ROOT_DIR/data/cube.obj" "$BUILD_DIR/data/cube.mesh" -keep-order > /dev/null || ERR=1
+fi
+
+if [ $ERR = 0 ]; then
+    echo success!
+fi
+exit $ERR
@@ -0,0 +1,640 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "frustum_cull.h"
+#include "simd_math.h"
+#include "thread_pool.h"
+
+// bounding volume hierarchy over object aabbs for hierarchical frustum culling and ray
+// picking. the objects come in as the center / half extent streams of a frustum_bounds with
+// FRUSTUM_AABB_STREAMS, the same layout frustum_cull_aabbs takes.
+//
+// bvh_build splits top down with a binned surface area heuristic until at most BVH_LEAF_SIZE
+// objects are left. nodes are stored depth first, an interior node's left child directly
+// follows it, so every subtree is a contiguous range of nodes. a leaf keeps copies of its
+// objects' bounds as SoA streams of BVH_LEAF_SIZE floats, which the culling and ray tests
+// read SIMD_MATH_WIDTH lanes at a time.
+//
+// when objects move without changing much relative to each other (the spinning cubes)
+// bvh_refit rewrites the leaf copies and the node bounds in place, the subtrees below
+// BVH_REFIT_DEPTH in parallel on the pool and the nodes above them afterwards. a refit tree
+// stays correct but slowly gets worse to traverse, rebuild it once objects have moved far.
+
+#define BVH_LEAF_SIZE 8
+#define BVH_SAH_BINS 12
+#define BVH_REFIT_DEPTH 6 // up to 64 subtrees refit in parallel
+#define BVH_SAH_MAX_DEPTH 32 // deeper nodes split at the median, which bounds the depth
+#define BVH_MAX_DEPTH 64
+#define BVH_NONE 0xffffffffu
+
+struct bvh_node
+{
+    float min[3];
+    uint32_t right; // interior: index of the right child, the left one is this index + 1
+    float max[3];
+    uint32_t count; // leaf: number of objects, leaf_index is valid. interior: 0
+    uint32_t leaf_index;
+    uint32_t subtree_end; // one past the last node of this subtree
+};
+
+// SoA copies of the bounds of up to BVH_LEAF_SIZE objects. unused lanes have a negative
+// extent so no test can pass them
+struct bvh_leaf
+{
+    float center_x[BVH_LEAF_SIZE];
+    float center_y[BVH_LEAF_SIZE];
+    float center_z[BVH_LEAF_SIZE];
+    float extent_x[BVH_LEAF_SIZE];
+    float extent_y[BVH_LEAF_SIZE];
+    float extent_z[BVH_LEAF_SIZE];
+    uint32_t objects[BVH_LEAF_SIZE];
+};
+
+struct bvh_refit_task
+{
+    uint32_t first;
+    uint32_t end;
+};
+
+struct bvh
+{
+    std::vector<bvh_node> nodes;
+    bvh_leaf *leaves;
+    uint32_t leaf_count;
+    uint32_t object_count;
+
+    // subtrees rooted at BVH_REFIT_DEPTH (or shallower leaves) and the interior nodes above
+    // them in depth first order
+    std::vector<bvh_refit_task> refit_tasks;
+    std::vector<uint32_t> top_nodes;
+};
+
+struct bvh_ray_hit
+{
+    uint32_t object; // BVH_NONE when nothing was hit
+    float t;
+};
+
+inline void
+bvh_free(bvh *tree)
+{
+    simd_aligned_free(tree->leaves);
+    tree->leaves = nullptr;
+    tree->leaf_count = 0;
+    tree->object_count = 0;
+    tree->nodes.clear();
+    tree->refit_tasks.clear();
+    tree->top_nodes.clear();
+}
+
+inline float
+bvh_half_area(const float min[3], const float max[3])
+{
+    float dx = max[0] - min[0];
+    float dy = max[1] - min[1];
+    float dz = max[2] - min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+inline void
+bvh_grow(float min[3], float max[3], const float box_min[3], const float box_max[3])
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        min[axis] = box_min[axis] < min[axis] ? box_min[axis] : min[axis];
+        max[axis] = box_max[axis] > max[axis] ? box_max[axis] : max[axis];
+    }
+}
+
+// builder state, object bounds as min / max and centroids unpacked from the streams
+struct bvh_builder
+{
+    bvh *tree;
+    const frustum_bounds *boxes;
+    std::vector<uint32_t> objects;
+    std::vector<float> min;      // 3 per object
+    std::vector<float> max;      // 3 per object
+    std::vector<float> centroid; // 3 per object
+};
+
+inline void
+bvh_write_leaf(bvh_leaf *leaf, const frustum_bounds *boxes, const uint32_t *objects, uint32_t count, float min[3], float max[3])
+{
+    const float *cx = frustum_bounds_stream(boxes, 0);
+    const float *cy = frustum_bounds_stream(boxes, 1);
+    const float *cz = frustum_bounds_stream(boxes, 2);
+    const float *ex = frustum_bounds_stream(boxes, 3);
+    const float *ey = frustum_bounds_stream(boxes, 4);
+    const float *ez = frustum_bounds_stream(boxes, 5);
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        min[axis] = FLT_MAX;
+        max[axis] = -FLT_MAX;
+    }
+    for (uint32_t lane = 0; lane < BVH_LEAF_SIZE; ++lane)
+    {
+        if (lane >= count)
+        {
+            leaf->center_x[lane] = leaf->center_y[lane] = leaf->center_z[lane] = 0.0f;
+            leaf->extent_x[lane] = leaf->extent_y[lane] = leaf->extent_z[lane] = -1.0f;
+            leaf->objects[lane] = BVH_NONE;
+            continue;
+        }
+
+        uint32_t object = objects[lane];
+        leaf->center_x[lane] = cx[object];
+        leaf->center_y[lane] = cy[object];
+        leaf->center_z[lane] = cz[object];
+        leaf->extent_x[lane] = ex[object];
+        leaf->extent_y[lane] = ey[object];
+        leaf->extent_z[lane] = ez[object];
+        leaf->objects[lane] = object;
+
+        float box_min[3] = {cx[object] - ex[object], cy[object] - ey[object], cz[object] - ez[object]};
+        float box_max[3] = {cx[object] + ex[object], cy[object] + ey[object], cz[object] + ez[object]};
+        bvh_grow(min, max, box_min, box_max);
+    }
+}
+
+inline void
+bvh_build_node(bvh_builder *builder, uint32_t begin, uint32_t end, int depth)
+{
+    bvh *tree = builder->tree;
+    uint32_t node_index = (uint32_t)tree->nodes.size();
+    tree->nodes.push_back(bvh_node());
+
+    uint32_t count = end - begin;
+    uint32_t *objects = builder->objects.data();
+
+    // bounds of the centroids pick the bins, the split has to separate centroids
+    float centroid_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float centroid_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const float *c = &builder->centroid[(size_t)objects[i] * 3];
+        bvh_grow(centroid_min, centroid_max, c, c);
+    }
+
+    int split_axis = -1;
+    int split_bin = 0;
+    float split_scale = 0.0f;
+    if (count > BVH_LEAF_SIZE && depth < BVH_SAH_MAX_DEPTH)
+    {
+        // best split over the bin boundaries of all three axes. cost is area * count of both
+        // sides, a leaf isn't an option above BVH_LEAF_SIZE objects
+        float best_cost = FLT_MAX;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = centroid_max[axis] - centroid_min[axis];
+            if (extent <= 0.0f)
+                continue;
+            float scale = (float)BVH_SAH_BINS / extent;
+
+            uint32_t bin_count[BVH_SAH_BINS] = {};
+            float bin_min[BVH_SAH_BINS][3], bin_max[BVH_SAH_BINS][3];
+            for (int b = 0; b < BVH_SAH_BINS; ++b)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    bin_min[b][k] = FLT_MAX;
+                    bin_max[b][k] = -FLT_MAX;
+                }
+            }
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                uint32_t object = objects[i];
+                int b = (int)((builder->centroid[(size_t)object * 3 + axis] - centroid_min[axis]) * scale);
+                b = b < BVH_SAH_BINS ? b : BVH_SAH_BINS - 1;
+                bin_count[b]++;
+                bvh_grow(bin_min[b], bin_max[b], &builder->min[(size_t)object * 3], &builder->max[(size_t)object * 3]);
+            }
+
+            // sweep from the right to get the cost of every right side, then from the left
+            float right_area[BVH_SAH_BINS];
+            uint32_t right_count[BVH_SAH_BINS];
+            float grow_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+            float grow_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+            uint32_t sum = 0;
+            for (int b = BVH_SAH_BINS - 1; b > 0; --b)
+            {
+                sum += bin_count[b];
+                if (bin_count[b])
+                    bvh_grow(grow_min, grow_max, bin_min[b], bin_max[b]);
+                right_count[b] = sum;
+                right_area[b] = sum ? bvh_half_area(grow_min, grow_max) : 0.0f;
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                grow_min[k] = FLT_MAX;
+                grow_max[k] = -FLT_MAX;
+            }
+            sum = 0;
+            for (int b = 0; b < BVH_SAH_BINS - 1; ++b)
+            {
+                sum += bin_count[b];
+                if (bin_count[b])
+                    bvh_grow(grow_min, grow_max, bin_min[b], bin_max[b]);
+                if (sum == 0 || right_count[b + 1] == 0)
+                    continue;
+                float cost = bvh_half_area(grow_min, grow_max) * (float)sum + right_area[b + 1] * (float)right_count[b + 1];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    split_axis = axis;
+                    split_bin = b;
+                    split_scale = scale;
+                }
+            }
+        }
+    }
+
+    // the left side gets the bins up to split_bin, binned exactly like above
+    uint32_t middle = begin;
+    if (split_axis >= 0)
+    {
+        const float *centroid = builder->centroid.data();
+        float axis_min = centroid_min[split_axis];
+        uint32_t *split = std::partition(objects + begin, objects + end, [=](uint32_t object) {
+            int b = (int)((centroid[(size_t)object * 3 + split_axis] - axis_min) * split_scale);
+            return b <= split_bin;
+        });
+        middle = (uint32_t)(split - objects);
+    }
+    if (count > BVH_LEAF_SIZE && (middle == begin || middle == end))
+    {
+        // too deep or every centroid in the same spot, halve at the median of the longest axis
+        int axis = 0;
+        for (int k = 1; k < 3; ++k)
+            if (centroid_max[k] - centroid_min[k] > centroid_max[axis] - centroid_min[axis])
+                axis = k;
+        const float *centroid = builder->centroid.data();
+        middle = begin + count / 2;
+        std::nth_element(objects + begin, objects + middle, objects + end, [=](uint32_t a, uint32_t b) {
+            return centroid[(size_t)a * 3 + axis] < centroid[(size_t)b * 3 + axis];
+        });
+    }
+
+    if (middle == begin || middle == end)
+    {
+        uint32_t leaf_index = tree->leaf_count++;
+        bvh_node *node = &tree->nodes[node_index];
+        bvh_write_leaf(&tree->leaves[leaf_index], builder->boxes, objects + begin, count, node->min, node->max);
+        node->count = count;
+        node->leaf_index = leaf_index;
+        node->right = BVH_NONE;
+        node->subtree_end = node_index + 1;
+        if (depth <= BVH_REFIT_DEPTH)
+            tree->refit_tasks.push_back({node_index, node_index + 1});
+        return;
+    }
+
+    if (depth < BVH_REFIT_DEPTH)
+        tree->top_nodes.push_back(node_index);
+
+    bvh_build_node(builder, begin, middle, depth + 1);
+    uint32_t right = (uint32_t)tree->nodes.size();
+    bvh_build_node(builder, middle, end, depth + 1);
+
+    bvh_node *node = &tree->nodes[node_index];
+    const bvh_node *left_child = &tree->nodes[node_index + 1];
+    const bvh_node *right_child = &tree->nodes[right];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        node->min[axis] = left_child->min[axis] < right_child->min[axis] ? left_child->min[axis] : right_child->min[axis];
+        node->max[axis] = left_child->max[axis] > right_child->max[axis] ? left_child->max[axis] : right_child->max[axis];
+    }
+    node->right = right;
+    node->count = 0;
+    node->leaf_index = BVH_NONE;
+    node->subtree_end = (uint32_t)tree->nodes.size();
+    if (depth == BVH_REFIT_DEPTH)
+        tree->refit_tasks.push_back({node_index, node->subtree_end});
+}
+
+// boxes holds FRUSTUM_AABB_STREAMS streams, returns false when out of memory
+inline bool
+bvh_build(bvh *tree, const frustum_bounds *boxes)
+{
+    uint32_t count = (uint32_t)boxes->count;
+    tree->nodes.clear();
+    tree->refit_tasks.clear();
+    tree->top_nodes.clear();
+    tree->object_count = count;
+    tree->leaf_count = 0;
+
+    // at most one leaf per object, and a full binary tree over them
+    uint32_t max_leaves = count > 0 ? count : 1;
+    tree->leaves = (bvh_leaf *)simd_aligned_alloc(max_leaves * sizeof(bvh_leaf));
+    if (tree->leaves == nullptr)
+        return false;
+    tree->nodes.reserve(2 * (size_t)max_leaves);
+
+    bvh_builder builder;
+    builder.tree = tree;
+    builder.boxes = boxes;
+    builder.objects.resize(count);
+    builder.min.resize((size_t)count * 3);
+    builder.max.resize((size_t)count * 3);
+    builder.centroid.resize((size_t)count * 3);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        builder.objects[i] = i;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float c = frustum_bounds_stream(boxes, axis)[i];
+            float e = frustum_bounds_stream(boxes, axis + 3)[i];
+            builder.min[(size_t)i * 3 + axis] = c - e;
+            builder.max[(size_t)i * 3 + axis] = c + e;
+            builder.centroid[(size_t)i * 3 + axis] = c;
+        }
+    }
+
+    bvh_build_node(&builder, 0, count, 0);
+    return true;
+}
+
+inline void
+bvh_refit_node(bvh *tree, const frustum_bounds *boxes, uint32_t node_index)
+{
+    bvh_node *node = &tree->nodes[node_index];
+    if (node->count)
+    {
+        bvh_leaf *leaf = &tree->leaves[node->leaf_index];
+        bvh_write_leaf(leaf, boxes, leaf->objects, node->count, node->min, node->max);
+        return;
+    }
+
+    const bvh_node *left = &tree->nodes[node_index + 1];
+    const bvh_node *right = &tree->nodes[node->right];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        node->min[axis] = left->min[axis] < right->min[axis] ? left->min[axis] : right->min[axis];
+        node->max[axis] = left->max[axis] > right->max[axis] ? left->max[axis] : right->max[axis];
+    }
+}
+
+// updates every bound from the objects' current boxes, same objects as the build. children
+// come after their parent, so walking a subtree's range backwards refits bottom up. pool may
+// be null to refit on the calling thread
+inline void
+bvh_refit(bvh *tree, const frustum_bounds *boxes, thread_pool *pool)
+{
+    auto refit_task = [tree, boxes](int task_index) {
+        const bvh_refit_task *task = &tree->refit_tasks[task_index];
+        for (uint32_t node = task->end; node-- > task->first;)
+            bvh_refit_node(tree, boxes, node);
+    };
+    int task_count = (int)tree->refit_tasks.size();
+    if (pool)
+        thread_pool_parallel_for(pool, task_count, refit_task);
+    else
+        for (int task = 0; task < task_count; ++task)
+            refit_task(task);
+
+    for (size_t i = tree->top_nodes.size(); i-- > 0;)
+        bvh_refit_node(tree, boxes, tree->top_nodes[i]);
+}
+
+// bit p of the result is set when the box isn't entirely inside plane p. returns BVH_NONE
+// when the box is outside one of the planes in mask
+inline uint32_t
+bvh_classify_node(const frustum *f, const bvh_node *node, uint32_t mask)
+{
+    float center[3], extent[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        center[axis] = (node->min[axis] + node->max[axis]) * 0.5f;
+        extent[axis] = (node->max[axis] - node->min[axis]) * 0.5f;
+    }
+
+    uint32_t straddling = 0;
+    for (int p = 0; p < 6; ++p)
+    {
+        if ((mask & (1u << p)) == 0)
+            continue;
+        const float *plane = f->planes[p];
+        float d = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+        float r = fabsf(plane[0]) * extent[0] + fabsf(plane[1]) * extent[1] + fabsf(plane[2]) * extent[2];
+        if (d + r < 0.0f)
+            return BVH_NONE;
+        if (d - r < 0.0f)
+            straddling |= 1u << p;
+    }
+    return straddling;
+}
+
+// tests the objects of a leaf against the planes in mask, appends the visible ones
+inline uint32_t
+bvh_cull_leaf(const frustum *f, const bvh_leaf *leaf, uint32_t count, uint32_t mask, uint32_t *visible, uint32_t n)
+{
+    vf zero = vf_splat(0.0f);
+    for (uint32_t lane = 0; lane < BVH_LEAF_SIZE; lane += SIMD_MATH_WIDTH)
+    {
+        if (lane >= count)
+            break;
+
+        vf x = vf_load(leaf->center_x + lane);
+        vf y = vf_load(leaf->center_y + lane);
+        vf z = vf_load(leaf->center_z + lane);
+        vf hx = vf_load(leaf->extent_x + lane);
+        vf hy = vf_load(leaf->extent_y + lane);
+        vf hz = vf_load(leaf->extent_z + lane);
+
+        // unused lanes have negative extents, keep them out when no plane is left to test
+        vf inside = vf_cmp_ge(hx, zero);
+        for (int p = 0; p < 6; ++p)
+        {
+            if ((mask & (1u << p)) == 0)
+                continue;
+            const float *plane = f->planes[p];
+            vf d = vf_madd(x, vf_splat(plane[0]), vf_madd(y, vf_splat(plane[1]), vf_madd(z, vf_splat(plane[2]), vf_splat(plane[3]))));
+            vf r = vf_madd(hx, vf_splat(fabsf(plane[0])), vf_madd(hy, vf_splat(fabsf(plane[1])), vf_mul(hz, vf_splat(fabsf(plane[2])))));
+            inside = vf_and(inside, vf_cmp_ge(vf_add(d, r), zero));
+        }
+
+        uint32_t bits = vf_mask_bits(inside);
+        while (bits)
+        {
+            visible[n++] = leaf->objects[lane + frustum_lowest_bit(bits)];
+            bits &= bits - 1;
+        }
+    }
+    return n;
+}
+
+// objects whose box intersects the frustum go to visible, which needs room for all of them.
+// same set as frustum_cull_aabbs over the boxes the tree was built or last refit with, in
+// tree order. subtrees entirely inside a plane stop testing it, subtrees inside all six
+// are emitted without any test
+inline uint32_t
+bvh_cull(const bvh *tree, const frustum *f, uint32_t *visible)
+{
+    if (tree->nodes.empty())
+        return 0;
+
+    struct entry
+    {
+        uint32_t node;
+        uint32_t mask;
+    };
+    entry stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = {0, 0x3f};
+
+    uint32_t n = 0;
+    while (top)
+    {
+        entry e = stack[--top];
+        const bvh_node *node = &tree->nodes[e.node];
+        uint32_t mask = bvh_classify_node(f, node, e.mask);
+        if (mask == BVH_NONE)
+            continue;
+
+        if (mask == 0)
+        {
+            // the whole subtree is inside, its leaves are in its node range
+            for (uint32_t i = e.node; i < node->subtree_end; ++i)
+            {
+                const bvh_node *inner = &tree->nodes[i];
+                if (inner->count == 0)
+                    continue;
+                const bvh_leaf *leaf = &tree->leaves[inner->leaf_index];
+                for (uint32_t lane = 0; lane < inner->count; ++lane)
+                    visible[n++] = leaf->objects[lane];
+            }
+            continue;
+        }
+
+        if (node->count)
+        {
+            n = bvh_cull_leaf(f, &tree->leaves[node->leaf_index], node->count, mask, visible, n);
+            continue;
+        }
+
+        stack[top++] = {node->right, mask};
+        stack[top++] = {e.node + 1, mask};
+    }
+    return n;
+}
+
+// entry and exit distance of a ray through a box, inv_dir is 1 / dir per axis
+inline bool
+bvh_ray_box(const float origin[3], const float inv_dir[3], const float min[3], const float max[3], float max_t, float *t_enter)
+{
+    float t0 = 0.0f;
+    float t1 = max_t;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float near_t = (min[axis] - origin[axis]) * inv_dir[axis];
+        float far_t = (max[axis] - origin[axis]) * inv_dir[axis];
+        if (near_t > far_t)
+        {
+            float swap = near_t;
+            near_t = far_t;
+            far_t = swap;
+        }
+        t0 = near_t > t0 ? near_t : t0;
+        t1 = far_t < t1 ? far_t : t1;
+    }
+    *t_enter = t0;
+    return t0 <= t1;
+}
+
+// nearest object box hit by origin + t * dir for t in [0, max_t]. this picks by box, callers
+// that need the exact shape test the hit object themselves. a ray starting inside a box hits
+// it at t = 0
+inline bvh_ray_hit
+bvh_raycast(const bvh *tree, const float origin[3], const float dir[3], float max_t)
+{
+    bvh_ray_hit hit = {BVH_NONE, max_t};
+    if (tree->nodes.empty())
+        return hit;
+
+    // a large finite reciprocal instead of inf keeps 0 * inf nans out of the slabs
+    float inv_dir[3];
+    for (int axis = 0; axis < 3; ++axis)
+        inv_dir[axis] = fabsf(dir[axis]) > 1e-20f ? 1.0f / dir[axis] : (dir[axis] < 0.0f ? -1e20f : 1e20f);
+
+    vf ox = vf_splat(origin[0]), oy = vf_splat(origin[1]), oz = vf_splat(origin[2]);
+    vf ix = vf_splat(inv_dir[0]), iy = vf_splat(inv_dir[1]), iz = vf_splat(inv_dir[2]);
+    vf zero = vf_splat(0.0f);
+
+    uint32_t stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top)
+    {
+        uint32_t node_index = stack[--top];
+        const bvh_node *node = &tree->nodes[node_index];
+        float t_enter;
+        if (bvh_ray_box(origin, inv_dir, node->min, node->max, hit.t, &t_enter) == false)
+            continue;
+
+        if (node->count == 0)
+        {
+            // visit the nearer child first, the farther one is often skipped once hit.t shrinks
+            uint32_t left_index = node_index + 1;
+            const bvh_node *left = &tree->nodes[left_index];
+            const bvh_node *right = &tree->nodes[node->right];
+            float t_left, t_right;
+            bool hit_left = bvh_ray_box(origin, inv_dir, left->min, left->max, hit.t, &t_left);
+            bool hit_right = bvh_ray_box(origin, inv_dir, right->min, right->max, hit.t, &t_right);
+            if (hit_left && hit_right)
+            {
+                stack[top++] = t_left < t_right ? node->right : left_index;
+                stack[top++] = t_left < t_right ? left_index : node->right;
+            }
+            else if (hit_left)
+            {
+                stack[top++] = left_index;
+            }
+            else if (hit_right)
+            {
+                stack[top++] = node->right;
+            }
+            continue;
+        }
+
+        const bvh_leaf *leaf = &tree->leaves[node->leaf_index];
+        for (uint32_t lane = 0; lane < node->count; lane += SIMD_MATH_WIDTH)
+        {
+            vf cx = vf_load(leaf->center_x + lane), cy = vf_load(leaf->center_y + lane), cz = vf_load(leaf->center_z + lane);
+            vf ex = vf_load(leaf->extent_x + lane), ey = vf_load(leaf->extent_y + lane), ez = vf_load(leaf->extent_z + lane);
+
+            vf ax = vf_mul(vf_sub(vf_sub(cx, ex), ox), ix), bx = vf_mul(vf_sub(vf_add(cx, ex), ox), ix);
+            vf ay = vf_mul(vf_sub(vf_sub(cy, ey), oy), iy), by = vf_mul(vf_sub(vf_add(cy, ey), oy), iy);
+            vf az = vf_mul(vf_sub(vf_sub(cz, ez), oz), iz), bz = vf_mul(vf_sub(vf_add(cz, ez), oz), iz);
+            vf t0 = vf_max(vf_max(vf_min(ax, bx), vf_min(ay, by)), vf_max(vf_min(az, bz), zero));
+            vf t1 = vf_min(vf_min(vf_max(ax, bx), vf_max(ay, by)), vf_min(vf_max(az, bz), vf_splat(hit.t)));
+
+            // unused lanes have negative extents, their max ends up below their min
+            uint32_t bits = vf_mask_bits(vf_and(vf_cmp_ge(t1, t0), vf_cmp_ge(ex, zero)));
+            if (bits == 0)
+                continue;
+
+            alignas(SIMD_MATH_ALIGN) float t_lanes[SIMD_MATH_WIDTH];
+            vf_store(t_lanes, t0);
+            while (bits)
+            {
+                uint32_t i = frustum_lowest_bit(bits);
+                bits &= bits - 1;
+                if (t_lanes[i] < hit.t || hit.object == BVH_NONE)
+                {
+                    hit.t = t_lanes[i];
+                    hit.object = leaf->objects[lane + i];
+                }
+            }
+        }
+    }
+    return hit;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// frame scoped ring allocator for per draw constant data. one big dynamic buffer is
+// sub-allocated in CBUFFER_RING_ALIGNMENT steps (d3d11.1 offset binding works in units of
+// 16 constants), written with no-overwrite maps and recycled once the frame fence that
+// covers a region completes. the gpu side (fences, map/unmap) sits behind
+// cbuffer_ring_backend so the same code runs on d3d11 and on a mock device.
+
+#define CBUFFER_RING_ALIGNMENT 256
+#define CBUFFER_RING_MAX_FRAMES 8
+
+struct cbuffer_ring_backend
+{
+    void *user;
+    // returns a fence value that completes when the gpu is done with everything submitted so far
+    uint64_t (*signal_fence)(void *user);
+    // latest completed fence value, must not block
+    uint64_t (*completed_fence)(void *user);
+    // blocks until fence completed
+    void (*wait_fence)(void *user, uint64_t fence);
+    // maps [offset, offset + size) of the ring buffer without discarding it
+    void *(*map)(void *user, uint32_t offset, uint32_t size);
+    void (*unmap)(void *user);
+};
+
+struct cbuffer_ring_stats
+{
+    uint64_t frames;
+    uint64_t allocations;
+    uint64_t bytes;             // allocated bytes including alignment and wrap padding
+    uint64_t last_frame_bytes;
+    uint64_t peak_frame_bytes;
+    uint64_t wraps;             // times the head jumped back to offset 0
+    uint64_t stalls;            // allocations that had to wait on a frame fence
+    uint64_t failures;          // allocations that didn't fit even with the gpu idle
+};
+
+struct cbuffer_ring
+{
+    cbuffer_ring_backend backend;
+    uint32_t size;
+
+    // virtual offsets, they only grow, the buffer offset is offset % size
+    uint64_t head;
+    uint64_t tail;
+    uint64_t frame_start;
+
+    // in flight frames, oldest first
+    uint64_t frame_ends[CBUFFER_RING_MAX_FRAMES];
+    uint64_t frame_fences[CBUFFER_RING_MAX_FRAMES];
+    int frame_first;
+    int frame_count;
+
+    cbuffer_ring_stats stats;
+};
+
+struct cbuffer_ring_allocation
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+inline uint32_t
+cbuffer_ring_align(uint32_t size)
+{
+    return (size + CBUFFER_RING_ALIGNMENT - 1) & ~(uint32_t)(CBUFFER_RING_ALIGNMENT - 1);
+}
+
+// size is rounded down to CBUFFER_RING_ALIGNMENT
+inline void
+cbuffer_ring_init(cbuffer_ring *ring, uint32_t size, const cbuffer_ring_backend *backend)
+{
+    ring->backend = *backend;
+    ring->size = size & ~(uint32_t)(CBUFFER_RING_ALIGNMENT - 1);
+    ring->head = 0;
+    ring->tail = 0;
+    ring->frame_start = 0;
+    ring->frame_first = 0;
+    ring->frame_count = 0;
+    ring->stats = {};
+}
+
+// releases the regions of every frame whose fence completed
+inline void
+cbuffer_ring_retire(cbuffer_ring *ring)
+{
+    if (ring->frame_count == 0)
+        return;
+
+    uint64_t completed = ring->backend.completed_fence(ring->backend.user);
+    while (ring->frame_count > 0 && ring->frame_fences[ring->frame_first] <= completed)
+    {
+        ring->tail = ring->frame_ends[ring->frame_first];
+        ring->frame_first = (ring->frame_first + 1) % CBUFFER_RING_MAX_FRAMES;
+        ring->frame_count--;
+    }
+}
+
+// waits for the oldest in flight frame and releases it
+inline void
+cbuffer_ring_wait_oldest(cbuffer_ring *ring)
+{
+    ring->backend.wait_fence(ring->backend.user, ring->frame_fences[ring->frame_first]);
+    cbuffer_ring_retire(ring);
+}
+
+inline void
+cbuffer_ring_begin_frame(cbuffer_ring *ring)
+{
+    cbuffer_ring_retire(ring);
+
+    // every fence slot is taken, the cpu is too far ahead
+    if (ring->frame_count == CBUFFER_RING_MAX_FRAMES)
+    {
+        ring->stats.stalls++;
+        cbuffer_ring_wait_oldest(ring);
+    }
+    ring->frame_start = ring->head;
+}
+
+inline void
+cbuffer_ring_end_frame(cbuffer_ring *ring)
+{
+    int slot = (ring->frame_first + ring->frame_count) % CBUFFER_RING_MAX_FRAMES;
+    ring->frame_ends[slot] = ring->head;
+    ring->frame_fences[slot] = ring->backend.signal_fence(ring->backend.user);
+    ring->frame_count++;
+
+    uint64_t frame_bytes = ring->head - ring->frame_start;
+    ring->stats.frames++;
+    ring->stats.last_frame_bytes = frame_bytes;
+    if (frame_bytes > ring->stats.peak_frame_bytes)
+        ring->stats.peak_frame_bytes = frame_bytes;
+}
+
+// reserves size bytes, waits on old frames when the ring is full. fails when the
+// request can't fit because the current frame alone fills the ring
+inline bool
+cbuffer_ring_alloc(cbuffer_ring *ring, uint32_t size, cbuffer_ring_allocation *allocation)
+{
+    uint32_t aligned_size = cbuffer_ring_align(size);
+    if (aligned_size == 0 || aligned_size > ring->size)
+    {
+        ring->stats.failures++;
+        return false;
+    }
+
+    // allocations never straddle the end of the buffer, skip to the start instead
+    uint32_t position = (uint32_t)(ring->head % ring->size);
+    uint32_t padding = position + aligned_size > ring->size ? ring->size - position : 0;
+    uint64_t needed = (uint64_t)padding + aligned_size;
+
+    bool stalled = false;
+    while (ring->head + needed - ring->tail > ring->size)
+    {
+        cbuffer_ring_retire(ring);
+        if (ring->head + needed - ring->tail <= ring->size)
+            break;
+        if (ring->frame_count == 0)
+        {
+            ring->stats.failures++;
+            return false;
+        }
+        stalled = true;
+        cbuffer_ring_wait_oldest(ring);
+    }
+
+    if (stalled)
+        ring->stats.stalls++;
+    if (padding || (position == 0 && ring->head != 0))
+        ring->stats.wraps++;
+
+    ring->head += padding;
+    allocation->offset = (uint32_t)(ring->head % ring->size);
+    allocation->size = aligned_size;
+    ring->head += aligned_size;
+
+    ring->stats.allocations++;
+    ring->stats.bytes += needed;
+    return true;
+}
+
+// allocates and copies data with one no-overwrite map
+inline bool
+cbuffer_ring_write(cbuffer_ring *ring, const void *data, uint32_t size, cbuffer_ring_allocation *allocation)
+{
+    if (cbuffer_ring_alloc(ring, size, allocation) == false)
+        return false;
+
+    void *dst = ring->backend.map(ring->backend.user, allocation->offset, size);
+    if (dst == nullptr)
+        return false;
+    memcpy(dst, data, size);
+    ring->backend.unmap(ring->backend.user);
+    return true;
+}
@@ -0,0 +1,619 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cbuffer_ring.h"
+#include "profile.h"
+#include "state_cache.h"
+
+// backend neutral recorded command stream. a command is a one byte opcode followed by its
+// arguments packed back to back: objects as raw pointers, integers as LEB128 varints (most
+// slots, counts and offsets take one byte) and signed ones zigzag encoded. per draw constant
+// data goes into the stream inline and is uploaded at replay time, the way a deferred context
+// turns map discards into ring allocations.
+//
+// recording touches nothing but the command buffer, so any number of threads can record
+// their own buffers at the same time. one thread then replays them in order with
+// command_buffer_execute through a state_cache, which is what makes them work on every
+// backend the cache has (d3d11, the null device, the software rasterizer). a buffer doesn't
+// reset state, it runs on whatever the previous one left bound, so each buffer should bind
+// everything its draws need and let the cache drop what is already there.
+
+// opcodes
+enum command_buffer_op
+{
+    COMMAND_BUFFER_OP_SET_INPUT_LAYOUT,
+    COMMAND_BUFFER_OP_SET_PRIMITIVE_TOPOLOGY,
+    COMMAND_BUFFER_OP_SET_VERTEX_BUFFER,
+    COMMAND_BUFFER_OP_SET_INDEX_BUFFER,
+    COMMAND_BUFFER_OP_SET_SHADER,
+    COMMAND_BUFFER_OP_SET_CONSTANT_BUFFER,
+    COMMAND_BUFFER_OP_SET_CONSTANTS,
+    COMMAND_BUFFER_OP_SET_SHADER_RESOURCE,
+    COMMAND_BUFFER_OP_SET_SAMPLER,
+    COMMAND_BUFFER_OP_SET_VIEWPORTS,
+    COMMAND_BUFFER_OP_SET_RENDER_TARGET,
+    COMMAND_BUFFER_OP_SET_DEPTH_STENCIL_VIEW,
+    COMMAND_BUFFER_OP_SET_DEPTH_STENCIL_STATE,
+    COMMAND_BUFFER_OP_DRAW,
+    COMMAND_BUFFER_OP_DRAW_INDEXED,
+    COMMAND_BUFFER_OP_DRAW_INDEXED_INSTANCED,
+    COMMAND_BUFFER_OP_COUNT,
+};
+
+// inline constants start at a multiple of this in the stream so they can be read in place
+#define COMMAND_BUFFER_CONSTANT_ALIGNMENT 16
+
+struct command_buffer
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint32_t command_count;
+    uint32_t draw_count;
+};
+
+// where inline constants go on replay. upload copies size bytes somewhere the backend can read
+// them and returns the buffer to bind with the 16 byte constant range they landed in,
+// constant_count 0 binds the whole buffer. returning null drops the binding.
+struct command_buffer_constants
+{
+    void *user;
+    void *(*upload)(void *user, const void *data, uint32_t size, uint32_t *first_constant, uint32_t *constant_count);
+};
+
+inline void
+command_buffer_init(command_buffer *cb, size_t capacity = 4096)
+{
+    cb->data = (uint8_t *)malloc(capacity);
+    cb->size = 0;
+    cb->capacity = cb->data ? capacity : 0;
+    cb->command_count = 0;
+    cb->draw_count = 0;
+}
+
+inline void
+command_buffer_free(command_buffer *cb)
+{
+    free(cb->data);
+    cb->data = nullptr;
+    cb->size = 0;
+    cb->capacity = 0;
+}
+
+// drops the recorded commands and keeps the memory for the next recording
+inline void
+command_buffer_reset(command_buffer *cb)
+{
+    cb->size = 0;
+    cb->command_count = 0;
+    cb->draw_count = 0;
+}
+
+// encoding
+
+// returns room for max_size more bytes at the end of the stream, write the command there and
+// pass the end of what was written to command_buffer_commit
+inline uint8_t *
+command_buffer_reserve(command_buffer *cb, size_t max_size)
+{
+    if (cb->size + max_size > cb->capacity)
+    {
+        size_t capacity = cb->capacity ? cb->capacity * 2 : 4096;
+        while (capacity < cb->size + max_size)
+            capacity *= 2;
+        uint8_t *data = (uint8_t *)realloc(cb->data, capacity);
+        if (data == nullptr)
+            abort();
+        cb->data = data;
+        cb->capacity = capacity;
+    }
+    return cb->data + cb->size;
+}
+
+inline void
+command_buffer_commit(command_buffer *cb, uint8_t *end)
+{
+    cb->size = (size_t)(end - cb->data);
+    cb->command_count++;
+}
+
+// longest encodings, a varint of a uint32_t takes up to 5 bytes
+#define COMMAND_BUFFER_VARINT_SIZE 5
+#define COMMAND_BUFFER_POINTER_SIZE sizeof(void *)
+
+inline uint8_t *
+command_buffer_put_varint(uint8_t *at, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *at++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *at++ = (uint8_t)value;
+    return at;
+}
+
+inline uint8_t *
+command_buffer_put_int(uint8_t *at, int32_t value)
+{
+    return command_buffer_put_varint(at, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+inline uint8_t *
+command_buffer_put_pointer(uint8_t *at, const void *pointer)
+{
+    memcpy(at, &pointer, sizeof(pointer));
+    return at + sizeof(pointer);
+}
+
+inline const uint8_t *
+command_buffer_get_varint(const uint8_t *at, uint32_t *value)
+{
+    uint32_t result = 0;
+    int shift = 0;
+    while (*at & 0x80)
+    {
+        result |= (uint32_t)(*at++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *value = result | ((uint32_t)*at++ << shift);
+    return at;
+}
+
+inline const uint8_t *
+command_buffer_get_int(const uint8_t *at, int32_t *value)
+{
+    uint32_t zigzag;
+    at = command_buffer_get_varint(at, &zigzag);
+    *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    return at;
+}
+
+inline const uint8_t *
+command_buffer_get_pointer(const uint8_t *at, void **pointer)
+{
+    memcpy(pointer, at, sizeof(*pointer));
+    return at + sizeof(*pointer);
+}
+
+// recording, the calls and their arguments match state_cache.h
+
+inline void
+command_buffer_ia_set_input_layout(command_buffer *cb, void *input_layout)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + COMMAND_BUFFER_POINTER_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_INPUT_LAYOUT;
+    at = command_buffer_put_pointer(at, input_layout);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_ia_set_primitive_topology(command_buffer *cb, uint32_t topology)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_PRIMITIVE_TOPOLOGY;
+    at = command_buffer_put_varint(at, topology);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_ia_set_vertex_buffer(command_buffer *cb, uint32_t slot, void *buffer, uint32_t stride, uint32_t offset)
+{
+    uint8_t *at = command_buffer_reserve(cb, 2 + COMMAND_BUFFER_POINTER_SIZE + 2 * COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_VERTEX_BUFFER;
+    *at++ = (uint8_t)slot;
+    at = command_buffer_put_pointer(at, buffer);
+    at = command_buffer_put_varint(at, stride);
+    at = command_buffer_put_varint(at, offset);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_ia_set_index_buffer(command_buffer *cb, void *buffer, uint32_t format, uint32_t offset)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + COMMAND_BUFFER_POINTER_SIZE + 2 * COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_INDEX_BUFFER;
+    at = command_buffer_put_pointer(at, buffer);
+    at = command_buffer_put_varint(at, format);
+    at = command_buffer_put_varint(at, offset);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_set_shader(command_buffer *cb, state_cache_stage stage, void *shader)
+{
+    uint8_t *at = command_buffer_reserve(cb, 2 + COMMAND_BUFFER_POINTER_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_SHADER;
+    *at++ = (uint8_t)stage;
+    at = command_buffer_put_pointer(at, shader);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_set_constant_buffer(command_buffer *cb, state_cache_stage stage, uint32_t slot, void *buffer, uint32_t first_constant = 0,
+    uint32_t constant_count = 0)
+{
+    uint8_t *at = command_buffer_reserve(cb, 3 + COMMAND_BUFFER_POINTER_SIZE + 2 * COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_CONSTANT_BUFFER;
+    *at++ = (uint8_t)stage;
+    *at++ = (uint8_t)slot;
+    at = command_buffer_put_pointer(at, buffer);
+    at = command_buffer_put_varint(at, first_constant);
+    at = command_buffer_put_varint(at, constant_count);
+    command_buffer_commit(cb, at);
+}
+
+// copies size bytes of constant data into the stream, on replay they get uploaded through
+// command_buffer_constants and bound to slot
+inline void
+command_buffer_set_constants(command_buffer *cb, state_cache_stage stage, uint32_t slot, const void *data, uint32_t size)
+{
+    uint8_t *at = command_buffer_reserve(cb, 3 + COMMAND_BUFFER_VARINT_SIZE + COMMAND_BUFFER_CONSTANT_ALIGNMENT + size);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_CONSTANTS;
+    *at++ = (uint8_t)stage;
+    *at++ = (uint8_t)slot;
+    at = command_buffer_put_varint(at, size);
+    while ((at - cb->data) % COMMAND_BUFFER_CONSTANT_ALIGNMENT)
+        *at++ = 0;
+    memcpy(at, data, size);
+    command_buffer_commit(cb, at + size);
+}
+
+inline void
+command_buffer_set_shader_resource(command_buffer *cb, state_cache_stage stage, uint32_t slot, void *view)
+{
+    uint8_t *at = command_buffer_reserve(cb, 3 + COMMAND_BUFFER_POINTER_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_SHADER_RESOURCE;
+    *at++ = (uint8_t)stage;
+    *at++ = (uint8_t)slot;
+    at = command_buffer_put_pointer(at, view);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_set_sampler(command_buffer *cb, state_cache_stage stage, uint32_t slot, void *sampler)
+{
+    uint8_t *at = command_buffer_reserve(cb, 3 + COMMAND_BUFFER_POINTER_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_SAMPLER;
+    *at++ = (uint8_t)stage;
+    *at++ = (uint8_t)slot;
+    at = command_buffer_put_pointer(at, sampler);
+    command_buffer_commit(cb, at);
+}
+
+inline void command_buffer_vs_set_shader(command_buffer *cb, void *shader) { command_buffer_set_shader(cb, STATE_CACHE_STAGE_VS, shader); }
+inline void command_buffer_ps_set_shader(command_buffer *cb, void *shader) { command_buffer_set_shader(cb, STATE_CACHE_STAGE_PS, shader); }
+
+inline void
+command_buffer_vs_set_constant_buffer(command_buffer *cb, uint32_t slot, void *buffer, uint32_t first_constant = 0, uint32_t constant_count = 0)
+{
+    command_buffer_set_constant_buffer(cb, STATE_CACHE_STAGE_VS, slot, buffer, first_constant, constant_count);
+}
+
+inline void
+command_buffer_ps_set_constant_buffer(command_buffer *cb, uint32_t slot, void *buffer, uint32_t first_constant = 0, uint32_t constant_count = 0)
+{
+    command_buffer_set_constant_buffer(cb, STATE_CACHE_STAGE_PS, slot, buffer, first_constant, constant_count);
+}
+
+inline void
+command_buffer_vs_set_constants(command_buffer *cb, uint32_t slot, const void *data, uint32_t size)
+{
+    command_buffer_set_constants(cb, STATE_CACHE_STAGE_VS, slot, data, size);
+}
+
+inline void
+command_buffer_ps_set_constants(command_buffer *cb, uint32_t slot, const void *data, uint32_t size)
+{
+    command_buffer_set_constants(cb, STATE_CACHE_STAGE_PS, slot, data, size);
+}
+
+inline void
+command_buffer_ps_set_shader_resource(command_buffer *cb, uint32_t slot, void *view)
+{
+    command_buffer_set_shader_resource(cb, STATE_CACHE_STAGE_PS, slot, view);
+}
+
+inline void
+command_buffer_ps_set_sampler(command_buffer *cb, uint32_t slot, void *sampler)
+{
+    command_buffer_set_sampler(cb, STATE_CACHE_STAGE_PS, slot, sampler);
+}
+
+inline void
+command_buffer_rs_set_viewports(command_buffer *cb, uint32_t count, const state_cache_viewport *viewports)
+{
+    uint8_t *at = command_buffer_reserve(cb, 2 + count * sizeof(*viewports));
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_VIEWPORTS;
+    *at++ = (uint8_t)count;
+    memcpy(at, viewports, count * sizeof(*viewports));
+    command_buffer_commit(cb, at + count * sizeof(*viewports));
+}
+
+inline void
+command_buffer_om_set_render_target(command_buffer *cb, uint32_t slot, void *view)
+{
+    uint8_t *at = command_buffer_reserve(cb, 2 + COMMAND_BUFFER_POINTER_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_RENDER_TARGET;
+    *at++ = (uint8_t)slot;
+    at = command_buffer_put_pointer(at, view);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_om_set_depth_stencil_view(command_buffer *cb, void *view)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + COMMAND_BUFFER_POINTER_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_DEPTH_STENCIL_VIEW;
+    at = command_buffer_put_pointer(at, view);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_om_set_depth_stencil_state(command_buffer *cb, void *state, uint32_t stencil_ref)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + COMMAND_BUFFER_POINTER_SIZE + COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_SET_DEPTH_STENCIL_STATE;
+    at = command_buffer_put_pointer(at, state);
+    at = command_buffer_put_varint(at, stencil_ref);
+    command_buffer_commit(cb, at);
+}
+
+inline void
+command_buffer_draw(command_buffer *cb, uint32_t vertex_count, uint32_t start_vertex)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + 2 * COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_DRAW;
+    at = command_buffer_put_varint(at, vertex_count);
+    at = command_buffer_put_varint(at, start_vertex);
+    command_buffer_commit(cb, at);
+    cb->draw_count++;
+}
+
+inline void
+command_buffer_draw_indexed(command_buffer *cb, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + 3 * COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_DRAW_INDEXED;
+    at = command_buffer_put_varint(at, index_count);
+    at = command_buffer_put_varint(at, start_index);
+    at = command_buffer_put_int(at, base_vertex);
+    command_buffer_commit(cb, at);
+    cb->draw_count++;
+}
+
+inline void
+command_buffer_draw_indexed_instanced(command_buffer *cb, uint32_t index_count, uint32_t instance_count, uint32_t start_index,
+    int32_t base_vertex, uint32_t start_instance)
+{
+    uint8_t *at = command_buffer_reserve(cb, 1 + 5 * COMMAND_BUFFER_VARINT_SIZE);
+    *at++ = (uint8_t)COMMAND_BUFFER_OP_DRAW_INDEXED_INSTANCED;
+    at = command_buffer_put_varint(at, index_count);
+    at = command_buffer_put_varint(at, instance_count);
+    at = command_buffer_put_varint(at, start_index);
+    at = command_buffer_put_int(at, base_vertex);
+    at = command_buffer_put_varint(at, start_instance);
+    command_buffer_commit(cb, at);
+    cb->draw_count++;
+}
+
+// replay
+
+// sends every command of cb to cache in recording order, constants may be null when cb has no
+// inline constants
+inline void
+command_buffer_execute(const command_buffer *cb, state_cache *cache, const command_buffer_constants *constants)
+{
+    PROFILE_ZONE("command_buffer_execute");
+    const uint8_t *at = cb->data;
+    const uint8_t *end = cb->data + cb->size;
+    while (at < end)
+    {
+        uint8_t op = *at++;
+        switch (op)
+        {
+            case COMMAND_BUFFER_OP_SET_INPUT_LAYOUT:
+            {
+                void *input_layout;
+                at = command_buffer_get_pointer(at, &input_layout);
+                state_cache_ia_set_input_layout(cache, input_layout);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_PRIMITIVE_TOPOLOGY:
+            {
+                uint32_t topology;
+                at = command_buffer_get_varint(at, &topology);
+                state_cache_ia_set_primitive_topology(cache, topology);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_VERTEX_BUFFER:
+            {
+                uint32_t slot = *at++;
+                void *buffer;
+                uint32_t stride, offset;
+                at = command_buffer_get_pointer(at, &buffer);
+                at = command_buffer_get_varint(at, &stride);
+                at = command_buffer_get_varint(at, &offset);
+                state_cache_ia_set_vertex_buffer(cache, slot, buffer, stride, offset);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_INDEX_BUFFER:
+            {
+                void *buffer;
+                uint32_t format, offset;
+                at = command_buffer_get_pointer(at, &buffer);
+                at = command_buffer_get_varint(at, &format);
+                at = command_buffer_get_varint(at, &offset);
+                state_cache_ia_set_index_buffer(cache, buffer, format, offset);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_SHADER:
+            {
+                state_cache_stage stage = (state_cache_stage)*at++;
+                void *shader;
+                at = command_buffer_get_pointer(at, &shader);
+                state_cache_set_shader(cache, stage, shader);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_CONSTANT_BUFFER:
+            {
+                state_cache_stage stage = (state_cache_stage)*at++;
+                uint32_t slot = *at++;
+                void *buffer;
+                uint32_t first_constant, constant_count;
+                at = command_buffer_get_pointer(at, &buffer);
+                at = command_buffer_get_varint(at, &first_constant);
+                at = command_buffer_get_varint(at, &constant_count);
+                state_cache_set_constant_buffer(cache, stage, slot, buffer, first_constant, constant_count);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_CONSTANTS:
+            {
+                state_cache_stage stage = (state_cache_stage)*at++;
+                uint32_t slot = *at++;
+                uint32_t size;
+                at = command_buffer_get_varint(at, &size);
+                while ((at - cb->data) % COMMAND_BUFFER_CONSTANT_ALIGNMENT)
+                    at++;
+
+                uint32_t first_constant = 0;
+                uint32_t constant_count = 0;
+                void *buffer = constants ? constants->upload(constants->user, at, size, &first_constant, &constant_count) : nullptr;
+                state_cache_set_constant_buffer(cache, stage, slot, buffer, first_constant, constant_count);
+                at += size;
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_SHADER_RESOURCE:
+            {
+                state_cache_stage stage = (state_cache_stage)*at++;
+                uint32_t slot = *at++;
+                void *view;
+                at = command_buffer_get_pointer(at, &view);
+                state_cache_set_shader_resource(cache, stage, slot, view);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_SAMPLER:
+            {
+                state_cache_stage stage = (state_cache_stage)*at++;
+                uint32_t slot = *at++;
+                void *sampler;
+                at = command_buffer_get_pointer(at, &sampler);
+                state_cache_set_sampler(cache, stage, slot, sampler);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_VIEWPORTS:
+            {
+                uint32_t count = *at++;
+                state_cache_viewport viewports[STATE_CACHE_VIEWPORT_SLOTS];
+                memcpy(viewports, at, count * sizeof(*viewports));
+                at += count * sizeof(*viewports);
+                state_cache_rs_set_viewports(cache, count, viewports);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_RENDER_TARGET:
+            {
+                uint32_t slot = *at++;
+                void *view;
+                at = command_buffer_get_pointer(at, &view);
+                state_cache_om_set_render_target(cache, slot, view);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_DEPTH_STENCIL_VIEW:
+            {
+                void *view;
+                at = command_buffer_get_pointer(at, &view);
+                state_cache_om_set_depth_stencil_view(cache, view);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_SET_DEPTH_STENCIL_STATE:
+            {
+                void *state;
+                uint32_t stencil_ref;
+                at = command_buffer_get_pointer(at, &state);
+                at = command_buffer_get_varint(at, &stencil_ref);
+                state_cache_om_set_depth_stencil_state(cache, state, stencil_ref);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_DRAW:
+            {
+                uint32_t vertex_count, start_vertex;
+                at = command_buffer_get_varint(at, &vertex_count);
+                at = command_buffer_get_varint(at, &start_vertex);
+                state_cache_draw(cache, vertex_count, start_vertex);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_DRAW_INDEXED:
+            {
+                uint32_t index_count, start_index;
+                int32_t base_vertex;
+                at = command_buffer_get_varint(at, &index_count);
+                at = command_buffer_get_varint(at, &start_index);
+                at = command_buffer_get_int(at, &base_vertex);
+                state_cache_draw_indexed(cache, index_count, start_index, base_vertex);
+                break;
+            }
+
+            case COMMAND_BUFFER_OP_DRAW_INDEXED_INSTANCED:
+            {
+                uint32_t index_count, instance_count, start_index, start_instance;
+                int32_t base_vertex;
+                at = command_buffer_get_varint(at, &index_count);
+                at = command_buffer_get_varint(at, &instance_count);
+                at = command_buffer_get_varint(at, &start_index);
+                at = command_buffer_get_int(at, &base_vertex);
+                at = command_buffer_get_varint(at, &start_instance);
+                state_cache_draw_indexed_instanced(cache, index_count, instance_count, start_index, base_vertex, start_instance);
+                break;
+            }
+
+            default:
+                // corrupt stream, nothing after this can be decoded
+                return;
+        }
+    }
+}
+
+// inline constants through a cbuffer_ring, buffer is the object the ring sub-allocates
+struct command_buffer_ring
+{
+    cbuffer_ring *ring;
+    void *buffer;
+};
+
+inline void *
+command_buffer_ring_upload(void *user, const void *data, uint32_t size, uint32_t *first_constant, uint32_t *constant_count)
+{
+    command_buffer_ring *ring = (command_buffer_ring *)user;
+    cbuffer_ring_allocation allocation;
+    if (cbuffer_ring_write(ring->ring, data, size, &allocation) == false)
+        return nullptr;
+    *first_constant = allocation.offset / 16;
+    *constant_count = allocation.size / 16;
+    return ring->buffer;
+}
+
+inline command_buffer_constants
+command_buffer_constants_ring(command_buffer_ring *ring)
+{
+    command_buffer_constants constants = {};
+    constants.user = ring;
+    constants.upload = command_buffer_ring_upload;
+    return constants;
+}
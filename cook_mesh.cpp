@@ -0,0 +1,144 @@
+// cooks an .obj, .gltf or .glb into a mesh_file.h container: import on the thread pool, reorder
+// triangles for the post transform cache and vertices for fetch, quantize, usage:
+// cook_mesh input output.mesh [-p float|snorm16|half] [-u float|unorm16|half] [-c float|rgba8] [-keep-order] [-t threads]
+// -keep-order leaves triangles and vertices as the source has them, for meshes that are
+// drawn with per primitive data
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "mesh_file.h"
+#include "mesh_import.h"
+#include "mesh_optimize.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// tipsify, then every stream in order of first use
+static void
+optimize(mesh_data *mesh)
+{
+    size_t vertex_count = mesh->positions.size() / 3;
+    size_t index_count = mesh->indices.size();
+    mesh_optimize_vertex_cache(mesh->indices.data(), mesh->indices.data(), index_count, vertex_count);
+
+    std::vector<uint32_t> remap(vertex_count);
+    size_t used = mesh_optimize_vertex_fetch_remap(remap.data(), mesh->indices.data(), index_count, vertex_count);
+    std::vector<float> *streams[] = {&mesh->positions, &mesh->uvs, &mesh->colors};
+    for (std::vector<float> *stream : streams)
+    {
+        if (stream->empty())
+            continue;
+        size_t components = stream->size() / vertex_count;
+        std::vector<float> reordered(used * components);
+        for (size_t v = 0; v < vertex_count; ++v)
+        {
+            if (remap[v] != UINT32_MAX)
+                memcpy(&reordered[(size_t)remap[v] * components], &(*stream)[v * components], components * sizeof(float));
+        }
+        stream->swap(reordered);
+    }
+    for (uint32_t &index : mesh->indices)
+        index = remap[index];
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: cook_mesh input output.mesh [-p float|snorm16|half] [-u float|unorm16|half] [-c float|rgba8] [-keep-order] [-t threads]\n");
+        return 1;
+    }
+
+    const char *input = argv[1];
+    const char *output = argv[2];
+    mesh_encoding encoding = {MESH_POSITION_SNORM16, MESH_UV_UNORM16, MESH_COLOR_RGBA8, true};
+    bool keep_order = false;
+    int threads = 0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-keep-order") == 0)
+        {
+            keep_order = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            break;
+
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "-p") == 0)
+        {
+            if (strcmp(value, "float") == 0)
+                encoding.position = MESH_POSITION_FLOAT;
+            else if (strcmp(value, "snorm16") == 0)
+                encoding.position = MESH_POSITION_SNORM16;
+            else if (strcmp(value, "half") == 0)
+                encoding.position = MESH_POSITION_HALF;
+        }
+        else if (strcmp(argv[i - 1], "-u") == 0)
+        {
+            if (strcmp(value, "float") == 0)
+                encoding.uv = MESH_UV_FLOAT;
+            else if (strcmp(value, "unorm16") == 0)
+                encoding.uv = MESH_UV_UNORM16;
+            else if (strcmp(value, "half") == 0)
+                encoding.uv = MESH_UV_HALF;
+        }
+        else if (strcmp(argv[i - 1], "-c") == 0)
+        {
+            encoding.color = strcmp(value, "float") == 0 ? MESH_COLOR_FLOAT : MESH_COLOR_RGBA8;
+        }
+        else if (strcmp(argv[i - 1], "-t") == 0)
+        {
+            threads = atoi(value);
+        }
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    double start = now_seconds();
+    mesh_data mesh;
+    bool imported = mesh_import(input, &mesh, &pool);
+    thread_pool_shutdown(&pool);
+    if (imported == false)
+    {
+        fprintf(stderr, "Failed to import %s\n", input);
+        return 1;
+    }
+    double import_ms = (now_seconds() - start) * 1000.0;
+
+    start = now_seconds();
+    if (keep_order == false)
+        optimize(&mesh);
+    double optimize_ms = (now_seconds() - start) * 1000.0;
+
+    start = now_seconds();
+    mesh_source source = mesh_data_source(&mesh);
+    mesh_encoded encoded;
+    if (mesh_encode(&source, &encoding, &encoded) == false)
+    {
+        fprintf(stderr, "Failed to encode %s\n", input);
+        return 1;
+    }
+    if (mesh_file_write(output, &encoded) == false)
+    {
+        fprintf(stderr, "Failed to write %s\n", output);
+        return 1;
+    }
+    double write_ms = (now_seconds() - start) * 1000.0;
+
+    printf("%s: %zu vertices, %zu triangles, %u byte vertices, %u bit indices, %.2f MB -> %.2f MB\n", output, encoded.vertex_count,
+        encoded.index_count / 3, encoded.stride, encoded.index_size * 8, (double)mesh_source_size(&source) / (1024.0 * 1024.0),
+        (double)mesh_encoded_size(&encoded) / (1024.0 * 1024.0));
+    printf("import %.1f ms, optimize %.1f ms, encode and write %.1f ms\n", import_ms, optimize_ms, write_ms);
+    return 0;
+}
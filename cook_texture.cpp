@@ -0,0 +1,152 @@
+// cooks an image into a texture_file.h container: decode, full mip chain, optional block
+// compression, usage:
+// cook_texture input output.tex [-f rgba8|bc1|bc3|bc7] [-q fast|normal|high] [-m box|kaiser|lanczos] [-linear] [-t threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "bc_encode.h"
+#include "image_io.h"
+#include "mip_gen.h"
+#include "texture_file.h"
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: cook_texture input output.tex [-f rgba8|bc1|bc3|bc7] [-q fast|normal|high] [-m box|kaiser|lanczos] [-linear] [-t threads]\n");
+        return 1;
+    }
+
+    const char *input = argv[1];
+    const char *output = argv[2];
+    texture_file_format format = TEXTURE_FILE_FORMAT_BC7;
+    bc_quality quality = BC_QUALITY_NORMAL;
+    mip_filter filter = MIP_FILTER_KAISER;
+    bool srgb = true;
+    int threads = 0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-linear") == 0)
+        {
+            srgb = false;
+            continue;
+        }
+        if (i + 1 >= argc)
+            break;
+
+        const char *value = argv[++i];
+        if (strcmp(argv[i - 1], "-f") == 0)
+        {
+            if (strcmp(value, "rgba8") == 0)
+                format = TEXTURE_FILE_FORMAT_RGBA8;
+            else if (strcmp(value, "bc1") == 0)
+                format = TEXTURE_FILE_FORMAT_BC1;
+            else if (strcmp(value, "bc3") == 0)
+                format = TEXTURE_FILE_FORMAT_BC3;
+            else if (strcmp(value, "bc7") == 0)
+                format = TEXTURE_FILE_FORMAT_BC7;
+        }
+        else if (strcmp(argv[i - 1], "-q") == 0)
+        {
+            if (strcmp(value, "fast") == 0)
+                quality = BC_QUALITY_FAST;
+            else if (strcmp(value, "normal") == 0)
+                quality = BC_QUALITY_NORMAL;
+            else if (strcmp(value, "high") == 0)
+                quality = BC_QUALITY_HIGH;
+        }
+        else if (strcmp(argv[i - 1], "-m") == 0)
+        {
+            if (strcmp(value, "box") == 0)
+                filter = MIP_FILTER_BOX;
+            else if (strcmp(value, "kaiser") == 0)
+                filter = MIP_FILTER_KAISER;
+            else if (strcmp(value, "lanczos") == 0)
+                filter = MIP_FILTER_LANCZOS;
+        }
+        else if (strcmp(argv[i - 1], "-t") == 0)
+        {
+            threads = atoi(value);
+        }
+    }
+
+    double start = now_seconds();
+    int width, height;
+    uint8_t *pixels = image_load(input, &width, &height);
+    if (pixels == nullptr)
+    {
+        fprintf(stderr, "Failed to load %s\n", input);
+        return 1;
+    }
+    double loaded = now_seconds();
+
+    // D3D11 wants the top level of a BC texture to be a multiple of the block size
+    if (texture_file_is_block_format(format) && (width % 4 != 0 || height % 4 != 0))
+    {
+        fprintf(stderr, "%dx%d is not a multiple of 4, use -f rgba8\n", width, height);
+        return 1;
+    }
+
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    mip_chain mips = {};
+    if (mip_chain_build(&mips, pixels, width, height, filter, srgb, &pool) == false)
+    {
+        fprintf(stderr, "Failed to generate mips\n");
+        return 1;
+    }
+    double mipped = now_seconds();
+
+    // compress every level, rgba8 levels are written straight from the chain
+    std::vector<std::vector<uint8_t>> blocks(mips.level_count);
+    std::vector<const void *> subresources(mips.level_count);
+    for (int level = 0; level < mips.level_count; ++level)
+    {
+        const mip_level *mip = &mips.levels[level];
+        if (format == TEXTURE_FILE_FORMAT_RGBA8)
+        {
+            subresources[level] = mip->data;
+            continue;
+        }
+
+        bc_format bc = format == TEXTURE_FILE_FORMAT_BC1 ? BC_FORMAT_BC1 : (format == TEXTURE_FILE_FORMAT_BC3 ? BC_FORMAT_BC3 : BC_FORMAT_BC7);
+        blocks[level].resize(bc_level_size(bc, mip->width, mip->height));
+        bc_encode_image(bc, quality, mip->data, mip->width, mip->height, mip->pitch, blocks[level].data(), &pool);
+        subresources[level] = blocks[level].data();
+    }
+    double encoded = now_seconds();
+
+    bool written = texture_file_write(output, format, srgb ? TEXTURE_FILE_FLAG_SRGB : 0,
+        (uint32_t)width, (uint32_t)height, (uint32_t)mips.level_count, 1, subresources.data());
+    double finished = now_seconds();
+
+    int level_count = mips.level_count;
+    int thread_count = thread_pool_size(&pool);
+    mip_chain_free(&mips);
+    image_free(pixels);
+    thread_pool_shutdown(&pool);
+
+    if (written == false)
+    {
+        fprintf(stderr, "Failed to write %s\n", output);
+        return 1;
+    }
+
+    printf("%s -> %s, %dx%d, %d levels, %d threads\n", input, output, width, height, level_count, thread_count);
+    printf("load %.1f ms, mips %.1f ms, encode %.1f ms, write %.1f ms\n",
+        (loaded - start) * 1000.0, (mipped - loaded) * 1000.0, (encoded - mipped) * 1000.0, (finished - encoded) * 1000.0);
+    return 0;
+}
@@ -16,6 +16,9 @@
 #undef max
 #endif
 
+#include "shader_cache_d3d.h"
+#include "state_cache_d3d.h"
+
 LRESULT CALLBACK
 window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 {
@@ -144,7 +147,7 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
     }
 
     // create vertex and pixel shaders
-    ID3DBlob *vertex_shader_blob = nullptr;
+    std::vector<uint8_t> vertex_shader_code;
     ID3D11VertexShader *vertex_shader = nullptr;
     ID3D11PixelShader *pixel_shader = nullptr;
     {
@@ -165,58 +168,48 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
             }
         )";
 
-        // compile vertex shader
+        // compile through the shader cache in build/shader_cache, later runs read the bytecode
+        // from disk instead of calling D3DCompile and the misses compile in parallel
+        std::vector<uint8_t> pixel_shader_code;
         {
-            ID3DBlob *error_blob = nullptr;
-            HRESULT result = D3DCompile(
-                shader_src,
-                sizeof(shader_src),
-                nullptr,
-                nullptr,
-                nullptr,
-                "vs_main",
-                "vs_5_0",
-                0,
-                0,
-                &vertex_shader_blob,
-                &error_blob);
-            if (FAILED(result))
+            shader_desc shader_descs[] = {
+                {"shader_src", shader_src, sizeof(shader_src), "vs_main", "vs_5_0", nullptr, 0},
+                {"shader_src", shader_src, sizeof(shader_src), "ps_main", "ps_5_0", nullptr, 0},
+            };
+            std::vector<uint8_t> *shader_code[] = {&vertex_shader_code, &pixel_shader_code};
+            const wchar_t *shader_errors[] = {L"Failed to compile vertex shader", L"Failed to compile pixel shader"};
+            shader_result shader_results[ARRAYSIZE(shader_descs)];
+
+            shader_cache cache;
+            shader_cache_init(&cache, "shader_cache", shader_compiler_d3d());
+            thread_pool pool;
+            thread_pool_init(&pool, (int)ARRAYSIZE(shader_descs));
+            shader_cache_compile_many(&cache, shader_descs, (int)ARRAYSIZE(shader_descs), shader_results, &pool);
+            thread_pool_shutdown(&pool);
+
+            for (int i = 0; i < (int)ARRAYSIZE(shader_descs); ++i)
             {
-                OutputDebugString(L"Failed to compile vertex shader");
-                OutputDebugStringA((char *)error_blob->GetBufferPointer());
-                return GetLastError();
+                if (shader_results[i].ok == false)
+                {
+                    OutputDebugString(shader_errors[i]);
+                    OutputDebugStringA(shader_results[i].errors.c_str());
+                    return GetLastError();
+                }
+                shader_code[i]->swap(shader_results[i].bytecode);
             }
-        }
 
-        // compile pixel shader
-        ID3DBlob *pixel_shader_blob = nullptr;
-        {
-            ID3DBlob *error_blob = nullptr;
-            HRESULT result = D3DCompile(
-                shader_src,
-                sizeof(shader_src),
-                nullptr,
-                nullptr,
-                nullptr,
-                "ps_main",
-                "ps_5_0",
-                0,
-                0,
-                &pixel_shader_blob,
-                &error_blob);
-            if (FAILED(result))
-            {
-                OutputDebugString(L"Failed to compile pixel shader");
-                OutputDebugStringA((char *)error_blob->GetBufferPointer());
-                return GetLastError();
-            }
+            shader_cache_stats stats = shader_cache_get_stats(&cache);
+            char message[128];
+            snprintf(message, sizeof(message), "shader cache: %llu of %llu from cache, %.2f ms saved\n",
+                (unsigned long long)(stats.memory_hits + stats.disk_hits), (unsigned long long)stats.lookups, stats.saved_seconds * 1000.0);
+            OutputDebugStringA(message);
         }
 
         // create vertex shader
         {
             HRESULT result = device->CreateVertexShader(
-                vertex_shader_blob->GetBufferPointer(),
-                vertex_shader_blob->GetBufferSize(),
+                vertex_shader_code.data(),
+                vertex_shader_code.size(),
                 nullptr,
                 &vertex_shader);
             if (FAILED(result))
@@ -229,8 +222,8 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         // create pixel shader
         {
             HRESULT result = device->CreatePixelShader(
-                pixel_shader_blob->GetBufferPointer(),
-                pixel_shader_blob->GetBufferSize(),
+                pixel_shader_code.data(),
+                pixel_shader_code.size(),
                 nullptr,
                 &pixel_shader);
             if (FAILED(result))
@@ -238,7 +231,6 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
                 OutputDebugString(L"Failed to create pixel shader");
                 return GetLastError();
             }
-            pixel_shader_blob->Release();
         }
     }
 
@@ -252,14 +244,13 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         HRESULT result = device->CreateInputLayout(
             input_element_desc,
             ARRAYSIZE(input_element_desc),
-            vertex_shader_blob->GetBufferPointer(),
-            vertex_shader_blob->GetBufferSize(), &input_layout);
+            vertex_shader_code.data(),
+            vertex_shader_code.size(), &input_layout);
         if (FAILED(result))
         {
             OutputDebugString(L"Failed to create input layout");
             return GetLastError();
         }
-        vertex_shader_blob->Release();
     }
 
     // create viewport
@@ -299,6 +290,14 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         }
     }
 
+    // every bind in the frame loop goes through the state cache, which drops the redundant ones
+    state_cache_d3d state_backend = {context, nullptr};
+    state_cache state;
+    {
+        state_cache_backend backend = state_cache_backend_d3d(&state_backend);
+        state_cache_init(&state, &backend);
+    }
+
     // msg loop
     bool running = true;
     while (running)
@@ -322,26 +321,28 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         // set vertex buffer in input assempler stage
         UINT stride = 2 * sizeof(float);
         UINT offset = 0;
-        context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
-        context->IASetInputLayout(input_layout);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        state_cache_ia_set_vertex_buffer(&state, 0, vertex_buffer, stride, offset);
+        state_cache_ia_set_input_layout(&state, input_layout);
+        state_cache_ia_set_primitive_topology(&state, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
         // set vertex and pixel shaders
-        context->VSSetShader(vertex_shader, nullptr, 0);
-        context->PSSetShader(pixel_shader, nullptr, 0);
+        state_cache_vs_set_shader(&state, vertex_shader);
+        state_cache_ps_set_shader(&state, pixel_shader);
 
         // set pixel shader constant buffer
-        context->PSSetConstantBuffers(0, 1, &constant_buffer);
+        state_cache_ps_set_constant_buffer(&state, 0, constant_buffer);
 
         // set viewport
-        context->RSSetViewports(1, &viewport);
+        state_cache_rs_set_viewports(&state, 1, &viewport);
 
         // set render target and viewport
-        context->OMSetRenderTargets(1, &render_target_view, nullptr);
+        state_cache_om_set_render_target(&state, 0, render_target_view);
+        state_cache_om_set_depth_stencil_view(&state, nullptr);
 
         // draw
-        context->Draw(3, 0);
+        state_cache_draw(&state, 3, 0);
 
+        state_cache_end_frame(&state);
         swapchain->Present(1, 0);
     }
 
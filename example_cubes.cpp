@@ -5,9 +5,8 @@
 #define WIN32_LEAN_AND_MEAN
 #define UNICODE
 #include <Windows.h>
-#include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
-#include <DirectXMath.h>
 
 #if defined(min)
 #undef min
@@ -17,6 +16,102 @@
 #undef max
 #endif
 
+#include <stdio.h>
+
+#include <mutex>
+#include <thread>
+
+#include "cbuffer_ring.h"
+#include "command_buffer.h"
+#include "frame_handoff.h"
+#include "frame_timing.h"
+#include "mesh_file.h"
+#include "mesh_quantize_d3d.h"
+#include "shader_cache_d3d.h"
+#include "state_cache_d3d.h"
+#include "simd_math.h"
+
+// event queries used as frame fences for the constant ring, fence n lives in
+// queries[n % ARRAYSIZE(queries)]
+struct d3d11_ring_backend
+{
+    ID3D11DeviceContext1 *context;
+    ID3D11Buffer *buffer;
+    ID3D11Query *queries[CBUFFER_RING_MAX_FRAMES + 1];
+    uint64_t signaled;
+    uint64_t completed;
+};
+
+static uint64_t
+d3d11_ring_signal_fence(void *user)
+{
+    d3d11_ring_backend *backend = (d3d11_ring_backend *)user;
+    backend->signaled++;
+    backend->context->End(backend->queries[backend->signaled % ARRAYSIZE(backend->queries)]);
+    return backend->signaled;
+}
+
+static uint64_t
+d3d11_ring_completed_fence(void *user)
+{
+    d3d11_ring_backend *backend = (d3d11_ring_backend *)user;
+    while (backend->completed < backend->signaled)
+    {
+        BOOL done = FALSE;
+        ID3D11Query *query = backend->queries[(backend->completed + 1) % ARRAYSIZE(backend->queries)];
+        if (backend->context->GetData(query, &done, sizeof(done), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK || done == FALSE)
+            break;
+        backend->completed++;
+    }
+    return backend->completed;
+}
+
+static void
+d3d11_ring_wait_fence(void *user, uint64_t fence)
+{
+    d3d11_ring_backend *backend = (d3d11_ring_backend *)user;
+    while (backend->completed < fence)
+    {
+        BOOL done = FALSE;
+        ID3D11Query *query = backend->queries[(backend->completed + 1) % ARRAYSIZE(backend->queries)];
+        if (backend->context->GetData(query, &done, sizeof(done), 0) == S_OK && done)
+            backend->completed++;
+        else
+            YieldProcessor();
+    }
+}
+
+static void *
+d3d11_ring_map(void *user, uint32_t offset, uint32_t size)
+{
+    d3d11_ring_backend *backend = (d3d11_ring_backend *)user;
+    D3D11_MAPPED_SUBRESOURCE mapped_subresource = {};
+    if (FAILED(backend->context->Map(backend->buffer, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped_subresource)))
+        return nullptr;
+    return (uint8_t *)mapped_subresource.pData + offset;
+}
+
+static void
+d3d11_ring_unmap(void *user)
+{
+    d3d11_ring_backend *backend = (d3d11_ring_backend *)user;
+    backend->context->Unmap(backend->buffer, 0);
+}
+
+// the simulation runs at a fixed 60 hz
+#define CUBE_SIM_STEP (1.0 / 60.0)
+
+// what the simulation hands the render thread, the last two steps for interpolation
+struct cube_snapshot
+{
+    double state_time;
+    float previous_angle;
+    float angle;
+};
+
+// key codes from the window thread to the simulation
+typedef spsc_queue<uint32_t, 256> cube_input_queue;
+
 LRESULT CALLBACK
 window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 {
@@ -35,6 +130,28 @@ window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
 int
 WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdShow)
 {
+    // set current directory to the executable directory
+    {
+        char module_path[512];
+        GetModuleFileNameA(0, module_path, sizeof(module_path));
+
+        char *last_slash = module_path;
+        char *iter = module_path;
+        while (*iter++)
+        {
+            if (*iter == '\\')
+                last_slash = ++iter;
+        }
+        *last_slash = '\0';
+
+        bool result = SetCurrentDirectoryA(module_path);
+        if (result == false)
+        {
+            OutputDebugString(L"Failed to set current directory\n");
+            return 1;
+        }
+    }
+
     // register window class
     {
         WNDCLASSEX wnd_class = {};
@@ -113,6 +230,25 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         }
     }
 
+    // the constant ring needs d3d11.1 offset binding and no-overwrite maps on constant buffers
+    ID3D11DeviceContext1 *context1 = nullptr;
+    {
+        HRESULT result = context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void **)&context1);
+        if (FAILED(result))
+        {
+            OutputDebugString(L"Failed to get d3d11.1 device context");
+            return GetLastError();
+        }
+
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        result = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+        if (FAILED(result) || options.ConstantBufferOffsetting == FALSE || options.MapNoOverwriteOnDynamicConstantBuffer == FALSE)
+        {
+            OutputDebugString(L"Constant buffer offsetting is not supported");
+            return 1;
+        }
+    }
+
     // create render target view
     ID3D11RenderTargetView *render_target_view = nullptr;
     {
@@ -157,69 +293,69 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         depth_stencil->Release();
     }
 
-    // create vertiex and index buffers
+    // create vertiex and index buffers from the cube build.bat cooked out of data/cube.obj,
+    // snorm16 positions and 16 bit indices that go to CreateBuffer straight from the mapping
     ID3D11Buffer *vertex_buffer = nullptr;
     ID3D11Buffer *index_buffer = nullptr;
+    mesh_vertex_element cube_elements[MESH_MAX_ELEMENTS];
+    uint32_t cube_element_count = 0;
+    UINT cube_stride = 0;
+    DXGI_FORMAT cube_index_format = DXGI_FORMAT_R16_UINT;
+    UINT cube_index_count = 0;
+    mat4 cube_dequantize;
     {
-        // vertex buffer
+        mesh_file cube_file;
+        if (mesh_file_open(&cube_file, "data/cube.mesh") == false)
         {
-            float vertices[] = {
-                // position
-                -1.0f, -1.0f, -1.0f,
-                 1.0f, -1.0f, -1.0f,
-                -1.0f,  1.0f, -1.0f,
-                 1.0f,  1.0f, -1.0f,
-                -1.0f, -1.0f,  1.0f,
-                 1.0f, -1.0f,  1.0f,
-                -1.0f,  1.0f,  1.0f,
-                 1.0f,  1.0f,  1.0f
-            };
+            OutputDebugString(L"Failed to open data/cube.mesh, build.bat cooks it with cook_mesh");
+            return 1;
+        }
+        cube_element_count = mesh_file_elements(&cube_file, cube_elements);
+        cube_stride = cube_file.header->stride;
+        cube_index_format = (DXGI_FORMAT)cube_file.header->index_format;
+        cube_index_count = cube_file.header->index_count;
+        cube_dequantize = mesh_file_dequantize_matrix(&cube_file);
 
+        // vertex buffer
+        {
             D3D11_BUFFER_DESC buffer_desc = {};
-            buffer_desc.ByteWidth = sizeof(vertices);
+            buffer_desc.ByteWidth = (UINT)cube_file.header->vertex_size;
             buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-            buffer_desc.StructureByteStride = 3 * sizeof(float);
+            buffer_desc.StructureByteStride = cube_stride;
 
             D3D11_SUBRESOURCE_DATA subresource_data = {};
-            subresource_data.pSysMem = vertices;
+            subresource_data.pSysMem = mesh_file_vertices(&cube_file);
 
             HRESULT result = device->CreateBuffer(&buffer_desc, &subresource_data, &vertex_buffer);
             if (FAILED(result))
             {
                 OutputDebugString(L"Failed to create vertex buffer");
+                mesh_file_close(&cube_file);
                 return GetLastError();
             }
         }
         // index buffer
         {
-            unsigned int indices[] = {
-                // clockwise
-                0, 2, 3,  0, 3, 1,
-                1, 3, 7,  1, 7, 5,
-                5, 7, 6,  5, 6, 4,
-                4, 6, 2,  4, 2, 0,
-                2, 6, 7,  2, 7, 3,
-                0, 1, 5,  0, 5, 4
-            };
-
             D3D11_BUFFER_DESC buffer_desc = {};
-            buffer_desc.ByteWidth = sizeof(indices);
+            buffer_desc.ByteWidth = (UINT)cube_file.header->index_size;
             buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 
             D3D11_SUBRESOURCE_DATA subresource_data = {};
-            subresource_data.pSysMem = indices;
+            subresource_data.pSysMem = mesh_file_indices(&cube_file);
 
             HRESULT result = device->CreateBuffer(&buffer_desc, &subresource_data, &index_buffer);
             if (FAILED(result))
             {
                 OutputDebugString(L"Failed to create index buffer");
+                mesh_file_close(&cube_file);
                 return GetLastError();
             }
         }
+        mesh_file_close(&cube_file);
     }
 
     // create vertex and pixel shaders
-    ID3DBlob *vertex_shader_blob = nullptr;
+    std::vector<uint8_t> vertex_shader_code;
     ID3D11VertexShader *vertex_shader = nullptr;
     ID3D11PixelShader *pixel_shader = nullptr;
     {
@@ -245,58 +381,48 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
             }
         )";
 
-        // compile vertex shader
+        // compile through the shader cache in build/shader_cache, later runs read the bytecode
+        // from disk instead of calling D3DCompile and the misses compile in parallel
+        std::vector<uint8_t> pixel_shader_code;
         {
-            ID3DBlob *error_blob = nullptr;
-            HRESULT result = D3DCompile(
-                shader_src,
-                sizeof(shader_src),
-                nullptr,
-                nullptr,
-                nullptr,
-                "vs_main",
-                "vs_5_0",
-                0,
-                0,
-                &vertex_shader_blob,
-                &error_blob);
-            if (FAILED(result))
+            shader_desc shader_descs[] = {
+                {"shader_src", shader_src, sizeof(shader_src), "vs_main", "vs_5_0", nullptr, 0},
+                {"shader_src", shader_src, sizeof(shader_src), "ps_main", "ps_5_0", nullptr, 0},
+            };
+            std::vector<uint8_t> *shader_code[] = {&vertex_shader_code, &pixel_shader_code};
+            const wchar_t *shader_errors[] = {L"Failed to compile vertex shader", L"Failed to compile pixel shader"};
+            shader_result shader_results[ARRAYSIZE(shader_descs)];
+
+            shader_cache cache;
+            shader_cache_init(&cache, "shader_cache", shader_compiler_d3d());
+            thread_pool pool;
+            thread_pool_init(&pool, (int)ARRAYSIZE(shader_descs));
+            shader_cache_compile_many(&cache, shader_descs, (int)ARRAYSIZE(shader_descs), shader_results, &pool);
+            thread_pool_shutdown(&pool);
+
+            for (int i = 0; i < (int)ARRAYSIZE(shader_descs); ++i)
             {
-                OutputDebugString(L"Failed to compile vertex shader");
-                OutputDebugStringA((char *)error_blob->GetBufferPointer());
-                return GetLastError();
+                if (shader_results[i].ok == false)
+                {
+                    OutputDebugString(shader_errors[i]);
+                    OutputDebugStringA(shader_results[i].errors.c_str());
+                    return GetLastError();
+                }
+                shader_code[i]->swap(shader_results[i].bytecode);
             }
-        }
 
-        // compile pixel shader
-        ID3DBlob *pixel_shader_blob = nullptr;
-        {
-            ID3DBlob *error_blob = nullptr;
-            HRESULT result = D3DCompile(
-                shader_src,
-                sizeof(shader_src),
-                nullptr,
-                nullptr,
-                nullptr,
-                "ps_main",
-                "ps_5_0",
-                0,
-                0,
-                &pixel_shader_blob,
-                &error_blob);
-            if (FAILED(result))
-            {
-                OutputDebugString(L"Failed to compile pixel shader");
-                OutputDebugStringA((char *)error_blob->GetBufferPointer());
-                return GetLastError();
-            }
+            shader_cache_stats stats = shader_cache_get_stats(&cache);
+            char message[128];
+            snprintf(message, sizeof(message), "shader cache: %llu of %llu from cache, %.2f ms saved\n",
+                (unsigned long long)(stats.memory_hits + stats.disk_hits), (unsigned long long)stats.lookups, stats.saved_seconds * 1000.0);
+            OutputDebugStringA(message);
         }
 
         // create vertex shader
         {
             HRESULT result = device->CreateVertexShader(
-                vertex_shader_blob->GetBufferPointer(),
-                vertex_shader_blob->GetBufferSize(),
+                vertex_shader_code.data(),
+                vertex_shader_code.size(),
                 nullptr,
                 &vertex_shader);
             if (FAILED(result))
@@ -309,8 +435,8 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         // create pixel shader
         {
             HRESULT result = device->CreatePixelShader(
-                pixel_shader_blob->GetBufferPointer(),
-                pixel_shader_blob->GetBufferSize(),
+                pixel_shader_code.data(),
+                pixel_shader_code.size(),
                 nullptr,
                 &pixel_shader);
             if (FAILED(result))
@@ -318,28 +444,25 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
                 OutputDebugString(L"Failed to create pixel shader");
                 return GetLastError();
             }
-            pixel_shader_blob->Release();
         }
     }
 
     // create input layout
     ID3D11InputLayout *input_layout = nullptr;
     {
-        D3D11_INPUT_ELEMENT_DESC input_element_desc[] = {
-            {"Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0}
-        };
+        // the elements the encoder wrote, snorm16 positions read as float3
+        D3D11_INPUT_ELEMENT_DESC input_element_desc[MESH_MAX_ELEMENTS];
 
         HRESULT result = device->CreateInputLayout(
             input_element_desc,
-            ARRAYSIZE(input_element_desc),
-            vertex_shader_blob->GetBufferPointer(),
-            vertex_shader_blob->GetBufferSize(), &input_layout);
+            mesh_input_element_descs(cube_elements, cube_element_count, input_element_desc),
+            vertex_shader_code.data(),
+            vertex_shader_code.size(), &input_layout);
         if (FAILED(result))
         {
             OutputDebugString(L"Failed to create input layout");
             return GetLastError();
         }
-        vertex_shader_blob->Release();
     }
 
     // create viewport
@@ -351,14 +474,16 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         viewport.MaxDepth = 1.0f;
     }
 
-    // create dynamic transform and static colors constant buffers
+    // create transform constant ring and static colors constant buffers
     ID3D11Buffer *transform_cbuffer = nullptr;
     ID3D11Buffer *colors_cbuffer = nullptr;
+    d3d11_ring_backend ring_backend = {};
+    cbuffer_ring transform_ring;
     {
-        // create transform buffer, dynamic as we will update it every frame
+        // create transform ring, one dynamic buffer that every draw sub-allocates from
         {
             D3D11_BUFFER_DESC buffer_desc = {};
-            buffer_desc.ByteWidth = sizeof(DirectX::XMMATRIX);
+            buffer_desc.ByteWidth = 1024 * 1024;
             buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
             buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
             buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
@@ -369,6 +494,31 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
                 OutputDebugString(L"Failed to create transform constant buffer");
                 return GetLastError();
             }
+
+            // one event query per fence slot
+            D3D11_QUERY_DESC query_desc = {};
+            query_desc.Query = D3D11_QUERY_EVENT;
+            for (size_t i = 0; i < ARRAYSIZE(ring_backend.queries); ++i)
+            {
+                result = device->CreateQuery(&query_desc, &ring_backend.queries[i]);
+                if (FAILED(result))
+                {
+                    OutputDebugString(L"Failed to create fence query");
+                    return GetLastError();
+                }
+            }
+
+            ring_backend.context = context1;
+            ring_backend.buffer = transform_cbuffer;
+
+            cbuffer_ring_backend backend = {};
+            backend.user = &ring_backend;
+            backend.signal_fence = d3d11_ring_signal_fence;
+            backend.completed_fence = d3d11_ring_completed_fence;
+            backend.wait_fence = d3d11_ring_wait_fence;
+            backend.map = d3d11_ring_map;
+            backend.unmap = d3d11_ring_unmap;
+            cbuffer_ring_init(&transform_ring, buffer_desc.ByteWidth, &backend);
         }
         // create colors buffer, static we won't update it every frame
         {
@@ -414,106 +564,251 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
     }
 
     // create projection matrix
-    DirectX::XMMATRIX proj = DirectX::XMMatrixPerspectiveFovLH(
-        DirectX::XMConvertToRadians(60.0f),
+    mat4 proj = mat4_perspective_fov_lh(
+        simd_radians(60.0f),
         viewport.Width / viewport.Height,
         0.1f,
         100.0f);
 
-    // msg loop
-    float angle = 0.0f;
-    bool running = true;
-    while (running)
+    // every bind in the frame loop goes through the state cache, which drops the redundant ones
+    state_cache_d3d state_backend = {context, context1};
+    state_cache state;
     {
-        MSG msg = {};
-        PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE);
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+        state_cache_backend backend = state_cache_backend_d3d(&state_backend);
+        state_cache_init(&state, &backend);
+    }
 
-        switch (msg.message)
+    // the frame is recorded into command buffers on the pool and replayed in order on the
+    // render thread
+    thread_pool record_pool;
+    thread_pool_init(&record_pool, 2);
+    command_buffer cube_buffers[2];
+    for (size_t i = 0; i < ARRAYSIZE(cube_buffers); ++i)
+        command_buffer_init(&cube_buffers[i]);
+    command_buffer_ring transform_constants_ring = {&transform_ring, transform_cbuffer};
+    command_buffer_constants transform_constants = command_buffer_constants_ring(&transform_constants_ring);
+
+    // the window thread only pumps messages and forwards input, the simulation steps at a fixed
+    // rate on its own thread and publishes snapshots, the render thread draws the newest one.
+    // a vsync stall in Present only ever holds up rendering.
+    cube_input_queue *input_queue = new cube_input_queue;
+    spsc_queue_init(input_queue);
+    frame_handoff handoff;
+    frame_handoff_init(&handoff);
+    cube_snapshot snapshots[FRAME_HANDOFF_SLOTS] = {};
+    std::atomic<bool> quit(false);
+
+    // the render thread times its phases every frame, F2 dumps the recent frames and the
+    // totals so far, exit dumps them again
+    enum render_phase
+    {
+        RENDER_PHASE_SNAPSHOT,
+        RENDER_PHASE_RECORD,
+        RENDER_PHASE_SUBMIT,
+        RENDER_PHASE_PRESENT,
+        RENDER_PHASE_COUNT
+    };
+    static const char *render_phase_names[RENDER_PHASE_COUNT] = {"snapshot", "record", "submit", "present"};
+    frame_timing timing;
+    frame_timing_init(&timing, RENDER_PHASE_COUNT, render_phase_names);
+    std::atomic<bool> dump_timing(false);
+
+    // the render thread hands window titles to this one, SetWindowText waits on the window thread
+    std::mutex title_mutex;
+    char title_text[192] = {};
+
+    std::thread sim_thread([&] {
+        PROFILE_THREAD_NAME("simulation");
+        fixed_timestep ts;
+        fixed_timestep_init(&ts, CUBE_SIM_STEP, frame_handoff_now());
+        float angle = 0.0f;
+        float previous_angle = 0.0f;
+        bool spinning = true;
+        while (quit.load() == false)
         {
-            case WM_QUIT:
-                running = false;
-                break;
-        }
-
-        // clear frame using red color
-        float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
-        context->ClearRenderTargetView(render_target_view, clear_color);
-        context->ClearDepthStencilView(depth_stencil_view, D3D11_CLEAR_DEPTH, 1.0f, 1);
-
-        // set layout and primitive
-        context->IASetInputLayout(input_layout);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-        // set vertex and index buffer
-        UINT stride = 3 * sizeof(float);
-        UINT offset = 0;
-        context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
-        context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+            uint32_t steps = fixed_timestep_advance(&ts, frame_handoff_now());
+            for (uint32_t i = 0; i < steps; ++i)
+            {
+                // space pauses and resumes the spin
+                uint32_t key;
+                while (spsc_queue_pop(input_queue, &key))
+                {
+                    if (key == VK_SPACE)
+                        spinning = !spinning;
+                }
+
+                previous_angle = angle;
+                if (spinning)
+                    angle += (float)CUBE_SIM_STEP;
+            }
 
-        // set vertex and pixel shaders
-        context->VSSetShader(vertex_shader, nullptr, 0);
-        context->PSSetShader(pixel_shader, nullptr, 0);
+            if (steps)
+            {
+                cube_snapshot *snapshot = &snapshots[frame_handoff_write_slot(&handoff)];
+                snapshot->state_time = fixed_timestep_state_time(&ts);
+                snapshot->previous_angle = previous_angle;
+                snapshot->angle = angle;
+                frame_handoff_publish(&handoff);
+            }
 
-        // set constant buffers
-        context->VSSetConstantBuffers(0, 1, &transform_cbuffer);
-        context->PSSetConstantBuffers(0, 1, &colors_cbuffer);
+            double wait = fixed_timestep_next_time(&ts) - frame_handoff_now();
+            if (wait > 0.0)
+                Sleep((DWORD)(wait * 1000.0));
+        }
+    });
 
-        // set viewport
-        context->RSSetViewports(1, &viewport);
+    std::thread render_thread([&] {
+        PROFILE_THREAD_NAME("render");
+        while (quit.load() == false)
+        {
+            frame_timing_begin_frame(&timing);
+
+            // clear frame using red color
+            float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+            context->ClearRenderTargetView(render_target_view, clear_color);
+            context->ClearDepthStencilView(depth_stencil_view, D3D11_CLEAR_DEPTH, 1.0f, 1);
+
+            // interpolate between the last two simulation steps, rendering a step behind
+            frame_handoff_acquire(&handoff);
+            const cube_snapshot *snapshot = &snapshots[frame_handoff_read_slot(&handoff)];
+            float alpha = fixed_timestep_alpha(snapshot->state_time, frame_handoff_now(), CUBE_SIM_STEP);
+            float angle = snapshot->previous_angle + (snapshot->angle - snapshot->previous_angle) * alpha;
+            frame_timing_mark(&timing, RENDER_PHASE_SNAPSHOT);
+
+            // record each cube into its own command buffer on the pool, both bind everything they
+            // need and the state cache drops what the first one already bound
+            float cube_angles[ARRAYSIZE(cube_buffers)] = {angle, angle / 2.0f};
+            thread_pool_parallel_for(&record_pool, (int)ARRAYSIZE(cube_buffers), [&](int i) {
+                PROFILE_ZONE("record cube");
+                command_buffer *cb = &cube_buffers[i];
+                command_buffer_reset(cb);
+
+                // set layout and primitive
+                command_buffer_ia_set_input_layout(cb, input_layout);
+                command_buffer_ia_set_primitive_topology(cb, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+                // set vertex and index buffer
+                UINT stride = cube_stride;
+                UINT offset = 0;
+                command_buffer_ia_set_vertex_buffer(cb, 0, vertex_buffer, stride, offset);
+                command_buffer_ia_set_index_buffer(cb, index_buffer, cube_index_format, 0);
+
+                // set vertex and pixel shaders
+                command_buffer_vs_set_shader(cb, vertex_shader);
+                command_buffer_ps_set_shader(cb, pixel_shader);
+
+                // set colors constant buffer
+                command_buffer_ps_set_constant_buffer(cb, 0, colors_cbuffer);
+
+                // set viewport
+                command_buffer_rs_set_viewports(cb, 1, (const state_cache_viewport *)&viewport);
+
+                // set render target and depth stencil
+                command_buffer_om_set_render_target(cb, 0, render_target_view);
+                command_buffer_om_set_depth_stencil_view(cb, depth_stencil_view);
+                command_buffer_om_set_depth_stencil_state(cb, depth_stencil_state, 1);
+
+                // the transform goes into the buffer inline and into the ring on replay, the
+                // dequantize matrix brings the snorm16 positions back to the cube's size
+                float cube_angle = cube_angles[i];
+                mat4 mvp = mat4_transpose(
+                    cube_dequantize *
+                    mat4_rotation_x(cube_angle) *
+                    mat4_rotation_y(cube_angle) *
+                    mat4_rotation_z(cube_angle) *
+                    mat4_translation(0.0f, 0.0f, 5.0f) *
+                    proj
+                );
+                command_buffer_vs_set_constants(cb, 0, &mvp, (uint32_t)sizeof(mvp));
+
+                // draw cube
+                command_buffer_draw_indexed(cb, cube_index_count, 0, 0);
+            });
+            frame_timing_mark(&timing, RENDER_PHASE_RECORD);
+
+            // replay in recording order, transforms are written into the ring and bound as ranges
+            cbuffer_ring_begin_frame(&transform_ring);
+            for (size_t i = 0; i < ARRAYSIZE(cube_buffers); ++i)
+                command_buffer_execute(&cube_buffers[i], &state, &transform_constants);
+
+            cbuffer_ring_end_frame(&transform_ring);
+            state_cache_end_frame(&state);
+
+            // show ring usage and state calls every 60 frames
+            if (transform_ring.stats.frames % 60 == 0)
+            {
+                char title[192];
+                snprintf(title, sizeof(title), "example cubes - constant ring %llu bytes/frame, %llu wraps, %llu stalls, state %llu/%llu calls issued",
+                    (unsigned long long)transform_ring.stats.last_frame_bytes,
+                    (unsigned long long)transform_ring.stats.wraps,
+                    (unsigned long long)transform_ring.stats.stalls,
+                    (unsigned long long)state.last_frame.issued_calls,
+                    (unsigned long long)state.last_frame.set_calls);
+                std::lock_guard<std::mutex> lock(title_mutex);
+                memcpy(title_text, title, sizeof(title));
+                PostMessage(hwnd, WM_APP, 0, 0);
+            }
 
-        // set render target and viewport
-        context->OMSetRenderTargets(1, &render_target_view, depth_stencil_view);
+            frame_timing_mark(&timing, RENDER_PHASE_SUBMIT);
 
-        // set depth stencil state
-        context->OMSetDepthStencilState(depth_stencil_state, 1);
+            swapchain->Present(1, 0);
+            frame_timing_mark(&timing, RENDER_PHASE_PRESENT);
+            frame_timing_end_frame(&timing);
 
-        // update first cube transform constant buffer
-        {
-            angle += (1.0f / 60.0f);
-            DirectX::XMMATRIX mvp = DirectX::XMMatrixTranspose(
-                DirectX::XMMatrixRotationX(angle) *
-                DirectX::XMMatrixRotationY(angle) *
-                DirectX::XMMatrixRotationZ(angle) *
-                DirectX::XMMatrixTranslation(0.0f, 0.0f, 5.0f) *
-                proj
-            );
-
-            D3D11_MAPPED_SUBRESOURCE mapped_subresource = {};
-            context->Map(transform_cbuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
-            memcpy(mapped_subresource.pData, &mvp, sizeof(mvp));
-            context->Unmap(transform_cbuffer, 0);
+            if (dump_timing.exchange(false))
+            {
+                frame_timing_write_csv(&timing, "example_cubes_timing.csv");
+                frame_timing_write_json(&timing, "example_cubes_timing.json");
+            }
         }
+    });
 
-        // draw first cube
-        context->DrawIndexed(36, 0, 0);
-
-        // update second cube transform constant buffer
+    // msg loop, GetMessage returns 0 on WM_QUIT
+    MSG msg = {};
+    while (GetMessage(&msg, nullptr, 0, 0) > 0)
+    {
+        switch (msg.message)
         {
-            DirectX::XMMATRIX mvp = DirectX::XMMatrixTranspose(
-                DirectX::XMMatrixRotationX(angle / 2.0f) *
-                DirectX::XMMatrixRotationY(angle / 2.0f) *
-                DirectX::XMMatrixRotationZ(angle / 2.0f) *
-                DirectX::XMMatrixTranslation(0.0f, 0.0f, 5.0f) *
-                proj
-            );
-
-            D3D11_MAPPED_SUBRESOURCE mapped_subresource = {};
-            context->Map(transform_cbuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
-            memcpy(mapped_subresource.pData, &mvp, sizeof(mvp));
-            context->Unmap(transform_cbuffer, 0);
+            case WM_KEYDOWN:
+                if (msg.wParam == VK_F2)
+                    dump_timing.store(true);
+                else
+                    spsc_queue_push(input_queue, (uint32_t)msg.wParam);
+                break;
+            case WM_APP:
+            {
+                std::lock_guard<std::mutex> lock(title_mutex);
+                SetWindowTextA(hwnd, title_text);
+                break;
+            }
         }
 
-        // draw second cube
-        context->DrawIndexed(36, 0, 0);
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
 
-        swapchain->Present(1, 0);
+    quit.store(true);
+    render_thread.join();
+    sim_thread.join();
+    delete input_queue;
+
+    if (frame_timing_write_csv(&timing, "example_cubes_timing.csv") == false ||
+        frame_timing_write_json(&timing, "example_cubes_timing.json") == false)
+    {
+        OutputDebugString(L"Failed to write frame timing");
     }
+    frame_timing_free(&timing);
+    PROFILE_WRITE_TRACE("example_cubes_trace.json");
+
+    for (size_t i = 0; i < ARRAYSIZE(cube_buffers); ++i)
+        command_buffer_free(&cube_buffers[i]);
+    thread_pool_shutdown(&record_pool);
 
     // release resources
     depth_stencil_state->Release();
     colors_cbuffer->Release();
+    for (size_t i = 0; i < ARRAYSIZE(ring_backend.queries); ++i)
+        ring_backend.queries[i]->Release();
     transform_cbuffer->Release();
     input_layout->Release();
     pixel_shader->Release();
@@ -522,6 +817,7 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
     vertex_buffer->Release();
     depth_stencil_view->Release();
     render_target_view->Release();
+    context1->Release();
     context->Release();
     device->Release();
     swapchain->Release();
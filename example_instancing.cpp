@@ -0,0 +1,799 @@
+#pragma comment(lib, "user32.lib")
+#pragma comment(lib, "D3D11.lib")
+#pragma comment(lib, "d3dcompiler.lib")
+
+#define WIN32_LEAN_AND_MEAN
+#define UNICODE
+#include <Windows.h>
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+#if defined(min)
+#undef min
+#endif
+
+#if defined(max)
+#undef max
+#endif
+
+#include <stdio.h>
+
+#include "frustum_cull.h"
+#include "shader_cache_d3d.h"
+#include "state_cache_d3d.h"
+#include "simd_math.h"
+
+// matches the Transform cbuffer, padded to a multiple of 16 bytes
+struct transform_constants
+{
+    mat4 mvp;
+    unsigned int color;
+    unsigned int pad[3];
+};
+
+LRESULT CALLBACK
+window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    switch (msg)
+    {
+        case WM_CLOSE:
+        case WM_DESTROY:
+            PostQuitMessage(0);
+            return 0;
+        default:
+            return DefWindowProc(hwnd, msg, wparam, lparam);
+            break;
+    }
+}
+
+int
+WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdShow)
+{
+    // register window class
+    {
+        WNDCLASSEX wnd_class = {};
+        wnd_class.cbSize = sizeof(wnd_class);
+        wnd_class.hCursor = LoadCursor(nullptr, IDC_ARROW);
+        wnd_class.lpfnWndProc = window_proc;
+        wnd_class.hInstance = hInstance;
+        wnd_class.lpszClassName = L"dx11_wnd_class";
+
+        if (RegisterClassEx(&wnd_class) == 0)
+        {
+            OutputDebugString(L"Failed to register window class");
+            return GetLastError();
+        }
+    }
+
+    // create window
+    HWND hwnd = CreateWindowEx(
+        0,
+        L"dx11_wnd_class",
+        L"example instancing",
+        WS_OVERLAPPEDWINDOW | WS_VISIBLE,
+        CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
+        nullptr,
+        nullptr,
+        nullptr,
+        nullptr
+    );
+    if (hwnd == nullptr)
+    {
+        OutputDebugString(L"Failed to create window");
+        return GetLastError();
+    }
+
+    // get window width and height
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    int window_width = rect.right - rect.left;
+    int window_height = rect.bottom - rect.top;
+
+    // create dx11 swapchain, device, and immediate context
+    IDXGISwapChain *swapchain = nullptr;
+    ID3D11Device *device = nullptr;
+    ID3D11DeviceContext *context = nullptr;
+    {
+        D3D_FEATURE_LEVEL feature_levels_requested[] = {
+            D3D_FEATURE_LEVEL_11_1,
+            D3D_FEATURE_LEVEL_11_0,
+        };
+        DXGI_SWAP_CHAIN_DESC swapchain_desc = {};
+        swapchain_desc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        swapchain_desc.SampleDesc.Count = 1;
+        swapchain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        swapchain_desc.BufferCount = 2;
+        swapchain_desc.OutputWindow = hwnd;
+        swapchain_desc.Windowed = TRUE;
+        swapchain_desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        HRESULT result = D3D11CreateDeviceAndSwapChain(
+            nullptr,
+            D3D_DRIVER_TYPE_HARDWARE,
+            nullptr,
+            D3D11_CREATE_DEVICE_DEBUG,
+            feature_levels_requested,
+            ARRAYSIZE(feature_levels_requested),
+            D3D11_SDK_VERSION,
+            &swapchain_desc,
+            &swapchain,
+            &device,
+            nullptr,
+            &context
+        );
+        if (FAILED(result))
+        {
+            OutputDebugString(L"Failed to create device and swapchain");
+            return GetLastError();
+        }
+    }
+
+    // create render target view
+    ID3D11RenderTargetView *render_target_view = nullptr;
+    {
+        ID3D11Texture2D *back_buffer;
+        swapchain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void **)&back_buffer);
+
+        device->CreateRenderTargetView(back_buffer, nullptr, &render_target_view);
+
+        back_buffer->Release();
+    }
+
+    // create depth target view
+    ID3D11DepthStencilView *depth_stencil_view = nullptr;
+    {
+        // create depth stencil texture
+        ID3D11Texture2D *depth_stencil;
+        {
+            D3D11_TEXTURE2D_DESC texture_desc = {};
+            texture_desc.Width = window_width;
+            texture_desc.Height = window_height;
+            texture_desc.MipLevels = 1;
+            texture_desc.ArraySize = 1;
+            texture_desc.Format = DXGI_FORMAT_D32_FLOAT;
+            texture_desc.SampleDesc.Count = 1;
+            texture_desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+            HRESULT result = device->CreateTexture2D(&texture_desc, nullptr, &depth_stencil);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create device and swapchain");
+                return GetLastError();
+            }
+        }
+
+        // create depth stencil view
+        {
+            D3D11_DEPTH_STENCIL_VIEW_DESC view_desc = {};
+            view_desc.Format = DXGI_FORMAT_D32_FLOAT;
+            view_desc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+            device->CreateDepthStencilView(depth_stencil, &view_desc, &depth_stencil_view);
+        }
+
+        depth_stencil->Release();
+    }
+
+    // create vertiex and index buffers
+    ID3D11Buffer *vertex_buffer = nullptr;
+    ID3D11Buffer *index_buffer = nullptr;
+    {
+        // vertex buffer
+        {
+            float vertices[] = {
+                // position
+                -1.0f, -1.0f, -1.0f,
+                 1.0f, -1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+                 1.0f,  1.0f, -1.0f,
+                -1.0f, -1.0f,  1.0f,
+                 1.0f, -1.0f,  1.0f,
+                -1.0f,  1.0f,  1.0f,
+                 1.0f,  1.0f,  1.0f
+            };
+
+            D3D11_BUFFER_DESC buffer_desc = {};
+            buffer_desc.ByteWidth = sizeof(vertices);
+            buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+            buffer_desc.StructureByteStride = 3 * sizeof(float);
+
+            D3D11_SUBRESOURCE_DATA subresource_data = {};
+            subresource_data.pSysMem = vertices;
+
+            HRESULT result = device->CreateBuffer(&buffer_desc, &subresource_data, &vertex_buffer);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create vertex buffer");
+                return GetLastError();
+            }
+        }
+        // index buffer
+        {
+            unsigned int indices[] = {
+                // clockwise
+                0, 2, 3,  0, 3, 1,
+                1, 3, 7,  1, 7, 5,
+                5, 7, 6,  5, 6, 4,
+                4, 6, 2,  4, 2, 0,
+                2, 6, 7,  2, 7, 3,
+                0, 1, 5,  0, 5, 4
+            };
+
+            D3D11_BUFFER_DESC buffer_desc = {};
+            buffer_desc.ByteWidth = sizeof(indices);
+            buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+            D3D11_SUBRESOURCE_DATA subresource_data = {};
+            subresource_data.pSysMem = indices;
+
+            HRESULT result = device->CreateBuffer(&buffer_desc, &subresource_data, &index_buffer);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create index buffer");
+                return GetLastError();
+            }
+        }
+    }
+
+    // cube transforms and colors, transforms are rebuilt every frame
+    const int cube_count = 100000;
+    float *speeds = (float *)malloc(cube_count * sizeof(float));
+    float *angles = (float *)malloc(cube_count * sizeof(float));
+    float *positions_x = (float *)malloc(cube_count * sizeof(float));
+    float *positions_y = (float *)malloc(cube_count * sizeof(float));
+    float *positions_z = (float *)malloc(cube_count * sizeof(float));
+    unsigned int *cube_colors = (unsigned int *)malloc(cube_count * sizeof(unsigned int));
+    float *transforms = (float *)malloc(cube_count * 16 * sizeof(float));
+    unsigned int *visible_colors = (unsigned int *)malloc(cube_count * sizeof(unsigned int));
+    uint32_t *visible = (uint32_t *)malloc(cube_count * sizeof(uint32_t));
+    mat4_soa world;
+    frustum_bounds cube_bounds;
+    {
+        // 100 x 100 x 10 grid, every cube spins at its own speed
+        for (int i = 0; i < cube_count; ++i)
+        {
+            speeds[i] = 0.5f + (float)(i % 7) * 0.25f;
+            positions_x[i] = ((float)(i % 100) - 49.5f) * 4.0f;
+            positions_y[i] = ((float)((i / 100) % 100) - 49.5f) * 4.0f;
+            positions_z[i] = 250.0f + (float)(i / 10000) * 4.0f;
+            cube_colors[i] = i % 6;
+        }
+
+        if (mat4_soa_init(&world, cube_count) == false)
+        {
+            OutputDebugString(L"Failed to allocate cube transforms");
+            return 1;
+        }
+
+        // cubes spin in place, a sphere of radius sqrt(3) around the position bounds them
+        if (frustum_bounds_init(&cube_bounds, cube_count, FRUSTUM_SPHERE_STREAMS) == false)
+        {
+            OutputDebugString(L"Failed to allocate cube bounds");
+            return 1;
+        }
+        for (int i = 0; i < cube_count; ++i)
+            frustum_bounds_set_sphere(&cube_bounds, i, positions_x[i], positions_y[i], positions_z[i], sqrtf(3.0f));
+    }
+
+    // create per instance transform and color buffers
+    ID3D11Buffer *instance_transform_buffer = nullptr;
+    ID3D11Buffer *instance_color_buffer = nullptr;
+    {
+        // transforms, dynamic as we will update them every frame
+        {
+            D3D11_BUFFER_DESC buffer_desc = {};
+            buffer_desc.ByteWidth = (UINT)(cube_count * 16 * sizeof(float));
+            buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+            buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+            buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            buffer_desc.StructureByteStride = 16 * sizeof(float);
+
+            HRESULT result = device->CreateBuffer(&buffer_desc, nullptr, &instance_transform_buffer);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create instance transform buffer");
+                return GetLastError();
+            }
+        }
+        // colors, dynamic too as the visible cubes are packed to the front every frame
+        {
+            D3D11_BUFFER_DESC buffer_desc = {};
+            buffer_desc.ByteWidth = (UINT)(cube_count * sizeof(unsigned int));
+            buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+            buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+            buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            buffer_desc.StructureByteStride = sizeof(unsigned int);
+
+            HRESULT result = device->CreateBuffer(&buffer_desc, nullptr, &instance_color_buffer);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create instance color buffer");
+                return GetLastError();
+            }
+        }
+    }
+
+    // create vertex and pixel shaders
+    std::vector<uint8_t> vertex_shader_code;
+    std::vector<uint8_t> instanced_vertex_shader_code;
+    ID3D11VertexShader *vertex_shader = nullptr;
+    ID3D11VertexShader *instanced_vertex_shader = nullptr;
+    ID3D11PixelShader *pixel_shader = nullptr;
+    {
+        const char shader_src[] = R"(
+            cbuffer Transform
+            {
+                float4x4 mvp;
+                uint color;
+            };
+
+            struct VS_Out
+            {
+                nointerpolation uint color : Color;
+                float4 position : SV_Position;
+            };
+
+            VS_Out vs_main(float3 position : Position)
+            {
+                VS_Out output;
+                output.position = mul(float4(position, 1.0), mvp);
+                output.color = color;
+                return output;
+            }
+
+            // per instance transform rows are stored transposed, same as the cbuffer
+            VS_Out vs_instanced(
+                float3 position : Position,
+                float4 mvp0 : Transform0,
+                float4 mvp1 : Transform1,
+                float4 mvp2 : Transform2,
+                float4 mvp3 : Transform3,
+                uint instance_color : Color)
+            {
+                float4 p = float4(position, 1.0);
+                VS_Out output;
+                output.position = float4(dot(p, mvp0), dot(p, mvp1), dot(p, mvp2), dot(p, mvp3));
+                output.color = instance_color;
+                return output;
+            }
+
+            cbuffer Colors
+            {
+                float4 colors[6];
+            };
+
+            float4 ps_main(VS_Out input, uint id: SV_PrimitiveID) : SV_Target
+            {
+                return colors[(id / 2 + input.color) % 6];
+            }
+        )";
+
+        // compile through the shader cache in build/shader_cache, later runs read the bytecode
+        // from disk instead of calling D3DCompile and the misses compile in parallel
+        std::vector<uint8_t> pixel_shader_code;
+        {
+            shader_desc shader_descs[] = {
+                {"shader_src", shader_src, sizeof(shader_src), "vs_main", "vs_5_0", nullptr, 0},
+                {"shader_src", shader_src, sizeof(shader_src), "vs_instanced", "vs_5_0", nullptr, 0},
+                {"shader_src", shader_src, sizeof(shader_src), "ps_main", "ps_5_0", nullptr, 0},
+            };
+            std::vector<uint8_t> *shader_code[] = {&vertex_shader_code, &instanced_vertex_shader_code, &pixel_shader_code};
+            const wchar_t *shader_errors[] = {L"Failed to compile vertex shader", L"Failed to compile instanced vertex shader", L"Failed to compile pixel shader"};
+            shader_result shader_results[ARRAYSIZE(shader_descs)];
+
+            shader_cache cache;
+            shader_cache_init(&cache, "shader_cache", shader_compiler_d3d());
+            thread_pool pool;
+            thread_pool_init(&pool, (int)ARRAYSIZE(shader_descs));
+            shader_cache_compile_many(&cache, shader_descs, (int)ARRAYSIZE(shader_descs), shader_results, &pool);
+            thread_pool_shutdown(&pool);
+
+            for (int i = 0; i < (int)ARRAYSIZE(shader_descs); ++i)
+            {
+                if (shader_results[i].ok == false)
+                {
+                    OutputDebugString(shader_errors[i]);
+                    OutputDebugStringA(shader_results[i].errors.c_str());
+                    return GetLastError();
+                }
+                shader_code[i]->swap(shader_results[i].bytecode);
+            }
+
+            shader_cache_stats stats = shader_cache_get_stats(&cache);
+            char message[128];
+            snprintf(message, sizeof(message), "shader cache: %llu of %llu from cache, %.2f ms saved\n",
+                (unsigned long long)(stats.memory_hits + stats.disk_hits), (unsigned long long)stats.lookups, stats.saved_seconds * 1000.0);
+            OutputDebugStringA(message);
+        }
+
+        // create vertex shader
+        {
+            HRESULT result = device->CreateVertexShader(
+                vertex_shader_code.data(),
+                vertex_shader_code.size(),
+                nullptr,
+                &vertex_shader);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create vertex shader");
+                return GetLastError();
+            }
+        }
+
+        // create instanced vertex shader
+        {
+            HRESULT result = device->CreateVertexShader(
+                instanced_vertex_shader_code.data(),
+                instanced_vertex_shader_code.size(),
+                nullptr,
+                &instanced_vertex_shader);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create instanced vertex shader");
+                return GetLastError();
+            }
+        }
+
+        // create pixel shader
+        {
+            HRESULT result = device->CreatePixelShader(
+                pixel_shader_code.data(),
+                pixel_shader_code.size(),
+                nullptr,
+                &pixel_shader);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create pixel shader");
+                return GetLastError();
+            }
+        }
+    }
+
+    // create input layouts
+    ID3D11InputLayout *input_layout = nullptr;
+    ID3D11InputLayout *instanced_input_layout = nullptr;
+    {
+        // one position per vertex
+        {
+            D3D11_INPUT_ELEMENT_DESC input_element_desc[] = {
+                {"Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0}
+            };
+
+            HRESULT result = device->CreateInputLayout(
+                input_element_desc,
+                ARRAYSIZE(input_element_desc),
+                vertex_shader_code.data(),
+                vertex_shader_code.size(), &input_layout);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create input layout");
+                return GetLastError();
+            }
+        }
+
+        // positions from slot 0, transform rows from slot 1 and colors from slot 2 advance once per instance
+        {
+            D3D11_INPUT_ELEMENT_DESC input_element_desc[] = {
+                {"Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+                {"Transform", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+                {"Transform", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+                {"Transform", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+                {"Transform", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+                {"Color", 0, DXGI_FORMAT_R32_UINT, 2, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+            };
+
+            HRESULT result = device->CreateInputLayout(
+                input_element_desc,
+                ARRAYSIZE(input_element_desc),
+                instanced_vertex_shader_code.data(),
+                instanced_vertex_shader_code.size(), &instanced_input_layout);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create instanced input layout");
+                return GetLastError();
+            }
+        }
+    }
+
+    // create viewport
+    D3D11_VIEWPORT viewport = {};
+    {
+        viewport.Width = (float)window_width;
+        viewport.Height = (float)window_height;
+        viewport.MinDepth = 0.0f;
+        viewport.MaxDepth = 1.0f;
+    }
+
+    // create dynamic transform and static colors constant buffers
+    ID3D11Buffer *transform_cbuffer = nullptr;
+    ID3D11Buffer *colors_cbuffer = nullptr;
+    {
+        // create transform buffer, dynamic as we will update it every draw
+        {
+            D3D11_BUFFER_DESC buffer_desc = {};
+            buffer_desc.ByteWidth = sizeof(transform_constants);
+            buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+            buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+            buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+            HRESULT result = device->CreateBuffer(&buffer_desc, nullptr, &transform_cbuffer);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create transform constant buffer");
+                return GetLastError();
+            }
+        }
+        // create colors buffer, static we won't update it every frame
+        {
+            float colors[] = {
+                1.0f, 0.0f, 0.0f, 1.0f,
+                0.0f, 1.0f, 0.0f, 1.0f,
+                0.0f, 0.0f, 1.0f, 1.0f,
+                1.0f, 1.0f, 0.0f, 1.0f,
+                0.0f, 1.0f, 1.0f, 1.0f,
+                1.0f, 0.0f, 1.0f, 1.0f
+            };
+
+            D3D11_BUFFER_DESC buffer_desc = {};
+            buffer_desc.ByteWidth = sizeof(colors);
+            buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+            D3D11_SUBRESOURCE_DATA subresource_data = {};
+            subresource_data.pSysMem = colors;
+
+            HRESULT result = device->CreateBuffer(&buffer_desc, &subresource_data, &colors_cbuffer);
+            if (FAILED(result))
+            {
+                OutputDebugString(L"Failed to create colors constant buffer");
+                return GetLastError();
+            }
+        }
+    }
+
+    // create depth stencil state
+    ID3D11DepthStencilState *depth_stencil_state = nullptr;
+    {
+        D3D11_DEPTH_STENCIL_DESC depth_stencil_desc = {};
+        depth_stencil_desc.DepthEnable = TRUE;
+        depth_stencil_desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+        depth_stencil_desc.DepthFunc = D3D11_COMPARISON_LESS;
+
+        HRESULT result = device->CreateDepthStencilState(&depth_stencil_desc, &depth_stencil_state);
+        if (FAILED(result))
+        {
+            OutputDebugString(L"Failed to create constant buffer");
+            return GetLastError();
+        }
+    }
+
+    // create projection matrix
+    mat4 proj = mat4_perspective_fov_lh(
+        simd_radians(60.0f),
+        viewport.Width / viewport.Height,
+        0.1f,
+        1000.0f);
+
+    // cpu submission timing, space toggles between instanced and per draw submission and c
+    // turns frustum culling on and off
+    LARGE_INTEGER timer_frequency;
+    QueryPerformanceFrequency(&timer_frequency);
+    long long submit_ticks = 0;
+    int timed_frames = 0;
+    bool instanced = true;
+    bool culling = true;
+
+    // every bind in the frame loop goes through the state cache, which drops the redundant ones
+    state_cache_d3d state_backend = {context, nullptr};
+    state_cache state;
+    {
+        state_cache_backend backend = state_cache_backend_d3d(&state_backend);
+        state_cache_init(&state, &backend);
+    }
+
+    // msg loop
+    float angle = 0.0f;
+    bool running = true;
+    while (running)
+    {
+        MSG msg = {};
+        PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE);
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+
+        switch (msg.message)
+        {
+            case WM_QUIT:
+                running = false;
+                break;
+            case WM_KEYDOWN:
+                if (msg.wParam == VK_SPACE || msg.wParam == 'C')
+                {
+                    if (msg.wParam == VK_SPACE)
+                        instanced = !instanced;
+                    else
+                        culling = !culling;
+                    submit_ticks = 0;
+                    timed_frames = 0;
+                }
+                break;
+        }
+
+        // clear frame using red color
+        float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        context->ClearRenderTargetView(render_target_view, clear_color);
+        context->ClearDepthStencilView(depth_stencil_view, D3D11_CLEAR_DEPTH, 1.0f, 1);
+
+        // update all cube transforms, SIMD_MATH_WIDTH cubes at a time
+        {
+            angle += (1.0f / 60.0f);
+            for (int i = 0; i < cube_count; ++i)
+                angles[i] = angle * speeds[i];
+            mat4_soa_euler_translation(&world, angles, angles, angles, positions_x, positions_y, positions_z);
+            mat4_soa_mul_mat4(&world, &world, proj);
+            if (instanced == false || culling)
+                mat4_soa_store_transposed(transforms, &world);
+        }
+
+        // the positions are in view space already, so the planes of proj alone cull them
+        uint32_t visible_count = (uint32_t)cube_count;
+        if (culling)
+        {
+            frustum view_frustum = frustum_from_matrix(proj);
+            visible_count = frustum_cull_spheres(&view_frustum, &cube_bounds, 0, cube_count, visible);
+        }
+
+        LARGE_INTEGER submit_start;
+        QueryPerformanceCounter(&submit_start);
+
+        // set primitive
+        state_cache_ia_set_primitive_topology(&state, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        state_cache_ia_set_index_buffer(&state, index_buffer, DXGI_FORMAT_R32_UINT, 0);
+
+        // set pixel shader and colors
+        state_cache_ps_set_shader(&state, pixel_shader);
+        state_cache_ps_set_constant_buffer(&state, 0, colors_cbuffer);
+
+        // set viewport
+        state_cache_rs_set_viewports(&state, 1, &viewport);
+
+        // set render target and viewport
+        state_cache_om_set_render_target(&state, 0, render_target_view);
+        state_cache_om_set_depth_stencil_view(&state, depth_stencil_view);
+
+        // set depth stencil state
+        state_cache_om_set_depth_stencil_state(&state, depth_stencil_state, 1);
+
+        if (instanced)
+        {
+            // set layout, vertex shader and the per vertex and per instance streams
+            state_cache_ia_set_input_layout(&state, instanced_input_layout);
+            state_cache_vs_set_shader(&state, instanced_vertex_shader);
+
+            ID3D11Buffer *vertex_buffers[] = {vertex_buffer, instance_transform_buffer, instance_color_buffer};
+            UINT strides[] = {3 * sizeof(float), 16 * sizeof(float), sizeof(unsigned int)};
+            UINT offsets[] = {0, 0, 0};
+            for (UINT i = 0; i < 3; ++i)
+                state_cache_ia_set_vertex_buffer(&state, i, vertex_buffers[i], strides[i], offsets[i]);
+
+            // write every visible transform and color with one map each, packed to the front. the
+            // draw is skipped when a map fails, e.g. after the device was removed
+            bool uploaded = false;
+            {
+                D3D11_MAPPED_SUBRESOURCE mapped_subresource = {};
+                HRESULT result = context->Map(instance_transform_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+                if (FAILED(result) == false)
+                {
+                    float *mapped_transforms = (float *)mapped_subresource.pData;
+                    if (culling)
+                    {
+                        for (uint32_t i = 0; i < visible_count; ++i)
+                        {
+                            memcpy(mapped_transforms + i * 16, transforms + visible[i] * 16, 16 * sizeof(float));
+                            visible_colors[i] = cube_colors[visible[i]];
+                        }
+                    }
+                    else
+                    {
+                        mat4_soa_store_transposed(mapped_transforms, &world);
+                        memcpy(visible_colors, cube_colors, cube_count * sizeof(unsigned int));
+                    }
+                    context->Unmap(instance_transform_buffer, 0);
+
+                    result = context->Map(instance_color_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+                    if (FAILED(result) == false)
+                    {
+                        memcpy(mapped_subresource.pData, visible_colors, visible_count * sizeof(unsigned int));
+                        context->Unmap(instance_color_buffer, 0);
+                        uploaded = true;
+                    }
+                }
+            }
+
+            // draw the visible cubes
+            if (uploaded)
+                state_cache_draw_indexed_instanced(&state, 36, visible_count, 0, 0, 0);
+        }
+        else
+        {
+            // set layout, vertex shader, vertex buffer and transform constant buffer
+            state_cache_ia_set_input_layout(&state, input_layout);
+            state_cache_vs_set_shader(&state, vertex_shader);
+
+            UINT stride = 3 * sizeof(float);
+            UINT offset = 0;
+            state_cache_ia_set_vertex_buffer(&state, 0, vertex_buffer, stride, offset);
+            state_cache_vs_set_constant_buffer(&state, 0, transform_cbuffer);
+
+            // update transform constant buffer and draw, once per visible cube
+            for (uint32_t v = 0; v < visible_count; ++v)
+            {
+                uint32_t i = culling ? visible[v] : v;
+                transform_constants constants = {};
+                constants.mvp = mat4_load(transforms + i * 16);
+                constants.color = cube_colors[i];
+
+                // a failed map, e.g. after the device was removed, skips the rest of the draws
+                D3D11_MAPPED_SUBRESOURCE mapped_subresource = {};
+                HRESULT result = context->Map(transform_cbuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+                if (FAILED(result))
+                    break;
+                memcpy(mapped_subresource.pData, &constants, sizeof(constants));
+                context->Unmap(transform_cbuffer, 0);
+
+                state_cache_draw_indexed(&state, 36, 0, 0);
+            }
+        }
+
+        LARGE_INTEGER submit_end;
+        QueryPerformanceCounter(&submit_end);
+
+        // show average submission time every 60 frames
+        submit_ticks += submit_end.QuadPart - submit_start.QuadPart;
+        if (++timed_frames == 60)
+        {
+            char title[128];
+            snprintf(title, sizeof(title), "example instancing - %s, %u of %d cubes visible, submit %.3f ms",
+                instanced ? "instanced" : "per draw",
+                visible_count,
+                cube_count,
+                (double)submit_ticks * 1000.0 / (double)timer_frequency.QuadPart / timed_frames);
+            SetWindowTextA(hwnd, title);
+            submit_ticks = 0;
+            timed_frames = 0;
+        }
+
+        state_cache_end_frame(&state);
+        swapchain->Present(1, 0);
+    }
+
+    // release resources
+    depth_stencil_state->Release();
+    colors_cbuffer->Release();
+    transform_cbuffer->Release();
+    instanced_input_layout->Release();
+    input_layout->Release();
+    pixel_shader->Release();
+    instanced_vertex_shader->Release();
+    vertex_shader->Release();
+    instance_color_buffer->Release();
+    instance_transform_buffer->Release();
+    index_buffer->Release();
+    vertex_buffer->Release();
+    depth_stencil_view->Release();
+    render_target_view->Release();
+    context->Release();
+    device->Release();
+    swapchain->Release();
+    DestroyWindow(hwnd);
+
+    frustum_bounds_free(&cube_bounds);
+    mat4_soa_free(&world);
+    free(visible);
+    free(visible_colors);
+    free(transforms);
+    free(cube_colors);
+    free(positions_z);
+    free(positions_y);
+    free(positions_x);
+    free(angles);
+    free(speeds);
+
+    return 0;
+}
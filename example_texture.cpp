@@ -7,6 +7,7 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <d3dcompiler.h>
+#include <stdio.h>
 
 #if defined(min)
 #undef min
@@ -16,8 +17,61 @@
 #undef max
 #endif
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb/stb_image.h"
+#include "shader_cache_d3d.h"
+#include "state_cache_d3d.h"
+#include "async_load.h"
+
+// creates the texture and its view once the image is loaded, runs on the render thread. null
+// on failure
+static ID3D11ShaderResourceView *
+create_texture(ID3D11Device *device, const texture_stream_image *image)
+{
+    D3D11_TEXTURE2D_DESC texture_desc = {};
+    texture_desc.Width = image->width;
+    texture_desc.Height = image->height;
+    texture_desc.MipLevels = image->level_count;
+    texture_desc.ArraySize = 1;
+    texture_desc.Format = (DXGI_FORMAT)image->format;
+    texture_desc.SampleDesc.Count = 1;
+    texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    // one subresource per mip level, compressed levels are rows of 4x4 blocks. cooked
+    // levels point straight into the mapped file
+    D3D11_SUBRESOURCE_DATA subresource_data[MIP_MAX_LEVELS] = {};
+    for (int level = 0; level < image->level_count; ++level)
+    {
+        subresource_data[level].pSysMem = image->levels[level].data;
+        subresource_data[level].SysMemPitch = image->levels[level].row_pitch;
+    }
+
+    ID3D11Texture2D *texture = nullptr;
+    HRESULT result = device->CreateTexture2D(&texture_desc, subresource_data, &texture);
+    if (FAILED(result))
+    {
+        OutputDebugString(L"Failed to create texture 2d\n");
+        return nullptr;
+    }
+
+    ID3D11ShaderResourceView *view = nullptr;
+    result = device->CreateShaderResourceView(texture, nullptr, &view);
+    texture->Release();
+    if (FAILED(result))
+    {
+        OutputDebugString(L"Failed to create texture view\n");
+        return nullptr;
+    }
+    return view;
+}
+
+// the cooked texture, or the jpg when it is missing or broken
+static load_task<texture_stream_image *>
+load_uv_grid(load_context *ctx)
+{
+    texture_stream_image *image = co_await load_texture(ctx, "data/uv_grid.tex");
+    if (image == nullptr)
+        image = co_await load_texture(ctx, "data/uv_grid.jpg", true);
+    co_return image;
+}
 
 LRESULT CALLBACK
 window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
@@ -197,27 +251,22 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         }
     }
 
-    // load image and create a 2d texture
-    ID3D11ShaderResourceView *texture_view = nullptr;
+    // the texture loads on a thread pool while a small checker is drawn, the frame loop swaps
+    // it in once the task finished. data/uv_grid.tex is the cooked copy of the jpg that
+    // build.bat writes with cook_texture, the jpg is only decoded, mipped and compressed when
+    // it is missing
+    ID3D11ShaderResourceView *placeholder_view = nullptr;
     {
-        // load image
-        unsigned char * data = nullptr;
-        int img_width, img_height, img_channels;
-        {
-            data = stbi_load("data/uv_grid.jpg", &img_width, &img_height, &img_channels, 4);
-            if (data == nullptr)
-            {
-                OutputDebugString(L"Failed to load image\n");
-                return 1;
-            }
-        }
+        uint32_t pixels[8 * 8];
+        for (int y = 0; y < 8; ++y)
+            for (int x = 0; x < 8; ++x)
+                pixels[y * 8 + x] = ((x ^ y) & 1) ? 0xff808080 : 0xff404040;
 
-        // craete texture
         ID3D11Texture2D *texture = nullptr;
         {
             D3D11_TEXTURE2D_DESC texture_desc = {};
-            texture_desc.Width = img_width;
-            texture_desc.Height = img_height;
+            texture_desc.Width = 8;
+            texture_desc.Height = 8;
             texture_desc.MipLevels = 1;
             texture_desc.ArraySize = 1;
             texture_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -225,34 +274,34 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
             texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
             D3D11_SUBRESOURCE_DATA subresource_data = {};
-            subresource_data.pSysMem = data;
-            subresource_data.SysMemPitch = img_width * 4;
+            subresource_data.pSysMem = pixels;
+            subresource_data.SysMemPitch = 8 * sizeof(uint32_t);
 
             HRESULT result = device->CreateTexture2D(&texture_desc, &subresource_data, &texture);
             if (FAILED(result))
             {
-                OutputDebugString(L"Failed to create texture 2d\n");
+                OutputDebugString(L"Failed to create placeholder texture\n");
                 return GetLastError();
             }
         }
-        stbi_image_free(data);
 
-        // create texture view
+        HRESULT result = device->CreateShaderResourceView(texture, nullptr, &placeholder_view);
+        if (FAILED(result))
         {
-            D3D11_SHADER_RESOURCE_VIEW_DESC view_desc = {};
-            view_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-            view_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-            view_desc.Texture2D.MipLevels = 1;
-            HRESULT result = device->CreateShaderResourceView(texture, &view_desc, &texture_view);
-            if (FAILED(result))
-            {
-                OutputDebugString(L"Failed to create render target view\n");
-                return GetLastError();
-            }
+            OutputDebugString(L"Failed to create placeholder view\n");
+            return GetLastError();
         }
         texture->Release();
     }
 
+    thread_pool pool;
+    thread_pool_init(&pool);
+    load_context load;
+    load_context_init(&load, &pool);
+    double texture_request_time = texture_stream_now();
+    load_task<texture_stream_image *> texture_task = load_uv_grid(&load);
+    ID3D11ShaderResourceView *texture_view = nullptr;
+
     // create sampler state
     ID3D11SamplerState *sampler_state = nullptr;
     {
@@ -269,10 +318,11 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         }
     }
 
-    // create vertex and pixel shaders
-    ID3DBlob *vertex_shader_blob = nullptr;
-    ID3D11VertexShader *vertex_shader = nullptr;
-    ID3D11PixelShader *pixel_shader = nullptr;
+    // the shaders are needed for the first frame. they compile through the shader cache in
+    // build/shader_cache on the same pool, later runs read the bytecode from disk instead of
+    // calling D3DCompile
+    std::vector<uint8_t> vertex_shader_code;
+    std::vector<uint8_t> pixel_shader_code;
     {
         const char shader_src[] = R"(
             struct VS_Out
@@ -297,59 +347,46 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
                 return tex.Sample(tex_sampler, uv);
             }
         )";
-
-        // compile vertex shader
+        shader_desc vs_desc = {"shader_src", shader_src, sizeof(shader_src), "vs_main", "vs_5_0", nullptr, 0};
+        shader_desc ps_desc = {"shader_src", shader_src, sizeof(shader_src), "ps_main", "ps_5_0", nullptr, 0};
+
+        shader_cache cache;
+        shader_cache_init(&cache, "shader_cache", shader_compiler_d3d());
+        load_task<shader_result> vs = load_shader(&load, &cache, &vs_desc);
+        load_task<shader_result> ps = load_shader(&load, &cache, &ps_desc);
+        shader_result vs_result = load_wait(&load, std::move(vs));
+        shader_result ps_result = load_wait(&load, std::move(ps));
+        if (vs_result.ok == false)
         {
-            ID3DBlob *error_blob = nullptr;
-            HRESULT result = D3DCompile(
-                shader_src,
-                sizeof(shader_src),
-                nullptr,
-                nullptr,
-                nullptr,
-                "vs_main",
-                "vs_5_0",
-                0,
-                0,
-                &vertex_shader_blob,
-                &error_blob);
-            if (FAILED(result))
-            {
-                OutputDebugString(L"Failed to compile vertex shader\n");
-                OutputDebugStringA((char *)error_blob->GetBufferPointer());
-                return GetLastError();
-            }
+            OutputDebugString(L"Failed to compile vertex shader\n");
+            OutputDebugStringA(vs_result.errors.c_str());
+            return GetLastError();
         }
-
-        // compile pixel shader
-        ID3DBlob *pixel_shader_blob = nullptr;
+        if (ps_result.ok == false)
         {
-            ID3DBlob *error_blob = nullptr;
-            HRESULT result = D3DCompile(
-                shader_src,
-                sizeof(shader_src),
-                nullptr,
-                nullptr,
-                nullptr,
-                "ps_main",
-                "ps_5_0",
-                0,
-                0,
-                &pixel_shader_blob,
-                &error_blob);
-            if (FAILED(result))
-            {
-                OutputDebugString(L"Failed to compile pixel shader\n");
-                OutputDebugStringA((char *)error_blob->GetBufferPointer());
-                return GetLastError();
-            }
+            OutputDebugString(L"Failed to compile pixel shader\n");
+            OutputDebugStringA(ps_result.errors.c_str());
+            return GetLastError();
         }
+        vertex_shader_code.swap(vs_result.bytecode);
+        pixel_shader_code.swap(ps_result.bytecode);
+
+        shader_cache_stats stats = shader_cache_get_stats(&cache);
+        char message[128];
+        snprintf(message, sizeof(message), "shader cache: %llu of %llu from cache, %.2f ms saved\n",
+            (unsigned long long)(stats.memory_hits + stats.disk_hits), (unsigned long long)stats.lookups, stats.saved_seconds * 1000.0);
+        OutputDebugStringA(message);
+    }
 
+    // create vertex and pixel shaders
+    ID3D11VertexShader *vertex_shader = nullptr;
+    ID3D11PixelShader *pixel_shader = nullptr;
+    {
         // create vertex shader
         {
             HRESULT result = device->CreateVertexShader(
-                vertex_shader_blob->GetBufferPointer(),
-                vertex_shader_blob->GetBufferSize(),
+                vertex_shader_code.data(),
+                vertex_shader_code.size(),
                 nullptr,
                 &vertex_shader);
             if (FAILED(result))
@@ -362,8 +399,8 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         // create pixel shader
         {
             HRESULT result = device->CreatePixelShader(
-                pixel_shader_blob->GetBufferPointer(),
-                pixel_shader_blob->GetBufferSize(),
+                pixel_shader_code.data(),
+                pixel_shader_code.size(),
                 nullptr,
                 &pixel_shader);
             if (FAILED(result))
@@ -371,7 +408,6 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
                 OutputDebugString(L"Failed to create pixel shader\n");
                 return GetLastError();
             }
-            pixel_shader_blob->Release();
         }
     }
 
@@ -386,14 +422,13 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         HRESULT result = device->CreateInputLayout(
             input_element_desc,
             ARRAYSIZE(input_element_desc),
-            vertex_shader_blob->GetBufferPointer(),
-            vertex_shader_blob->GetBufferSize(), &input_layout);
+            vertex_shader_code.data(),
+            vertex_shader_code.size(), &input_layout);
         if (FAILED(result))
         {
             OutputDebugString(L"Failed to create input layout\n");
             return GetLastError();
         }
-        vertex_shader_blob->Release();
     }
 
     // create viewport
@@ -409,6 +444,14 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
         viewport.Height = (float)window_height;
     }
 
+    // every bind in the frame loop goes through the state cache, which drops the redundant ones
+    state_cache_d3d state_backend = {context, nullptr};
+    state_cache state;
+    {
+        state_cache_backend backend = state_cache_backend_d3d(&state_backend);
+        state_cache_init(&state, &backend);
+    }
+
     // msg loop
     bool running = true;
     while (running)
@@ -425,48 +468,82 @@ WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pCmdLine, int nCmdSho
                 break;
         }
 
+        // runs the main thread jobs and picks the texture up the frame its task finished
+        job_system_pump_main(&pool.jobs);
+        if (texture_task.handle && load_task_done(texture_task))
+        {
+            texture_stream_image *image = load_wait(&load, std::move(texture_task));
+            texture_task = load_task<texture_stream_image *>();
+            if (image)
+            {
+                texture_view = create_texture(device, image);
+                char message[128];
+                snprintf(message, sizeof(message), "texture %ux%u, %d levels, uploaded after %.2f ms\n", image->width,
+                    image->height, image->level_count, (texture_stream_now() - texture_request_time) * 1000.0);
+                OutputDebugStringA(message);
+                texture_stream_image_free(image);
+            }
+            else
+            {
+                OutputDebugString(L"Failed to load texture\n");
+            }
+        }
+        ID3D11ShaderResourceView *shown_view = texture_view ? texture_view : placeholder_view;
+
         // clear frame using red color
         float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
         context->ClearRenderTargetView(render_target_view, clear_color);
 
         // set layout and primitive
-        context->IASetInputLayout(input_layout);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        state_cache_ia_set_input_layout(&state, input_layout);
+        state_cache_ia_set_primitive_topology(&state, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
         // set vertex and index buffer
         UINT stride = 4 * sizeof(float);
         UINT offset = 0;
-        context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
-        context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+        state_cache_ia_set_vertex_buffer(&state, 0, vertex_buffer, stride, offset);
+        state_cache_ia_set_index_buffer(&state, index_buffer, DXGI_FORMAT_R32_UINT, 0);
 
         // set vertex and pixel shaders
-        context->VSSetShader(vertex_shader, nullptr, 0);
-        context->PSSetShader(pixel_shader, nullptr, 0);
+        state_cache_vs_set_shader(&state, vertex_shader);
+        state_cache_ps_set_shader(&state, pixel_shader);
 
         // set texture and sampler
-        context->PSSetShaderResources(0, 1, &texture_view);
-        context->PSSetSamplers(0, 1, &sampler_state);
+        state_cache_ps_set_shader_resource(&state, 0, shown_view);
+        state_cache_ps_set_sampler(&state, 0, sampler_state);
 
         // set viewport
-        context->RSSetViewports(1, &viewport);
+        state_cache_rs_set_viewports(&state, 1, &viewport);
 
         // set render target and viewport
-        context->OMSetRenderTargets(1, &render_target_view, nullptr);
+        state_cache_om_set_render_target(&state, 0, render_target_view);
+        state_cache_om_set_depth_stencil_view(&state, nullptr);
 
         // draw
-        context->DrawIndexed(6, 0, 0);
+        state_cache_draw_indexed(&state, 6, 0, 0);
 
+        state_cache_end_frame(&state);
         swapchain->Present(1, 0);
     }
 
-    // release resources
+    // release resources, a texture still loading is finished first
+    if (texture_task.handle)
+    {
+        texture_stream_image *image = load_wait(&load, std::move(texture_task));
+        if (image)
+            texture_stream_image_free(image);
+    }
+    load_context_shutdown(&load);
+    thread_pool_shutdown(&pool);
     input_layout->Release();
     pixel_shader->Release();
     vertex_shader->Release();
     index_buffer->Release();
     vertex_buffer->Release();
     sampler_state->Release();
-    texture_view->Release();
+    if (texture_view)
+        texture_view->Release();
+    placeholder_view->Release();
     render_target_view->Release();
     context->Release();
     device->Release();
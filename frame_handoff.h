@@ -0,0 +1,212 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+
+// lock free pieces that let simulation and rendering run on their own threads:
+// - frame_handoff, a triple buffer the simulation publishes immutable frame snapshots into
+//   and the render thread takes the newest one from, neither side ever waits on the other
+// - spsc_queue, a bounded single producer single consumer queue for input events on their
+//   way from the window thread to the simulation
+// - fixed_timestep, turns wall time into a whole number of simulation steps and gives the
+//   interpolation factor between the last two of them at render time
+
+#define FRAME_HANDOFF_SLOTS 3
+#define FRAME_HANDOFF_FRESH 4u // set on middle while the render side hasn't taken it yet
+#define FRAME_HANDOFF_CACHE_LINE 64
+
+inline double
+frame_handoff_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the snapshots themselves live in a caller owned array of FRAME_HANDOFF_SLOTS. the producer
+// owns back, the consumer front and middle holds the newest published slot. publishing
+// swaps back and middle, acquiring swaps front and middle, so a slot is only ever touched by
+// the side that owns it. each side keeps its own counters.
+struct frame_handoff
+{
+    std::atomic<uint32_t> middle;
+    uint8_t pad[FRAME_HANDOFF_CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+
+    // producer side
+    uint32_t back;
+    uint64_t published;
+    uint64_t overwritten; // published and replaced before the consumer took them
+    uint8_t producer_pad[FRAME_HANDOFF_CACHE_LINE - 3 * sizeof(uint64_t)];
+
+    // consumer side
+    uint32_t front;
+    uint64_t acquired;
+    uint64_t stale; // acquires that found nothing newer than front
+};
+
+inline void
+frame_handoff_init(frame_handoff *handoff)
+{
+    handoff->back = 0;
+    handoff->middle.store(1, std::memory_order_relaxed);
+    handoff->front = 2;
+    handoff->published = 0;
+    handoff->overwritten = 0;
+    handoff->acquired = 0;
+    handoff->stale = 0;
+}
+
+// slot the producer writes its next snapshot into
+inline uint32_t
+frame_handoff_write_slot(const frame_handoff *handoff)
+{
+    return handoff->back;
+}
+
+// makes the back slot the newest snapshot and hands the producer a new back slot
+inline void
+frame_handoff_publish(frame_handoff *handoff)
+{
+    uint32_t previous = handoff->middle.exchange(handoff->back | FRAME_HANDOFF_FRESH, std::memory_order_acq_rel);
+    if (previous & FRAME_HANDOFF_FRESH)
+        handoff->overwritten++;
+    handoff->back = previous & ~FRAME_HANDOFF_FRESH;
+    handoff->published++;
+}
+
+// moves the newest snapshot to front when there is one, returns false when front is still
+// the newest. front is valid to read until the next acquire either way, once anything has
+// been published
+inline bool
+frame_handoff_acquire(frame_handoff *handoff)
+{
+    if ((handoff->middle.load(std::memory_order_relaxed) & FRAME_HANDOFF_FRESH) == 0)
+    {
+        handoff->stale++;
+        return false;
+    }
+
+    // only the producer sets the fresh bit, it is still set here
+    uint32_t previous = handoff->middle.exchange(handoff->front, std::memory_order_acq_rel);
+    handoff->front = previous & ~FRAME_HANDOFF_FRESH;
+    handoff->acquired++;
+    return true;
+}
+
+inline uint32_t
+frame_handoff_read_slot(const frame_handoff *handoff)
+{
+    return handoff->front;
+}
+
+// bounded queue, capacity is a power of two. head and tail only grow and wrap at 2^32
+template <typename T, uint32_t capacity>
+struct spsc_queue
+{
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    T items[capacity];
+    std::atomic<uint32_t> head; // next item to pop, written by the consumer
+    uint8_t head_pad[FRAME_HANDOFF_CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> tail; // next item to push, written by the producer
+    uint8_t tail_pad[FRAME_HANDOFF_CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+};
+
+template <typename T, uint32_t capacity>
+inline void
+spsc_queue_init(spsc_queue<T, capacity> *queue)
+{
+    queue->head.store(0, std::memory_order_relaxed);
+    queue->tail.store(0, std::memory_order_relaxed);
+}
+
+// returns false when the queue is full
+template <typename T, uint32_t capacity>
+inline bool
+spsc_queue_push(spsc_queue<T, capacity> *queue, const T &item)
+{
+    uint32_t tail = queue->tail.load(std::memory_order_relaxed);
+    if (tail - queue->head.load(std::memory_order_acquire) == capacity)
+        return false;
+    queue->items[tail & (capacity - 1)] = item;
+    queue->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// returns false when the queue is empty
+template <typename T, uint32_t capacity>
+inline bool
+spsc_queue_pop(spsc_queue<T, capacity> *queue, T *item)
+{
+    uint32_t head = queue->head.load(std::memory_order_relaxed);
+    if (head == queue->tail.load(std::memory_order_acquire))
+        return false;
+    *item = queue->items[head & (capacity - 1)];
+    queue->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+// fixed step simulation clock. every advance turns the wall time since the last one into
+// whole steps, the remainder carries over. after a long stall at most max_steps run and the
+// rest of the backlog is dropped so the simulation can't spiral behind.
+struct fixed_timestep
+{
+    double step;
+    double start_time;
+    double accumulator;
+    double last_time;
+    uint64_t ticks;
+    uint32_t max_steps;
+    uint64_t dropped_steps;
+};
+
+inline void
+fixed_timestep_init(fixed_timestep *ts, double step, double now, uint32_t max_steps = 8)
+{
+    ts->step = step;
+    ts->start_time = now;
+    ts->accumulator = 0.0;
+    ts->last_time = now;
+    ts->ticks = 0;
+    ts->max_steps = max_steps;
+    ts->dropped_steps = 0;
+}
+
+// returns the number of steps to run now, ticks counts them
+inline uint32_t
+fixed_timestep_advance(fixed_timestep *ts, double now)
+{
+    ts->accumulator += now - ts->last_time;
+    ts->last_time = now;
+
+    uint64_t due = (uint64_t)(ts->accumulator / ts->step);
+    ts->accumulator -= (double)due * ts->step;
+    uint32_t steps = due > ts->max_steps ? ts->max_steps : (uint32_t)due;
+    ts->dropped_steps += due - steps;
+    ts->ticks += steps;
+    return steps;
+}
+
+// wall time the state after the last step stands for
+inline double
+fixed_timestep_state_time(const fixed_timestep *ts)
+{
+    return ts->last_time - ts->accumulator;
+}
+
+// wall time at which the next step is due
+inline double
+fixed_timestep_next_time(const fixed_timestep *ts)
+{
+    return ts->last_time + (ts->step - ts->accumulator);
+}
+
+// interpolation factor between a snapshot's previous and current state for a frame rendered
+// at now, when the current state was simulated up to state_time. rendering a step behind
+// the simulation keeps this an interpolation instead of a guess about the future.
+inline float
+fixed_timestep_alpha(double state_time, double now, double step)
+{
+    double alpha = (now - state_time) / step;
+    return alpha < 0.0 ? 0.0f : (alpha > 1.0 ? 1.0f : (float)alpha);
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "profile.h"
+
+// per frame phase timing. a frame is split into caller named phases by marking the end of each
+// one, the durations go into a fixed size ring of the most recent frame records and into a
+// log scale histogram per phase that covers the whole run. percentiles come from the
+// histograms, the ring is what the csv and json dumps list frame by frame.
+//
+//     frame_timing_begin_frame(&timing);
+//     ... pump messages
+//     frame_timing_mark(&timing, PHASE_MESSAGES);
+//     ... simulate
+//     frame_timing_mark(&timing, PHASE_SIMULATION);
+//     frame_timing_end_frame(&timing);
+//
+// a phase that isn't marked in a frame counts as zero, time between the last mark and
+// end_frame only shows up in the frame total.
+
+#define FRAME_TIMING_MAX_PHASES 8
+// histogram buckets per doubling of the duration, from 1/16 us up to 2^24 us (16 s)
+#define FRAME_TIMING_BUCKETS_PER_OCTAVE 8
+#define FRAME_TIMING_BUCKETS (28 * FRAME_TIMING_BUCKETS_PER_OCTAVE)
+#define FRAME_TIMING_BUCKET_BASE_US 0.0625f
+
+struct frame_timing_record
+{
+    uint64_t frame;
+    double start;   // seconds since frame_timing_init
+    float total_ms; // begin_frame to end_frame
+    float phase_ms[FRAME_TIMING_MAX_PHASES];
+};
+
+struct frame_timing_histogram
+{
+    uint32_t buckets[FRAME_TIMING_BUCKETS];
+    uint64_t count;
+    double sum_ms;
+    float min_ms;
+    float max_ms;
+};
+
+struct frame_timing_summary
+{
+    uint64_t count;
+    float mean_ms;
+    float min_ms;
+    float p50_ms;
+    float p95_ms;
+    float p99_ms;
+    float max_ms;
+};
+
+struct frame_timing
+{
+    int phase_count;
+    const char *phase_names[FRAME_TIMING_MAX_PHASES];
+
+    // ring of the last capacity frames, records[frames % capacity] is the next one
+    frame_timing_record *records;
+    uint32_t capacity;
+    uint64_t frames;
+
+    // phase_count phase histograms then the frame total
+    frame_timing_histogram histograms[FRAME_TIMING_MAX_PHASES + 1];
+
+    // frame in progress
+    frame_timing_record current;
+    double epoch;
+    double last_mark;
+};
+
+inline double
+frame_timing_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// phase_names must outlive the frame_timing
+inline bool
+frame_timing_init(frame_timing *timing, int phase_count, const char *const *phase_names, uint32_t capacity = 1024)
+{
+    if (phase_count > FRAME_TIMING_MAX_PHASES)
+        phase_count = FRAME_TIMING_MAX_PHASES;
+    timing->phase_count = phase_count;
+    for (int i = 0; i < phase_count; ++i)
+        timing->phase_names[i] = phase_names[i];
+
+    timing->records = (frame_timing_record *)calloc(capacity, sizeof(frame_timing_record));
+    timing->capacity = timing->records ? capacity : 0;
+    timing->frames = 0;
+    memset(timing->histograms, 0, sizeof(timing->histograms));
+    memset(&timing->current, 0, sizeof(timing->current));
+    timing->epoch = frame_timing_now();
+    timing->last_mark = timing->epoch;
+    return timing->records != nullptr;
+}
+
+inline void
+frame_timing_free(frame_timing *timing)
+{
+    free(timing->records);
+    timing->records = nullptr;
+    timing->capacity = 0;
+}
+
+inline int
+frame_timing_bucket(float ms)
+{
+    float x = ms * 1000.0f / FRAME_TIMING_BUCKET_BASE_US;
+    if (x <= 1.0f)
+        return 0;
+    int bucket = (int)(log2f(x) * FRAME_TIMING_BUCKETS_PER_OCTAVE);
+    return bucket < FRAME_TIMING_BUCKETS ? bucket : FRAME_TIMING_BUCKETS - 1;
+}
+
+// geometric middle of a bucket in ms
+inline float
+frame_timing_bucket_ms(int bucket)
+{
+    return exp2f(((float)bucket + 0.5f) / FRAME_TIMING_BUCKETS_PER_OCTAVE) * FRAME_TIMING_BUCKET_BASE_US * 0.001f;
+}
+
+inline void
+frame_timing_histogram_add(frame_timing_histogram *histogram, float ms)
+{
+    histogram->buckets[frame_timing_bucket(ms)]++;
+    histogram->min_ms = histogram->count == 0 || ms < histogram->min_ms ? ms : histogram->min_ms;
+    histogram->max_ms = ms > histogram->max_ms ? ms : histogram->max_ms;
+    histogram->count++;
+    histogram->sum_ms += ms;
+}
+
+// p in [0, 1], accurate to about 4% of the value, clamped to the observed min and max
+inline float
+frame_timing_histogram_percentile(const frame_timing_histogram *histogram, float p)
+{
+    if (histogram->count == 0)
+        return 0.0f;
+
+    uint64_t rank = (uint64_t)(p * (float)(histogram->count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < FRAME_TIMING_BUCKETS; ++bucket)
+    {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank)
+        {
+            float ms = frame_timing_bucket_ms(bucket);
+            ms = ms < histogram->min_ms ? histogram->min_ms : ms;
+            return ms > histogram->max_ms ? histogram->max_ms : ms;
+        }
+    }
+    return histogram->max_ms;
+}
+
+inline void
+frame_timing_begin_frame(frame_timing *timing)
+{
+    double now = frame_timing_now();
+    memset(&timing->current, 0, sizeof(timing->current));
+    timing->current.frame = timing->frames;
+    timing->current.start = now - timing->epoch;
+    timing->last_mark = now;
+}
+
+// ends phase, it took the time since begin_frame or the previous mark. marking a phase
+// twice in a frame adds up
+inline void
+frame_timing_mark(frame_timing *timing, int phase)
+{
+    double now = frame_timing_now();
+    timing->current.phase_ms[phase] += (float)((now - timing->last_mark) * 1000.0);
+    timing->last_mark = now;
+}
+
+inline void
+frame_timing_end_frame(frame_timing *timing)
+{
+    frame_timing_record *record = &timing->current;
+    record->total_ms = (float)((frame_timing_now() - timing->epoch - record->start) * 1000.0);
+
+    for (int i = 0; i < timing->phase_count; ++i)
+        frame_timing_histogram_add(&timing->histograms[i], record->phase_ms[i]);
+    frame_timing_histogram_add(&timing->histograms[timing->phase_count], record->total_ms);
+
+    if (timing->capacity)
+        timing->records[timing->frames % timing->capacity] = *record;
+    timing->frames++;
+}
+
+// phase == phase_count summarizes the frame totals
+inline frame_timing_summary
+frame_timing_summarize(const frame_timing *timing, int phase)
+{
+    const frame_timing_histogram *histogram = &timing->histograms[phase];
+    frame_timing_summary summary = {};
+    summary.count = histogram->count;
+    if (histogram->count == 0)
+        return summary;
+    summary.mean_ms = (float)(histogram->sum_ms / (double)histogram->count);
+    summary.min_ms = histogram->min_ms;
+    summary.p50_ms = frame_timing_histogram_percentile(histogram, 0.50f);
+    summary.p95_ms = frame_timing_histogram_percentile(histogram, 0.95f);
+    summary.p99_ms = frame_timing_histogram_percentile(histogram, 0.99f);
+    summary.max_ms = histogram->max_ms;
+    return summary;
+}
+
+inline const char *
+frame_timing_phase_name(const frame_timing *timing, int phase)
+{
+    return phase < timing->phase_count ? timing->phase_names[phase] : "frame";
+}
+
+// number of records in the ring and the oldest one's index
+inline uint32_t
+frame_timing_record_count(const frame_timing *timing, uint64_t *first)
+{
+    uint64_t count = timing->frames < timing->capacity ? timing->frames : timing->capacity;
+    *first = timing->frames - count;
+    return (uint32_t)count;
+}
+
+inline void
+frame_timing_print(const frame_timing *timing, FILE *file)
+{
+    fprintf(file, "%-14s %9s %9s %9s %9s %9s %9s\n", "phase ms", "mean", "min", "p50", "p95", "p99", "max");
+    for (int phase = 0; phase <= timing->phase_count; ++phase)
+    {
+        frame_timing_summary s = frame_timing_summarize(timing, phase);
+        fprintf(file, "%-14s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", frame_timing_phase_name(timing, phase), s.mean_ms, s.min_ms,
+            s.p50_ms, s.p95_ms, s.p99_ms, s.max_ms);
+    }
+}
+
+// one row per frame in the ring, oldest first
+inline bool
+frame_timing_write_csv(const frame_timing *timing, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "frame,start_ms,total_ms");
+    for (int i = 0; i < timing->phase_count; ++i)
+        fprintf(file, ",%s_ms", timing->phase_names[i]);
+    fprintf(file, "\n");
+
+    uint64_t first;
+    uint32_t count = frame_timing_record_count(timing, &first);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const frame_timing_record *record = &timing->records[(first + i) % timing->capacity];
+        fprintf(file, "%llu,%.3f,%.4f", (unsigned long long)record->frame, record->start * 1000.0, record->total_ms);
+        for (int phase = 0; phase < timing->phase_count; ++phase)
+            fprintf(file, ",%.4f", record->phase_ms[phase]);
+        fprintf(file, "\n");
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+// the whole run summary per phase plus the frames in the ring, oldest first, as
+// [frame, start_ms, total_ms, phase_ms...] arrays
+inline bool
+frame_timing_write_json(const frame_timing *timing, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "{\n  \"frames\": %llu,\n  \"summary\": {\n", (unsigned long long)timing->frames);
+    for (int phase = 0; phase <= timing->phase_count; ++phase)
+    {
+        frame_timing_summary s = frame_timing_summarize(timing, phase);
+        fprintf(file, "    ");
+        profile_write_json_string(file, frame_timing_phase_name(timing, phase));
+        fprintf(file, ": {\"mean_ms\": %.4f, \"min_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+            s.mean_ms, s.min_ms, s.p50_ms, s.p95_ms, s.p99_ms, s.max_ms, phase < timing->phase_count ? "," : "");
+    }
+
+    fprintf(file, "  },\n  \"columns\": [\"frame\", \"start_ms\", \"total_ms\"");
+    for (int i = 0; i < timing->phase_count; ++i)
+    {
+        fprintf(file, ", ");
+        profile_write_json_string(file, timing->phase_names[i], "_ms");
+    }
+    fprintf(file, "],\n  \"records\": [\n");
+
+    uint64_t first;
+    uint32_t count = frame_timing_record_count(timing, &first);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const frame_timing_record *record = &timing->records[(first + i) % timing->capacity];
+        fprintf(file, "    [%llu, %.3f, %.4f", (unsigned long long)record->frame, record->start * 1000.0, record->total_ms);
+        for (int phase = 0; phase < timing->phase_count; ++phase)
+            fprintf(file, ", %.4f", record->phase_ms[phase]);
+        fprintf(file, "]%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "simd_math.h"
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// view frustum culling of bounding spheres and boxes. the bounds live in SoA streams like
+// mat4_soa and every frustum_cull_* call tests SIMD_MATH_WIDTH of them against all six
+// planes per step, 8 with AVX2, 4 with SSE/NEON. the survivors come out as a compacted list
+// of indices in ascending order, ready to gather instance data from or to loop draws over.
+//
+//     frustum f = frustum_from_matrix(view * proj);
+//     uint32_t visible_count = frustum_cull_spheres(&f, &spheres, 0, spheres.count, visible);
+//
+// the tests are conservative, a volume that straddles two planes outside a corner of the
+// frustum is kept.
+
+#define FRUSTUM_SPHERE_STREAMS 4 // center x, y, z, radius
+#define FRUSTUM_AABB_STREAMS 6   // center x, y, z, half extent x, y, z
+
+// planes point inwards, a point p is inside plane i when dot(plane.xyz, p) + plane.w >= 0.
+// left, right, bottom, top, near, far
+struct frustum
+{
+    float planes[6][4];
+};
+
+// bounds stored as `streams` streams of `stride` floats, stream s of bound i lives at
+// data[s * stride + i]. stride is count rounded up to 8 so every stream starts aligned
+struct frustum_bounds
+{
+    float *data;
+    size_t count;
+    size_t stride;
+    int streams;
+};
+
+// planes of the clip volume of a row vector matrix (v * m), d3d depth range [0, w]. with a
+// view * proj matrix they are in world space, with proj alone in view space
+inline frustum
+frustum_from_matrix(const mat4 &m)
+{
+    float f[16];
+    mat4_store(f, m);
+
+    // clip = v * m, so clip x, y, z, w are dot products with the columns of m
+    float columns[4][4];
+    for (int row = 0; row < 4; ++row)
+        for (int col = 0; col < 4; ++col)
+            columns[col][row] = f[row * 4 + col];
+
+    frustum out;
+    for (int i = 0; i < 4; ++i)
+    {
+        out.planes[0][i] = columns[3][i] + columns[0][i]; // -w <= x
+        out.planes[1][i] = columns[3][i] - columns[0][i]; // x <= w
+        out.planes[2][i] = columns[3][i] + columns[1][i]; // -w <= y
+        out.planes[3][i] = columns[3][i] - columns[1][i]; // y <= w
+        out.planes[4][i] = columns[2][i];                 // 0 <= z
+        out.planes[5][i] = columns[3][i] - columns[2][i]; // z <= w
+    }
+
+    // unit normals so the plane distance compares against a radius
+    for (int p = 0; p < 6; ++p)
+    {
+        float *plane = out.planes[p];
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        float inv = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int i = 0; i < 4; ++i)
+            plane[i] *= inv;
+    }
+    return out;
+}
+
+inline bool
+frustum_bounds_init(frustum_bounds *bounds, size_t count, int streams)
+{
+    bounds->count = count;
+    bounds->stride = (count + 7) & ~(size_t)7;
+    bounds->streams = streams;
+    bounds->data = (float *)simd_aligned_alloc((size_t)streams * bounds->stride * sizeof(float));
+    if (bounds->data == nullptr)
+        return false;
+    memset(bounds->data, 0, (size_t)streams * bounds->stride * sizeof(float));
+    return true;
+}
+
+inline void
+frustum_bounds_free(frustum_bounds *bounds)
+{
+    simd_aligned_free(bounds->data);
+    bounds->data = nullptr;
+    bounds->count = 0;
+    bounds->stride = 0;
+}
+
+inline float *
+frustum_bounds_stream(const frustum_bounds *bounds, int stream)
+{
+    return bounds->data + (size_t)stream * bounds->stride;
+}
+
+inline void
+frustum_bounds_set_sphere(frustum_bounds *bounds, size_t index, float x, float y, float z, float radius)
+{
+    float values[FRUSTUM_SPHERE_STREAMS] = {x, y, z, radius};
+    for (int s = 0; s < FRUSTUM_SPHERE_STREAMS; ++s)
+        bounds->data[(size_t)s * bounds->stride + index] = values[s];
+}
+
+inline void
+frustum_bounds_set_aabb(frustum_bounds *bounds, size_t index, const float center[3], const float extent[3])
+{
+    for (int s = 0; s < 3; ++s)
+    {
+        bounds->data[(size_t)s * bounds->stride + index] = center[s];
+        bounds->data[(size_t)(s + 3) * bounds->stride + index] = extent[s];
+    }
+}
+
+inline uint32_t
+frustum_lowest_bit(uint32_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(bits);
+#endif
+}
+
+inline uint32_t
+frustum_bit_count(uint32_t bits)
+{
+#if defined(_MSC_VER)
+    return (uint32_t)__popcnt(bits);
+#else
+    return (uint32_t)__builtin_popcount(bits);
+#endif
+}
+
+#if defined(SIMD_MATH_AVX2)
+// lane indices of the set bits of every 8 bit mask, packed one per byte
+inline const uint64_t *
+frustum_compact_table()
+{
+    static const struct table
+    {
+        uint64_t lanes[256];
+        table()
+        {
+            for (uint32_t mask = 0; mask < 256; ++mask)
+            {
+                uint64_t packed = 0;
+                int n = 0;
+                for (uint32_t lane = 0; lane < 8; ++lane)
+                    if (mask & (1u << lane))
+                        packed |= (uint64_t)lane << (8 * n++);
+                lanes[mask] = packed;
+            }
+        }
+    } t;
+    return t.lanes;
+}
+#endif
+
+// appends base + lane for every set bit of mask to visible[n...], returns the new n. with
+// AVX2 a full block stores 8 indices at once, the ones past the set bits land in slots the
+// block could have filled itself and get overwritten by the next one
+inline uint32_t
+frustum_emit(uint32_t *visible, uint32_t n, uint32_t mask, uint32_t base, bool full)
+{
+#if defined(SIMD_MATH_AVX2)
+    if (full)
+    {
+        __m128i packed = _mm_loadl_epi64((const __m128i *)&frustum_compact_table()[mask]);
+        __m256i lanes = _mm256_add_epi32(_mm256_cvtepu8_epi32(packed), _mm256_set1_epi32((int)base));
+        _mm256_storeu_si256((__m256i *)(visible + n), lanes);
+        return n + frustum_bit_count(mask);
+    }
+#endif
+    (void)full;
+    while (mask)
+    {
+        visible[n++] = base + frustum_lowest_bit(mask);
+        mask &= mask - 1;
+    }
+    return n;
+}
+
+// indices in [begin, end) of the spheres that intersect the frustum go to visible, which
+// needs room for end - begin of them. begin has to be a multiple of SIMD_MATH_WIDTH so ranges
+// can be culled in parallel, returns the number written
+inline uint32_t
+frustum_cull_spheres(const frustum *f, const frustum_bounds *spheres, size_t begin, size_t end, uint32_t *visible)
+{
+    const float *cx = frustum_bounds_stream(spheres, 0);
+    const float *cy = frustum_bounds_stream(spheres, 1);
+    const float *cz = frustum_bounds_stream(spheres, 2);
+    const float *radius = frustum_bounds_stream(spheres, 3);
+
+    vf planes[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int i = 0; i < 4; ++i)
+            planes[p][i] = vf_splat(f->planes[p][i]);
+
+    vf zero = vf_splat(0.0f);
+    uint32_t n = 0;
+    for (size_t i = begin; i < end; i += SIMD_MATH_WIDTH)
+    {
+        vf x = vf_load(cx + i);
+        vf y = vf_load(cy + i);
+        vf z = vf_load(cz + i);
+        vf neg_r = vf_sub(zero, vf_load(radius + i));
+
+        // inside unless the center is further than the radius behind any plane
+        vf inside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            vf d = vf_madd(x, planes[p][0], vf_madd(y, planes[p][1], vf_madd(z, planes[p][2], planes[p][3])));
+            vf in_plane = vf_cmp_ge(d, neg_r);
+            inside = p == 0 ? in_plane : vf_and(inside, in_plane);
+        }
+
+        uint32_t mask = vf_mask_bits(inside);
+        bool full = i + SIMD_MATH_WIDTH <= end;
+        if (full == false)
+            mask &= (1u << (end - i)) - 1;
+        n = frustum_emit(visible, n, mask, (uint32_t)i, full);
+    }
+    return n;
+}
+
+// same for boxes, a box is outside when its corner furthest along the plane normal is
+// behind the plane. that corner's distance is dot(n, center) + d + dot(|n|, extent)
+inline uint32_t
+frustum_cull_aabbs(const frustum *f, const frustum_bounds *boxes, size_t begin, size_t end, uint32_t *visible)
+{
+    const float *cx = frustum_bounds_stream(boxes, 0);
+    const float *cy = frustum_bounds_stream(boxes, 1);
+    const float *cz = frustum_bounds_stream(boxes, 2);
+    const float *ex = frustum_bounds_stream(boxes, 3);
+    const float *ey = frustum_bounds_stream(boxes, 4);
+    const float *ez = frustum_bounds_stream(boxes, 5);
+
+    vf planes[6][4];
+    vf abs_normals[6][3];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int i = 0; i < 4; ++i)
+            planes[p][i] = vf_splat(f->planes[p][i]);
+        for (int i = 0; i < 3; ++i)
+            abs_normals[p][i] = vf_splat(fabsf(f->planes[p][i]));
+    }
+
+    vf zero = vf_splat(0.0f);
+    uint32_t n = 0;
+    for (size_t i = begin; i < end; i += SIMD_MATH_WIDTH)
+    {
+        vf x = vf_load(cx + i);
+        vf y = vf_load(cy + i);
+        vf z = vf_load(cz + i);
+        vf hx = vf_load(ex + i);
+        vf hy = vf_load(ey + i);
+        vf hz = vf_load(ez + i);
+
+        vf inside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            vf d = vf_madd(x, planes[p][0], vf_madd(y, planes[p][1], vf_madd(z, planes[p][2], planes[p][3])));
+            vf r = vf_madd(hx, abs_normals[p][0], vf_madd(hy, abs_normals[p][1], vf_mul(hz, abs_normals[p][2])));
+            vf in_plane = vf_cmp_ge(vf_add(d, r), zero);
+            inside = p == 0 ? in_plane : vf_and(inside, in_plane);
+        }
+
+        uint32_t mask = vf_mask_bits(inside);
+        bool full = i + SIMD_MATH_WIDTH <= end;
+        if (full == false)
+            mask &= (1u << (end - i)) - 1;
+        n = frustum_emit(visible, n, mask, (uint32_t)i, full);
+    }
+    return n;
+}
+
+// one sphere at a time without SIMD, the reference the batch versions are checked against
+inline bool
+frustum_test_sphere(const frustum *f, float x, float y, float z, float radius)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float *plane = f->planes[p];
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+            return false;
+    }
+    return true;
+}
+
+inline bool
+frustum_test_aabb(const frustum *f, const float center[3], const float extent[3])
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float *plane = f->planes[p];
+        float d = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+        float r = fabsf(plane[0]) * extent[0] + fabsf(plane[1]) * extent[1] + fabsf(plane[2]) * extent[2];
+        if (d + r < 0.0f)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,231 @@
+// example_cubes rendered without a window or gpu through the software rasterizer in sw_raster.h,
+// every frame is split into simulation, constants, submit and flush phases whose timing is
+// summarized at exit and optionally dumped per frame as csv and json. built with
+// PROFILE_ENABLED (build.sh -p) -p writes the rasterizer zones as a chrome trace.
+// usage: headless_cubes [-w width] [-h height] [-f frames] [-t threads] [-o out.ppm] [-c timing.csv] [-j timing.json] [-p trace.json]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "frame_timing.h"
+#include "simd_math.h"
+#include "sw_raster.h"
+
+enum frame_phase
+{
+    PHASE_SIMULATION,
+    PHASE_CONSTANTS,
+    PHASE_SUBMIT,
+    PHASE_FLUSH,
+    PHASE_COUNT
+};
+
+static const char *phase_names[PHASE_COUNT] = {"simulation", "constants", "submit", "flush"};
+
+static sw_float4
+ps_main(const sw_pixel_input *input, const void *const *constant_buffers)
+{
+    const sw_float4 *colors = (const sw_float4 *)constant_buffers[0];
+    return colors[input->primitive_id / 2];
+}
+
+static bool
+write_ppm(const char *path, const sw_render_target *rt)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", rt->width, rt->height);
+    for (int i = 0; i < rt->width * rt->height; ++i)
+    {
+        uint32_t c = rt->color[i];
+        unsigned char rgb[3] = {(unsigned char)(c & 0xff), (unsigned char)((c >> 8) & 0xff), (unsigned char)((c >> 16) & 0xff)};
+        fwrite(rgb, 1, 3, file);
+    }
+    fclose(file);
+    return true;
+}
+
+int
+main(int argc, char **argv)
+{
+    int width = 1280;
+    int height = 720;
+    int frames = 1000;
+    int threads = 0;
+    const char *out_path = "headless_cubes.ppm";
+    const char *csv_path = nullptr;
+    const char *json_path = nullptr;
+    const char *trace_path = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-w") == 0)
+            width = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-h") == 0)
+            height = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-f") == 0)
+            frames = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0)
+            threads = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0)
+            out_path = argv[i + 1];
+        else if (strcmp(argv[i], "-c") == 0)
+            csv_path = argv[i + 1];
+        else if (strcmp(argv[i], "-j") == 0)
+            json_path = argv[i + 1];
+        else if (strcmp(argv[i], "-p") == 0)
+            trace_path = argv[i + 1];
+    }
+
+    PROFILE_THREAD_NAME("main");
+    thread_pool pool;
+    thread_pool_init(&pool, threads);
+
+    // create offscreen color and depth targets
+    sw_render_target render_target;
+    if (sw_render_target_init(&render_target, width, height) == false)
+    {
+        fprintf(stderr, "Failed to create render target\n");
+        return 1;
+    }
+
+    sw_context context;
+    sw_context_init(&context, &pool);
+
+    float vertices[] = {
+        // position
+        -1.0f, -1.0f, -1.0f,
+         1.0f, -1.0f, -1.0f,
+        -1.0f,  1.0f, -1.0f,
+         1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,
+         1.0f, -1.0f,  1.0f,
+        -1.0f,  1.0f,  1.0f,
+         1.0f,  1.0f,  1.0f
+    };
+
+    unsigned int indices[] = {
+        // clockwise
+        0, 2, 3,  0, 3, 1,
+        1, 3, 7,  1, 7, 5,
+        5, 7, 6,  5, 6, 4,
+        4, 6, 2,  4, 2, 0,
+        2, 6, 7,  2, 7, 3,
+        0, 1, 5,  0, 5, 4
+    };
+
+    float colors[] = {
+        1.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, 1.0f, 1.0f,
+        1.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 1.0f
+    };
+
+    // stands in for the dynamic transform cbuffer
+    mat4 transform_cbuffer;
+
+    sw_viewport viewport = {};
+    viewport.width = (float)width;
+    viewport.height = (float)height;
+    viewport.min_depth = 0.0f;
+    viewport.max_depth = 1.0f;
+
+    mat4 proj = mat4_perspective_fov_lh(simd_radians(60.0f), viewport.width / viewport.height, 0.1f, 100.0f);
+
+    frame_timing timing;
+    frame_timing_init(&timing, PHASE_COUNT, phase_names);
+
+    auto start = std::chrono::steady_clock::now();
+
+    float angle = 0.0f;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        frame_timing_begin_frame(&timing);
+
+        angle += (1.0f / 60.0f);
+        frame_timing_mark(&timing, PHASE_SIMULATION);
+
+        float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        sw_om_set_render_target(&context, &render_target);
+        sw_clear_render_target(&context, clear_color);
+        sw_clear_depth(&context, 1.0f);
+
+        sw_ia_set_vertex_buffer(&context, vertices, 3 * sizeof(float), 0);
+        sw_ia_set_index_buffer(&context, indices, 0);
+        sw_ps_set_shader(&context, ps_main);
+        sw_vs_set_constant_buffer(&context, 0, &transform_cbuffer);
+        sw_ps_set_constant_buffer(&context, 0, colors);
+        sw_rs_set_viewport(&context, &viewport);
+        sw_om_set_depth_state(&context, true, true, SW_COMPARISON_LESS);
+
+        frame_timing_mark(&timing, PHASE_SUBMIT);
+
+        // first cube
+        transform_cbuffer = mat4_transpose(
+            mat4_rotation_x(angle) *
+            mat4_rotation_y(angle) *
+            mat4_rotation_z(angle) *
+            mat4_translation(0.0f, 0.0f, 5.0f) *
+            proj
+        );
+        frame_timing_mark(&timing, PHASE_CONSTANTS);
+        sw_draw_indexed(&context, 36, 0, 0);
+        frame_timing_mark(&timing, PHASE_SUBMIT);
+
+        // second cube
+        transform_cbuffer = mat4_transpose(
+            mat4_rotation_x(angle / 2.0f) *
+            mat4_rotation_y(angle / 2.0f) *
+            mat4_rotation_z(angle / 2.0f) *
+            mat4_translation(0.0f, 0.0f, 5.0f) *
+            proj
+        );
+        frame_timing_mark(&timing, PHASE_CONSTANTS);
+        sw_draw_indexed(&context, 36, 0, 0);
+        frame_timing_mark(&timing, PHASE_SUBMIT);
+
+        sw_flush(&context);
+        frame_timing_mark(&timing, PHASE_FLUSH);
+        frame_timing_end_frame(&timing);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%d frames at %dx%d on %d threads: %.3f ms/frame, %.1f fps\n",
+        frames, width, height, thread_pool_size(&pool), seconds * 1000.0 / frames, frames / seconds);
+    printf("triangles in %llu, culled %llu, rasterized %llu, tiles touched %llu\n",
+        (unsigned long long)context.stats.triangles_in,
+        (unsigned long long)context.stats.triangles_culled,
+        (unsigned long long)context.stats.triangles_rasterized,
+        (unsigned long long)context.stats.tiles_touched);
+    frame_timing_print(&timing, stdout);
+
+    if (csv_path && frame_timing_write_csv(&timing, csv_path) == false)
+        fprintf(stderr, "Failed to write %s\n", csv_path);
+    if (json_path && frame_timing_write_json(&timing, json_path) == false)
+        fprintf(stderr, "Failed to write %s\n", json_path);
+    if (trace_path)
+    {
+#if defined(PROFILE_ENABLED)
+        if (profile_write_chrome_trace(trace_path) == false)
+            fprintf(stderr, "Failed to write %s\n", trace_path);
+#else
+        fprintf(stderr, "-p needs a build with PROFILE_ENABLED (build.sh -p)\n");
+#endif
+    }
+
+    if (write_ppm(out_path, &render_target) == false)
+        fprintf(stderr, "Failed to write %s\n", out_path);
+
+    frame_timing_free(&timing);
+    sw_render_target_free(&render_target);
+    thread_pool_shutdown(&pool);
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+// rgba8 image loading for the offline tools. binary ppm (P6) always works, everything else
+// goes through stb_image when the stb submodule is checked out
+
+#if defined(__has_include)
+    #if __has_include("stb/stb_image.h")
+        #define IMAGE_IO_STB 1
+    #endif
+#endif
+
+#if defined(IMAGE_IO_STB)
+    #define STB_IMAGE_IMPLEMENTATION
+    #include "stb/stb_image.h"
+#endif
+
+inline uint8_t *
+image_load_ppm(FILE *file, int *width, int *height)
+{
+    int max_value = 0;
+    if (fscanf(file, "P6 %d %d %d", width, height, &max_value) != 3 || max_value != 255 || fgetc(file) == EOF)
+        return nullptr;
+    if (*width <= 0 || *height <= 0)
+        return nullptr;
+
+    size_t pixel_count = (size_t)*width * *height;
+    uint8_t *pixels = (uint8_t *)malloc(pixel_count * 4);
+    if (pixels == nullptr)
+        return nullptr;
+    if (fread(pixels, 3, pixel_count, file) != pixel_count)
+    {
+        free(pixels);
+        return nullptr;
+    }
+
+    // expand rgb to rgba in place, back to front
+    for (size_t i = pixel_count; i-- > 0;)
+    {
+        pixels[i * 4 + 3] = 255;
+        pixels[i * 4 + 2] = pixels[i * 3 + 2];
+        pixels[i * 4 + 1] = pixels[i * 3 + 1];
+        pixels[i * 4 + 0] = pixels[i * 3 + 0];
+    }
+    return pixels;
+}
+
+// returns tightly packed rgba8 pixels to be released with image_free, or null
+inline uint8_t *
+image_load(const char *path, int *width, int *height)
+{
+    PROFILE_ZONE("image decode");
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return nullptr;
+
+    uint8_t *pixels = nullptr;
+    char magic[2] = {};
+    if (fread(magic, 1, 2, file) == 2 && magic[0] == 'P' && magic[1] == '6')
+    {
+        fseek(file, 0, SEEK_SET);
+        pixels = image_load_ppm(file, width, height);
+    }
+#if defined(IMAGE_IO_STB)
+    else
+    {
+        fseek(file, 0, SEEK_SET);
+        int channels = 0;
+        pixels = stbi_load_from_file(file, width, height, &channels, 4);
+    }
+#endif
+    fclose(file);
+    return pixels;
+}
+
+// reads the next whitespace separated decimal number of a ppm header
+inline bool
+image_ppm_header_value(const uint8_t **at, const uint8_t *end, int *value)
+{
+    const uint8_t *p = *at;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        ++p;
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    int v = 0;
+    while (p < end && *p >= '0' && *p <= '9' && v < (1 << 24))
+        v = v * 10 + (*p++ - '0');
+    *at = p;
+    *value = v;
+    return true;
+}
+
+// same as image_load for a file that is already in memory, for loaders that do their own reads
+inline uint8_t *
+image_load_memory(const uint8_t *data, size_t size, int *width, int *height)
+{
+    PROFILE_ZONE("image decode");
+    if (size >= 2 && data[0] == 'P' && data[1] == '6')
+    {
+        const uint8_t *at = data + 2;
+        const uint8_t *end = data + size;
+        int max_value = 0;
+        if (image_ppm_header_value(&at, end, width) == false || image_ppm_header_value(&at, end, height) == false ||
+            image_ppm_header_value(&at, end, &max_value) == false || max_value != 255 || at == end)
+            return nullptr;
+        ++at;
+        if (*width <= 0 || *height <= 0)
+            return nullptr;
+
+        size_t pixel_count = (size_t)*width * *height;
+        if ((size_t)(end - at) / 3 < pixel_count)
+            return nullptr;
+        uint8_t *pixels = (uint8_t *)malloc(pixel_count * 4);
+        if (pixels == nullptr)
+            return nullptr;
+        for (size_t i = 0; i < pixel_count; ++i)
+        {
+            pixels[i * 4 + 0] = at[i * 3 + 0];
+            pixels[i * 4 + 1] = at[i * 3 + 1];
+            pixels[i * 4 + 2] = at[i * 3 + 2];
+            pixels[i * 4 + 3] = 255;
+        }
+        return pixels;
+    }
+#if defined(IMAGE_IO_STB)
+    if (size <= (size_t)0x7fffffff)
+    {
+        int channels = 0;
+        return stbi_load_from_memory(data, (int)size, width, height, &channels, 4);
+    }
+#endif
+    return nullptr;
+}
+
+inline void
+image_free(uint8_t *pixels)
+{
+    free(pixels);
+}
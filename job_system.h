@@ -0,0 +1,631 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "profile.h"
+
+// work stealing job system. every thread owns a chase-lev deque (le, pop, cohen and
+// zappa nardelli, "correct and efficient work-stealing for weak memory models"): it pushes
+// and pops its own jobs at the bottom without locks while idle threads steal the oldest
+// ones from the top, so fan out stays local until somebody runs dry.
+//
+//     job_counter counter;
+//     job_run(&jobs, decode_texture, &textures[i], &counter);   // any number of them
+//     job_run_after(&jobs, &counter, build_mips, &mips, &done);  // once all decodes finished
+//     job_wait(&jobs, &done);                                    // runs jobs while it waits
+//
+// the thread that calls job_system_init is worker 0 and takes part in the work whenever it
+// waits. job_run_main queues a job that only ever runs on that thread, from
+// job_system_pump_main or a job_wait there, for calls like d3d11 device context ones that
+// must not move between threads. threads outside the system can queue and wait too, their
+// jobs go through a locked inbox.
+//
+// job_parallel_for splits its range lazily: a worker keeps halving what is left of its range
+// and pushes the upper half only while its own deque is empty, which is exactly when another
+// thread may want to steal it. uneven work and oversubscription balance without a tuned
+// chunk size. calls nest freely.
+
+#define JOB_DEQUE_CAPACITY 4096 // jobs queued per thread, a full deque runs the job right away
+#define JOB_POOL_SIZE 1024      // job records per thread, reused round robin
+#define JOB_SPIN_COUNT 64       // empty polls before a worker sleeps
+
+// with JOB_PROFILE_ZONES defined every job records a "job" zone. off by default, parallel_for
+// and the cull passes run enough jobs to fill the profiler's per thread buffers and push out
+// the zones callers put around their own work
+
+struct job_counter;
+
+struct job
+{
+    void (*fn)(void *user);                                     // plain jobs
+    void (*range_fn)(void *user, uint32_t begin, uint32_t end); // parallel for ranges
+    void *user;
+    uint32_t begin;
+    uint32_t end;
+    job_counter *counter;
+    job *next;                   // in the waiting list of a counter
+    std::atomic<uint32_t> state; // 0 free, 1 in use
+    bool heap;                   // allocated, not one of a worker's records
+};
+
+// number of jobs still to finish. jobs waiting for it to reach 0 hang off it, the list is
+// only touched under the mutex
+struct job_counter
+{
+    std::atomic<int> value{0};
+    std::mutex mutex;
+    job *waiting = nullptr;
+};
+
+// top and bottom on their own cache lines, thieves hammer one and the owner the other
+struct job_deque
+{
+    std::atomic<int64_t> top;
+    uint8_t top_padding[56];
+    std::atomic<int64_t> bottom;
+    uint8_t bottom_padding[56];
+    std::atomic<job *> slots[JOB_DEQUE_CAPACITY];
+};
+
+struct job_system;
+
+struct job_worker
+{
+    job_system *system;
+    int index;
+    job_deque deque;
+    job jobs[JOB_POOL_SIZE];
+    uint32_t next_job;
+    uint32_t random;
+    job_worker *previous; // the thread's worker before job_system_init, worker 0 only
+};
+
+struct job_main_call
+{
+    void (*fn)(void *user);
+    void *user;
+    job_counter *counter;
+};
+
+struct job_system
+{
+    std::vector<job_worker *> workers;
+    std::vector<std::thread> threads;
+
+    // jobs from threads outside the system
+    std::mutex inbox_mutex;
+    std::vector<job *> inbox;
+    std::atomic<int> inbox_count;
+
+    // jobs for worker 0 only
+    std::mutex main_mutex;
+    std::vector<job_main_call> main_queue;
+    std::atomic<int> main_count;
+
+    // queued jobs nobody picked up yet, sleeping workers wait for it to turn positive
+    std::atomic<int> pending;
+    std::atomic<int> sleeping;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> quit;
+};
+
+inline job_worker *&
+job_current_worker()
+{
+    static thread_local job_worker *worker = nullptr;
+    return worker;
+}
+
+// the calling thread's worker in system, null for threads outside it
+inline job_worker *
+job_worker_of(job_system *system)
+{
+    job_worker *worker = job_current_worker();
+    return worker && worker->system == system ? worker : nullptr;
+}
+
+//
+// chase-lev deque
+//
+
+inline bool
+job_deque_push(job_deque *deque, job *j)
+{
+    int64_t b = deque->bottom.load(std::memory_order_relaxed);
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    if (b - t >= JOB_DEQUE_CAPACITY)
+        return false;
+    deque->slots[b & (JOB_DEQUE_CAPACITY - 1)].store(j, std::memory_order_relaxed);
+    deque->bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+// owner only, newest first
+inline job *
+job_deque_pop(job_deque *deque)
+{
+    int64_t b = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = deque->top.load(std::memory_order_relaxed);
+    if (t > b)
+    {
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    job *j = deque->slots[b & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // the last one, a thief may be after it too
+        if (deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+            j = nullptr;
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return j;
+}
+
+// any thread, oldest first. null when empty or another thread won the race for the job
+inline job *
+job_deque_steal(job_deque *deque)
+{
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = deque->bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+
+    job *j = deque->slots[t & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+        return nullptr;
+    return j;
+}
+
+inline bool
+job_deque_empty(const job_deque *deque)
+{
+    return deque->bottom.load(std::memory_order_relaxed) <= deque->top.load(std::memory_order_relaxed);
+}
+
+//
+// scheduling
+//
+
+inline void job_execute(job_system *system, job *j);
+inline bool job_help(job_system *system);
+
+inline job *
+job_alloc(job_system *system, void *user, job_counter *counter)
+{
+    job_worker *worker = job_worker_of(system);
+    job *j = nullptr;
+    if (worker)
+    {
+        // a record still in use means a lot of jobs are in flight. run one of them and try
+        // again, but never wait for it: it may belong to a job further up this very stack
+        j = &worker->jobs[worker->next_job++ & (JOB_POOL_SIZE - 1)];
+        if (j->state.load(std::memory_order_acquire) != 0)
+        {
+            job_help(system);
+            if (j->state.load(std::memory_order_acquire) != 0)
+                j = nullptr;
+        }
+    }
+    if (j)
+    {
+        j->heap = false;
+    }
+    else
+    {
+        j = new job;
+        j->heap = true;
+    }
+    j->fn = nullptr;
+    j->range_fn = nullptr;
+    j->user = user;
+    j->begin = 0;
+    j->end = 0;
+    j->counter = counter;
+    j->next = nullptr;
+    j->state.store(1, std::memory_order_relaxed);
+    return j;
+}
+
+inline void
+job_push(job_system *system, job *j)
+{
+    job_worker *worker = job_worker_of(system);
+    if (worker)
+    {
+        if (job_deque_push(&worker->deque, j) == false)
+        {
+            job_execute(system, j);
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(system->inbox_mutex);
+        system->inbox.push_back(j);
+        system->inbox_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    system->pending.fetch_add(1, std::memory_order_seq_cst);
+    if (system->sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        std::lock_guard<std::mutex> lock(system->sleep_mutex);
+        system->wake.notify_one();
+    }
+}
+
+// own deque first, then the inbox, then steal from the others starting at a random one
+inline job *
+job_next(job_system *system)
+{
+    job_worker *worker = job_worker_of(system);
+    job *j = worker ? job_deque_pop(&worker->deque) : nullptr;
+    if (j == nullptr && system->inbox_count.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(system->inbox_mutex);
+        if (system->inbox.empty() == false)
+        {
+            j = system->inbox.back();
+            system->inbox.pop_back();
+            system->inbox_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    if (j == nullptr)
+    {
+        int count = (int)system->workers.size();
+        uint32_t start = 0;
+        if (worker)
+        {
+            worker->random = worker->random * 1664525u + 1013904223u;
+            start = worker->random >> 8;
+        }
+        for (int i = 0; i < count && j == nullptr; ++i)
+        {
+            job_worker *victim = system->workers[(start + (uint32_t)i) % (uint32_t)count];
+            if (victim != worker)
+                j = job_deque_steal(&victim->deque);
+        }
+    }
+    if (j)
+        system->pending.fetch_sub(1, std::memory_order_relaxed);
+    return j;
+}
+
+inline void
+job_counter_add(job_counter *counter, int count)
+{
+    if (counter)
+        counter->value.fetch_add(count, std::memory_order_relaxed);
+}
+
+// the jobs waiting for the counter go out when it reaches 0. the last decrement happens under
+// the mutex and job_wait takes the mutex once after seeing 0, so a counter on the waiter's
+// stack stays alive until the releasing thread let go of it
+inline void
+job_counter_done(job_system *system, job_counter *counter)
+{
+    if (counter == nullptr)
+        return;
+    int value = counter->value.load(std::memory_order_relaxed);
+    while (value > 1)
+    {
+        if (counter->value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    job *waiting = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            waiting = counter->waiting;
+            counter->waiting = nullptr;
+        }
+    }
+    while (waiting)
+    {
+        job *next = waiting->next;
+        job_push(system, waiting);
+        waiting = next;
+    }
+}
+
+inline void
+job_execute(job_system *system, job *j)
+{
+#if defined(JOB_PROFILE_ZONES)
+    PROFILE_ZONE("job");
+#endif
+    job_counter *counter = j->counter;
+    if (j->range_fn)
+        j->range_fn(j->user, j->begin, j->end);
+    else
+        j->fn(j->user);
+    if (j->heap)
+        delete j;
+    else
+        j->state.store(0, std::memory_order_release);
+    job_counter_done(system, counter);
+}
+
+// runs the main thread queue, call it once per frame on the thread that created the system.
+// returns the number of jobs run
+inline int
+job_system_pump_main(job_system *system)
+{
+    if (system->main_count.load(std::memory_order_acquire) == 0)
+        return 0;
+
+    std::vector<job_main_call> calls;
+    {
+        std::lock_guard<std::mutex> lock(system->main_mutex);
+        calls.swap(system->main_queue);
+        system->main_count.store(0, std::memory_order_relaxed);
+    }
+    for (const job_main_call &call : calls)
+    {
+        call.fn(call.user);
+        job_counter_done(system, call.counter);
+    }
+    return (int)calls.size();
+}
+
+// runs one job if there is one, worker 0 also takes main thread jobs
+inline bool
+job_help(job_system *system)
+{
+    job_worker *worker = job_worker_of(system);
+    if (worker && worker->index == 0 && job_system_pump_main(system) > 0)
+        return true;
+    job *j = job_next(system);
+    if (j == nullptr)
+        return false;
+    job_execute(system, j);
+    return true;
+}
+
+inline void
+job_worker_main(job_system *system, job_worker *worker)
+{
+    PROFILE_THREAD_NAME("job worker");
+    job_current_worker() = worker;
+    int idle = 0;
+    while (system->quit.load(std::memory_order_relaxed) == false)
+    {
+        if (job_help(system))
+        {
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOB_SPIN_COUNT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // sleep until a push; pushes read sleeping after bumping pending, so one of the two
+        // sides sees the other
+        std::unique_lock<std::mutex> lock(system->sleep_mutex);
+        system->sleeping.fetch_add(1, std::memory_order_seq_cst);
+        system->wake.wait(lock, [&] {
+            return system->pending.load(std::memory_order_seq_cst) > 0 || system->quit.load(std::memory_order_relaxed);
+        });
+        system->sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        idle = 0;
+    }
+    job_current_worker() = nullptr;
+}
+
+//
+// api
+//
+
+// thread_count is the total number of threads including the caller, 0 uses all cores
+inline void
+job_system_init(job_system *system, int thread_count = 0)
+{
+    if (thread_count <= 0)
+        thread_count = (int)std::thread::hardware_concurrency();
+    if (thread_count <= 0)
+        thread_count = 1;
+
+    system->inbox_count.store(0);
+    system->main_count.store(0);
+    system->pending.store(0);
+    system->sleeping.store(0);
+    system->quit.store(false);
+    for (int i = 0; i < thread_count; ++i)
+    {
+        job_worker *worker = new job_worker;
+        worker->system = system;
+        worker->index = i;
+        worker->deque.top.store(0);
+        worker->deque.bottom.store(0);
+        for (job &j : worker->jobs)
+            j.state.store(0);
+        worker->next_job = 0;
+        worker->random = 0x9e3779b9u * (uint32_t)(i + 1);
+        worker->previous = nullptr;
+        system->workers.push_back(worker);
+    }
+
+    job_worker *main_worker = system->workers[0];
+    main_worker->previous = job_current_worker();
+    job_current_worker() = main_worker;
+    for (int i = 1; i < thread_count; ++i)
+        system->threads.emplace_back(job_worker_main, system, system->workers[i]);
+}
+
+// every job has to be finished, call on the thread that called job_system_init
+inline void
+job_system_shutdown(job_system *system)
+{
+    {
+        std::lock_guard<std::mutex> lock(system->sleep_mutex);
+        system->quit.store(true);
+    }
+    system->wake.notify_all();
+    for (std::thread &thread : system->threads)
+        thread.join();
+    system->threads.clear();
+
+    // unlink worker 0 from the thread's chain, systems don't have to be shut down in reverse order
+    job_worker *main_worker = system->workers[0];
+    job_worker **link = &job_current_worker();
+    while (*link && *link != main_worker)
+        link = &(*link)->previous;
+    if (*link)
+        *link = main_worker->previous;
+    for (job_worker *worker : system->workers)
+        delete worker;
+    system->workers.clear();
+}
+
+inline int
+job_system_thread_count(const job_system *system)
+{
+    return (int)system->workers.size();
+}
+
+// queues fn(user). counter may be null, otherwise it goes up by one until the job finished
+inline void
+job_run(job_system *system, void (*fn)(void *user), void *user, job_counter *counter = nullptr)
+{
+    job_counter_add(counter, 1);
+    job *j = job_alloc(system, user, counter);
+    j->fn = fn;
+    job_push(system, j);
+}
+
+// same, but the job is only queued once dependency reached 0
+inline void
+job_run_after(job_system *system, job_counter *dependency, void (*fn)(void *user), void *user, job_counter *counter = nullptr)
+{
+    job_counter_add(counter, 1);
+    job *j = job_alloc(system, user, counter);
+    j->fn = fn;
+    if (dependency)
+    {
+        std::unique_lock<std::mutex> lock(dependency->mutex);
+        if (dependency->value.load(std::memory_order_acquire) > 0)
+        {
+            j->next = dependency->waiting;
+            dependency->waiting = j;
+            return;
+        }
+    }
+    job_push(system, j);
+}
+
+// queues fn(user) for the thread that created the system
+inline void
+job_run_main(job_system *system, void (*fn)(void *user), void *user, job_counter *counter = nullptr)
+{
+    job_counter_add(counter, 1);
+    std::lock_guard<std::mutex> lock(system->main_mutex);
+    system->main_queue.push_back({fn, user, counter});
+    system->main_count.fetch_add(1, std::memory_order_release);
+}
+
+// runs other jobs until counter reaches 0
+inline void
+job_wait(job_system *system, job_counter *counter)
+{
+    while (counter->value.load(std::memory_order_acquire) > 0)
+    {
+        if (job_help(system) == false)
+            std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(counter->mutex);
+}
+
+template <typename F>
+struct job_parallel_for_state
+{
+    job_system *system;
+    F *fn;
+    uint32_t grain;
+    job_counter counter;
+};
+
+// runs [begin, end), splitting off the upper half while the thread's queue is empty
+template <typename F>
+inline void
+job_parallel_for_range(void *user, uint32_t begin, uint32_t end)
+{
+    job_parallel_for_state<F> *state = (job_parallel_for_state<F> *)user;
+    job_system *system = state->system;
+    job_worker *worker = job_worker_of(system);
+    while (end - begin > state->grain)
+    {
+        // threads outside the system have no deque to split into
+        bool starving = worker && job_deque_empty(&worker->deque);
+        if (starving)
+        {
+            uint32_t middle = begin + (end - begin) / 2;
+            job_counter_add(&state->counter, 1);
+            job *j = job_alloc(system, user, &state->counter);
+            j->range_fn = job_parallel_for_range<F>;
+            j->begin = middle;
+            j->end = end;
+            job_push(system, j);
+            end = middle;
+            continue;
+        }
+        for (uint32_t i = begin; i < begin + state->grain; ++i)
+            (*state->fn)((int)i);
+        begin += state->grain;
+    }
+    for (uint32_t i = begin; i < end; ++i)
+        (*state->fn)((int)i);
+}
+
+// calls fn(index) for every index in [0, count) and returns when all of them are done. grain
+// is the smallest run of indices a job takes, 0 picks one from count and the thread count
+template <typename F>
+inline void
+job_parallel_for(job_system *system, int count, F &&fn, int grain = 0)
+{
+    if (count <= 0)
+        return;
+    typedef typename std::remove_reference<F>::type fn_type;
+    if (count == 1 || system->workers.size() < 2)
+    {
+        for (int i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    job_parallel_for_state<fn_type> state;
+    state.system = system;
+    state.fn = &fn;
+    uint32_t auto_grain = (uint32_t)count / ((uint32_t)system->workers.size() * 64u);
+    state.grain = grain > 0 ? (uint32_t)grain : (auto_grain > 0 ? auto_grain : 1);
+
+    // threads outside the system can't split, they hand the whole range to the inbox
+    if (job_worker_of(system) == nullptr)
+    {
+        job_counter_add(&state.counter, 1);
+        job *j = job_alloc(system, &state, &state.counter);
+        j->range_fn = job_parallel_for_range<fn_type>;
+        j->end = (uint32_t)count;
+        job_push(system, j);
+    }
+    else
+    {
+        job_parallel_for_range<fn_type>(&state, 0, (uint32_t)count);
+    }
+    job_wait(system, &state.counter);
+}
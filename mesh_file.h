@@ -0,0 +1,270 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mesh_quantize.h"
+
+#if defined(_WIN32)
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// cooked mesh container. a fixed header followed by the interleaved vertices and the indices
+// exactly as mesh_encode wrote them, each at a MESH_FILE_ALIGNMENT boundary. the file is
+// mapped read-only and mesh_file_vertices and mesh_file_indices go straight into pSysMem,
+// nothing is parsed or copied before CreateBuffer. the header carries the input layout and
+// the dequantize transform.
+
+#define MESH_FILE_MAGIC 0x48534d43 // "CMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGNMENT 16
+
+enum mesh_file_semantic
+{
+    MESH_FILE_SEMANTIC_POSITION,
+    MESH_FILE_SEMANTIC_TEXCOORD,
+    MESH_FILE_SEMANTIC_COLOR,
+    MESH_FILE_SEMANTIC_COUNT,
+};
+
+struct mesh_file_element
+{
+    uint32_t semantic; // mesh_file_semantic
+    uint32_t format;   // mesh_format
+    uint32_t offset;
+    uint32_t reserved;
+};
+
+struct mesh_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t stride;
+    uint32_t index_format;
+    uint32_t element_count;
+    uint32_t reserved;
+    float position_scale[3];
+    float position_offset[3];
+    float uv_scale_offset[4];
+    float reserved_floats[2];
+    mesh_file_element elements[MESH_MAX_ELEMENTS];
+    uint64_t vertex_offset; // from the start of the file
+    uint64_t vertex_size;
+    uint64_t index_offset;
+    uint64_t index_size;
+    uint64_t file_size;
+    uint64_t reserved_offset;
+};
+
+struct mesh_file
+{
+    const uint8_t *data;
+    size_t size;
+    const mesh_file_header *header;
+#if defined(_WIN32)
+    HANDLE file_handle;
+    HANDLE mapping;
+#endif
+};
+
+inline const char *
+mesh_file_semantic_name(uint32_t semantic)
+{
+    static const char *names[MESH_FILE_SEMANTIC_COUNT] = {"Position", "TexCoord", "Color"};
+    return semantic < MESH_FILE_SEMANTIC_COUNT ? names[semantic] : nullptr;
+}
+
+inline uint64_t
+mesh_file_align(uint64_t offset)
+{
+    return (offset + MESH_FILE_ALIGNMENT - 1) & ~(uint64_t)(MESH_FILE_ALIGNMENT - 1);
+}
+
+inline bool
+mesh_file_write(const char *path, const mesh_encoded *encoded)
+{
+    if (encoded->vertex_count == 0 || encoded->vertex_count > UINT32_MAX || encoded->index_count > UINT32_MAX)
+        return false;
+
+    mesh_file_header header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertex_count = (uint32_t)encoded->vertex_count;
+    header.index_count = (uint32_t)encoded->index_count;
+    header.stride = encoded->stride;
+    header.index_format = encoded->index_format;
+    header.element_count = encoded->element_count;
+    memcpy(header.position_scale, encoded->position_scale, sizeof(header.position_scale));
+    memcpy(header.position_offset, encoded->position_offset, sizeof(header.position_offset));
+    memcpy(header.uv_scale_offset, encoded->uv_scale_offset, sizeof(header.uv_scale_offset));
+    for (uint32_t i = 0; i < encoded->element_count; ++i)
+    {
+        uint32_t semantic = 0;
+        while (semantic < MESH_FILE_SEMANTIC_COUNT && strcmp(mesh_file_semantic_name(semantic), encoded->elements[i].semantic) != 0)
+            semantic++;
+        if (semantic == MESH_FILE_SEMANTIC_COUNT)
+            return false;
+        header.elements[i].semantic = semantic;
+        header.elements[i].format = encoded->elements[i].format;
+        header.elements[i].offset = encoded->elements[i].offset;
+    }
+    header.vertex_offset = mesh_file_align(sizeof(header));
+    header.vertex_size = encoded->vertices.size();
+    header.index_offset = mesh_file_align(header.vertex_offset + header.vertex_size);
+    header.index_size = encoded->indices.size();
+    header.file_size = mesh_file_align(header.index_offset + header.index_size);
+
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    static const uint8_t padding[MESH_FILE_ALIGNMENT] = {};
+    size_t vertex_pad = (size_t)(header.vertex_offset - sizeof(header));
+    size_t index_pad = (size_t)(header.index_offset - header.vertex_offset - header.vertex_size);
+    size_t end_pad = (size_t)(header.file_size - header.index_offset - header.index_size);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(padding, 1, vertex_pad, file) == vertex_pad &&
+        fwrite(encoded->vertices.data(), 1, encoded->vertices.size(), file) == encoded->vertices.size() &&
+        fwrite(padding, 1, index_pad, file) == index_pad &&
+        fwrite(encoded->indices.data(), 1, encoded->indices.size(), file) == encoded->indices.size() &&
+        fwrite(padding, 1, end_pad, file) == end_pad;
+    return fclose(file) == 0 && ok;
+}
+
+inline void
+mesh_file_close(mesh_file *file)
+{
+#if defined(_WIN32)
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->mapping)
+        CloseHandle(file->mapping);
+    if (file->file_handle && file->file_handle != INVALID_HANDLE_VALUE)
+        CloseHandle(file->file_handle);
+    file->file_handle = nullptr;
+    file->mapping = nullptr;
+#else
+    if (file->data)
+        munmap((void *)file->data, file->size);
+#endif
+    file->data = nullptr;
+    file->size = 0;
+    file->header = nullptr;
+}
+
+// maps the file and checks that the header, the elements and both streams fit inside it
+inline bool
+mesh_file_open(mesh_file *file, const char *path)
+{
+    memset(file, 0, sizeof(*file));
+
+#if defined(_WIN32)
+    file->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->file_handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file->file_handle, &file_size) == FALSE || file_size.QuadPart < (LONGLONG)sizeof(mesh_file_header))
+    {
+        mesh_file_close(file);
+        return false;
+    }
+    file->mapping = CreateFileMappingA(file->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file->mapping == nullptr)
+    {
+        mesh_file_close(file);
+        return false;
+    }
+    file->data = (const uint8_t *)MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    file->size = (size_t)file_size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(mesh_file_header))
+    {
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped != MAP_FAILED)
+    {
+        file->data = (const uint8_t *)mapped;
+        file->size = (size_t)st.st_size;
+    }
+#endif
+    if (file->data == nullptr)
+    {
+        mesh_file_close(file);
+        return false;
+    }
+
+    const mesh_file_header *header = (const mesh_file_header *)file->data;
+    uint32_t index_size = header->index_format == MESH_FORMAT_R16_UINT ? 2 : 4;
+    bool valid = header->magic == MESH_FILE_MAGIC && header->version == MESH_FILE_VERSION && header->file_size <= file->size &&
+        header->element_count > 0 && header->element_count <= MESH_MAX_ELEMENTS &&
+        (header->index_format == MESH_FORMAT_R16_UINT || header->index_format == MESH_FORMAT_R32_UINT) &&
+        header->vertex_offset % MESH_FILE_ALIGNMENT == 0 && header->index_offset % MESH_FILE_ALIGNMENT == 0 &&
+        header->vertex_offset <= file->size && header->vertex_size <= file->size - header->vertex_offset &&
+        header->index_offset <= file->size && header->index_size <= file->size - header->index_offset &&
+        header->vertex_size == (uint64_t)header->vertex_count * header->stride &&
+        header->index_size == (uint64_t)header->index_count * index_size;
+    for (uint32_t i = 0; valid && i < header->element_count; ++i)
+    {
+        const mesh_file_element *element = &header->elements[i];
+        valid = element->semantic < MESH_FILE_SEMANTIC_COUNT && mesh_format_size(element->format) != 0 &&
+            element->offset + mesh_format_size(element->format) <= header->stride;
+    }
+    if (valid == false)
+    {
+        mesh_file_close(file);
+        return false;
+    }
+
+    file->header = header;
+    return true;
+}
+
+inline const void *
+mesh_file_vertices(const mesh_file *file)
+{
+    return file->data + file->header->vertex_offset;
+}
+
+inline const void *
+mesh_file_indices(const mesh_file *file)
+{
+    return file->data + file->header->index_offset;
+}
+
+// elements needs room for MESH_MAX_ELEMENTS, returns how many were written
+inline uint32_t
+mesh_file_elements(const mesh_file *file, mesh_vertex_element *elements)
+{
+    for (uint32_t i = 0; i < file->header->element_count; ++i)
+    {
+        const mesh_file_element *element = &file->header->elements[i];
+        elements[i] = {mesh_file_semantic_name(element->semantic), element->format, element->offset};
+    }
+    return file->header->element_count;
+}
+
+inline mat4
+mesh_file_dequantize_matrix(const mesh_file *file)
+{
+    const float *s = file->header->position_scale;
+    const float *o = file->header->position_offset;
+    return {{v4_set(s[0], 0, 0, 0), v4_set(0, s[1], 0, 0), v4_set(0, 0, s[2], 0), v4_set(o[0], o[1], o[2], 1)}};
+}
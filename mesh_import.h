@@ -0,0 +1,1288 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "mesh_quantize.h"
+#include "thread_pool.h"
+
+// imports triangle meshes from .obj, .gltf and .glb into float streams for mesh_encode.
+//
+// obj text is cut into MESH_IMPORT_CHUNK_SIZE pieces at line ends and every piece is parsed on
+// the thread pool into its own position, uv and triangle lists. relative (negative) indices
+// are kept relative to their piece until the piece sizes are known. position/uv pairs are
+// then welded into vertices with one hash table per range of positions, each range on its
+// own thread, and numbered in order of first use so the result doesn't depend on the thread
+// count. faces are triangulated as fans, normals are not kept.
+//
+// gltf json is parsed on the calling thread, buffers come from the glb BIN chunk, data: uris
+// or files next to the .gltf. every triangle primitive reachable from the default scene is
+// appended with its node transform, the accessor conversion runs on the pool in pieces of
+// MESH_IMPORT_BATCH elements. POSITION, TEXCOORD_0 and COLOR_0 are read, in float or
+// normalized integer components.
+//
+// both formats are right handed with counter clockwise front faces and uv (0, 0) at the bottom
+// for obj. the result is what the examples use: left handed (z negated), clockwise front faces
+// and uv (0, 0) at the top left.
+
+#define MESH_IMPORT_CHUNK_SIZE (1 << 20)
+#define MESH_IMPORT_BATCH 65536
+#define MESH_IMPORT_JSON_DEPTH 64
+
+struct mesh_data
+{
+    std::vector<float> positions; // xyz
+    std::vector<float> uvs;       // uv, empty when the source has none
+    std::vector<float> colors;    // rgba, empty when the source has none
+    std::vector<uint32_t> indices;
+};
+
+inline mesh_source
+mesh_data_source(const mesh_data *data)
+{
+    mesh_source source = {};
+    source.positions = data->positions.data();
+    source.uvs = data->uvs.empty() ? nullptr : data->uvs.data();
+    source.colors = data->colors.empty() ? nullptr : data->colors.data();
+    source.color_components = 4;
+    source.vertex_count = data->positions.size() / 3;
+    source.indices = data->indices.data();
+    source.index_count = data->indices.size();
+    return source;
+}
+
+// runs fn(index) for index in [0, count), on the pool when there is one
+template <typename F>
+inline void
+mesh_import_for(thread_pool *pool, int count, F &&fn)
+{
+    if (pool)
+    {
+        thread_pool_parallel_for(pool, count, fn);
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+        fn(i);
+}
+
+inline bool
+mesh_import_read_file(const char *path, std::vector<uint8_t> *data)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+#if defined(_WIN32)
+    bool ok = _fseeki64(file, 0, SEEK_END) == 0;
+    int64_t size = ok ? _ftelli64(file) : -1;
+    ok = ok && size >= 0 && _fseeki64(file, 0, SEEK_SET) == 0;
+#else
+    bool ok = fseeko(file, 0, SEEK_END) == 0;
+    int64_t size = ok ? (int64_t)ftello(file) : -1;
+    ok = ok && size >= 0 && fseeko(file, 0, SEEK_SET) == 0;
+#endif
+    if (ok)
+    {
+        data->resize((size_t)size);
+        ok = size == 0 || fread(data->data(), 1, (size_t)size, file) == (size_t)size;
+    }
+    fclose(file);
+    return ok;
+}
+
+// decimal with optional fraction and exponent, within an ulp of strtof. inf and nan come out
+// as 0. returns the character after the number
+inline const char *
+mesh_import_parse_float(const char *s, const char *end, float *out)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    while (s < end && (*s == ' ' || *s == '\t'))
+        s++;
+    bool negative = s < end && *s == '-';
+    if (s < end && (*s == '-' || *s == '+'))
+        s++;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    const char *start = s;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+    if (s < end && *s == '.')
+    {
+        for (++s; s < end && *s >= '0' && *s <= '9'; ++s)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (s == start)
+    {
+        while (s < end && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n')
+            s++;
+        *out = 0.0f;
+        return s;
+    }
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        const char *e = s + 1;
+        bool negative_exponent = e < end && *e == '-';
+        if (e < end && (*e == '-' || *e == '+'))
+            e++;
+        int value = 0;
+        for (; e < end && *e >= '0' && *e <= '9'; ++e)
+            value = value < 10000 ? value * 10 + (*e - '0') : value;
+        exponent += negative_exponent ? -value : value;
+        s = e;
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0)
+        value = -exponent <= 22 ? value / powers[-exponent] : value * pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * powers[exponent] : value * pow(10.0, exponent);
+    *out = (float)(negative ? -value : value);
+    return s;
+}
+
+inline const char *
+mesh_import_parse_int(const char *s, const char *end, int64_t *out)
+{
+    bool negative = s < end && *s == '-';
+    if (s < end && (*s == '-' || *s == '+'))
+        s++;
+    int64_t value = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s)
+        value = value < ((int64_t)1 << 40) ? value * 10 + (*s - '0') : value;
+    *out = negative ? -value : value;
+    return s;
+}
+
+// what one piece of obj text holds. corners are 0 based position and uv indices, the ones
+// flagged in relative count from the first position or uv of the piece and may be negative
+#define MESH_OBJ_RELATIVE_POSITION 1
+#define MESH_OBJ_RELATIVE_UV 2
+#define MESH_OBJ_NO_UV 4
+
+struct mesh_obj_chunk
+{
+    const char *begin;
+    const char *end;
+    std::vector<float> positions; // xyz
+    std::vector<float> colors;    // rgb per position once a vertex line had one
+    std::vector<float> uvs;
+    std::vector<int64_t> corners; // position, uv per triangle corner
+    std::vector<uint8_t> flags;   // MESH_OBJ_* per corner
+    bool failed;
+};
+
+inline void
+mesh_obj_parse_chunk(mesh_obj_chunk *chunk)
+{
+    std::vector<int64_t> face;
+    std::vector<uint8_t> face_flags;
+    const char *s = chunk->begin;
+    const char *end = chunk->end;
+    while (s < end)
+    {
+        const char *line_end = (const char *)memchr(s, '\n', (size_t)(end - s));
+        if (line_end == nullptr)
+            line_end = end;
+
+        while (s < line_end && (*s == ' ' || *s == '\t'))
+            s++;
+        if (line_end - s >= 2 && s[0] == 'v' && (s[1] == ' ' || s[1] == '\t'))
+        {
+            float values[6] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+            int count = 0;
+            const char *cursor = s + 2;
+            for (; count < 6; ++count)
+            {
+                while (cursor < line_end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+                    cursor++;
+                if (cursor == line_end)
+                    break;
+                cursor = mesh_import_parse_float(cursor, line_end, &values[count]);
+            }
+            chunk->positions.insert(chunk->positions.end(), values, values + 3);
+
+            // "v x y z r g b", the rest of the piece gets white for the plain ones
+            if (count >= 6 && chunk->colors.empty())
+                chunk->colors.resize(chunk->positions.size() - 3, 1.0f);
+            if (chunk->colors.empty() == false)
+                chunk->colors.insert(chunk->colors.end(), values + 3, values + 6);
+        }
+        else if (line_end - s >= 3 && s[0] == 'v' && s[1] == 't' && (s[2] == ' ' || s[2] == '\t'))
+        {
+            float u = 0.0f, v = 0.0f;
+            const char *cursor = mesh_import_parse_float(s + 3, line_end, &u);
+            mesh_import_parse_float(cursor, line_end, &v);
+            chunk->uvs.insert(chunk->uvs.end(), {u, 1.0f - v});
+        }
+        else if (line_end - s >= 2 && s[0] == 'f' && (s[1] == ' ' || s[1] == '\t'))
+        {
+            face.clear();
+            face_flags.clear();
+            int64_t position_count = (int64_t)(chunk->positions.size() / 3);
+            int64_t uv_count = (int64_t)(chunk->uvs.size() / 2);
+            const char *cursor = s + 2;
+            for (;;)
+            {
+                while (cursor < line_end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+                    cursor++;
+                if (cursor == line_end)
+                    break;
+
+                // v, v/vt, v//vn or v/vt/vn
+                int64_t position = 0, uv = 0;
+                cursor = mesh_import_parse_int(cursor, line_end, &position);
+                if (cursor < line_end && *cursor == '/')
+                {
+                    cursor++;
+                    if (cursor < line_end && *cursor != '/')
+                        cursor = mesh_import_parse_int(cursor, line_end, &uv);
+                }
+                while (cursor < line_end && *cursor != ' ' && *cursor != '\t' && *cursor != '\r')
+                    cursor++;
+                if (position == 0)
+                {
+                    chunk->failed = true;
+                    return;
+                }
+
+                uint8_t flags = 0;
+                if (position < 0)
+                {
+                    position += position_count;
+                    flags |= MESH_OBJ_RELATIVE_POSITION;
+                }
+                else
+                {
+                    position -= 1;
+                }
+                if (uv < 0)
+                {
+                    uv += uv_count;
+                    flags |= MESH_OBJ_RELATIVE_UV;
+                }
+                else if (uv == 0)
+                {
+                    flags |= MESH_OBJ_NO_UV;
+                }
+                else
+                {
+                    uv -= 1;
+                }
+                face.insert(face.end(), {position, uv});
+                face_flags.push_back(flags);
+            }
+
+            // fan, the second and third corner swap for clockwise winding
+            size_t corner_count = face_flags.size();
+            for (size_t i = 1; i + 1 < corner_count; ++i)
+            {
+                size_t triangle[3] = {0, i + 1, i};
+                for (size_t corner : triangle)
+                {
+                    chunk->corners.insert(chunk->corners.end(), {face[corner * 2], face[corner * 2 + 1]});
+                    chunk->flags.push_back(face_flags[corner]);
+                }
+            }
+        }
+        s = line_end + 1;
+    }
+}
+
+// open addressing table from position/uv key to the first corner that used it
+struct mesh_weld_table
+{
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> corners;
+    size_t count;
+};
+
+inline uint64_t
+mesh_weld_hash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return key;
+}
+
+inline void
+mesh_weld_table_init(mesh_weld_table *table, size_t capacity)
+{
+    size_t size = 64;
+    while (size < capacity * 2)
+        size *= 2;
+    table->keys.assign(size, UINT64_MAX);
+    table->corners.assign(size, 0);
+    table->count = 0;
+}
+
+// the first corner with key, corner itself when it is the first
+inline uint32_t
+mesh_weld_table_insert(mesh_weld_table *table, uint64_t key, uint32_t corner)
+{
+    if ((table->count + 1) * 2 > table->keys.size())
+    {
+        mesh_weld_table grown;
+        mesh_weld_table_init(&grown, table->keys.size());
+        for (size_t i = 0; i < table->keys.size(); ++i)
+        {
+            if (table->keys[i] != UINT64_MAX)
+                mesh_weld_table_insert(&grown, table->keys[i], table->corners[i]);
+        }
+        *table = std::move(grown);
+    }
+
+    size_t mask = table->keys.size() - 1;
+    for (size_t slot = (size_t)mesh_weld_hash(key) & mask;; slot = (slot + 1) & mask)
+    {
+        if (table->keys[slot] == key)
+            return table->corners[slot];
+        if (table->keys[slot] == UINT64_MAX)
+        {
+            table->keys[slot] = key;
+            table->corners[slot] = corner;
+            table->count++;
+            return corner;
+        }
+    }
+}
+
+// obj text already in memory, text does not need to be zero terminated
+inline bool
+mesh_import_obj_text(const char *text, size_t size, mesh_data *out, thread_pool *pool)
+{
+    PROFILE_ZONE("mesh_import_obj_text");
+    *out = {};
+
+    // pieces end after a line end
+    std::vector<mesh_obj_chunk> chunks;
+    for (size_t offset = 0; offset < size;)
+    {
+        size_t chunk_end = offset + MESH_IMPORT_CHUNK_SIZE < size ? offset + MESH_IMPORT_CHUNK_SIZE : size;
+        const char *line_end = chunk_end < size ? (const char *)memchr(text + chunk_end, '\n', size - chunk_end) : nullptr;
+        chunk_end = line_end ? (size_t)(line_end - text) + 1 : size;
+        mesh_obj_chunk chunk = {};
+        chunk.begin = text + offset;
+        chunk.end = text + chunk_end;
+        chunks.push_back(std::move(chunk));
+        offset = chunk_end;
+    }
+    int chunk_count = (int)chunks.size();
+    mesh_import_for(pool, chunk_count, [&](int c) { mesh_obj_parse_chunk(&chunks[c]); });
+
+    // where every piece starts in the whole file
+    std::vector<size_t> position_base(chunk_count + 1, 0), uv_base(chunk_count + 1, 0), corner_base(chunk_count + 1, 0);
+    bool has_colors = false;
+    for (int c = 0; c < chunk_count; ++c)
+    {
+        if (chunks[c].failed)
+            return false;
+        position_base[c + 1] = position_base[c] + chunks[c].positions.size() / 3;
+        uv_base[c + 1] = uv_base[c] + chunks[c].uvs.size() / 2;
+        corner_base[c + 1] = corner_base[c] + chunks[c].flags.size();
+        has_colors = has_colors || chunks[c].colors.empty() == false;
+    }
+    size_t position_count = position_base[chunk_count];
+    size_t uv_count = uv_base[chunk_count];
+    size_t corner_count = corner_base[chunk_count];
+    if (position_count >= UINT32_MAX || uv_count >= UINT32_MAX || corner_count >= UINT32_MAX)
+        return false;
+
+    // keys of every corner, the position in the high half and uv + 1 in the low one
+    std::vector<uint64_t> keys(corner_count);
+    std::atomic<bool> failed(false);
+    mesh_import_for(pool, chunk_count, [&](int c) {
+        const mesh_obj_chunk *chunk = &chunks[c];
+        for (size_t i = 0; i < chunk->flags.size(); ++i)
+        {
+            uint8_t flags = chunk->flags[i];
+            int64_t position = chunk->corners[i * 2] + ((flags & MESH_OBJ_RELATIVE_POSITION) ? (int64_t)position_base[c] : 0);
+            int64_t uv = chunk->corners[i * 2 + 1] + ((flags & MESH_OBJ_RELATIVE_UV) ? (int64_t)uv_base[c] : 0);
+            if (flags & MESH_OBJ_NO_UV)
+                uv = -1;
+            if (position < 0 || position >= (int64_t)position_count || uv < -1 || uv >= (int64_t)uv_count)
+            {
+                failed.store(true, std::memory_order_relaxed);
+                return;
+            }
+            keys[corner_base[c] + i] = (uint64_t)position << 32 | (uint64_t)(uv + 1);
+        }
+    });
+    if (failed.load())
+        return false;
+
+    // every range of positions welds on its own thread, first[i] is the first corner with the
+    // key of corner i
+    std::vector<uint32_t> first(corner_count);
+    int ranges = pool ? thread_pool_size(pool) : 1;
+    mesh_import_for(pool, ranges, [&](int r) {
+        uint64_t range_begin = (uint64_t)position_count * (uint64_t)r / (uint64_t)ranges;
+        uint64_t range_end = (uint64_t)position_count * (uint64_t)(r + 1) / (uint64_t)ranges;
+        mesh_weld_table table;
+        mesh_weld_table_init(&table, (size_t)(range_end - range_begin) + 16);
+        for (size_t i = 0; i < corner_count; ++i)
+        {
+            uint64_t position = keys[i] >> 32;
+            if (position >= range_begin && position < range_end)
+                first[i] = mesh_weld_table_insert(&table, keys[i], (uint32_t)i);
+        }
+    });
+
+    // vertices in order of first use
+    out->indices.resize(corner_count);
+    std::vector<uint32_t> vertex_corners;
+    for (size_t i = 0; i < corner_count; ++i)
+    {
+        if (first[i] == i)
+        {
+            out->indices[i] = (uint32_t)vertex_corners.size();
+            vertex_corners.push_back((uint32_t)i);
+        }
+        else
+        {
+            out->indices[i] = out->indices[first[i]];
+        }
+    }
+
+    // gather the vertex attributes from the pieces they were parsed in
+    std::vector<const float *> chunk_positions(chunk_count), chunk_uvs(chunk_count), chunk_colors(chunk_count);
+    std::vector<uint32_t> position_chunk(position_count), uv_chunk(uv_count);
+    for (int c = 0; c < chunk_count; ++c)
+    {
+        for (size_t p = position_base[c]; p < position_base[c + 1]; ++p)
+            position_chunk[p] = (uint32_t)c;
+        for (size_t t = uv_base[c]; t < uv_base[c + 1]; ++t)
+            uv_chunk[t] = (uint32_t)c;
+    }
+
+    size_t vertex_count = vertex_corners.size();
+    bool has_uvs = uv_count > 0;
+    out->positions.resize(vertex_count * 3);
+    if (has_uvs)
+        out->uvs.resize(vertex_count * 2);
+    if (has_colors)
+        out->colors.resize(vertex_count * 4);
+    int batches = (int)((vertex_count + MESH_IMPORT_BATCH - 1) / MESH_IMPORT_BATCH);
+    mesh_import_for(pool, batches, [&](int b) {
+        size_t begin = (size_t)b * MESH_IMPORT_BATCH;
+        size_t end = begin + MESH_IMPORT_BATCH < vertex_count ? begin + MESH_IMPORT_BATCH : vertex_count;
+        for (size_t v = begin; v < end; ++v)
+        {
+            uint64_t key = keys[vertex_corners[v]];
+            size_t position = (size_t)(key >> 32);
+            const mesh_obj_chunk *chunk = &chunks[position_chunk[position]];
+            size_t local = position - position_base[position_chunk[position]];
+            out->positions[v * 3 + 0] = chunk->positions[local * 3 + 0];
+            out->positions[v * 3 + 1] = chunk->positions[local * 3 + 1];
+            out->positions[v * 3 + 2] = -chunk->positions[local * 3 + 2];
+            if (has_colors)
+            {
+                bool colored = chunk->colors.empty() == false;
+                for (int c = 0; c < 3; ++c)
+                    out->colors[v * 4 + c] = colored ? chunk->colors[local * 3 + c] : 1.0f;
+                out->colors[v * 4 + 3] = 1.0f;
+            }
+            if (has_uvs)
+            {
+                uint32_t uv = (uint32_t)key;
+                if (uv == 0)
+                {
+                    out->uvs[v * 2] = out->uvs[v * 2 + 1] = 0.0f;
+                    continue;
+                }
+                const mesh_obj_chunk *uv_owner = &chunks[uv_chunk[uv - 1]];
+                size_t uv_local = uv - 1 - uv_base[uv_chunk[uv - 1]];
+                out->uvs[v * 2] = uv_owner->uvs[uv_local * 2];
+                out->uvs[v * 2 + 1] = uv_owner->uvs[uv_local * 2 + 1];
+            }
+        }
+    });
+    return true;
+}
+
+inline bool
+mesh_import_obj(const char *path, mesh_data *out, thread_pool *pool)
+{
+    std::vector<uint8_t> text;
+    if (mesh_import_read_file(path, &text) == false)
+        return false;
+    return mesh_import_obj_text((const char *)text.data(), text.size(), out, pool);
+}
+
+// json, just enough for gltf. strings point into the text with their escapes left in
+enum mesh_json_type
+{
+    MESH_JSON_NULL,
+    MESH_JSON_BOOL,
+    MESH_JSON_NUMBER,
+    MESH_JSON_STRING,
+    MESH_JSON_ARRAY,
+    MESH_JSON_OBJECT,
+};
+
+struct mesh_json_value
+{
+    mesh_json_type type;
+    const char *string; // strings, and the key when the parent is an object
+    uint32_t length;
+    const char *key;
+    uint32_t key_length;
+    double number;       // numbers and bools
+    int32_t first_child; // arrays and objects, -1 when empty
+    int32_t next;        // next child of the same parent, -1 for the last
+};
+
+struct mesh_json
+{
+    std::vector<mesh_json_value> values; // values[0] is the root
+};
+
+struct mesh_json_parser
+{
+    const char *at;
+    const char *end;
+    mesh_json *json;
+};
+
+inline void
+mesh_json_skip_space(mesh_json_parser *p)
+{
+    while (p->at < p->end && (*p->at == ' ' || *p->at == '\t' || *p->at == '\r' || *p->at == '\n'))
+        p->at++;
+}
+
+// the characters between the quotes, p->at on the opening one
+inline bool
+mesh_json_parse_string(mesh_json_parser *p, const char **string, uint32_t *length)
+{
+    if (p->at >= p->end || *p->at != '"')
+        return false;
+    const char *begin = ++p->at;
+    while (p->at < p->end && *p->at != '"')
+        p->at += *p->at == '\\' ? 2 : 1;
+    if (p->at >= p->end)
+        return false;
+    *string = begin;
+    *length = (uint32_t)(p->at - begin);
+    p->at++;
+    return true;
+}
+
+inline int32_t
+mesh_json_parse_value(mesh_json_parser *p, int depth)
+{
+    mesh_json_skip_space(p);
+    if (p->at >= p->end || depth > MESH_IMPORT_JSON_DEPTH)
+        return -1;
+
+    int32_t index = (int32_t)p->json->values.size();
+    mesh_json_value value = {};
+    value.first_child = -1;
+    value.next = -1;
+    p->json->values.push_back(value);
+
+    char c = *p->at;
+    if (c == '{' || c == '[')
+    {
+        bool object = c == '{';
+        p->json->values[index].type = object ? MESH_JSON_OBJECT : MESH_JSON_ARRAY;
+        p->at++;
+        int32_t previous = -1;
+        uint32_t count = 0;
+        for (;;)
+        {
+            mesh_json_skip_space(p);
+            if (p->at < p->end && *p->at == (object ? '}' : ']') && count == 0)
+            {
+                p->at++;
+                break;
+            }
+
+            const char *key = nullptr;
+            uint32_t key_length = 0;
+            if (object)
+            {
+                if (mesh_json_parse_string(p, &key, &key_length) == false)
+                    return -1;
+                mesh_json_skip_space(p);
+                if (p->at >= p->end || *p->at != ':')
+                    return -1;
+                p->at++;
+            }
+            int32_t child = mesh_json_parse_value(p, depth + 1);
+            if (child < 0)
+                return -1;
+            p->json->values[child].key = key;
+            p->json->values[child].key_length = key_length;
+            if (previous < 0)
+                p->json->values[index].first_child = child;
+            else
+                p->json->values[previous].next = child;
+            previous = child;
+            count++;
+
+            mesh_json_skip_space(p);
+            if (p->at < p->end && *p->at == ',')
+            {
+                p->at++;
+                continue;
+            }
+            if (p->at < p->end && *p->at == (object ? '}' : ']'))
+            {
+                p->at++;
+                break;
+            }
+            return -1;
+        }
+        p->json->values[index].length = count;
+    }
+    else if (c == '"')
+    {
+        const char *string;
+        uint32_t length;
+        if (mesh_json_parse_string(p, &string, &length) == false)
+            return -1;
+        p->json->values[index].type = MESH_JSON_STRING;
+        p->json->values[index].string = string;
+        p->json->values[index].length = length;
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        // the text is zero terminated, strtod stops at the end of the number
+        char *number_end;
+        p->json->values[index].type = MESH_JSON_NUMBER;
+        p->json->values[index].number = strtod(p->at, &number_end);
+        if (number_end == p->at)
+            return -1;
+        p->at = number_end;
+    }
+    else if (p->end - p->at >= 4 && memcmp(p->at, "true", 4) == 0)
+    {
+        p->json->values[index].type = MESH_JSON_BOOL;
+        p->json->values[index].number = 1.0;
+        p->at += 4;
+    }
+    else if (p->end - p->at >= 5 && memcmp(p->at, "false", 5) == 0)
+    {
+        p->json->values[index].type = MESH_JSON_BOOL;
+        p->at += 5;
+    }
+    else if (p->end - p->at >= 4 && memcmp(p->at, "null", 4) == 0)
+    {
+        p->at += 4;
+    }
+    else
+    {
+        return -1;
+    }
+    return index;
+}
+
+// text must be zero terminated at text[size]
+inline bool
+mesh_json_parse(mesh_json *json, const char *text, size_t size)
+{
+    json->values.clear();
+    mesh_json_parser parser = {text, text + size, json};
+    return mesh_json_parse_value(&parser, 0) == 0;
+}
+
+inline int32_t
+mesh_json_member(const mesh_json *json, int32_t object, const char *key)
+{
+    if (object < 0 || json->values[object].type != MESH_JSON_OBJECT)
+        return -1;
+    size_t key_length = strlen(key);
+    for (int32_t child = json->values[object].first_child; child >= 0; child = json->values[child].next)
+    {
+        const mesh_json_value *value = &json->values[child];
+        if (value->key_length == key_length && memcmp(value->key, key, key_length) == 0)
+            return child;
+    }
+    return -1;
+}
+
+// children of an array, empty when it isn't one
+inline std::vector<int32_t>
+mesh_json_elements(const mesh_json *json, int32_t array)
+{
+    std::vector<int32_t> elements;
+    if (array >= 0 && json->values[array].type == MESH_JSON_ARRAY)
+    {
+        for (int32_t child = json->values[array].first_child; child >= 0; child = json->values[child].next)
+            elements.push_back(child);
+    }
+    return elements;
+}
+
+inline double
+mesh_json_number(const mesh_json *json, int32_t value, double fallback)
+{
+    if (value < 0 || (json->values[value].type != MESH_JSON_NUMBER && json->values[value].type != MESH_JSON_BOOL))
+        return fallback;
+    return json->values[value].number;
+}
+
+inline bool
+mesh_json_string_is(const mesh_json *json, int32_t value, const char *string)
+{
+    if (value < 0 || json->values[value].type != MESH_JSON_STRING)
+        return false;
+    size_t length = strlen(string);
+    return json->values[value].length == length && memcmp(json->values[value].string, string, length) == 0;
+}
+
+inline bool
+mesh_import_base64(const char *text, size_t length, std::vector<uint8_t> *out)
+{
+    out->clear();
+    uint32_t bits = 0;
+    int bit_count = 0;
+    for (size_t i = 0; i < length && text[i] != '='; ++i)
+    {
+        char c = text[i];
+        int value = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 : c >= '0' && c <= '9' ? c - '0' + 52 :
+            c == '+' ? 62 : c == '/' ? 63 : -1;
+        if (value < 0)
+            return false;
+        bits = bits << 6 | (uint32_t)value;
+        bit_count += 6;
+        if (bit_count >= 8)
+        {
+            bit_count -= 8;
+            out->push_back((uint8_t)(bits >> bit_count));
+        }
+    }
+    return true;
+}
+
+// gltf component types
+#define MESH_GLTF_BYTE 5120
+#define MESH_GLTF_UNSIGNED_BYTE 5121
+#define MESH_GLTF_SHORT 5122
+#define MESH_GLTF_UNSIGNED_SHORT 5123
+#define MESH_GLTF_UNSIGNED_INT 5125
+#define MESH_GLTF_FLOAT 5126
+
+struct mesh_gltf_accessor
+{
+    const uint8_t *data;
+    size_t count;
+    size_t stride;
+    uint32_t component_type;
+    uint32_t components;
+    bool normalized;
+};
+
+inline uint32_t
+mesh_gltf_component_size(uint32_t component_type)
+{
+    switch (component_type)
+    {
+        case MESH_GLTF_BYTE:
+        case MESH_GLTF_UNSIGNED_BYTE: return 1;
+        case MESH_GLTF_SHORT:
+        case MESH_GLTF_UNSIGNED_SHORT: return 2;
+        case MESH_GLTF_UNSIGNED_INT:
+        case MESH_GLTF_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+// component c of element i as a float, normalized integers mapped to [0, 1] or [-1, 1]
+inline float
+mesh_gltf_read(const mesh_gltf_accessor *a, size_t i, uint32_t c)
+{
+    const uint8_t *p = a->data + i * a->stride + c * mesh_gltf_component_size(a->component_type);
+    switch (a->component_type)
+    {
+        case MESH_GLTF_FLOAT:
+        {
+            float f;
+            memcpy(&f, p, sizeof(f));
+            return f;
+        }
+        case MESH_GLTF_UNSIGNED_BYTE: return a->normalized ? (float)*p / 255.0f : (float)*p;
+        case MESH_GLTF_BYTE: return a->normalized ? fmaxf((float)(int8_t)*p / 127.0f, -1.0f) : (float)(int8_t)*p;
+        case MESH_GLTF_UNSIGNED_SHORT:
+        {
+            uint16_t u;
+            memcpy(&u, p, sizeof(u));
+            return a->normalized ? (float)u / 65535.0f : (float)u;
+        }
+        case MESH_GLTF_SHORT:
+        {
+            int16_t s;
+            memcpy(&s, p, sizeof(s));
+            return a->normalized ? fmaxf((float)s / 32767.0f, -1.0f) : (float)s;
+        }
+        default:
+        {
+            uint32_t u;
+            memcpy(&u, p, sizeof(u));
+            return (float)u;
+        }
+    }
+}
+
+inline uint32_t
+mesh_gltf_read_index(const mesh_gltf_accessor *a, size_t i)
+{
+    const uint8_t *p = a->data + i * a->stride;
+    if (a->component_type == MESH_GLTF_UNSIGNED_BYTE)
+        return *p;
+    if (a->component_type == MESH_GLTF_UNSIGNED_SHORT)
+    {
+        uint16_t u;
+        memcpy(&u, p, sizeof(u));
+        return u;
+    }
+    uint32_t u;
+    memcpy(&u, p, sizeof(u));
+    return u;
+}
+
+struct mesh_gltf_buffer
+{
+    const uint8_t *data;
+    size_t size;
+};
+
+struct mesh_gltf
+{
+    mesh_json json;
+    std::vector<mesh_gltf_buffer> buffers;
+    std::vector<std::vector<uint8_t>> loaded; // external and data: buffers
+    const uint8_t *glb_bin;
+    size_t glb_bin_size;
+    std::vector<int32_t> accessors;
+    std::vector<int32_t> buffer_views;
+};
+
+inline bool
+mesh_gltf_accessor_get(const mesh_gltf *gltf, int64_t index, mesh_gltf_accessor *out)
+{
+    const mesh_json *json = &gltf->json;
+    if (index < 0 || index >= (int64_t)gltf->accessors.size())
+        return false;
+    int32_t accessor = gltf->accessors[(size_t)index];
+    int64_t view_index = (int64_t)mesh_json_number(json, mesh_json_member(json, accessor, "bufferView"), -1.0);
+    if (view_index < 0 || view_index >= (int64_t)gltf->buffer_views.size() || mesh_json_member(json, accessor, "sparse") >= 0)
+        return false;
+    int32_t view = gltf->buffer_views[(size_t)view_index];
+    int64_t buffer = (int64_t)mesh_json_number(json, mesh_json_member(json, view, "buffer"), -1.0);
+    if (buffer < 0 || buffer >= (int64_t)gltf->buffers.size())
+        return false;
+
+    int32_t type = mesh_json_member(json, accessor, "type");
+    out->components = mesh_json_string_is(json, type, "SCALAR") ? 1 : mesh_json_string_is(json, type, "VEC2") ? 2 :
+        mesh_json_string_is(json, type, "VEC3") ? 3 : mesh_json_string_is(json, type, "VEC4") ? 4 : 0;
+    out->component_type = (uint32_t)mesh_json_number(json, mesh_json_member(json, accessor, "componentType"), 0.0);
+    out->count = (size_t)mesh_json_number(json, mesh_json_member(json, accessor, "count"), 0.0);
+    out->normalized = mesh_json_number(json, mesh_json_member(json, accessor, "normalized"), 0.0) != 0.0;
+    uint32_t element_size = out->components * mesh_gltf_component_size(out->component_type);
+    if (element_size == 0)
+        return false;
+
+    const mesh_gltf_buffer *data = &gltf->buffers[(size_t)buffer];
+    uint64_t view_offset = (uint64_t)mesh_json_number(json, mesh_json_member(json, view, "byteOffset"), 0.0);
+    uint64_t view_length = (uint64_t)mesh_json_number(json, mesh_json_member(json, view, "byteLength"), 0.0);
+    uint64_t offset = (uint64_t)mesh_json_number(json, mesh_json_member(json, accessor, "byteOffset"), 0.0);
+    out->stride = (size_t)mesh_json_number(json, mesh_json_member(json, view, "byteStride"), (double)element_size);
+    if (out->stride < element_size || view_offset + view_length > data->size)
+        return false;
+    if (out->count > 0 && offset + (uint64_t)out->stride * (out->count - 1) + element_size > view_length)
+        return false;
+    out->data = data->data + view_offset + offset;
+    return true;
+}
+
+// a triangle primitive with the transform of the node that draws it
+struct mesh_gltf_instance
+{
+    int32_t primitive;
+    float matrix[16]; // column major
+    bool flip_winding;
+    mesh_gltf_accessor positions;
+    mesh_gltf_accessor uvs;
+    mesh_gltf_accessor colors;
+    mesh_gltf_accessor indices;
+    bool has_uvs;
+    bool has_colors;
+    bool has_indices;
+    size_t vertex_base;
+    size_t index_base;
+    size_t index_count;
+};
+
+inline void
+mesh_gltf_multiply(float out[16], const float a[16], const float b[16])
+{
+    float result[16];
+    for (int col = 0; col < 4; ++col)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+                sum += a[k * 4 + row] * b[col * 4 + k];
+            result[col * 4 + row] = sum;
+        }
+    }
+    memcpy(out, result, sizeof(result));
+}
+
+// matrix, or translation * rotation * scale
+inline void
+mesh_gltf_node_matrix(const mesh_json *json, int32_t node, float out[16])
+{
+    std::vector<int32_t> matrix = mesh_json_elements(json, mesh_json_member(json, node, "matrix"));
+    if (matrix.size() == 16)
+    {
+        for (int i = 0; i < 16; ++i)
+            out[i] = (float)mesh_json_number(json, matrix[i], 0.0);
+        return;
+    }
+
+    float t[3] = {0.0f, 0.0f, 0.0f}, r[4] = {0.0f, 0.0f, 0.0f, 1.0f}, s[3] = {1.0f, 1.0f, 1.0f};
+    std::vector<int32_t> translation = mesh_json_elements(json, mesh_json_member(json, node, "translation"));
+    std::vector<int32_t> rotation = mesh_json_elements(json, mesh_json_member(json, node, "rotation"));
+    std::vector<int32_t> scale = mesh_json_elements(json, mesh_json_member(json, node, "scale"));
+    for (size_t i = 0; i < 3 && translation.size() == 3; ++i)
+        t[i] = (float)mesh_json_number(json, translation[i], 0.0);
+    for (size_t i = 0; i < 4 && rotation.size() == 4; ++i)
+        r[i] = (float)mesh_json_number(json, rotation[i], 0.0);
+    for (size_t i = 0; i < 3 && scale.size() == 3; ++i)
+        s[i] = (float)mesh_json_number(json, scale[i], 1.0);
+
+    float x = r[0], y = r[1], z = r[2], w = r[3];
+    float rotation_matrix[9] = {
+        1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w),
+        2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w),
+        2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y),
+    };
+    for (int col = 0; col < 3; ++col)
+    {
+        for (int row = 0; row < 3; ++row)
+            out[col * 4 + row] = rotation_matrix[col * 3 + row] * s[col];
+        out[col * 4 + 3] = 0.0f;
+    }
+    out[12] = t[0];
+    out[13] = t[1];
+    out[14] = t[2];
+    out[15] = 1.0f;
+}
+
+inline bool
+mesh_gltf_collect(const mesh_gltf *gltf, int32_t node, const float parent[16], int depth, std::vector<mesh_gltf_instance> *instances)
+{
+    const mesh_json *json = &gltf->json;
+    if (depth > MESH_IMPORT_JSON_DEPTH)
+        return false;
+
+    float local[16], world[16];
+    mesh_gltf_node_matrix(json, node, local);
+    mesh_gltf_multiply(world, parent, local);
+
+    int64_t mesh = (int64_t)mesh_json_number(json, mesh_json_member(json, node, "mesh"), -1.0);
+    if (mesh >= 0)
+    {
+        std::vector<int32_t> meshes = mesh_json_elements(json, mesh_json_member(json, 0, "meshes"));
+        if (mesh >= (int64_t)meshes.size())
+            return false;
+
+        // a mirroring transform turns the winding around too
+        float determinant = world[0] * (world[5] * world[10] - world[9] * world[6]) -
+            world[4] * (world[1] * world[10] - world[9] * world[2]) + world[8] * (world[1] * world[6] - world[5] * world[2]);
+        for (int32_t primitive : mesh_json_elements(json, mesh_json_member(json, meshes[(size_t)mesh], "primitives")))
+        {
+            if (mesh_json_number(json, mesh_json_member(json, primitive, "mode"), 4.0) != 4.0)
+                continue;
+            mesh_gltf_instance instance = {};
+            instance.primitive = primitive;
+            memcpy(instance.matrix, world, sizeof(world));
+            instance.flip_winding = determinant < 0.0f;
+            instances->push_back(instance);
+        }
+    }
+
+    std::vector<int32_t> nodes = mesh_json_elements(json, mesh_json_member(json, 0, "nodes"));
+    for (int32_t child : mesh_json_elements(json, mesh_json_member(json, node, "children")))
+    {
+        int64_t index = (int64_t)mesh_json_number(json, child, -1.0);
+        if (index < 0 || index >= (int64_t)nodes.size() || mesh_gltf_collect(gltf, nodes[(size_t)index], world, depth + 1, instances) == false)
+            return false;
+    }
+    return true;
+}
+
+// gltf or glb already in memory, directory is where external buffers are looked up
+inline bool
+mesh_import_gltf_data(const uint8_t *data, size_t size, const char *directory, mesh_data *out, thread_pool *pool)
+{
+    PROFILE_ZONE("mesh_import_gltf_data");
+    *out = {};
+    mesh_gltf gltf = {};
+
+    // glb is a 12 byte header, a JSON chunk and an optional BIN chunk
+    std::string text;
+    uint32_t magic = 0;
+    if (size >= 12)
+        memcpy(&magic, data, sizeof(magic));
+    if (magic == 0x46546c67) // "glTF"
+    {
+        size_t offset = 12;
+        while (offset + 8 <= size)
+        {
+            uint32_t chunk_length, chunk_type;
+            memcpy(&chunk_length, data + offset, 4);
+            memcpy(&chunk_type, data + offset + 4, 4);
+            if (chunk_length > size - offset - 8)
+                return false;
+            if (chunk_type == 0x4e4f534a) // "JSON"
+                text.assign((const char *)data + offset + 8, chunk_length);
+            else if (chunk_type == 0x004e4942) // "BIN\0"
+            {
+                gltf.glb_bin = data + offset + 8;
+                gltf.glb_bin_size = chunk_length;
+            }
+            offset += 8 + ((chunk_length + 3) & ~3u);
+        }
+    }
+    else
+    {
+        text.assign((const char *)data, size);
+    }
+    if (mesh_json_parse(&gltf.json, text.c_str(), text.size()) == false)
+        return false;
+    const mesh_json *json = &gltf.json;
+
+    // buffers, the glb one stays where it is
+    std::vector<int32_t> buffers = mesh_json_elements(json, mesh_json_member(json, 0, "buffers"));
+    gltf.loaded.resize(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        std::vector<uint8_t> *bytes = &gltf.loaded[i];
+        int32_t uri = mesh_json_member(json, buffers[i], "uri");
+        if (uri < 0)
+        {
+            if (gltf.glb_bin == nullptr)
+                return false;
+            gltf.buffers.push_back({gltf.glb_bin, gltf.glb_bin_size});
+            continue;
+        }
+        if (json->values[uri].type != MESH_JSON_STRING)
+            return false;
+        std::string path(json->values[uri].string, json->values[uri].length);
+        if (path.compare(0, 5, "data:") == 0)
+        {
+            size_t comma = path.find(',');
+            if (comma == std::string::npos || path.find(";base64") == std::string::npos ||
+                mesh_import_base64(path.c_str() + comma + 1, path.size() - comma - 1, bytes) == false)
+            {
+                return false;
+            }
+        }
+        else if (mesh_import_read_file((std::string(directory) + path).c_str(), bytes) == false)
+        {
+            return false;
+        }
+        gltf.buffers.push_back({bytes->data(), bytes->size()});
+    }
+    gltf.accessors = mesh_json_elements(json, mesh_json_member(json, 0, "accessors"));
+    gltf.buffer_views = mesh_json_elements(json, mesh_json_member(json, 0, "bufferViews"));
+
+    // every primitive of the default scene, or every mesh when there are no scenes
+    std::vector<mesh_gltf_instance> instances;
+    float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    std::vector<int32_t> scenes = mesh_json_elements(json, mesh_json_member(json, 0, "scenes"));
+    std::vector<int32_t> nodes = mesh_json_elements(json, mesh_json_member(json, 0, "nodes"));
+    if (scenes.empty() == false)
+    {
+        int64_t scene = (int64_t)mesh_json_number(json, mesh_json_member(json, 0, "scene"), 0.0);
+        if (scene < 0 || scene >= (int64_t)scenes.size())
+            return false;
+        for (int32_t root : mesh_json_elements(json, mesh_json_member(json, scenes[(size_t)scene], "nodes")))
+        {
+            int64_t index = (int64_t)mesh_json_number(json, root, -1.0);
+            if (index < 0 || index >= (int64_t)nodes.size() || mesh_gltf_collect(&gltf, nodes[(size_t)index], identity, 0, &instances) == false)
+                return false;
+        }
+    }
+    else
+    {
+        for (int32_t mesh : mesh_json_elements(json, mesh_json_member(json, 0, "meshes")))
+        {
+            for (int32_t primitive : mesh_json_elements(json, mesh_json_member(json, mesh, "primitives")))
+            {
+                if (mesh_json_number(json, mesh_json_member(json, primitive, "mode"), 4.0) != 4.0)
+                    continue;
+                mesh_gltf_instance instance = {};
+                instance.primitive = primitive;
+                memcpy(instance.matrix, identity, sizeof(identity));
+                instances.push_back(instance);
+            }
+        }
+    }
+
+    // accessors and where every instance goes in the output
+    size_t vertex_count = 0, index_count = 0;
+    bool has_uvs = false, has_colors = false;
+    for (mesh_gltf_instance &instance : instances)
+    {
+        int32_t attributes = mesh_json_member(json, instance.primitive, "attributes");
+        int64_t position = (int64_t)mesh_json_number(json, mesh_json_member(json, attributes, "POSITION"), -1.0);
+        int64_t uv = (int64_t)mesh_json_number(json, mesh_json_member(json, attributes, "TEXCOORD_0"), -1.0);
+        int64_t color = (int64_t)mesh_json_number(json, mesh_json_member(json, attributes, "COLOR_0"), -1.0);
+        int64_t indices = (int64_t)mesh_json_number(json, mesh_json_member(json, instance.primitive, "indices"), -1.0);
+        if (mesh_gltf_accessor_get(&gltf, position, &instance.positions) == false || instance.positions.components != 3)
+            return false;
+        instance.has_uvs = uv >= 0;
+        instance.has_colors = color >= 0;
+        instance.has_indices = indices >= 0;
+        if ((instance.has_uvs && (mesh_gltf_accessor_get(&gltf, uv, &instance.uvs) == false || instance.uvs.count < instance.positions.count)) ||
+            (instance.has_colors && (mesh_gltf_accessor_get(&gltf, color, &instance.colors) == false || instance.colors.count < instance.positions.count)) ||
+            (instance.has_indices && mesh_gltf_accessor_get(&gltf, indices, &instance.indices) == false))
+        {
+            return false;
+        }
+        instance.vertex_base = vertex_count;
+        instance.index_base = index_count;
+        instance.index_count = (instance.has_indices ? instance.indices.count : instance.positions.count) / 3 * 3;
+        vertex_count += instance.positions.count;
+        index_count += instance.index_count;
+        has_uvs = has_uvs || instance.has_uvs;
+        has_colors = has_colors || instance.has_colors;
+    }
+    if (vertex_count >= UINT32_MAX)
+        return false;
+
+    out->positions.resize(vertex_count * 3);
+    out->indices.resize(index_count);
+    if (has_uvs)
+        out->uvs.resize(vertex_count * 2);
+    if (has_colors)
+        out->colors.resize(vertex_count * 4);
+
+    // batches of vertices and triangles over all instances
+    struct batch
+    {
+        uint32_t instance;
+        bool indices;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<batch> batches;
+    for (uint32_t i = 0; i < (uint32_t)instances.size(); ++i)
+    {
+        for (size_t begin = 0; begin < instances[i].positions.count; begin += MESH_IMPORT_BATCH)
+            batches.push_back({i, false, begin, begin + MESH_IMPORT_BATCH < instances[i].positions.count ? begin + MESH_IMPORT_BATCH : instances[i].positions.count});
+        for (size_t begin = 0; begin < instances[i].index_count; begin += MESH_IMPORT_BATCH * 3)
+            batches.push_back({i, true, begin, begin + MESH_IMPORT_BATCH * 3 < instances[i].index_count ? begin + MESH_IMPORT_BATCH * 3 : instances[i].index_count});
+    }
+
+    std::atomic<bool> failed(false);
+    mesh_import_for(pool, (int)batches.size(), [&](int b) {
+        const batch *work = &batches[b];
+        const mesh_gltf_instance *instance = &instances[work->instance];
+        if (work->indices)
+        {
+            uint32_t count = (uint32_t)instance->positions.count;
+            uint32_t base = (uint32_t)instance->vertex_base;
+            for (size_t i = work->begin; i < work->end; i += 3)
+            {
+                uint32_t triangle[3];
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    triangle[c] = instance->has_indices ? mesh_gltf_read_index(&instance->indices, i + c) : (uint32_t)(i + c);
+                    if (triangle[c] >= count)
+                        failed.store(true, std::memory_order_relaxed);
+                }
+                // z is negated, which flips the winding, unless the node already mirrors
+                uint32_t *dest = &out->indices[instance->index_base + i];
+                dest[0] = base + triangle[0];
+                dest[1] = base + triangle[instance->flip_winding ? 1 : 2];
+                dest[2] = base + triangle[instance->flip_winding ? 2 : 1];
+            }
+            return;
+        }
+
+        const float *m = instance->matrix;
+        for (size_t v = work->begin; v < work->end; ++v)
+        {
+            size_t dest = instance->vertex_base + v;
+            float x = mesh_gltf_read(&instance->positions, v, 0);
+            float y = mesh_gltf_read(&instance->positions, v, 1);
+            float z = mesh_gltf_read(&instance->positions, v, 2);
+            out->positions[dest * 3 + 0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+            out->positions[dest * 3 + 1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+            out->positions[dest * 3 + 2] = -(m[2] * x + m[6] * y + m[10] * z + m[14]);
+            if (has_uvs)
+            {
+                for (uint32_t c = 0; c < 2; ++c)
+                    out->uvs[dest * 2 + c] = instance->has_uvs ? mesh_gltf_read(&instance->uvs, v, c) : 0.0f;
+            }
+            if (has_colors)
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    bool present = instance->has_colors && c < instance->colors.components;
+                    out->colors[dest * 4 + c] = present ? mesh_gltf_read(&instance->colors, v, c) : 1.0f;
+                }
+            }
+        }
+    });
+    return failed.load() == false;
+}
+
+inline bool
+mesh_import_gltf(const char *path, mesh_data *out, thread_pool *pool)
+{
+    std::vector<uint8_t> data;
+    if (mesh_import_read_file(path, &data) == false)
+        return false;
+    std::string directory(path);
+    size_t slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+    return mesh_import_gltf_data(data.data(), data.size(), directory.c_str(), out, pool);
+}
+
+// picks the format by extension, pool may be null to run on the calling thread only
+inline bool
+mesh_import(const char *path, mesh_data *out, thread_pool *pool)
+{
+    const char *dot = strrchr(path, '.');
+    if (dot && (strcmp(dot, ".obj") == 0 || strcmp(dot, ".OBJ") == 0))
+        return mesh_import_obj(path, out, pool);
+    if (dot && (strcmp(dot, ".gltf") == 0 || strcmp(dot, ".glb") == 0 || strcmp(dot, ".GLTF") == 0 || strcmp(dot, ".GLB") == 0))
+        return mesh_import_gltf(path, out, pool);
+    return false;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frustum_cull.h"
+#include "simd_math.h"
+
+// runtime lod selection by projected screen space error. a level whose simplification error
+// is e world units covers e * proj[1][1] * viewport_height / 2 / distance pixels on screen, so
+// with a pixel budget every level has a distance from which it may be drawn:
+//
+//     float distances[MESH_LOD_MAX_LEVELS];
+//     mesh_lod_switch_distances(distances, errors, level_count, proj, 720.0f, 1.0f);
+//     mesh_lod_select_spheres(levels, &spheres, eye, distances, level_count);
+//
+// proj is the mat4_perspective_fov_lh matrix the examples draw with. distances are taken to
+// the nearest point of the bounding sphere, so an instance the camera is inside of always
+// gets level 0.
+
+#if !defined(MESH_LOD_MAX_LEVELS)
+    #define MESH_LOD_MAX_LEVELS 8
+#endif
+
+// errors ascending, errors[0] is the full mesh. distances[i] is where level i starts
+inline void
+mesh_lod_switch_distances(float *distances, const float *errors, int level_count, const mat4 &proj, float viewport_height,
+    float pixel_error)
+{
+    float p[16];
+    mat4_store(p, proj);
+    float pixels_per_unit = p[5] * viewport_height * 0.5f / pixel_error;
+    for (int i = 0; i < level_count; ++i)
+        distances[i] = errors[i] * pixels_per_unit;
+}
+
+// the coarsest level allowed at distance
+inline int
+mesh_lod_select(const float *distances, int level_count, float distance)
+{
+    int level = 0;
+    while (level + 1 < level_count && distances[level + 1] <= distance)
+        level++;
+    return level;
+}
+
+// levels for every sphere of bounds, SIMD_MATH_WIDTH at a time. compares squared distances
+// to the centers against (switch distance + radius)^2 so there is no square root per sphere.
+// levels needs bounds->count entries
+inline void
+mesh_lod_select_spheres(uint8_t *levels, const frustum_bounds *spheres, const float eye[3], const float *distances, int level_count)
+{
+    const float *xs = frustum_bounds_stream(spheres, 0);
+    const float *ys = frustum_bounds_stream(spheres, 1);
+    const float *zs = frustum_bounds_stream(spheres, 2);
+    const float *rs = frustum_bounds_stream(spheres, 3);
+    vf ex = vf_splat(eye[0]), ey = vf_splat(eye[1]), ez = vf_splat(eye[2]);
+    vf one = vf_splat(1.0f), zero = vf_splat(0.0f);
+
+    alignas(32) float lanes[SIMD_MATH_WIDTH];
+    for (size_t i = 0; i < spheres->count; i += SIMD_MATH_WIDTH)
+    {
+        vf dx = vf_sub(vf_load(xs + i), ex);
+        vf dy = vf_sub(vf_load(ys + i), ey);
+        vf dz = vf_sub(vf_load(zs + i), ez);
+        vf d2 = vf_madd(dx, dx, vf_madd(dy, dy, vf_mul(dz, dz)));
+        vf r = vf_load(rs + i);
+
+        vf level = zero;
+        for (int l = 1; l < level_count; ++l)
+        {
+            vf reach = vf_add(vf_splat(distances[l]), r);
+            level = vf_add(level, vf_select(vf_cmp_ge(d2, vf_mul(reach, reach)), one, zero));
+        }
+
+        vf_store(lanes, level);
+        size_t end = spheres->count - i < SIMD_MATH_WIDTH ? spheres->count - i : SIMD_MATH_WIDTH;
+        for (size_t lane = 0; lane < end; ++lane)
+            levels[i + lane] = (uint8_t)lanes[lane];
+    }
+}
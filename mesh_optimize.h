@@ -0,0 +1,384 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+// index and vertex buffer reordering for the gpu's vertex pipeline, plus the numbers to judge
+// it by. an indexed triangle list goes through two passes:
+//
+//     mesh_optimize_vertex_cache(indices, indices, index_count, vertex_count);
+//     mesh_optimize_vertex_fetch(vertices, indices, index_count, vertices, vertex_count, sizeof(vertex));
+//
+// the first reorders triangles so vertices that were just shaded are reused while they are
+// still in the post transform cache, the second renumbers vertices in the order the new index
+// buffer first touches them so vertex fetch streams through memory. mesh_analyze simulates
+// both caches and reports
+// - acmr, vertices shaded per triangle, 0.5 is the ideal for a large regular grid and 3 the worst
+// - atvr, vertices shaded per unique vertex, 1 is the ideal
+// - overfetch, bytes read from the vertex buffer per byte of unique vertices, 1 is the ideal
+//
+// two cache orderings are here. tipsify (sander et al. 2007) walks the mesh vertex by vertex
+// and is tuned for a fifo cache of a given size, forsyth's linear speed optimizer scores
+// vertices by cache position and remaining triangles and assumes an lru cache. both run in
+// linear time.
+
+#define MESH_CACHE_SIZE 16      // fifo entries tipsify targets and mesh_analyze simulates
+#define MESH_FORSYTH_CACHE_SIZE 32
+#define MESH_FETCH_LINE_SIZE 64 // bytes
+#define MESH_FETCH_CACHE_LINES 64
+
+struct mesh_analysis
+{
+    uint32_t triangles;
+    uint32_t unique_vertices;
+    uint32_t transformed; // post transform cache misses
+    float acmr;
+    float atvr;
+    uint64_t fetched_bytes;
+    float overfetch;
+};
+
+// triangles of every vertex, the ones of vertex v are triangles[offsets[v], offsets[v + 1])
+struct mesh_adjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+inline void
+mesh_build_adjacency(mesh_adjacency *adjacency, const uint32_t *indices, size_t index_count, size_t vertex_count)
+{
+    adjacency->offsets.assign(vertex_count + 1, 0);
+    for (size_t i = 0; i < index_count; ++i)
+        adjacency->offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertex_count; ++v)
+        adjacency->offsets[v + 1] += adjacency->offsets[v];
+
+    adjacency->triangles.resize(index_count);
+    std::vector<uint32_t> fill(adjacency->offsets.begin(), adjacency->offsets.end() - 1);
+    for (size_t i = 0; i < index_count; ++i)
+        adjacency->triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+}
+
+// tipsify, dest may be indices. cache_size is the fifo size of the target, MESH_CACHE_SIZE
+// suits most gpus
+inline void
+mesh_optimize_vertex_cache(uint32_t *dest, const uint32_t *indices, size_t index_count, size_t vertex_count,
+    uint32_t cache_size = MESH_CACHE_SIZE)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || vertex_count == 0)
+        return;
+
+    mesh_adjacency adjacency;
+    mesh_build_adjacency(&adjacency, indices, index_count, vertex_count);
+
+    // live triangle count and fifo timestamp per vertex, a vertex is in the cache while
+    // timestamp - cache_time <= cache_size
+    std::vector<uint32_t> live(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(triangle_count * 3);
+
+    uint32_t timestamp = cache_size + 1;
+    size_t cursor = 0;
+    uint32_t fanning = 0;
+    while (live[fanning] == 0 && fanning + 1 < vertex_count)
+        fanning++;
+
+    for (;;)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; ++a)
+        {
+            uint32_t triangle = adjacency.triangles[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = 1;
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cache_time[v] > cache_size)
+                    cache_time[v] = timestamp++;
+            }
+        }
+
+        // next fanning vertex, the candidate that is oldest in the cache while its remaining
+        // triangles still fit before it is evicted
+        uint32_t best = UINT32_MAX;
+        int64_t best_priority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if ((int64_t)(timestamp - cache_time[v]) + 2 * (int64_t)live[v] <= (int64_t)cache_size)
+                priority = timestamp - cache_time[v];
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                best = v;
+            }
+        }
+
+        // dead end, fall back to recently touched vertices, then to the input order
+        while (best == UINT32_MAX && dead_end.empty() == false)
+        {
+            uint32_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v])
+                best = v;
+        }
+        while (best == UINT32_MAX && cursor < vertex_count)
+        {
+            if (live[cursor])
+                best = (uint32_t)cursor;
+            cursor++;
+        }
+        if (best == UINT32_MAX)
+            break;
+        fanning = best;
+    }
+
+    memcpy(dest, output.data(), output.size() * sizeof(uint32_t));
+}
+
+// scores by cache position and by remaining triangles up to MESH_FORSYTH_MAX_VALENCE, read from
+// tables built once
+#define MESH_FORSYTH_MAX_VALENCE 32
+
+inline float
+mesh_forsyth_vertex_score(int cache_position, uint32_t remaining)
+{
+    static const struct tables
+    {
+        float position[MESH_FORSYTH_CACHE_SIZE];
+        float valence[MESH_FORSYTH_MAX_VALENCE + 1];
+        tables()
+        {
+            // the last triangle's vertices score a fixed amount so the next one doesn't just reuse them
+            for (int i = 0; i < MESH_FORSYTH_CACHE_SIZE; ++i)
+                position[i] = i < 3 ? 0.75f : powf(1.0f - (float)(i - 3) / (float)(MESH_FORSYTH_CACHE_SIZE - 3), 1.5f);
+            // vertices with few triangles left are worth finishing off
+            valence[0] = 0.0f;
+            for (int i = 1; i <= MESH_FORSYTH_MAX_VALENCE; ++i)
+                valence[i] = 2.0f / sqrtf((float)i);
+        }
+    } t;
+
+    if (remaining == 0)
+        return -1.0f;
+    float score = cache_position >= 0 ? t.position[cache_position] : 0.0f;
+    return score + t.valence[remaining < MESH_FORSYTH_MAX_VALENCE ? remaining : MESH_FORSYTH_MAX_VALENCE];
+}
+
+// forsyth's linear speed vertex cache optimization, dest may be indices
+inline void
+mesh_optimize_vertex_cache_forsyth(uint32_t *dest, const uint32_t *indices, size_t index_count, size_t vertex_count)
+{
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || vertex_count == 0)
+        return;
+
+    mesh_adjacency adjacency;
+    mesh_build_adjacency(&adjacency, indices, index_count, vertex_count);
+
+    // the first remaining[v] triangles of a vertex's adjacency are the ones not emitted yet
+    std::vector<uint32_t> remaining(vertex_count);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        remaining[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+        vertex_score[v] = mesh_forsyth_vertex_score(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    for (size_t t = 0; t < triangle_count; ++t)
+        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> output;
+    output.reserve(triangle_count * 3);
+
+    // lru cache with room for the 3 vertices pushed in front of a full one
+    uint32_t cache[MESH_FORSYTH_CACHE_SIZE + 3];
+    uint32_t next_cache[MESH_FORSYTH_CACHE_SIZE + 3];
+    int cache_count = 0;
+
+    size_t cursor = 0;
+    uint32_t best_triangle = 0;
+    for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+    {
+        const uint32_t *tri = &indices[best_triangle * 3];
+        emitted[best_triangle] = 1;
+        output.insert(output.end(), tri, tri + 3);
+
+        // the triangle's vertices move to the front, the rest shift back
+        int next_count = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            uint32_t v = tri[corner];
+            next_cache[next_count++] = v;
+            uint32_t *live = &adjacency.triangles[adjacency.offsets[v]];
+            uint32_t last = --remaining[v];
+            for (uint32_t a = 0; a < last; ++a)
+            {
+                if (live[a] == best_triangle)
+                {
+                    live[a] = live[last];
+                    break;
+                }
+            }
+        }
+        for (int i = 0; i < cache_count; ++i)
+        {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next_cache[next_count++] = v;
+        }
+
+        // rescore everything that was or is in the cache, evicted vertices lose their position
+        for (int i = 0; i < next_count; ++i)
+        {
+            uint32_t v = next_cache[i];
+            float score = mesh_forsyth_vertex_score(i < MESH_FORSYTH_CACHE_SIZE ? i : -1, remaining[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (uint32_t a = adjacency.offsets[v]; a < adjacency.offsets[v] + remaining[v]; ++a)
+                triangle_score[adjacency.triangles[a]] += delta;
+        }
+        cache_count = next_count < MESH_FORSYTH_CACHE_SIZE ? next_count : MESH_FORSYTH_CACHE_SIZE;
+        memcpy(cache, next_cache, cache_count * sizeof(uint32_t));
+
+        // the best triangle is almost always one touching the cache
+        float best_score = -1e30f;
+        best_triangle = UINT32_MAX;
+        for (int i = 0; i < cache_count; ++i)
+        {
+            uint32_t v = cache[i];
+            for (uint32_t a = adjacency.offsets[v]; a < adjacency.offsets[v] + remaining[v]; ++a)
+            {
+                uint32_t t = adjacency.triangles[a];
+                if (triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        // nothing left around the cache, continue with the first triangle in input order
+        if (best_triangle == UINT32_MAX)
+        {
+            while (cursor < triangle_count && emitted[cursor])
+                cursor++;
+            if (cursor == triangle_count)
+                break;
+            best_triangle = (uint32_t)cursor;
+        }
+    }
+
+    memcpy(dest, output.data(), output.size() * sizeof(uint32_t));
+}
+
+// new index of every vertex in the order indices first use it, unused vertices get UINT32_MAX.
+// returns the number of used vertices
+inline size_t
+mesh_optimize_vertex_fetch_remap(uint32_t *remap, const uint32_t *indices, size_t index_count, size_t vertex_count)
+{
+    for (size_t v = 0; v < vertex_count; ++v)
+        remap[v] = UINT32_MAX;
+    uint32_t next = 0;
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        if (remap[indices[i]] == UINT32_MAX)
+            remap[indices[i]] = next++;
+    }
+    return next;
+}
+
+// reorders vertices by first use and rewrites indices to match, unused vertices are dropped.
+// dest may be vertices. returns the number of vertices written
+inline size_t
+mesh_optimize_vertex_fetch(void *dest, uint32_t *indices, size_t index_count, const void *vertices, size_t vertex_count,
+    size_t vertex_size)
+{
+    std::vector<uint32_t> remap(vertex_count);
+    size_t used = mesh_optimize_vertex_fetch_remap(remap.data(), indices, index_count, vertex_count);
+
+    std::vector<uint8_t> reordered(used * vertex_size);
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        if (remap[v] != UINT32_MAX)
+            memcpy(&reordered[(size_t)remap[v] * vertex_size], (const uint8_t *)vertices + v * vertex_size, vertex_size);
+    }
+    for (size_t i = 0; i < index_count; ++i)
+        indices[i] = remap[indices[i]];
+    memcpy(dest, reordered.data(), reordered.size());
+    return used;
+}
+
+// runs the index buffer through a fifo post transform cache of cache_size entries, every miss
+// reads its vertex through a fifo of MESH_FETCH_CACHE_LINES cache lines
+inline mesh_analysis
+mesh_analyze(const uint32_t *indices, size_t index_count, size_t vertex_count, size_t vertex_size,
+    uint32_t cache_size = MESH_CACHE_SIZE)
+{
+    mesh_analysis result = {};
+    result.triangles = (uint32_t)(index_count / 3);
+
+    // a vertex is in the fifo while its insertion stamp is within cache_size of the newest
+    std::vector<uint32_t> stamp(vertex_count, 0);
+    std::vector<uint8_t> seen(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+
+    uint64_t lines[MESH_FETCH_CACHE_LINES];
+    for (int i = 0; i < MESH_FETCH_CACHE_LINES; ++i)
+        lines[i] = UINT64_MAX;
+    int line_head = 0;
+
+    for (size_t i = 0; i < result.triangles * (size_t)3; ++i)
+    {
+        uint32_t v = indices[i];
+        if (seen[v] == 0)
+        {
+            seen[v] = 1;
+            result.unique_vertices++;
+        }
+        if (time - stamp[v] <= cache_size)
+            continue;
+        stamp[v] = time++;
+        result.transformed++;
+
+        uint64_t first = (uint64_t)v * vertex_size / MESH_FETCH_LINE_SIZE;
+        uint64_t last = ((uint64_t)v * vertex_size + vertex_size - 1) / MESH_FETCH_LINE_SIZE;
+        for (uint64_t line = first; line <= last; ++line)
+        {
+            bool cached = false;
+            for (int l = 0; l < MESH_FETCH_CACHE_LINES && cached == false; ++l)
+                cached = lines[l] == line;
+            if (cached)
+                continue;
+            lines[line_head] = line;
+            line_head = (line_head + 1) % MESH_FETCH_CACHE_LINES;
+            result.fetched_bytes += MESH_FETCH_LINE_SIZE;
+        }
+    }
+
+    result.acmr = result.triangles ? (float)result.transformed / (float)result.triangles : 0.0f;
+    result.atvr = result.unique_vertices ? (float)result.transformed / (float)result.unique_vertices : 0.0f;
+    result.overfetch = result.unique_vertices ? (float)result.fetched_bytes / (float)((uint64_t)result.unique_vertices * vertex_size) : 0.0f;
+    return result;
+}
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "simd_math.h"
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+    #define MESH_QUANTIZE_F16C 1
+    #include <immintrin.h>
+#endif
+
+// packs float vertex attributes and 32 bit indices into smaller formats before they go into
+// vertex and index buffers:
+// - positions to R16G16B16A16_SNORM or R16G16B16A16_FLOAT, relative to the mesh bounds. the
+//   shader gets them in [-1, 1], mesh_dequantize_matrix maps that back and goes in front of
+//   the world matrix, w comes out as 1
+// - uvs to R16G16_UNORM or R16G16_FLOAT relative to their bounds, uv_scale_offset maps them
+//   back with uv * scale + offset, a float4 constant next to the transform
+// - colors to R8G8B8A8_UNORM
+// - indices to R16_UINT when every vertex can be addressed with 16 bits
+//
+//     mesh_encoded encoded;
+//     mesh_encode(&source, &encoding, &encoded);
+//     D3D11_INPUT_ELEMENT_DESC descs[MESH_MAX_ELEMENTS];
+//     device->CreateInputLayout(descs, mesh_input_element_descs(&encoded, descs), ...);
+//
+// formats are DXGI_FORMAT values so this builds without the d3d headers, mesh_quantize_d3d.h
+// turns the elements into D3D11_INPUT_ELEMENT_DESCs. float to half conversion uses F16C or
+// NEON when there is one, 8 or 4 values per instruction.
+
+#define MESH_MAX_ELEMENTS 3
+
+// DXGI_FORMAT values
+enum mesh_format
+{
+    MESH_FORMAT_R32G32B32A32_FLOAT = 2,
+    MESH_FORMAT_R32G32B32_FLOAT = 6,
+    MESH_FORMAT_R16G16B16A16_FLOAT = 10,
+    MESH_FORMAT_R16G16B16A16_SNORM = 13,
+    MESH_FORMAT_R32G32_FLOAT = 16,
+    MESH_FORMAT_R8G8B8A8_UNORM = 28,
+    MESH_FORMAT_R16G16_FLOAT = 34,
+    MESH_FORMAT_R16G16_UNORM = 35,
+    MESH_FORMAT_R32_UINT = 42,
+    MESH_FORMAT_R16_UINT = 57,
+};
+
+enum mesh_position_encoding
+{
+    MESH_POSITION_FLOAT,
+    MESH_POSITION_SNORM16,
+    MESH_POSITION_HALF,
+};
+
+enum mesh_uv_encoding
+{
+    MESH_UV_FLOAT,
+    MESH_UV_UNORM16,
+    MESH_UV_HALF,
+};
+
+enum mesh_color_encoding
+{
+    MESH_COLOR_FLOAT,
+    MESH_COLOR_RGBA8,
+};
+
+struct mesh_encoding
+{
+    mesh_position_encoding position;
+    mesh_uv_encoding uv;
+    mesh_color_encoding color;
+    bool index16; // use R16_UINT indices when the vertex count allows it
+};
+
+// float attributes as the examples author them, uvs and colors may be null
+struct mesh_source
+{
+    const float *positions; // xyz
+    const float *uvs;       // uv
+    const float *colors;    // color_components per vertex
+    int color_components;   // 3 or 4
+    size_t vertex_count;
+    const uint32_t *indices;
+    size_t index_count;
+};
+
+struct mesh_vertex_element
+{
+    const char *semantic;
+    uint32_t format;
+    uint32_t offset;
+};
+
+struct mesh_encoded
+{
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+    uint32_t stride;
+    uint32_t index_format; // MESH_FORMAT_R16_UINT or MESH_FORMAT_R32_UINT
+    uint32_t index_size;
+    size_t vertex_count;
+    size_t index_count;
+
+    mesh_vertex_element elements[MESH_MAX_ELEMENTS];
+    uint32_t element_count;
+
+    // position = stored * scale + offset per axis, uv the same
+    float position_scale[3];
+    float position_offset[3];
+    float uv_scale_offset[4];
+};
+
+// round to nearest even, overflow goes to infinity and tiny values to subnormals or zero
+inline uint16_t
+mesh_float_to_half_scalar(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xff)
+        return (uint16_t)(sign | 0x7c00u | (mantissa ? 0x200u | (mantissa >> 13) : 0u));
+
+    int32_t half_exponent = (int32_t)exponent - 127 + 15;
+    if (half_exponent >= 31)
+        return (uint16_t)(sign | 0x7c00u);
+    if (half_exponent <= 0)
+    {
+        // subnormal half, shift the mantissa with its implicit bit into place
+        if (half_exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t)(14 - half_exponent);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1)))
+            half_mantissa++;
+        return (uint16_t)(sign | half_mantissa);
+    }
+
+    uint32_t half = sign | ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fffu;
+    // a carry out of the mantissa bumps the exponent, which is the right rounding too
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1)))
+        half++;
+    return (uint16_t)half;
+}
+
+inline float
+mesh_half_to_float_scalar(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+    uint32_t exponent = (h >> 10) & 0x1fu;
+    uint32_t mantissa = h & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // normalize the subnormal
+            int32_t e = -1;
+            do
+            {
+                e++;
+                mantissa <<= 1;
+            } while ((mantissa & 0x400u) == 0);
+            bits = sign | ((uint32_t)(127 - 15 - e) << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// count floats to halfs, with F16C 8 at a time
+inline void
+mesh_float_to_half(uint16_t *dest, const float *src, size_t count)
+{
+    size_t i = 0;
+#if defined(MESH_QUANTIZE_F16C)
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128((__m128i *)(dest + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(SIMD_MATH_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    for (; i + 4 <= count; i += 4)
+        vst1_u16(dest + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+#endif
+    for (; i < count; ++i)
+        dest[i] = mesh_float_to_half_scalar(src[i]);
+}
+
+inline void
+mesh_half_to_float(float *dest, const uint16_t *src, size_t count)
+{
+    size_t i = 0;
+#if defined(MESH_QUANTIZE_F16C)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+#elif defined(SIMD_MATH_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dest + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+#endif
+    for (; i < count; ++i)
+        dest[i] = mesh_half_to_float_scalar(src[i]);
+}
+
+inline int16_t
+mesh_snorm16(float f)
+{
+    f = f < -1.0f ? -1.0f : (f > 1.0f ? 1.0f : f);
+    return (int16_t)lrintf(f * 32767.0f);
+}
+
+inline uint16_t
+mesh_unorm16(float f)
+{
+    f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+    return (uint16_t)lrintf(f * 65535.0f);
+}
+
+inline uint8_t
+mesh_unorm8(float f)
+{
+    f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+    return (uint8_t)lrintf(f * 255.0f);
+}
+
+inline uint32_t
+mesh_format_size(uint32_t format)
+{
+    switch (format)
+    {
+        case MESH_FORMAT_R32G32B32A32_FLOAT: return 16;
+        case MESH_FORMAT_R32G32B32_FLOAT: return 12;
+        case MESH_FORMAT_R16G16B16A16_FLOAT:
+        case MESH_FORMAT_R16G16B16A16_SNORM:
+        case MESH_FORMAT_R32G32_FLOAT: return 8;
+        case MESH_FORMAT_R8G8B8A8_UNORM:
+        case MESH_FORMAT_R16G16_FLOAT:
+        case MESH_FORMAT_R16G16_UNORM:
+        case MESH_FORMAT_R32_UINT: return 4;
+        case MESH_FORMAT_R16_UINT: return 2;
+        default: return 0;
+    }
+}
+
+// bytes of the source as float vertices and 32 bit indices
+inline size_t
+mesh_source_size(const mesh_source *source)
+{
+    size_t stride = 3 * sizeof(float);
+    if (source->uvs)
+        stride += 2 * sizeof(float);
+    if (source->colors)
+        stride += (size_t)source->color_components * sizeof(float);
+    return stride * source->vertex_count + source->index_count * sizeof(uint32_t);
+}
+
+inline size_t
+mesh_encoded_size(const mesh_encoded *encoded)
+{
+    return encoded->vertices.size() + encoded->indices.size();
+}
+
+// maps the stored position in [-1, 1] back to the mesh, goes in front of the world matrix
+inline mat4
+mesh_dequantize_matrix(const mesh_encoded *encoded)
+{
+    const float *s = encoded->position_scale;
+    const float *o = encoded->position_offset;
+    return {{v4_set(s[0], 0, 0, 0), v4_set(0, s[1], 0, 0), v4_set(0, 0, s[2], 0), v4_set(o[0], o[1], o[2], 1)}};
+}
+
+inline void
+mesh_add_element(mesh_encoded *encoded, const char *semantic, uint32_t format)
+{
+    mesh_vertex_element *element = &encoded->elements[encoded->element_count++];
+    element->semantic = semantic;
+    element->format = format;
+    element->offset = encoded->stride;
+    encoded->stride += mesh_format_size(format);
+}
+
+// encodes the source into one interleaved vertex stream with elements Position, TexCoord and
+// Color in that order, returns false when an index is out of range
+inline bool
+mesh_encode(const mesh_source *source, const mesh_encoding *encoding, mesh_encoded *out)
+{
+    for (size_t i = 0; i < source->index_count; ++i)
+    {
+        if (source->indices[i] >= source->vertex_count)
+            return false;
+    }
+
+    *out = {};
+    out->vertex_count = source->vertex_count;
+    out->index_count = source->index_count;
+
+    // bounds, a quantized attribute covers exactly its range
+    float min[3] = {0.0f, 0.0f, 0.0f}, max[3] = {0.0f, 0.0f, 0.0f};
+    float uv_min[2] = {0.0f, 0.0f}, uv_max[2] = {1.0f, 1.0f};
+    for (size_t v = 0; v < source->vertex_count; ++v)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float p = source->positions[v * 3 + axis];
+            min[axis] = v == 0 || p < min[axis] ? p : min[axis];
+            max[axis] = v == 0 || p > max[axis] ? p : max[axis];
+        }
+        for (int axis = 0; source->uvs && axis < 2; ++axis)
+        {
+            float t = source->uvs[v * 2 + axis];
+            uv_min[axis] = v == 0 || t < uv_min[axis] ? t : uv_min[axis];
+            uv_max[axis] = v == 0 || t > uv_max[axis] ? t : uv_max[axis];
+        }
+    }
+
+    // float positions keep their values, the dequantize matrix is the identity then
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        bool quantized = encoding->position != MESH_POSITION_FLOAT;
+        float half_extent = (max[axis] - min[axis]) * 0.5f;
+        out->position_offset[axis] = quantized ? (min[axis] + max[axis]) * 0.5f : 0.0f;
+        out->position_scale[axis] = quantized && half_extent > 0.0f ? half_extent : 1.0f;
+    }
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        bool quantized = encoding->uv == MESH_UV_UNORM16;
+        float extent = uv_max[axis] - uv_min[axis];
+        out->uv_scale_offset[axis] = quantized && extent > 0.0f ? extent : 1.0f;
+        out->uv_scale_offset[2 + axis] = quantized ? uv_min[axis] : 0.0f;
+    }
+
+    uint32_t position_format = encoding->position == MESH_POSITION_SNORM16 ? MESH_FORMAT_R16G16B16A16_SNORM :
+        (encoding->position == MESH_POSITION_HALF ? MESH_FORMAT_R16G16B16A16_FLOAT : MESH_FORMAT_R32G32B32_FLOAT);
+    uint32_t uv_format = encoding->uv == MESH_UV_UNORM16 ? MESH_FORMAT_R16G16_UNORM :
+        (encoding->uv == MESH_UV_HALF ? MESH_FORMAT_R16G16_FLOAT : MESH_FORMAT_R32G32_FLOAT);
+    uint32_t color_format = encoding->color == MESH_COLOR_RGBA8 ? MESH_FORMAT_R8G8B8A8_UNORM :
+        (source->color_components == 4 ? MESH_FORMAT_R32G32B32A32_FLOAT : MESH_FORMAT_R32G32B32_FLOAT);
+    mesh_add_element(out, "Position", position_format);
+    if (source->uvs)
+        mesh_add_element(out, "TexCoord", uv_format);
+    if (source->colors)
+        mesh_add_element(out, "Color", color_format);
+
+    // positions relative to the bounds go through one float buffer, converted per element
+    // format after. half converts all of them in one batch
+    size_t n = source->vertex_count;
+    std::vector<float> relative(n * 4);
+    for (size_t v = 0; v < n; ++v)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+            relative[v * 4 + axis] = (source->positions[v * 3 + axis] - out->position_offset[axis]) / out->position_scale[axis];
+        relative[v * 4 + 3] = 1.0f;
+    }
+    std::vector<uint16_t> halfs;
+    if (encoding->position == MESH_POSITION_HALF)
+    {
+        halfs.resize(n * 4);
+        mesh_float_to_half(halfs.data(), relative.data(), n * 4);
+    }
+    std::vector<uint16_t> uv_halfs;
+    if (source->uvs && encoding->uv == MESH_UV_HALF)
+    {
+        uv_halfs.resize(n * 2);
+        mesh_float_to_half(uv_halfs.data(), source->uvs, n * 2);
+    }
+
+    out->vertices.resize(n * out->stride);
+    for (size_t v = 0; v < n; ++v)
+    {
+        uint8_t *vertex = &out->vertices[v * out->stride];
+        const mesh_vertex_element *element = out->elements;
+
+        // position
+        if (encoding->position == MESH_POSITION_SNORM16)
+        {
+            int16_t q[4];
+            for (int c = 0; c < 4; ++c)
+                q[c] = mesh_snorm16(relative[v * 4 + c]);
+            memcpy(vertex + element->offset, q, sizeof(q));
+        }
+        else if (encoding->position == MESH_POSITION_HALF)
+        {
+            memcpy(vertex + element->offset, &halfs[v * 4], 4 * sizeof(uint16_t));
+        }
+        else
+        {
+            memcpy(vertex + element->offset, &source->positions[v * 3], 3 * sizeof(float));
+        }
+        element++;
+
+        if (source->uvs)
+        {
+            const float *uv = &source->uvs[v * 2];
+            if (encoding->uv == MESH_UV_UNORM16)
+            {
+                uint16_t q[2];
+                for (int c = 0; c < 2; ++c)
+                    q[c] = mesh_unorm16((uv[c] - out->uv_scale_offset[2 + c]) / out->uv_scale_offset[c]);
+                memcpy(vertex + element->offset, q, sizeof(q));
+            }
+            else if (encoding->uv == MESH_UV_HALF)
+            {
+                memcpy(vertex + element->offset, &uv_halfs[v * 2], 2 * sizeof(uint16_t));
+            }
+            else
+            {
+                memcpy(vertex + element->offset, uv, 2 * sizeof(float));
+            }
+            element++;
+        }
+
+        if (source->colors)
+        {
+            const float *color = &source->colors[v * source->color_components];
+            if (encoding->color == MESH_COLOR_RGBA8)
+            {
+                uint8_t q[4];
+                for (int c = 0; c < 4; ++c)
+                    q[c] = c < source->color_components ? mesh_unorm8(color[c]) : 255;
+                memcpy(vertex + element->offset, q, sizeof(q));
+            }
+            else
+            {
+                memcpy(vertex + element->offset, color, (size_t)source->color_components * sizeof(float));
+            }
+        }
+    }
+
+    // 16 bit indices reach vertex 65535
+    bool index16 = encoding->index16 && n <= 65536;
+    out->index_format = index16 ? MESH_FORMAT_R16_UINT : MESH_FORMAT_R32_UINT;
+    out->index_size = index16 ? 2 : 4;
+    out->indices.resize(source->index_count * out->index_size);
+    if (index16)
+    {
+        uint16_t *indices = (uint16_t *)out->indices.data();
+        for (size_t i = 0; i < source->index_count; ++i)
+            indices[i] = (uint16_t)source->indices[i];
+    }
+    else
+    {
+        memcpy(out->indices.data(), source->indices, source->index_count * sizeof(uint32_t));
+    }
+    return true;
+}
+
+// the position of vertex v as the gpu sees it after mesh_dequantize_matrix, to check errors
+inline void
+mesh_decode_position(const mesh_encoded *encoded, size_t v, float out[3])
+{
+    const uint8_t *p = &encoded->vertices[v * encoded->stride + encoded->elements[0].offset];
+    float stored[3];
+    if (encoded->elements[0].format == MESH_FORMAT_R16G16B16A16_SNORM)
+    {
+        int16_t q[3];
+        memcpy(q, p, sizeof(q));
+        for (int c = 0; c < 3; ++c)
+            stored[c] = fmaxf((float)q[c] / 32767.0f, -1.0f);
+    }
+    else if (encoded->elements[0].format == MESH_FORMAT_R16G16B16A16_FLOAT)
+    {
+        uint16_t h[3];
+        memcpy(h, p, sizeof(h));
+        mesh_half_to_float(stored, h, 3);
+    }
+    else
+    {
+        memcpy(stored, p, sizeof(stored));
+    }
+    for (int c = 0; c < 3; ++c)
+        out[c] = stored[c] * encoded->position_scale[c] + encoded->position_offset[c];
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "mesh_quantize.h"
+
+// the input layout matching encoded vertices, one per-vertex element per attribute in slot 0.
+// descs needs room for MESH_MAX_ELEMENTS, returns how many were written. the semantic names
+// are static strings, so descs can outlive the mesh.
+inline uint32_t
+mesh_input_element_descs(const mesh_vertex_element *elements, uint32_t count, D3D11_INPUT_ELEMENT_DESC *descs)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const mesh_vertex_element *element = &elements[i];
+        descs[i] = {element->semantic, 0, (DXGI_FORMAT)element->format, 0, element->offset, D3D11_INPUT_PER_VERTEX_DATA, 0};
+    }
+    return count;
+}
+
+inline uint32_t
+mesh_input_element_descs(const mesh_encoded *encoded, D3D11_INPUT_ELEMENT_DESC *descs)
+{
+    return mesh_input_element_descs(encoded->elements, encoded->element_count, descs);
+}
@@ -0,0 +1,478 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+// quadric error mesh simplification (garland and heckbert) for building lod chains offline.
+//
+// every vertex carries the sum of the planes of its triangles, weighted by triangle area,
+// and collapsing vertex a into its neighbour b costs the mean squared distance of b to the
+// planes of both. collapses only ever move a vertex onto one of its neighbours, so the
+// simplified index buffer still points into the original vertex buffer and every lod of a
+// mesh can share one vertex buffer.
+//
+// vertices at the same position with other attributes (uv seams) are locked, vertices on an
+// open border only slide along it and get extra planes through the border edges so the
+// outline holds. a pass sorts all collapses by cost and takes the cheap ones that touch no
+// vertex around another collapse of the pass. a collapse that would pinch the surface (link
+// condition) or turn a triangle over is skipped. passes repeat until the target triangle
+// count or error is reached.
+//
+//     std::vector<mesh_lod> lods;
+//     mesh_build_lods(&lods, indices, index_count, positions, vertex_count, sizeof(float) * 3, 6);
+//
+// errors are distances in the units of the positions.
+
+#define MESH_SIMPLIFY_BORDER_WEIGHT 10.0
+#if !defined(MESH_LOD_MAX_LEVELS)
+    #define MESH_LOD_MAX_LEVELS 8
+#endif
+
+// symmetric 4x4 plane quadric with the total weight of its planes
+struct mesh_quadric
+{
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    double weight;
+};
+
+inline void
+mesh_quadric_add_plane(mesh_quadric *q, double a, double b, double c, double d, double weight)
+{
+    q->a00 += a * a * weight;
+    q->a01 += a * b * weight;
+    q->a02 += a * c * weight;
+    q->a03 += a * d * weight;
+    q->a11 += b * b * weight;
+    q->a12 += b * c * weight;
+    q->a13 += b * d * weight;
+    q->a22 += c * c * weight;
+    q->a23 += c * d * weight;
+    q->a33 += d * d * weight;
+    q->weight += weight;
+}
+
+inline void
+mesh_quadric_add(mesh_quadric *q, const mesh_quadric *other)
+{
+    q->a00 += other->a00;
+    q->a01 += other->a01;
+    q->a02 += other->a02;
+    q->a03 += other->a03;
+    q->a11 += other->a11;
+    q->a12 += other->a12;
+    q->a13 += other->a13;
+    q->a22 += other->a22;
+    q->a23 += other->a23;
+    q->a33 += other->a33;
+    q->weight += other->weight;
+}
+
+// weighted sum of squared distances of p to the planes
+inline double
+mesh_quadric_error(const mesh_quadric *q, const float p[3])
+{
+    double x = p[0], y = p[1], z = p[2];
+    double error = q->a00 * x * x + 2.0 * q->a01 * x * y + 2.0 * q->a02 * x * z + 2.0 * q->a03 * x +
+        q->a11 * y * y + 2.0 * q->a12 * y * z + 2.0 * q->a13 * y +
+        q->a22 * z * z + 2.0 * q->a23 * z + q->a33;
+    return error > 0.0 ? error : 0.0;
+}
+
+enum mesh_simplify_kind
+{
+    MESH_SIMPLIFY_MANIFOLD, // any neighbour
+    MESH_SIMPLIFY_BORDER,   // along a border edge onto another border vertex
+    MESH_SIMPLIFY_LOCKED,   // never moves
+};
+
+inline const float *
+mesh_simplify_position(const float *positions, size_t stride, uint32_t v)
+{
+    return (const float *)((const uint8_t *)positions + (size_t)v * stride);
+}
+
+inline void
+mesh_simplify_normal(const float *a, const float *b, const float *c, double n[3])
+{
+    double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+struct mesh_simplify_collapse
+{
+    float cost;
+    uint32_t from;
+    uint32_t to;
+};
+
+// the first vertex at the same position as every vertex
+inline void
+mesh_simplify_position_remap(std::vector<uint32_t> *remap, const float *positions, size_t vertex_count, size_t stride)
+{
+    size_t size = 64;
+    while (size < vertex_count * 2)
+        size *= 2;
+    std::vector<uint32_t> table(size, UINT32_MAX);
+    remap->resize(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        const float *p = mesh_simplify_position(positions, stride, (uint32_t)v);
+        // + 0.0f folds -0 into 0 so both hash alike
+        float key[3] = {p[0] + 0.0f, p[1] + 0.0f, p[2] + 0.0f};
+        uint32_t bits[3];
+        memcpy(bits, key, sizeof(bits));
+        uint32_t hash = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        for (size_t slot = hash & (size - 1);; slot = (slot + 1) & (size - 1))
+        {
+            if (table[slot] == UINT32_MAX)
+            {
+                table[slot] = (uint32_t)v;
+                (*remap)[v] = (uint32_t)v;
+                break;
+            }
+            const float *q = mesh_simplify_position(positions, stride, table[slot]);
+            if (q[0] == p[0] && q[1] == p[1] && q[2] == p[2])
+            {
+                (*remap)[v] = table[slot];
+                break;
+            }
+        }
+    }
+}
+
+// directed edges of the triangles, sorted, keyed by their position remapped ends
+inline void
+mesh_simplify_edges(std::vector<uint64_t> *edges, const uint32_t *indices, size_t index_count, const uint32_t *remap)
+{
+    edges->clear();
+    for (size_t t = 0; t + 2 < index_count; t += 3)
+    {
+        for (int e = 0; e < 3; ++e)
+        {
+            uint64_t a = remap[indices[t + e]], b = remap[indices[t + (e + 1) % 3]];
+            edges->push_back(a << 32 | b);
+        }
+    }
+    std::sort(edges->begin(), edges->end());
+}
+
+inline bool
+mesh_simplify_has_edge(const std::vector<uint64_t> &edges, uint32_t a, uint32_t b)
+{
+    return std::binary_search(edges.begin(), edges.end(), (uint64_t)a << 32 | b);
+}
+
+// simplifies towards target_index_count indices without going over target_error, dest may be
+// indices. returns the index count written and the largest collapse error in result_error
+inline size_t
+mesh_simplify(uint32_t *dest, const uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+    size_t stride, size_t target_index_count, float target_error, float *result_error = nullptr)
+{
+    std::vector<uint32_t> remap;
+    mesh_simplify_position_remap(&remap, positions, vertex_count, stride);
+
+    // triangles with two corners at one position (the poles of a uv sphere) have no area and
+    // would make their edges look non-manifold
+    std::vector<uint32_t> current;
+    current.reserve(index_count);
+    for (size_t t = 0; t + 2 < index_count; t += 3)
+    {
+        uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+        if (a != b && b != c && a != c)
+            current.insert(current.end(), {indices[t], indices[t + 1], indices[t + 2]});
+    }
+
+    // seams: positions shared by several vertices
+    std::vector<uint32_t> group_size(vertex_count, 0);
+    for (size_t v = 0; v < vertex_count; ++v)
+        group_size[remap[v]]++;
+
+    // kinds from the edges around every position. an edge without its twin is a border, one
+    // used twice the same way is not manifold
+    std::vector<uint64_t> edges;
+    mesh_simplify_edges(&edges, current.data(), current.size(), remap.data());
+    std::vector<uint8_t> kind(vertex_count, MESH_SIMPLIFY_MANIFOLD);
+    for (size_t v = 0; v < vertex_count; ++v)
+    {
+        if (group_size[remap[v]] > 1)
+            kind[v] = MESH_SIMPLIFY_LOCKED;
+    }
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        uint32_t a = (uint32_t)(edges[i] >> 32), b = (uint32_t)edges[i];
+        if (a == b)
+            continue;
+        if (i + 1 < edges.size() && edges[i + 1] == edges[i])
+        {
+            kind[a] = kind[b] = MESH_SIMPLIFY_LOCKED;
+        }
+        else if (mesh_simplify_has_edge(edges, b, a) == false)
+        {
+            kind[a] = kind[a] == MESH_SIMPLIFY_LOCKED ? MESH_SIMPLIFY_LOCKED : MESH_SIMPLIFY_BORDER;
+            kind[b] = kind[b] == MESH_SIMPLIFY_LOCKED ? MESH_SIMPLIFY_LOCKED : MESH_SIMPLIFY_BORDER;
+        }
+    }
+    // every vertex of a position gets the kind of the position
+    for (size_t v = 0; v < vertex_count; ++v)
+        kind[v] = std::max(kind[v], kind[remap[v]]);
+
+    // quadrics live on the position remapped vertex
+    std::vector<mesh_quadric> quadrics(vertex_count, mesh_quadric{});
+    for (size_t t = 0; t + 2 < current.size(); t += 3)
+    {
+        uint32_t corners[3] = {remap[current[t]], remap[current[t + 1]], remap[current[t + 2]]};
+        const float *p[3];
+        for (int c = 0; c < 3; ++c)
+            p[c] = mesh_simplify_position(positions, stride, corners[c]);
+        double n[3];
+        mesh_simplify_normal(p[0], p[1], p[2], n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+            continue;
+        double area = length * 0.5;
+        double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+        double d = -(a * p[0][0] + b * p[0][1] + c * p[0][2]);
+        for (int k = 0; k < 3; ++k)
+            mesh_quadric_add_plane(&quadrics[corners[k]], a, b, c, d, area);
+
+        // border edges get a plane through the edge, perpendicular to the triangle
+        for (int e = 0; e < 3; ++e)
+        {
+            uint32_t i0 = corners[e], i1 = corners[(e + 1) % 3];
+            if (mesh_simplify_has_edge(edges, i1, i0))
+                continue;
+            const float *e0 = p[e], *e1 = p[(e + 1) % 3];
+            double edge[3] = {e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2]};
+            double edge_length = sqrt(edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]);
+            if (edge_length == 0.0)
+                continue;
+            double bn[3] = {edge[1] * c - edge[2] * b, edge[2] * a - edge[0] * c, edge[0] * b - edge[1] * a};
+            double bn_length = sqrt(bn[0] * bn[0] + bn[1] * bn[1] + bn[2] * bn[2]);
+            bn[0] /= bn_length;
+            bn[1] /= bn_length;
+            bn[2] /= bn_length;
+            double bd = -(bn[0] * e0[0] + bn[1] * e0[1] + bn[2] * e0[2]);
+            double weight = edge_length * edge_length * MESH_SIMPLIFY_BORDER_WEIGHT;
+            mesh_quadric_add_plane(&quadrics[i0], bn[0], bn[1], bn[2], bd, weight);
+            mesh_quadric_add_plane(&quadrics[i1], bn[0], bn[1], bn[2], bd, weight);
+        }
+    }
+
+    double limit = (double)target_error * (double)target_error;
+    double worst = 0.0;
+    std::vector<mesh_simplify_collapse> collapses;
+    std::vector<uint32_t> collapse_remap(vertex_count);
+    std::vector<uint8_t> touched(vertex_count);
+    std::vector<uint32_t> triangle_offsets(vertex_count + 1), triangles;
+    std::vector<uint32_t> ring_from, ring_to;
+    while (current.size() > target_index_count)
+    {
+        // triangles around every position for the flip and link tests
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for (uint32_t index : current)
+            triangle_offsets[remap[index] + 1]++;
+        for (size_t v = 0; v < vertex_count; ++v)
+            triangle_offsets[v + 1] += triangle_offsets[v];
+        triangles.resize(current.size());
+        {
+            std::vector<uint32_t> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+            for (size_t i = 0; i < current.size(); ++i)
+                triangles[fill[remap[current[i]]]++] = (uint32_t)(i / 3);
+        }
+        mesh_simplify_edges(&edges, current.data(), current.size(), remap.data());
+
+        // every allowed collapse along a triangle edge, both ways
+        collapses.clear();
+        for (size_t t = 0; t + 2 < current.size(); t += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                uint32_t ends[2] = {current[t + e], current[t + (e + 1) % 3]};
+                for (int way = 0; way < 2; ++way)
+                {
+                    uint32_t from = ends[way], to = ends[1 - way];
+                    if (kind[from] == MESH_SIMPLIFY_LOCKED)
+                        continue;
+                    if (kind[from] == MESH_SIMPLIFY_BORDER)
+                    {
+                        // only along the border, which runs one way in the triangles
+                        bool border_edge = mesh_simplify_has_edge(edges, remap[to], remap[from]) == false ||
+                            mesh_simplify_has_edge(edges, remap[from], remap[to]) == false;
+                        if (kind[to] == MESH_SIMPLIFY_MANIFOLD || border_edge == false)
+                            continue;
+                    }
+                    // interior edges are seen from both triangles, keep one of the two
+                    if (kind[from] == MESH_SIMPLIFY_MANIFOLD && way == 1)
+                        continue;
+
+                    mesh_quadric q = quadrics[remap[from]];
+                    mesh_quadric_add(&q, &quadrics[remap[to]]);
+                    double cost = mesh_quadric_error(&q, mesh_simplify_position(positions, stride, to)) / (q.weight > 0.0 ? q.weight : 1.0);
+                    collapses.push_back({(float)cost, from, to});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const mesh_simplify_collapse &a, const mesh_simplify_collapse &b) {
+            return a.cost < b.cost || (a.cost == b.cost && (a.from < b.from || (a.from == b.from && a.to < b.to)));
+        });
+
+        // cheapest first. a collapse touches the ring around from, so the rings the tests below
+        // look at never change within a pass
+        for (size_t v = 0; v < vertex_count; ++v)
+            collapse_remap[v] = (uint32_t)v;
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t triangles_left = current.size() / 3;
+        size_t target_triangles = target_index_count / 3;
+        size_t applied = 0;
+        for (const mesh_simplify_collapse &collapse : collapses)
+        {
+            if (triangles_left <= target_triangles || collapse.cost > limit)
+                break;
+            uint32_t from = remap[collapse.from], to = remap[collapse.to];
+            if (touched[from] || touched[to])
+                continue;
+
+            // the positions around both ends. from is never locked, so its position is its own
+            ring_from.clear();
+            ring_to.clear();
+            size_t shared = 0;
+            for (int end = 0; end < 2; ++end)
+            {
+                uint32_t center = end == 0 ? from : to;
+                std::vector<uint32_t> *ring = end == 0 ? &ring_from : &ring_to;
+                for (uint32_t i = triangle_offsets[center]; i < triangle_offsets[center + 1]; ++i)
+                {
+                    size_t t = (size_t)triangles[i] * 3;
+                    bool has_from = false, has_to = false;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        uint32_t corner = remap[current[t + c]];
+                        has_from = has_from || corner == from;
+                        has_to = has_to || corner == to;
+                        if (corner != center && std::find(ring->begin(), ring->end(), corner) == ring->end())
+                            ring->push_back(corner);
+                    }
+                    shared += end == 0 && has_from && has_to ? 1 : 0;
+                }
+            }
+
+            // link condition: the ends may only share the corners opposite their edge, or the
+            // collapse pinches the surface
+            size_t common = 0;
+            for (uint32_t corner : ring_from)
+                common += corner != to && std::find(ring_to.begin(), ring_to.end(), corner) != ring_to.end() ? 1 : 0;
+            if (common != shared)
+                continue;
+
+            // no triangle around from may turn over
+            const float *target = mesh_simplify_position(positions, stride, collapse.to);
+            bool flips = false;
+            for (uint32_t i = triangle_offsets[from]; i < triangle_offsets[from + 1] && flips == false; ++i)
+            {
+                size_t t = (size_t)triangles[i] * 3;
+                const float *p[3];
+                int moving = -1;
+                bool collapses_away = false;
+                for (int c = 0; c < 3; ++c)
+                {
+                    p[c] = mesh_simplify_position(positions, stride, current[t + c]);
+                    moving = remap[current[t + c]] == from ? c : moving;
+                    collapses_away = collapses_away || remap[current[t + c]] == to;
+                }
+                if (collapses_away)
+                    continue;
+                double before[3], after[3];
+                mesh_simplify_normal(p[0], p[1], p[2], before);
+                p[moving] = target;
+                mesh_simplify_normal(p[0], p[1], p[2], after);
+                // turning by more than ~75 degrees counts too, that is how slivers that stand
+                // on edge come about
+                double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                double lengths = sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                    (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+                flips = dot <= 0.25 * lengths;
+            }
+            if (flips)
+                continue;
+
+            collapse_remap[collapse.from] = collapse.to;
+            mesh_quadric_add(&quadrics[to], &quadrics[from]);
+            touched[to] = 1;
+            for (uint32_t corner : ring_from)
+                touched[corner] = 1;
+            worst = std::max(worst, (double)collapse.cost);
+            triangles_left -= shared;
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        // apply, dropping the triangles that lost an edge
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < current.size(); t += 3)
+        {
+            uint32_t a = collapse_remap[current[t]], b = collapse_remap[current[t + 1]], c = collapse_remap[current[t + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                continue;
+            current[write++] = a;
+            current[write++] = b;
+            current[write++] = c;
+        }
+        current.resize(write);
+    }
+
+    if (result_error)
+        *result_error = (float)sqrt(worst);
+    memcpy(dest, current.data(), current.size() * sizeof(uint32_t));
+    return current.size();
+}
+
+struct mesh_lod
+{
+    std::vector<uint32_t> indices;
+    float error; // distance from the full mesh, 0 for level 0
+};
+
+// lods[0] is the input, every next level is simplified from the one before to ratio of its
+// triangles. errors add up along the chain, so each level's error bounds its distance from
+// the full mesh. stops at max_levels, past max_error or when a level keeps more than 90% of
+// the one before. returns the level count
+inline int
+mesh_build_lods(std::vector<mesh_lod> *lods, const uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+    size_t stride, int max_levels = MESH_LOD_MAX_LEVELS, float ratio = 0.5f, float max_error = FLT_MAX)
+{
+    lods->clear();
+    mesh_lod full;
+    full.indices.assign(indices, indices + index_count);
+    full.error = 0.0f;
+    lods->push_back(std::move(full));
+
+    while ((int)lods->size() < max_levels)
+    {
+        const mesh_lod &previous = lods->back();
+        size_t target = (size_t)((double)previous.indices.size() / 3.0 * ratio) * 3;
+        mesh_lod next;
+        next.indices.resize(previous.indices.size());
+        float error = 0.0f;
+        size_t count = mesh_simplify(next.indices.data(), previous.indices.data(), previous.indices.size(), positions, vertex_count,
+            stride, target, max_error - previous.error, &error);
+        if (count == 0 || (double)count > (double)previous.indices.size() * 0.9)
+            break;
+        next.indices.resize(count);
+        next.error = previous.error + error;
+        lods->push_back(std::move(next));
+    }
+    return (int)lods->size();
+}
@@ -0,0 +1,432 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "frustum_cull.h"
+#include "simd_math.h"
+
+// meshlets: an index buffer split into clusters of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles, each with a bounding sphere and a cone around its triangle
+// normals. clusters are culled on the cpu SIMD_MATH_WIDTH at a time against the frustum and
+// against the camera (every triangle facing away), the survivors are copied into one compact
+// index stream for a single DrawIndexed.
+//
+//     meshlet_build(&mesh, indices, index_count, positions, vertex_count, stride);
+//     frustum f = frustum_from_matrix(world * view * proj);
+//     uint32_t visible_count = meshlet_cull(&f, camera, &mesh.cull, 0, mesh.cull.count, visible);
+//     uint32_t index_count = meshlet_emit(stream, &mesh, visible, visible_count);
+//
+// bounds are in mesh space, so the frustum comes from world * view * proj and the camera
+// position has to be moved into mesh space too. front faces are clockwise like the examples
+// draw them, for those (b - a) x (c - a) points towards the viewer.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_CULL_STREAMS 8 // center x, y, z, radius, cone axis x, y, z, cone cutoff
+
+struct meshlet
+{
+    uint32_t vertex_offset;   // into meshlet_mesh::vertices
+    uint32_t triangle_offset; // into meshlet_mesh::triangles / 3 and meshlet_mesh::indices / 3
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+};
+
+struct meshlet_bounds
+{
+    float center[3];
+    float radius;
+    // a cluster faces away from every camera with dot(center - camera, axis) >=
+    // cutoff * |center - camera| + radius. axis 0 and cutoff 1 when the normals spread too far
+    float cone_axis[3];
+    float cone_cutoff;
+};
+
+struct meshlet_mesh
+{
+    std::vector<meshlet> meshlets;
+    std::vector<meshlet_bounds> bounds;
+    std::vector<uint32_t> vertices; // mesh vertex of every meshlet vertex
+    std::vector<uint8_t> triangles; // meshlet local corners, 3 per triangle
+    std::vector<uint32_t> indices;  // the same triangles with mesh indices, meshlet after meshlet
+    frustum_bounds cull = {};       // bounds as MESHLET_CULL_STREAMS streams
+};
+
+inline const float *
+meshlet_position(const float *positions, size_t stride, uint32_t v)
+{
+    return (const float *)((const uint8_t *)positions + (size_t)v * stride);
+}
+
+// unit normal of (b - a) x (c - a), 0 for degenerate triangles
+inline void
+meshlet_triangle_normal(const float *a, const float *b, const float *c, float n[3])
+{
+    float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    n[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    float inv = length > 0.0f ? 1.0f / length : 0.0f;
+    n[0] *= inv;
+    n[1] *= inv;
+    n[2] *= inv;
+}
+
+inline void
+meshlet_triangle_centroid(const uint32_t *indices, uint32_t triangle, const float *positions, size_t stride, float out[3])
+{
+    const float *a = meshlet_position(positions, stride, indices[(size_t)triangle * 3 + 0]);
+    const float *b = meshlet_position(positions, stride, indices[(size_t)triangle * 3 + 1]);
+    const float *c = meshlet_position(positions, stride, indices[(size_t)triangle * 3 + 2]);
+    for (int i = 0; i < 3; ++i)
+        out[i] = (a[i] + b[i] + c[i]) * (1.0f / 3.0f);
+}
+
+// distance from p to sum * scale
+inline float
+meshlet_distance(const float p[3], const float sum[3], float scale)
+{
+    float d[3] = {p[0] - sum[0] * scale, p[1] - sum[1] * scale, p[2] - sum[2] * scale};
+    return sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+// sphere around the aabb center of the meshlet's vertices, cone from its triangle normals
+inline meshlet_bounds
+meshlet_compute_bounds(const meshlet_mesh *mesh, const meshlet *m, const float *positions, size_t stride)
+{
+    meshlet_bounds b = {};
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    const uint32_t *vertices = &mesh->vertices[m->vertex_offset];
+    for (uint32_t v = 0; v < m->vertex_count; ++v)
+    {
+        const float *p = meshlet_position(positions, stride, vertices[v]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            lo[axis] = p[axis] < lo[axis] ? p[axis] : lo[axis];
+            hi[axis] = p[axis] > hi[axis] ? p[axis] : hi[axis];
+        }
+    }
+    float radius2 = 0.0f;
+    for (int axis = 0; axis < 3; ++axis)
+        b.center[axis] = (lo[axis] + hi[axis]) * 0.5f;
+    for (uint32_t v = 0; v < m->vertex_count; ++v)
+    {
+        const float *p = meshlet_position(positions, stride, vertices[v]);
+        float d[3] = {p[0] - b.center[0], p[1] - b.center[1], p[2] - b.center[2]};
+        float d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        radius2 = d2 > radius2 ? d2 : radius2;
+    }
+    // a little slack so the vertices on the sphere survive the SIMD test's rounding
+    b.radius = sqrtf(radius2) * 1.0001f;
+
+    const uint8_t *triangles = &mesh->triangles[(size_t)m->triangle_offset * 3];
+    float normals[MESHLET_MAX_TRIANGLES][3];
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t t = 0; t < m->triangle_count; ++t)
+    {
+        meshlet_triangle_normal(meshlet_position(positions, stride, vertices[triangles[t * 3 + 0]]),
+            meshlet_position(positions, stride, vertices[triangles[t * 3 + 1]]),
+            meshlet_position(positions, stride, vertices[triangles[t * 3 + 2]]), normals[t]);
+        for (int i = 0; i < 3; ++i)
+            axis[i] += normals[t][i];
+    }
+    float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float min_dot = 1.0f;
+    if (length > 0.0f)
+    {
+        for (int i = 0; i < 3; ++i)
+            axis[i] /= length;
+        for (uint32_t t = 0; t < m->triangle_count; ++t)
+        {
+            float d = normals[t][0] * axis[0] + normals[t][1] * axis[1] + normals[t][2] * axis[2];
+            min_dot = d < min_dot ? d : min_dot;
+        }
+    }
+
+    // the normals span more than a hemisphere around the axis, no camera sees only backs
+    if (length == 0.0f || min_dot <= 0.0f)
+    {
+        b.cone_cutoff = 1.0f;
+        return b;
+    }
+    for (int i = 0; i < 3; ++i)
+        b.cone_axis[i] = axis[i];
+    b.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+    return b;
+}
+
+// partitions the triangles into meshlets. every meshlet grows from a seed triangle, taking the
+// neighbour that adds the fewest new vertices and bends the normals least, until it runs out
+// of room or neighbours. the next seed is taken from the edge of the last meshlet, the first
+// unused triangle in index order when a connected piece is done
+inline bool
+meshlet_build(meshlet_mesh *mesh, const uint32_t *indices, size_t index_count, const float *positions, size_t vertex_count,
+    size_t stride, uint32_t max_vertices = MESHLET_MAX_VERTICES, uint32_t max_triangles = MESHLET_MAX_TRIANGLES)
+{
+    if (max_vertices > 255 || max_triangles > MESHLET_MAX_TRIANGLES || max_vertices < 3 || max_triangles < 1)
+        return false;
+
+    mesh->meshlets.clear();
+    mesh->bounds.clear();
+    mesh->vertices.clear();
+    mesh->triangles.clear();
+    mesh->indices.clear();
+    size_t triangle_count = index_count / 3;
+
+    // triangles around every vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0), adjacency(triangle_count * 3);
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertex_count; ++v)
+        offsets[v + 1] += offsets[v];
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangle_count * 3; ++i)
+            adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<float> normals(triangle_count * 3);
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+        meshlet_triangle_normal(meshlet_position(positions, stride, indices[t * 3 + 0]),
+            meshlet_position(positions, stride, indices[t * 3 + 1]), meshlet_position(positions, stride, indices[t * 3 + 2]),
+            &normals[t * 3]);
+    }
+
+    // local[v] is the meshlet corner of v, 0xff when v is not in the current meshlet
+    std::vector<uint8_t> local(vertex_count, 0xff);
+    std::vector<uint8_t> used(triangle_count, 0), queued(triangle_count, 0);
+    std::vector<uint32_t> candidates;
+    size_t seed = 0;
+    uint32_t border_seed = UINT32_MAX;
+    for (;;)
+    {
+        while (seed < triangle_count && used[seed])
+            seed++;
+        if (seed == triangle_count)
+            break;
+
+        meshlet m = {(uint32_t)mesh->vertices.size(), (uint32_t)(mesh->triangles.size() / 3), 0, 0};
+        float axis[3] = {0.0f, 0.0f, 0.0f};
+        float center[3] = {0.0f, 0.0f, 0.0f}; // sum of the triangle centroids
+        float extent = 0.0f;                  // furthest centroid from their mean
+        candidates.clear();
+        uint32_t next = border_seed != UINT32_MAX ? border_seed : (uint32_t)seed;
+        while (next != UINT32_MAX)
+        {
+            // take next
+            const uint32_t *corners = &indices[(size_t)next * 3];
+            used[next] = 1;
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t v = corners[c];
+                if (local[v] == 0xff)
+                {
+                    local[v] = (uint8_t)m.vertex_count++;
+                    mesh->vertices.push_back(v);
+                }
+                mesh->triangles.push_back(local[v]);
+                mesh->indices.push_back(v);
+
+                for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+                {
+                    uint32_t t = adjacency[i];
+                    if (used[t] == 0 && queued[t] == 0)
+                    {
+                        queued[t] = 1;
+                        candidates.push_back(t);
+                    }
+                }
+            }
+            float centroid[3];
+            meshlet_triangle_centroid(indices, next, positions, stride, centroid);
+            for (int i = 0; i < 3; ++i)
+            {
+                axis[i] += normals[(size_t)next * 3 + i];
+                center[i] += centroid[i];
+            }
+            m.triangle_count++;
+            extent = std::max(extent, meshlet_distance(centroid, center, 1.0f / (float)m.triangle_count));
+            if (m.triangle_count == max_triangles)
+                break;
+
+            // the cheapest neighbour that still fits: fewest new vertices, then the normal
+            // closest to the meshlet's and the centroid closest to its middle, which keeps
+            // meshlets round instead of growing strips along flat regions
+            float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            float inv = length > 0.0f ? 1.0f / length : 0.0f;
+            float inv_extent = extent > 0.0f ? 1.0f / extent : 0.0f;
+            float best_score = FLT_MAX;
+            next = UINT32_MAX;
+            for (size_t i = 0; i < candidates.size();)
+            {
+                uint32_t t = candidates[i];
+                if (used[t])
+                {
+                    queued[t] = 0;
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                ++i;
+                uint32_t added = 0;
+                for (int c = 0; c < 3; ++c)
+                    added += local[indices[(size_t)t * 3 + c]] == 0xff ? 1 : 0;
+                if (m.vertex_count + added > max_vertices)
+                    continue;
+                const float *n = &normals[(size_t)t * 3];
+                float spread = 1.0f - (n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]) * inv;
+                meshlet_triangle_centroid(indices, t, positions, stride, centroid);
+                float distance = meshlet_distance(centroid, center, 1.0f / (float)m.triangle_count) * inv_extent;
+                float score = (float)added * 4.0f + spread + distance;
+                if (score < best_score)
+                {
+                    best_score = score;
+                    next = t;
+                }
+            }
+        }
+
+        // the next meshlet starts next to this one, at the triangle most surrounded by used
+        // ones, so no islands of leftovers form in between
+        border_seed = UINT32_MAX;
+        uint32_t most_used = 0;
+        for (uint32_t t : candidates)
+        {
+            queued[t] = 0;
+            if (used[t])
+                continue;
+            uint32_t used_around = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t v = indices[(size_t)t * 3 + c];
+                for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+                    used_around += used[adjacency[i]];
+            }
+            if (border_seed == UINT32_MAX || used_around > most_used)
+            {
+                border_seed = t;
+                most_used = used_around;
+            }
+        }
+        for (uint32_t v = 0; v < m.vertex_count; ++v)
+            local[mesh->vertices[m.vertex_offset + v]] = 0xff;
+        mesh->meshlets.push_back(m);
+    }
+
+    for (const meshlet &m : mesh->meshlets)
+        mesh->bounds.push_back(meshlet_compute_bounds(mesh, &m, positions, stride));
+
+    frustum_bounds_free(&mesh->cull);
+    if (frustum_bounds_init(&mesh->cull, mesh->meshlets.size(), MESHLET_CULL_STREAMS) == false)
+        return false;
+    for (size_t i = 0; i < mesh->bounds.size(); ++i)
+    {
+        const meshlet_bounds &b = mesh->bounds[i];
+        float values[MESHLET_CULL_STREAMS] = {b.center[0], b.center[1], b.center[2], b.radius, b.cone_axis[0], b.cone_axis[1],
+            b.cone_axis[2], b.cone_cutoff};
+        for (int s = 0; s < MESHLET_CULL_STREAMS; ++s)
+            frustum_bounds_stream(&mesh->cull, s)[i] = values[s];
+    }
+    return true;
+}
+
+inline void
+meshlet_mesh_free(meshlet_mesh *mesh)
+{
+    frustum_bounds_free(&mesh->cull);
+}
+
+// the one at a time test meshlet_cull does SIMD_MATH_WIDTH at a time
+inline bool
+meshlet_visible(const frustum *f, const float camera[3], const meshlet_bounds *b)
+{
+    if (frustum_test_sphere(f, b->center[0], b->center[1], b->center[2], b->radius) == false)
+        return false;
+    float d[3] = {b->center[0] - camera[0], b->center[1] - camera[1], b->center[2] - camera[2]};
+    float distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    return d[0] * b->cone_axis[0] + d[1] * b->cone_axis[1] + d[2] * b->cone_axis[2] < b->cone_cutoff * distance + b->radius;
+}
+
+// indices in [begin, end) of the meshlets that intersect the frustum and have a triangle
+// facing camera go to visible, same rules as frustum_cull_spheres. returns the number written
+inline uint32_t
+meshlet_cull(const frustum *f, const float camera[3], const frustum_bounds *cull, size_t begin, size_t end, uint32_t *visible)
+{
+    const float *cx = frustum_bounds_stream(cull, 0);
+    const float *cy = frustum_bounds_stream(cull, 1);
+    const float *cz = frustum_bounds_stream(cull, 2);
+    const float *radius = frustum_bounds_stream(cull, 3);
+    const float *ax = frustum_bounds_stream(cull, 4);
+    const float *ay = frustum_bounds_stream(cull, 5);
+    const float *az = frustum_bounds_stream(cull, 6);
+    const float *cutoff = frustum_bounds_stream(cull, 7);
+
+    vf planes[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int i = 0; i < 4; ++i)
+            planes[p][i] = vf_splat(f->planes[p][i]);
+    vf camera_x = vf_splat(camera[0]), camera_y = vf_splat(camera[1]), camera_z = vf_splat(camera[2]);
+
+    vf zero = vf_splat(0.0f);
+    uint32_t n = 0;
+    for (size_t i = begin; i < end; i += SIMD_MATH_WIDTH)
+    {
+        vf x = vf_load(cx + i);
+        vf y = vf_load(cy + i);
+        vf z = vf_load(cz + i);
+        vf r = vf_load(radius + i);
+        vf neg_r = vf_sub(zero, r);
+
+        vf inside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            vf d = vf_madd(x, planes[p][0], vf_madd(y, planes[p][1], vf_madd(z, planes[p][2], planes[p][3])));
+            vf in_plane = vf_cmp_ge(d, neg_r);
+            inside = p == 0 ? in_plane : vf_and(inside, in_plane);
+        }
+
+        // back facing when dot(center - camera, axis) >= cutoff * |center - camera| + radius
+        vf dx = vf_sub(x, camera_x);
+        vf dy = vf_sub(y, camera_y);
+        vf dz = vf_sub(z, camera_z);
+        vf distance = vf_sqrt(vf_madd(dx, dx, vf_madd(dy, dy, vf_mul(dz, dz))));
+        vf along = vf_madd(dx, vf_load(ax + i), vf_madd(dy, vf_load(ay + i), vf_mul(dz, vf_load(az + i))));
+        vf back = vf_cmp_ge(along, vf_madd(vf_load(cutoff + i), distance, r));
+
+        uint32_t mask = vf_mask_bits(inside) & ~vf_mask_bits(back);
+        bool full = i + SIMD_MATH_WIDTH <= end;
+        if (full == false)
+            mask &= (1u << (end - i)) - 1;
+        n = frustum_emit(visible, n, mask, (uint32_t)i, full);
+    }
+    return n;
+}
+
+// copies the indices of the visible meshlets into dest, runs of neighbouring meshlets in one
+// go. dest needs room for mesh->indices.size(), returns the index count written
+inline uint32_t
+meshlet_emit(uint32_t *dest, const meshlet_mesh *mesh, const uint32_t *visible, uint32_t visible_count)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < visible_count;)
+    {
+        const meshlet &first = mesh->meshlets[visible[i]];
+        uint32_t begin = first.triangle_offset;
+        uint32_t end = begin + first.triangle_count;
+        for (++i; i < visible_count && visible[i] == visible[i - 1] + 1; ++i)
+            end += mesh->meshlets[visible[i]].triangle_count;
+        memcpy(dest + n, &mesh->indices[(size_t)begin * 3], (size_t)(end - begin) * 3 * sizeof(uint32_t));
+        n += (end - begin) * 3;
+    }
+    return n;
+}
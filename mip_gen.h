@@ -0,0 +1,447 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "profile.h"
+#include "simd_math.h"
+#include "thread_pool.h"
+
+// cpu mip chain generation for rgba8 images. every level is resampled from the level above
+// in linear space: rgb is decoded from srgb (unless srgb is false), alpha is always linear.
+// a level is split into bands of MIP_BAND_ROWS output rows that run on the thread pool.
+//
+// exact 2:1 box reductions average 2x2 blocks of 16 bit linear values from a table. every
+// other case goes through a separable float filter, each source row is decoded and filtered
+// horizontally one rgba pixel (v4) at a time, then the band is filtered vertically
+// SIMD_MATH_WIDTH floats at a time.
+
+#define MIP_MAX_LEVELS 16
+#define MIP_BAND_ROWS 16
+
+enum mip_filter
+{
+    MIP_FILTER_BOX,     // exact pixel coverage, a 2x2 average for even sizes
+    MIP_FILTER_KAISER,  // kaiser windowed sinc, radius 3, alpha 4
+    MIP_FILTER_LANCZOS, // lanczos 3
+};
+
+struct mip_level
+{
+    const uint8_t *data;
+    int width;
+    int height;
+    int pitch;
+};
+
+struct mip_chain
+{
+    // levels 1..n live in memory, level 0 points at the source image
+    uint8_t *memory;
+    mip_level levels[MIP_MAX_LEVELS];
+    int level_count;
+};
+
+// filter taps for every output sample along one axis, padded to the same count
+struct mip_taps
+{
+    int count;
+    std::vector<int> indices;
+    std::vector<float> weights;
+};
+
+inline int
+mip_level_count(int width, int height)
+{
+    int size = width > height ? width : height;
+    int count = 1;
+    while (size > 1 && count < MIP_MAX_LEVELS)
+    {
+        size >>= 1;
+        count++;
+    }
+    return count;
+}
+
+inline float
+mip_srgb_to_linear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float
+mip_linear_to_srgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// 256 srgb decodes followed by 256 linear decodes for alpha
+inline const float *
+mip_decode_table()
+{
+    static const std::vector<float> table = [] {
+        std::vector<float> t(512);
+        for (int i = 0; i < 256; ++i)
+        {
+            t[i] = mip_srgb_to_linear((float)i / 255.0f);
+            t[256 + i] = (float)i / 255.0f;
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// srgb byte -> linear value in 16 bits
+inline const uint16_t *
+mip_decode16_table()
+{
+    static const std::vector<uint16_t> table = [] {
+        std::vector<uint16_t> t(256);
+        for (int i = 0; i < 256; ++i)
+            t[i] = (uint16_t)(mip_srgb_to_linear((float)i / 255.0f) * 65535.0f + 0.5f);
+        return t;
+    }();
+    return table.data();
+}
+
+// linear value quantized to 16 bits -> srgb byte, fine enough to round like the exact curve
+inline const uint8_t *
+mip_encode_table()
+{
+    static const std::vector<uint8_t> table = [] {
+        std::vector<uint8_t> t(65536);
+        for (int i = 0; i < 65536; ++i)
+            t[i] = (uint8_t)(mip_linear_to_srgb((float)i / 65535.0f) * 255.0f + 0.5f);
+        return t;
+    }();
+    return table.data();
+}
+
+inline float
+mip_sinc(float x)
+{
+    if (fabsf(x) < 1e-6f)
+        return 1.0f;
+    x *= SIMD_MATH_PI;
+    return sinf(x) / x;
+}
+
+// modified bessel function of the first kind, order 0
+inline float
+mip_bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32; ++k)
+    {
+        float f = x / (2.0f * (float)k);
+        term *= f * f;
+        sum += term;
+        if (term < sum * 1e-8f)
+            break;
+    }
+    return sum;
+}
+
+inline float
+mip_filter_radius(mip_filter filter)
+{
+    return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+}
+
+// windowed sinc kernels, t is in output pixels
+inline float
+mip_filter_weight(mip_filter filter, float t)
+{
+    t = fabsf(t);
+    if (t >= 3.0f)
+        return 0.0f;
+    if (filter == MIP_FILTER_KAISER)
+    {
+        float r = t / 3.0f;
+        return mip_sinc(t) * mip_bessel_i0(4.0f * sqrtf(1.0f - r * r)) / mip_bessel_i0(4.0f);
+    }
+    return mip_sinc(t) * mip_sinc(t / 3.0f);
+}
+
+// taps mapping dst_size samples onto src_size, source indices are clamped to the edge
+inline void
+mip_build_taps(mip_taps *taps, mip_filter filter, int src_size, int dst_size)
+{
+    float scale = (float)src_size / (float)dst_size;
+    float radius = mip_filter_radius(filter) * scale;
+    int max_count = (int)ceilf(2.0f * radius) + 1;
+
+    std::vector<int> firsts(dst_size);
+    std::vector<float> weights((size_t)dst_size * max_count);
+    int lead = max_count;
+    int count = 0;
+    for (int dst = 0; dst < dst_size; ++dst)
+    {
+        float center = ((float)dst + 0.5f) * scale;
+        int first = (int)floorf(center - radius);
+        firsts[dst] = first;
+
+        float *w = &weights[(size_t)dst * max_count];
+        float total = 0.0f;
+        for (int k = 0; k < max_count; ++k)
+        {
+            float src = (float)(first + k);
+            if (filter == MIP_FILTER_BOX)
+            {
+                float lo = src > center - radius ? src : center - radius;
+                float hi = src + 1.0f < center + radius ? src + 1.0f : center + radius;
+                w[k] = hi > lo ? hi - lo : 0.0f;
+            }
+            else
+            {
+                w[k] = mip_filter_weight(filter, (src + 0.5f - center) / scale);
+            }
+            total += w[k];
+        }
+
+        for (int k = 0; k < max_count; ++k)
+        {
+            w[k] /= total;
+            if (w[k] != 0.0f)
+            {
+                lead = k < lead ? k : lead;
+                count = k + 1 > count ? k + 1 : count;
+            }
+        }
+    }
+
+    // drop the columns that are zero for every output
+    taps->count = count - lead;
+    taps->indices.resize((size_t)dst_size * taps->count);
+    taps->weights.resize((size_t)dst_size * taps->count);
+    for (int dst = 0; dst < dst_size; ++dst)
+    {
+        for (int k = 0; k < taps->count; ++k)
+        {
+            int src = firsts[dst] + lead + k;
+            src = src < 0 ? 0 : (src >= src_size ? src_size - 1 : src);
+            taps->indices[(size_t)dst * taps->count + k] = src;
+            taps->weights[(size_t)dst * taps->count + k] = weights[(size_t)dst * max_count + lead + k];
+        }
+    }
+}
+
+struct mip_level_job
+{
+    const mip_level *src;
+    uint8_t *dst;
+    int dst_width;
+    int dst_height;
+    bool srgb;
+    const mip_taps *rows;
+    const mip_taps *columns;
+    const float *decode;
+    const uint16_t *decode16;
+    const uint8_t *encode;
+};
+
+// exact 2:1 box in both directions
+inline void
+mip_box_band(const mip_level_job *job, int band)
+{
+    const mip_level *src = job->src;
+    const uint16_t *decode16 = job->decode16;
+    const uint8_t *encode = job->encode;
+    int y_begin = band * MIP_BAND_ROWS;
+    int y_end = y_begin + MIP_BAND_ROWS < job->dst_height ? y_begin + MIP_BAND_ROWS : job->dst_height;
+
+    for (int y = y_begin; y < y_end; ++y)
+    {
+        const uint8_t *a = src->data + (size_t)(y * 2) * src->pitch;
+        const uint8_t *b = a + src->pitch;
+        uint8_t *out = job->dst + (size_t)y * job->dst_width * 4;
+        if (job->srgb)
+        {
+            for (int x = 0; x < job->dst_width; ++x, a += 8, b += 8, out += 4)
+            {
+                out[0] = encode[(decode16[a[0]] + decode16[a[4]] + decode16[b[0]] + decode16[b[4]] + 2) >> 2];
+                out[1] = encode[(decode16[a[1]] + decode16[a[5]] + decode16[b[1]] + decode16[b[5]] + 2) >> 2];
+                out[2] = encode[(decode16[a[2]] + decode16[a[6]] + decode16[b[2]] + decode16[b[6]] + 2) >> 2];
+                out[3] = (uint8_t)((a[3] + a[7] + b[3] + b[7] + 2) >> 2);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < job->dst_width * 4; ++i)
+                out[i] = (uint8_t)((a[(i & ~3) * 2 + (i & 3)] + a[(i & ~3) * 2 + (i & 3) + 4] +
+                    b[(i & ~3) * 2 + (i & 3)] + b[(i & ~3) * 2 + (i & 3) + 4] + 2) >> 2);
+        }
+    }
+}
+
+inline void
+mip_resample_band(const mip_level_job *job, int band)
+{
+    const mip_level *src = job->src;
+    int y_begin = band * MIP_BAND_ROWS;
+    int y_end = y_begin + MIP_BAND_ROWS < job->dst_height ? y_begin + MIP_BAND_ROWS : job->dst_height;
+
+    // source rows this band reads
+    const mip_taps *rows = job->rows;
+    int src_first = src->height;
+    int src_last = 0;
+    for (size_t i = (size_t)y_begin * rows->count; i < (size_t)y_end * rows->count; ++i)
+    {
+        src_first = rows->indices[i] < src_first ? rows->indices[i] : src_first;
+        src_last = rows->indices[i] > src_last ? rows->indices[i] : src_last;
+    }
+
+    // filtered rows are padded to a multiple of 8 floats so every row stays aligned for vf
+    int row_floats = (job->dst_width * 4 + 7) & ~7;
+    int row_count = src_last - src_first + 1;
+    size_t float_count = (size_t)(row_count + 1) * row_floats + (size_t)src->width * 4;
+    float *filtered = (float *)simd_aligned_alloc(float_count * sizeof(float));
+    float *column = filtered + (size_t)row_count * row_floats;
+    float *decoded = column + row_floats;
+
+    // decode and filter every source row horizontally, one rgba pixel per v4
+    const mip_taps *columns = job->columns;
+    const float *rgb_decode = job->srgb ? job->decode : job->decode + 256;
+    const float *alpha_decode = job->decode + 256;
+    for (int y = src_first; y <= src_last; ++y)
+    {
+        const uint8_t *in = src->data + (size_t)y * src->pitch;
+        for (int x = 0; x < src->width * 4; x += 4)
+        {
+            decoded[x + 0] = rgb_decode[in[x + 0]];
+            decoded[x + 1] = rgb_decode[in[x + 1]];
+            decoded[x + 2] = rgb_decode[in[x + 2]];
+            decoded[x + 3] = alpha_decode[in[x + 3]];
+        }
+
+        float *out = filtered + (size_t)(y - src_first) * row_floats;
+        for (int x = 0; x < job->dst_width; ++x)
+        {
+            const int *column_indices = &columns->indices[(size_t)x * columns->count];
+            const float *column_weights = &columns->weights[(size_t)x * columns->count];
+            v4 sum = v4_splat(0.0f);
+            for (int k = 0; k < columns->count; ++k)
+                sum = v4_madd(v4_load(decoded + column_indices[k] * 4), v4_splat(column_weights[k]), sum);
+            v4_store(out + x * 4, sum);
+        }
+        for (int i = job->dst_width * 4; i < row_floats; ++i)
+            out[i] = 0.0f;
+    }
+
+    for (int y = y_begin; y < y_end; ++y)
+    {
+        // vertical pass over the whole row
+        const int *row_indices = &rows->indices[(size_t)y * rows->count];
+        const float *row_weights = &rows->weights[(size_t)y * rows->count];
+        for (int i = 0; i < row_floats; i += SIMD_MATH_WIDTH)
+        {
+            vf sum = vf_splat(0.0f);
+            for (int k = 0; k < rows->count; ++k)
+            {
+                const float *row = filtered + (size_t)(row_indices[k] - src_first) * row_floats;
+                sum = vf_madd(vf_load(row + i), vf_splat(row_weights[k]), sum);
+            }
+            vf_store(column + i, sum);
+        }
+
+        uint8_t *out = job->dst + (size_t)y * job->dst_width * 4;
+        for (int i = 0; i < job->dst_width * 4; ++i)
+        {
+            // sinc filters ring past [0, 1]
+            float v = column[i] < 0.0f ? 0.0f : (column[i] > 1.0f ? 1.0f : column[i]);
+            if ((i & 3) != 3 && job->srgb)
+                out[i] = job->encode[(int)(v * 65535.0f + 0.5f)];
+            else
+                out[i] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+    }
+
+    simd_aligned_free(filtered);
+}
+
+// builds every level below the tightly packed rgba8 source, level 0 aliases pixels so it
+// has to outlive the chain. pool may be null to run on the calling thread only
+inline bool
+mip_chain_build(mip_chain *chain, const uint8_t *pixels, int width, int height, mip_filter filter, bool srgb, thread_pool *pool)
+{
+    PROFILE_ZONE("mip_chain_build");
+    chain->level_count = mip_level_count(width, height);
+    chain->levels[0].data = pixels;
+    chain->levels[0].width = width;
+    chain->levels[0].height = height;
+    chain->levels[0].pitch = width * 4;
+
+    size_t total = 0;
+    for (int level = 1; level < chain->level_count; ++level)
+    {
+        int w = width >> level > 0 ? width >> level : 1;
+        int h = height >> level > 0 ? height >> level : 1;
+        chain->levels[level].width = w;
+        chain->levels[level].height = h;
+        chain->levels[level].pitch = w * 4;
+        total += (size_t)w * h * 4;
+    }
+
+    chain->memory = (uint8_t *)malloc(total > 0 ? total : 1);
+    if (chain->memory == nullptr)
+        return false;
+
+    size_t offset = 0;
+    for (int level = 1; level < chain->level_count; ++level)
+    {
+        const mip_level *src = &chain->levels[level - 1];
+        mip_level *dst = &chain->levels[level];
+        uint8_t *dst_data = chain->memory + offset;
+        dst->data = dst_data;
+        offset += (size_t)dst->pitch * dst->height;
+
+        mip_level_job job;
+        job.src = src;
+        job.dst = dst_data;
+        job.dst_width = dst->width;
+        job.dst_height = dst->height;
+        job.srgb = srgb;
+        job.decode = mip_decode_table();
+        job.decode16 = mip_decode16_table();
+        job.encode = mip_encode_table();
+
+        int band_count = (dst->height + MIP_BAND_ROWS - 1) / MIP_BAND_ROWS;
+        bool box_2x2 = filter == MIP_FILTER_BOX && src->width == dst->width * 2 && src->height == dst->height * 2;
+
+        mip_taps rows, columns;
+        if (box_2x2 == false)
+        {
+            mip_build_taps(&rows, filter, src->height, dst->height);
+            mip_build_taps(&columns, filter, src->width, dst->width);
+        }
+        job.rows = &rows;
+        job.columns = &columns;
+
+        auto run_band = [&](int band) {
+            PROFILE_ZONE("mip band");
+            if (box_2x2)
+                mip_box_band(&job, band);
+            else
+                mip_resample_band(&job, band);
+        };
+        if (pool)
+            thread_pool_parallel_for(pool, band_count, run_band);
+        else
+            for (int band = 0; band < band_count; ++band)
+                run_band(band);
+    }
+    return true;
+}
+
+inline void
+mip_chain_free(mip_chain *chain)
+{
+    free(chain->memory);
+    chain->memory = nullptr;
+    chain->level_count = 0;
+}
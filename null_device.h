@@ -0,0 +1,1168 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// null rendering backend. it takes the same call stream the d3d11 examples issue, with
+// the same argument rules, checks every call like the debug layer would and counts it,
+// but never touches a gpu or a pixel. what is left is the cpu cost of building and
+// submitting a frame, so it runs anywhere, linux included.
+//
+// objects live in per type tables and are referred to by null_handle, 0 is the null
+// object. constants that have a d3d11 counterpart use the same values.
+//
+// the pipeline is validated lazily like a driver does it: set calls only mark the state
+// dirty, the first draw after a change checks shaders, layouts, bound buffers, views and
+// viewports together, later draws only check what depends on their own arguments (index
+// range, vertex range, buffers still mapped). fences complete gpu_latency presents after
+// they are signaled.
+
+#define NULL_VERTEX_BUFFER_SLOTS 32       // D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
+#define NULL_CONSTANT_BUFFER_SLOTS 14     // D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT
+#define NULL_SHADER_RESOURCE_SLOTS 128    // D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT
+#define NULL_SAMPLER_SLOTS 16             // D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT
+#define NULL_RENDER_TARGET_SLOTS 8        // D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT
+#define NULL_VIEWPORT_SLOTS 16
+#define NULL_MAX_CONSTANTS 4096           // D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT
+#define NULL_MAX_INPUT_ELEMENTS 32
+#define NULL_MAX_MESSAGES 64
+#define NULL_MAX_LATENCY 8
+
+#define NULL_BIND_VERTEX_BUFFER 0x1
+#define NULL_BIND_INDEX_BUFFER 0x2
+#define NULL_BIND_CONSTANT_BUFFER 0x4
+
+enum null_usage
+{
+    NULL_USAGE_DEFAULT = 0,
+    NULL_USAGE_IMMUTABLE = 1,
+    NULL_USAGE_DYNAMIC = 2,
+};
+
+enum null_map_type
+{
+    NULL_MAP_WRITE_DISCARD = 4,
+    NULL_MAP_WRITE_NO_OVERWRITE = 5,
+};
+
+enum null_index_format
+{
+    NULL_INDEX_FORMAT_R32_UINT = 42,
+    NULL_INDEX_FORMAT_R16_UINT = 57,
+};
+
+enum null_topology
+{
+    NULL_TOPOLOGY_UNDEFINED = 0,
+    NULL_TOPOLOGY_TRIANGLELIST = 4,
+    NULL_TOPOLOGY_TRIANGLESTRIP = 5,
+};
+
+enum null_object_type
+{
+    NULL_OBJECT_BUFFER,
+    NULL_OBJECT_INPUT_LAYOUT,
+    NULL_OBJECT_VERTEX_SHADER,
+    NULL_OBJECT_PIXEL_SHADER,
+    NULL_OBJECT_RENDER_TARGET_VIEW,
+    NULL_OBJECT_DEPTH_STENCIL_VIEW,
+    NULL_OBJECT_SHADER_RESOURCE_VIEW,
+    NULL_OBJECT_SAMPLER_STATE,
+    NULL_OBJECT_DEPTH_STENCIL_STATE,
+    NULL_OBJECT_TYPE_COUNT,
+};
+
+// every entry point, for the per call counters
+enum null_call
+{
+    NULL_CALL_IA_SET_INPUT_LAYOUT,
+    NULL_CALL_IA_SET_PRIMITIVE_TOPOLOGY,
+    NULL_CALL_IA_SET_VERTEX_BUFFERS,
+    NULL_CALL_IA_SET_INDEX_BUFFER,
+    NULL_CALL_VS_SET_SHADER,
+    NULL_CALL_VS_SET_CONSTANT_BUFFERS,
+    NULL_CALL_PS_SET_SHADER,
+    NULL_CALL_PS_SET_CONSTANT_BUFFERS,
+    NULL_CALL_PS_SET_SHADER_RESOURCES,
+    NULL_CALL_PS_SET_SAMPLERS,
+    NULL_CALL_RS_SET_VIEWPORTS,
+    NULL_CALL_OM_SET_RENDER_TARGETS,
+    NULL_CALL_OM_SET_DEPTH_STENCIL_STATE,
+    NULL_CALL_CLEAR_RENDER_TARGET_VIEW,
+    NULL_CALL_CLEAR_DEPTH_STENCIL_VIEW,
+    NULL_CALL_MAP,
+    NULL_CALL_UNMAP,
+    NULL_CALL_DRAW,
+    NULL_CALL_DRAW_INDEXED,
+    NULL_CALL_DRAW_INDEXED_INSTANCED,
+    NULL_CALL_PRESENT,
+    NULL_CALL_COUNT,
+};
+
+inline const char *
+null_call_name(int call)
+{
+    static const char *names[NULL_CALL_COUNT] = {
+        "IASetInputLayout", "IASetPrimitiveTopology", "IASetVertexBuffers", "IASetIndexBuffer",
+        "VSSetShader", "VSSetConstantBuffers", "PSSetShader", "PSSetConstantBuffers",
+        "PSSetShaderResources", "PSSetSamplers", "RSSetViewports", "OMSetRenderTargets",
+        "OMSetDepthStencilState", "ClearRenderTargetView", "ClearDepthStencilView", "Map",
+        "Unmap", "Draw", "DrawIndexed", "DrawIndexedInstanced", "Present",
+    };
+    return call >= 0 && call < NULL_CALL_COUNT ? names[call] : "?";
+}
+
+typedef uint32_t null_handle;
+
+struct null_input_element
+{
+    uint32_t input_slot;
+    uint32_t aligned_byte_offset;
+    uint32_t size; // bytes of the element format, 12 for R32G32B32_FLOAT
+    bool per_instance;
+};
+
+// what the shader reflection of a compiled shader says it reads
+struct null_shader_desc
+{
+    uint32_t constant_buffer_sizes[NULL_CONSTANT_BUFFER_SLOTS]; // bytes, 0 for unused slots
+    uint32_t resource_mask; // shader resource slots 0..31
+    uint32_t sampler_mask;
+};
+
+struct null_viewport
+{
+    float top_left_x;
+    float top_left_y;
+    float width;
+    float height;
+    float min_depth;
+    float max_depth;
+};
+
+struct null_buffer
+{
+    uint32_t size;
+    uint32_t bind_flags;
+    null_usage usage;
+    uint32_t max_index; // largest index in an index buffer with initial data
+    bool has_max_index;
+    bool mapped;
+    uint8_t *memory; // dynamic buffers only, what map returns
+};
+
+struct null_input_layout
+{
+    uint32_t slot_mask;
+    uint32_t instance_slot_mask;
+    uint32_t min_strides[NULL_VERTEX_BUFFER_SLOTS]; // end of the last element per slot
+};
+
+struct null_view
+{
+    uint32_t width;
+    uint32_t height;
+};
+
+// one generation counter per slot catches stale handles
+struct null_object
+{
+    null_object_type type;
+    uint32_t generation;
+    bool alive;
+    union
+    {
+        null_buffer buffer;
+        null_input_layout input_layout;
+        null_shader_desc shader;
+        null_view view;
+    };
+};
+
+struct null_stats
+{
+    uint64_t calls[NULL_CALL_COUNT];
+    uint64_t state_changes; // every set call
+    uint64_t draws;
+    uint64_t instances;
+    uint64_t indices; // vertices for Draw
+    uint64_t pipeline_validations;
+    uint64_t presents;
+    uint64_t errors;
+};
+
+struct null_constant_binding
+{
+    null_handle buffer;
+    uint32_t first_constant;
+    uint32_t constant_count;
+};
+
+struct null_device
+{
+    std::vector<null_object> objects;
+    std::vector<uint32_t> free_slots;
+
+    // pipeline state
+    null_handle input_layout;
+    null_topology topology;
+    null_handle vertex_buffers[NULL_VERTEX_BUFFER_SLOTS];
+    uint32_t vertex_strides[NULL_VERTEX_BUFFER_SLOTS];
+    uint32_t vertex_offsets[NULL_VERTEX_BUFFER_SLOTS];
+    null_handle index_buffer;
+    null_index_format index_format;
+    uint32_t index_offset;
+    null_handle vertex_shader;
+    null_handle pixel_shader;
+    null_constant_binding vs_constant_buffers[NULL_CONSTANT_BUFFER_SLOTS];
+    null_constant_binding ps_constant_buffers[NULL_CONSTANT_BUFFER_SLOTS];
+    null_handle ps_resources[NULL_SHADER_RESOURCE_SLOTS];
+    null_handle ps_samplers[NULL_SAMPLER_SLOTS];
+    null_viewport viewports[NULL_VIEWPORT_SLOTS];
+    uint32_t viewport_count;
+    null_handle render_targets[NULL_RENDER_TARGET_SLOTS];
+    uint32_t render_target_count;
+    null_handle depth_stencil_view;
+    null_handle depth_stencil_state;
+    bool pipeline_dirty;
+    bool pipeline_valid;
+    uint32_t mapped_count;
+
+    // fences
+    uint64_t fence;
+    uint64_t present_fences[NULL_MAX_LATENCY];
+    uint64_t waited_fence;
+    uint32_t gpu_latency;
+
+    null_stats stats;
+    std::vector<std::string> messages; // the first NULL_MAX_MESSAGES errors
+};
+
+inline void
+null_error(null_device *device, const char *format, ...)
+{
+    device->stats.errors++;
+    if (device->messages.size() >= NULL_MAX_MESSAGES)
+        return;
+
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    device->messages.push_back(message);
+}
+
+// gpu_latency is the number of presents before a signaled fence completes
+inline void
+null_device_init(null_device *device, uint32_t gpu_latency = 2)
+{
+    device->objects.clear();
+    device->free_slots.clear();
+    device->messages.clear();
+
+    device->input_layout = 0;
+    device->topology = NULL_TOPOLOGY_UNDEFINED;
+    for (int i = 0; i < NULL_VERTEX_BUFFER_SLOTS; ++i)
+    {
+        device->vertex_buffers[i] = 0;
+        device->vertex_strides[i] = 0;
+        device->vertex_offsets[i] = 0;
+    }
+    device->index_buffer = 0;
+    device->index_format = NULL_INDEX_FORMAT_R32_UINT;
+    device->index_offset = 0;
+    device->vertex_shader = 0;
+    device->pixel_shader = 0;
+    for (int i = 0; i < NULL_CONSTANT_BUFFER_SLOTS; ++i)
+    {
+        device->vs_constant_buffers[i] = {};
+        device->ps_constant_buffers[i] = {};
+    }
+    for (int i = 0; i < NULL_SHADER_RESOURCE_SLOTS; ++i)
+        device->ps_resources[i] = 0;
+    for (int i = 0; i < NULL_SAMPLER_SLOTS; ++i)
+        device->ps_samplers[i] = 0;
+    device->viewport_count = 0;
+    for (int i = 0; i < NULL_RENDER_TARGET_SLOTS; ++i)
+        device->render_targets[i] = 0;
+    device->render_target_count = 0;
+    device->depth_stencil_view = 0;
+    device->depth_stencil_state = 0;
+    device->pipeline_dirty = true;
+    device->pipeline_valid = false;
+    device->mapped_count = 0;
+
+    device->fence = 0;
+    for (int i = 0; i < NULL_MAX_LATENCY; ++i)
+        device->present_fences[i] = 0;
+    device->waited_fence = 0;
+    device->gpu_latency = gpu_latency < NULL_MAX_LATENCY ? gpu_latency : NULL_MAX_LATENCY - 1;
+    device->stats = {};
+}
+
+inline void
+null_device_shutdown(null_device *device)
+{
+    for (null_object &object : device->objects)
+    {
+        if (object.alive && object.type == NULL_OBJECT_BUFFER)
+            free(object.buffer.memory);
+    }
+    device->objects.clear();
+    device->free_slots.clear();
+}
+
+// handles are slot index + 1 in the low 20 bits and the slot's generation above
+inline null_handle
+null_make_handle(uint32_t slot, uint32_t generation)
+{
+    return ((generation & 0xfff) << 20) | (slot + 1);
+}
+
+inline null_object *
+null_lookup(null_device *device, null_handle handle, null_object_type type)
+{
+    uint32_t slot = (handle & 0xfffff) - 1;
+    if (handle == 0 || slot >= device->objects.size())
+        return nullptr;
+    null_object *object = &device->objects[slot];
+    if (object->alive == false || object->type != type || (object->generation & 0xfff) != handle >> 20)
+        return nullptr;
+    return object;
+}
+
+inline null_handle
+null_create_object(null_device *device, null_object_type type, null_object **out)
+{
+    uint32_t slot;
+    if (device->free_slots.empty() == false)
+    {
+        slot = device->free_slots.back();
+        device->free_slots.pop_back();
+    }
+    else
+    {
+        slot = (uint32_t)device->objects.size();
+        device->objects.push_back({});
+    }
+
+    null_object *object = &device->objects[slot];
+    uint32_t generation = object->generation + 1;
+    memset(object, 0, sizeof(*object));
+    object->type = type;
+    object->generation = generation;
+    object->alive = true;
+    *out = object;
+    return null_make_handle(slot, generation);
+}
+
+// index_data is only looked at for index buffers, it bounds the vertex range of their draws
+inline null_handle
+null_create_buffer(null_device *device, uint32_t size, null_usage usage, uint32_t bind_flags, const void *initial_data = nullptr,
+    null_index_format index_format = NULL_INDEX_FORMAT_R32_UINT)
+{
+    if (size == 0 || bind_flags == 0)
+    {
+        null_error(device, "CreateBuffer: size and bind flags can't be 0");
+        return 0;
+    }
+    if ((bind_flags & NULL_BIND_CONSTANT_BUFFER) && (size % 16 != 0 || bind_flags != NULL_BIND_CONSTANT_BUFFER))
+    {
+        null_error(device, "CreateBuffer: constant buffers are a multiple of 16 bytes and can't have other bind flags");
+        return 0;
+    }
+    if (usage == NULL_USAGE_IMMUTABLE && initial_data == nullptr)
+    {
+        null_error(device, "CreateBuffer: immutable buffers need initial data");
+        return 0;
+    }
+
+    uint8_t *memory = nullptr;
+    if (usage == NULL_USAGE_DYNAMIC)
+    {
+        memory = (uint8_t *)calloc(1, size);
+        if (memory == nullptr)
+        {
+            null_error(device, "CreateBuffer: out of memory");
+            return 0;
+        }
+    }
+
+    null_object *object;
+    null_handle handle = null_create_object(device, NULL_OBJECT_BUFFER, &object);
+    null_buffer *buffer = &object->buffer;
+    buffer->size = size;
+    buffer->bind_flags = bind_flags;
+    buffer->usage = usage;
+    buffer->memory = memory;
+
+    if ((bind_flags & NULL_BIND_INDEX_BUFFER) && initial_data)
+    {
+        uint32_t max_index = 0;
+        if (index_format == NULL_INDEX_FORMAT_R16_UINT)
+        {
+            for (uint32_t i = 0; i < size / 2; ++i)
+                max_index = ((const uint16_t *)initial_data)[i] > max_index ? ((const uint16_t *)initial_data)[i] : max_index;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < size / 4; ++i)
+                max_index = ((const uint32_t *)initial_data)[i] > max_index ? ((const uint32_t *)initial_data)[i] : max_index;
+        }
+        buffer->max_index = max_index;
+        buffer->has_max_index = usage == NULL_USAGE_IMMUTABLE;
+    }
+    return handle;
+}
+
+inline null_handle
+null_create_input_layout(null_device *device, const null_input_element *elements, uint32_t count)
+{
+    if (count == 0 || count > NULL_MAX_INPUT_ELEMENTS)
+    {
+        null_error(device, "CreateInputLayout: %u elements", count);
+        return 0;
+    }
+
+    null_input_layout layout = {};
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const null_input_element *element = &elements[i];
+        if (element->input_slot >= NULL_VERTEX_BUFFER_SLOTS || element->size == 0 || element->aligned_byte_offset % 4 != 0)
+        {
+            null_error(device, "CreateInputLayout: element %u has slot %u, offset %u, size %u", i, element->input_slot,
+                element->aligned_byte_offset, element->size);
+            return 0;
+        }
+
+        uint32_t bit = 1u << element->input_slot;
+        if ((layout.slot_mask & bit) && ((layout.instance_slot_mask & bit) != 0) != element->per_instance)
+        {
+            null_error(device, "CreateInputLayout: slot %u mixes per vertex and per instance data", element->input_slot);
+            return 0;
+        }
+        layout.slot_mask |= bit;
+        if (element->per_instance)
+            layout.instance_slot_mask |= bit;
+
+        uint32_t end = element->aligned_byte_offset + element->size;
+        if (end > layout.min_strides[element->input_slot])
+            layout.min_strides[element->input_slot] = end;
+    }
+
+    null_object *object;
+    null_handle handle = null_create_object(device, NULL_OBJECT_INPUT_LAYOUT, &object);
+    object->input_layout = layout;
+    return handle;
+}
+
+inline null_handle
+null_create_shader(null_device *device, null_object_type type, const null_shader_desc *desc)
+{
+    null_object *object;
+    null_handle handle = null_create_object(device, type, &object);
+    if (desc)
+        object->shader = *desc;
+    return handle;
+}
+
+inline null_handle
+null_create_vertex_shader(null_device *device, const null_shader_desc *desc)
+{
+    return null_create_shader(device, NULL_OBJECT_VERTEX_SHADER, desc);
+}
+
+inline null_handle
+null_create_pixel_shader(null_device *device, const null_shader_desc *desc)
+{
+    return null_create_shader(device, NULL_OBJECT_PIXEL_SHADER, desc);
+}
+
+inline null_handle
+null_create_view(null_device *device, null_object_type type, uint32_t width, uint32_t height)
+{
+    null_object *object;
+    null_handle handle = null_create_object(device, type, &object);
+    object->view.width = width;
+    object->view.height = height;
+    return handle;
+}
+
+inline null_handle
+null_create_render_target_view(null_device *device, uint32_t width, uint32_t height)
+{
+    return null_create_view(device, NULL_OBJECT_RENDER_TARGET_VIEW, width, height);
+}
+
+inline null_handle
+null_create_depth_stencil_view(null_device *device, uint32_t width, uint32_t height)
+{
+    return null_create_view(device, NULL_OBJECT_DEPTH_STENCIL_VIEW, width, height);
+}
+
+inline null_handle
+null_create_shader_resource_view(null_device *device, uint32_t width, uint32_t height)
+{
+    return null_create_view(device, NULL_OBJECT_SHADER_RESOURCE_VIEW, width, height);
+}
+
+inline null_handle
+null_create_sampler_state(null_device *device)
+{
+    null_object *object;
+    return null_create_object(device, NULL_OBJECT_SAMPLER_STATE, &object);
+}
+
+inline null_handle
+null_create_depth_stencil_state(null_device *device)
+{
+    null_object *object;
+    return null_create_object(device, NULL_OBJECT_DEPTH_STENCIL_STATE, &object);
+}
+
+// like the last Release, objects still bound keep a stale handle that validation reports
+inline void
+null_release(null_device *device, null_handle handle)
+{
+    uint32_t slot = (handle & 0xfffff) - 1;
+    if (handle == 0 || slot >= device->objects.size() || device->objects[slot].alive == false ||
+        (device->objects[slot].generation & 0xfff) != handle >> 20)
+    {
+        null_error(device, "Release: invalid handle 0x%08x", handle);
+        return;
+    }
+
+    null_object *object = &device->objects[slot];
+    if (object->type == NULL_OBJECT_BUFFER)
+    {
+        if (object->buffer.mapped)
+            device->mapped_count--;
+        free(object->buffer.memory);
+    }
+    object->alive = false;
+    device->free_slots.push_back(slot);
+    device->pipeline_dirty = true;
+}
+
+// set calls, arguments are checked here and the combination at the next draw
+
+inline void
+null_ia_set_input_layout(null_device *device, null_handle input_layout)
+{
+    device->stats.calls[NULL_CALL_IA_SET_INPUT_LAYOUT]++;
+    device->stats.state_changes++;
+    device->input_layout = input_layout;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_ia_set_primitive_topology(null_device *device, null_topology topology)
+{
+    device->stats.calls[NULL_CALL_IA_SET_PRIMITIVE_TOPOLOGY]++;
+    device->stats.state_changes++;
+    device->topology = topology;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_ia_set_vertex_buffers(null_device *device, uint32_t start_slot, uint32_t count, const null_handle *buffers,
+    const uint32_t *strides, const uint32_t *offsets)
+{
+    device->stats.calls[NULL_CALL_IA_SET_VERTEX_BUFFERS]++;
+    device->stats.state_changes++;
+    if (start_slot + count > NULL_VERTEX_BUFFER_SLOTS)
+    {
+        null_error(device, "IASetVertexBuffers: slots %u..%u out of range", start_slot, start_slot + count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        device->vertex_buffers[start_slot + i] = buffers[i];
+        device->vertex_strides[start_slot + i] = strides[i];
+        device->vertex_offsets[start_slot + i] = offsets[i];
+    }
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_ia_set_index_buffer(null_device *device, null_handle buffer, null_index_format format, uint32_t offset)
+{
+    device->stats.calls[NULL_CALL_IA_SET_INDEX_BUFFER]++;
+    device->stats.state_changes++;
+    if (format != NULL_INDEX_FORMAT_R16_UINT && format != NULL_INDEX_FORMAT_R32_UINT)
+    {
+        null_error(device, "IASetIndexBuffer: format %d is not R16_UINT or R32_UINT", (int)format);
+        return;
+    }
+    if (offset % (format == NULL_INDEX_FORMAT_R16_UINT ? 2 : 4) != 0)
+    {
+        null_error(device, "IASetIndexBuffer: offset %u is not aligned to the index size", offset);
+        return;
+    }
+    device->index_buffer = buffer;
+    device->index_format = format;
+    device->index_offset = offset;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_vs_set_shader(null_device *device, null_handle shader)
+{
+    device->stats.calls[NULL_CALL_VS_SET_SHADER]++;
+    device->stats.state_changes++;
+    device->vertex_shader = shader;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_ps_set_shader(null_device *device, null_handle shader)
+{
+    device->stats.calls[NULL_CALL_PS_SET_SHADER]++;
+    device->stats.state_changes++;
+    device->pixel_shader = shader;
+    device->pipeline_dirty = true;
+}
+
+// first_constants and constant_counts may be null for the whole buffer (VSSetConstantBuffers),
+// otherwise it is VSSetConstantBuffers1 and ranges are in 16 byte constants, multiples of 16
+inline void
+null_set_constant_buffers(null_device *device, null_constant_binding *bindings, const char *name, uint32_t start_slot, uint32_t count,
+    const null_handle *buffers, const uint32_t *first_constants, const uint32_t *constant_counts)
+{
+    device->stats.state_changes++;
+    if (start_slot + count > NULL_CONSTANT_BUFFER_SLOTS)
+    {
+        null_error(device, "%s: slots %u..%u out of range", name, start_slot, start_slot + count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        null_constant_binding binding = {buffers[i], 0, 0};
+        if (first_constants && constant_counts)
+        {
+            binding.first_constant = first_constants[i];
+            binding.constant_count = constant_counts[i];
+            if (binding.first_constant % 16 != 0 || binding.constant_count % 16 != 0 ||
+                binding.constant_count == 0 || binding.constant_count > NULL_MAX_CONSTANTS)
+            {
+                null_error(device, "%s: slot %u range %u+%u is not in multiples of 16 constants up to 4096", name,
+                    start_slot + i, binding.first_constant, binding.constant_count);
+                return;
+            }
+        }
+        bindings[start_slot + i] = binding;
+    }
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_vs_set_constant_buffers(null_device *device, uint32_t start_slot, uint32_t count, const null_handle *buffers,
+    const uint32_t *first_constants = nullptr, const uint32_t *constant_counts = nullptr)
+{
+    device->stats.calls[NULL_CALL_VS_SET_CONSTANT_BUFFERS]++;
+    null_set_constant_buffers(device, device->vs_constant_buffers, "VSSetConstantBuffers", start_slot, count, buffers,
+        first_constants, constant_counts);
+}
+
+inline void
+null_ps_set_constant_buffers(null_device *device, uint32_t start_slot, uint32_t count, const null_handle *buffers,
+    const uint32_t *first_constants = nullptr, const uint32_t *constant_counts = nullptr)
+{
+    device->stats.calls[NULL_CALL_PS_SET_CONSTANT_BUFFERS]++;
+    null_set_constant_buffers(device, device->ps_constant_buffers, "PSSetConstantBuffers", start_slot, count, buffers,
+        first_constants, constant_counts);
+}
+
+inline void
+null_ps_set_shader_resources(null_device *device, uint32_t start_slot, uint32_t count, const null_handle *views)
+{
+    device->stats.calls[NULL_CALL_PS_SET_SHADER_RESOURCES]++;
+    device->stats.state_changes++;
+    if (start_slot + count > NULL_SHADER_RESOURCE_SLOTS)
+    {
+        null_error(device, "PSSetShaderResources: slots %u..%u out of range", start_slot, start_slot + count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+        device->ps_resources[start_slot + i] = views[i];
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_ps_set_samplers(null_device *device, uint32_t start_slot, uint32_t count, const null_handle *samplers)
+{
+    device->stats.calls[NULL_CALL_PS_SET_SAMPLERS]++;
+    device->stats.state_changes++;
+    if (start_slot + count > NULL_SAMPLER_SLOTS)
+    {
+        null_error(device, "PSSetSamplers: slots %u..%u out of range", start_slot, start_slot + count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+        device->ps_samplers[start_slot + i] = samplers[i];
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_rs_set_viewports(null_device *device, uint32_t count, const null_viewport *viewports)
+{
+    device->stats.calls[NULL_CALL_RS_SET_VIEWPORTS]++;
+    device->stats.state_changes++;
+    if (count > NULL_VIEWPORT_SLOTS)
+    {
+        null_error(device, "RSSetViewports: %u viewports", count);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const null_viewport *viewport = &viewports[i];
+        if ((viewport->width > 0.0f && viewport->height > 0.0f) == false || viewport->min_depth < 0.0f ||
+            viewport->max_depth > 1.0f || viewport->min_depth > viewport->max_depth)
+        {
+            null_error(device, "RSSetViewports: viewport %u is %gx%g with depth %g..%g", i, viewport->width,
+                viewport->height, viewport->min_depth, viewport->max_depth);
+            return;
+        }
+        device->viewports[i] = *viewport;
+    }
+    device->viewport_count = count;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_om_set_render_targets(null_device *device, uint32_t count, const null_handle *render_targets, null_handle depth_stencil_view)
+{
+    device->stats.calls[NULL_CALL_OM_SET_RENDER_TARGETS]++;
+    device->stats.state_changes++;
+    if (count > NULL_RENDER_TARGET_SLOTS)
+    {
+        null_error(device, "OMSetRenderTargets: %u render targets", count);
+        return;
+    }
+    for (uint32_t i = 0; i < NULL_RENDER_TARGET_SLOTS; ++i)
+        device->render_targets[i] = i < count ? render_targets[i] : 0;
+    device->render_target_count = count;
+    device->depth_stencil_view = depth_stencil_view;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_om_set_depth_stencil_state(null_device *device, null_handle state, uint32_t stencil_ref)
+{
+    device->stats.calls[NULL_CALL_OM_SET_DEPTH_STENCIL_STATE]++;
+    device->stats.state_changes++;
+    device->depth_stencil_state = state;
+    device->pipeline_dirty = true;
+}
+
+inline void
+null_clear_render_target_view(null_device *device, null_handle view, const float color[4])
+{
+    device->stats.calls[NULL_CALL_CLEAR_RENDER_TARGET_VIEW]++;
+    if (null_lookup(device, view, NULL_OBJECT_RENDER_TARGET_VIEW) == nullptr)
+        null_error(device, "ClearRenderTargetView: invalid view 0x%08x", view);
+}
+
+inline void
+null_clear_depth_stencil_view(null_device *device, null_handle view, float depth)
+{
+    device->stats.calls[NULL_CALL_CLEAR_DEPTH_STENCIL_VIEW]++;
+    if (null_lookup(device, view, NULL_OBJECT_DEPTH_STENCIL_VIEW) == nullptr)
+        null_error(device, "ClearDepthStencilView: invalid view 0x%08x", view);
+    if (depth < 0.0f || depth > 1.0f)
+        null_error(device, "ClearDepthStencilView: depth %g outside 0..1", depth);
+}
+
+// returns the buffer's memory, the caller writes what it would write to a real mapping
+inline void *
+null_map(null_device *device, null_handle handle, null_map_type map_type)
+{
+    device->stats.calls[NULL_CALL_MAP]++;
+    null_object *object = null_lookup(device, handle, NULL_OBJECT_BUFFER);
+    if (object == nullptr)
+    {
+        null_error(device, "Map: invalid buffer 0x%08x", handle);
+        return nullptr;
+    }
+
+    null_buffer *buffer = &object->buffer;
+    if (buffer->usage != NULL_USAGE_DYNAMIC)
+    {
+        null_error(device, "Map: buffer 0x%08x is not dynamic", handle);
+        return nullptr;
+    }
+    if (map_type != NULL_MAP_WRITE_DISCARD && map_type != NULL_MAP_WRITE_NO_OVERWRITE)
+    {
+        null_error(device, "Map: dynamic buffers take WRITE_DISCARD or WRITE_NO_OVERWRITE");
+        return nullptr;
+    }
+    if (buffer->mapped)
+    {
+        null_error(device, "Map: buffer 0x%08x is already mapped", handle);
+        return nullptr;
+    }
+
+    buffer->mapped = true;
+    device->mapped_count++;
+    return buffer->memory;
+}
+
+inline void
+null_unmap(null_device *device, null_handle handle)
+{
+    device->stats.calls[NULL_CALL_UNMAP]++;
+    null_object *object = null_lookup(device, handle, NULL_OBJECT_BUFFER);
+    if (object == nullptr || object->buffer.mapped == false)
+    {
+        null_error(device, "Unmap: buffer 0x%08x is not mapped", handle);
+        return;
+    }
+    object->buffer.mapped = false;
+    device->mapped_count--;
+}
+
+// checks that the bound state forms a pipeline that can draw
+inline bool
+null_validate_pipeline(null_device *device)
+{
+    device->stats.pipeline_validations++;
+    bool valid = true;
+
+    if (device->topology == NULL_TOPOLOGY_UNDEFINED)
+    {
+        null_error(device, "Draw: no primitive topology");
+        valid = false;
+    }
+
+    null_object *layout = null_lookup(device, device->input_layout, NULL_OBJECT_INPUT_LAYOUT);
+    if (layout == nullptr)
+    {
+        null_error(device, "Draw: no valid input layout bound");
+        valid = false;
+    }
+    else
+    {
+        for (uint32_t slot = 0; slot < NULL_VERTEX_BUFFER_SLOTS; ++slot)
+        {
+            if ((layout->input_layout.slot_mask & (1u << slot)) == 0)
+                continue;
+            null_object *buffer = null_lookup(device, device->vertex_buffers[slot], NULL_OBJECT_BUFFER);
+            if (buffer == nullptr || (buffer->buffer.bind_flags & NULL_BIND_VERTEX_BUFFER) == 0)
+            {
+                null_error(device, "Draw: input layout reads slot %u, no vertex buffer bound there", slot);
+                valid = false;
+            }
+            else if (device->vertex_strides[slot] < layout->input_layout.min_strides[slot] ||
+                device->vertex_offsets[slot] >= buffer->buffer.size)
+            {
+                null_error(device, "Draw: slot %u stride %u is below the layout's %u bytes or offset %u is past the buffer", slot,
+                    device->vertex_strides[slot], layout->input_layout.min_strides[slot], device->vertex_offsets[slot]);
+                valid = false;
+            }
+        }
+    }
+
+    struct stage
+    {
+        const char *name;
+        null_handle shader;
+        null_object_type type;
+        const null_constant_binding *constant_buffers;
+        bool required;
+    };
+    stage stages[2] = {
+        {"vertex", device->vertex_shader, NULL_OBJECT_VERTEX_SHADER, device->vs_constant_buffers, true},
+        {"pixel", device->pixel_shader, NULL_OBJECT_PIXEL_SHADER, device->ps_constant_buffers, false},
+    };
+    for (const stage &s : stages)
+    {
+        null_object *shader = null_lookup(device, s.shader, s.type);
+        if (shader == nullptr)
+        {
+            if (s.required || s.shader != 0)
+            {
+                null_error(device, "Draw: no valid %s shader bound", s.name);
+                valid = false;
+            }
+            continue;
+        }
+
+        for (uint32_t slot = 0; slot < NULL_CONSTANT_BUFFER_SLOTS; ++slot)
+        {
+            uint32_t needed = shader->shader.constant_buffer_sizes[slot];
+            if (needed == 0)
+                continue;
+
+            const null_constant_binding *binding = &s.constant_buffers[slot];
+            null_object *buffer = null_lookup(device, binding->buffer, NULL_OBJECT_BUFFER);
+            if (buffer == nullptr || (buffer->buffer.bind_flags & NULL_BIND_CONSTANT_BUFFER) == 0)
+            {
+                null_error(device, "Draw: %s shader reads constant buffer %u, none bound", s.name, slot);
+                valid = false;
+                continue;
+            }
+
+            // a range may run past the end of the buffer, the missing constants read as 0, but
+            // the shader must see all the constants it declares
+            uint32_t bound = buffer->buffer.size;
+            if (binding->constant_count)
+            {
+                uint32_t first = binding->first_constant * 16;
+                bound = first >= buffer->buffer.size ? 0 : buffer->buffer.size - first;
+                if (binding->constant_count * 16 < bound)
+                    bound = binding->constant_count * 16;
+            }
+            if (bound < needed)
+            {
+                null_error(device, "Draw: %s shader reads %u bytes of constant buffer %u, %u bound", s.name, needed, slot, bound);
+                valid = false;
+            }
+        }
+
+        if (s.type == NULL_OBJECT_PIXEL_SHADER)
+        {
+            for (uint32_t slot = 0; slot < 32; ++slot)
+            {
+                if ((shader->shader.resource_mask & (1u << slot)) &&
+                    null_lookup(device, device->ps_resources[slot], NULL_OBJECT_SHADER_RESOURCE_VIEW) == nullptr)
+                {
+                    null_error(device, "Draw: pixel shader reads resource %u, none bound", slot);
+                    valid = false;
+                }
+                if (slot < NULL_SAMPLER_SLOTS && (shader->shader.sampler_mask & (1u << slot)) &&
+                    null_lookup(device, device->ps_samplers[slot], NULL_OBJECT_SAMPLER_STATE) == nullptr)
+                {
+                    null_error(device, "Draw: pixel shader uses sampler %u, none bound", slot);
+                    valid = false;
+                }
+            }
+        }
+    }
+
+    if (device->viewport_count == 0)
+    {
+        null_error(device, "Draw: no viewport");
+        valid = false;
+    }
+
+    // every bound target has to exist and agree on its size
+    uint32_t width = 0, height = 0;
+    bool any_target = false;
+    for (uint32_t i = 0; i < device->render_target_count; ++i)
+    {
+        if (device->render_targets[i] == 0)
+            continue;
+        null_object *view = null_lookup(device, device->render_targets[i], NULL_OBJECT_RENDER_TARGET_VIEW);
+        if (view == nullptr)
+        {
+            null_error(device, "Draw: render target %u is not a valid view", i);
+            valid = false;
+            continue;
+        }
+        if (any_target && (view->view.width != width || view->view.height != height))
+        {
+            null_error(device, "Draw: render target %u is %ux%u, the others %ux%u", i, view->view.width, view->view.height, width, height);
+            valid = false;
+        }
+        width = view->view.width;
+        height = view->view.height;
+        any_target = true;
+    }
+    if (device->depth_stencil_view)
+    {
+        null_object *view = null_lookup(device, device->depth_stencil_view, NULL_OBJECT_DEPTH_STENCIL_VIEW);
+        if (view == nullptr)
+        {
+            null_error(device, "Draw: depth stencil view is not valid");
+            valid = false;
+        }
+        else if (any_target && (view->view.width < width || view->view.height < height))
+        {
+            null_error(device, "Draw: depth stencil view %ux%u is smaller than the render targets", view->view.width, view->view.height);
+            valid = false;
+        }
+        any_target = true;
+    }
+    if (any_target == false)
+    {
+        null_error(device, "Draw: nothing bound to the output merger");
+        valid = false;
+    }
+    if (device->depth_stencil_state && null_lookup(device, device->depth_stencil_state, NULL_OBJECT_DEPTH_STENCIL_STATE) == nullptr)
+    {
+        null_error(device, "Draw: depth stencil state is not valid");
+        valid = false;
+    }
+
+    device->pipeline_dirty = false;
+    device->pipeline_valid = valid;
+    return valid;
+}
+
+// buffers bound for this draw can't be mapped
+inline bool
+null_check_mapped(null_device *device)
+{
+    for (uint32_t slot = 0; slot < NULL_VERTEX_BUFFER_SLOTS; ++slot)
+    {
+        null_object *buffer = null_lookup(device, device->vertex_buffers[slot], NULL_OBJECT_BUFFER);
+        if (buffer && buffer->buffer.mapped)
+            return false;
+    }
+    null_object *index_buffer = null_lookup(device, device->index_buffer, NULL_OBJECT_BUFFER);
+    if (index_buffer && index_buffer->buffer.mapped)
+        return false;
+    for (uint32_t slot = 0; slot < NULL_CONSTANT_BUFFER_SLOTS; ++slot)
+    {
+        null_object *vs_buffer = null_lookup(device, device->vs_constant_buffers[slot].buffer, NULL_OBJECT_BUFFER);
+        null_object *ps_buffer = null_lookup(device, device->ps_constant_buffers[slot].buffer, NULL_OBJECT_BUFFER);
+        if ((vs_buffer && vs_buffer->buffer.mapped) || (ps_buffer && ps_buffer->buffer.mapped))
+            return false;
+    }
+    return true;
+}
+
+// index_count and base_vertex are the vertex count and start vertex of non indexed draws
+inline bool
+null_check_draw(null_device *device, const char *name, bool indexed, uint32_t index_count, uint32_t start_index, int32_t base_vertex,
+    uint32_t instance_count, uint32_t start_instance)
+{
+    if (device->pipeline_dirty)
+        null_validate_pipeline(device);
+    if (device->pipeline_valid == false)
+    {
+        null_error(device, "%s: skipped, the pipeline is not valid", name);
+        return false;
+    }
+    if (device->mapped_count && null_check_mapped(device) == false)
+    {
+        null_error(device, "%s: a bound buffer is still mapped", name);
+        return false;
+    }
+
+    // the index range has to be inside the index buffer
+    null_buffer *index_buffer = nullptr;
+    if (indexed)
+    {
+        null_object *object = null_lookup(device, device->index_buffer, NULL_OBJECT_BUFFER);
+        if (object == nullptr || (object->buffer.bind_flags & NULL_BIND_INDEX_BUFFER) == 0)
+        {
+            null_error(device, "%s: no index buffer bound", name);
+            return false;
+        }
+        index_buffer = &object->buffer;
+        uint64_t index_size = device->index_format == NULL_INDEX_FORMAT_R16_UINT ? 2 : 4;
+        if (device->index_offset + ((uint64_t)start_index + index_count) * index_size > index_buffer->size)
+        {
+            null_error(device, "%s: indices %u..%u run past the index buffer", name, start_index, start_index + index_count);
+            return false;
+        }
+    }
+
+    // and when the largest index is known, the vertices it reaches inside every vertex stream
+    null_input_layout *layout = &null_lookup(device, device->input_layout, NULL_OBJECT_INPUT_LAYOUT)->input_layout;
+    for (uint32_t slot = 0; slot < NULL_VERTEX_BUFFER_SLOTS; ++slot)
+    {
+        uint32_t bit = 1u << slot;
+        if ((layout->slot_mask & bit) == 0)
+            continue;
+
+        int64_t last;
+        if (layout->instance_slot_mask & bit)
+            last = (int64_t)start_instance + instance_count - 1;
+        else if (indexed == false)
+            last = (int64_t)base_vertex + index_count - 1;
+        else if (index_buffer->has_max_index)
+            last = (int64_t)index_buffer->max_index + base_vertex;
+        else
+            continue;
+
+        null_buffer *buffer = &null_lookup(device, device->vertex_buffers[slot], NULL_OBJECT_BUFFER)->buffer;
+        if (last < 0 || device->vertex_offsets[slot] + (uint64_t)last * device->vertex_strides[slot] + layout->min_strides[slot] > buffer->size)
+        {
+            null_error(device, "%s: element %lld of slot %u is outside its vertex buffer", name, (long long)last, slot);
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void
+null_draw(null_device *device, uint32_t vertex_count, uint32_t start_vertex)
+{
+    device->stats.calls[NULL_CALL_DRAW]++;
+    if (vertex_count == 0)
+        return;
+    if (null_check_draw(device, "Draw", false, vertex_count, 0, (int32_t)start_vertex, 1, 0) == false)
+        return;
+    device->stats.draws++;
+    device->stats.instances++;
+    device->stats.indices += vertex_count;
+}
+
+inline void
+null_draw_indexed(null_device *device, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    device->stats.calls[NULL_CALL_DRAW_INDEXED]++;
+    if (null_check_draw(device, "DrawIndexed", true, index_count, start_index, base_vertex, 1, 0) == false)
+        return;
+    device->stats.draws++;
+    device->stats.instances++;
+    device->stats.indices += index_count;
+}
+
+inline void
+null_draw_indexed_instanced(null_device *device, uint32_t index_count, uint32_t instance_count, uint32_t start_index,
+    int32_t base_vertex, uint32_t start_instance)
+{
+    device->stats.calls[NULL_CALL_DRAW_INDEXED_INSTANCED]++;
+    if (instance_count == 0)
+        return;
+    if (null_check_draw(device, "DrawIndexedInstanced", true, index_count, start_index, base_vertex, instance_count, start_instance) == false)
+        return;
+    device->stats.draws++;
+    device->stats.instances += instance_count;
+    device->stats.indices += (uint64_t)index_count * instance_count;
+}
+
+// fences
+
+inline uint64_t
+null_signal_fence(null_device *device)
+{
+    return ++device->fence;
+}
+
+inline uint64_t
+null_completed_fence(null_device *device)
+{
+    uint64_t completed = 0;
+    if (device->stats.presents >= device->gpu_latency)
+        completed = device->present_fences[(device->stats.presents - device->gpu_latency) % NULL_MAX_LATENCY];
+    return completed > device->waited_fence ? completed : device->waited_fence;
+}
+
+// the null gpu finishes whatever it is waited on immediately
+inline void
+null_wait_fence(null_device *device, uint64_t fence)
+{
+    if (fence > device->waited_fence)
+        device->waited_fence = fence;
+}
+
+inline void
+null_present(null_device *device)
+{
+    device->stats.calls[NULL_CALL_PRESENT]++;
+    if (device->mapped_count)
+        null_error(device, "Present: %u buffers still mapped", device->mapped_count);
+    device->stats.presents++;
+    device->present_fences[device->stats.presents % NULL_MAX_LATENCY] = device->fence;
+}
@@ -0,0 +1,437 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "frustum_cull.h"
+#include "profile.h"
+#include "simd_math.h"
+#include "thread_pool.h"
+
+// software occlusion culling on the cpu. a few large occluders are rasterized into a small
+// depth buffer, then object boxes are tested against it before their draws are issued, a box
+// whose nearest point is behind the occluders on every pixel it covers can't show up.
+//
+//     occlusion_begin(&occlusion);
+//     occlusion_add_occluder(&occlusion, wall_positions, 3 * sizeof(float), wall_indices, 36, wall_world * view_proj);
+//     occlusion_rasterize(&occlusion);
+//     uint32_t visible_count = occlusion_cull_aabbs(&occlusion, view_proj, &boxes, candidates, candidate_count, visible);
+//
+// the buffer is split into OCCLUSION_TILE_WIDTH x OCCLUSION_TILE_HEIGHT tiles, every tile's
+// depths are contiguous and the tiles rasterize their binned occluders in parallel on the pool,
+// SIMD_MATH_WIDTH pixels at a time. each tile also keeps the farthest depth in it, a box that
+// is behind that is occluded on the whole tile without looking at its pixels.
+//
+// depth is d3d z/w in [0, 1] with less passing, like the examples. occluders only count on
+// pixels they cover entirely and with the farthest depth they have across the pixel, so the
+// buffer stays conservative at any resolution and is usually a fraction of the screen's.
+
+#define OCCLUSION_TILE_WIDTH 32
+#define OCCLUSION_TILE_HEIGHT 8
+#define OCCLUSION_TILE_PIXELS (OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT)
+// occluder edges move in by half a pixel diagonal, a pixel center that is still inside means
+// the whole pixel is
+#define OCCLUSION_EDGE_INSET 0.7072f
+// boxes tested by one task
+#define OCCLUSION_TEST_CHUNK 256
+
+// edge functions are a * x + b * y + c >= 0 inside, evaluated at pixel centers. depth is the
+// plane z = z[0] + z[1] * x + z[2] * y
+struct occlusion_triangle
+{
+    float edge_a[3];
+    float edge_b[3];
+    float edge_c[3];
+    float z[3];
+    int32_t min_x, min_y, max_x, max_y;
+};
+
+struct occlusion_stats
+{
+    uint64_t occluder_triangles; // rasterized, after clipping and back face culling
+    uint64_t tested;
+    uint64_t occluded;
+};
+
+struct occlusion_buffer
+{
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+    float *depth;    // OCCLUSION_TILE_PIXELS per tile, rows of OCCLUSION_TILE_WIDTH
+    float *tile_max; // farthest depth in each tile
+    thread_pool *pool;
+
+    std::vector<occlusion_triangle> triangles;
+    std::vector<std::vector<uint32_t>> bins; // triangles overlapping each tile
+    std::vector<uint8_t> results;            // per tested box, 1 visible
+
+    // since occlusion_begin
+    occlusion_stats stats;
+};
+
+inline bool
+occlusion_buffer_init(occlusion_buffer *buffer, int width, int height, thread_pool *pool)
+{
+    buffer->width = width;
+    buffer->height = height;
+    buffer->tiles_x = (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+    buffer->tiles_y = (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+    buffer->pool = pool;
+
+    size_t tile_count = (size_t)buffer->tiles_x * buffer->tiles_y;
+    buffer->depth = (float *)simd_aligned_alloc(tile_count * OCCLUSION_TILE_PIXELS * sizeof(float));
+    buffer->tile_max = (float *)malloc(tile_count * sizeof(float));
+    if (buffer->depth == nullptr || buffer->tile_max == nullptr)
+        return false;
+    for (size_t i = 0; i < tile_count * OCCLUSION_TILE_PIXELS; ++i)
+        buffer->depth[i] = 1.0f;
+    for (size_t i = 0; i < tile_count; ++i)
+        buffer->tile_max[i] = 1.0f;
+
+    buffer->bins.resize(tile_count);
+    buffer->stats = {};
+    return true;
+}
+
+inline void
+occlusion_buffer_free(occlusion_buffer *buffer)
+{
+    simd_aligned_free(buffer->depth);
+    free(buffer->tile_max);
+    buffer->depth = nullptr;
+    buffer->tile_max = nullptr;
+    buffer->triangles.clear();
+    buffer->bins.clear();
+}
+
+// starts a new frame, drops the occluders of the last one
+inline void
+occlusion_begin(occlusion_buffer *buffer)
+{
+    buffer->triangles.clear();
+    buffer->stats = {};
+}
+
+// sets up one screen space triangle, clockwise is front facing like sw_raster.h and back faces
+// are dropped, they are always behind the front faces of a closed occluder
+inline void
+occlusion_setup_triangle(occlusion_buffer *buffer, const float *v0, const float *v1, const float *v2)
+{
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+    if ((area > 0.0f) == false)
+        return;
+
+    float min_x = fminf(v0[0], fminf(v1[0], v2[0]));
+    float min_y = fminf(v0[1], fminf(v1[1], v2[1]));
+    float max_x = fmaxf(v0[0], fmaxf(v1[0], v2[0]));
+    float max_y = fmaxf(v0[1], fmaxf(v1[1], v2[1]));
+    if (max_x < 0.0f || max_y < 0.0f || min_x > (float)buffer->width || min_y > (float)buffer->height)
+        return;
+
+    occlusion_triangle tri;
+    tri.min_x = (int32_t)fmaxf(floorf(min_x), 0.0f);
+    tri.min_y = (int32_t)fmaxf(floorf(min_y), 0.0f);
+    tri.max_x = (int32_t)fminf(ceilf(max_x), (float)(buffer->width - 1));
+    tri.max_y = (int32_t)fminf(ceilf(max_y), (float)(buffer->height - 1));
+
+    const float *v[3] = {v0, v1, v2};
+    for (int i = 0; i < 3; ++i)
+    {
+        // a clockwise triangle has its inside to the right of a -> b with y down
+        const float *a = v[i];
+        const float *b = v[(i + 1) % 3];
+        float edge_a = a[1] - b[1];
+        float edge_b = b[0] - a[0];
+        tri.edge_a[i] = edge_a;
+        tri.edge_b[i] = edge_b;
+        tri.edge_c[i] = -(edge_a * a[0] + edge_b * a[1]) - OCCLUSION_EDGE_INSET * sqrtf(edge_a * edge_a + edge_b * edge_b);
+    }
+
+    float inv_area = 1.0f / area;
+    float ex1 = v1[0] - v0[0];
+    float ey1 = v1[1] - v0[1];
+    float ex2 = v2[0] - v0[0];
+    float ey2 = v2[1] - v0[1];
+    float dzdx = ((v1[2] - v0[2]) * ey2 - (v2[2] - v0[2]) * ey1) * inv_area;
+    float dzdy = ((v2[2] - v0[2]) * ex1 - (v1[2] - v0[2]) * ex2) * inv_area;
+    // the plane at the center plus its slope to the pixel's farthest corner
+    tri.z[0] = v0[2] - dzdx * v0[0] - dzdy * v0[1] + 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+    tri.z[1] = dzdx;
+    tri.z[2] = dzdy;
+
+    buffer->triangles.push_back(tri);
+    buffer->stats.occluder_triangles++;
+}
+
+// adds an indexed triangle list with float3 positions at offset 0 of every vertex, mvp is the
+// row vector object to clip matrix. triangles are clipped against the near plane only, the
+// far plane and the screen edges don't matter to a depth that is only ever lowered
+inline void
+occlusion_add_occluder(occlusion_buffer *buffer, const float *positions, uint32_t stride, const uint32_t *indices,
+    uint32_t index_count, const mat4 &mvp)
+{
+    float m[16];
+    mat4_store(m, mvp);
+    for (uint32_t i = 0; i + 2 < index_count; i += 3)
+    {
+        // clip space x, y, z, w of the three corners
+        float clip[3][4];
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const float *p = (const float *)((const uint8_t *)positions + (size_t)indices[i + corner] * stride);
+            for (int c = 0; c < 4; ++c)
+                clip[corner][c] = p[0] * m[c] + p[1] * m[4 + c] + p[2] * m[8 + c] + m[12 + c];
+        }
+
+        // near plane z >= 0, the clipped polygon has at most 4 corners
+        float polygon[4][4];
+        int count = 0;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const float *a = clip[corner];
+            const float *b = clip[(corner + 1) % 3];
+            if (a[2] >= 0.0f)
+                memcpy(polygon[count++], a, sizeof(polygon[0]));
+            if ((a[2] >= 0.0f) != (b[2] >= 0.0f))
+            {
+                float t = a[2] / (a[2] - b[2]);
+                for (int c = 0; c < 4; ++c)
+                    polygon[count][c] = a[c] + (b[c] - a[c]) * t;
+                count++;
+            }
+        }
+        if (count < 3)
+            continue;
+
+        float screen[4][3];
+        for (int corner = 0; corner < count; ++corner)
+        {
+            float inv_w = 1.0f / polygon[corner][3];
+            screen[corner][0] = (polygon[corner][0] * inv_w + 1.0f) * 0.5f * (float)buffer->width;
+            screen[corner][1] = (1.0f - polygon[corner][1] * inv_w) * 0.5f * (float)buffer->height;
+            screen[corner][2] = polygon[corner][2] * inv_w;
+        }
+        for (int corner = 1; corner + 1 < count; ++corner)
+            occlusion_setup_triangle(buffer, screen[0], screen[corner], screen[corner + 1]);
+    }
+}
+
+// x + 0.5 for every lane
+inline vf
+occlusion_lane_centers()
+{
+    alignas(SIMD_MATH_ALIGN) static const float centers[8] = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+    return vf_load(centers);
+}
+
+inline void
+occlusion_rasterize_tile(occlusion_buffer *buffer, int tile)
+{
+    PROFILE_ZONE("occlusion tile");
+    int tile_x = (tile % buffer->tiles_x) * OCCLUSION_TILE_WIDTH;
+    int tile_y = (tile / buffer->tiles_x) * OCCLUSION_TILE_HEIGHT;
+    float *depth = buffer->depth + (size_t)tile * OCCLUSION_TILE_PIXELS;
+
+    vf far_depth = vf_splat(1.0f);
+    for (int i = 0; i < OCCLUSION_TILE_PIXELS; i += SIMD_MATH_WIDTH)
+        vf_store(depth + i, far_depth);
+
+    vf lane_centers = occlusion_lane_centers();
+    vf zero = vf_splat(0.0f);
+    for (uint32_t index : buffer->bins[tile])
+    {
+        const occlusion_triangle *tri = &buffer->triangles[index];
+        int min_y = tri->min_y > tile_y ? tri->min_y : tile_y;
+        int max_y = tri->max_y < tile_y + OCCLUSION_TILE_HEIGHT - 1 ? tri->max_y : tile_y + OCCLUSION_TILE_HEIGHT - 1;
+        // whole SIMD blocks covering the triangle's columns in this tile
+        int min_x = (tri->min_x > tile_x ? tri->min_x : tile_x) - tile_x;
+        int max_x = (tri->max_x < tile_x + OCCLUSION_TILE_WIDTH - 1 ? tri->max_x : tile_x + OCCLUSION_TILE_WIDTH - 1) - tile_x;
+        min_x -= min_x % SIMD_MATH_WIDTH;
+
+        vf a0 = vf_splat(tri->edge_a[0]), a1 = vf_splat(tri->edge_a[1]), a2 = vf_splat(tri->edge_a[2]);
+        vf dzdx = vf_splat(tri->z[1]);
+        for (int y = min_y; y <= max_y; ++y)
+        {
+            float py = (float)y + 0.5f;
+            float *row = depth + (y - tile_y) * OCCLUSION_TILE_WIDTH;
+            vf row0 = vf_splat(tri->edge_b[0] * py + tri->edge_c[0]);
+            vf row1 = vf_splat(tri->edge_b[1] * py + tri->edge_c[1]);
+            vf row2 = vf_splat(tri->edge_b[2] * py + tri->edge_c[2]);
+            vf row_z = vf_splat(tri->z[0] + tri->z[2] * py);
+            for (int x = min_x; x <= max_x; x += SIMD_MATH_WIDTH)
+            {
+                vf px = vf_add(vf_splat((float)(tile_x + x)), lane_centers);
+                vf inside = vf_and(vf_cmp_ge(vf_madd(px, a0, row0), zero),
+                    vf_and(vf_cmp_ge(vf_madd(px, a1, row1), zero), vf_cmp_ge(vf_madd(px, a2, row2), zero)));
+                if (vf_mask_bits(inside) == 0)
+                    continue;
+                vf z = vf_madd(px, dzdx, row_z);
+                vf d = vf_load(row + x);
+                vf_store(row + x, vf_select(inside, vf_min(d, z), d));
+            }
+        }
+    }
+
+    vf farthest = vf_load(depth);
+    for (int i = SIMD_MATH_WIDTH; i < OCCLUSION_TILE_PIXELS; i += SIMD_MATH_WIDTH)
+        farthest = vf_max(farthest, vf_load(depth + i));
+    alignas(SIMD_MATH_ALIGN) float lanes[SIMD_MATH_WIDTH];
+    vf_store(lanes, farthest);
+    float tile_max = lanes[0];
+    for (int i = 1; i < SIMD_MATH_WIDTH; ++i)
+        tile_max = lanes[i] > tile_max ? lanes[i] : tile_max;
+    buffer->tile_max[tile] = tile_max;
+}
+
+// bins the occluders added since occlusion_begin and rasterizes every tile on the pool
+inline void
+occlusion_rasterize(occlusion_buffer *buffer)
+{
+    PROFILE_ZONE("occlusion_rasterize");
+    for (std::vector<uint32_t> &bin : buffer->bins)
+        bin.clear();
+    for (uint32_t i = 0; i < (uint32_t)buffer->triangles.size(); ++i)
+    {
+        const occlusion_triangle *tri = &buffer->triangles[i];
+        for (int ty = tri->min_y / OCCLUSION_TILE_HEIGHT; ty <= tri->max_y / OCCLUSION_TILE_HEIGHT; ++ty)
+            for (int tx = tri->min_x / OCCLUSION_TILE_WIDTH; tx <= tri->max_x / OCCLUSION_TILE_WIDTH; ++tx)
+                buffer->bins[(size_t)ty * buffer->tiles_x + tx].push_back(i);
+    }
+
+    int tile_count = buffer->tiles_x * buffer->tiles_y;
+    thread_pool_parallel_for(buffer->pool, tile_count, [buffer](int tile) { occlusion_rasterize_tile(buffer, tile); });
+}
+
+// false when the box with this center and half extent is behind the occluders everywhere it
+// covers. boxes crossing the near plane are always visible, boxes entirely off screen never
+inline bool
+occlusion_test_aabb(const occlusion_buffer *buffer, const float view_proj[16], const float center[3], const float extent[3])
+{
+    // the 8 corners to clip space, SIMD_MATH_WIDTH of them at a time
+    alignas(SIMD_MATH_ALIGN) float corner_x[8], corner_y[8], corner_z[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        corner_x[i] = center[0] + (i & 1 ? extent[0] : -extent[0]);
+        corner_y[i] = center[1] + (i & 2 ? extent[1] : -extent[1]);
+        corner_z[i] = center[2] + (i & 4 ? extent[2] : -extent[2]);
+    }
+    alignas(SIMD_MATH_ALIGN) float clip[4][8];
+    for (int i = 0; i < 8; i += SIMD_MATH_WIDTH)
+    {
+        vf x = vf_load(corner_x + i), y = vf_load(corner_y + i), z = vf_load(corner_z + i);
+        for (int c = 0; c < 4; ++c)
+        {
+            vf r = vf_madd(x, vf_splat(view_proj[c]), vf_madd(y, vf_splat(view_proj[4 + c]),
+                vf_madd(z, vf_splat(view_proj[8 + c]), vf_splat(view_proj[12 + c]))));
+            vf_store(clip[c] + i, r);
+        }
+    }
+
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX, min_z = FLT_MAX;
+    for (int i = 0; i < 8; ++i)
+    {
+        if (clip[2][i] < 0.0f)
+            return true;
+        float inv_w = 1.0f / clip[3][i];
+        float x = (clip[0][i] * inv_w + 1.0f) * 0.5f * (float)buffer->width;
+        float y = (1.0f - clip[1][i] * inv_w) * 0.5f * (float)buffer->height;
+        float z = clip[2][i] * inv_w;
+        min_x = x < min_x ? x : min_x;
+        max_x = x > max_x ? x : max_x;
+        min_y = y < min_y ? y : min_y;
+        max_y = y > max_y ? y : max_y;
+        min_z = z < min_z ? z : min_z;
+    }
+    if (max_x < 0.0f || max_y < 0.0f || min_x > (float)buffer->width || min_y > (float)buffer->height)
+        return false;
+
+    // every pixel the box overlaps
+    int x0 = (int)fmaxf(floorf(min_x), 0.0f);
+    int y0 = (int)fmaxf(floorf(min_y), 0.0f);
+    int x1 = (int)fminf(floorf(max_x), (float)(buffer->width - 1));
+    int y1 = (int)fminf(floorf(max_y), (float)(buffer->height - 1));
+
+    vf box_z = vf_splat(min_z);
+    vf lane_centers = occlusion_lane_centers();
+    vf left = vf_splat((float)x0), right = vf_splat((float)x1 + 1.0f);
+    for (int ty = y0 / OCCLUSION_TILE_HEIGHT; ty <= y1 / OCCLUSION_TILE_HEIGHT; ++ty)
+    {
+        for (int tx = x0 / OCCLUSION_TILE_WIDTH; tx <= x1 / OCCLUSION_TILE_WIDTH; ++tx)
+        {
+            int tile = ty * buffer->tiles_x + tx;
+            if (min_z > buffer->tile_max[tile])
+                continue;
+
+            int tile_x = tx * OCCLUSION_TILE_WIDTH;
+            int tile_y = ty * OCCLUSION_TILE_HEIGHT;
+            int row_begin = (y0 > tile_y ? y0 : tile_y) - tile_y;
+            int row_end = (y1 < tile_y + OCCLUSION_TILE_HEIGHT - 1 ? y1 : tile_y + OCCLUSION_TILE_HEIGHT - 1) - tile_y;
+            int column_begin = (x0 > tile_x ? x0 : tile_x) - tile_x;
+            int column_end = (x1 < tile_x + OCCLUSION_TILE_WIDTH - 1 ? x1 : tile_x + OCCLUSION_TILE_WIDTH - 1) - tile_x;
+            column_begin -= column_begin % SIMD_MATH_WIDTH;
+
+            const float *depth = buffer->depth + (size_t)tile * OCCLUSION_TILE_PIXELS;
+            for (int x = column_begin; x <= column_end; x += SIMD_MATH_WIDTH)
+            {
+                // lanes within [x0, x1]
+                vf px = vf_add(vf_splat((float)(tile_x + x)), lane_centers);
+                vf in_box = vf_and(vf_cmp_ge(px, left), vf_cmp_ge(right, px));
+                for (int row = row_begin; row <= row_end; ++row)
+                {
+                    vf d = vf_load(depth + row * OCCLUSION_TILE_WIDTH + x);
+                    if (vf_mask_bits(vf_and(in_box, vf_cmp_ge(d, box_z))))
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// tests the boxes candidates[0, count) of a FRUSTUM_AABB_STREAMS frustum_bounds, usually the
+// list frustum_cull_aabbs wrote, and copies the visible ones to visible in the same order.
+// the boxes are tested on the pool in chunks, returns the number written
+inline uint32_t
+occlusion_cull_aabbs(occlusion_buffer *buffer, const mat4 &view_proj, const frustum_bounds *boxes, const uint32_t *candidates,
+    uint32_t count, uint32_t *visible)
+{
+    PROFILE_ZONE("occlusion_cull_aabbs");
+    float m[16];
+    mat4_store(m, view_proj);
+
+    buffer->results.resize(count);
+    uint8_t *results = buffer->results.data();
+    int chunk_count = (int)((count + OCCLUSION_TEST_CHUNK - 1) / OCCLUSION_TEST_CHUNK);
+    thread_pool_parallel_for(buffer->pool, chunk_count, [&](int chunk) {
+        uint32_t begin = (uint32_t)chunk * OCCLUSION_TEST_CHUNK;
+        uint32_t end = begin + OCCLUSION_TEST_CHUNK < count ? begin + OCCLUSION_TEST_CHUNK : count;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            uint32_t box = candidates[i];
+            float center[3], extent[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                center[axis] = frustum_bounds_stream(boxes, axis)[box];
+                extent[axis] = frustum_bounds_stream(boxes, axis + 3)[box];
+            }
+            results[i] = occlusion_test_aabb(buffer, m, center, extent) ? 1 : 0;
+        }
+    });
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        visible[n] = candidates[i];
+        n += results[i];
+    }
+    buffer->stats.tested += count;
+    buffer->stats.occluded += count - n;
+    return n;
+}
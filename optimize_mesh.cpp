@@ -0,0 +1,222 @@
+// runs mesh_optimize.h over every .obj in a directory: reorders triangles for the post transform
+// cache, then vertices for fetch, and prints acmr, atvr and overfetch before and after. with
+// -o the optimized meshes are written there as .obj, vertices and faces in their new order.
+// meshes are read with mesh_import_obj, so normals are dropped and every distinct position/uv
+// pair becomes one 20 byte vertex.
+// usage: optimize_mesh directory [-o output directory] [-a tipsify|forsyth] [-c cache size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "mesh_import.h"
+#include "mesh_optimize.h"
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <direct.h>
+#else
+    #include <dirent.h>
+    #include <sys/stat.h>
+#endif
+
+struct obj_vertex
+{
+    float position[3];
+    float uv[2];
+};
+
+struct obj_mesh
+{
+    std::vector<obj_vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+static double
+now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void
+list_meshes(const char *dir, std::vector<std::string> *names)
+{
+#if defined(_WIN32)
+    std::string pattern = std::string(dir) + "\\*.obj";
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA(pattern.c_str(), &find_data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            names->push_back(find_data.cFileName);
+    } while (FindNextFileA(find, &find_data));
+    FindClose(find);
+#else
+    DIR *directory = opendir(dir);
+    if (directory == nullptr)
+        return;
+    while (dirent *entry = readdir(directory))
+    {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (entry->d_name[0] != '.' && dot && strcmp(dot, ".obj") == 0)
+            names->push_back(entry->d_name);
+    }
+    closedir(directory);
+#endif
+    std::sort(names->begin(), names->end());
+}
+
+// interleaves the streams mesh_import_obj returns, missing uvs are 0
+static void
+build_vertices(const mesh_data *data, obj_mesh *mesh)
+{
+    size_t vertex_count = data->positions.size() / 3;
+    mesh->vertices.resize(vertex_count);
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        obj_vertex *vertex = &mesh->vertices[i];
+        memcpy(vertex->position, &data->positions[i * 3], sizeof(vertex->position));
+        if (data->uvs.empty())
+            vertex->uv[0] = vertex->uv[1] = 0.0f;
+        else
+            memcpy(vertex->uv, &data->uvs[i * 2], sizeof(vertex->uv));
+    }
+    mesh->indices = data->indices;
+}
+
+static bool
+write_obj(const char *path, const obj_mesh *mesh)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    // back to right handed, counter clockwise and uv (0, 0) at the bottom
+    for (const obj_vertex &v : mesh->vertices)
+        fprintf(file, "v %g %g %g\n", v.position[0], v.position[1], -v.position[2]);
+    for (const obj_vertex &v : mesh->vertices)
+        fprintf(file, "vt %g %g\n", v.uv[0], 1.0f - v.uv[1]);
+    for (size_t i = 0; i + 2 < mesh->indices.size(); i += 3)
+    {
+        uint32_t a = mesh->indices[i] + 1, b = mesh->indices[i + 1] + 1, c = mesh->indices[i + 2] + 1;
+        fprintf(file, "f %u/%u %u/%u %u/%u\n", a, a, c, c, b, b);
+    }
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: optimize_mesh directory [-o output directory] [-a tipsify|forsyth] [-c cache size]\n");
+        return 1;
+    }
+
+    const char *input_dir = argv[1];
+    const char *output_dir = nullptr;
+    bool forsyth = false;
+    uint32_t cache_size = MESH_CACHE_SIZE;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-o") == 0)
+            output_dir = argv[i + 1];
+        else if (strcmp(argv[i], "-a") == 0)
+            forsyth = strcmp(argv[i + 1], "forsyth") == 0;
+        else if (strcmp(argv[i], "-c") == 0)
+            cache_size = (uint32_t)atoi(argv[i + 1]);
+    }
+
+    std::vector<std::string> names;
+    list_meshes(input_dir, &names);
+    if (names.empty())
+    {
+        fprintf(stderr, "No .obj files in %s\n", input_dir);
+        return 1;
+    }
+    if (output_dir)
+    {
+#if defined(_WIN32)
+        _mkdir(output_dir);
+#else
+        mkdir(output_dir, 0755);
+#endif
+    }
+
+    printf("%s, fifo cache %u, %d byte vertices\n", forsyth ? "forsyth" : "tipsify", cache_size, (int)sizeof(obj_vertex));
+    printf("%-24s %9s %9s %13s %13s %13s %9s\n", "mesh", "tris", "verts", "acmr", "atvr", "overfetch", "ms");
+
+    thread_pool pool;
+    thread_pool_init(&pool);
+
+    int failed = 0;
+    mesh_analysis total_before = {}, total_after = {};
+    for (const std::string &name : names)
+    {
+        std::string path = std::string(input_dir) + "/" + name;
+        mesh_data data;
+        if (mesh_import_obj(path.c_str(), &data, &pool) == false)
+        {
+            fprintf(stderr, "Failed to load %s\n", path.c_str());
+            failed++;
+            continue;
+        }
+        obj_mesh mesh;
+        build_vertices(&data, &mesh);
+
+        size_t index_count = mesh.indices.size();
+        mesh_analysis before = mesh_analyze(mesh.indices.data(), index_count, mesh.vertices.size(), sizeof(obj_vertex), cache_size);
+
+        double start = now_seconds();
+        if (forsyth)
+            mesh_optimize_vertex_cache_forsyth(mesh.indices.data(), mesh.indices.data(), index_count, mesh.vertices.size());
+        else
+            mesh_optimize_vertex_cache(mesh.indices.data(), mesh.indices.data(), index_count, mesh.vertices.size(), cache_size);
+        size_t vertex_count = mesh_optimize_vertex_fetch(mesh.vertices.data(), mesh.indices.data(), index_count,
+            mesh.vertices.data(), mesh.vertices.size(), sizeof(obj_vertex));
+        mesh.vertices.resize(vertex_count);
+        double ms = (now_seconds() - start) * 1000.0;
+
+        mesh_analysis after = mesh_analyze(mesh.indices.data(), index_count, mesh.vertices.size(), sizeof(obj_vertex), cache_size);
+        printf("%-24s %9u %9u %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %9.2f\n", name.c_str(), before.triangles, before.unique_vertices,
+            before.acmr, after.acmr, before.atvr, after.atvr, before.overfetch, after.overfetch, ms);
+
+        total_before.triangles += before.triangles;
+        total_before.unique_vertices += before.unique_vertices;
+        total_before.transformed += before.transformed;
+        total_before.fetched_bytes += before.fetched_bytes;
+        total_after.transformed += after.transformed;
+        total_after.fetched_bytes += after.fetched_bytes;
+
+        if (output_dir)
+        {
+            std::string out_path = std::string(output_dir) + "/" + name;
+            if (write_obj(out_path.c_str(), &mesh) == false)
+            {
+                fprintf(stderr, "Failed to write %s\n", out_path.c_str());
+                failed++;
+            }
+        }
+    }
+
+    if (total_before.triangles)
+    {
+        double vertex_bytes = (double)total_before.unique_vertices * sizeof(obj_vertex);
+        printf("%-24s %9u %9u %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f\n", "total", total_before.triangles, total_before.unique_vertices,
+            (double)total_before.transformed / total_before.triangles, (double)total_after.transformed / total_before.triangles,
+            (double)total_before.transformed / total_before.unique_vertices, (double)total_after.transformed / total_before.unique_vertices,
+            total_before.fetched_bytes / vertex_bytes, total_after.fetched_bytes / vertex_bytes);
+    }
+    thread_pool_shutdown(&pool);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+
+// scoped zone profiler. PROFILE_ZONE("name") times the rest of the enclosing scope and
+// appends one event to a buffer owned by the calling thread, so recording never takes a
+// lock or shares a cache line with another thread. profile_write_chrome_trace merges the
+// buffers of every thread into chrome trace_event json (chrome://tracing, ui.perfetto.dev).
+//
+// the zones only exist when PROFILE_ENABLED is defined (build.sh -p), otherwise the macros
+// expand to nothing and the functions below are never referenced. names must be string
+// literals or otherwise outlive the trace.
+//
+// timestamps are rdtsc on x86, the virtual counter on arm64 and the steady clock elsewhere,
+// converted to microseconds against the steady clock when the trace is written.
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+// events each thread can hold, further zones on a full thread are counted and dropped
+#if !defined(PROFILE_EVENTS_PER_THREAD)
+    #define PROFILE_EVENTS_PER_THREAD (1 << 16)
+#endif
+#define PROFILE_THREAD_NAME_SIZE 32
+
+#if defined(PROFILE_ENABLED)
+    #define PROFILE_CONCAT_(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+    #define PROFILE_ZONE(name) profile_zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+    #define PROFILE_THREAD_NAME(name) profile_set_thread_name(name)
+    #define PROFILE_WRITE_TRACE(path) profile_write_chrome_trace(path)
+#else
+    #define PROFILE_ZONE(name) ((void)0)
+    #define PROFILE_THREAD_NAME(name) ((void)0)
+    #define PROFILE_WRITE_TRACE(path) ((void)0)
+#endif
+
+struct profile_event
+{
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// written only by its thread, the writer reads up to count. buffers are never freed so a
+// trace can still be written after their threads exited
+struct profile_thread_buffer
+{
+    profile_event *events;
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> dropped;
+    uint32_t thread_id;
+    char name[PROFILE_THREAD_NAME_SIZE];
+    profile_thread_buffer *next;
+};
+
+inline uint64_t
+profile_ticks()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline double
+profile_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ticks and steady clock time of the first use, trace timestamps start here
+struct profile_epoch
+{
+    uint64_t ticks;
+    double time;
+};
+
+inline const profile_epoch *
+profile_get_epoch()
+{
+    static const profile_epoch epoch = {profile_ticks(), profile_now()};
+    return &epoch;
+}
+
+// head of the list of every thread's buffer, new buffers are pushed in front
+inline std::atomic<profile_thread_buffer *> *
+profile_buffer_list()
+{
+    static std::atomic<profile_thread_buffer *> head(nullptr);
+    return &head;
+}
+
+inline profile_thread_buffer **
+profile_local_buffer()
+{
+    static thread_local profile_thread_buffer *buffer = nullptr;
+    return &buffer;
+}
+
+// first event on a thread, kept out of line so the zone fast path stays small
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+inline profile_thread_buffer *
+profile_register_thread()
+{
+    static std::atomic<uint32_t> next_thread_id(1);
+    profile_get_epoch();
+
+    profile_thread_buffer *buffer = new profile_thread_buffer;
+    buffer->events = (profile_event *)malloc(PROFILE_EVENTS_PER_THREAD * sizeof(profile_event));
+    buffer->count.store(0, std::memory_order_relaxed);
+    buffer->dropped.store(buffer->events ? 0 : 1, std::memory_order_relaxed);
+    buffer->thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    snprintf(buffer->name, sizeof(buffer->name), "thread %u", buffer->thread_id);
+
+    std::atomic<profile_thread_buffer *> *head = profile_buffer_list();
+    buffer->next = head->load(std::memory_order_relaxed);
+    while (head->compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed) == false)
+    {
+    }
+
+    *profile_local_buffer() = buffer;
+    return buffer;
+}
+
+inline void
+profile_record(const char *name, uint64_t begin, uint64_t end)
+{
+    profile_thread_buffer *buffer = *profile_local_buffer();
+    if (buffer == nullptr)
+        buffer = profile_register_thread();
+
+    uint32_t count = buffer->count.load(std::memory_order_relaxed);
+    if (count == PROFILE_EVENTS_PER_THREAD || buffer->events == nullptr)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    profile_event *event = &buffer->events[count];
+    event->name = name;
+    event->begin = begin;
+    event->end = end;
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+struct profile_zone
+{
+    const char *name;
+    uint64_t begin;
+
+    explicit profile_zone(const char *zone_name) : name(zone_name), begin(profile_ticks()) {}
+    ~profile_zone() { profile_record(name, begin, profile_ticks()); }
+
+    profile_zone(const profile_zone &) = delete;
+    profile_zone &operator=(const profile_zone &) = delete;
+};
+
+// shows up as the thread's name in the trace
+inline void
+profile_set_thread_name(const char *name)
+{
+    profile_thread_buffer *buffer = *profile_local_buffer();
+    if (buffer == nullptr)
+        buffer = profile_register_thread();
+    snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+struct profile_stats
+{
+    uint32_t threads;
+    uint64_t events;
+    uint64_t dropped;
+};
+
+inline profile_stats
+profile_get_stats()
+{
+    profile_stats stats = {};
+    for (profile_thread_buffer *buffer = profile_buffer_list()->load(std::memory_order_acquire); buffer; buffer = buffer->next)
+    {
+        stats.threads++;
+        stats.events += buffer->count.load(std::memory_order_acquire);
+        stats.dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+// forgets every recorded event, only call it while no zone is open on any thread
+inline void
+profile_reset()
+{
+    for (profile_thread_buffer *buffer = profile_buffer_list()->load(std::memory_order_acquire); buffer; buffer = buffer->next)
+    {
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+}
+
+// ticks per microsecond measured between the epoch and now
+inline double
+profile_ticks_per_us()
+{
+    const profile_epoch *epoch = profile_get_epoch();
+    uint64_t ticks = profile_ticks();
+    double us = (profile_now() - epoch->time) * 1e6;
+    if (us <= 0.0 || ticks == epoch->ticks)
+        return 1.0;
+    return (double)(ticks - epoch->ticks) / us;
+}
+
+// writes s followed by suffix as one quoted json string, s is escaped and suffix is written
+// as is. names come from the program and may hold anything. frame_timing.h's json uses it too
+inline void
+profile_write_json_string(FILE *file, const char *s, const char *suffix = "")
+{
+    fputc('"', file);
+    for (; *s; ++s)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+    fprintf(file, "%s\"", suffix);
+}
+
+// every event recorded so far, zones still open are not included. safe to call while
+// other threads keep recording, their events after the start of the call may be missing
+inline bool
+profile_write_chrome_trace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    const profile_epoch *epoch = profile_get_epoch();
+    double us_per_tick = 1.0 / profile_ticks_per_us();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (profile_thread_buffer *buffer = profile_buffer_list()->load(std::memory_order_acquire); buffer; buffer = buffer->next)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n",
+            buffer->thread_id);
+        profile_write_json_string(file, buffer->name);
+        fprintf(file, "}}");
+        first = false;
+
+        uint32_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const profile_event *event = &buffer->events[i];
+            double ts = (double)(int64_t)(event->begin - epoch->ticks) * us_per_tick;
+            double dur = (double)(event->end - event->begin) * us_per_tick;
+            fprintf(file, ",\n{\"name\":");
+            profile_write_json_string(file, event->name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->thread_id, ts, dur);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "profile.h"
+#include "thread_pool.h"
+
+#if defined(_WIN32)
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <Windows.h>
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// shader bytecode cache. a shader is keyed by a hash of its source, entry point, profile,
+// defines, compile flags and the compiler name and version. results live in memory and in
+// one file per key under the cache directory, so later runs skip the compiler entirely.
+// files are written to a temporary name and renamed into place, a run that dies half way
+// or two processes filling the same cache never leave a torn file behind. #include'd files
+// are not part of the key, shaders that use them have to be passed in flattened.
+//
+// the compiler is a function pointer, shader_cache_d3d.h wraps D3DCompile and anything else
+// (a stub on linux, dxc) can be plugged in the same way.
+
+#define SHADER_CACHE_MAGIC 0x43444853 // "SHDC"
+#define SHADER_CACHE_VERSION 1
+
+// same layout as D3D_SHADER_MACRO, arrays end with a {nullptr, nullptr} entry
+struct shader_define
+{
+    const char *name;
+    const char *definition;
+};
+
+struct shader_desc
+{
+    const char *name; // shows up in compiler errors
+    const char *source;
+    size_t source_size;
+    const char *entry;
+    const char *profile;
+    const shader_define *defines; // may be null
+    uint32_t flags;
+};
+
+// returns false on a compile error, errors receives the compiler output either way
+typedef bool (*shader_compile_fn)(void *user, const shader_desc *desc, std::vector<uint8_t> *bytecode, std::string *errors);
+
+struct shader_compiler
+{
+    const char *name;
+    uint32_t version;
+    shader_compile_fn compile;
+    void *user;
+};
+
+struct shader_result
+{
+    std::vector<uint8_t> bytecode;
+    std::string errors;
+    bool ok;
+    bool cached;
+};
+
+struct shader_cache_stats
+{
+    uint64_t lookups;
+    uint64_t memory_hits;
+    uint64_t disk_hits;
+    uint64_t compiles;
+    uint64_t failures;
+    double compile_seconds; // spent in the compiler
+    double load_seconds;    // spent reading cache files
+    double saved_seconds;   // what the hits took to compile originally, minus load_seconds
+};
+
+struct shader_cache_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+    uint64_t checksum;
+    double compile_seconds;
+};
+
+struct shader_cache_entry
+{
+    std::vector<uint8_t> bytecode;
+    double compile_seconds;
+};
+
+struct shader_cache
+{
+    std::string dir; // empty keeps everything in memory
+    shader_compiler compiler;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, shader_cache_entry> entries;
+    shader_cache_stats stats;
+};
+
+inline double
+shader_cache_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 64 bit fnv-1a
+inline uint64_t
+shader_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// strings are hashed with their length so "ab" + "c" and "a" + "bc" differ
+inline uint64_t
+shader_cache_hash_string(uint64_t hash, const char *s)
+{
+    uint64_t length = s ? strlen(s) : ~0ull;
+    hash = shader_cache_hash(hash, &length, sizeof(length));
+    return s ? shader_cache_hash(hash, s, (size_t)length) : hash;
+}
+
+inline uint64_t
+shader_cache_key(const shader_cache *cache, const shader_desc *desc)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = shader_cache_hash_string(hash, cache->compiler.name);
+    hash = shader_cache_hash(hash, &cache->compiler.version, sizeof(cache->compiler.version));
+    uint64_t size = desc->source_size;
+    hash = shader_cache_hash(hash, &size, sizeof(size));
+    hash = shader_cache_hash(hash, desc->source, desc->source_size);
+    hash = shader_cache_hash_string(hash, desc->entry);
+    hash = shader_cache_hash_string(hash, desc->profile);
+    hash = shader_cache_hash(hash, &desc->flags, sizeof(desc->flags));
+    for (const shader_define *define = desc->defines; define && define->name; ++define)
+    {
+        hash = shader_cache_hash_string(hash, define->name);
+        hash = shader_cache_hash_string(hash, define->definition);
+    }
+    return hash;
+}
+
+inline std::string
+shader_cache_path(const shader_cache *cache, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.shader", (unsigned long long)key);
+    return cache->dir + name;
+}
+
+inline bool
+shader_cache_read(const shader_cache *cache, uint64_t key, shader_cache_entry *entry)
+{
+    FILE *file = fopen(shader_cache_path(cache, key).c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    shader_cache_file_header header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC &&
+        header.version == SHADER_CACHE_VERSION && header.key == key && header.size < (1ull << 30);
+    if (ok)
+    {
+        entry->bytecode.resize((size_t)header.size);
+        ok = fread(entry->bytecode.data(), 1, entry->bytecode.size(), file) == entry->bytecode.size() &&
+            shader_cache_hash(0xcbf29ce484222325ull, entry->bytecode.data(), entry->bytecode.size()) == header.checksum;
+        entry->compile_seconds = header.compile_seconds;
+    }
+    fclose(file);
+    return ok;
+}
+
+inline void
+shader_cache_write(const shader_cache *cache, uint64_t key, const shader_cache_entry *entry)
+{
+    shader_cache_file_header header = {};
+    header.magic = SHADER_CACHE_MAGIC;
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.size = entry->bytecode.size();
+    header.checksum = shader_cache_hash(0xcbf29ce484222325ull, entry->bytecode.data(), entry->bytecode.size());
+    header.compile_seconds = entry->compile_seconds;
+
+    // unique per thread and process so concurrent writers never share a temporary
+    std::string path = shader_cache_path(cache, key);
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%llx.tmp",
+        (unsigned long long)std::hash<std::thread::id>()(std::this_thread::get_id()) ^ (unsigned long long)(uintptr_t)&header);
+    std::string temp_path = path + suffix;
+
+    FILE *file = fopen(temp_path.c_str(), "wb");
+    if (file == nullptr)
+        return;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(entry->bytecode.data(), 1, entry->bytecode.size(), file) == entry->bytecode.size();
+    ok = fclose(file) == 0 && ok;
+
+#if defined(_WIN32)
+    ok = ok && MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+    ok = ok && rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+    if (ok == false)
+        remove(temp_path.c_str());
+}
+
+// dir may be null or empty for a memory only cache, it is created if it doesn't exist
+inline void
+shader_cache_init(shader_cache *cache, const char *dir, shader_compiler compiler)
+{
+    cache->dir = dir ? dir : "";
+    cache->compiler = compiler;
+    cache->entries.clear();
+    cache->stats = {};
+
+    if (cache->dir.empty() == false)
+    {
+#if defined(_WIN32)
+        _mkdir(cache->dir.c_str());
+#else
+        mkdir(cache->dir.c_str(), 0755);
+#endif
+    }
+}
+
+inline shader_cache_stats
+shader_cache_get_stats(shader_cache *cache)
+{
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    return cache->stats;
+}
+
+// memory, then disk, then the compiler. failed compiles are not cached so a fixed shader is
+// picked up on the next call. safe to call from several threads
+inline bool
+shader_cache_compile(shader_cache *cache, const shader_desc *desc, shader_result *result)
+{
+    uint64_t key = shader_cache_key(cache, desc);
+    result->errors.clear();
+    result->cached = true;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->stats.lookups++;
+        auto it = cache->entries.find(key);
+        if (it != cache->entries.end())
+        {
+            cache->stats.memory_hits++;
+            cache->stats.saved_seconds += it->second.compile_seconds;
+            result->bytecode = it->second.bytecode;
+            result->ok = true;
+            return true;
+        }
+    }
+
+    shader_cache_entry entry;
+    if (cache->dir.empty() == false)
+    {
+        double start = shader_cache_now();
+        bool found = shader_cache_read(cache, key, &entry);
+        double seconds = shader_cache_now() - start;
+
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->stats.load_seconds += seconds;
+        if (found)
+        {
+            cache->stats.disk_hits++;
+            cache->stats.saved_seconds += entry.compile_seconds - seconds;
+            result->bytecode = entry.bytecode;
+            result->ok = true;
+            cache->entries[key] = std::move(entry);
+            return true;
+        }
+    }
+
+    result->cached = false;
+    double start = shader_cache_now();
+    {
+        PROFILE_ZONE("shader compile");
+        result->ok = cache->compiler.compile(cache->compiler.user, desc, &entry.bytecode, &result->errors);
+    }
+    entry.compile_seconds = shader_cache_now() - start;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->stats.compiles++;
+        cache->stats.compile_seconds += entry.compile_seconds;
+        if (result->ok == false)
+        {
+            cache->stats.failures++;
+            return false;
+        }
+    }
+
+    if (cache->dir.empty() == false)
+        shader_cache_write(cache, key, &entry);
+    result->bytecode = entry.bytecode;
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->entries[key] = std::move(entry);
+    return true;
+}
+
+// looks up count independent shaders, the misses compile in parallel on the pool. pool may be
+// null to do everything on the calling thread. returns true if all of them succeeded
+inline bool
+shader_cache_compile_many(shader_cache *cache, const shader_desc *descs, int count, shader_result *results, thread_pool *pool)
+{
+    std::vector<uint8_t> ok(count);
+    auto compile = [&](int i) { ok[i] = shader_cache_compile(cache, &descs[i], &results[i]) ? 1 : 0; };
+    if (pool)
+    {
+        thread_pool_parallel_for(pool, count, compile);
+    }
+    else
+    {
+        for (int i = 0; i < count; ++i)
+            compile(i);
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (ok[i] == 0)
+            return false;
+    }
+    return true;
+}
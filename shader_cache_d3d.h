@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3dcompiler.h>
+
+#include "shader_cache.h"
+
+// shader_cache compiler backed by D3DCompile, link with d3dcompiler.lib
+
+inline bool
+shader_compile_d3d(void *user, const shader_desc *desc, std::vector<uint8_t> *bytecode, std::string *errors)
+{
+    ID3DBlob *code_blob = nullptr;
+    ID3DBlob *error_blob = nullptr;
+    HRESULT result = D3DCompile(
+        desc->source,
+        desc->source_size,
+        desc->name,
+        (const D3D_SHADER_MACRO *)desc->defines,
+        nullptr,
+        desc->entry,
+        desc->profile,
+        desc->flags,
+        0,
+        &code_blob,
+        &error_blob);
+
+    if (error_blob)
+    {
+        errors->assign((const char *)error_blob->GetBufferPointer(), error_blob->GetBufferSize());
+        error_blob->Release();
+    }
+    if (FAILED(result))
+        return false;
+
+    const uint8_t *code = (const uint8_t *)code_blob->GetBufferPointer();
+    bytecode->assign(code, code + code_blob->GetBufferSize());
+    code_blob->Release();
+    return true;
+}
+
+inline shader_compiler
+shader_compiler_d3d()
+{
+    shader_compiler compiler = {};
+    compiler.name = "D3DCompile";
+    compiler.version = D3D_COMPILER_VERSION;
+    compiler.compile = shader_compile_d3d;
+    return compiler;
+}
@@ -0,0 +1,620 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// portable replacement for the DirectXMath subset the examples use. matrices are row-major
+// and multiply row vectors (v * m) exactly like XMMATRIX, so mat4_transpose(world * proj)
+// can be memcpy'd into a cbuffer read by mul(float4(p, 1), mvp).
+//
+// mat4 works on one 4x4 at a time with 128-bit rows. mat4_soa stores many matrices as 16
+// float streams and the mat4_soa_* functions process SIMD_MATH_WIDTH matrices per step,
+// 8 with AVX2, 4 with SSE/NEON, 1 without SIMD (define SIMD_MATH_NO_SIMD to force it).
+
+#if defined(SIMD_MATH_NO_SIMD)
+    #define SIMD_MATH_SCALAR 1
+    #define SIMD_MATH_WIDTH 1
+    #define SIMD_MATH_NAME "scalar"
+#elif defined(__AVX2__)
+    #define SIMD_MATH_SSE 1
+    #define SIMD_MATH_AVX2 1
+    #define SIMD_MATH_WIDTH 8
+    #define SIMD_MATH_NAME "avx2"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SIMD_MATH_SSE 1
+    #define SIMD_MATH_WIDTH 4
+    #if defined(__SSE4_1__) || defined(__AVX__)
+        #define SIMD_MATH_NAME "sse4.1"
+    #else
+        #define SIMD_MATH_NAME "sse2"
+    #endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #define SIMD_MATH_NEON 1
+    #define SIMD_MATH_WIDTH 4
+    #define SIMD_MATH_NAME "neon"
+#else
+    #define SIMD_MATH_SCALAR 1
+    #define SIMD_MATH_WIDTH 1
+    #define SIMD_MATH_NAME "scalar"
+#endif
+
+#if defined(SIMD_MATH_SSE)
+    #include <immintrin.h>
+#elif defined(SIMD_MATH_NEON)
+    #include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+    #include <malloc.h>
+#endif
+
+#define SIMD_MATH_ALIGN 32
+#define SIMD_MATH_PI 3.14159265358979323846f
+
+inline float
+simd_radians(float degrees)
+{
+    return degrees * (SIMD_MATH_PI / 180.0f);
+}
+
+inline void *
+simd_aligned_alloc(size_t size)
+{
+#if defined(_MSC_VER)
+    return _aligned_malloc(size, SIMD_MATH_ALIGN);
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, SIMD_MATH_ALIGN, size) != 0)
+        return nullptr;
+    return ptr;
+#endif
+}
+
+inline void
+simd_aligned_free(void *ptr)
+{
+#if defined(_MSC_VER)
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+//
+// v4, one 128-bit row
+//
+
+#if defined(SIMD_MATH_SSE)
+typedef __m128 v4;
+
+inline v4 v4_set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+inline v4 v4_splat(float f) { return _mm_set1_ps(f); }
+inline v4 v4_load(const float *p) { return _mm_loadu_ps(p); }
+inline void v4_store(float *p, v4 a) { _mm_storeu_ps(p, a); }
+inline v4 v4_add(v4 a, v4 b) { return _mm_add_ps(a, b); }
+inline v4 v4_mul(v4 a, v4 b) { return _mm_mul_ps(a, b); }
+template <int lane> inline v4 v4_splat_lane(v4 a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(lane, lane, lane, lane)); }
+#elif defined(SIMD_MATH_NEON)
+typedef float32x4_t v4;
+
+inline v4 v4_set(float x, float y, float z, float w) { float f[4] = {x, y, z, w}; return vld1q_f32(f); }
+inline v4 v4_splat(float f) { return vdupq_n_f32(f); }
+inline v4 v4_load(const float *p) { return vld1q_f32(p); }
+inline void v4_store(float *p, v4 a) { vst1q_f32(p, a); }
+inline v4 v4_add(v4 a, v4 b) { return vaddq_f32(a, b); }
+inline v4 v4_mul(v4 a, v4 b) { return vmulq_f32(a, b); }
+template <int lane> inline v4 v4_splat_lane(v4 a) { return vdupq_n_f32(vgetq_lane_f32(a, lane)); }
+#else
+struct v4
+{
+    float e[4];
+};
+
+inline v4 v4_set(float x, float y, float z, float w) { return {{x, y, z, w}}; }
+inline v4 v4_splat(float f) { return {{f, f, f, f}}; }
+inline v4 v4_load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void v4_store(float *p, v4 a) { memcpy(p, a.e, sizeof(a.e)); }
+inline v4 v4_add(v4 a, v4 b) { return {{a.e[0] + b.e[0], a.e[1] + b.e[1], a.e[2] + b.e[2], a.e[3] + b.e[3]}}; }
+inline v4 v4_mul(v4 a, v4 b) { return {{a.e[0] * b.e[0], a.e[1] * b.e[1], a.e[2] * b.e[2], a.e[3] * b.e[3]}}; }
+template <int lane> inline v4 v4_splat_lane(v4 a) { return v4_splat(a.e[lane]); }
+#endif
+
+inline v4
+v4_madd(v4 a, v4 b, v4 c)
+{
+#if defined(SIMD_MATH_SSE) && defined(__FMA__)
+    return _mm_fmadd_ps(a, b, c);
+#elif defined(SIMD_MATH_NEON) && defined(__aarch64__)
+    return vfmaq_f32(c, a, b);
+#else
+    return v4_add(v4_mul(a, b), c);
+#endif
+}
+
+//
+// mat4, single matrix operations
+//
+
+struct mat4
+{
+    v4 r[4];
+};
+
+inline mat4
+mat4_load(const float *m)
+{
+    return {{v4_load(m), v4_load(m + 4), v4_load(m + 8), v4_load(m + 12)}};
+}
+
+inline void
+mat4_store(float *out, const mat4 &m)
+{
+    for (int i = 0; i < 4; ++i)
+        v4_store(out + i * 4, m.r[i]);
+}
+
+inline mat4
+mat4_identity()
+{
+    return {{v4_set(1, 0, 0, 0), v4_set(0, 1, 0, 0), v4_set(0, 0, 1, 0), v4_set(0, 0, 0, 1)}};
+}
+
+inline v4
+v4_transform(v4 v, const mat4 &m)
+{
+    v4 r = v4_mul(v4_splat_lane<0>(v), m.r[0]);
+    r = v4_madd(v4_splat_lane<1>(v), m.r[1], r);
+    r = v4_madd(v4_splat_lane<2>(v), m.r[2], r);
+    r = v4_madd(v4_splat_lane<3>(v), m.r[3], r);
+    return r;
+}
+
+inline mat4
+mat4_mul(const mat4 &a, const mat4 &b)
+{
+    return {{v4_transform(a.r[0], b), v4_transform(a.r[1], b), v4_transform(a.r[2], b), v4_transform(a.r[3], b)}};
+}
+
+inline mat4
+operator*(const mat4 &a, const mat4 &b)
+{
+    return mat4_mul(a, b);
+}
+
+inline mat4
+mat4_transpose(const mat4 &m)
+{
+#if defined(SIMD_MATH_SSE)
+    mat4 t = m;
+    _MM_TRANSPOSE4_PS(t.r[0], t.r[1], t.r[2], t.r[3]);
+    return t;
+#elif defined(SIMD_MATH_NEON)
+    float32x4x2_t a = vzipq_f32(m.r[0], m.r[2]);
+    float32x4x2_t b = vzipq_f32(m.r[1], m.r[3]);
+    float32x4x2_t lo = vzipq_f32(a.val[0], b.val[0]);
+    float32x4x2_t hi = vzipq_f32(a.val[1], b.val[1]);
+    return {{lo.val[0], lo.val[1], hi.val[0], hi.val[1]}};
+#else
+    mat4 t;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            t.r[i].e[j] = m.r[j].e[i];
+    return t;
+#endif
+}
+
+inline mat4
+mat4_translation(float x, float y, float z)
+{
+    return {{v4_set(1, 0, 0, 0), v4_set(0, 1, 0, 0), v4_set(0, 0, 1, 0), v4_set(x, y, z, 1)}};
+}
+
+inline mat4
+mat4_rotation_x(float angle)
+{
+    float s = sinf(angle);
+    float c = cosf(angle);
+    return {{v4_set(1, 0, 0, 0), v4_set(0, c, s, 0), v4_set(0, -s, c, 0), v4_set(0, 0, 0, 1)}};
+}
+
+inline mat4
+mat4_rotation_y(float angle)
+{
+    float s = sinf(angle);
+    float c = cosf(angle);
+    return {{v4_set(c, 0, -s, 0), v4_set(0, 1, 0, 0), v4_set(s, 0, c, 0), v4_set(0, 0, 0, 1)}};
+}
+
+inline mat4
+mat4_rotation_z(float angle)
+{
+    float s = sinf(angle);
+    float c = cosf(angle);
+    return {{v4_set(c, s, 0, 0), v4_set(-s, c, 0, 0), v4_set(0, 0, 1, 0), v4_set(0, 0, 0, 1)}};
+}
+
+// left handed, depth maps [near_z, far_z] to [0, 1] like XMMatrixPerspectiveFovLH
+inline mat4
+mat4_perspective_fov_lh(float fov_y, float aspect, float near_z, float far_z)
+{
+    float h = cosf(0.5f * fov_y) / sinf(0.5f * fov_y);
+    float w = h / aspect;
+    float range = far_z / (far_z - near_z);
+    return {{v4_set(w, 0, 0, 0), v4_set(0, h, 0, 0), v4_set(0, 0, range, 1), v4_set(0, 0, -range * near_z, 0)}};
+}
+
+//
+// vf, SIMD_MATH_WIDTH lanes used by the batch functions
+//
+
+#if defined(SIMD_MATH_AVX2)
+typedef __m256 vf;
+
+inline vf vf_load(const float *p) { return _mm256_load_ps(p); }
+inline vf vf_loadu(const float *p) { return _mm256_loadu_ps(p); }
+inline void vf_store(float *p, vf a) { _mm256_store_ps(p, a); }
+inline vf vf_splat(float f) { return _mm256_set1_ps(f); }
+inline vf vf_add(vf a, vf b) { return _mm256_add_ps(a, b); }
+inline vf vf_sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+inline vf vf_mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+inline vf vf_min(vf a, vf b) { return _mm256_min_ps(a, b); }
+inline vf vf_max(vf a, vf b) { return _mm256_max_ps(a, b); }
+inline vf vf_floor(vf a) { return _mm256_floor_ps(a); }
+inline vf vf_sqrt(vf a) { return _mm256_sqrt_ps(a); }
+inline vf vf_cmp_eq(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+inline vf vf_cmp_ge(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline vf vf_or(vf a, vf b) { return _mm256_or_ps(a, b); }
+inline vf vf_xor(vf a, vf b) { return _mm256_xor_ps(a, b); }
+inline vf vf_and(vf a, vf b) { return _mm256_and_ps(a, b); }
+inline vf vf_select(vf mask, vf a, vf b) { return _mm256_blendv_ps(b, a, mask); }
+#elif defined(SIMD_MATH_SSE)
+typedef __m128 vf;
+
+inline vf vf_load(const float *p) { return _mm_load_ps(p); }
+inline vf vf_loadu(const float *p) { return _mm_loadu_ps(p); }
+inline void vf_store(float *p, vf a) { _mm_store_ps(p, a); }
+inline vf vf_splat(float f) { return _mm_set1_ps(f); }
+inline vf vf_add(vf a, vf b) { return _mm_add_ps(a, b); }
+inline vf vf_sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+inline vf vf_mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+inline vf vf_min(vf a, vf b) { return _mm_min_ps(a, b); }
+inline vf vf_max(vf a, vf b) { return _mm_max_ps(a, b); }
+inline vf vf_sqrt(vf a) { return _mm_sqrt_ps(a); }
+inline vf vf_cmp_eq(vf a, vf b) { return _mm_cmpeq_ps(a, b); }
+inline vf vf_cmp_ge(vf a, vf b) { return _mm_cmpge_ps(a, b); }
+inline vf vf_or(vf a, vf b) { return _mm_or_ps(a, b); }
+inline vf vf_xor(vf a, vf b) { return _mm_xor_ps(a, b); }
+inline vf vf_and(vf a, vf b) { return _mm_and_ps(a, b); }
+#if defined(__SSE4_1__) || defined(__AVX__)
+inline vf vf_floor(vf a) { return _mm_floor_ps(a); }
+inline vf vf_select(vf mask, vf a, vf b) { return _mm_blendv_ps(b, a, mask); }
+#else
+inline vf
+vf_floor(vf a)
+{
+    // truncate then fix up negative non-integers, inputs stay well inside int32 range
+    vf t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+inline vf vf_select(vf mask, vf a, vf b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+#endif
+#elif defined(SIMD_MATH_NEON)
+typedef float32x4_t vf;
+
+inline vf vf_load(const float *p) { return vld1q_f32(p); }
+inline vf vf_loadu(const float *p) { return vld1q_f32(p); }
+inline void vf_store(float *p, vf a) { vst1q_f32(p, a); }
+inline vf vf_splat(float f) { return vdupq_n_f32(f); }
+inline vf vf_add(vf a, vf b) { return vaddq_f32(a, b); }
+inline vf vf_sub(vf a, vf b) { return vsubq_f32(a, b); }
+inline vf vf_mul(vf a, vf b) { return vmulq_f32(a, b); }
+inline vf vf_min(vf a, vf b) { return vminq_f32(a, b); }
+inline vf vf_max(vf a, vf b) { return vmaxq_f32(a, b); }
+inline vf vf_cmp_eq(vf a, vf b) { return vreinterpretq_f32_u32(vceqq_f32(a, b)); }
+inline vf vf_cmp_ge(vf a, vf b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline vf vf_or(vf a, vf b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline vf vf_xor(vf a, vf b) { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline vf vf_and(vf a, vf b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline vf vf_select(vf mask, vf a, vf b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+#if defined(__aarch64__) || defined(_M_ARM64)
+inline vf vf_floor(vf a) { return vrndmq_f32(a); }
+inline vf vf_sqrt(vf a) { return vsqrtq_f32(a); }
+#else
+inline vf
+vf_sqrt(vf a)
+{
+    // armv7 has only the estimate, go through memory for exact results
+    float f[4];
+    vst1q_f32(f, a);
+    for (int i = 0; i < 4; ++i)
+        f[i] = sqrtf(f[i]);
+    return vld1q_f32(f);
+}
+inline vf
+vf_floor(vf a)
+{
+    vf t = vcvtq_f32_s32(vcvtq_s32_f32(a));
+    return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, a), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+}
+#endif
+#else
+typedef float vf;
+
+inline vf vf_load(const float *p) { return *p; }
+inline vf vf_loadu(const float *p) { return *p; }
+inline void vf_store(float *p, vf a) { *p = a; }
+inline vf vf_splat(float f) { return f; }
+inline vf vf_add(vf a, vf b) { return a + b; }
+inline vf vf_sub(vf a, vf b) { return a - b; }
+inline vf vf_mul(vf a, vf b) { return a * b; }
+inline vf vf_min(vf a, vf b) { return a < b ? a : b; }
+inline vf vf_max(vf a, vf b) { return a > b ? a : b; }
+inline vf vf_floor(vf a) { return floorf(a); }
+inline vf vf_sqrt(vf a) { return sqrtf(a); }
+// masks are 0.0f or -0.0f so sign flips with vf_xor keep working
+inline vf vf_cmp_eq(vf a, vf b) { return a == b ? -0.0f : 0.0f; }
+inline vf vf_cmp_ge(vf a, vf b) { return a >= b ? -0.0f : 0.0f; }
+inline vf vf_or(vf a, vf b) { return (signbit(a) || signbit(b)) ? -0.0f : 0.0f; }
+inline vf vf_and(vf a, vf b) { return signbit(a) ? b : 0.0f; }
+inline vf vf_xor(vf a, vf b) { return signbit(b) ? -a : a; }
+inline vf vf_select(vf mask, vf a, vf b) { return signbit(mask) ? a : b; }
+#endif
+
+inline vf
+vf_madd(vf a, vf b, vf c)
+{
+#if defined(SIMD_MATH_AVX2) && defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#elif defined(SIMD_MATH_SSE) && !defined(SIMD_MATH_AVX2) && defined(__FMA__)
+    return _mm_fmadd_ps(a, b, c);
+#elif defined(SIMD_MATH_NEON) && defined(__aarch64__)
+    return vfmaq_f32(c, a, b);
+#else
+    return vf_add(vf_mul(a, b), c);
+#endif
+}
+
+// one bit per lane of a comparison mask, lane 0 in bit 0
+inline uint32_t
+vf_mask_bits(vf mask)
+{
+#if defined(SIMD_MATH_AVX2)
+    return (uint32_t)_mm256_movemask_ps(mask);
+#elif defined(SIMD_MATH_SSE)
+    return (uint32_t)_mm_movemask_ps(mask);
+#elif defined(SIMD_MATH_NEON)
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+    return vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3);
+#else
+    return signbit(mask) ? 1u : 0u;
+#endif
+}
+
+// sine and cosine of every lane, cephes style reduction to [-pi/4, pi/4] around multiples of pi/2
+inline void
+vf_sincos(vf x, vf *out_sin, vf *out_cos)
+{
+    vf j = vf_floor(vf_madd(x, vf_splat(0.63661977236758134f), vf_splat(0.5f)));
+    vf y = vf_madd(j, vf_splat(-1.5703125f), x);
+    y = vf_madd(j, vf_splat(-4.837512969970703125e-4f), y);
+    y = vf_madd(j, vf_splat(-7.54978995489188216e-8f), y);
+
+    vf y2 = vf_mul(y, y);
+    vf s = vf_madd(y2, vf_splat(-1.9515295891e-4f), vf_splat(8.3321608736e-3f));
+    s = vf_madd(s, y2, vf_splat(-1.6666654611e-1f));
+    s = vf_madd(vf_mul(s, y2), y, y);
+    vf c = vf_madd(y2, vf_splat(2.443315711809948e-5f), vf_splat(-1.388731625493765e-3f));
+    c = vf_madd(c, y2, vf_splat(4.166664568298827e-2f));
+    c = vf_madd(vf_mul(c, y2), y2, vf_madd(y2, vf_splat(-0.5f), vf_splat(1.0f)));
+
+    // quadrant q = j mod 4
+    vf q = vf_sub(j, vf_mul(vf_floor(vf_mul(j, vf_splat(0.25f))), vf_splat(4.0f)));
+    vf odd = vf_or(vf_cmp_eq(q, vf_splat(1.0f)), vf_cmp_eq(q, vf_splat(3.0f)));
+    vf sin_negative = vf_cmp_ge(q, vf_splat(2.0f));
+    vf cos_negative = vf_or(vf_cmp_eq(q, vf_splat(1.0f)), vf_cmp_eq(q, vf_splat(2.0f)));
+    vf sign_bit = vf_splat(-0.0f);
+
+    vf sin_result = vf_select(odd, c, s);
+    vf cos_result = vf_select(odd, s, c);
+    *out_sin = vf_xor(sin_result, vf_and(sin_negative, sign_bit));
+    *out_cos = vf_xor(cos_result, vf_and(cos_negative, sign_bit));
+}
+
+//
+// mat4_soa, many matrices stored as 16 streams of `stride` floats, element (i, row, col)
+// lives at data[(row * 4 + col) * stride + i]. stride is count rounded up to SIMD_MATH_WIDTH
+//
+
+struct mat4_soa
+{
+    float *data;
+    size_t count;
+    size_t stride;
+};
+
+inline bool
+mat4_soa_init(mat4_soa *soa, size_t count)
+{
+    soa->count = count;
+    soa->stride = (count + 7) & ~(size_t)7;
+    soa->data = (float *)simd_aligned_alloc(16 * soa->stride * sizeof(float));
+    if (soa->data == nullptr)
+        return false;
+    memset(soa->data, 0, 16 * soa->stride * sizeof(float));
+    return true;
+}
+
+inline void
+mat4_soa_free(mat4_soa *soa)
+{
+    simd_aligned_free(soa->data);
+    soa->data = nullptr;
+    soa->count = 0;
+    soa->stride = 0;
+}
+
+inline float *
+mat4_soa_stream(const mat4_soa *soa, int row, int col)
+{
+    return soa->data + (size_t)(row * 4 + col) * soa->stride;
+}
+
+inline void
+mat4_soa_set(mat4_soa *soa, size_t index, const mat4 &m)
+{
+    float f[16];
+    mat4_store(f, m);
+    for (int i = 0; i < 16; ++i)
+        soa->data[(size_t)i * soa->stride + index] = f[i];
+}
+
+inline mat4
+mat4_soa_get(const mat4_soa *soa, size_t index)
+{
+    float f[16];
+    for (int i = 0; i < 16; ++i)
+        f[i] = soa->data[(size_t)i * soa->stride + index];
+    return mat4_load(f);
+}
+
+// loads SIMD_MATH_WIDTH floats from a caller array of `count` floats, zero filling past the end
+inline vf
+mat4_soa_load_tail(const float *p, size_t index, size_t count)
+{
+    if (index + SIMD_MATH_WIDTH <= count)
+        return vf_loadu(p + index);
+
+    alignas(SIMD_MATH_ALIGN) float tmp[SIMD_MATH_WIDTH] = {};
+    for (size_t i = index; i < count; ++i)
+        tmp[i - index] = p[i];
+    return vf_load(tmp);
+}
+
+// out[i] = rotation_x(angle_x[i]) * rotation_y(angle_y[i]) * rotation_z(angle_z[i]) * translation(t[i])
+inline void
+mat4_soa_euler_translation(mat4_soa *out,
+    const float *angle_x, const float *angle_y, const float *angle_z,
+    const float *tx, const float *ty, const float *tz)
+{
+    vf zero = vf_splat(0.0f);
+    vf one = vf_splat(1.0f);
+    for (size_t i = 0; i < out->count; i += SIMD_MATH_WIDTH)
+    {
+        vf sx, cx, sy, cy, sz, cz;
+        vf_sincos(mat4_soa_load_tail(angle_x, i, out->count), &sx, &cx);
+        vf_sincos(mat4_soa_load_tail(angle_y, i, out->count), &sy, &cy);
+        vf_sincos(mat4_soa_load_tail(angle_z, i, out->count), &sz, &cz);
+
+        vf sx_sy = vf_mul(sx, sy);
+        vf cx_sy = vf_mul(cx, sy);
+
+        float *d = out->data + i;
+        size_t s = out->stride;
+        vf_store(d + 0 * s, vf_mul(cy, cz));
+        vf_store(d + 1 * s, vf_mul(cy, sz));
+        vf_store(d + 2 * s, vf_sub(zero, sy));
+        vf_store(d + 3 * s, zero);
+        vf_store(d + 4 * s, vf_sub(vf_mul(sx_sy, cz), vf_mul(cx, sz)));
+        vf_store(d + 5 * s, vf_madd(sx_sy, sz, vf_mul(cx, cz)));
+        vf_store(d + 6 * s, vf_mul(sx, cy));
+        vf_store(d + 7 * s, zero);
+        vf_store(d + 8 * s, vf_madd(cx_sy, cz, vf_mul(sx, sz)));
+        vf_store(d + 9 * s, vf_sub(vf_mul(cx_sy, sz), vf_mul(sx, cz)));
+        vf_store(d + 10 * s, vf_mul(cx, cy));
+        vf_store(d + 11 * s, zero);
+        vf_store(d + 12 * s, mat4_soa_load_tail(tx, i, out->count));
+        vf_store(d + 13 * s, mat4_soa_load_tail(ty, i, out->count));
+        vf_store(d + 14 * s, mat4_soa_load_tail(tz, i, out->count));
+        vf_store(d + 15 * s, one);
+    }
+}
+
+// out[i] = a[i] * b, out may alias a
+inline void
+mat4_soa_mul_mat4(mat4_soa *out, const mat4_soa *a, const mat4 &b)
+{
+    float bf[16];
+    mat4_store(bf, b);
+    size_t s = a->stride;
+    for (size_t i = 0; i < a->count; i += SIMD_MATH_WIDTH)
+    {
+        const float *src = a->data + i;
+        float *dst = out->data + i;
+        for (int row = 0; row < 4; ++row)
+        {
+            vf a0 = vf_load(src + (row * 4 + 0) * s);
+            vf a1 = vf_load(src + (row * 4 + 1) * s);
+            vf a2 = vf_load(src + (row * 4 + 2) * s);
+            vf a3 = vf_load(src + (row * 4 + 3) * s);
+            for (int col = 0; col < 4; ++col)
+            {
+                vf r = vf_mul(a0, vf_splat(bf[0 * 4 + col]));
+                r = vf_madd(a1, vf_splat(bf[1 * 4 + col]), r);
+                r = vf_madd(a2, vf_splat(bf[2 * 4 + col]), r);
+                r = vf_madd(a3, vf_splat(bf[3 * 4 + col]), r);
+                vf_store(dst + (row * 4 + col) * s, r);
+            }
+        }
+    }
+}
+
+// out[i] = a[i] * b[i], out may alias a or b
+inline void
+mat4_soa_mul(mat4_soa *out, const mat4_soa *a, const mat4_soa *b)
+{
+    size_t s = a->stride;
+    for (size_t i = 0; i < a->count; i += SIMD_MATH_WIDTH)
+    {
+        vf bm[16];
+        for (int k = 0; k < 16; ++k)
+            bm[k] = vf_load(b->data + k * b->stride + i);
+        for (int row = 0; row < 4; ++row)
+        {
+            vf a0 = vf_load(a->data + (row * 4 + 0) * s + i);
+            vf a1 = vf_load(a->data + (row * 4 + 1) * s + i);
+            vf a2 = vf_load(a->data + (row * 4 + 2) * s + i);
+            vf a3 = vf_load(a->data + (row * 4 + 3) * s + i);
+            for (int col = 0; col < 4; ++col)
+            {
+                vf r = vf_mul(a0, bm[0 * 4 + col]);
+                r = vf_madd(a1, bm[1 * 4 + col], r);
+                r = vf_madd(a2, bm[2 * 4 + col], r);
+                r = vf_madd(a3, bm[3 * 4 + col], r);
+                vf_store(out->data + (row * 4 + col) * out->stride + i, r);
+            }
+        }
+    }
+}
+
+// writes mat4_transpose(a[i]) as 16 consecutive floats per matrix, the layout the cbuffer wants
+inline void
+mat4_soa_store_transposed(float *out, const mat4_soa *a)
+{
+    size_t s = a->stride;
+    size_t i = 0;
+#if defined(SIMD_MATH_SSE)
+    // 4 matrices at a time, one 4x4 transpose per output row
+    for (; i + 4 <= a->count; i += 4)
+    {
+        for (int col = 0; col < 4; ++col)
+        {
+            __m128 r0 = _mm_load_ps(a->data + (0 * 4 + col) * s + i);
+            __m128 r1 = _mm_load_ps(a->data + (1 * 4 + col) * s + i);
+            __m128 r2 = _mm_load_ps(a->data + (2 * 4 + col) * s + i);
+            __m128 r3 = _mm_load_ps(a->data + (3 * 4 + col) * s + i);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(out + (i + 0) * 16 + col * 4, r0);
+            _mm_storeu_ps(out + (i + 1) * 16 + col * 4, r1);
+            _mm_storeu_ps(out + (i + 2) * 16 + col * 4, r2);
+            _mm_storeu_ps(out + (i + 3) * 16 + col * 4, r3);
+        }
+    }
+#endif
+    for (; i < a->count; ++i)
+        for (int row = 0; row < 4; ++row)
+            for (int col = 0; col < 4; ++col)
+                out[i * 16 + col * 4 + row] = a->data[(row * 4 + col) * s + i];
+}
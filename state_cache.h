@@ -0,0 +1,602 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// redundant state filter in front of a device context. set calls only record the state the
+// next draw wants, one slot at a time, and the draw sends the backend what differs from what
+// it already has bound. a set that matches what is already wanted never leaves the cache, the
+// changed slots of an array (vertex buffers, constant buffers, views, samplers) go out as one
+// range call from the lowest to the highest changed slot, and a state set and set back before
+// the next draw costs nothing.
+//
+// the cache assumes it is the only thing binding state on its context. after anything else
+// does (ClearState, a deferred context, d3d unbinding a resource that got bound as an output)
+// call state_cache_invalidate so the next draw rebinds everything.
+//
+// the context sits behind state_cache_backend, state_cache_d3d.h drives an
+// ID3D11DeviceContext and state_cache_null.h the null device. objects are opaque pointers.
+
+#define STATE_CACHE_VERTEX_BUFFER_SLOTS 32
+#define STATE_CACHE_CONSTANT_BUFFER_SLOTS 14
+#define STATE_CACHE_SHADER_RESOURCE_SLOTS 128
+#define STATE_CACHE_SAMPLER_SLOTS 16
+#define STATE_CACHE_RENDER_TARGET_SLOTS 8
+#define STATE_CACHE_VIEWPORT_SLOTS 16
+
+enum state_cache_stage
+{
+    STATE_CACHE_STAGE_VS,
+    STATE_CACHE_STAGE_PS,
+    STATE_CACHE_STAGE_COUNT,
+};
+
+// what gets tracked and flushed as a unit, the per stage ones repeat for every stage
+enum state_cache_category
+{
+    STATE_CACHE_INPUT_LAYOUT,
+    STATE_CACHE_PRIMITIVE_TOPOLOGY,
+    STATE_CACHE_VERTEX_BUFFERS,
+    STATE_CACHE_INDEX_BUFFER,
+    STATE_CACHE_VIEWPORTS,
+    STATE_CACHE_RENDER_TARGETS,
+    STATE_CACHE_DEPTH_STENCIL_STATE,
+    STATE_CACHE_SHADER,
+    STATE_CACHE_CONSTANT_BUFFERS = STATE_CACHE_SHADER + STATE_CACHE_STAGE_COUNT,
+    STATE_CACHE_SHADER_RESOURCES = STATE_CACHE_CONSTANT_BUFFERS + STATE_CACHE_STAGE_COUNT,
+    STATE_CACHE_SAMPLERS = STATE_CACHE_SHADER_RESOURCES + STATE_CACHE_STAGE_COUNT,
+    STATE_CACHE_CATEGORY_COUNT = STATE_CACHE_SAMPLERS + STATE_CACHE_STAGE_COUNT,
+};
+
+// same layout as D3D11_VIEWPORT
+struct state_cache_viewport
+{
+    float top_left_x;
+    float top_left_y;
+    float width;
+    float height;
+    float min_depth;
+    float max_depth;
+};
+
+struct state_cache_backend
+{
+    void *user;
+    void (*set_input_layout)(void *user, void *input_layout);
+    void (*set_primitive_topology)(void *user, uint32_t topology);
+    void (*set_vertex_buffers)(void *user, uint32_t start_slot, uint32_t count, void *const *buffers, const uint32_t *strides, const uint32_t *offsets);
+    void (*set_index_buffer)(void *user, void *buffer, uint32_t format, uint32_t offset);
+    void (*set_shader)(void *user, state_cache_stage stage, void *shader);
+    // first_constants and constant_counts are null when every buffer in the range is bound whole
+    void (*set_constant_buffers)(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *buffers,
+        const uint32_t *first_constants, const uint32_t *constant_counts);
+    void (*set_shader_resources)(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *views);
+    void (*set_samplers)(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *samplers);
+    void (*set_viewports)(void *user, uint32_t count, const state_cache_viewport *viewports);
+    void (*set_render_targets)(void *user, uint32_t count, void *const *views, void *depth_stencil_view);
+    void (*set_depth_stencil_state)(void *user, void *state, uint32_t stencil_ref);
+    void (*draw)(void *user, uint32_t vertex_count, uint32_t start_vertex);
+    void (*draw_indexed)(void *user, uint32_t index_count, uint32_t start_index, int32_t base_vertex);
+    void (*draw_indexed_instanced)(void *user, uint32_t index_count, uint32_t instance_count, uint32_t start_index, int32_t base_vertex,
+        uint32_t start_instance);
+};
+
+// every set call ends up counted once, set_calls = issued_calls + elided_calls + merged_calls
+struct state_cache_stats
+{
+    uint64_t set_calls;    // made on the cache
+    uint64_t issued_calls; // made on the backend
+    uint64_t elided_calls; // changed nothing the backend didn't already have
+    uint64_t merged_calls; // went out as part of another call's range
+    uint64_t rebinds;      // made on the backend after state_cache_invalidate, not part of the above
+    uint64_t draws;
+};
+
+struct state_cache_stage_state
+{
+    void *shader;
+    void *constant_buffers[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    uint32_t first_constants[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    uint32_t constant_counts[STATE_CACHE_CONSTANT_BUFFER_SLOTS]; // 0 binds the whole buffer
+    void *shader_resources[STATE_CACHE_SHADER_RESOURCE_SLOTS];
+    void *samplers[STATE_CACHE_SAMPLER_SLOTS];
+};
+
+struct state_cache_state
+{
+    void *input_layout;
+    uint32_t topology;
+    void *vertex_buffers[STATE_CACHE_VERTEX_BUFFER_SLOTS];
+    uint32_t vertex_strides[STATE_CACHE_VERTEX_BUFFER_SLOTS];
+    uint32_t vertex_offsets[STATE_CACHE_VERTEX_BUFFER_SLOTS];
+    void *index_buffer;
+    uint32_t index_format;
+    uint32_t index_offset;
+    state_cache_stage_state stages[STATE_CACHE_STAGE_COUNT];
+    state_cache_viewport viewports[STATE_CACHE_VIEWPORT_SLOTS];
+    uint32_t viewport_count;
+    void *render_targets[STATE_CACHE_RENDER_TARGET_SLOTS];
+    void *depth_stencil_view;
+    void *depth_stencil_state;
+    uint32_t stencil_ref;
+};
+
+// slots [first, end) may differ between wanted and bound, changes is the set calls behind them
+struct state_cache_dirty
+{
+    uint32_t first;
+    uint32_t end;
+    uint32_t changes;
+};
+
+struct state_cache
+{
+    state_cache_backend backend;
+    state_cache_state wanted;
+    state_cache_state bound;
+    state_cache_dirty dirty[STATE_CACHE_CATEGORY_COUNT];
+    uint32_t dirty_mask;   // bit per category
+    uint32_t unknown_mask; // categories whose bound state is unknown and get rebound whole
+
+    state_cache_stats stats;
+    state_cache_stats last_frame;
+    state_cache_stats frame_start;
+};
+
+// a fresh context has nothing bound, which is what the cache starts from
+inline void
+state_cache_init(state_cache *cache, const state_cache_backend *backend)
+{
+    cache->backend = *backend;
+    memset(&cache->wanted, 0, sizeof(cache->wanted));
+    memset(&cache->bound, 0, sizeof(cache->bound));
+    memset(cache->dirty, 0, sizeof(cache->dirty));
+    cache->dirty_mask = 0;
+    cache->unknown_mask = 0;
+    cache->stats = {};
+    cache->last_frame = {};
+    cache->frame_start = {};
+}
+
+inline uint32_t
+state_cache_slot_count(int category)
+{
+    switch (category)
+    {
+        case STATE_CACHE_VERTEX_BUFFERS:
+            return STATE_CACHE_VERTEX_BUFFER_SLOTS;
+        case (int)STATE_CACHE_CONSTANT_BUFFERS + STATE_CACHE_STAGE_VS:
+        case (int)STATE_CACHE_CONSTANT_BUFFERS + STATE_CACHE_STAGE_PS:
+            return STATE_CACHE_CONSTANT_BUFFER_SLOTS;
+        case (int)STATE_CACHE_SHADER_RESOURCES + STATE_CACHE_STAGE_VS:
+        case (int)STATE_CACHE_SHADER_RESOURCES + STATE_CACHE_STAGE_PS:
+            return STATE_CACHE_SHADER_RESOURCE_SLOTS;
+        case (int)STATE_CACHE_SAMPLERS + STATE_CACHE_STAGE_VS:
+        case (int)STATE_CACHE_SAMPLERS + STATE_CACHE_STAGE_PS:
+            return STATE_CACHE_SAMPLER_SLOTS;
+        default:
+            return 1;
+    }
+}
+
+// forget what the backend has bound, the next draw rebinds all wanted state
+inline void
+state_cache_invalidate(state_cache *cache)
+{
+    for (int category = 0; category < STATE_CACHE_CATEGORY_COUNT; ++category)
+    {
+        cache->dirty[category].first = 0;
+        cache->dirty[category].end = state_cache_slot_count(category);
+    }
+    cache->dirty_mask = (1u << STATE_CACHE_CATEGORY_COUNT) - 1;
+    cache->unknown_mask = cache->dirty_mask;
+}
+
+inline void
+state_cache_end_frame(state_cache *cache)
+{
+    cache->last_frame.set_calls = cache->stats.set_calls - cache->frame_start.set_calls;
+    cache->last_frame.issued_calls = cache->stats.issued_calls - cache->frame_start.issued_calls;
+    cache->last_frame.elided_calls = cache->stats.elided_calls - cache->frame_start.elided_calls;
+    cache->last_frame.merged_calls = cache->stats.merged_calls - cache->frame_start.merged_calls;
+    cache->last_frame.rebinds = cache->stats.rebinds - cache->frame_start.rebinds;
+    cache->last_frame.draws = cache->stats.draws - cache->frame_start.draws;
+    cache->frame_start = cache->stats;
+}
+
+// records one set call that changed slots [first, end) of the wanted state, or counts it as
+// elided when it didn't change anything
+inline void
+state_cache_mark(state_cache *cache, int category, bool changed, uint32_t slot, uint32_t count = 1)
+{
+    cache->stats.set_calls++;
+    if (changed == false)
+    {
+        cache->stats.elided_calls++;
+        return;
+    }
+
+    state_cache_dirty *dirty = &cache->dirty[category];
+    uint32_t bit = 1u << category;
+    if (cache->dirty_mask & bit)
+    {
+        dirty->first = slot < dirty->first ? slot : dirty->first;
+        dirty->end = slot + count > dirty->end ? slot + count : dirty->end;
+    }
+    else
+    {
+        dirty->first = slot;
+        dirty->end = slot + count;
+        cache->dirty_mask |= bit;
+    }
+    dirty->changes++;
+}
+
+// set calls
+
+inline void
+state_cache_ia_set_input_layout(state_cache *cache, void *input_layout)
+{
+    bool changed = cache->wanted.input_layout != input_layout;
+    cache->wanted.input_layout = input_layout;
+    state_cache_mark(cache, STATE_CACHE_INPUT_LAYOUT, changed, 0);
+}
+
+// topology values are D3D11_PRIMITIVE_TOPOLOGY
+inline void
+state_cache_ia_set_primitive_topology(state_cache *cache, uint32_t topology)
+{
+    bool changed = cache->wanted.topology != topology;
+    cache->wanted.topology = topology;
+    state_cache_mark(cache, STATE_CACHE_PRIMITIVE_TOPOLOGY, changed, 0);
+}
+
+inline void
+state_cache_ia_set_vertex_buffer(state_cache *cache, uint32_t slot, void *buffer, uint32_t stride, uint32_t offset)
+{
+    state_cache_state *wanted = &cache->wanted;
+    bool changed = wanted->vertex_buffers[slot] != buffer || wanted->vertex_strides[slot] != stride || wanted->vertex_offsets[slot] != offset;
+    wanted->vertex_buffers[slot] = buffer;
+    wanted->vertex_strides[slot] = stride;
+    wanted->vertex_offsets[slot] = offset;
+    state_cache_mark(cache, STATE_CACHE_VERTEX_BUFFERS, changed, slot);
+}
+
+// format is a DXGI_FORMAT
+inline void
+state_cache_ia_set_index_buffer(state_cache *cache, void *buffer, uint32_t format, uint32_t offset)
+{
+    state_cache_state *wanted = &cache->wanted;
+    bool changed = wanted->index_buffer != buffer || wanted->index_format != format || wanted->index_offset != offset;
+    wanted->index_buffer = buffer;
+    wanted->index_format = format;
+    wanted->index_offset = offset;
+    state_cache_mark(cache, STATE_CACHE_INDEX_BUFFER, changed, 0);
+}
+
+inline void
+state_cache_set_shader(state_cache *cache, state_cache_stage stage, void *shader)
+{
+    bool changed = cache->wanted.stages[stage].shader != shader;
+    cache->wanted.stages[stage].shader = shader;
+    state_cache_mark(cache, (int)STATE_CACHE_SHADER + stage, changed, 0);
+}
+
+// constant_count 0 binds the whole buffer, anything else is a d3d11.1 offset binding in
+// 16 byte constants
+inline void
+state_cache_set_constant_buffer(state_cache *cache, state_cache_stage stage, uint32_t slot, void *buffer, uint32_t first_constant = 0,
+    uint32_t constant_count = 0)
+{
+    state_cache_stage_state *wanted = &cache->wanted.stages[stage];
+    bool changed = wanted->constant_buffers[slot] != buffer || wanted->first_constants[slot] != first_constant ||
+        wanted->constant_counts[slot] != constant_count;
+    wanted->constant_buffers[slot] = buffer;
+    wanted->first_constants[slot] = first_constant;
+    wanted->constant_counts[slot] = constant_count;
+    state_cache_mark(cache, (int)STATE_CACHE_CONSTANT_BUFFERS + stage, changed, slot);
+}
+
+inline void
+state_cache_set_shader_resource(state_cache *cache, state_cache_stage stage, uint32_t slot, void *view)
+{
+    bool changed = cache->wanted.stages[stage].shader_resources[slot] != view;
+    cache->wanted.stages[stage].shader_resources[slot] = view;
+    state_cache_mark(cache, (int)STATE_CACHE_SHADER_RESOURCES + stage, changed, slot);
+}
+
+inline void
+state_cache_set_sampler(state_cache *cache, state_cache_stage stage, uint32_t slot, void *sampler)
+{
+    bool changed = cache->wanted.stages[stage].samplers[slot] != sampler;
+    cache->wanted.stages[stage].samplers[slot] = sampler;
+    state_cache_mark(cache, (int)STATE_CACHE_SAMPLERS + stage, changed, slot);
+}
+
+inline void state_cache_vs_set_shader(state_cache *cache, void *shader) { state_cache_set_shader(cache, STATE_CACHE_STAGE_VS, shader); }
+inline void state_cache_ps_set_shader(state_cache *cache, void *shader) { state_cache_set_shader(cache, STATE_CACHE_STAGE_PS, shader); }
+
+inline void
+state_cache_vs_set_constant_buffer(state_cache *cache, uint32_t slot, void *buffer, uint32_t first_constant = 0, uint32_t constant_count = 0)
+{
+    state_cache_set_constant_buffer(cache, STATE_CACHE_STAGE_VS, slot, buffer, first_constant, constant_count);
+}
+
+inline void
+state_cache_ps_set_constant_buffer(state_cache *cache, uint32_t slot, void *buffer, uint32_t first_constant = 0, uint32_t constant_count = 0)
+{
+    state_cache_set_constant_buffer(cache, STATE_CACHE_STAGE_PS, slot, buffer, first_constant, constant_count);
+}
+
+inline void
+state_cache_ps_set_shader_resource(state_cache *cache, uint32_t slot, void *view)
+{
+    state_cache_set_shader_resource(cache, STATE_CACHE_STAGE_PS, slot, view);
+}
+
+inline void
+state_cache_ps_set_sampler(state_cache *cache, uint32_t slot, void *sampler)
+{
+    state_cache_set_sampler(cache, STATE_CACHE_STAGE_PS, slot, sampler);
+}
+
+inline void
+state_cache_rs_set_viewports(state_cache *cache, uint32_t count, const state_cache_viewport *viewports)
+{
+    state_cache_state *wanted = &cache->wanted;
+    bool changed = wanted->viewport_count != count || memcmp(wanted->viewports, viewports, count * sizeof(*viewports)) != 0;
+    memcpy(wanted->viewports, viewports, count * sizeof(*viewports));
+    wanted->viewport_count = count;
+    state_cache_mark(cache, STATE_CACHE_VIEWPORTS, changed, 0);
+}
+
+// render targets and the depth stencil view go out together as one OMSetRenderTargets, with as
+// many render targets as the highest non null slot
+inline void
+state_cache_om_set_render_target(state_cache *cache, uint32_t slot, void *view)
+{
+    bool changed = cache->wanted.render_targets[slot] != view;
+    cache->wanted.render_targets[slot] = view;
+    state_cache_mark(cache, STATE_CACHE_RENDER_TARGETS, changed, 0);
+}
+
+inline void
+state_cache_om_set_depth_stencil_view(state_cache *cache, void *view)
+{
+    bool changed = cache->wanted.depth_stencil_view != view;
+    cache->wanted.depth_stencil_view = view;
+    state_cache_mark(cache, STATE_CACHE_RENDER_TARGETS, changed, 0);
+}
+
+inline void
+state_cache_om_set_depth_stencil_state(state_cache *cache, void *state, uint32_t stencil_ref)
+{
+    bool changed = cache->wanted.depth_stencil_state != state || cache->wanted.stencil_ref != stencil_ref;
+    cache->wanted.depth_stencil_state = state;
+    cache->wanted.stencil_ref = stencil_ref;
+    state_cache_mark(cache, STATE_CACHE_DEPTH_STENCIL_STATE, changed, 0);
+}
+
+// flush
+
+// narrows [*first, *end) to the slots where differs(slot) is true, empty when it never is
+template <typename differs_fn>
+inline void
+state_cache_trim(uint32_t *first, uint32_t *end, differs_fn differs)
+{
+    while (*first < *end && differs(*first) == false)
+        (*first)++;
+    while (*end > *first && differs(*end - 1) == false)
+        (*end)--;
+}
+
+// sends one category to the backend, returns false when there was nothing to send
+inline bool
+state_cache_flush_category(state_cache *cache, int category)
+{
+    const state_cache_dirty *dirty = &cache->dirty[category];
+    state_cache_state *wanted = &cache->wanted;
+    state_cache_state *bound = &cache->bound;
+    const state_cache_backend *backend = &cache->backend;
+    bool unknown = (cache->unknown_mask & (1u << category)) != 0;
+    uint32_t first = dirty->first;
+    uint32_t end = dirty->end;
+
+    switch (category)
+    {
+        case STATE_CACHE_INPUT_LAYOUT:
+            if (unknown == false && wanted->input_layout == bound->input_layout)
+                return false;
+            backend->set_input_layout(backend->user, wanted->input_layout);
+            bound->input_layout = wanted->input_layout;
+            return true;
+
+        case STATE_CACHE_PRIMITIVE_TOPOLOGY:
+            if (unknown == false && wanted->topology == bound->topology)
+                return false;
+            backend->set_primitive_topology(backend->user, wanted->topology);
+            bound->topology = wanted->topology;
+            return true;
+
+        case STATE_CACHE_VERTEX_BUFFERS:
+            if (unknown == false)
+            {
+                state_cache_trim(&first, &end, [&](uint32_t slot) {
+                    return wanted->vertex_buffers[slot] != bound->vertex_buffers[slot] ||
+                        wanted->vertex_strides[slot] != bound->vertex_strides[slot] ||
+                        wanted->vertex_offsets[slot] != bound->vertex_offsets[slot];
+                });
+            }
+            if (first == end)
+                return false;
+            backend->set_vertex_buffers(backend->user, first, end - first, wanted->vertex_buffers + first, wanted->vertex_strides + first,
+                wanted->vertex_offsets + first);
+            memcpy(bound->vertex_buffers + first, wanted->vertex_buffers + first, (end - first) * sizeof(void *));
+            memcpy(bound->vertex_strides + first, wanted->vertex_strides + first, (end - first) * sizeof(uint32_t));
+            memcpy(bound->vertex_offsets + first, wanted->vertex_offsets + first, (end - first) * sizeof(uint32_t));
+            return true;
+
+        case STATE_CACHE_INDEX_BUFFER:
+            if (unknown == false && wanted->index_buffer == bound->index_buffer && wanted->index_format == bound->index_format &&
+                wanted->index_offset == bound->index_offset)
+                return false;
+            backend->set_index_buffer(backend->user, wanted->index_buffer, wanted->index_format, wanted->index_offset);
+            bound->index_buffer = wanted->index_buffer;
+            bound->index_format = wanted->index_format;
+            bound->index_offset = wanted->index_offset;
+            return true;
+
+        case STATE_CACHE_VIEWPORTS:
+            if (unknown == false && wanted->viewport_count == bound->viewport_count &&
+                memcmp(wanted->viewports, bound->viewports, wanted->viewport_count * sizeof(state_cache_viewport)) == 0)
+                return false;
+            backend->set_viewports(backend->user, wanted->viewport_count, wanted->viewports);
+            memcpy(bound->viewports, wanted->viewports, sizeof(wanted->viewports));
+            bound->viewport_count = wanted->viewport_count;
+            return true;
+
+        case STATE_CACHE_RENDER_TARGETS:
+        {
+            if (unknown == false && wanted->depth_stencil_view == bound->depth_stencil_view &&
+                memcmp(wanted->render_targets, bound->render_targets, sizeof(wanted->render_targets)) == 0)
+                return false;
+            uint32_t count = STATE_CACHE_RENDER_TARGET_SLOTS;
+            while (count > 0 && wanted->render_targets[count - 1] == nullptr)
+                count--;
+            backend->set_render_targets(backend->user, count, wanted->render_targets, wanted->depth_stencil_view);
+            memcpy(bound->render_targets, wanted->render_targets, sizeof(wanted->render_targets));
+            bound->depth_stencil_view = wanted->depth_stencil_view;
+            return true;
+        }
+
+        case STATE_CACHE_DEPTH_STENCIL_STATE:
+            if (unknown == false && wanted->depth_stencil_state == bound->depth_stencil_state && wanted->stencil_ref == bound->stencil_ref)
+                return false;
+            backend->set_depth_stencil_state(backend->user, wanted->depth_stencil_state, wanted->stencil_ref);
+            bound->depth_stencil_state = wanted->depth_stencil_state;
+            bound->stencil_ref = wanted->stencil_ref;
+            return true;
+    }
+
+    if (category >= STATE_CACHE_SHADER && category < STATE_CACHE_CONSTANT_BUFFERS)
+    {
+        state_cache_stage stage = (state_cache_stage)(category - STATE_CACHE_SHADER);
+        if (unknown == false && wanted->stages[stage].shader == bound->stages[stage].shader)
+            return false;
+        backend->set_shader(backend->user, stage, wanted->stages[stage].shader);
+        bound->stages[stage].shader = wanted->stages[stage].shader;
+        return true;
+    }
+
+    if (category >= STATE_CACHE_CONSTANT_BUFFERS && category < STATE_CACHE_SHADER_RESOURCES)
+    {
+        state_cache_stage stage = (state_cache_stage)(category - STATE_CACHE_CONSTANT_BUFFERS);
+        state_cache_stage_state *w = &wanted->stages[stage];
+        state_cache_stage_state *b = &bound->stages[stage];
+        if (unknown == false)
+        {
+            state_cache_trim(&first, &end, [&](uint32_t slot) {
+                return w->constant_buffers[slot] != b->constant_buffers[slot] || w->first_constants[slot] != b->first_constants[slot] ||
+                    w->constant_counts[slot] != b->constant_counts[slot];
+            });
+        }
+        if (first == end)
+            return false;
+
+        bool whole = true;
+        for (uint32_t slot = first; slot < end; ++slot)
+            whole = whole && w->constant_counts[slot] == 0;
+        backend->set_constant_buffers(backend->user, stage, first, end - first, w->constant_buffers + first,
+            whole ? nullptr : w->first_constants + first, whole ? nullptr : w->constant_counts + first);
+        memcpy(b->constant_buffers + first, w->constant_buffers + first, (end - first) * sizeof(void *));
+        memcpy(b->first_constants + first, w->first_constants + first, (end - first) * sizeof(uint32_t));
+        memcpy(b->constant_counts + first, w->constant_counts + first, (end - first) * sizeof(uint32_t));
+        return true;
+    }
+
+    if (category >= STATE_CACHE_SHADER_RESOURCES && category < STATE_CACHE_SAMPLERS)
+    {
+        state_cache_stage stage = (state_cache_stage)(category - STATE_CACHE_SHADER_RESOURCES);
+        void **w = wanted->stages[stage].shader_resources;
+        void **b = bound->stages[stage].shader_resources;
+        if (unknown == false)
+            state_cache_trim(&first, &end, [&](uint32_t slot) { return w[slot] != b[slot]; });
+        if (first == end)
+            return false;
+        backend->set_shader_resources(backend->user, stage, first, end - first, w + first);
+        memcpy(b + first, w + first, (end - first) * sizeof(void *));
+        return true;
+    }
+
+    state_cache_stage stage = (state_cache_stage)(category - STATE_CACHE_SAMPLERS);
+    void **w = wanted->stages[stage].samplers;
+    void **b = bound->stages[stage].samplers;
+    if (unknown == false)
+        state_cache_trim(&first, &end, [&](uint32_t slot) { return w[slot] != b[slot]; });
+    if (first == end)
+        return false;
+    backend->set_samplers(backend->user, stage, first, end - first, w + first);
+    memcpy(b + first, w + first, (end - first) * sizeof(void *));
+    return true;
+}
+
+// sends every dirty category, draws call it before they go to the backend
+inline void
+state_cache_flush(state_cache *cache)
+{
+    while (cache->dirty_mask)
+    {
+        int category = 0;
+        while ((cache->dirty_mask & (1u << category)) == 0)
+            category++;
+
+        uint32_t changes = cache->dirty[category].changes;
+        if (state_cache_flush_category(cache, category))
+        {
+            if (changes == 0)
+            {
+                cache->stats.rebinds++;
+            }
+            else
+            {
+                cache->stats.issued_calls++;
+                cache->stats.merged_calls += changes - 1;
+            }
+        }
+        else
+        {
+            cache->stats.elided_calls += changes;
+        }
+
+        cache->dirty[category].changes = 0;
+        cache->dirty_mask &= ~(1u << category);
+        cache->unknown_mask &= ~(1u << category);
+    }
+}
+
+// draws
+
+inline void
+state_cache_draw(state_cache *cache, uint32_t vertex_count, uint32_t start_vertex)
+{
+    state_cache_flush(cache);
+    cache->stats.draws++;
+    cache->backend.draw(cache->backend.user, vertex_count, start_vertex);
+}
+
+inline void
+state_cache_draw_indexed(state_cache *cache, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    state_cache_flush(cache);
+    cache->stats.draws++;
+    cache->backend.draw_indexed(cache->backend.user, index_count, start_index, base_vertex);
+}
+
+inline void
+state_cache_draw_indexed_instanced(state_cache *cache, uint32_t index_count, uint32_t instance_count, uint32_t start_index,
+    int32_t base_vertex, uint32_t start_instance)
+{
+    state_cache_flush(cache);
+    cache->stats.draws++;
+    cache->backend.draw_indexed_instanced(cache->backend.user, index_count, instance_count, start_index, base_vertex, start_instance);
+}
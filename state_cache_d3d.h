@@ -0,0 +1,168 @@
+#pragma once
+
+#include <d3d11_1.h>
+
+#include "state_cache.h"
+
+// state_cache backend driving an ID3D11DeviceContext. offset constant buffer bindings need
+// context1, the ID3D11DeviceContext1 of the same context, it may be null otherwise.
+
+struct state_cache_d3d
+{
+    ID3D11DeviceContext *context;
+    ID3D11DeviceContext1 *context1;
+};
+
+inline void
+state_cache_d3d_set_input_layout(void *user, void *input_layout)
+{
+    ((state_cache_d3d *)user)->context->IASetInputLayout((ID3D11InputLayout *)input_layout);
+}
+
+inline void
+state_cache_d3d_set_primitive_topology(void *user, uint32_t topology)
+{
+    ((state_cache_d3d *)user)->context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+inline void
+state_cache_d3d_set_vertex_buffers(void *user, uint32_t start_slot, uint32_t count, void *const *buffers, const uint32_t *strides,
+    const uint32_t *offsets)
+{
+    ((state_cache_d3d *)user)->context->IASetVertexBuffers(start_slot, count, (ID3D11Buffer *const *)buffers, strides, offsets);
+}
+
+inline void
+state_cache_d3d_set_index_buffer(void *user, void *buffer, uint32_t format, uint32_t offset)
+{
+    ((state_cache_d3d *)user)->context->IASetIndexBuffer((ID3D11Buffer *)buffer, (DXGI_FORMAT)format, offset);
+}
+
+inline void
+state_cache_d3d_set_shader(void *user, state_cache_stage stage, void *shader)
+{
+    ID3D11DeviceContext *context = ((state_cache_d3d *)user)->context;
+    if (stage == STATE_CACHE_STAGE_VS)
+        context->VSSetShader((ID3D11VertexShader *)shader, nullptr, 0);
+    else
+        context->PSSetShader((ID3D11PixelShader *)shader, nullptr, 0);
+}
+
+// whole buffers mixed with offset bindings in one range go out as the first 4096 constants,
+// the most a whole binding can hold
+inline void
+state_cache_d3d_set_constant_buffers(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *buffers,
+    const uint32_t *first_constants, const uint32_t *constant_counts)
+{
+    state_cache_d3d *d3d = (state_cache_d3d *)user;
+    ID3D11Buffer *const *d3d_buffers = (ID3D11Buffer *const *)buffers;
+    if (constant_counts == nullptr || d3d->context1 == nullptr)
+    {
+        if (stage == STATE_CACHE_STAGE_VS)
+            d3d->context->VSSetConstantBuffers(start_slot, count, d3d_buffers);
+        else
+            d3d->context->PSSetConstantBuffers(start_slot, count, d3d_buffers);
+        return;
+    }
+
+    UINT firsts[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    UINT counts[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        firsts[i] = constant_counts[i] ? first_constants[i] : 0;
+        counts[i] = constant_counts[i] ? constant_counts[i] : D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT;
+    }
+    if (stage == STATE_CACHE_STAGE_VS)
+        d3d->context1->VSSetConstantBuffers1(start_slot, count, d3d_buffers, firsts, counts);
+    else
+        d3d->context1->PSSetConstantBuffers1(start_slot, count, d3d_buffers, firsts, counts);
+}
+
+inline void
+state_cache_d3d_set_shader_resources(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *views)
+{
+    ID3D11DeviceContext *context = ((state_cache_d3d *)user)->context;
+    if (stage == STATE_CACHE_STAGE_VS)
+        context->VSSetShaderResources(start_slot, count, (ID3D11ShaderResourceView *const *)views);
+    else
+        context->PSSetShaderResources(start_slot, count, (ID3D11ShaderResourceView *const *)views);
+}
+
+inline void
+state_cache_d3d_set_samplers(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *samplers)
+{
+    ID3D11DeviceContext *context = ((state_cache_d3d *)user)->context;
+    if (stage == STATE_CACHE_STAGE_VS)
+        context->VSSetSamplers(start_slot, count, (ID3D11SamplerState *const *)samplers);
+    else
+        context->PSSetSamplers(start_slot, count, (ID3D11SamplerState *const *)samplers);
+}
+
+static_assert(sizeof(state_cache_viewport) == sizeof(D3D11_VIEWPORT), "viewport layouts differ");
+
+inline void
+state_cache_d3d_set_viewports(void *user, uint32_t count, const state_cache_viewport *viewports)
+{
+    ((state_cache_d3d *)user)->context->RSSetViewports(count, (const D3D11_VIEWPORT *)viewports);
+}
+
+inline void
+state_cache_d3d_set_render_targets(void *user, uint32_t count, void *const *views, void *depth_stencil_view)
+{
+    ((state_cache_d3d *)user)->context->OMSetRenderTargets(count, (ID3D11RenderTargetView *const *)views,
+        (ID3D11DepthStencilView *)depth_stencil_view);
+}
+
+inline void
+state_cache_d3d_set_depth_stencil_state(void *user, void *state, uint32_t stencil_ref)
+{
+    ((state_cache_d3d *)user)->context->OMSetDepthStencilState((ID3D11DepthStencilState *)state, stencil_ref);
+}
+
+inline void
+state_cache_d3d_draw(void *user, uint32_t vertex_count, uint32_t start_vertex)
+{
+    ((state_cache_d3d *)user)->context->Draw(vertex_count, start_vertex);
+}
+
+inline void
+state_cache_d3d_draw_indexed(void *user, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    ((state_cache_d3d *)user)->context->DrawIndexed(index_count, start_index, base_vertex);
+}
+
+inline void
+state_cache_d3d_draw_indexed_instanced(void *user, uint32_t index_count, uint32_t instance_count, uint32_t start_index,
+    int32_t base_vertex, uint32_t start_instance)
+{
+    ((state_cache_d3d *)user)->context->DrawIndexedInstanced(index_count, instance_count, start_index, base_vertex, start_instance);
+}
+
+inline state_cache_backend
+state_cache_backend_d3d(state_cache_d3d *d3d)
+{
+    state_cache_backend backend = {};
+    backend.user = d3d;
+    backend.set_input_layout = state_cache_d3d_set_input_layout;
+    backend.set_primitive_topology = state_cache_d3d_set_primitive_topology;
+    backend.set_vertex_buffers = state_cache_d3d_set_vertex_buffers;
+    backend.set_index_buffer = state_cache_d3d_set_index_buffer;
+    backend.set_shader = state_cache_d3d_set_shader;
+    backend.set_constant_buffers = state_cache_d3d_set_constant_buffers;
+    backend.set_shader_resources = state_cache_d3d_set_shader_resources;
+    backend.set_samplers = state_cache_d3d_set_samplers;
+    backend.set_viewports = state_cache_d3d_set_viewports;
+    backend.set_render_targets = state_cache_d3d_set_render_targets;
+    backend.set_depth_stencil_state = state_cache_d3d_set_depth_stencil_state;
+    backend.draw = state_cache_d3d_draw;
+    backend.draw_indexed = state_cache_d3d_draw_indexed;
+    backend.draw_indexed_instanced = state_cache_d3d_draw_indexed_instanced;
+    return backend;
+}
+
+// lets callers pass D3D11_VIEWPORT as is
+inline void
+state_cache_rs_set_viewports(state_cache *cache, uint32_t count, const D3D11_VIEWPORT *viewports)
+{
+    state_cache_rs_set_viewports(cache, count, (const state_cache_viewport *)viewports);
+}
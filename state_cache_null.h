@@ -0,0 +1,178 @@
+#pragma once
+
+#include "null_device.h"
+#include "state_cache.h"
+
+// state_cache backend driving null_device.h. null handles travel through the cache as
+// pointers, state_cache_null_object and state_cache_null_handle convert between the two.
+
+inline void *
+state_cache_null_object(null_handle handle)
+{
+    return (void *)(uintptr_t)handle;
+}
+
+inline null_handle
+state_cache_null_handle(void *object)
+{
+    return (null_handle)(uintptr_t)object;
+}
+
+inline void
+state_cache_null_set_input_layout(void *user, void *input_layout)
+{
+    null_ia_set_input_layout((null_device *)user, state_cache_null_handle(input_layout));
+}
+
+inline void
+state_cache_null_set_primitive_topology(void *user, uint32_t topology)
+{
+    null_ia_set_primitive_topology((null_device *)user, (null_topology)topology);
+}
+
+inline void
+state_cache_null_set_vertex_buffers(void *user, uint32_t start_slot, uint32_t count, void *const *buffers, const uint32_t *strides,
+    const uint32_t *offsets)
+{
+    null_handle handles[STATE_CACHE_VERTEX_BUFFER_SLOTS];
+    for (uint32_t i = 0; i < count; ++i)
+        handles[i] = state_cache_null_handle(buffers[i]);
+    null_ia_set_vertex_buffers((null_device *)user, start_slot, count, handles, strides, offsets);
+}
+
+inline void
+state_cache_null_set_index_buffer(void *user, void *buffer, uint32_t format, uint32_t offset)
+{
+    null_ia_set_index_buffer((null_device *)user, state_cache_null_handle(buffer), (null_index_format)format, offset);
+}
+
+inline void
+state_cache_null_set_shader(void *user, state_cache_stage stage, void *shader)
+{
+    if (stage == STATE_CACHE_STAGE_VS)
+        null_vs_set_shader((null_device *)user, state_cache_null_handle(shader));
+    else
+        null_ps_set_shader((null_device *)user, state_cache_null_handle(shader));
+}
+
+// whole buffers mixed with offset bindings in one range go out as the first 4096 constants
+inline void
+state_cache_null_set_constant_buffers(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *buffers,
+    const uint32_t *first_constants, const uint32_t *constant_counts)
+{
+    null_handle handles[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    uint32_t firsts[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    uint32_t counts[STATE_CACHE_CONSTANT_BUFFER_SLOTS];
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        handles[i] = state_cache_null_handle(buffers[i]);
+        if (constant_counts)
+        {
+            firsts[i] = constant_counts[i] ? first_constants[i] : 0;
+            counts[i] = constant_counts[i] ? constant_counts[i] : NULL_MAX_CONSTANTS;
+        }
+    }
+
+    null_device *device = (null_device *)user;
+    if (stage == STATE_CACHE_STAGE_VS)
+        null_vs_set_constant_buffers(device, start_slot, count, handles, constant_counts ? firsts : nullptr, constant_counts ? counts : nullptr);
+    else
+        null_ps_set_constant_buffers(device, start_slot, count, handles, constant_counts ? firsts : nullptr, constant_counts ? counts : nullptr);
+}
+
+// the null device only has pixel shader resources and samplers
+inline void
+state_cache_null_set_shader_resources(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *views)
+{
+    null_device *device = (null_device *)user;
+    if (stage != STATE_CACHE_STAGE_PS)
+    {
+        null_error(device, "VSSetShaderResources: not supported");
+        return;
+    }
+
+    null_handle handles[STATE_CACHE_SHADER_RESOURCE_SLOTS];
+    for (uint32_t i = 0; i < count; ++i)
+        handles[i] = state_cache_null_handle(views[i]);
+    null_ps_set_shader_resources(device, start_slot, count, handles);
+}
+
+inline void
+state_cache_null_set_samplers(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *samplers)
+{
+    null_device *device = (null_device *)user;
+    if (stage != STATE_CACHE_STAGE_PS)
+    {
+        null_error(device, "VSSetSamplers: not supported");
+        return;
+    }
+
+    null_handle handles[STATE_CACHE_SAMPLER_SLOTS];
+    for (uint32_t i = 0; i < count; ++i)
+        handles[i] = state_cache_null_handle(samplers[i]);
+    null_ps_set_samplers(device, start_slot, count, handles);
+}
+
+static_assert(sizeof(state_cache_viewport) == sizeof(null_viewport), "viewport layouts differ");
+
+inline void
+state_cache_null_set_viewports(void *user, uint32_t count, const state_cache_viewport *viewports)
+{
+    null_rs_set_viewports((null_device *)user, count, (const null_viewport *)viewports);
+}
+
+inline void
+state_cache_null_set_render_targets(void *user, uint32_t count, void *const *views, void *depth_stencil_view)
+{
+    null_handle handles[STATE_CACHE_RENDER_TARGET_SLOTS];
+    for (uint32_t i = 0; i < count; ++i)
+        handles[i] = state_cache_null_handle(views[i]);
+    null_om_set_render_targets((null_device *)user, count, handles, state_cache_null_handle(depth_stencil_view));
+}
+
+inline void
+state_cache_null_set_depth_stencil_state(void *user, void *state, uint32_t stencil_ref)
+{
+    null_om_set_depth_stencil_state((null_device *)user, state_cache_null_handle(state), stencil_ref);
+}
+
+inline void
+state_cache_null_draw(void *user, uint32_t vertex_count, uint32_t start_vertex)
+{
+    null_draw((null_device *)user, vertex_count, start_vertex);
+}
+
+inline void
+state_cache_null_draw_indexed(void *user, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    null_draw_indexed((null_device *)user, index_count, start_index, base_vertex);
+}
+
+inline void
+state_cache_null_draw_indexed_instanced(void *user, uint32_t index_count, uint32_t instance_count, uint32_t start_index,
+    int32_t base_vertex, uint32_t start_instance)
+{
+    null_draw_indexed_instanced((null_device *)user, index_count, instance_count, start_index, base_vertex, start_instance);
+}
+
+inline state_cache_backend
+state_cache_backend_null(null_device *device)
+{
+    state_cache_backend backend = {};
+    backend.user = device;
+    backend.set_input_layout = state_cache_null_set_input_layout;
+    backend.set_primitive_topology = state_cache_null_set_primitive_topology;
+    backend.set_vertex_buffers = state_cache_null_set_vertex_buffers;
+    backend.set_index_buffer = state_cache_null_set_index_buffer;
+    backend.set_shader = state_cache_null_set_shader;
+    backend.set_constant_buffers = state_cache_null_set_constant_buffers;
+    backend.set_shader_resources = state_cache_null_set_shader_resources;
+    backend.set_samplers = state_cache_null_set_samplers;
+    backend.set_viewports = state_cache_null_set_viewports;
+    backend.set_render_targets = state_cache_null_set_render_targets;
+    backend.set_depth_stencil_state = state_cache_null_set_depth_stencil_state;
+    backend.draw = state_cache_null_draw;
+    backend.draw_indexed = state_cache_null_draw_indexed;
+    backend.draw_indexed_instanced = state_cache_null_draw_indexed_instanced;
+    return backend;
+}
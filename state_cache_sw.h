@@ -0,0 +1,153 @@
+#pragma once
+
+#include "state_cache.h"
+#include "sw_raster.h"
+
+// state_cache backend driving the software rasterizer in sw_raster.h. objects are plain
+// pointers to what sw_raster works on:
+// - buffers point at their data in memory, index buffers hold R32_UINT indices
+// - pixel shaders point at a sw_pixel_shader, vertex shaders are ignored (sw_raster has the
+//   one fixed transform)
+// - render target views point at a sw_render_target, which carries its own depth so the
+//   depth stencil view is ignored
+// - depth stencil states point at a state_cache_sw_depth_state
+// vertex buffer slot 1 is the instance stream, input layouts, topologies, shader resources
+// and samplers have no sw_raster counterpart and are ignored.
+
+struct state_cache_sw_depth_state
+{
+    bool enable;
+    bool write;
+    sw_comparison func;
+};
+
+inline void
+state_cache_sw_set_input_layout(void *user, void *input_layout)
+{
+}
+
+inline void
+state_cache_sw_set_primitive_topology(void *user, uint32_t topology)
+{
+}
+
+inline void
+state_cache_sw_set_vertex_buffers(void *user, uint32_t start_slot, uint32_t count, void *const *buffers, const uint32_t *strides,
+    const uint32_t *offsets)
+{
+    sw_context *ctx = (sw_context *)user;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (start_slot + i == 0)
+            sw_ia_set_vertex_buffer(ctx, buffers[i], strides[i], offsets[i]);
+        else if (start_slot + i == 1)
+            sw_ia_set_instance_buffer(ctx, buffers[i], strides[i], offsets[i]);
+    }
+}
+
+inline void
+state_cache_sw_set_index_buffer(void *user, void *buffer, uint32_t format, uint32_t offset)
+{
+    sw_ia_set_index_buffer((sw_context *)user, (const uint32_t *)buffer, offset);
+}
+
+inline void
+state_cache_sw_set_shader(void *user, state_cache_stage stage, void *shader)
+{
+    if (stage == STATE_CACHE_STAGE_PS)
+        sw_ps_set_shader((sw_context *)user, shader ? *(const sw_pixel_shader *)shader : nullptr);
+}
+
+// offset bindings point the stage at the first constant
+inline void
+state_cache_sw_set_constant_buffers(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *buffers,
+    const uint32_t *first_constants, const uint32_t *constant_counts)
+{
+    sw_context *ctx = (sw_context *)user;
+    for (uint32_t i = 0; i < count && start_slot + i < SW_MAX_CONSTANT_BUFFERS; ++i)
+    {
+        const uint8_t *data = (const uint8_t *)buffers[i];
+        if (data && first_constants)
+            data += (size_t)first_constants[i] * 16;
+        if (stage == STATE_CACHE_STAGE_VS)
+            sw_vs_set_constant_buffer(ctx, (int)(start_slot + i), data);
+        else
+            sw_ps_set_constant_buffer(ctx, (int)(start_slot + i), data);
+    }
+}
+
+inline void
+state_cache_sw_set_shader_resources(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *views)
+{
+}
+
+inline void
+state_cache_sw_set_samplers(void *user, state_cache_stage stage, uint32_t start_slot, uint32_t count, void *const *samplers)
+{
+}
+
+static_assert(sizeof(state_cache_viewport) == sizeof(sw_viewport), "viewport layouts differ");
+
+inline void
+state_cache_sw_set_viewports(void *user, uint32_t count, const state_cache_viewport *viewports)
+{
+    if (count)
+        sw_rs_set_viewport((sw_context *)user, (const sw_viewport *)viewports);
+}
+
+inline void
+state_cache_sw_set_render_targets(void *user, uint32_t count, void *const *views, void *depth_stencil_view)
+{
+    sw_om_set_render_target((sw_context *)user, count ? (sw_render_target *)views[0] : nullptr);
+}
+
+inline void
+state_cache_sw_set_depth_stencil_state(void *user, void *state, uint32_t stencil_ref)
+{
+    const state_cache_sw_depth_state *depth = (const state_cache_sw_depth_state *)state;
+    if (depth)
+        sw_om_set_depth_state((sw_context *)user, depth->enable, depth->write, depth->func);
+    else
+        sw_om_set_depth_state((sw_context *)user, true, true, SW_COMPARISON_LESS);
+}
+
+// sw_raster only has indexed draws
+inline void
+state_cache_sw_draw(void *user, uint32_t vertex_count, uint32_t start_vertex)
+{
+}
+
+inline void
+state_cache_sw_draw_indexed(void *user, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    sw_draw_indexed((sw_context *)user, index_count, start_index, base_vertex);
+}
+
+inline void
+state_cache_sw_draw_indexed_instanced(void *user, uint32_t index_count, uint32_t instance_count, uint32_t start_index,
+    int32_t base_vertex, uint32_t start_instance)
+{
+    sw_draw_indexed_instanced((sw_context *)user, index_count, instance_count, start_index, base_vertex, start_instance);
+}
+
+inline state_cache_backend
+state_cache_backend_sw(sw_context *ctx)
+{
+    state_cache_backend backend = {};
+    backend.user = ctx;
+    backend.set_input_layout = state_cache_sw_set_input_layout;
+    backend.set_primitive_topology = state_cache_sw_set_primitive_topology;
+    backend.set_vertex_buffers = state_cache_sw_set_vertex_buffers;
+    backend.set_index_buffer = state_cache_sw_set_index_buffer;
+    backend.set_shader = state_cache_sw_set_shader;
+    backend.set_constant_buffers = state_cache_sw_set_constant_buffers;
+    backend.set_shader_resources = state_cache_sw_set_shader_resources;
+    backend.set_samplers = state_cache_sw_set_samplers;
+    backend.set_viewports = state_cache_sw_set_viewports;
+    backend.set_render_targets = state_cache_sw_set_render_targets;
+    backend.set_depth_stencil_state = state_cache_sw_set_depth_stencil_state;
+    backend.draw = state_cache_sw_draw;
+    backend.draw_indexed = state_cache_sw_draw_indexed;
+    backend.draw_indexed_instanced = state_cache_sw_draw_indexed_instanced;
+    return backend;
+}
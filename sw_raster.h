@@ -0,0 +1,789 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "profile.h"
+#include "thread_pool.h"
+
+// software rasterizer backend, it mirrors the subset of the d3d11 pipeline the examples use:
+// - float3 positions at offset 0 of the vertex stream, transformed by the float4x4 in vs
+//   constant buffer 0, stored transposed exactly like the examples memcpy it into the cbuffer.
+//   instanced draws read that matrix from the start of each element of the instance stream
+// - flat pixel shading, the pixel shader runs once per primitive (SV_PrimitiveID,
+//   SV_InstanceID and cbuffers)
+// - back face culling with clockwise front faces, top-left fill rule, depth test
+//
+// draws are transformed, clipped and set up immediately so constant buffers can be
+// rewritten between draws (map discard semantics). sw_flush bins the triangles into
+// SW_TILE_SIZE screen tiles and rasterizes the tiles in parallel, every tile walks its
+// triangles in submission order so the output matches an in-order gpu.
+
+#define SW_TILE_SIZE 64
+#define SW_SUBPIXEL_BITS 8
+#define SW_SUBPIXEL_ONE (1 << SW_SUBPIXEL_BITS)
+#define SW_MAX_CONSTANT_BUFFERS 4
+// triangles binned by one task at flush time
+#define SW_BIN_CHUNK_SIZE 1024
+// instances set up by one task in instanced draws
+#define SW_INSTANCE_CHUNK_SIZE 256
+
+enum sw_comparison
+{
+    SW_COMPARISON_NEVER,
+    SW_COMPARISON_LESS,
+    SW_COMPARISON_LESS_EQUAL,
+    SW_COMPARISON_ALWAYS,
+};
+
+enum sw_cull_mode
+{
+    SW_CULL_NONE,
+    SW_CULL_FRONT,
+    SW_CULL_BACK,
+};
+
+struct sw_float4
+{
+    float x, y, z, w;
+};
+
+struct sw_viewport
+{
+    float top_left_x;
+    float top_left_y;
+    float width;
+    float height;
+    float min_depth;
+    float max_depth;
+};
+
+// color is R8G8B8A8_UNORM, depth is D32_FLOAT
+struct sw_render_target
+{
+    int width;
+    int height;
+    uint32_t *color;
+    float *depth;
+};
+
+struct sw_pixel_input
+{
+    uint32_t primitive_id;
+    uint32_t instance_id;
+};
+
+typedef sw_float4 (*sw_pixel_shader)(const sw_pixel_input *input, const void *const *constant_buffers);
+
+struct sw_clip_vertex
+{
+    float x, y, z, w;
+};
+
+struct sw_triangle
+{
+    // vertices in SW_SUBPIXEL_BITS fixed point screen space, clockwise
+    int32_t x0, y0, x1, y1, x2, y2;
+    // inclusive pixel bounds clamped to the viewport
+    int32_t min_x, min_y, max_x, max_y;
+    // depth at the center of pixel (0, 0) and its screen space gradients
+    float z, dzdx, dzdy;
+    uint32_t color;
+    uint16_t depth_func;
+    uint16_t depth_write;
+};
+
+struct sw_stats
+{
+    uint64_t draws;
+    uint64_t triangles_in;
+    uint64_t triangles_culled;
+    uint64_t triangles_rasterized;
+    uint64_t tiles_touched;
+};
+
+// vertex and triangle setup output of one task of an instanced draw
+struct sw_draw_chunk
+{
+    std::vector<sw_clip_vertex> clip_vertices;
+    std::vector<sw_triangle> triangles;
+    sw_stats stats;
+};
+
+struct sw_context
+{
+    thread_pool *pool;
+
+    // input assembler
+    const uint8_t *vertex_buffer;
+    uint32_t vertex_stride;
+    const uint32_t *index_buffer;
+    const uint8_t *instance_buffer;
+    uint32_t instance_stride;
+
+    // shader stages
+    const void *vs_constant_buffers[SW_MAX_CONSTANT_BUFFERS];
+    const void *ps_constant_buffers[SW_MAX_CONSTANT_BUFFERS];
+    sw_pixel_shader pixel_shader;
+
+    // rasterizer
+    sw_viewport viewport;
+    sw_cull_mode cull_mode;
+
+    // output merger
+    sw_render_target *render_target;
+    sw_comparison depth_func;
+    bool depth_enable;
+    bool depth_write;
+
+    // pending work, consumed by sw_flush
+    std::vector<sw_clip_vertex> clip_vertices;
+    std::vector<sw_triangle> triangles;
+    std::vector<sw_draw_chunk> draw_chunks;
+    bool clear_color_pending;
+    uint32_t clear_color;
+    bool clear_depth_pending;
+    float clear_depth;
+
+    // bins[chunk * tile_count + tile] holds triangle indices in submission order
+    std::vector<std::vector<uint32_t>> bins;
+    int tiles_x;
+    int tiles_y;
+
+    sw_stats stats;
+};
+
+inline bool
+sw_render_target_init(sw_render_target *rt, int width, int height)
+{
+    rt->width = width;
+    rt->height = height;
+    rt->color = (uint32_t *)malloc((size_t)width * height * sizeof(uint32_t));
+    rt->depth = (float *)malloc((size_t)width * height * sizeof(float));
+    return rt->color != nullptr && rt->depth != nullptr;
+}
+
+inline void
+sw_render_target_free(sw_render_target *rt)
+{
+    free(rt->color);
+    free(rt->depth);
+    rt->color = nullptr;
+    rt->depth = nullptr;
+}
+
+inline uint32_t
+sw_pack_unorm8(sw_float4 c)
+{
+    auto to_unorm8 = [](float v) -> uint32_t {
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        return (uint32_t)(v * 255.0f + 0.5f);
+    };
+    return to_unorm8(c.x) | (to_unorm8(c.y) << 8) | (to_unorm8(c.z) << 16) | (to_unorm8(c.w) << 24);
+}
+
+inline void
+sw_context_init(sw_context *ctx, thread_pool *pool)
+{
+    ctx->pool = pool;
+    ctx->vertex_buffer = nullptr;
+    ctx->vertex_stride = 0;
+    ctx->index_buffer = nullptr;
+    ctx->instance_buffer = nullptr;
+    ctx->instance_stride = 0;
+    for (int i = 0; i < SW_MAX_CONSTANT_BUFFERS; ++i)
+    {
+        ctx->vs_constant_buffers[i] = nullptr;
+        ctx->ps_constant_buffers[i] = nullptr;
+    }
+    ctx->pixel_shader = nullptr;
+    ctx->viewport = {};
+    ctx->cull_mode = SW_CULL_BACK;
+    ctx->render_target = nullptr;
+    ctx->depth_func = SW_COMPARISON_LESS;
+    ctx->depth_enable = false;
+    ctx->depth_write = false;
+    ctx->clear_color_pending = false;
+    ctx->clear_color = 0;
+    ctx->clear_depth_pending = false;
+    ctx->clear_depth = 1.0f;
+    ctx->tiles_x = 0;
+    ctx->tiles_y = 0;
+    ctx->stats = {};
+}
+
+inline void
+sw_ia_set_vertex_buffer(sw_context *ctx, const void *data, uint32_t stride, uint32_t offset)
+{
+    ctx->vertex_buffer = (const uint8_t *)data + offset;
+    ctx->vertex_stride = stride;
+}
+
+inline void
+sw_ia_set_index_buffer(sw_context *ctx, const uint32_t *data, uint32_t offset)
+{
+    ctx->index_buffer = (const uint32_t *)((const uint8_t *)data + offset);
+}
+
+// every element of the instance stream starts with the instance's transposed mvp,
+// pass nullptr to unbind
+inline void
+sw_ia_set_instance_buffer(sw_context *ctx, const void *data, uint32_t stride, uint32_t offset)
+{
+    ctx->instance_buffer = data ? (const uint8_t *)data + offset : nullptr;
+    ctx->instance_stride = stride;
+}
+
+inline void
+sw_vs_set_constant_buffer(sw_context *ctx, int slot, const void *data)
+{
+    ctx->vs_constant_buffers[slot] = data;
+}
+
+inline void
+sw_ps_set_constant_buffer(sw_context *ctx, int slot, const void *data)
+{
+    ctx->ps_constant_buffers[slot] = data;
+}
+
+inline void
+sw_ps_set_shader(sw_context *ctx, sw_pixel_shader shader)
+{
+    ctx->pixel_shader = shader;
+}
+
+inline void
+sw_rs_set_viewport(sw_context *ctx, const sw_viewport *viewport)
+{
+    ctx->viewport = *viewport;
+}
+
+inline void
+sw_rs_set_cull_mode(sw_context *ctx, sw_cull_mode cull_mode)
+{
+    ctx->cull_mode = cull_mode;
+}
+
+inline void
+sw_om_set_depth_state(sw_context *ctx, bool enable, bool write, sw_comparison func)
+{
+    ctx->depth_enable = enable;
+    ctx->depth_write = write;
+    ctx->depth_func = func;
+}
+
+inline void sw_flush(sw_context *ctx);
+
+inline void
+sw_om_set_render_target(sw_context *ctx, sw_render_target *rt)
+{
+    if (ctx->render_target != rt)
+        sw_flush(ctx);
+    ctx->render_target = rt;
+}
+
+// clears are deferred and applied per tile right before the tile's triangles
+inline void
+sw_clear_render_target(sw_context *ctx, const float color[4])
+{
+    if (ctx->triangles.empty() == false)
+        sw_flush(ctx);
+    ctx->clear_color_pending = true;
+    ctx->clear_color = sw_pack_unorm8({color[0], color[1], color[2], color[3]});
+}
+
+inline void
+sw_clear_depth(sw_context *ctx, float depth)
+{
+    if (ctx->triangles.empty() == false)
+        sw_flush(ctx);
+    ctx->clear_depth_pending = true;
+    ctx->clear_depth = depth;
+}
+
+inline int32_t
+sw_min3(int32_t a, int32_t b, int32_t c)
+{
+    int32_t m = a < b ? a : b;
+    return m < c ? m : c;
+}
+
+inline int32_t
+sw_max3(int32_t a, int32_t b, int32_t c)
+{
+    int32_t m = a > b ? a : b;
+    return m > c ? m : c;
+}
+
+// snaps a screen space triangle, culls it and appends it to triangles
+inline void
+sw_setup_triangle(const sw_context *ctx, std::vector<sw_triangle> *triangles, sw_stats *stats,
+    const sw_clip_vertex *v0, const sw_clip_vertex *v1, const sw_clip_vertex *v2, uint32_t color)
+{
+    // screen space vertices, x/y already in pixels and z in depth range
+    int32_t x0 = (int32_t)lrintf(v0->x * SW_SUBPIXEL_ONE);
+    int32_t y0 = (int32_t)lrintf(v0->y * SW_SUBPIXEL_ONE);
+    int32_t x1 = (int32_t)lrintf(v1->x * SW_SUBPIXEL_ONE);
+    int32_t y1 = (int32_t)lrintf(v1->y * SW_SUBPIXEL_ONE);
+    int32_t x2 = (int32_t)lrintf(v2->x * SW_SUBPIXEL_ONE);
+    int32_t y2 = (int32_t)lrintf(v2->y * SW_SUBPIXEL_ONE);
+    float z0 = v0->z;
+    float z1 = v1->z;
+    float z2 = v2->z;
+
+    // positive area is clockwise on screen (y down), which d3d treats as front facing
+    int64_t area = (int64_t)(x1 - x0) * (y2 - y0) - (int64_t)(y1 - y0) * (x2 - x0);
+    if (area == 0 ||
+        (area < 0 && ctx->cull_mode == SW_CULL_BACK) ||
+        (area > 0 && ctx->cull_mode == SW_CULL_FRONT))
+    {
+        stats->triangles_culled++;
+        return;
+    }
+    if (area < 0)
+    {
+        int32_t t;
+        t = x1; x1 = x2; x2 = t;
+        t = y1; y1 = y2; y2 = t;
+        float tz = z1; z1 = z2; z2 = tz;
+        area = -area;
+    }
+
+    // clamp bounds to viewport and render target
+    const sw_viewport *vp = &ctx->viewport;
+    const sw_render_target *rt = ctx->render_target;
+    int32_t vp_min_x = (int32_t)floorf(vp->top_left_x);
+    int32_t vp_min_y = (int32_t)floorf(vp->top_left_y);
+    int32_t vp_max_x = (int32_t)ceilf(vp->top_left_x + vp->width) - 1;
+    int32_t vp_max_y = (int32_t)ceilf(vp->top_left_y + vp->height) - 1;
+    if (vp_min_x < 0) vp_min_x = 0;
+    if (vp_min_y < 0) vp_min_y = 0;
+    if (vp_max_x > rt->width - 1) vp_max_x = rt->width - 1;
+    if (vp_max_y > rt->height - 1) vp_max_y = rt->height - 1;
+
+    sw_triangle tri;
+    tri.min_x = sw_min3(x0, x1, x2) >> SW_SUBPIXEL_BITS;
+    tri.min_y = sw_min3(y0, y1, y2) >> SW_SUBPIXEL_BITS;
+    tri.max_x = sw_max3(x0, x1, x2) >> SW_SUBPIXEL_BITS;
+    tri.max_y = sw_max3(y0, y1, y2) >> SW_SUBPIXEL_BITS;
+    if (tri.min_x < vp_min_x) tri.min_x = vp_min_x;
+    if (tri.min_y < vp_min_y) tri.min_y = vp_min_y;
+    if (tri.max_x > vp_max_x) tri.max_x = vp_max_x;
+    if (tri.max_y > vp_max_y) tri.max_y = vp_max_y;
+    if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+    {
+        stats->triangles_culled++;
+        return;
+    }
+
+    // depth plane from the snapped positions
+    float inv_area = (float)SW_SUBPIXEL_ONE / (float)area;
+    float ex1 = (float)(x1 - x0);
+    float ey1 = (float)(y1 - y0);
+    float ex2 = (float)(x2 - x0);
+    float ey2 = (float)(y2 - y0);
+    tri.dzdx = ((z1 - z0) * ey2 - (z2 - z0) * ey1) * inv_area;
+    tri.dzdy = ((z2 - z0) * ex1 - (z1 - z0) * ex2) * inv_area;
+    float fx0 = (float)x0 / SW_SUBPIXEL_ONE;
+    float fy0 = (float)y0 / SW_SUBPIXEL_ONE;
+    tri.z = z0 + tri.dzdx * (0.5f - fx0) + tri.dzdy * (0.5f - fy0);
+
+    tri.x0 = x0; tri.y0 = y0;
+    tri.x1 = x1; tri.y1 = y1;
+    tri.x2 = x2; tri.y2 = y2;
+    tri.color = color;
+    tri.depth_func = (uint16_t)(ctx->depth_enable ? ctx->depth_func : SW_COMPARISON_ALWAYS);
+    tri.depth_write = (uint16_t)(ctx->depth_enable && ctx->depth_write);
+    triangles->push_back(tri);
+}
+
+// clips a clip space triangle against the near/far planes and the guard band, projects it and sets it up
+inline void
+sw_process_triangle(const sw_context *ctx, std::vector<sw_triangle> *triangles, sw_stats *stats,
+    const sw_clip_vertex *v0, const sw_clip_vertex *v1, const sw_clip_vertex *v2, uint32_t primitive_id, uint32_t instance_id)
+{
+    stats->triangles_in++;
+
+    // keep snapped screen coordinates well inside int32 fixed point
+    const sw_viewport *vp = &ctx->viewport;
+    float guard = 262144.0f / (vp->width > vp->height ? vp->width : vp->height);
+    if (guard < 1.0f)
+        guard = 1.0f;
+
+    // plane i is inside when dot(plane, v) >= 0: near, far, -x, +x, -y, +y guard band
+    auto distance = [guard](const sw_clip_vertex *v, int plane) -> float {
+        switch (plane)
+        {
+            case 0: return v->z;
+            case 1: return v->w - v->z;
+            case 2: return guard * v->w + v->x;
+            case 3: return guard * v->w - v->x;
+            case 4: return guard * v->w + v->y;
+            default: return guard * v->w - v->y;
+        }
+    };
+    // trivially outside a frustum plane, the guard band planes only matter for clipping
+    auto outcode = [](const sw_clip_vertex *v) -> uint32_t {
+        return (v->z < 0.0f ? 1u : 0u) |
+               (v->z > v->w ? 2u : 0u) |
+               (v->x < -v->w ? 4u : 0u) |
+               (v->x > v->w ? 8u : 0u) |
+               (v->y < -v->w ? 16u : 0u) |
+               (v->y > v->w ? 32u : 0u);
+    };
+    if (outcode(v0) & outcode(v1) & outcode(v2))
+    {
+        stats->triangles_culled++;
+        return;
+    }
+
+    // clipped polygon, every plane adds at most one vertex
+    sw_clip_vertex polygon[2][12];
+    int count = 3;
+    polygon[0][0] = *v0;
+    polygon[0][1] = *v1;
+    polygon[0][2] = *v2;
+    int current = 0;
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        bool any_outside = false;
+        for (int i = 0; i < count; ++i)
+            any_outside |= distance(&polygon[current][i], plane) < 0.0f;
+        if (any_outside == false)
+            continue;
+
+        int next_count = 0;
+        const sw_clip_vertex *in = polygon[current];
+        sw_clip_vertex *out = polygon[current ^ 1];
+        for (int i = 0; i < count; ++i)
+        {
+            const sw_clip_vertex *a = &in[i];
+            const sw_clip_vertex *b = &in[(i + 1) % count];
+            float da = distance(a, plane);
+            float db = distance(b, plane);
+            if (da >= 0.0f)
+                out[next_count++] = *a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+            {
+                float t = da / (da - db);
+                out[next_count++] = {
+                    a->x + (b->x - a->x) * t,
+                    a->y + (b->y - a->y) * t,
+                    a->z + (b->z - a->z) * t,
+                    a->w + (b->w - a->w) * t,
+                };
+            }
+        }
+        count = next_count;
+        current ^= 1;
+        if (count < 3)
+        {
+            stats->triangles_culled++;
+            return;
+        }
+    }
+
+    // project to screen space
+    sw_clip_vertex screen[12];
+    float half_width = vp->width * 0.5f;
+    float half_height = vp->height * 0.5f;
+    float depth_scale = vp->max_depth - vp->min_depth;
+    for (int i = 0; i < count; ++i)
+    {
+        const sw_clip_vertex *v = &polygon[current][i];
+        float inv_w = 1.0f / v->w;
+        float z = v->z * inv_w;
+        z = z < 0.0f ? 0.0f : (z > 1.0f ? 1.0f : z);
+        screen[i].x = vp->top_left_x + (v->x * inv_w + 1.0f) * half_width;
+        screen[i].y = vp->top_left_y + (1.0f - v->y * inv_w) * half_height;
+        screen[i].z = vp->min_depth + z * depth_scale;
+        screen[i].w = inv_w;
+    }
+
+    sw_float4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+    if (ctx->pixel_shader)
+    {
+        sw_pixel_input input = {primitive_id, instance_id};
+        color = ctx->pixel_shader(&input, ctx->ps_constant_buffers);
+    }
+    uint32_t packed_color = sw_pack_unorm8(color);
+
+    for (int i = 1; i + 1 < count; ++i)
+        sw_setup_triangle(ctx, triangles, stats, &screen[0], &screen[i], &screen[i + 1], packed_color);
+}
+
+inline sw_clip_vertex
+sw_transform_position(const float *mvp_transposed, const float *p)
+{
+    // mul(float4(p, 1), mvp) with mvp stored transposed, each output is a row dot product
+    const float *m = mvp_transposed;
+    sw_clip_vertex v;
+    v.x = m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3];
+    v.y = m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7];
+    v.z = m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11];
+    v.w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+    return v;
+}
+
+// transforms the vertices in [min_index, max_index] once and sets up the draw's triangles
+inline void
+sw_draw_instance(const sw_context *ctx, const float *mvp, const uint32_t *indices, uint32_t index_count,
+    uint32_t min_index, uint32_t max_index, int32_t base_vertex, uint32_t instance_id,
+    std::vector<sw_clip_vertex> *clip_vertices, std::vector<sw_triangle> *triangles, sw_stats *stats)
+{
+    clip_vertices->resize(max_index - min_index + 1);
+    for (uint32_t i = min_index; i <= max_index; ++i)
+    {
+        const float *position = (const float *)(ctx->vertex_buffer + (size_t)((int64_t)i + base_vertex) * ctx->vertex_stride);
+        (*clip_vertices)[i - min_index] = sw_transform_position(mvp, position);
+    }
+
+    // clip vertex 0 is vertex min_index
+    const sw_clip_vertex *vertices = clip_vertices->data();
+    for (uint32_t i = 0; i + 2 < index_count; i += 3)
+    {
+        sw_process_triangle(ctx, triangles, stats,
+            &vertices[indices[i + 0] - min_index],
+            &vertices[indices[i + 1] - min_index],
+            &vertices[indices[i + 2] - min_index],
+            i / 3,
+            instance_id);
+    }
+}
+
+inline void
+sw_index_range(const uint32_t *indices, uint32_t index_count, uint32_t *min_index, uint32_t *max_index)
+{
+    *min_index = UINT32_MAX;
+    *max_index = 0;
+    for (uint32_t i = 0; i < index_count; ++i)
+    {
+        *min_index = indices[i] < *min_index ? indices[i] : *min_index;
+        *max_index = indices[i] > *max_index ? indices[i] : *max_index;
+    }
+}
+
+inline void
+sw_draw_indexed(sw_context *ctx, uint32_t index_count, uint32_t start_index, int32_t base_vertex)
+{
+    if (ctx->render_target == nullptr || index_count < 3)
+        return;
+    ctx->stats.draws++;
+
+    const uint32_t *indices = ctx->index_buffer + start_index;
+    uint32_t min_index, max_index;
+    sw_index_range(indices, index_count, &min_index, &max_index);
+
+    sw_draw_instance(ctx, (const float *)ctx->vs_constant_buffers[0], indices, index_count,
+        min_index, max_index, base_vertex, 0, &ctx->clip_vertices, &ctx->triangles, &ctx->stats);
+}
+
+// instances are set up in parallel chunks and appended in instance order
+inline void
+sw_draw_indexed_instanced(sw_context *ctx, uint32_t index_count, uint32_t instance_count,
+    uint32_t start_index, int32_t base_vertex, uint32_t start_instance)
+{
+    if (ctx->render_target == nullptr || index_count < 3 || instance_count == 0)
+        return;
+    ctx->stats.draws++;
+
+    const uint32_t *indices = ctx->index_buffer + start_index;
+    uint32_t min_index, max_index;
+    sw_index_range(indices, index_count, &min_index, &max_index);
+
+    int chunk_count = (int)((instance_count + SW_INSTANCE_CHUNK_SIZE - 1) / SW_INSTANCE_CHUNK_SIZE);
+    if ((int)ctx->draw_chunks.size() < chunk_count)
+        ctx->draw_chunks.resize(chunk_count);
+
+    thread_pool_parallel_for(ctx->pool, chunk_count, [=](int chunk_index) {
+        sw_draw_chunk *chunk = &ctx->draw_chunks[chunk_index];
+        chunk->triangles.clear();
+        chunk->stats = {};
+
+        uint32_t begin = (uint32_t)chunk_index * SW_INSTANCE_CHUNK_SIZE;
+        uint32_t end = begin + SW_INSTANCE_CHUNK_SIZE < instance_count ? begin + SW_INSTANCE_CHUNK_SIZE : instance_count;
+        for (uint32_t instance = begin; instance < end; ++instance)
+        {
+            const float *mvp = (const float *)ctx->vs_constant_buffers[0];
+            if (ctx->instance_buffer)
+                mvp = (const float *)(ctx->instance_buffer + (size_t)(start_instance + instance) * ctx->instance_stride);
+            sw_draw_instance(ctx, mvp, indices, index_count, min_index, max_index, base_vertex, instance,
+                &chunk->clip_vertices, &chunk->triangles, &chunk->stats);
+        }
+    });
+
+    for (int i = 0; i < chunk_count; ++i)
+    {
+        const sw_draw_chunk *chunk = &ctx->draw_chunks[i];
+        ctx->triangles.insert(ctx->triangles.end(), chunk->triangles.begin(), chunk->triangles.end());
+        ctx->stats.triangles_in += chunk->stats.triangles_in;
+        ctx->stats.triangles_culled += chunk->stats.triangles_culled;
+    }
+}
+
+inline void
+sw_rasterize_triangle(const sw_triangle *tri, sw_render_target *rt, int32_t tile_min_x, int32_t tile_min_y, int32_t tile_max_x, int32_t tile_max_y)
+{
+    int32_t min_x = tri->min_x > tile_min_x ? tri->min_x : tile_min_x;
+    int32_t min_y = tri->min_y > tile_min_y ? tri->min_y : tile_min_y;
+    int32_t max_x = tri->max_x < tile_max_x ? tri->max_x : tile_max_x;
+    int32_t max_y = tri->max_y < tile_max_y ? tri->max_y : tile_max_y;
+    if (min_x > max_x || min_y > max_y)
+        return;
+
+    // edge functions w_i(p) = a_i * (p.x - v.x) + b_i * (p.y - v.y), positive inside.
+    // top-left fill rule: pixels exactly on an edge only belong to top and left edges
+    auto edge_bias = [](int32_t ax, int32_t ay, int32_t bx, int32_t by) -> int64_t {
+        int32_t dx = bx - ax;
+        int32_t dy = by - ay;
+        bool top_left = (dy < 0) || (dy == 0 && dx > 0);
+        return top_left ? 0 : -1;
+    };
+
+    int64_t px = ((int64_t)min_x << SW_SUBPIXEL_BITS) + SW_SUBPIXEL_ONE / 2;
+    int64_t py = ((int64_t)min_y << SW_SUBPIXEL_BITS) + SW_SUBPIXEL_ONE / 2;
+
+    int64_t a0 = -(int64_t)(tri->y2 - tri->y1), b0 = (int64_t)(tri->x2 - tri->x1);
+    int64_t a1 = -(int64_t)(tri->y0 - tri->y2), b1 = (int64_t)(tri->x0 - tri->x2);
+    int64_t a2 = -(int64_t)(tri->y1 - tri->y0), b2 = (int64_t)(tri->x1 - tri->x0);
+
+    int64_t row0 = a0 * (px - tri->x1) + b0 * (py - tri->y1) + edge_bias(tri->x1, tri->y1, tri->x2, tri->y2);
+    int64_t row1 = a1 * (px - tri->x2) + b1 * (py - tri->y2) + edge_bias(tri->x2, tri->y2, tri->x0, tri->y0);
+    int64_t row2 = a2 * (px - tri->x0) + b2 * (py - tri->y0) + edge_bias(tri->x0, tri->y0, tri->x1, tri->y1);
+
+    // per pixel steps
+    a0 <<= SW_SUBPIXEL_BITS; b0 <<= SW_SUBPIXEL_BITS;
+    a1 <<= SW_SUBPIXEL_BITS; b1 <<= SW_SUBPIXEL_BITS;
+    a2 <<= SW_SUBPIXEL_BITS; b2 <<= SW_SUBPIXEL_BITS;
+
+    float z_row = tri->z + tri->dzdx * (float)min_x + tri->dzdy * (float)min_y;
+    uint32_t color = tri->color;
+    int depth_func = tri->depth_func;
+    bool depth_write = tri->depth_write != 0;
+
+    for (int32_t y = min_y; y <= max_y; ++y)
+    {
+        int64_t w0 = row0;
+        int64_t w1 = row1;
+        int64_t w2 = row2;
+        float z = z_row;
+        uint32_t *color_row = rt->color + (size_t)y * rt->width;
+        float *depth_row = rt->depth + (size_t)y * rt->width;
+        for (int32_t x = min_x; x <= max_x; ++x)
+        {
+            if ((w0 | w1 | w2) >= 0)
+            {
+                bool pass;
+                switch (depth_func)
+                {
+                    case SW_COMPARISON_LESS: pass = z < depth_row[x]; break;
+                    case SW_COMPARISON_LESS_EQUAL: pass = z <= depth_row[x]; break;
+                    case SW_COMPARISON_ALWAYS: pass = true; break;
+                    default: pass = false; break;
+                }
+                if (pass)
+                {
+                    if (depth_write)
+                        depth_row[x] = z;
+                    color_row[x] = color;
+                }
+            }
+            w0 += a0;
+            w1 += a1;
+            w2 += a2;
+            z += tri->dzdx;
+        }
+        row0 += b0;
+        row1 += b1;
+        row2 += b2;
+        z_row += tri->dzdy;
+    }
+}
+
+inline void
+sw_flush(sw_context *ctx)
+{
+    sw_render_target *rt = ctx->render_target;
+    if (rt == nullptr)
+        return;
+    if (ctx->triangles.empty() && ctx->clear_color_pending == false && ctx->clear_depth_pending == false)
+        return;
+
+    PROFILE_ZONE("sw_flush");
+    int tiles_x = (rt->width + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+    int tiles_y = (rt->height + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+    int tile_count = tiles_x * tiles_y;
+    if (tiles_x != ctx->tiles_x || tiles_y != ctx->tiles_y)
+    {
+        ctx->bins.clear();
+        ctx->tiles_x = tiles_x;
+        ctx->tiles_y = tiles_y;
+    }
+
+    // bin contiguous chunks of triangles in parallel, each chunk owns a list per tile
+    int triangle_count = (int)ctx->triangles.size();
+    int chunk_count = (triangle_count + SW_BIN_CHUNK_SIZE - 1) / SW_BIN_CHUNK_SIZE;
+    if ((int)ctx->bins.size() < chunk_count * tile_count)
+        ctx->bins.resize((size_t)chunk_count * tile_count);
+
+    thread_pool_parallel_for(ctx->pool, chunk_count, [ctx, triangle_count, tile_count, tiles_x](int chunk) {
+        PROFILE_ZONE("sw bin chunk");
+        std::vector<uint32_t> *bins = &ctx->bins[(size_t)chunk * tile_count];
+        int begin = chunk * SW_BIN_CHUNK_SIZE;
+        int end = begin + SW_BIN_CHUNK_SIZE < triangle_count ? begin + SW_BIN_CHUNK_SIZE : triangle_count;
+        for (int i = begin; i < end; ++i)
+        {
+            const sw_triangle *tri = &ctx->triangles[i];
+            int tx0 = tri->min_x / SW_TILE_SIZE;
+            int ty0 = tri->min_y / SW_TILE_SIZE;
+            int tx1 = tri->max_x / SW_TILE_SIZE;
+            int ty1 = tri->max_y / SW_TILE_SIZE;
+            for (int ty = ty0; ty <= ty1; ++ty)
+                for (int tx = tx0; tx <= tx1; ++tx)
+                    bins[ty * tiles_x + tx].push_back((uint32_t)i);
+        }
+    });
+
+    // rasterize tiles in parallel, chunks are walked in order to keep submission order
+    std::atomic<uint64_t> tiles_touched(0);
+    thread_pool_parallel_for(ctx->pool, tile_count, [ctx, rt, chunk_count, tile_count, tiles_x, &tiles_touched](int tile) {
+        PROFILE_ZONE("sw tile");
+        int32_t tile_min_x = (tile % tiles_x) * SW_TILE_SIZE;
+        int32_t tile_min_y = (tile / tiles_x) * SW_TILE_SIZE;
+        int32_t tile_max_x = (tile_min_x + SW_TILE_SIZE < rt->width ? tile_min_x + SW_TILE_SIZE : rt->width) - 1;
+        int32_t tile_max_y = (tile_min_y + SW_TILE_SIZE < rt->height ? tile_min_y + SW_TILE_SIZE : rt->height) - 1;
+
+        for (int32_t y = tile_min_y; y <= tile_max_y; ++y)
+        {
+            size_t row = (size_t)y * rt->width;
+            if (ctx->clear_color_pending)
+                for (int32_t x = tile_min_x; x <= tile_max_x; ++x)
+                    rt->color[row + x] = ctx->clear_color;
+            if (ctx->clear_depth_pending)
+                for (int32_t x = tile_min_x; x <= tile_max_x; ++x)
+                    rt->depth[row + x] = ctx->clear_depth;
+        }
+
+        bool touched = false;
+        for (int chunk = 0; chunk < chunk_count; ++chunk)
+        {
+            std::vector<uint32_t> *bin = &ctx->bins[(size_t)chunk * tile_count + tile];
+            for (uint32_t index : *bin)
+                sw_rasterize_triangle(&ctx->triangles[index], rt, tile_min_x, tile_min_y, tile_max_x, tile_max_y);
+            touched |= bin->empty() == false;
+            bin->clear();
+        }
+        if (touched)
+            tiles_touched.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    ctx->stats.triangles_rasterized += (uint64_t)triangle_count;
+    ctx->stats.tiles_touched += tiles_touched.load();
+    ctx->triangles.clear();
+    ctx->clear_color_pending = false;
+    ctx->clear_depth_pending = false;
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #if !defined(WIN32_LEAN_AND_MEAN)
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// cooked texture container. a fixed header, a table with one entry per subresource and the
+// subresource data, every piece at a TEXTURE_FILE_ALIGNMENT boundary. the file is mapped
+// read-only and texture_file_subresource_data can go straight into pSysMem, nothing is
+// decoded or copied before CreateTexture2D.
+//
+// subresource i is mip (i % mip_count) of array slice (i / mip_count), the D3D11CalcSubresource
+// order. rows are rows of pixels for RGBA8 and rows of 4x4 blocks for the BC formats.
+
+#define TEXTURE_FILE_MAGIC 0x58455443 // "CTEX"
+#define TEXTURE_FILE_VERSION 1
+#define TEXTURE_FILE_ALIGNMENT 16
+#define TEXTURE_FILE_MAX_SUBRESOURCES 1024
+#define TEXTURE_FILE_MAX_DIMENSION 16384 // D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION
+
+// values match DXGI_FORMAT so they can be cast to it
+enum texture_file_format
+{
+    TEXTURE_FILE_FORMAT_RGBA8 = 28, // DXGI_FORMAT_R8G8B8A8_UNORM
+    TEXTURE_FILE_FORMAT_BC1 = 71,   // DXGI_FORMAT_BC1_UNORM
+    TEXTURE_FILE_FORMAT_BC3 = 77,   // DXGI_FORMAT_BC3_UNORM
+    TEXTURE_FILE_FORMAT_BC7 = 98,   // DXGI_FORMAT_BC7_UNORM
+};
+
+// rgb holds srgb encoded values
+#define TEXTURE_FILE_FLAG_SRGB 1
+
+struct texture_file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t flags;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint32_t array_size;
+    uint64_t file_size;
+    uint64_t reserved;
+};
+
+struct texture_file_subresource
+{
+    uint64_t offset; // from the start of the file
+    uint64_t size;
+    uint32_t row_pitch;
+    uint32_t width;
+    uint32_t height;
+    uint32_t reserved;
+};
+
+struct texture_file
+{
+    const uint8_t *data;
+    size_t size;
+    const texture_file_header *header;
+    const texture_file_subresource *subresources;
+#if defined(_WIN32)
+    HANDLE file_handle;
+    HANDLE mapping;
+#endif
+};
+
+inline bool
+texture_file_is_known_format(uint32_t format)
+{
+    return format == TEXTURE_FILE_FORMAT_RGBA8 || format == TEXTURE_FILE_FORMAT_BC1 || format == TEXTURE_FILE_FORMAT_BC3 ||
+        format == TEXTURE_FILE_FORMAT_BC7;
+}
+
+inline bool
+texture_file_is_block_format(uint32_t format)
+{
+    return format == TEXTURE_FILE_FORMAT_BC1 || format == TEXTURE_FILE_FORMAT_BC3 || format == TEXTURE_FILE_FORMAT_BC7;
+}
+
+inline uint32_t
+texture_file_row_pitch(uint32_t format, uint32_t width)
+{
+    if (texture_file_is_block_format(format))
+        return (width + 3) / 4 * (format == TEXTURE_FILE_FORMAT_BC1 ? 8 : 16);
+    return width * 4;
+}
+
+inline uint32_t
+texture_file_row_count(uint32_t format, uint32_t height)
+{
+    return texture_file_is_block_format(format) ? (height + 3) / 4 : height;
+}
+
+inline uint64_t
+texture_file_align(uint64_t offset)
+{
+    return (offset + TEXTURE_FILE_ALIGNMENT - 1) & ~(uint64_t)(TEXTURE_FILE_ALIGNMENT - 1);
+}
+
+// subresources holds mip_count * array_size pointers in subresource order, each tightly
+// packed at texture_file_row_pitch
+inline bool
+texture_file_write(const char *path, texture_file_format format, uint32_t flags, uint32_t width, uint32_t height,
+    uint32_t mip_count, uint32_t array_size, const void *const *subresources)
+{
+    uint32_t count = mip_count * array_size;
+    if (width == 0 || height == 0 || count == 0 || count > TEXTURE_FILE_MAX_SUBRESOURCES)
+        return false;
+
+    texture_file_header header = {};
+    header.magic = TEXTURE_FILE_MAGIC;
+    header.version = TEXTURE_FILE_VERSION;
+    header.format = (uint32_t)format;
+    header.flags = flags;
+    header.width = width;
+    header.height = height;
+    header.mip_count = mip_count;
+    header.array_size = array_size;
+
+    texture_file_subresource *table = (texture_file_subresource *)calloc(count, sizeof(texture_file_subresource));
+    if (table == nullptr)
+        return false;
+
+    uint64_t offset = texture_file_align(sizeof(header) + (uint64_t)count * sizeof(texture_file_subresource));
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t mip = i % mip_count;
+        texture_file_subresource *subresource = &table[i];
+        subresource->width = width >> mip > 0 ? width >> mip : 1;
+        subresource->height = height >> mip > 0 ? height >> mip : 1;
+        subresource->row_pitch = texture_file_row_pitch(format, subresource->width);
+        subresource->size = (uint64_t)subresource->row_pitch * texture_file_row_count(format, subresource->height);
+        subresource->offset = offset;
+        offset = texture_file_align(offset + subresource->size);
+    }
+    header.file_size = offset;
+
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+    {
+        free(table);
+        return false;
+    }
+
+    static const uint8_t padding[TEXTURE_FILE_ALIGNMENT] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(table, sizeof(texture_file_subresource), count, file) == count;
+    uint64_t position = sizeof(header) + (uint64_t)count * sizeof(texture_file_subresource);
+    for (uint32_t i = 0; ok && i < count; ++i)
+    {
+        size_t pad = (size_t)(table[i].offset - position);
+        ok = fwrite(padding, 1, pad, file) == pad && fwrite(subresources[i], 1, (size_t)table[i].size, file) == table[i].size;
+        position = table[i].offset + table[i].size;
+    }
+    if (ok && position < header.file_size)
+    {
+        size_t pad = (size_t)(header.file_size - position);
+        ok = fwrite(padding, 1, pad, file) == pad;
+    }
+
+    ok = fclose(file) == 0 && ok;
+    free(table);
+    return ok;
+}
+
+inline void
+texture_file_close(texture_file *file)
+{
+#if defined(_WIN32)
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->mapping)
+        CloseHandle(file->mapping);
+    if (file->file_handle && file->file_handle != INVALID_HANDLE_VALUE)
+        CloseHandle(file->file_handle);
+    file->file_handle = nullptr;
+    file->mapping = nullptr;
+#else
+    if (file->data)
+        munmap((void *)file->data, file->size);
+#endif
+    file->data = nullptr;
+    file->size = 0;
+    file->header = nullptr;
+    file->subresources = nullptr;
+}
+
+// maps the file and checks that the header and every subresource fit inside it
+inline bool
+texture_file_open(texture_file *file, const char *path)
+{
+    memset(file, 0, sizeof(*file));
+
+#if defined(_WIN32)
+    file->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->file_handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file->file_handle, &file_size) == FALSE || file_size.QuadPart < (LONGLONG)sizeof(texture_file_header))
+    {
+        texture_file_close(file);
+        return false;
+    }
+    file->mapping = CreateFileMappingA(file->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (file->mapping == nullptr)
+    {
+        texture_file_close(file);
+        return false;
+    }
+    file->data = (const uint8_t *)MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+    file->size = (size_t)file_size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(texture_file_header))
+    {
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped != MAP_FAILED)
+    {
+        file->data = (const uint8_t *)mapped;
+        file->size = (size_t)st.st_size;
+    }
+#endif
+    if (file->data == nullptr)
+    {
+        texture_file_close(file);
+        return false;
+    }
+
+    const texture_file_header *header = (const texture_file_header *)file->data;
+    uint64_t count = (uint64_t)header->mip_count * header->array_size;
+    uint32_t full_mip_count = 1;
+    while (full_mip_count < 32 && (header->width >> full_mip_count > 0 || header->height >> full_mip_count > 0))
+        ++full_mip_count;
+    bool valid = header->magic == TEXTURE_FILE_MAGIC && header->version == TEXTURE_FILE_VERSION &&
+        header->file_size <= file->size && texture_file_is_known_format(header->format) && header->width > 0 &&
+        header->height > 0 && header->width <= TEXTURE_FILE_MAX_DIMENSION && header->height <= TEXTURE_FILE_MAX_DIMENSION &&
+        header->mip_count <= full_mip_count && count > 0 && count <= TEXTURE_FILE_MAX_SUBRESOURCES &&
+        sizeof(texture_file_header) + count * sizeof(texture_file_subresource) <= file->size;
+
+    // CreateTexture2D sizes every level from the header, so the table has to agree with it
+    const texture_file_subresource *subresources = (const texture_file_subresource *)(header + 1);
+    for (uint64_t i = 0; valid && i < count; ++i)
+    {
+        const texture_file_subresource *subresource = &subresources[i];
+        uint32_t mip = (uint32_t)(i % header->mip_count);
+        uint32_t width = header->width >> mip > 0 ? header->width >> mip : 1;
+        uint32_t height = header->height >> mip > 0 ? header->height >> mip : 1;
+        valid = subresource->width == width && subresource->height == height &&
+            subresource->offset % TEXTURE_FILE_ALIGNMENT == 0 && subresource->offset <= file->size &&
+            subresource->size <= file->size - subresource->offset &&
+            subresource->row_pitch >= texture_file_row_pitch(header->format, subresource->width) &&
+            (uint64_t)subresource->row_pitch * texture_file_row_count(header->format, subresource->height) <= subresource->size;
+    }
+    if (valid == false)
+    {
+        texture_file_close(file);
+        return false;
+    }
+
+    file->header = header;
+    file->subresources = subresources;
+    return true;
+}
+
+inline const void *
+texture_file_subresource_data(const texture_file *file, uint32_t index)
+{
+    return file->data + file->subresources[index].offset;
+}
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bc_encode.h"
+#include "image_io.h"
+#include "mip_gen.h"
+#include "profile.h"
+#include "texture_file.h"
+
+// asynchronous texture loading. texture_stream_request queues a path and returns a handle
+// right away, worker threads open or decode the file and build everything CreateTexture2D
+// needs, and the render thread picks the finished images up with texture_stream_poll, which
+// stops handing them out once the frame's upload byte budget is used up.
+//
+// cooked .tex files are mapped and their pages touched on the worker so the upload doesn't
+// fault them in on the render thread. anything else goes through image_io.h, gets a kaiser
+// filtered srgb mip chain and, if asked for, BC7 compression.
+//
+// workers stop picking up new requests while more than ready_bytes_limit bytes of finished
+// images wait for upload, so queueing hundreds of textures can't pile up gigabytes of pixels.
+
+enum texture_stream_state
+{
+    TEXTURE_STREAM_QUEUED,
+    TEXTURE_STREAM_LOADING,
+    TEXTURE_STREAM_READY,
+    TEXTURE_STREAM_UPLOADED,
+    TEXTURE_STREAM_FAILED,
+};
+
+struct texture_stream_level
+{
+    const void *data;
+    uint32_t row_pitch;
+    uint32_t width;
+    uint32_t height;
+    uint64_t size;
+};
+
+// a loaded texture waiting for upload, levels are tightly packed rows in the layout
+// D3D11_SUBRESOURCE_DATA expects
+struct texture_stream_image
+{
+    uint32_t handle;
+    uint32_t format; // texture_file_format, castable to DXGI_FORMAT
+    uint32_t width;
+    uint32_t height;
+    int level_count;
+    texture_stream_level levels[MIP_MAX_LEVELS];
+    uint64_t bytes;
+
+    // seconds on the texture_stream_now clock
+    double request_time;
+    double ready_time;
+
+    // whichever of these holds the level data
+    texture_file cooked;
+    mip_chain mips;
+    uint8_t *pixels;
+    uint8_t *blocks;
+};
+
+// return false if the upload failed, the handle is marked failed
+typedef bool (*texture_stream_upload_fn)(void *user, const texture_stream_image *image);
+
+struct texture_stream_stats
+{
+    uint64_t requests;
+    uint64_t loaded;
+    uint64_t failed;
+    uint64_t uploaded;
+    uint64_t uploaded_bytes;
+    uint64_t polls;
+    uint64_t budget_limited_polls; // polls that left ready images for the next frame
+    uint64_t peak_ready_bytes;
+};
+
+struct texture_stream_entry
+{
+    std::string path;
+    texture_stream_state state;
+    double request_time;
+};
+
+struct texture_stream
+{
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // guarded by mutex
+    std::vector<texture_stream_entry> entries; // indexed by handle
+    std::deque<uint32_t> queue;
+    std::deque<texture_stream_image *> ready;
+    uint64_t ready_bytes;
+    uint64_t ready_bytes_limit;
+    bool compress;
+    bool quit;
+    texture_stream_stats stats;
+};
+
+inline double
+texture_stream_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void
+texture_stream_image_free(texture_stream_image *image)
+{
+    texture_file_close(&image->cooked);
+    mip_chain_free(&image->mips);
+    image_free(image->pixels);
+    free(image->blocks);
+    delete image;
+}
+
+inline bool
+texture_stream_load_cooked(texture_stream_image *image, const char *path)
+{
+    PROFILE_ZONE("texture load cooked");
+    if (texture_file_open(&image->cooked, path) == false)
+        return false;
+
+    const texture_file_header *header = image->cooked.header;
+    if (header->array_size != 1 || header->mip_count > MIP_MAX_LEVELS)
+        return false;
+
+    image->format = header->format;
+    image->width = header->width;
+    image->height = header->height;
+    image->level_count = (int)header->mip_count;
+
+    // one read per page brings the whole file in on this thread
+    volatile uint8_t sink = 0;
+    for (int level = 0; level < image->level_count; ++level)
+    {
+        const texture_file_subresource *subresource = &image->cooked.subresources[level];
+        const uint8_t *data = (const uint8_t *)texture_file_subresource_data(&image->cooked, level);
+        for (uint64_t offset = 0; offset < subresource->size; offset += 4096)
+            sink = (uint8_t)(sink + data[offset]);
+
+        texture_stream_level *out = &image->levels[level];
+        out->data = data;
+        out->row_pitch = subresource->row_pitch;
+        out->width = subresource->width;
+        out->height = subresource->height;
+        out->size = subresource->size;
+        image->bytes += subresource->size;
+    }
+    return true;
+}
+
+// takes over pixels from image_load, builds the mips and optionally the BC7 blocks. pool may
+// be null to do everything on the calling thread
+inline bool
+texture_stream_build_image(texture_stream_image *image, uint8_t *pixels, int width, int height, bool compress, thread_pool *pool)
+{
+    image->pixels = pixels;
+    if (mip_chain_build(&image->mips, image->pixels, width, height, MIP_FILTER_KAISER, true, pool) == false)
+        return false;
+
+    image->width = (uint32_t)width;
+    image->height = (uint32_t)height;
+    image->level_count = image->mips.level_count;
+
+    // BC textures need a top level that is a multiple of the 4x4 block size
+    if (compress && width % 4 == 0 && height % 4 == 0)
+    {
+        size_t total = 0;
+        for (int level = 0; level < image->level_count; ++level)
+            total += bc_level_size(BC_FORMAT_BC7, image->mips.levels[level].width, image->mips.levels[level].height);
+        image->blocks = (uint8_t *)malloc(total);
+    }
+
+    if (image->blocks)
+    {
+        PROFILE_ZONE("bc7 encode");
+        image->format = TEXTURE_FILE_FORMAT_BC7;
+        uint8_t *out = image->blocks;
+        for (int level = 0; level < image->level_count; ++level)
+        {
+            const mip_level *mip = &image->mips.levels[level];
+            bc_encode_image(BC_FORMAT_BC7, BC_QUALITY_NORMAL, mip->data, mip->width, mip->height, mip->pitch, out, pool);
+
+            texture_stream_level *level_out = &image->levels[level];
+            level_out->data = out;
+            level_out->row_pitch = (uint32_t)bc_row_pitch(BC_FORMAT_BC7, mip->width);
+            level_out->width = (uint32_t)mip->width;
+            level_out->height = (uint32_t)mip->height;
+            level_out->size = bc_level_size(BC_FORMAT_BC7, mip->width, mip->height);
+            out += level_out->size;
+            image->bytes += level_out->size;
+        }
+
+        // only the blocks are needed from here on
+        mip_chain_free(&image->mips);
+        image_free(image->pixels);
+        image->pixels = nullptr;
+    }
+    else
+    {
+        image->format = TEXTURE_FILE_FORMAT_RGBA8;
+        for (int level = 0; level < image->level_count; ++level)
+        {
+            const mip_level *mip = &image->mips.levels[level];
+            texture_stream_level *level_out = &image->levels[level];
+            level_out->data = mip->data;
+            level_out->row_pitch = (uint32_t)mip->pitch;
+            level_out->width = (uint32_t)mip->width;
+            level_out->height = (uint32_t)mip->height;
+            level_out->size = (uint64_t)mip->pitch * mip->height;
+            image->bytes += level_out->size;
+        }
+    }
+    return true;
+}
+
+inline bool
+texture_stream_load_image(texture_stream_image *image, const char *path, bool compress)
+{
+    int width, height;
+    uint8_t *pixels = image_load(path, &width, &height);
+    if (pixels == nullptr)
+        return false;
+    return texture_stream_build_image(image, pixels, width, height, compress, nullptr);
+}
+
+inline void
+texture_stream_worker_main(texture_stream *stream)
+{
+    PROFILE_THREAD_NAME("texture stream");
+    for (;;)
+    {
+        uint32_t handle;
+        std::string path;
+        bool compress;
+        double request_time;
+        {
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            stream->wake.wait(lock, [&] {
+                return stream->quit || (stream->queue.empty() == false && stream->ready_bytes < stream->ready_bytes_limit);
+            });
+            if (stream->quit)
+                return;
+
+            handle = stream->queue.front();
+            stream->queue.pop_front();
+            texture_stream_entry *entry = &stream->entries[handle];
+            entry->state = TEXTURE_STREAM_LOADING;
+            path = entry->path;
+            request_time = entry->request_time;
+            compress = stream->compress;
+        }
+
+        texture_stream_image *image = new texture_stream_image();
+        image->handle = handle;
+        image->request_time = request_time;
+
+        size_t length = path.size();
+        bool cooked = length > 4 && strcmp(path.c_str() + length - 4, ".tex") == 0;
+        bool loaded = cooked ? texture_stream_load_cooked(image, path.c_str()) : texture_stream_load_image(image, path.c_str(), compress);
+        image->ready_time = texture_stream_now();
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        if (loaded)
+        {
+            stream->entries[handle].state = TEXTURE_STREAM_READY;
+            stream->ready.push_back(image);
+            stream->ready_bytes += image->bytes;
+            if (stream->ready_bytes > stream->stats.peak_ready_bytes)
+                stream->stats.peak_ready_bytes = stream->ready_bytes;
+            stream->stats.loaded++;
+        }
+        else
+        {
+            stream->entries[handle].state = TEXTURE_STREAM_FAILED;
+            stream->stats.failed++;
+            texture_stream_image_free(image);
+        }
+    }
+}
+
+// worker_count 0 uses one thread less than there are cores, the render thread keeps its own.
+// compress turns decoded images into BC7, cooked files are uploaded in whatever format they hold
+inline void
+texture_stream_init(texture_stream *stream, int worker_count = 0, bool compress = false, uint64_t ready_bytes_limit = 256ull << 20)
+{
+    if (worker_count <= 0)
+        worker_count = (int)std::thread::hardware_concurrency() - 1;
+    if (worker_count <= 0)
+        worker_count = 1;
+
+    stream->ready_bytes = 0;
+    stream->ready_bytes_limit = ready_bytes_limit;
+    stream->compress = compress;
+    stream->quit = false;
+    stream->stats = {};
+
+    for (int i = 0; i < worker_count; ++i)
+        stream->workers.emplace_back(texture_stream_worker_main, stream);
+}
+
+// images that were never uploaded are dropped
+inline void
+texture_stream_shutdown(texture_stream *stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->quit = true;
+    }
+    stream->wake.notify_all();
+    for (std::thread &worker : stream->workers)
+        worker.join();
+    stream->workers.clear();
+
+    for (texture_stream_image *image : stream->ready)
+        texture_stream_image_free(image);
+    stream->ready.clear();
+    stream->queue.clear();
+    stream->ready_bytes = 0;
+}
+
+inline uint32_t
+texture_stream_request(texture_stream *stream, const char *path)
+{
+    uint32_t handle;
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        handle = (uint32_t)stream->entries.size();
+        texture_stream_entry entry;
+        entry.path = path;
+        entry.state = TEXTURE_STREAM_QUEUED;
+        entry.request_time = texture_stream_now();
+        stream->entries.push_back(entry);
+        stream->queue.push_back(handle);
+        stream->stats.requests++;
+    }
+    stream->wake.notify_one();
+    return handle;
+}
+
+inline texture_stream_state
+texture_stream_get_state(texture_stream *stream, uint32_t handle)
+{
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    return stream->entries[handle].state;
+}
+
+inline texture_stream_stats
+texture_stream_get_stats(texture_stream *stream)
+{
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    return stream->stats;
+}
+
+// called once a frame on the render thread. hands ready images to upload in the order they
+// finished until the next one would go over byte_budget, 0 means no limit. the first image
+// of a frame always goes through so one larger than the budget can't stall the stream.
+// returns the number of images handed out
+inline int
+texture_stream_poll(texture_stream *stream, uint64_t byte_budget, texture_stream_upload_fn upload, void *user)
+{
+    int count = 0;
+    uint64_t used = 0;
+    for (;;)
+    {
+        texture_stream_image *image = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            if (count == 0)
+                stream->stats.polls++;
+            if (stream->ready.empty())
+                break;
+
+            image = stream->ready.front();
+            if (byte_budget && used && used + image->bytes > byte_budget)
+            {
+                stream->stats.budget_limited_polls++;
+                break;
+            }
+            stream->ready.pop_front();
+            stream->ready_bytes -= image->bytes;
+        }
+
+        // room for the workers again
+        stream->wake.notify_all();
+
+        bool uploaded = upload(user, image);
+        used += image->bytes;
+        count++;
+
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            if (uploaded)
+            {
+                stream->entries[image->handle].state = TEXTURE_STREAM_UPLOADED;
+                stream->stats.uploaded++;
+                stream->stats.uploaded_bytes += image->bytes;
+            }
+            else
+            {
+                stream->entries[image->handle].state = TEXTURE_STREAM_FAILED;
+                stream->stats.failed++;
+            }
+        }
+        texture_stream_image_free(image);
+    }
+    return count;
+}
+
+// true once every request has been uploaded or has failed
+inline bool
+texture_stream_idle(texture_stream *stream)
+{
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    return stream->stats.uploaded + stream->stats.failed == stream->stats.requests;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "job_system.h"
+
+// minimal fork-join thread pool, the calling thread takes part in the work. it is a job
+// system underneath, so a parallel_for inside another one fans out as well and calls from
+// several threads run side by side; see job_system.h for dependencies and main thread jobs.
+struct thread_pool
+{
+    job_system jobs;
+};
+
+// thread_count is the total number of threads including the caller, 0 uses all cores
+inline void
+thread_pool_init(thread_pool *pool, int thread_count = 0)
+{
+    job_system_init(&pool->jobs, thread_count);
+}
+
+inline void
+thread_pool_shutdown(thread_pool *pool)
+{
+    job_system_shutdown(&pool->jobs);
+}
+
+inline int
+thread_pool_size(const thread_pool *pool)
+{
+    return job_system_thread_count(&pool->jobs);
+}
+
+// calls fn(index) for every index in [0, count) and returns when all of them are done
+template <typename F>
+inline void
+thread_pool_parallel_for(thread_pool *pool, int count, F &&fn)
+{
+    job_parallel_for(&pool->jobs, count, fn);
+}